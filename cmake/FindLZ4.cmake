@@ -0,0 +1,17 @@
+# This module searches for the LZ4 compression library and defines
+# LZ4_LIBRARIES - link libraries
+# LZ4_FOUND, if false, do not try to link
+# LZ4_INCLUDE_DIR, where to find the headers
+#
+# $LZ4_DIR is an environment variable that would correspond to the ./configure --prefix=$LZ4_DIR
+
+find_path(LZ4_INCLUDE_DIR lz4.h HINTS ENV LZ4_DIR PATH_SUFFIXES include)
+find_library(LZ4_LIBRARY NAMES lz4 liblz4 HINTS ENV LZ4_DIR PATH_SUFFIXES lib)
+set(LZ4_LIBRARIES ${LZ4_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(LZ4 REQUIRED_VARS LZ4_LIBRARIES LZ4_INCLUDE_DIR)
+
+if(LZ4_FOUND)
+  mark_as_advanced(LZ4_INCLUDE_DIR LZ4_LIBRARY LZ4_LIBRARIES)
+endif(LZ4_FOUND)
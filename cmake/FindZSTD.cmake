@@ -0,0 +1,17 @@
+# This module searches for the Zstandard compression library and defines
+# ZSTD_LIBRARIES - link libraries
+# ZSTD_FOUND, if false, do not try to link
+# ZSTD_INCLUDE_DIR, where to find the headers
+#
+# $ZSTD_DIR is an environment variable that would correspond to the ./configure --prefix=$ZSTD_DIR
+
+find_path(ZSTD_INCLUDE_DIR zstd.h HINTS ENV ZSTD_DIR PATH_SUFFIXES include)
+find_library(ZSTD_LIBRARY NAMES zstd libzstd zstd_static HINTS ENV ZSTD_DIR PATH_SUFFIXES lib)
+set(ZSTD_LIBRARIES ${ZSTD_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(ZSTD REQUIRED_VARS ZSTD_LIBRARIES ZSTD_INCLUDE_DIR)
+
+if(ZSTD_FOUND)
+  mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARY ZSTD_LIBRARIES)
+endif(ZSTD_FOUND)
@@ -0,0 +1,120 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "ChunkOccupancySummary.h"
+
+#include "MapChunk.h"
+#include "VoxelBlock.h"
+#include "VoxelBuffer.h"
+#include "VoxelOccupancy.h"
+
+#include "private/OccupancyMapDetail.h"
+
+#include <glm/glm.hpp>
+
+#include <utility>
+
+namespace ohm
+{
+void ChunkOccupancySummary::sync(const MapChunk &chunk, int occupancy_layer, uint64_t stamp,
+                                 float occupancy_threshold)
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+
+  const unsigned write_count = chunk.voxel_blocks[occupancy_layer]->writeCount();
+  if (valid_ && stamp_ == stamp && write_count_ == write_count && occupancy_threshold_ == occupancy_threshold)
+  {
+    return;
+  }
+
+  dim_ = chunk.map->region_voxel_dimensions;
+  const unsigned voxel_count = voxelCount();
+  const size_t word_count = (voxel_count + 63u) / 64u;
+  occupied_bits_.assign(word_count, 0u);
+  unobserved_bits_.assign(word_count, 0u);
+
+  // Build the first level of the pyramid while setting the bits.
+  levels_.clear();
+  levels_.emplace_back();
+  glm::ivec3 cell_dim = (dim_ + glm::ivec3(kCellDim - 1)) / kCellDim;
+  levels_.back().resize(size_t(cell_dim.x) * size_t(cell_dim.y) * size_t(cell_dim.z));
+
+  VoxelBuffer<const VoxelBlock> buffer(chunk.voxel_blocks[occupancy_layer]);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  const float *occupancy_mem = reinterpret_cast<const float *>(buffer.voxelMemory());
+  unsigned voxel_index = 0;
+  for (int z = 0; z < dim_.z; ++z)
+  {
+    for (int y = 0; y < dim_.y; ++y)
+    {
+      Cell *cell_row = &levels_.back()[size_t((z / kCellDim) * cell_dim.y + y / kCellDim) * size_t(cell_dim.x)];
+      for (int x = 0; x < dim_.x; ++x, ++voxel_index)
+      {
+        const float occupancy = occupancy_mem[voxel_index];
+        if (occupancy == unobservedOccupancyValue())
+        {
+          unobserved_bits_[voxel_index / 64u] |= bit(voxel_index);
+          ++cell_row[x / kCellDim].unobserved;
+        }
+        else if (occupancy >= occupancy_threshold)
+        {
+          occupied_bits_[voxel_index / 64u] |= bit(voxel_index);
+          ++cell_row[x / kCellDim].occupied;
+        }
+      }
+    }
+  }
+
+  // Build the coarser levels by merging 2x2x2 cells until a single cell remains.
+  while (glm::any(glm::greaterThan(cell_dim, glm::ivec3(1))))
+  {
+    const glm::ivec3 child_dim = cell_dim;
+    cell_dim = (cell_dim + glm::ivec3(1)) / 2;
+    std::vector<Cell> level(size_t(cell_dim.x) * size_t(cell_dim.y) * size_t(cell_dim.z));
+    const std::vector<Cell> &children = levels_.back();
+    for (int z = 0; z < child_dim.z; ++z)
+    {
+      for (int y = 0; y < child_dim.y; ++y)
+      {
+        for (int x = 0; x < child_dim.x; ++x)
+        {
+          const Cell &child = children[size_t(x + (y + z * child_dim.y) * child_dim.x)];
+          Cell &parent = level[size_t(x / 2 + (y / 2 + (z / 2) * cell_dim.y) * cell_dim.x)];
+          parent.occupied += child.occupied;
+          parent.unobserved += child.unobserved;
+        }
+      }
+    }
+    levels_.emplace_back(std::move(level));
+  }
+
+  totals_ = levels_.back().front();
+  stamp_ = stamp;
+  write_count_ = write_count;
+  occupancy_threshold_ = occupancy_threshold;
+  valid_ = true;
+}
+
+
+void ChunkOccupancySummary::invalidate()
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+  valid_ = false;
+}
+
+
+glm::ivec3 ChunkOccupancySummary::cellDimensions(unsigned level) const
+{
+  const int cell_size = cellSize(level);
+  return (dim_ + glm::ivec3(cell_size - 1)) / cell_size;
+}
+
+
+const ChunkOccupancySummary::Cell &ChunkOccupancySummary::cell(unsigned level, const glm::ivec3 &coord) const
+{
+  const glm::ivec3 cell_dim = cellDimensions(level);
+  return levels_[level][size_t(coord.x + (coord.y + coord.z * cell_dim.y) * cell_dim.x)];
+}
+}  // namespace ohm
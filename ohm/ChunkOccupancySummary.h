@@ -0,0 +1,180 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_CHUNKOCCUPANCYSUMMARY_H
+#define OHM_CHUNKOCCUPANCYSUMMARY_H
+
+#include "OhmConfig.h"
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif  // _MSC_VER
+
+namespace ohm
+{
+struct MapChunk;
+
+/// A summary of the occupancy layer of a @c MapChunk used to skip empty space in queries.
+///
+/// The summary holds a bitmask marking the occupied voxels and a bitmask marking the unobserved voxels of the chunk.
+/// Bits are ordered by @c voxelIndex() , so scanning the bitmasks visits voxels in the same order as iterating the
+/// voxel memory, 64 voxels at a time. The summary also holds a pyramid of occupied and unobserved voxel counts. The
+/// first level counts voxels in cells of @c kCellDim voxels along each axis, with each following level doubling the
+/// cell size until a single cell covers the chunk. The @c totals() are the counts for the whole chunk.
+///
+/// The summary is not updated on every voxel write. Instead, it is lazily recalculated by
+/// @c MapChunk::occupancySummary() whenever the @c MapChunk::touched_stamps value for the occupancy layer or the
+/// map occupancy threshold differs from that used to build the summary. All occupancy writers are expected to update
+/// the touched stamps as described for @c MapChunk . Writes through a writable @c VoxelBuffer which do not update the
+/// stamps are detected via the @c VoxelBlock::writeCount() of the occupancy layer once the buffer is released.
+class ohm_API ChunkOccupancySummary
+{
+public:
+  /// Number of voxels along each axis of a cell in the first level of the count pyramid.
+  static constexpr int kCellDim = 4;
+
+  /// Occupied and unobserved voxel counts for a cell in the count pyramid.
+  struct Cell
+  {
+    uint32_t occupied = 0;    ///< Number of occupied voxels.
+    uint32_t unobserved = 0;  ///< Number of unobserved voxels.
+  };
+
+  /// Query the bit within a bitmask word for the given @p voxel_index .
+  /// @param voxel_index Index of the voxel in the chunk.
+  /// @return The bit for @p voxel_index in word <tt>voxel_index / 64</tt> .
+  static inline uint64_t bit(unsigned voxel_index) { return uint64_t(1u) << (voxel_index % 64u); }
+
+  /// Count the trailing zero bits in a non-zero @p word .
+  /// @param word The word to count trailing zeros in. Must not be zero.
+  /// @return The index of the lowest set bit.
+  static inline unsigned lowestBit(uint64_t word)
+  {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index = 0;
+    _BitScanForward64(&index, word);
+    return unsigned(index);
+#elif defined(__GNUC__) || defined(__clang__)
+    return unsigned(__builtin_ctzll(word));
+#else   // _MSC_VER
+    unsigned index = 0;
+    while (!(word & 1u))
+    {
+      word >>= 1u;
+      ++index;
+    }
+    return index;
+#endif  // _MSC_VER
+  }
+
+  /// Recalculate the summary if @p stamp , @p occupancy_threshold or the @c VoxelBlock::writeCount() of the occupancy
+  /// layer differ from the values used to build the summary.
+  ///
+  /// This is thread safe, but is not safe to call while the chunk occupancy is being modified.
+  ///
+  /// @param chunk The chunk to summarise.
+  /// @param occupancy_layer The index of the occupancy layer in @p chunk .
+  /// @param stamp The @c MapChunk::touched_stamps value for the occupancy layer.
+  /// @param occupancy_threshold The map occupancy threshold value.
+  void sync(const MapChunk &chunk, int occupancy_layer, uint64_t stamp, float occupancy_threshold);
+
+  /// Mark the summary as requiring recalculation.
+  void invalidate();
+
+  /// Query the voxel dimensions of the summarised chunk.
+  /// @return The region voxel dimensions.
+  inline const glm::ivec3 &dimensions() const { return dim_; }
+  /// Query the number of voxels in the summarised chunk.
+  /// @return The voxel count.
+  inline unsigned voxelCount() const { return unsigned(dim_.x * dim_.y * dim_.z); }
+
+  /// Query the occupied voxel bitmask.
+  /// @return The occupied bitmask words.
+  inline const std::vector<uint64_t> &occupiedBits() const { return occupied_bits_; }
+  /// Query the unobserved voxel bitmask.
+  /// @return The unobserved bitmask words.
+  inline const std::vector<uint64_t> &unobservedBits() const { return unobserved_bits_; }
+
+  /// Query whether the voxel at @p voxel_index is occupied.
+  /// @param voxel_index Index of the voxel in the chunk.
+  /// @return True if occupied.
+  inline bool isOccupied(unsigned voxel_index) const
+  {
+    return (occupied_bits_[voxel_index / 64u] & bit(voxel_index)) != 0;
+  }
+  /// Query whether the voxel at @p voxel_index is unobserved.
+  /// @param voxel_index Index of the voxel in the chunk.
+  /// @return True if unobserved.
+  inline bool isUnobserved(unsigned voxel_index) const
+  {
+    return (unobserved_bits_[voxel_index / 64u] & bit(voxel_index)) != 0;
+  }
+
+  /// Query the occupied and unobserved voxel counts for the whole chunk.
+  /// @return The chunk counts.
+  inline const Cell &totals() const { return totals_; }
+
+  /// Query the number of levels in the count pyramid.
+  /// @return The number of levels.
+  inline unsigned levelCount() const { return unsigned(levels_.size()); }
+  /// Query the number of voxels along each axis of a cell at @p level .
+  /// @param level The pyramid level.
+  /// @return The cell voxel size.
+  inline int cellSize(unsigned level) const { return kCellDim << level; }
+  /// Query the number of cells along each axis at @p level .
+  /// @param level The pyramid level.
+  /// @return The number of cells at @p level .
+  glm::ivec3 cellDimensions(unsigned level) const;
+  /// Query the counts for the cell at @p coord in @p level .
+  /// @param level The pyramid level.
+  /// @param coord The cell coordinate in the range <tt>[0, cellDimensions(level))</tt> .
+  /// @return The cell counts.
+  const Cell &cell(unsigned level, const glm::ivec3 &coord) const;
+
+  /// Visit the voxels marked in the occupied and/or unobserved bitmasks in @c voxelIndex() order.
+  /// @param occupied Visit the occupied voxels.
+  /// @param unobserved Visit the unobserved voxels.
+  /// @param func Function invoked with the @c unsigned voxel index of each voxel visited.
+  template <typename Func>
+  void visitVoxels(bool occupied, bool unobserved, Func &&func) const;
+
+private:
+  std::mutex mutex_;
+  std::vector<uint64_t> occupied_bits_;
+  std::vector<uint64_t> unobserved_bits_;
+  std::vector<std::vector<Cell>> levels_;
+  Cell totals_;
+  glm::ivec3 dim_{ 0 };
+  uint64_t stamp_ = 0;
+  unsigned write_count_ = 0;
+  float occupancy_threshold_ = 0;
+  bool valid_ = false;
+};
+
+
+template <typename Func>
+void ChunkOccupancySummary::visitVoxels(bool occupied, bool unobserved, Func &&func) const
+{
+  const uint64_t occupied_mask = (occupied) ? ~uint64_t(0u) : 0u;
+  const uint64_t unobserved_mask = (unobserved) ? ~uint64_t(0u) : 0u;
+  for (size_t i = 0; i < occupied_bits_.size(); ++i)
+  {
+    uint64_t word = (occupied_bits_[i] & occupied_mask) | (unobserved_bits_[i] & unobserved_mask);
+    while (word)
+    {
+      func(unsigned(i * 64u + lowestBit(word)));
+      word &= word - 1u;
+    }
+  }
+}
+}  // namespace ohm
+
+#endif  // OHM_CHUNKOCCUPANCYSUMMARY_H
@@ -5,15 +5,21 @@
 // Author: Kazys Stepanas
 #include "CompareMaps.h"
 
+#include "ForEachRegion.h"
 #include "KeyStream.h"
+#include "MapChunk.h"
 #include "MapLayer.h"
 #include "MapLayout.h"
 #include "OccupancyMap.h"
 #include "VoxelBuffer.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 namespace ohm
@@ -190,149 +196,391 @@ std::string memberValueErrorString(DataType::Type data_type, const void *val_ptr
 }
 
 
-bool compareVoxel(const Key &key, VoxelBuffer<const VoxelBlock> &eval_buffer, VoxelLayoutConst &eval_voxel_layout,
-                  VoxelBuffer<const VoxelBlock> &ref_buffer, VoxelLayoutConst &ref_voxel_layout,
-                  const MapLayer *tolerance, Log log)
+namespace
 {
-  if (!eval_buffer.isValid())
-  {
-    return false;
-  }
+/// Precalculated comparison details for a reference voxel member.
+struct MemberCompare
+{
+  std::string name;
+  DataType::Type type = DataType::kUnknown;
+  size_t ref_offset = 0;
+  size_t eval_offset = 0;
+  size_t size = 0;
+  uint64_t tolerance = 0;
+  bool has_tolerance = false;
+};
+
+
+/// Precalculated comparison details for a pair of voxel layouts. This resolves the member name matching and tolerance
+/// lookup once rather than for every voxel.
+struct VoxelCompare
+{
+  /// Members to compare, in reference layout order.
+  std::vector<MemberCompare> members;
+  /// Voxel byte size for the reference layout.
+  size_t ref_stride = 0;
+  /// Voxel byte size for the evaluation layout.
+  size_t eval_stride = 0;
+  /// True when a reference member is missing from, or has a different type in the eval layout. The comparison fails
+  /// after comparing the preceding @c members .
+  bool incomplete = false;
+  /// True if all @c members can be compared using the region kernels.
+  bool use_kernels = true;
+  /// True if byte equality of a voxel range implies all voxels in the range pass.
+  bool use_bytewise = true;
+};
+
+
+bool isToleranceSupported(DataType::Type type)
+{
+  return DataType::kInt8 <= type && type <= DataType::kDouble;
+}
 
-  if (!ref_buffer.isValid())
-  {
-    return false;
-  }
 
-  bool ok = true;
+VoxelCompare buildVoxelCompare(const VoxelLayoutConst &eval_voxel_layout, const VoxelLayoutConst &ref_voxel_layout,
+                               const MapLayer *tolerance)
+{
+  VoxelCompare compare;
+  compare.ref_stride = ref_voxel_layout.voxelByteSize();
+  compare.eval_stride = eval_voxel_layout.voxelByteSize();
+  compare.use_bytewise = compare.ref_stride == compare.eval_stride;
+
   // Iterate reference members and extract from eval. Note we are not validating mismatches here, only validating the
   // data where we can.
   for (size_t i = 0; i < ref_voxel_layout.memberCount(); ++i)
   {
-    std::string ref_name = ref_voxel_layout.memberName(i);
+    MemberCompare member;
+    member.name = ref_voxel_layout.memberName(i);
 
     size_t eval_member_index{};
+    bool found_member = false;
 
     // Only search if the member at i is the not the same.
-    if (i < eval_voxel_layout.memberCount() && ref_name == eval_voxel_layout.memberName(i))
+    if (i < eval_voxel_layout.memberCount() && member.name == eval_voxel_layout.memberName(i))
     {
       eval_member_index = i;
+      found_member = true;
     }
     else
     {
-      bool found_member = false;
       // Search by name.
       for (size_t j = 0; j < eval_voxel_layout.memberCount(); ++j)
       {
-        if (ref_name == eval_voxel_layout.memberName(j))
+        if (member.name == eval_voxel_layout.memberName(j))
         {
           eval_member_index = j;
           found_member = true;
           break;
         }
       }
-
-      if (!found_member)
-      {
-        return false;
-      }
     }
 
     // Check data type match.
-    if (eval_voxel_layout.memberType(eval_member_index) != ref_voxel_layout.memberType(i))
+    if (!found_member || eval_voxel_layout.memberType(eval_member_index) != ref_voxel_layout.memberType(i))
     {
-      return false;
+      compare.incomplete = true;
+      break;
     }
 
-    // Check value.
-    int tolerance_index = (tolerance) ? tolerance->voxelLayout().indexOf(ref_name.c_str()) : -1;
+    member.type = DataType::Type(ref_voxel_layout.memberType(i));
+    member.ref_offset = ref_voxel_layout.memberOffset(i);
+    member.eval_offset = eval_voxel_layout.memberOffset(eval_member_index);
+    member.size = ref_voxel_layout.memberSize(i);
 
-    bool value_match = true;
+    const int tolerance_index = (tolerance) ? tolerance->voxelLayout().indexOf(member.name.c_str()) : -1;
     if (tolerance_index != -1)
     {
-      // Comparison with tolerance.
-      switch (ref_voxel_layout.memberType(i))
+      member.has_tolerance = true;
+      member.tolerance = tolerance->voxelLayout().memberClearValue(tolerance_index);
+      // Unsupported types log an error for every voxel, so need the per voxel comparison.
+      compare.use_kernels = compare.use_kernels && isToleranceSupported(member.type);
+      // Floating point NaN values fail a tolerance comparison even when the bytes are identical.
+      compare.use_bytewise =
+        compare.use_bytewise && member.type != DataType::kFloat && member.type != DataType::kDouble;
+    }
+
+    compare.use_bytewise = compare.use_bytewise && member.eval_offset == member.ref_offset;
+    compare.members.emplace_back(member);
+  }
+
+  compare.use_kernels = compare.use_kernels && !compare.incomplete;
+  compare.use_bytewise = compare.use_bytewise && compare.use_kernels;
+  return compare;
+}
+
+
+bool compareMember(const MemberCompare &member, const uint8_t *eval_voxel, const uint8_t *ref_voxel)
+{
+  const uint8_t *eval_mem = eval_voxel + member.eval_offset;
+  const uint8_t *ref_mem = ref_voxel + member.ref_offset;
+  if (!member.has_tolerance)
+  {
+    // No tolerance. Raw byte comparison.
+    return std::memcmp(ref_mem, eval_mem, member.size) == 0;
+  }
+
+  // Comparison with tolerance.
+  switch (member.type)
+  {
+  case DataType::kInt8:
+    return compareDatum<int8_t>(eval_mem, ref_mem, member.tolerance);
+  case DataType::kUInt8:
+    return compareDatum<uint8_t>(eval_mem, ref_mem, member.tolerance);
+  case DataType::kInt16:
+    return compareDatum<int16_t>(eval_mem, ref_mem, member.tolerance);
+  case DataType::kUInt16:
+    return compareDatum<uint16_t>(eval_mem, ref_mem, member.tolerance);
+  case DataType::kInt32:
+    return compareDatum<int32_t>(eval_mem, ref_mem, member.tolerance);
+  case DataType::kUInt32:
+    return compareDatum<uint32_t>(eval_mem, ref_mem, member.tolerance);
+  case DataType::kInt64:
+    return compareDatum<int64_t>(eval_mem, ref_mem, member.tolerance);
+  case DataType::kUInt64:
+    return compareDatum<uint64_t>(eval_mem, ref_mem, member.tolerance);
+  case DataType::kFloat:
+    return compareDatum<float>(eval_mem, ref_mem, member.tolerance);
+  case DataType::kDouble:
+    return compareDatum<double>(eval_mem, ref_mem, member.tolerance);
+  default:
+    break;
+  }
+
+  return true;
+}
+
+
+/// Compare a single voxel, logging each member mismatch.
+bool compareVoxelData(const Key &key, const VoxelCompare &compare, const uint8_t *eval_voxel,
+                      const uint8_t *ref_voxel, const Log &log)
+{
+  bool ok = true;
+  for (const MemberCompare &member : compare.members)
+  {
+    if (member.has_tolerance && !isToleranceSupported(member.type))
+    {
+      log(Severity::kError, "Unsupported data tolerance");
+      continue;
+    }
+
+    if (!compareMember(member, eval_voxel, ref_voxel))
+    {
+      ok = false;
+      std::string error_str =
+        memberValueErrorString(member.type, eval_voxel + member.eval_offset, ref_voxel + member.ref_offset);
+      logMessage(log, Severity::kError, "Voxel ", key, " value mismatch on member ", member.name, ": ", error_str);
+    }
+  }
+
+  return ok && !compare.incomplete;
+}
+
+
+/// Tolerance comparison kernel for a member across a range of voxels. The loop avoids early exit and branching so the
+/// compiler may vectorise it.
+template <typename T>
+bool rangeWithinTolerance(const MemberCompare &member, const VoxelCompare &compare, const uint8_t *eval_voxels,
+                          const uint8_t *ref_voxels, unsigned count)
+{
+  bool ok = true;
+  for (unsigned i = 0; i < count; ++i)
+  {
+    ok &= compareDatum<T>(eval_voxels + i * compare.eval_stride + member.eval_offset,
+                          ref_voxels + i * compare.ref_stride + member.ref_offset, member.tolerance);
+  }
+  return ok;
+}
+
+
+/// Raw comparison kernel for a member without tolerance across a range of voxels.
+template <typename T>
+bool rangeEqual(const MemberCompare &member, const VoxelCompare &compare, const uint8_t *eval_voxels,
+                const uint8_t *ref_voxels, unsigned count)
+{
+  bool ok = true;
+  for (unsigned i = 0; i < count; ++i)
+  {
+    T eval{};
+    T ref{};
+    memcpy(&eval, eval_voxels + i * compare.eval_stride + member.eval_offset, sizeof(T));
+    memcpy(&ref, ref_voxels + i * compare.ref_stride + member.ref_offset, sizeof(T));
+    ok &= eval == ref;
+  }
+  return ok;
+}
+
+
+/// Check if all the voxels in a range pass the comparison for all members, without logging.
+bool rangeMatches(const VoxelCompare &compare, const uint8_t *eval_voxels, const uint8_t *ref_voxels, unsigned count)
+{
+  for (const MemberCompare &member : compare.members)
+  {
+    bool ok = true;
+    if (member.has_tolerance)
+    {
+      switch (member.type)
       {
       case DataType::kInt8:
-        value_match = compareDatum<int8_t>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                           ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                           tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<int8_t>(member, compare, eval_voxels, ref_voxels, count);
         break;
       case DataType::kUInt8:
-        value_match = compareDatum<uint8_t>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                            ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                            tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<uint8_t>(member, compare, eval_voxels, ref_voxels, count);
         break;
       case DataType::kInt16:
-        value_match = compareDatum<int16_t>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                            ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                            tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<int16_t>(member, compare, eval_voxels, ref_voxels, count);
         break;
       case DataType::kUInt16:
-        value_match = compareDatum<uint16_t>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                             ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                             tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<uint16_t>(member, compare, eval_voxels, ref_voxels, count);
         break;
       case DataType::kInt32:
-        value_match = compareDatum<int32_t>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                            ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                            tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<int32_t>(member, compare, eval_voxels, ref_voxels, count);
         break;
       case DataType::kUInt32:
-        value_match = compareDatum<uint32_t>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                             ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                             tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<uint32_t>(member, compare, eval_voxels, ref_voxels, count);
         break;
       case DataType::kInt64:
-        value_match = compareDatum<int64_t>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                            ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                            tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<int64_t>(member, compare, eval_voxels, ref_voxels, count);
         break;
       case DataType::kUInt64:
-        value_match = compareDatum<uint64_t>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                             ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                             tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<uint64_t>(member, compare, eval_voxels, ref_voxels, count);
         break;
       case DataType::kFloat:
-        value_match = compareDatum<float>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                          ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                          tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<float>(member, compare, eval_voxels, ref_voxels, count);
         break;
       case DataType::kDouble:
-        value_match = compareDatum<double>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-                                           ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()),
-                                           tolerance->voxelLayout().memberClearValue(tolerance_index));
+        ok = rangeWithinTolerance<double>(member, compare, eval_voxels, ref_voxels, count);
         break;
       default:
-        log(Severity::kError, "Unsupported data tolerance");
         break;
       }
     }
     else
     {
-      // No tolerance. Raw byte comparison.
-      const uint8_t *ref_mem = static_cast<const uint8_t *>(ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()));
-      const uint8_t *eval_mem =
-        static_cast<const uint8_t *>(eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()));
+      // Compare using integer types of matching size to give raw byte comparison semantics.
+      switch (member.size)
+      {
+      case 1:
+        ok = rangeEqual<uint8_t>(member, compare, eval_voxels, ref_voxels, count);
+        break;
+      case 2:
+        ok = rangeEqual<uint16_t>(member, compare, eval_voxels, ref_voxels, count);
+        break;
+      case 4:
+        ok = rangeEqual<uint32_t>(member, compare, eval_voxels, ref_voxels, count);
+        break;
+      case 8:
+        ok = rangeEqual<uint64_t>(member, compare, eval_voxels, ref_voxels, count);
+        break;
+      default:
+        for (unsigned i = 0; ok && i < count; ++i)
+        {
+          ok = compareMember(member, eval_voxels + i * compare.eval_stride, ref_voxels + i * compare.ref_stride);
+        }
+        break;
+      }
+    }
 
-      value_match = std::memcmp(ref_mem, eval_mem, ref_voxel_layout.memberSize(i)) == 0;
+    if (!ok)
+    {
+      return false;
     }
+  }
+
+  return true;
+}
+
+
+/// Comparison results for a single region.
+struct RegionCompareResult
+{
+  size_t voxels_passed = 0;
+  size_t voxels_failed = 0;
+  /// Log messages for the region, deferred so they may be reported in region order when comparing in parallel.
+  std::vector<std::pair<Severity, std::string>> messages;
+};
+
 
-    if (!value_match)
+/// Compare the voxels in a reference map region against the matching eval map region.
+void compareRegion(const RegionVoxels &region, const MapChunk *eval_chunk, int eval_layer_index,
+                   const VoxelCompare &compare, unsigned flags, const Log &log, RegionCompareResult &result)
+{
+  // Start at the first valid voxel to match the voxels visited by the map iterator. As for the iterator, the first
+  // valid key is clamped to the region on each axis, which covers regions with no valid voxels.
+  const glm::ivec3 dims = region.map().regionVoxelDimensions();
+  const glm::u8vec3 first_valid_key = region.chunk().firstValidKey(dims);
+  const unsigned begin = voxelIndex(glm::u8vec3(std::min<int>(first_valid_key.x, dims.x - 1),
+                                                std::min<int>(first_valid_key.y, dims.y - 1),
+                                                std::min<int>(first_valid_key.z, dims.z - 1)),
+                                    dims);
+  const unsigned count = region.end() - begin;
+
+  const VoxelBuffer<const VoxelBlock> &ref_buffer = region.buffer(0);
+  VoxelBuffer<const VoxelBlock> eval_buffer;
+  if (eval_chunk)
+  {
+    eval_buffer = VoxelBuffer<const VoxelBlock>(eval_chunk->voxel_blocks[eval_layer_index]);
+  }
+
+  if (!eval_buffer.isValid() || !ref_buffer.isValid())
+  {
+    // All voxels fail.
+    result.voxels_failed = (flags & kContinue) ? count : 1u;
+    return;
+  }
+
+  const uint8_t *ref_voxels = ref_buffer.voxelMemory() + begin * compare.ref_stride;
+  const uint8_t *eval_voxels = eval_buffer.voxelMemory() + begin * compare.eval_stride;
+
+  // Fast paths: identical bytes, then the member kernels.
+  if ((compare.use_bytewise && std::memcmp(eval_voxels, ref_voxels, count * compare.ref_stride) == 0) ||
+      (compare.use_kernels && rangeMatches(compare, eval_voxels, ref_voxels, count)))
+  {
+    result.voxels_passed = count;
+    return;
+  }
+
+  // Per voxel comparison with logging.
+  for (unsigned i = 0; i < count; ++i)
+  {
+    const Key key = region.key(begin + i);
+    if (compareVoxelData(key, compare, eval_voxels + i * compare.eval_stride, ref_voxels + i * compare.ref_stride,
+                         log))
     {
-      ok = false;
-      std::string error_str = memberValueErrorString(
-        ref_voxel_layout.memberType(i), eval_voxel_layout.memberPtr(eval_member_index, eval_buffer.voxelMemory()),
-        ref_voxel_layout.memberPtr(i, ref_buffer.voxelMemory()));
-      logMessage(log, Severity::kError, "Voxel ", key, " value mismatch on member ", ref_name, ": ", error_str);
+      ++result.voxels_passed;
+    }
+    else
+    {
+      ++result.voxels_failed;
+      if ((flags & kContinue) == 0)
+      {
+        return;
+      }
     }
   }
+}
+}  // namespace
 
-  return ok;
+
+bool compareVoxel(const Key &key, VoxelBuffer<const VoxelBlock> &eval_buffer, VoxelLayoutConst &eval_voxel_layout,
+                  VoxelBuffer<const VoxelBlock> &ref_buffer, VoxelLayoutConst &ref_voxel_layout,
+                  const MapLayer *tolerance, Log log)
+{
+  if (!eval_buffer.isValid())
+  {
+    return false;
+  }
+
+  if (!ref_buffer.isValid())
+  {
+    return false;
+  }
+
+  const VoxelCompare compare = buildVoxelCompare(eval_voxel_layout, ref_voxel_layout, tolerance);
+  return compareVoxelData(key, compare, eval_buffer.voxelMemory(), ref_buffer.voxelMemory(), log);
 }
 
 VoxelsResult compareVoxels(const OccupancyMap &eval_map, const OccupancyMap &ref_map, const std::string &layer_name,
-                           const MapLayer *tolerance, unsigned flags, Log log)
+                           const MapLayer *tolerance, unsigned flags, Log log, unsigned thread_count)
 {
   VoxelsResult result{};
 
@@ -349,37 +597,92 @@ VoxelsResult compareVoxels(const OccupancyMap &eval_map, const OccupancyMap &ref
   // We've compared layers so we know the indices are valid.
   VoxelLayoutConst ref_voxel_layout = ref_map.layout().layer(ref_layer_index).voxelLayout();
   VoxelLayoutConst eval_voxel_layout = eval_map.layout().layer(eval_layer_index).voxelLayout();
-
-  VoxelBuffer<const VoxelBlock> ref_buffer;
-  VoxelBuffer<const VoxelBlock> eval_buffer;
-
-  Key last_key = Key(nullptr);
-  const MapChunk *ref_chunk = nullptr;
-  const MapChunk *eval_chunk = nullptr;
-  for (auto key : ref_map)
+  const VoxelCompare compare = buildVoxelCompare(eval_voxel_layout, ref_voxel_layout, tolerance);
+
+  std::vector<const MapChunk *> ref_chunks;
+  ref_map.enumerateRegions(ref_chunks);
+
+  // Compare batches of regions in parallel. Results and log messages are collated in region order, flushing each region
+  // as soon as all earlier regions are complete. This bounds the deferred log memory and allows early termination. The
+  // serial path logs directly.
+  const bool serial = thread_count == 1;
+  const size_t batch_size = 256;
+  std::vector<const MapChunk *> batch;
+  std::vector<const MapChunk *> eval_chunks;
+  std::vector<RegionCompareResult> region_results;
+  std::vector<uint8_t> region_done;
+  std::mutex flush_mutex;
+  bool stopped = false;
+  for (size_t batch_begin = 0; batch_begin < ref_chunks.size() && !stopped; batch_begin += batch_size)
   {
-    if (last_key.regionKey() != key.regionKey())
+    const size_t batch_end = std::min(batch_begin + batch_size, ref_chunks.size());
+    batch.assign(ref_chunks.begin() + batch_begin, ref_chunks.begin() + batch_end);
+    // Resolve the eval regions up front as the eval map may page regions in.
+    eval_chunks.clear();
+    for (const MapChunk *ref_chunk : batch)
     {
-      // Changed regions. Need to update the voxel buffers.
-      ref_chunk = ref_map.region(key.regionKey());
-      eval_chunk = eval_map.region(key.regionKey());
-
-      ref_buffer = (ref_chunk) ? VoxelBuffer<const VoxelBlock>(ref_chunk->voxel_blocks[ref_layer_index]) :
-                                 VoxelBuffer<const VoxelBlock>();
-      eval_buffer = (eval_chunk) ? VoxelBuffer<const VoxelBlock>(eval_chunk->voxel_blocks[eval_layer_index]) :
-                                   VoxelBuffer<const VoxelBlock>();
+      eval_chunks.emplace_back(eval_map.region(ref_chunk->region.coord));
     }
 
-    if (compareVoxel(key, eval_buffer, eval_voxel_layout, ref_buffer, ref_voxel_layout, tolerance, log))
-    {
-      ++result.voxels_passed;
-    }
-    else
-    {
-      ++result.voxels_failed;
-      OHM_CMP_FAIL(flags, result);
-    }
-    last_key = key;
+    region_results.clear();
+    region_results.resize(batch.size());
+    region_done.assign(batch.size(), 0u);
+    size_t next_flush = 0;
+    // Lowest region index with a failure. Later regions are skipped when stopping on failure.
+    std::atomic<size_t> first_failure{ batch.size() };
+
+    // Report completed regions in order. Must be called with the flush_mutex locked.
+    const auto flush_regions = [&]() {
+      while (next_flush < region_done.size() && region_done[next_flush])
+      {
+        RegionCompareResult &region_result = region_results[next_flush++];
+        if (!stopped)
+        {
+          for (const auto &message : region_result.messages)
+          {
+            log(message.first, message.second);
+          }
+          result.voxels_passed += region_result.voxels_passed;
+          result.voxels_failed += region_result.voxels_failed;
+          stopped = region_result.voxels_failed && (flags & kContinue) == 0;
+        }
+        std::vector<std::pair<Severity, std::string>>().swap(region_result.messages);
+      }
+    };
+
+    forEachRegion(
+      ref_map, batch, { ref_layer_index },
+      [&](const RegionVoxels &region) {
+        const size_t region_index = region.regionIndex();
+        RegionCompareResult &region_result = region_results[region_index];
+        if ((flags & kContinue) != 0 || region_index <= first_failure)
+        {
+          if (serial)
+          {
+            compareRegion(region, eval_chunks[region_index], eval_layer_index, compare, flags, log, region_result);
+          }
+          else
+          {
+            const Log region_log = [&region_result](Severity severity, const std::string &msg) {
+              region_result.messages.emplace_back(severity, msg);
+            };
+            compareRegion(region, eval_chunks[region_index], eval_layer_index, compare, flags, region_log,
+                          region_result);
+          }
+          if (region_result.voxels_failed)
+          {
+            size_t failure = first_failure;
+            while (region_index < failure && !first_failure.compare_exchange_weak(failure, region_index))
+            {
+            }
+          }
+        }
+
+        std::unique_lock<std::mutex> guard(flush_mutex);
+        region_done[region_index] = 1u;
+        flush_regions();
+      },
+      thread_count);
   }
 
   return result;
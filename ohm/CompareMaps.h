@@ -128,6 +128,14 @@ bool ohm_API compareVoxel(const Key &key, VoxelBuffer<const VoxelBlock> &eval_bu
 
 /// Compare the layer content for all voxels in @p ref_map ensuring they exit in, and match in @c eval_map.
 ///
+/// Regions are compared in parallel unless @p thread_count is 1. Each region is first checked using a byte
+/// comparison of the whole layer, then with per member comparisons across the region, only comparing voxel by voxel
+/// for regions which fail these checks. Results and @p log messages are reported in the same order regardless of the
+/// @p thread_count and @p log is never called concurrently.
+///
+/// When comparing in parallel, messages are buffered for each region and reported as soon as all preceding regions
+/// have been reported, so @p log may be called from a worker thread. The serial path logs directly.
+///
 /// @param eval_map The map to evaluate.
 /// @param ref_map The reference map.
 /// @param flags See @c Flag values.
@@ -135,10 +143,11 @@ bool ohm_API compareVoxel(const Key &key, VoxelBuffer<const VoxelBlock> &eval_bu
 /// @param tolerance A dummy @c MapLayer object which wraps the allowed tolerances for differences in voxel member
 /// values. See @c compareVoxel().
 /// @param log Logging function.
+/// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
 /// @return False if any validation step fails.
 VoxelsResult ohm_API compareVoxels(const OccupancyMap &eval_map, const OccupancyMap &ref_map,
                                    const std::string &layer_name, const MapLayer *tolerance = nullptr,
-                                   unsigned flags = 0, Log log = emptyLog);
+                                   unsigned flags = 0, Log log = emptyLog, unsigned thread_count = 0);
 
 
 /// Configure a data tolerance value for @c member_name. The allowed absolute error tolerance is @p epsilon.
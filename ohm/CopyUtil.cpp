@@ -13,21 +13,32 @@
 #include "MapRegionCache.h"
 #include "OccupancyMap.h"
 #include "VoxelBlock.h"
-#include "VoxelBuffer.h"
 
 #include <glm/glm.hpp>
 
-#include <cstring>
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif  // OHM_THREADS
+
+#include <atomic>
+#include <cassert>
+#include <shared_mutex>
 
 namespace
 {
-void copyChunkLayerUnsafe(ohm::MapChunk &dst_chunk, unsigned dst_layer, const ohm::MapChunk &src_chunk,
+/// Copy a voxel layer between chunks. The layers must have the same voxel layout, which holds for the layers matched by
+/// @c MapLayout::calculateOverlappingLayerSet() .
+/// @return True on success, false if the layer sizes differ or the source data cannot be decompressed.
+bool copyChunkLayerUnsafe(ohm::MapChunk &dst_chunk, unsigned dst_layer, const ohm::MapChunk &src_chunk,
                           unsigned src_layer)
 {
-  ohm::VoxelBuffer<ohm::VoxelBlock> dst_buffer(dst_chunk.voxel_blocks[dst_layer]);
-  ohm::VoxelBuffer<const ohm::VoxelBlock> src_buffer(src_chunk.voxel_blocks[src_layer]);
-
-  memcpy(dst_buffer.voxelMemory(), src_buffer.voxelMemory(), src_buffer.voxelMemorySize());
+  ohm::VoxelBlock &dst_block = *dst_chunk.voxel_blocks[dst_layer];
+  ohm::VoxelBlock &src_block = *src_chunk.voxel_blocks[src_layer];
+  // Copy the voxel data as stored, avoiding decompression. This fails on a layer size mismatch rather than copying a
+  // partial layer.
+  return dst_block.copyFrom(src_block);
 }
 }  // namespace
 
@@ -56,7 +67,7 @@ bool canCopy(const OccupancyMap &dst, const OccupancyMap &src)
 }
 
 bool copyMap(OccupancyMap &dst, const OccupancyMap &src, const CopyChunkFilter &copy_chunk_filter,
-             const CopyLayerFilter &copy_layer_filter)
+             const CopyLayerFilter &copy_layer_filter, unsigned thread_count)
 {
   if (!canCopy(dst, src))
   {
@@ -68,9 +79,9 @@ bool copyMap(OccupancyMap &dst, const OccupancyMap &src, const CopyChunkFilter &
   const OccupancyMapDetail &src_detail = *src.detail();
 
   // Lock required mutexes.
-  // We only lock the source map and assume we are the only writers to the dst map. The @c region() call will lock dst
-  // map mutex.
-  std::unique_lock<decltype(src_detail.mutex)> src_guard(src_detail.mutex);
+  // We only lock the source map for read access and assume we are the only writers to the dst map. The @c region()
+  // call will lock the relevant dst map shard.
+  std::shared_lock<const ChunkMap> src_guard(src_detail.chunks);
 
   // First resolve the overlapping layer set. Holds src, dst map layer index pairs.
   std::vector<std::pair<unsigned, unsigned>> layer_overlap;
@@ -113,7 +124,8 @@ bool copyMap(OccupancyMap &dst, const OccupancyMap &src, const CopyChunkFilter &
     std::fill(layer_caches.begin(), layer_caches.end(), nullptr);
   }
 
-  const int tsdf_layer_index = dst_layout.layerIndex(default_layer::tsdfLayerName());
+  // Resolve the included chunks, creating the destination chunks serially.
+  std::vector<std::pair<const MapChunk *, MapChunk *>> chunk_pairs;
   for (const auto &src_iter : src_detail.chunks)
   {
     if (!src_iter.second || (copy_chunk_filter && !copy_chunk_filter(*src_iter.second)))
@@ -122,9 +134,20 @@ bool copyMap(OccupancyMap &dst, const OccupancyMap &src, const CopyChunkFilter &
       continue;
     }
 
-    const MapChunk &src_chunk = *src_iter.second;
-    MapChunk &dst_chunk = *dst.region(src_iter.first, true);
-    assert(&dst_chunk);
+    MapChunk *dst_chunk = dst.region(src_iter.first, true);
+    assert(dst_chunk);
+    chunk_pairs.emplace_back(src_iter.second, dst_chunk);
+  }
+
+  // The layer caches are not threadsafe, so we only copy in parallel without them.
+  const bool use_layer_caches =
+    std::any_of(layer_caches.begin(), layer_caches.end(), [](const MapRegionCache *cache) { return cache != nullptr; });
+
+  const int tsdf_layer_index = dst_layout.layerIndex(default_layer::tsdfLayerName());
+  std::atomic_bool copy_failed{ false };
+  const auto copy_chunk = [&](size_t chunk_index) {
+    const MapChunk &src_chunk = *chunk_pairs[chunk_index].first;
+    MapChunk &dst_chunk = *chunk_pairs[chunk_index].second;
 
     // Included chunk.
     // First try copy via the GPU cache.
@@ -150,7 +173,11 @@ bool copyMap(OccupancyMap &dst, const OccupancyMap &src, const CopyChunkFilter &
       else
       {
         // Layer cache not present or it didn't handle the copy. Use the fallback function.
-        copyChunkLayerUnsafe(dst_chunk, layer_pair.second, src_chunk, layer_pair.first);
+        if (!copyChunkLayerUnsafe(dst_chunk, layer_pair.second, src_chunk, layer_pair.first))
+        {
+          copy_failed = true;
+          continue;
+        }
         // Special case: as in the branch above, but this time we can just copy the first_valid_index from the source
         // chunk as there's no layer cache and we can assume the MapChunk is fully up to date.
         if (update_first_valid)
@@ -159,9 +186,34 @@ bool copyMap(OccupancyMap &dst, const OccupancyMap &src, const CopyChunkFilter &
         }
       }
     }
+  };
+
+#ifdef OHM_THREADS
+  if (thread_count != 1 && !use_layer_caches && chunk_pairs.size() > 1)
+  {
+    tbb::task_arena arena(thread_count ? int(thread_count) : int(tbb::task_arena::automatic));
+    arena.execute([&]() {
+      tbb::parallel_for(tbb::blocked_range<size_t>(0u, chunk_pairs.size()),
+                        [&](const tbb::blocked_range<size_t> &range) {
+                          for (size_t i = range.begin(); i < range.end(); ++i)
+                          {
+                            copy_chunk(i);
+                          }
+                        });
+    });
+    return !copy_failed;
   }
+#else   // OHM_THREADS
+  (void)thread_count;
+  (void)use_layer_caches;
+#endif  // OHM_THREADS
 
-  return true;
-}  // namespace ohm
+  for (size_t i = 0; i < chunk_pairs.size(); ++i)
+  {
+    copy_chunk(i);
+  }
+
+  return !copy_failed;
+}
 
 }  // namespace ohm
@@ -138,6 +138,11 @@ bool ohm_API canCopy(const OccupancyMap &dst, const OccupancyMap &src);
 /// - @c canCopy() must pass.
 /// - The maps must have common map layers matched by name and voxel layout.
 ///
+/// The destination regions are created serially, then the voxel layers are copied region by region in parallel unless
+/// @p thread_count is 1. Layers are copied in their current uniform, compressed or uncompressed state without
+/// decompressing (see @c VoxelBlock::copyFrom() ). The copy is serial when @p src has a GPU cache as the cache is used
+/// to synchronise the layer data.
+///
 /// @note This is not currently threadsafe.
 ///
 /// @param dst The map to copy into.
@@ -145,8 +150,11 @@ bool ohm_API canCopy(const OccupancyMap &dst, const OccupancyMap &src);
 /// @param copy_chunk_filter Optional @c MapChunk filter to apply restricting what is copied.
 /// @param copy_layer_filter Optional filter function for determining which layers are copied from the source map,
 /// provided they exist in the destination map. Only source layers which pass the filter function are copied.
+/// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
+///   Ignored when threading is unavailable.
+/// @return True on success. False if the maps cannot be copied, have no common layers or a layer fails to copy.
 bool ohm_API copyMap(OccupancyMap &dst, const OccupancyMap &src, const CopyChunkFilter &copy_chunk_filter = {},
-                     const CopyLayerFilter &copy_layer_filter = {});
+                     const CopyLayerFilter &copy_layer_filter = {}, unsigned thread_count = 0);
 }  // namespace ohm
 
 #endif  // OHM_COPYUTIL_H
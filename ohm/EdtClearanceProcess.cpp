@@ -0,0 +1,621 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "EdtClearanceProcess.h"
+
+#include "ChunkOccupancySummary.h"
+#include "DefaultLayer.h"
+#include "MapChunk.h"
+#include "MapLayout.h"
+#include "OccupancyMap.h"
+#include "VoxelBlock.h"
+#include "VoxelBuffer.h"
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif  // OHM_THREADS
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace ohm
+{
+namespace
+{
+/// Number of regions to calculate between checking the @c EdtClearanceProcess::update() time slice.
+const size_t kRegionBatchSize = 16;
+
+/// Working memory for calculating the distance transform for a region and its halo.
+struct EdtWorkspace
+{
+  /// Squared (scaled) distance to the nearest obstruction for each voxel in the block.
+  std::vector<double> dist_sqr;
+  /// Block index of the nearest obstruction for each voxel in the block. Negative when there is none.
+  std::vector<int> nearest;
+  /// Lower envelope working memory for a single line.
+  std::vector<double> line_f;
+  std::vector<int> line_nearest;
+  std::vector<int> envelope_sites;
+  std::vector<double> envelope_bounds;
+};
+
+/// Order region keys by z, y, then x.
+inline bool regionKeyLess(const glm::i16vec3 &a, const glm::i16vec3 &b)
+{
+  return a.z < b.z || a.z == b.z && (a.y < b.y || a.y == b.y && a.x < b.x);
+}
+
+
+/// Calculate a value identifying the occupancy input from the @p neighbours around a region.
+///
+/// This combines which neighbours exist with the occupancy layer touched stamp and @c VoxelBlock::writeCount() of each
+/// and the map occupancy threshold. Any change in these values changes the obstructions within the halo.
+///
+/// @param map The map containing the region.
+/// @param neighbours The chunks around the region covering the halo, null where the region does not exist.
+/// @param neighbour_count The number of elements in @p neighbours .
+/// @return A hash of the halo state.
+uint64_t haloState(const OccupancyMap &map, const MapChunk *const *neighbours, size_t neighbour_count)
+{
+  const int occupancy_layer = map.layout().occupancyLayer();
+  uint64_t state = 0;
+  const auto combine = [&state](uint64_t value) {
+    state ^= value + 0x9e3779b97f4a7c15ull + (state << 6u) + (state >> 2u);
+  };
+
+  const float threshold = map.occupancyThresholdValue();
+  uint32_t threshold_bits = 0;
+  std::memcpy(&threshold_bits, &threshold, sizeof(threshold_bits));
+  combine(threshold_bits);
+  for (size_t i = 0; i < neighbour_count; ++i)
+  {
+    if (neighbours[i])
+    {
+      combine(neighbours[i]->touched_stamps[occupancy_layer]);
+      combine(neighbours[i]->voxel_blocks[occupancy_layer]->writeCount());
+    }
+    else
+    {
+      combine(~uint64_t(0u));
+    }
+  }
+  return state;
+}
+
+
+/// Floor division for voxel offsets relative to a region.
+inline int floorDiv(int value, int divisor)
+{
+  return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+
+/// Calculate the 1D distance transform for a line of the block in place.
+///
+/// This calculates the lower envelope of the parabolas rooted at each voxel in the line with a finite distance, then
+/// samples the envelope at each voxel. See Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled Functions".
+/// Voxels are separated by @p scale_sqr squared units along the line.
+///
+/// @param dist_sqr The squared distance values for the block.
+/// @param nearest The nearest obstruction index values for the block.
+/// @param start Block index of the first voxel in the line.
+/// @param stride Block index stride between voxels in the line.
+/// @param count Number of voxels in the line.
+/// @param scale_sqr Squared distance between adjacent voxels in the line.
+/// @param workspace Working memory.
+void edtLine(double *dist_sqr, int *nearest, size_t start, size_t stride, int count, double scale_sqr,
+             EdtWorkspace &workspace)
+{
+  const double inf = std::numeric_limits<double>::infinity();
+  double *f = workspace.line_f.data();
+  int *line_nearest = workspace.line_nearest.data();
+  int *v = workspace.envelope_sites.data();
+  double *z = workspace.envelope_bounds.data();
+
+  // Gather the line and build the lower envelope from the finite sites.
+  int k = -1;
+  for (int q = 0; q < count; ++q)
+  {
+    const size_t index = start + size_t(q) * stride;
+    f[q] = dist_sqr[index];
+    line_nearest[q] = nearest[index];
+    if (f[q] == inf)
+    {
+      continue;
+    }
+
+    if (k < 0)
+    {
+      k = 0;
+      v[0] = q;
+      z[0] = -inf;
+      z[1] = inf;
+      continue;
+    }
+
+    double s;
+    do
+    {
+      const int p = v[k];
+      s = ((f[q] + scale_sqr * q * q) - (f[p] + scale_sqr * p * p)) / (2.0 * scale_sqr * (q - p));
+    } while (s <= z[k] && --k >= 0);
+
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = inf;
+  }
+
+  if (k < 0)
+  {
+    // No obstructions along the line. Nothing to change.
+    return;
+  }
+
+  // Sample the envelope.
+  int j = 0;
+  for (int q = 0; q < count; ++q)
+  {
+    while (z[j + 1] < q)
+    {
+      ++j;
+    }
+    const int p = v[j];
+    const size_t index = start + size_t(q) * stride;
+    dist_sqr[index] = scale_sqr * (q - p) * (q - p) + f[p];
+    nearest[index] = line_nearest[p];
+  }
+}
+
+
+/// Calculate and write the clearance values for the region at the centre of @p neighbours .
+/// @param map The target map.
+/// @param chunk The chunk to write clearance values to.
+/// @param neighbours The chunks around @p chunk covering the halo, null where the region does not exist.
+/// @param region_halo The number of regions in @p neighbours either side of @p chunk along each axis.
+/// @param halo The number of voxels gathered around the region along each axis.
+/// @param search_radius The clearance search radius.
+/// @param axis_scaling The per axis distance scaling.
+/// @param query_flags The @c QueryFlag values.
+/// @param workspace Working memory.
+void calculateRegion(const OccupancyMap &map, MapChunk &chunk, const MapChunk *const *neighbours,
+                     const glm::ivec3 &region_halo, const glm::ivec3 &halo, float search_radius,
+                     const glm::vec3 &axis_scaling, unsigned query_flags, EdtWorkspace &workspace)
+{
+  const bool unknown_as_occupied = (query_flags & kQfUnknownAsOccupied) != 0;
+  const bool report_unscaled = (query_flags & kQfReportUnscaledResults) != 0;
+  const glm::ivec3 dim = map.regionVoxelDimensions();
+  const glm::ivec3 block = dim + 2 * halo;
+  const glm::ivec3 neighbourhood = 2 * region_halo + glm::ivec3(1);
+  const size_t block_volume = size_t(block.x) * size_t(block.y) * size_t(block.z);
+  const double inf = std::numeric_limits<double>::infinity();
+
+  workspace.dist_sqr.resize(block_volume);
+  workspace.nearest.resize(block_volume);
+  const int max_line = std::max(block.x, std::max(block.y, block.z));
+  workspace.line_f.resize(size_t(max_line));
+  workspace.line_nearest.resize(size_t(max_line));
+  workspace.envelope_sites.resize(size_t(max_line));
+  workspace.envelope_bounds.resize(size_t(max_line) + 1);
+
+  // Resolve the summaries here as they may be recalculated.
+  std::vector<const ChunkOccupancySummary *> summaries(size_t(neighbourhood.x * neighbourhood.y * neighbourhood.z));
+  for (size_t i = 0; i < summaries.size(); ++i)
+  {
+    summaries[i] = (neighbours[i]) ? neighbours[i]->occupancySummary() : nullptr;
+  }
+
+  // Gather the obstructions for the block.
+  size_t block_index = 0;
+  for (int z = 0; z < block.z; ++z)
+  {
+    const int rz = floorDiv(z - halo.z, dim.z);
+    const int lz = z - halo.z - rz * dim.z;
+    for (int y = 0; y < block.y; ++y)
+    {
+      const int ry = floorDiv(y - halo.y, dim.y);
+      const int ly = y - halo.y - ry * dim.y;
+      for (int x = 0; x < block.x; ++x, ++block_index)
+      {
+        const int rx = floorDiv(x - halo.x, dim.x);
+        const int lx = x - halo.x - rx * dim.x;
+        const ChunkOccupancySummary *summary =
+          summaries[size_t((rx + region_halo.x) +
+                           neighbourhood.x * ((ry + region_halo.y) + neighbourhood.y * (rz + region_halo.z)))];
+        bool obstruction = unknown_as_occupied;
+        if (summary)
+        {
+          const unsigned voxel_index = voxelIndex(unsigned(lx), unsigned(ly), unsigned(lz), dim.x, dim.y, dim.z);
+          obstruction =
+            summary->isOccupied(voxel_index) || unknown_as_occupied && summary->isUnobserved(voxel_index);
+        }
+        workspace.dist_sqr[block_index] = (obstruction) ? 0.0 : inf;
+        workspace.nearest[block_index] = (obstruction) ? int(block_index) : -1;
+      }
+    }
+  }
+
+  // Run the distance transform along each axis.
+  const double resolution = map.resolution();
+  const glm::dvec3 scale_sqr = glm::max(glm::dvec3(axis_scaling) * glm::dvec3(axis_scaling) * resolution * resolution,
+                                        glm::dvec3(std::numeric_limits<double>::min()));
+  double *dist_sqr = workspace.dist_sqr.data();
+  int *nearest = workspace.nearest.data();
+  const size_t stride_y = size_t(block.x);
+  const size_t stride_z = size_t(block.x) * size_t(block.y);
+  for (int z = 0; z < block.z; ++z)
+  {
+    for (int y = 0; y < block.y; ++y)
+    {
+      edtLine(dist_sqr, nearest, size_t(z) * stride_z + size_t(y) * stride_y, 1, block.x, scale_sqr.x, workspace);
+    }
+  }
+  for (int z = 0; z < block.z; ++z)
+  {
+    for (int x = 0; x < block.x; ++x)
+    {
+      edtLine(dist_sqr, nearest, size_t(z) * stride_z + size_t(x), stride_y, block.y, scale_sqr.y, workspace);
+    }
+  }
+  // Only the lines through the region are needed for the final pass.
+  for (int y = halo.y; y < halo.y + dim.y; ++y)
+  {
+    for (int x = halo.x; x < halo.x + dim.x; ++x)
+    {
+      edtLine(dist_sqr, nearest, size_t(y) * stride_y + size_t(x), stride_z, block.z, scale_sqr.z, workspace);
+    }
+  }
+
+  // Write the results for the region.
+  VoxelBuffer<VoxelBlock> clearance_buffer(chunk.voxel_blocks[map.layout().clearanceLayer()]);
+  const double search_radius_sqr = double(search_radius) * double(search_radius);
+  unsigned voxel_index = 0;
+  for (int z = 0; z < dim.z; ++z)
+  {
+    for (int y = 0; y < dim.y; ++y)
+    {
+      for (int x = 0; x < dim.x; ++x, ++voxel_index)
+      {
+        const size_t index = size_t(z + halo.z) * stride_z + size_t(y + halo.y) * stride_y + size_t(x + halo.x);
+        float range = -1.0f;
+        if (nearest[index] >= 0)
+        {
+          const size_t obstruction = size_t(nearest[index]);
+          const glm::dvec3 separation =
+            resolution * glm::dvec3(int(obstruction % stride_y) - (x + halo.x),
+                                    int((obstruction % stride_z) / stride_y) - (y + halo.y),
+                                    int(obstruction / stride_z) - (z + halo.z));
+          const glm::dvec3 scaled_separation = separation * glm::dvec3(axis_scaling);
+          const double range_sqr = (report_unscaled) ? glm::dot(separation, separation) :
+                                                       glm::dot(scaled_separation, scaled_separation);
+          if (range_sqr <= search_radius_sqr)
+          {
+            range = float(std::sqrt(range_sqr));
+          }
+        }
+        clearance_buffer.writeVoxel(voxel_index, range);
+      }
+    }
+  }
+}
+}  // namespace
+
+
+EdtClearanceProcess::EdtClearanceProcess() = default;
+
+
+EdtClearanceProcess::EdtClearanceProcess(float search_radius, unsigned query_flags)
+  : search_radius_(search_radius)
+  , query_flags_(query_flags)
+{}
+
+
+EdtClearanceProcess::~EdtClearanceProcess() = default;
+
+
+void EdtClearanceProcess::setSearchRadius(float range)
+{
+  search_radius_ = range;
+  force_ = true;
+}
+
+
+void EdtClearanceProcess::setQueryFlags(unsigned flags)
+{
+  query_flags_ = flags;
+  force_ = true;
+}
+
+
+void EdtClearanceProcess::setAxisScaling(const glm::vec3 &scaling)
+{
+  axis_scaling_ = scaling;
+  force_ = true;
+}
+
+
+bool EdtClearanceProcess::setThreadCount(unsigned thread_count)
+{
+#ifdef OHM_THREADS
+  thread_count_ = thread_count;
+  return true;
+#else   // OHM_THREADS
+  (void)thread_count;
+  thread_count_ = 1;
+  return false;
+#endif  // OHM_THREADS
+}
+
+
+void EdtClearanceProcess::reset()
+{
+  force_ = true;
+}
+
+
+int EdtClearanceProcess::update(OccupancyMap &map, double time_slice)
+{
+  ensureClearanceLayer(map);
+  if (force_)
+  {
+    // Regions with clearance values calculated before now are out of date.
+    min_stamp_ = map.touch();
+    halo_states_.clear();
+    force_ = false;
+  }
+
+  using Clock = std::chrono::high_resolution_clock;
+  const auto start_time = Clock::now();
+
+  std::vector<const MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  std::vector<glm::i16vec3> region_keys;
+  region_keys.reserve(chunks.size());
+  for (const MapChunk *chunk : chunks)
+  {
+    region_keys.emplace_back(chunk->region.coord);
+  }
+
+  // Process in a consistent order.
+  std::sort(region_keys.begin(), region_keys.end(), regionKeyLess);
+  pruneHaloStates(region_keys);
+  collectStale(map, region_keys, false);
+
+  size_t processed = 0;
+  while (processed < region_keys.size())
+  {
+    const size_t batch_end = std::min(region_keys.size(), processed + kRegionBatchSize);
+    calculateRegions(map, std::vector<glm::i16vec3>(region_keys.begin() + processed, region_keys.begin() + batch_end));
+    processed = batch_end;
+
+    const double elapsed_sec =
+      std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - start_time).count();
+    if (time_slice > 0 && elapsed_sec >= time_slice)
+    {
+      break;
+    }
+  }
+
+  return (processed < region_keys.size()) ? kMprProgressing : kMprUpToDate;
+}
+
+
+void EdtClearanceProcess::calculateForExtents(OccupancyMap &map, const glm::dvec3 &min_extents,
+                                              const glm::dvec3 &max_extents, bool force)
+{
+  ensureClearanceLayer(map);
+  if (force_)
+  {
+    min_stamp_ = map.touch();
+    halo_states_.clear();
+    force_ = false;
+  }
+
+  const glm::i16vec3 min_region = map.regionKey(min_extents);
+  const glm::i16vec3 max_region = map.regionKey(max_extents);
+
+  std::vector<glm::i16vec3> region_keys;
+  for (int z = min_region.z; z <= max_region.z; ++z)
+  {
+    for (int y = min_region.y; y <= max_region.y; ++y)
+    {
+      for (int x = min_region.x; x <= max_region.x; ++x)
+      {
+        region_keys.emplace_back(glm::i16vec3(x, y, z));
+      }
+    }
+  }
+
+  collectStale(map, region_keys, force);
+  calculateRegions(map, region_keys);
+}
+
+
+void EdtClearanceProcess::ensureClearanceLayer(OccupancyMap &map)
+{
+  if (map.layout().clearanceLayer() != -1)
+  {
+    return;
+  }
+
+  // Duplicate the layout, add the layer and update the map, preserving the current map.
+  MapLayout updated_layout(map.layout());
+  addClearance(updated_layout);
+  map.updateLayout(updated_layout, true);
+}
+
+
+glm::ivec3 EdtClearanceProcess::haloVoxels(const OccupancyMap &map) const
+{
+  // Cover the brute force search cube, extending it along axes with a scaling below 1 to cover the scaled radius.
+  glm::ivec3 halo;
+  for (int i = 0; i < 3; ++i)
+  {
+    const double scale = std::abs(double(axis_scaling_[i]));
+    const double axis_scale = (scale > 0 && scale < 1) ? scale : 1.0;
+    halo[i] = int(std::ceil(std::max(0.0, double(search_radius_)) / (map.resolution() * axis_scale)));
+  }
+  return halo;
+}
+
+
+void EdtClearanceProcess::collectStale(const OccupancyMap &map, std::vector<glm::i16vec3> &region_keys,
+                                       bool force) const
+{
+  const int occupancy_layer = map.layout().occupancyLayer();
+  const int clearance_layer = map.layout().clearanceLayer();
+  if (occupancy_layer < 0 || clearance_layer < 0)
+  {
+    region_keys.clear();
+    return;
+  }
+
+  const glm::ivec3 dim = map.regionVoxelDimensions();
+  const glm::ivec3 region_halo = (haloVoxels(map) + dim - glm::ivec3(1)) / dim;
+  std::vector<const MapChunk *> neighbours;
+
+  const auto is_stale = [&](const glm::i16vec3 &region_key) {
+    const MapChunk *chunk = map.region(region_key);
+    if (!chunk)
+    {
+      // Nothing to write to.
+      return false;
+    }
+
+    if (force)
+    {
+      return true;
+    }
+
+    const auto recorded_state = halo_states_.find(region_key);
+    if (chunk->touched_stamps[clearance_layer] < min_stamp_ || recorded_state == halo_states_.end())
+    {
+      // Never calculated, or calculated with different search parameters.
+      return true;
+    }
+
+    // The region is stale if the occupancy input from any region in the halo has changed since the clearance values
+    // were calculated, including regions which have been added or removed.
+    neighbours.clear();
+    for (int z = -region_halo.z; z <= region_halo.z; ++z)
+    {
+      for (int y = -region_halo.y; y <= region_halo.y; ++y)
+      {
+        for (int x = -region_halo.x; x <= region_halo.x; ++x)
+        {
+          neighbours.emplace_back(map.region(glm::i16vec3(region_key) + glm::i16vec3(x, y, z)));
+        }
+      }
+    }
+    return haloState(map, neighbours.data(), neighbours.size()) != recorded_state->second;
+  };
+
+  region_keys.erase(std::remove_if(region_keys.begin(), region_keys.end(),
+                                   [&is_stale](const glm::i16vec3 &region_key) { return !is_stale(region_key); }),
+                    region_keys.end());
+}
+
+
+void EdtClearanceProcess::pruneHaloStates(const std::vector<glm::i16vec3> &region_keys)
+{
+  for (auto iter = halo_states_.begin(); iter != halo_states_.end();)
+  {
+    if (!std::binary_search(region_keys.begin(), region_keys.end(), iter->first, regionKeyLess))
+    {
+      iter = halo_states_.erase(iter);
+    }
+    else
+    {
+      ++iter;
+    }
+  }
+}
+
+
+void EdtClearanceProcess::calculateRegions(OccupancyMap &map, const std::vector<glm::i16vec3> &region_keys)
+{
+  if (region_keys.empty() || map.layout().occupancyLayer() < 0 || map.layout().clearanceLayer() < 0)
+  {
+    return;
+  }
+
+  const glm::ivec3 dim = map.regionVoxelDimensions();
+  const glm::ivec3 halo = haloVoxels(map);
+  const glm::ivec3 region_halo = (halo + dim - glm::ivec3(1)) / dim;
+  const glm::ivec3 neighbourhood = 2 * region_halo + glm::ivec3(1);
+  const size_t neighbourhood_volume = size_t(neighbourhood.x) * size_t(neighbourhood.y) * size_t(neighbourhood.z);
+
+  // Resolve the chunks up front as region lookup may page regions in.
+  std::vector<MapChunk *> chunks(region_keys.size());
+  std::vector<const MapChunk *> neighbours(region_keys.size() * neighbourhood_volume);
+  for (size_t i = 0; i < region_keys.size(); ++i)
+  {
+    chunks[i] = map.region(region_keys[i]);
+    size_t neighbour_index = i * neighbourhood_volume;
+    for (int z = -region_halo.z; z <= region_halo.z; ++z)
+    {
+      for (int y = -region_halo.y; y <= region_halo.y; ++y)
+      {
+        for (int x = -region_halo.x; x <= region_halo.x; ++x)
+        {
+          neighbours[neighbour_index++] = map.region(glm::i16vec3(region_keys[i]) + glm::i16vec3(x, y, z));
+        }
+      }
+    }
+  }
+
+  // Record the halo state used for each region. The occupancy is not modified while calculating.
+  for (size_t i = 0; i < region_keys.size(); ++i)
+  {
+    if (chunks[i])
+    {
+      halo_states_[region_keys[i]] = haloState(map, neighbours.data() + i * neighbourhood_volume, neighbourhood_volume);
+    }
+  }
+
+  const int clearance_layer = map.layout().clearanceLayer();
+  const uint64_t stamp = map.touch();
+  const auto calculate = [&](size_t i, EdtWorkspace &workspace) {
+    if (chunks[i])
+    {
+      calculateRegion(map, *chunks[i], neighbours.data() + i * neighbourhood_volume, region_halo, halo, search_radius_,
+                      axis_scaling_, query_flags_, workspace);
+      chunks[i]->markDirty(stamp);
+      chunks[i]->touched_stamps[clearance_layer].store(stamp, std::memory_order_relaxed);
+    }
+  };
+
+#ifdef OHM_THREADS
+  if (thread_count_ != 1 && region_keys.size() > 1)
+  {
+    tbb::enumerable_thread_specific<EdtWorkspace> workspaces;
+    tbb::task_arena arena(thread_count_ ? int(thread_count_) : int(tbb::task_arena::automatic));
+    arena.execute([&]() {
+      tbb::parallel_for(tbb::blocked_range<size_t>(0u, region_keys.size()),
+                        [&](const tbb::blocked_range<size_t> &range) {
+                          EdtWorkspace &workspace = workspaces.local();
+                          for (size_t i = range.begin(); i < range.end(); ++i)
+                          {
+                            calculate(i, workspace);
+                          }
+                        });
+    });
+    return;
+  }
+#endif  // OHM_THREADS
+
+  EdtWorkspace workspace;
+  for (size_t i = 0; i < region_keys.size(); ++i)
+  {
+    calculate(i, workspace);
+  }
+}
+}  // namespace ohm
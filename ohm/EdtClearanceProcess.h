@@ -0,0 +1,166 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_EDTCLEARANCEPROCESS_H
+#define OHM_EDTCLEARANCEPROCESS_H
+
+#include "OhmConfig.h"
+
+#include "MapRegion.h"
+#include "MappingProcess.h"
+#include "QueryFlag.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ohm
+{
+class OccupancyMap;
+
+/// A CPU implementation for calculating the clearance layer values using an exact Euclidean distance transform (EDT).
+///
+/// For each voxel in each processed region, the range to the nearest obstructed voxel is calculated and written to the
+/// @c MapLayout::clearanceLayer() . Obstructed voxels are the occupied voxels as well as unobserved voxels when
+/// @c kQfUnknownAsOccupied is set. The results use the same semantics as the @c ClearanceProcess in @c ohmgpu :
+/// - 0.0 => The voxel in question is itself an obstruction.
+/// - > 0 => There is an obstructed voxel within the @c searchRadius().
+/// - < 0 => There are no obstructions within the @c searchRadius().
+///
+/// Each region is processed by gathering the obstructions from the region and a halo of voxels from its neighbouring
+/// regions, large enough to contain any obstruction within the @c searchRadius() , then running a separable, exact
+/// EDT (Felzenszwalb and Huttenlocher) over the gathered block. The distance transform runs one pass per axis, with
+/// each pass weighted by the @c axisScaling() for that axis and each voxel tracking its nearest obstruction. The
+/// cost is linear in the number of voxels in the block, as opposed to the brute force search of
+/// @c calculateNearestNeighbour() which scales with the cube of the search radius. Obstructions are read from the
+/// @c MapChunk::occupancySummary() of each region.
+///
+/// Regions are processed in parallel when a @c threadCount() other than 1 is set. Each region writes only its own
+/// clearance values, so the results do not depend on the number of threads.
+///
+/// The results match the brute force search except as follows:
+/// - Where @c axisScaling() is less than 1 for an axis, the halo is extended to cover the full scaled search radius,
+///   which may find obstructions outside the search cube of @c calculateNearestNeighbour() .
+/// - With @c kQfReportUnscaledResults , the nearest obstruction is selected by the scaled range before checking the
+///   unscaled range against the search radius.
+/// - Ties between equidistant obstructions may resolve to a different voxel. This only affects the reported range
+///   with @c kQfReportUnscaledResults .
+///
+/// Both @c update() and @c calculateForExtents() support incremental updates: a region is only recalculated when the
+/// occupancy input from its halo has changed since the region clearance values were last calculated. The process
+/// records the state of the halo for each calculated region, covering which neighbouring regions exist, their
+/// occupancy layer @c MapChunk::touched_stamps and @c VoxelBlock::writeCount() , and the map occupancy threshold. A
+/// region is recalculated when any of these change, including when a neighbouring region is added or removed.
+/// Modifying the search parameters forces recalculation of all regions on the next update.
+class ohm_API EdtClearanceProcess : public MappingProcess
+{
+public:
+  /// Empty constructor.
+  EdtClearanceProcess();
+
+  /// Construct a new process using the given parameters.
+  /// @param search_radius Defines the search radius around each voxel.
+  /// @param query_flags Flags controlling the process behaviour. See @c QueryFlag .
+  EdtClearanceProcess(float search_radius, unsigned query_flags);
+
+  /// Destructor.
+  ~EdtClearanceProcess() override;
+
+  /// Get the search radius to which we look for obstructing voxels.
+  /// @return The radius to look for obstacles within.
+  float searchRadius() const { return search_radius_; }
+  /// Set the search radius to which we look for obstructing voxels.
+  /// @param range The new search radius.
+  void setSearchRadius(float range);
+
+  /// The @c QueryFlag values applied to the process.
+  /// @return The value values.
+  unsigned queryFlags() const { return query_flags_; }
+  /// Set the @c QueryFlag values for the process. Supports @c kQfUnknownAsOccupied and @c kQfReportUnscaledResults .
+  /// @param flags The flag values to set.
+  void setQueryFlags(unsigned flags);
+
+  /// Get the axis weightings applied when determining the nearest obstructing voxel.
+  /// @return Current axis weighting.
+  /// @see @c ClearanceProcess::setAxisScaling()
+  glm::vec3 axisScaling() const { return axis_scaling_; }
+  /// Set the per axis scaling applied when determining the closest obstructing voxel. This has the same semantics as
+  /// @c ClearanceProcess::setAxisScaling() .
+  /// @param scaling The new axis scaling to apply.
+  void setAxisScaling(const glm::vec3 &scaling);
+
+  /// Set the number of threads used to calculate the clearance values of the stale regions in an update.
+  ///
+  /// Each region's distance transform is independent once its halo has been gathered, so regions are distributed
+  /// across the threads with a workspace per thread. Zero uses the TBB default thread count, while 1 (default)
+  /// calculates the regions on the calling thread. Threads are only used when more than one region is stale.
+  ///
+  /// @param thread_count The number of calculation threads.
+  /// @return True if threading is available. False when ohm is built without threads, leaving the thread count at 1.
+  bool setThreadCount(unsigned thread_count);
+
+  /// Get the number of calculation threads. See @c setThreadCount() .
+  /// @return The thread count: zero for the TBB default, 1 when single threaded.
+  unsigned threadCount() const { return thread_count_; }
+
+  /// Force recalculation of all regions on the next update.
+  void reset() override;
+
+  /// Update the clearance values for all regions which are out of date, processing regions until @p time_slice is
+  /// exceeded.
+  /// @param map The map to update.
+  /// @param time_slice Time processing limit for the update (seconds). Zero or negative for no limit.
+  /// @return @c kMprUpToDate when all regions are up to date, @c kMprProgressing when more remain.
+  int update(OccupancyMap &map, double time_slice) override;
+
+  /// Calculate the clearance values for all existing regions overlapping the given extents.
+  /// @param map The map to update.
+  /// @param min_extents The minimum spatial extents to update.
+  /// @param max_extents The maximum spatial extents to update.
+  /// @param force Force recalculation of all regions in the extents, even if they are up to date.
+  void calculateForExtents(OccupancyMap &map, const glm::dvec3 &min_extents, const glm::dvec3 &max_extents,
+                           bool force = true);
+
+  /// Ensure the mapping clearance layer is present in @p map .
+  /// @param map The map to ensure has a clearance layer.
+  static void ensureClearanceLayer(OccupancyMap &map);
+
+private:
+  /// Calculate the voxel halo gathered around each region along each axis.
+  /// @param map The target map.
+  /// @return The halo size in voxels.
+  glm::ivec3 haloVoxels(const OccupancyMap &map) const;
+
+  /// Remove the regions from @p region_keys which do not exist or do not require an update.
+  /// @param map The target map.
+  /// @param region_keys The candidate regions.
+  /// @param force True to keep all existing regions.
+  void collectStale(const OccupancyMap &map, std::vector<glm::i16vec3> &region_keys, bool force) const;
+
+  /// Forget the recorded halo state for regions which are not in the sorted @p region_keys .
+  /// @param region_keys The sorted keys of all regions in the map.
+  void pruneHaloStates(const std::vector<glm::i16vec3> &region_keys);
+
+  /// Calculate the clearance values for the given regions.
+  /// @param map The target map.
+  /// @param region_keys The regions to calculate.
+  void calculateRegions(OccupancyMap &map, const std::vector<glm::i16vec3> &region_keys);
+
+  glm::vec3 axis_scaling_{ 1.0f };
+  float search_radius_ = 0;
+  unsigned query_flags_ = 0;
+  unsigned thread_count_ = 1;
+  /// Clearance values calculated before this stamp are out of date. Set when the search parameters change.
+  uint64_t min_stamp_ = 0;
+  /// State of the halo inputs when the clearance values for each region were last calculated. See @c haloState() in
+  /// the implementation.
+  std::unordered_map<glm::i16vec3, uint64_t, MapRegion::Hash> halo_states_;
+  bool force_ = true;
+};
+}  // namespace ohm
+
+#endif  // OHM_EDTCLEARANCEPROCESS_H
@@ -0,0 +1,136 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "ForEachRegion.h"
+
+#include "MapChunk.h"
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif  // OHM_THREADS
+
+#include <algorithm>
+
+namespace ohm
+{
+namespace
+{
+/// A contiguous range of voxels in a region to visit.
+struct VisitItem
+{
+  size_t region_index;
+  unsigned begin;
+  unsigned end;
+};
+
+
+void visitItems(const OccupancyMap &map, const std::vector<const MapChunk *> &chunks,
+                const std::vector<VisitItem> &items, const std::vector<int> &layers, const RegionVisitFunction &func,
+                unsigned thread_count)
+{
+  const auto visit = [&](const VisitItem &item) {
+    const RegionVoxels region(map, *chunks[item.region_index], item.region_index, layers, item.begin, item.end);
+    func(region);
+  };
+
+#ifdef OHM_THREADS
+  if (thread_count != 1 && items.size() > 1)
+  {
+    tbb::task_arena arena(thread_count ? int(thread_count) : int(tbb::task_arena::automatic));
+    arena.execute([&]() {
+      tbb::parallel_for(tbb::blocked_range<size_t>(0u, items.size()), [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); ++i)
+        {
+          visit(items[i]);
+        }
+      });
+    });
+    return;
+  }
+#else   // OHM_THREADS
+  (void)thread_count;
+#endif  // OHM_THREADS
+
+  for (const VisitItem &item : items)
+  {
+    visit(item);
+  }
+}
+}  // namespace
+
+
+RegionVoxels::RegionVoxels(const OccupancyMap &map, const MapChunk &chunk, size_t region_index,
+                           const std::vector<int> &layers, unsigned begin, unsigned end)
+  : map_(&map)
+  , chunk_(&chunk)
+  , region_index_(region_index)
+  , begin_(begin)
+  , end_(end)
+{
+  buffers_.reserve(layers.size());
+  for (int layer : layers)
+  {
+    if (layer >= 0 && size_t(layer) < chunk.voxel_blocks.size())
+    {
+      buffers_.emplace_back(chunk.voxel_blocks[layer]);
+    }
+    else
+    {
+      buffers_.emplace_back();
+    }
+  }
+}
+
+
+Key RegionVoxels::key(unsigned voxel_index) const
+{
+  return chunk_->keyForIndex(voxel_index, map_->regionVoxelDimensions());
+}
+
+
+void forEachRegion(const OccupancyMap &map, const std::vector<const MapChunk *> &chunks,
+                   const std::vector<int> &layers, const RegionVisitFunction &func, unsigned thread_count)
+{
+  const auto voxel_count = unsigned(map.regionVoxelVolume());
+  std::vector<VisitItem> items(chunks.size());
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    items[i] = VisitItem{ i, 0u, voxel_count };
+  }
+  visitItems(map, chunks, items, layers, func, thread_count);
+}
+
+
+void forEachRegion(const OccupancyMap &map, const std::vector<int> &layers, const RegionVisitFunction &func,
+                   unsigned thread_count)
+{
+  std::vector<const MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  forEachRegion(map, chunks, layers, func, thread_count);
+}
+
+
+void forEachVoxelRange(const OccupancyMap &map, const std::vector<int> &layers, const RegionVisitFunction &func,
+                       unsigned thread_count, unsigned voxel_grain)
+{
+  std::vector<const MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+
+  const auto voxel_count = unsigned(map.regionVoxelVolume());
+  const unsigned grain = (voxel_grain) ? std::min(voxel_grain, voxel_count) : voxel_count;
+  std::vector<VisitItem> items;
+  items.reserve(chunks.size() * ((voxel_count + grain - 1) / std::max(grain, 1u)));
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    for (unsigned begin = 0; begin < voxel_count; begin += grain)
+    {
+      items.emplace_back(VisitItem{ i, begin, std::min(begin + grain, voxel_count) });
+    }
+  }
+  visitItems(map, chunks, items, layers, func, thread_count);
+}
+}  // namespace ohm
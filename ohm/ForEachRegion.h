@@ -0,0 +1,197 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_FOREACHREGION_H
+#define OHM_FOREACHREGION_H
+
+#include "OhmConfig.h"
+
+#include "Key.h"
+#include "OccupancyMap.h"
+#include "VoxelBlock.h"
+#include "VoxelBuffer.h"
+
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ohm
+{
+struct MapChunk;
+
+/// Voxel data access for a contiguous range of voxels in a single region, as passed to the visit functions of
+/// @c forEachRegion() , @c forEachVoxelRange() , @c parallelForEachVoxel() and @c reduceRegions() .
+///
+/// The object holds a retained @c VoxelBuffer for each layer requested of the visit function, in request order, so
+/// voxel data may be read directly by voxel index rather than resolving a @c Voxel for each @c Key . Voxel indices
+/// lie in the range <tt>[begin(), end())</tt> and match @c MapChunk::keyForIndex() for the map region dimensions.
+/// Layers which are not present in the map - a layer index of -1 - yield invalid buffers and null @c voxels() .
+///
+/// Voxel indexing assumes the requested layers are not subsampled.
+class ohm_API RegionVoxels
+{
+public:
+  /// Constructor, retaining the voxel buffers for @p layers of @p chunk .
+  /// @param map The map being visited.
+  /// @param chunk The region being visited.
+  /// @param region_index Index of the region in the visited region set.
+  /// @param layers The map layer indices to retain buffers for. May contain -1 for missing layers.
+  /// @param begin The first voxel index of the range to visit.
+  /// @param end The voxel index after the last voxel in the range to visit.
+  RegionVoxels(const OccupancyMap &map, const MapChunk &chunk, size_t region_index, const std::vector<int> &layers,
+               unsigned begin, unsigned end);
+
+  /// Query the map being visited.
+  /// @return The visited map.
+  inline const OccupancyMap &map() const { return *map_; }
+  /// Query the region being visited.
+  /// @return The visited region.
+  inline const MapChunk &chunk() const { return *chunk_; }
+  /// Query the index of the region within the visited region set. For @c forEachRegion() this is in the range
+  /// <tt>[0, region_count)</tt> .
+  /// @return The region index.
+  inline size_t regionIndex() const { return region_index_; }
+
+  /// Query the first voxel index to visit.
+  /// @return The first voxel index.
+  inline unsigned begin() const { return begin_; }
+  /// Query the voxel index after the last voxel to visit.
+  /// @return The end voxel index.
+  inline unsigned end() const { return end_; }
+
+  /// Query the number of requested layers.
+  /// @return The number of layer buffers.
+  inline unsigned layerCount() const { return unsigned(buffers_.size()); }
+  /// Access the retained buffer for the requested layer at @p layer in the visit function layer list.
+  /// @param layer Index into the requested layers, not the map layer index.
+  /// @return The retained voxel buffer. Invalid for missing layers.
+  inline const VoxelBuffer<const VoxelBlock> &buffer(unsigned layer) const { return buffers_[layer]; }
+  /// Access the voxel memory for the requested layer at @p layer in the visit function layer list.
+  /// @param layer Index into the requested layers, not the map layer index.
+  /// @tparam T The voxel data type. Must match the layer voxel size.
+  /// @return The voxel array for the whole region, or null for missing layers.
+  template <typename T>
+  inline const T *voxels(unsigned layer) const
+  {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<const T *>(buffers_[layer].voxelMemory());
+  }
+
+  /// Resolve the @c Key for @p voxel_index in the region.
+  /// @param voxel_index The voxel index of interest.
+  /// @return The voxel key.
+  Key key(unsigned voxel_index) const;
+
+private:
+  const OccupancyMap *map_;
+  const MapChunk *chunk_;
+  std::vector<VoxelBuffer<const VoxelBlock>> buffers_;
+  size_t region_index_;
+  unsigned begin_;
+  unsigned end_;
+};
+
+/// Function signature for region visit functions.
+using RegionVisitFunction = std::function<void(const RegionVoxels &)>;
+
+/// Default number of voxels in each range visited by @c parallelForEachVoxel() .
+const unsigned kDefaultVoxelGrain = 4096u;
+
+/// Visit each of the @p chunks of @p map , retaining the voxel buffers for @p layers during each visit.
+///
+/// Each region is visited once with a @c RegionVoxels covering all voxels in the region. The regions are visited in
+/// parallel by default, in which case the @p func must be thread safe. Pass a @p thread_count of 1 to visit the regions
+/// serially in the order of @p chunks . The map must not have regions added or removed during the call.
+///
+/// @param map The map to visit.
+/// @param chunks The regions of @p map to visit.
+/// @param layers The map layer indices to retain voxel buffers for.
+/// @param func The visit function.
+/// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
+///   Ignored when threading is unavailable.
+void ohm_API forEachRegion(const OccupancyMap &map, const std::vector<const MapChunk *> &chunks,
+                           const std::vector<int> &layers, const RegionVisitFunction &func, unsigned thread_count = 0);
+
+/// @overload
+/// Visits all regions in @p map , in @c OccupancyMap::enumerateRegions() order when serial.
+void ohm_API forEachRegion(const OccupancyMap &map, const std::vector<int> &layers, const RegionVisitFunction &func,
+                           unsigned thread_count = 0);
+
+/// Visit all regions of @p map as per @c forEachRegion() , splitting each region into contiguous voxel ranges of at
+/// most @p voxel_grain voxels. This improves load balancing when there are few regions. Ranges from the same region
+/// share the same @c RegionVoxels::regionIndex() .
+///
+/// @param map The map to visit.
+/// @param layers The map layer indices to retain voxel buffers for.
+/// @param func The visit function.
+/// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
+///   Ignored when threading is unavailable.
+/// @param voxel_grain The maximum number of voxels in each range. Zero to visit whole regions.
+void ohm_API forEachVoxelRange(const OccupancyMap &map, const std::vector<int> &layers,
+                               const RegionVisitFunction &func, unsigned thread_count = 0,
+                               unsigned voxel_grain = kDefaultVoxelGrain);
+
+/// Invoke @p func for every voxel in @p map , in parallel by default. See @c forEachVoxelRange() .
+///
+/// @param map The map to visit.
+/// @param layers The map layer indices to retain voxel buffers for.
+/// @param func The visit function with the signature <tt>void(const RegionVoxels &region, unsigned voxel_index)</tt> .
+///   Must be thread safe unless @p thread_count is 1.
+/// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
+template <typename Func>
+void parallelForEachVoxel(const OccupancyMap &map, const std::vector<int> &layers, Func &&func,
+                          unsigned thread_count = 0)
+{
+  forEachVoxelRange(
+    map, layers,
+    [&func](const RegionVoxels &region) {
+      for (unsigned i = region.begin(); i < region.end(); ++i)
+      {
+        func(region, i);
+      }
+    },
+    thread_count);
+}
+
+/// Calculate a reduction over the regions of @p map in parallel.
+///
+/// Each region is visited once, with @p region_func accumulating into a result for that region initialised to
+/// @p identity . The region results are then combined using @p reduce in @c OccupancyMap::enumerateRegions() order,
+/// so the result is independent of the @p thread_count , even for non-associative floating point operations.
+///
+/// @param map The map to visit.
+/// @param layers The map layer indices to retain voxel buffers for.
+/// @param identity The initial value for each region result and the overall result.
+/// @param region_func Region visit function with the signature <tt>void(const RegionVoxels &region, T &result)</tt> .
+/// @param reduce Function combining two results with the signature <tt>T(const T &a, const T &b)</tt> .
+/// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
+/// @return The reduced result.
+template <typename T, typename RegionFunc, typename ReduceFunc>
+T reduceRegions(const OccupancyMap &map, const std::vector<int> &layers, const T &identity, RegionFunc &&region_func,
+                ReduceFunc &&reduce, unsigned thread_count = 0)
+{
+  std::vector<const MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  // Use a deque rather than a vector so each region result has its own storage. A std::vector<bool> packs results into
+  // shared words, which the concurrent region visits would race on.
+  std::deque<T> region_results(chunks.size(), identity);
+  forEachRegion(
+    map, chunks, layers,
+    [&region_func, &region_results](const RegionVoxels &region) {
+      region_func(region, region_results[region.regionIndex()]);
+    },
+    thread_count);
+
+  T result = identity;
+  for (const T &region_result : region_results)
+  {
+    result = reduce(result, region_result);
+  }
+  return result;
+}
+}  // namespace ohm
+
+#endif  // OHM_FOREACHREGION_H
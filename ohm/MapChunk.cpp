@@ -34,6 +34,7 @@ MapChunk::MapChunk(const MapRegion &region, const OccupancyMapDetail &map)
     voxel_blocks[i].reset(new VoxelBlock(&map, layer));
     touched_stamps[i] = 0u;
   }
+  occupancy_summary = std::make_unique<ChunkOccupancySummary>();
 }
 
 
@@ -51,10 +52,23 @@ MapChunk::MapChunk(MapChunk &&other) noexcept
   , touched_stamps(std::move(other.touched_stamps))
   , voxel_blocks(std::move(other.voxel_blocks))
   , flags(std::exchange(other.flags, 0))
-{}
+  , occupancy_summary(std::move(other.occupancy_summary))
+{
+  // The moved chunk leaves the dirty list. This chunk is not listed until marked dirty.
+  if (map)
+  {
+    map->dirty_chunks.remove(&other);
+  }
+}
 
 
-MapChunk::~MapChunk() = default;
+MapChunk::~MapChunk()
+{
+  if (map)
+  {
+    map->dirty_chunks.remove(this);
+  }
+}
 
 
 const MapLayout &MapChunk::layout() const
@@ -63,6 +77,16 @@ const MapLayout &MapChunk::layout() const
 }
 
 
+void MapChunk::markDirty(uint64_t stamp)
+{
+  dirty_stamp = stamp;
+  if (map)
+  {
+    map->dirty_chunks.touch(this);
+  }
+}
+
+
 Key MapChunk::keyForIndex(size_t voxel_index, const glm::ivec3 &region_voxel_dimensions,
                           const glm::i16vec3 &region_coord)
 {
@@ -138,6 +162,11 @@ void MapChunk::updateLayout(const MapLayout *new_layout,
   // Update pointers
   std::swap(voxel_blocks, new_voxel_blocks);
   std::swap(touched_stamps, new_touched_stamps);
+  if (occupancy_summary)
+  {
+    // The occupancy layer may have moved or been replaced.
+    occupancy_summary->invalidate();
+  }
   // We do nothing to update the layout() to new_layout. This object is owned by the occupancy map which we assume is
   // about to change internally. It's address will remain unchanged.
 }
@@ -260,6 +289,20 @@ bool MapChunk::validateFirstValid() const
 }
 
 
+const ChunkOccupancySummary *MapChunk::occupancySummary() const
+{
+  const int occupancy_layer = (map) ? map->layout.occupancyLayer() : -1;
+  if (!occupancy_summary || occupancy_layer < 0)
+  {
+    return nullptr;
+  }
+
+  occupancy_summary->sync(*this, occupancy_layer, touched_stamps[occupancy_layer].load(std::memory_order_relaxed),
+                          map->occupancy_threshold_value);
+  return occupancy_summary.get();
+}
+
+
 bool MapChunk::overlapsExtents(const glm::dvec3 &min_ext, const glm::dvec3 &max_ext) const
 {
   glm::dvec3 region_min;
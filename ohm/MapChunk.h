@@ -8,12 +8,14 @@
 
 #include "OhmConfig.h"
 
+#include "ChunkOccupancySummary.h"
 #include "Key.h"
 #include "MapRegion.h"
 #include "VoxelBlock.h"
 
 #include <algorithm>
 #include <atomic>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -140,7 +142,7 @@ inline bool nextLocalKey(Key &key, const glm::ivec3 &dim)
 /// - Cast the voxel memory to the expected type - e.g., @c float for occupancy, @c VoxelMean for the voxel mean layer
 /// - Resolve the @c Key::localKey() into a one dimensional index using @c voxelIndex()
 /// - Read/write to the indexed voxel as required
-/// - Update the @c MapChunk::dirty_stamp to the cached @c OccupancyMap::touch() value
+/// - Update the @c MapChunk::dirty_stamp to the cached @c OccupancyMap::touch() value using @c MapChunk::markDirty()
 /// - Update the @c MapChunk::touched_stamps for the affected layer(s) to the same touch value.
 ///     - Recommend using @c std::atomic_uint64_t::.store() with @c std::memory_order_relaxed if permitted
 ///
@@ -165,7 +167,8 @@ struct ohm_API MapChunk
   double touched_time = 0;
 
   /// A monotonic stamp value occupancy layer, used to indicate when this chunk was last updated.
-  /// The map maintains the most up to date stamp: @c OccupancyMap::stamp().
+  /// The map maintains the most up to date stamp: @c OccupancyMap::stamp(). Set via @c markDirty() so the map can
+  /// track the modified regions.
   std::atomic_uint64_t dirty_stamp{ 0 };
 
   /// A monotonic stamp value for each @c voxelMap, used to indicate when the layer was last updated.
@@ -180,6 +183,19 @@ struct ohm_API MapChunk
 
   /// Chunk flags set from @c MapChunkFlag.
   unsigned flags = 0;
+  /// Lazily maintained summary of the occupancy layer. Access via @c occupancySummary() .
+  std::unique_ptr<ChunkOccupancySummary> occupancy_summary;
+  /// Number of outstanding @c pin() calls. A pinned chunk is never evicted from a paged map. See
+  /// @c OccupancyMap::pinRegion() .
+  mutable std::atomic_uint32_t pin_count{ 0 };
+
+  /// Links for the owning map's list of chunks in modification order. Managed by the map. See @c markDirty() .
+  MapChunk *dirty_prev = nullptr;
+  /// @copydoc dirty_prev
+  MapChunk *dirty_next = nullptr;
+  /// Orders this chunk in the dirty chunk list. Managed by the map and at least the @c dirty_stamp while listed.
+  /// Atomic as it is checked without the list lock when the chunk is already the latest dirty chunk.
+  std::atomic_uint64_t dirty_order_stamp{ 0 };
 
   /// Create an empty @c MapChunk object.
   MapChunk() = default;
@@ -202,6 +218,17 @@ struct ohm_API MapChunk
   /// Access details of the voxel layers and layouts for this map.
   const MapLayout &layout() const;
 
+  /// Set the @c dirty_stamp to @p stamp and record the chunk as modified with the owning map. This supports
+  /// @c OccupancyMap::collectDirtyRegions() , so modifications should always update the stamp via this function.
+  /// @param stamp The map stamp for the modification, generally the cached @c OccupancyMap::touch() value.
+  void markDirty(uint64_t stamp);
+
+  /// Pin the chunk, preventing eviction from a paged map until a matching @c unpin() . Pinning a chunk which may
+  /// already be evicted is only safe via @c OccupancyMap::pinRegion() , which pins while the region is locked.
+  inline void pin() const { ++pin_count; }
+  /// Release a @c pin() .
+  inline void unpin() const { --pin_count; }
+
   /// Given a @p voxelIndex into voxels, get the associated @c Key.
   /// @param voxel_index An index into voxels. Must be in range
   ///   <tt>[0, regionVoxelDimensions.x * regionVoxelDimensions.y * regionVoxelDimensions.z)</tt>
@@ -279,6 +306,14 @@ struct ohm_API MapChunk
   /// @return True when the @c first_valid_index value matches what it should be.
   bool validateFirstValid() const;
 
+  /// Access the @c ChunkOccupancySummary for this chunk, recalculating it first if the occupancy layer has been
+  /// touched since the summary was last built. See @c ChunkOccupancySummary for details.
+  ///
+  /// This may be called concurrently from multiple threads, but not while the chunk occupancy is being modified.
+  ///
+  /// @return The occupancy summary, or null if the map has no occupancy layer.
+  const ChunkOccupancySummary *occupancySummary() const;
+
   /// Query if this @c MapChunk overlaps the axis aligned bounding box.
   /// @param min_ext The lower extents of the AABB.
   /// @param max_ext The upper extents of the AABB.
@@ -0,0 +1,724 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "MapJournal.h"
+
+#include "MapChunk.h"
+#include "MapLayer.h"
+#include "MapLayout.h"
+#include "MapSerialise.h"
+#include "OccupancyMap.h"
+#include "Stream.h"
+#include "VoxelBlock.h"
+#include "VoxelBuffer.h"
+#include "VoxelCodec.h"
+
+#include "private/OccupancyMapDetail.h"
+#include "private/SerialiseUtil.h"
+
+#ifdef OHM_THREADS
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#endif  // OHM_THREADS
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#else   // _WIN32
+#include <sys/types.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace ohm
+{
+namespace
+{
+/// Marks the start of a journal file: "OHMJ"
+const uint32_t kJournalMarker = 0x4a4d484fu;
+/// Journal format version.
+const uint32_t kJournalVersion = 2u;
+/// Marks the start of a checkpoint record: "RECS"
+const uint32_t kRecordMarker = 0x53434552u;
+/// Marks the end of a complete checkpoint record: "RECE"
+const uint32_t kRecordEndMarker = 0x45434552u;
+/// Byte size of the record header: marker, stamp, region count, removed region count, payload size.
+const size_t kRecordHeaderSize =
+  sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t);
+/// Byte size of a removed region entry in a record payload.
+const size_t kRemovedRegionSize = 3 * sizeof(int32_t);
+/// Maximum number of bytes passed to a single @c InputStream::readRaw() call.
+const size_t kMaxReadSize = 1u << 30u;
+
+/// Header details of a checkpoint record.
+struct JournalRecord
+{
+  /// The map stamp at the checkpoint.
+  uint64_t stamp = 0;
+  /// Number of regions in the record.
+  uint32_t region_count = 0;
+  /// Number of removed regions in the record. These precede the regions in the payload.
+  uint32_t removed_count = 0;
+  /// Number of bytes of region data following the record header.
+  uint64_t payload_size = 0;
+};
+
+/// Build the journal header for @p detail . The header identifies the map layout so the journal may be validated
+/// against a map before appending or replaying.
+int buildHeader(const OccupancyMapDetail &detail, std::vector<uint8_t> &header)
+{
+  const MapLayout &layout = detail.layout;
+  if (layout.layerCount() > std::numeric_limits<uint64_t>::digits)
+  {
+    // Layer inclusion is written as a 64-bit mask.
+    return kSeValueOverflow;
+  }
+
+  header.clear();
+  write<uint32_t>(header, kJournalMarker);
+  write<uint32_t>(header, kJournalVersion);
+  write<int32_t>(header, detail.region_voxel_dimensions.x);
+  write<int32_t>(header, detail.region_voxel_dimensions.y);
+  write<int32_t>(header, detail.region_voxel_dimensions.z);
+  write<double>(header, detail.resolution);
+  write<uint32_t>(header, layout.layerCount());
+  for (size_t i = 0; i < layout.layerCount(); ++i)
+  {
+    const MapLayer &layer = layout.layer(i);
+    const size_t name_length = strlen(layer.name());
+    write<uint32_t>(header, layer.voxelByteSize());
+    write<uint32_t>(header, name_length);
+    header.insert(header.end(), layer.name(), layer.name() + name_length);
+  }
+
+  return kSeOk;
+}
+
+
+/// Validate the header of the journal open in @p stream against @p expected_header .
+/// @return @c kSeOk on success with @p empty set if the journal contains no header, or @c kSeJournalMismatch.
+int validateHeader(InputStream &stream, const std::vector<uint8_t> &expected_header, bool &empty)
+{
+  std::vector<uint8_t> header(expected_header.size());
+  const unsigned read_bytes = stream.readRaw(header.data(), unsigned(header.size()));
+  empty = read_bytes == 0;
+  if (empty)
+  {
+    return kSeOk;
+  }
+
+  if (read_bytes != header.size() || memcmp(header.data(), expected_header.data(), header.size()) != 0)
+  {
+    return kSeJournalMismatch;
+  }
+
+  return kSeOk;
+}
+
+
+/// Read the header of the next record, validating it is complete by checking for the end marker. The stream is left
+/// positioned at the start of the record payload.
+/// @return True if a complete record is available.
+bool readRecordHeader(InputStream &stream, JournalRecord &record)
+{
+  const size_t record_start = stream.tell();
+  uint32_t marker = 0;
+  bool ok = true;
+  ok = readRaw<uint32_t>(stream, marker) && marker == kRecordMarker && ok;
+  ok = ok && readRaw<uint64_t>(stream, record.stamp);
+  ok = ok && readRaw<uint32_t>(stream, record.region_count);
+  ok = ok && readRaw<uint32_t>(stream, record.removed_count);
+  ok = ok && readRaw<uint64_t>(stream, record.payload_size);
+
+  if (ok)
+  {
+    // Check the end marker. This fails for records which were not completely written.
+    stream.seek(record_start + kRecordHeaderSize + record.payload_size);
+    ok = readRaw<uint32_t>(stream, marker) && marker == kRecordEndMarker;
+    stream.seek(record_start + kRecordHeaderSize);
+  }
+
+  return ok;
+}
+
+
+/// Scan the records from the current stream position.
+/// @return The stream position following the last complete record.
+size_t scanRecords(InputStream &stream, unsigned *record_count, uint64_t *region_count)
+{
+  size_t end_pos = stream.tell();
+  JournalRecord record;
+  while (readRecordHeader(stream, record))
+  {
+    end_pos += kRecordHeaderSize + record.payload_size + sizeof(kRecordEndMarker);
+    stream.seek(end_pos);
+    if (record_count)
+    {
+      ++*record_count;
+    }
+    if (region_count)
+    {
+      *region_count += record.region_count;
+    }
+  }
+
+  return end_pos;
+}
+
+
+/// Write the dirty layers of @p chunk into @p buffer .
+int saveRegion(std::vector<uint8_t> &buffer, const MapChunk &chunk, const OccupancyMapDetail &detail,
+               uint64_t from_stamp)
+{
+  const MapLayout &layout = detail.layout;
+  uint64_t layer_mask = 0;
+  for (size_t i = 0; i < layout.layerCount(); ++i)
+  {
+    if (!(layout.layer(i).flags() & MapLayer::kSkipSerialise) && chunk.touched_stamps[i] > from_stamp)
+    {
+      layer_mask |= (uint64_t(1) << i);
+    }
+  }
+
+  write<int32_t>(buffer, chunk.region.coord.x);
+  write<int32_t>(buffer, chunk.region.coord.y);
+  write<int32_t>(buffer, chunk.region.coord.z);
+  write<double>(buffer, chunk.touched_time);
+  write<uint64_t>(buffer, chunk.dirty_stamp.load());
+  write<uint64_t>(buffer, layer_mask);
+
+  for (size_t i = 0; i < layout.layerCount(); ++i)
+  {
+    if (!(layer_mask & (uint64_t(1) << i)))
+    {
+      continue;
+    }
+
+    const MapLayer &layer = layout.layer(i);
+    write<uint64_t>(buffer, chunk.touched_stamps[i].load());
+
+    VoxelBuffer<const VoxelBlock> voxel_buffer(chunk.voxel_blocks[i]);
+    const uint8_t *layer_mem = voxel_buffer.voxelMemory();
+    const size_t node_byte_count = layer.voxelByteSize() * layer.volume(detail.region_voxel_dimensions);
+    if (buffer.size() + node_byte_count != uint32_t(buffer.size() + node_byte_count))
+    {
+      // Region data size must fit the record entry.
+      return kSeValueOverflow;
+    }
+    buffer.insert(buffer.end(), layer_mem, layer_mem + node_byte_count);
+  }
+
+  return kSeOk;
+}
+
+
+/// Apply region data written by @c saveRegion() to @p map .
+int loadRegion(const uint8_t *buffer, size_t buffer_size, OccupancyMap &map)
+{
+  OccupancyMapDetail &detail = *map.detail();
+  const MapLayout &layout = detail.layout;
+  bool ok = true;
+  size_t pos = 0;
+  glm::i16vec3 coord;
+  double touched_time = 0;
+  uint64_t dirty_stamp = 0;
+  uint64_t layer_mask = 0;
+
+  ok = read<int32_t>(buffer, buffer_size, pos, coord.x) && ok;
+  ok = read<int32_t>(buffer, buffer_size, pos, coord.y) && ok;
+  ok = read<int32_t>(buffer, buffer_size, pos, coord.z) && ok;
+  ok = read<double>(buffer, buffer_size, pos, touched_time) && ok;
+  ok = read<uint64_t>(buffer, buffer_size, pos, dirty_stamp) && ok;
+  ok = read<uint64_t>(buffer, buffer_size, pos, layer_mask) && ok;
+
+  if (!ok)
+  {
+    return kSeFileReadFailure;
+  }
+
+  MapChunk *chunk = map.region(coord, true);
+  for (size_t i = 0; i < layout.layerCount(); ++i)
+  {
+    if (!(layer_mask & (uint64_t(1) << i)))
+    {
+      continue;
+    }
+
+    const MapLayer &layer = layout.layer(i);
+    uint64_t layer_touched_stamp = 0;
+    if (!read<uint64_t>(buffer, buffer_size, pos, layer_touched_stamp))
+    {
+      return kSeFileReadFailure;
+    }
+
+    const size_t node_byte_count = layer.voxelByteSize() * layer.volume(detail.region_voxel_dimensions);
+    if (pos + node_byte_count > buffer_size)
+    {
+      return kSeFileReadFailure;
+    }
+
+    VoxelBuffer<VoxelBlock> voxel_buffer(chunk->voxel_blocks[i]);
+    memcpy(voxel_buffer.voxelMemory(), buffer + pos, node_byte_count);
+    pos += node_byte_count;
+    chunk->touched_stamps[i] = layer_touched_stamp;
+  }
+
+  // Replayed stamps need not exceed the stamps the occupancy summary was built with.
+  if (chunk->occupancy_summary)
+  {
+    chunk->occupancy_summary->invalidate();
+  }
+  chunk->touched_time = std::max(chunk->touched_time, touched_time);
+  chunk->markDirty(std::max(chunk->dirty_stamp.load(), dirty_stamp));
+  chunk->searchAndUpdateFirstValid(detail.region_voxel_dimensions);
+
+  return kSeOk;
+}
+
+
+/// Truncate the file at @p filename to @p size bytes.
+bool truncateFile(const std::string &filename, size_t size)
+{
+#ifdef _WIN32
+  int fd = -1;
+  if (_sopen_s(&fd, filename.c_str(), _O_RDWR | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0)
+  {
+    return false;
+  }
+  const bool ok = _chsize_s(fd, int64_t(size)) == 0;
+  _close(fd);
+  return ok;
+#else   // _WIN32
+  return ::truncate(filename.c_str(), off_t(size)) == 0;
+#endif  // _WIN32
+}
+
+
+/// Read @p size bytes into @p buffer in blocks suitable for @c InputStream::readRaw() .
+bool readPayload(InputStream &stream, std::vector<uint8_t> &buffer, size_t size)
+{
+  buffer.resize(size);
+  size_t pos = 0;
+  while (pos < size)
+  {
+    const unsigned read_size = unsigned(std::min(kMaxReadSize, size - pos));
+    if (stream.readRaw(buffer.data() + pos, read_size) != read_size)
+    {
+      return false;
+    }
+    pos += read_size;
+  }
+  return true;
+}
+
+
+/// Apply a complete record @p payload to @p map , decompressing and applying the regions in parallel.
+int replayRecord(const std::vector<uint8_t> &payload, const JournalRecord &record, OccupancyMap &map,
+                 const VoxelCodec &codec)
+{
+  struct RegionEntry
+  {
+    const uint8_t *data;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+  };
+
+  // Apply the removals first. Regions removed then recreated since the previous record are restored by the region
+  // entries which follow.
+  size_t pos = 0;
+  if (record.removed_count)
+  {
+    if (record.removed_count > payload.size() / kRemovedRegionSize)
+    {
+      return kSeFileReadFailure;
+    }
+
+    std::vector<glm::i16vec3> removed_regions(record.removed_count);
+    for (glm::i16vec3 &region_key : removed_regions)
+    {
+      bool ok = true;
+      ok = read<int32_t>(payload.data(), payload.size(), pos, region_key.x) && ok;
+      ok = read<int32_t>(payload.data(), payload.size(), pos, region_key.y) && ok;
+      ok = read<int32_t>(payload.data(), payload.size(), pos, region_key.z) && ok;
+      if (!ok)
+      {
+        return kSeFileReadFailure;
+      }
+    }
+    map.removeRegions(removed_regions);
+  }
+
+  // Resolve the region entries, then decompress and apply in parallel. Each region appears once per record.
+  std::vector<RegionEntry> entries(record.region_count);
+  for (RegionEntry &entry : entries)
+  {
+    bool ok = true;
+    ok = read<uint32_t>(payload.data(), payload.size(), pos, entry.compressed_size) && ok;
+    ok = read<uint32_t>(payload.data(), payload.size(), pos, entry.uncompressed_size) && ok;
+    if (!ok || pos + entry.compressed_size > payload.size())
+    {
+      return kSeFileReadFailure;
+    }
+    entry.data = payload.data() + pos;
+    pos += entry.compressed_size;
+  }
+
+  std::vector<int> errors(entries.size(), kSeOk);
+  const auto apply_region = [&](size_t i, std::vector<uint8_t> &uncompressed) {
+    const RegionEntry &entry = entries[i];
+    uncompressed.resize(entry.uncompressed_size);
+    if (!codec.decompress(entry.data, entry.compressed_size, uncompressed.data(), uncompressed.size()))
+    {
+      errors[i] = kSeCompressionFailure;
+      return;
+    }
+    errors[i] = loadRegion(uncompressed.data(), uncompressed.size(), map);
+  };
+
+#ifdef OHM_THREADS
+  tbb::enumerable_thread_specific<std::vector<uint8_t>> uncompressed_buffers;
+  tbb::parallel_for(size_t(0), entries.size(), [&](size_t i) { apply_region(i, uncompressed_buffers.local()); });
+#else   // OHM_THREADS
+  std::vector<uint8_t> uncompressed_buffer;
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    apply_region(i, uncompressed_buffer);
+  }
+#endif  // OHM_THREADS
+
+  for (int err : errors)
+  {
+    if (err)
+    {
+      return err;
+    }
+  }
+
+  return kSeOk;
+}
+}  // namespace
+
+
+int appendJournal(const std::string &filename, const OccupancyMap &map, uint64_t &stamp, SerialiseProgress *progress)
+{
+  const OccupancyMapDetail &detail = *map.detail();
+  // Capture the stamp first. Changes from here are captured by the next checkpoint.
+  const uint64_t checkpoint_stamp = map.stamp();
+
+  std::vector<uint8_t> header;
+  int err = buildHeader(detail, header);
+  if (err)
+  {
+    return err;
+  }
+
+  // Validate any existing journal and find the end of the last complete record. Data following the last complete
+  // record is from an interrupted write and is truncated, so it cannot follow the new record.
+  bool new_journal = true;
+  size_t append_pos = 0;
+  size_t file_size = 0;
+  {
+    InputStream in(filename);
+    if (in.isOpen())
+    {
+      err = validateHeader(in, header, new_journal);
+      if (err)
+      {
+        return err;
+      }
+      append_pos = (!new_journal) ? scanRecords(in, nullptr, nullptr) : 0;
+      file_size = in.size();
+    }
+  }
+
+  if (!new_journal && append_pos < file_size && !truncateFile(filename, append_pos))
+  {
+    return kSeFileWriteFailure;
+  }
+
+  std::vector<std::pair<uint64_t, glm::i16vec3>> regions;
+  map.collectDirtyRegions(stamp, regions);
+  std::vector<glm::i16vec3> removed_regions;
+  map.collectRemovedRegions(stamp, removed_regions);
+  if (removed_regions.size() > std::numeric_limits<uint32_t>::max())
+  {
+    return kSeValueOverflow;
+  }
+
+  if (progress)
+  {
+    progress->setTargetProgress(unsigned(std::max<size_t>(regions.size(), 1u)));
+  }
+
+  OutputStream stream(filename, kSfAppend);
+  if (!stream.isOpen())
+  {
+    return kSeFileCreateFailure;
+  }
+
+  if (new_journal)
+  {
+    stream.seek(0);
+    if (stream.writeUncompressed(header.data(), unsigned(header.size())) != header.size())
+    {
+      return kSeFileWriteFailure;
+    }
+  }
+  else
+  {
+    stream.seek(append_pos);
+  }
+
+  // Block region creation and removal while compressing. Regions may still be modified, so the record may include
+  // changes after checkpoint_stamp. These are rewritten by the next checkpoint.
+  std::vector<std::vector<uint8_t>> compressed(regions.size());
+  std::vector<uint32_t> uncompressed_sizes(regions.size(), 0);
+  std::vector<int> errors(regions.size(), kSeOk);
+  const VoxelCodec::Ptr codec = VoxelCodec::create(VoxelCodec::kZLib);
+  {
+    std::shared_lock<const ChunkMap> guard(detail.chunks);
+    const auto save_region = [&](size_t i, std::vector<uint8_t> &uncompressed) {
+      const auto chunk_iter = detail.chunks.find(regions[i].second);
+      if (chunk_iter == detail.chunks.end())
+      {
+        // Removed since collection. Nothing to write.
+        return;
+      }
+      uncompressed.clear();
+      errors[i] = saveRegion(uncompressed, *chunk_iter->second, detail, stamp);
+      if (!errors[i] && !codec->compress(uncompressed.data(), uncompressed.size(), compressed[i]))
+      {
+        errors[i] = kSeCompressionFailure;
+      }
+      uncompressed_sizes[i] = uint32_t(uncompressed.size());
+    };
+
+#ifdef OHM_THREADS
+    tbb::enumerable_thread_specific<std::vector<uint8_t>> uncompressed_buffers;
+    tbb::parallel_for(size_t(0), regions.size(), [&](size_t i) { save_region(i, uncompressed_buffers.local()); });
+#else   // OHM_THREADS
+    std::vector<uint8_t> uncompressed_buffer;
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+      save_region(i, uncompressed_buffer);
+    }
+#endif  // OHM_THREADS
+  }
+
+  uint32_t region_count = 0;
+  uint64_t payload_size = removed_regions.size() * kRemovedRegionSize;
+  for (size_t i = 0; i < regions.size(); ++i)
+  {
+    if (errors[i])
+    {
+      return errors[i];
+    }
+
+    if (uncompressed_sizes[i])
+    {
+      ++region_count;
+      payload_size += 2 * sizeof(uint32_t) + compressed[i].size();
+    }
+  }
+
+  // Write the record. The end marker is written last so incomplete records can be detected.
+  bool ok = true;
+  ok = writeUncompressed<uint32_t>(stream, kRecordMarker) && ok;
+  ok = writeUncompressed<uint64_t>(stream, checkpoint_stamp) && ok;
+  ok = writeUncompressed<uint32_t>(stream, region_count) && ok;
+  ok = writeUncompressed<uint32_t>(stream, uint32_t(removed_regions.size())) && ok;
+  ok = writeUncompressed<uint64_t>(stream, payload_size) && ok;
+  for (size_t i = 0; ok && i < removed_regions.size(); ++i)
+  {
+    ok = writeUncompressed<int32_t>(stream, removed_regions[i].x) && ok;
+    ok = writeUncompressed<int32_t>(stream, removed_regions[i].y) && ok;
+    ok = writeUncompressed<int32_t>(stream, removed_regions[i].z) && ok;
+  }
+  for (size_t i = 0; ok && i < regions.size() && (!progress || !progress->quit()); ++i)
+  {
+    if (uncompressed_sizes[i])
+    {
+      ok = writeUncompressed<uint32_t>(stream, compressed[i].size()) && ok;
+      ok = writeUncompressed<uint32_t>(stream, uncompressed_sizes[i]) && ok;
+      ok = stream.writeUncompressed(compressed[i].data(), unsigned(compressed[i].size())) == compressed[i].size() && ok;
+    }
+
+    if (progress)
+    {
+      progress->incrementProgress();
+    }
+  }
+
+  if (progress && progress->quit())
+  {
+    // Leave the record incomplete. It is ignored on replay and overwritten by the next append.
+    return kSeOk;
+  }
+
+  ok = ok && writeUncompressed<uint32_t>(stream, kRecordEndMarker);
+  stream.close();
+
+  if (!ok)
+  {
+    return kSeFileWriteFailure;
+  }
+
+  stamp = checkpoint_stamp;
+  return kSeOk;
+}
+
+
+int replayJournal(const std::string &filename, OccupancyMap &map, SerialiseProgress *progress, uint64_t *stamp_out)
+{
+  OccupancyMapDetail &detail = *map.detail();
+  InputStream stream(filename);
+  if (!stream.isOpen())
+  {
+    return kSeFileOpenFailure;
+  }
+
+  std::vector<uint8_t> header;
+  int err = buildHeader(detail, header);
+  if (err)
+  {
+    return err;
+  }
+
+  bool empty = false;
+  err = validateHeader(stream, header, empty);
+  if (err || empty)
+  {
+    return err;
+  }
+
+  // Scan the complete records to set the progress target.
+  unsigned record_count = 0;
+  uint64_t region_count = 0;
+  scanRecords(stream, &record_count, &region_count);
+  stream.seek(header.size());
+
+  if (progress)
+  {
+    progress->setTargetProgress(unsigned(std::max<uint64_t>(region_count, 1u)));
+  }
+
+  const VoxelCodec::Ptr codec = VoxelCodec::create(VoxelCodec::kZLib);
+  if (!codec)
+  {
+    return kSeCompressionFailure;
+  }
+
+  // Records must be applied in order.
+  std::vector<uint8_t> payload;
+  JournalRecord record;
+  for (unsigned i = 0; i < record_count && (!progress || !progress->quit()); ++i)
+  {
+    if (!readRecordHeader(stream, record) || !readPayload(stream, payload, record.payload_size))
+    {
+      return kSeFileReadFailure;
+    }
+
+    // Skip the end marker validated by readRecordHeader().
+    stream.seek(stream.tell() + sizeof(kRecordEndMarker));
+
+    err = replayRecord(payload, record, map, *codec);
+    if (err)
+    {
+      return err;
+    }
+
+    detail.stamp = std::max(detail.stamp, record.stamp);
+    if (stamp_out)
+    {
+      *stamp_out = record.stamp;
+    }
+
+    if (progress)
+    {
+      progress->incrementProgress(record.region_count);
+    }
+  }
+
+  return kSeOk;
+}
+
+
+int compactJournal(const std::string &map_filename, const std::string &journal_filename, SerialiseProgress *progress)
+{
+  OccupancyMap map(1.0);
+  int err = load(map_filename, map, progress);
+  if (err)
+  {
+    return err;
+  }
+
+  err = replayJournal(journal_filename, map, progress);
+  if (err)
+  {
+    return err;
+  }
+
+  // Save to a temporary file, then replace the map file so the map is not lost if saving fails.
+  const std::string compact_filename = map_filename + ".compact";
+  err = save(compact_filename, map, progress);
+  if (err)
+  {
+    std::remove(compact_filename.c_str());
+    return err;
+  }
+
+  // Rename does not replace an existing file on all platforms. In that case, move the map file to a backup first and
+  // remove the backup only once the compacted map is in place, restoring it on failure.
+  if (std::rename(compact_filename.c_str(), map_filename.c_str()) != 0)
+  {
+    const std::string backup_filename = map_filename + ".bak";
+    std::remove(backup_filename.c_str());
+    if (std::rename(map_filename.c_str(), backup_filename.c_str()) != 0)
+    {
+      std::remove(compact_filename.c_str());
+      return kSeFileCreateFailure;
+    }
+
+    if (std::rename(compact_filename.c_str(), map_filename.c_str()) != 0)
+    {
+      std::rename(backup_filename.c_str(), map_filename.c_str());
+      std::remove(compact_filename.c_str());
+      return kSeFileCreateFailure;
+    }
+
+    std::remove(backup_filename.c_str());
+  }
+
+  // Reset the journal.
+  std::vector<uint8_t> header;
+  err = buildHeader(*map.detail(), header);
+  if (err)
+  {
+    return err;
+  }
+
+  OutputStream stream(journal_filename);
+  if (!stream.isOpen())
+  {
+    return kSeFileCreateFailure;
+  }
+
+  if (stream.writeUncompressed(header.data(), unsigned(header.size())) != header.size())
+  {
+    return kSeFileWriteFailure;
+  }
+
+  return kSeOk;
+}
+}  // namespace ohm
@@ -0,0 +1,97 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_MAPJOURNAL_H
+#define OHM_MAPJOURNAL_H
+
+#include "OhmConfig.h"
+
+#include <cstdint>
+#include <string>
+
+namespace ohm
+{
+class OccupancyMap;
+class SerialiseProgress;
+
+/// @defgroup mapjournal Map Journal
+/// Incremental map checkpointing.
+///
+/// A map journal is an append only file of checkpoint records, each holding the regions of a map which have changed
+/// since the previous checkpoint. This allows a map to be checkpointed at a cost which scales with the volume of
+/// change rather than the size of the map. A journal is applied on top of a base map saved with @c ohm::save() :
+///
+/// @code
+/// uint64_t checkpoint_stamp = map.stamp();
+/// ohm::save("base.ohm", map);
+/// // ... continue mapping.
+/// ohm::appendJournal("base.ohmj", map, checkpoint_stamp);
+/// // ... continue mapping.
+/// ohm::appendJournal("base.ohmj", map, checkpoint_stamp);
+///
+/// // Restore.
+/// ohm::load("base.ohm", restored_map);
+/// ohm::replayJournal("base.ohmj", restored_map);
+/// @endcode
+///
+/// Only the voxel layers with @c MapChunk::touched_stamps after the previous checkpoint are written for each dirty
+/// region. Regions removed since the previous checkpoint - see @c OccupancyMap::collectRemovedRegions() - are also
+/// recorded and removed again on replay. Each record is terminated by an end marker and records which are incomplete,
+/// such as from an interrupted write, are ignored on replay and truncated by the next @c appendJournal() .
+///
+/// Over time the journal may be merged into the base map using @c compactJournal() .
+/// @{
+
+/// Append the regions of @p map which have changed since @p stamp to the journal at @p filename . The journal is
+/// created if it does not exist.
+///
+/// The checkpoint is consistent with the map state at the start of the call. Regions modified during the call may be
+/// partially captured, but will be captured again by the next checkpoint.
+///
+/// @param filename The journal file path.
+/// @param map The map to checkpoint.
+/// @param[in,out] stamp On input, the @c OccupancyMap::stamp() at the previous checkpoint. Use the stamp at which the
+///   base map was saved for the first checkpoint, or zero to include all modified regions. Updated to the map stamp
+///   for this checkpoint on success, ready for the next call.
+/// @param progress Optional progress tracking object.
+/// @return @c kSeOk on success, or a non zero @c SerialisationError on failure. @c kSeJournalMismatch indicates an
+///   existing journal does not match the @p map layout.
+int ohm_API appendJournal(const std::string &filename, const OccupancyMap &map, uint64_t &stamp,
+                          SerialiseProgress *progress = nullptr);
+
+/// Replay the journal at @p filename on top of @p map , which should generally be the base map the journal was
+/// started from.
+///
+/// Records are applied in order, so later changes to a region replace earlier ones. Within each record, removed regions
+/// are removed before the changed regions are applied. Incomplete records at the end of the journal are ignored.
+///
+/// @param filename The journal file path.
+/// @param map The map to apply the journal to.
+/// @param progress Optional progress tracking object.
+/// @param[out] stamp_out When present, set to the map stamp of the last checkpoint replayed.
+/// @return @c kSeOk on success, or a non zero @c SerialisationError on failure.
+int ohm_API replayJournal(const std::string &filename, OccupancyMap &map, SerialiseProgress *progress = nullptr,
+                          uint64_t *stamp_out = nullptr);
+
+/// Compact a journal into its base map file.
+///
+/// This loads @p map_filename , replays @p journal_filename on top, saves the result back to @p map_filename then
+/// resets the journal to be empty. The map file is replaced only once the new map has been successfully saved. Where
+/// the map file cannot be replaced directly, it is first moved to a backup file which is removed once the new map is
+/// in place.
+///
+/// Checkpoint stamps from @c appendJournal() remain valid after compaction.
+///
+/// @param map_filename The base map file path.
+/// @param journal_filename The journal file path.
+/// @param progress Optional progress tracking object.
+/// @return @c kSeOk on success, or a non zero @c SerialisationError on failure.
+int ohm_API compactJournal(const std::string &map_filename, const std::string &journal_filename,
+                           SerialiseProgress *progress = nullptr);
+
+/// @}
+}  // namespace ohm
+
+#endif  // OHM_MAPJOURNAL_H
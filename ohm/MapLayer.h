@@ -10,12 +10,14 @@
 
 #include "MapChunk.h"
 #include "MapLayoutMatch.h"
+#include "VoxelCodec.h"
 #include "VoxelLayout.h"
 
 #include <glm/vec3.hpp>
 
 #include <memory>
 #include <string>
+#include <utility>
 
 namespace ohm
 {
@@ -67,6 +69,20 @@ public:
   /// @param flags New flags to set.
   inline void setFlags(unsigned flags) { flags_ = flags; }
 
+  /// Access the codec used to compress voxel data for this layer.
+  /// @return The layer codec. Null when using the default codec set by @c VoxelBlock::setCompressionControls() .
+  inline const VoxelCodec::Ptr &codec() const { return codec_; }
+
+  /// Set the codec used to compress voxel data for this layer. Only relevant to maps with @c MapFlag::kCompressed .
+  ///
+  /// This should be set before the map is populated as the codec is not synchronised with the background compression
+  /// thread. Existing compressed data remain valid as each @c VoxelBlock retains the codec used to compress it.
+  ///
+  /// The codec is not serialised.
+  ///
+  /// @param codec The codec to use. Null to use the default codec.
+  inline void setCodec(VoxelCodec::Ptr codec) { codec_ = std::move(codec); }
+
   /// Copy the @c VoxelLayout from @p other.
   /// @param other Layer to copy the voxel structure of.
   void copyVoxelLayout(const MapLayer &other);
@@ -150,6 +166,7 @@ private:
   uint16_t layer_index_ = 0;
   uint16_t subsampling_ = 0;
   unsigned flags_ = 0;
+  VoxelCodec::Ptr codec_;
 };
 }  // namespace ohm
 
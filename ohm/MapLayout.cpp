@@ -366,6 +366,7 @@ MapLayout &MapLayout::operator=(const MapLayout &other)
       {
         MapLayer *new_layer = addLayer(layer->name(), layer->subsampling());
         new_layer->copyVoxelLayout(*layer);
+        new_layer->setCodec(layer->codec());
       }
     }
   }
@@ -5,6 +5,7 @@
 // Author: Kazys Stepanas
 #include "MapSerialise.h"
 
+#include "Aabb.h"
 #include "DefaultLayer.h"
 #include "MapChunk.h"
 #include "MapFlag.h"
@@ -14,27 +15,41 @@
 #include "Stream.h"
 #include "VoxelBlock.h"
 #include "VoxelBuffer.h"
+#include "VoxelCodec.h"
 #include "VoxelLayout.h"
 
 #include "private/OccupancyMapDetail.h"
+#include "private/RegionPager.h"
 #include "private/SerialiseUtil.h"
 
 #include "serialise/MapSerialiseV0.1.h"
 #include "serialise/MapSerialiseV0.2.h"
 #include "serialise/MapSerialiseV0.4.h"
 #include "serialise/MapSerialiseV0.5.h"
+#include "serialise/MapSerialiseV0.6.h"
 #include "serialise/MapSerialiseV0.h"
 
+#include <ohmutil/VectorHash.h>
+
 #include <glm/glm.hpp>
 
+#ifdef OHM_THREADS
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#endif  // OHM_THREADS
+
+#include <algorithm>
 #include <array>
 #include <cstdio>
 #include <cstring>
 #include <functional>
+#include <limits>
 #include <map>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <type_traits>
+#include <unordered_set>
 #include <vector>
 
 #include <zlib.h>
@@ -59,6 +74,8 @@ std::map<int, std::string> s_error_codes = { makeErrorCode(ohm::kSeOk, "ok"),
                                              makeErrorCode(ohm::kSeUnknownDataType, "unknown data type"),
                                              makeErrorCode(ohm::kSeUnsupportedVersion, "unsupported version"),
                                              makeErrorCode(ohm::kSeDeprecatedVersion, "deprecated version"),
+                                             makeErrorCode(ohm::kSeCompressionFailure, "compression failure"),
+                                             makeErrorCode(ohm::kSeJournalMismatch, "journal mismatch"),
                                              makeErrorCode(ohm::kSeExtensionCode, "unknown extension error") };
 }  // namespace
 
@@ -72,12 +89,18 @@ namespace ohm
 /// - @c vvv is the major version number (any number)
 /// - @c MMM is a three digit specification of the current minor version.
 /// - @c PPP is a three digit specification of the current patch version.
+///
+/// From version 0.6 the header also locates the region table.
 struct HeaderVersion
 {
   /// Marker equal to @c MapHeaderMarker if valid.
   uint32_t marker = 0;
   /// Map format version number.
   MapVersion version = { 0, 0, 0 };
+  /// Absolute file offset of the region table (v0.6).
+  uint64_t region_table_offset = 0;
+  /// The @c VoxelCodec::Type used to compress each region (v0.6).
+  uint8_t region_codec = VoxelCodec::kZLib;
 };
 
 const uint32_t kMapHeaderMarker = 0x44330011u;
@@ -89,8 +112,8 @@ const uint32_t kMapHeaderMarker = 0x44330011u;
 // - MMM is a three digit specification of the current minor version.
 // - PPP is a three digit specification of the current patch version.
 const MapVersion kSupportedVersionMin = { 0, 0, 0 };
-const MapVersion kSupportedVersionMax = { 0, 5, 0 };
-const MapVersion kCurrentVersion = { 0, 5, 0 };
+const MapVersion kSupportedVersionMax = { 0, 6, 0 };
+const MapVersion kCurrentVersion = { 0, 6, 0 };
 
 // Note: version 0.3.x is not supported.
 
@@ -284,7 +307,8 @@ int saveMapInfo(OutputStream &stream, const MapInfo &map_info)
 }
 
 
-int saveHeader(OutputStream &stream, const OccupancyMapDetail &map)
+int saveHeader(OutputStream &stream, const OccupancyMapDetail &map, const VoxelCodec &region_codec,
+               size_t &region_table_offset_pos)
 {
   bool ok = true;
   // Header marker + version
@@ -322,6 +346,12 @@ int saveHeader(OutputStream &stream, const OccupancyMapDetail &map)
   // Add v0.3.2
   ok = writeUncompressed<uint32_t>(stream, std::underlying_type_t<MapFlag>(map.flags)) && ok;
 
+  // Added v0.6.0
+  // Region table offset. Written as zero here and updated once the regions have been written.
+  region_table_offset_pos = stream.tell();
+  ok = writeUncompressed<uint64_t>(stream, 0u) && ok;
+  ok = writeUncompressed<uint8_t>(stream, region_codec.type()) && ok;
+
   return (ok) ? 0 : kSeFileWriteFailure;
 }
 
@@ -383,51 +413,6 @@ int saveLayout(OutputStream &stream, const OccupancyMapDetail &map)
 }
 
 
-int saveChunk(OutputStream &stream, const MapChunk &chunk, const OccupancyMapDetail &detail)
-{
-  bool ok = true;
-
-  // Write region details, then nodes. MapChunk members are derived.
-  ok = write<int32_t>(stream, chunk.region.coord.x) && ok;
-  ok = write<int32_t>(stream, chunk.region.coord.y) && ok;
-  ok = write<int32_t>(stream, chunk.region.coord.z) && ok;
-  ok = write<double>(stream, chunk.region.centre.x) && ok;
-  ok = write<double>(stream, chunk.region.centre.y) && ok;
-  ok = write<double>(stream, chunk.region.centre.z) && ok;
-  ok = write<double>(stream, chunk.touched_time) && ok;
-
-  // Save each map layer.
-  const MapLayout &layout = chunk.layout();
-  for (size_t i = 0; i < layout.layerCount(); ++i)
-  {
-    const MapLayer &layer = layout.layer(i);
-
-    if (layer.flags() & MapLayer::kSkipSerialise)
-    {
-      // Not to be serialised.
-      continue;
-    }
-
-    uint64_t layer_touched_stamp = chunk.touched_stamps[i];
-    ok = write<uint64_t>(stream, layer_touched_stamp) && ok;
-
-    // Get the layer memory.
-    VoxelBuffer<const VoxelBlock> voxel_buffer(chunk.voxel_blocks[layer.layerIndex()]);
-    const uint8_t *layer_mem = voxel_buffer.voxelMemory();
-    const size_t node_count = layer.volume(detail.region_voxel_dimensions);
-    const size_t node_byte_count = layer.voxelByteSize() * node_count;
-    if (node_byte_count != unsigned(node_byte_count))
-    {
-      return kSeValueOverflow;
-    }
-
-    ok = stream.write(layer_mem, unsigned(node_byte_count)) == node_byte_count && ok;
-  }
-
-  return (ok) ? 0 : kSeFileWriteFailure;
-}
-
-
 int loadHeader(InputStream &stream, HeaderVersion &version, OccupancyMapDetail &map, size_t &region_count)
 {
   bool ok = true;
@@ -519,6 +504,13 @@ int loadHeader(InputStream &stream, HeaderVersion &version, OccupancyMapDetail &
     map.flags = MapFlag::kNone;
   }
 
+  // v0.6.0 added the region table.
+  if (version.version.major > 0 || version.version.minor >= 6)
+  {
+    ok = readRaw<uint64_t>(stream, version.region_table_offset) && ok;
+    ok = readRaw<uint8_t>(stream, version.region_codec) && ok;
+  }
+
   if (!ok)
   {
     return kSeFileReadFailure;
@@ -593,6 +585,100 @@ void registerSerialiseExtensionErrorCodeString(int err, const char *error_string
 }
 
 
+namespace
+{
+/// Number of regions to compress in parallel before writing. Limits the memory overhead of saving.
+const size_t kSaveBatchSize = 256u;
+
+/// Remove the regions from @p detail which do not pass @p filter . Used to filter map versions which have no region
+/// table.
+void cullLoadedRegions(OccupancyMapDetail &detail, const RegionFilter &filter)
+{
+  auto region_iter = detail.chunks.begin();
+  while (region_iter != detail.chunks.end())
+  {
+    if (!filter(region_iter->first))
+    {
+      const MapChunk *chunk = region_iter->second;
+      region_iter = detail.chunks.erase(region_iter);
+      delete chunk;
+    }
+    else
+    {
+      ++region_iter;
+    }
+  }
+}
+
+
+int load(const std::string &filename, OccupancyMap &map, SerialiseProgress *progress, MapVersion *version_out,
+         const RegionFilter &filter)
+{
+  InputStream stream(filename, kSfCompress);
+  OccupancyMapDetail &detail = *map.detail();
+
+  if (!stream.isOpen())
+  {
+    return kSeFileOpenFailure;
+  }
+
+  map.clear();
+
+  // Header is read uncompressed.
+  size_t region_count = 0;
+  HeaderVersion version;
+  int err = loadHeader(stream, version, detail, region_count);
+  if (version_out)
+  {
+    *version_out = version.version;
+  }
+
+  if (err)
+  {
+    return err;
+  }
+
+  err = kSeUnsupportedVersion;
+  if (version.marker == 0 || version.version.major == 0 && version.version.minor == 0)
+  {
+    err = v0::load(stream, detail, progress, version.version, region_count);
+  }
+  else if (kSupportedVersionMin <= version.version && version.version <= kSupportedVersionMax)
+  {
+    if (version.version.major == 0 && version.version.minor == 1)
+    {
+      err = v0_1::load(stream, detail, progress, version.version, region_count);
+    }
+    else if (version.version.major == 0 && version.version.minor == 2)
+    {
+      err = v0_2::load(stream, detail, progress, version.version, region_count);
+    }
+    else if (version.version.major == 0 && version.version.minor == 4)
+    {
+      err = v0_4::load(stream, detail, progress, version.version, region_count);
+    }
+    else if (version.version.major == 0 && version.version.minor == 5)
+    {
+      err = v0_5::load(stream, detail, progress, version.version, region_count);
+    }
+    else if (version.version.major == 0 && version.version.minor == 6)
+    {
+      // Filtering is applied while loading.
+      return v0_6::load(stream, detail, progress, version.version, version.region_table_offset, version.region_codec,
+                        filter);
+    }
+  }
+
+  if (!err && filter)
+  {
+    cullLoadedRegions(detail, filter);
+  }
+
+  return err;
+}
+}  // namespace
+
+
 int save(const std::string &filename, const OccupancyMap &map, SerialiseProgress *progress)
 {
   OutputStream stream(filename, kSfCompress);
@@ -603,13 +689,19 @@ int save(const std::string &filename, const OccupancyMap &map, SerialiseProgress
     return kSeFileCreateFailure;
   }
 
+  // Block region creation and removal while saving. Lookups may continue.
+  std::shared_lock<const ChunkMap> guard(detail.chunks);
+
   if (progress)
   {
     progress->setTargetProgress(unsigned(detail.chunks.size()));
   }
 
+  const VoxelCodec::Ptr codec = VoxelCodec::create(VoxelCodec::kZLib);
+
   // Header is written uncompressed.
-  int err = saveHeader(stream, detail);
+  size_t region_table_offset_pos = 0;
+  int err = saveHeader(stream, detail, *codec, region_table_offset_pos);
 
   if (err)
   {
@@ -631,26 +723,147 @@ int save(const std::string &filename, const OccupancyMap &map, SerialiseProgress
     return err;
   }
 
-  for (auto region_iter = detail.chunks.begin(); region_iter != detail.chunks.end() && (!progress || !progress->quit());
-       ++region_iter)
+  // Complete the compressed section. Regions are compressed independently and written raw.
+  stream.flush();
+
+  // Write regions in order of their coordinates so spatially close regions are close in the file.
+  std::vector<const MapChunk *> chunks;
+  chunks.reserve(detail.chunks.size());
+  for (const auto &region : detail.chunks)
   {
-    err = saveChunk(stream, *region_iter->second, detail);
-    if (err)
+    chunks.emplace_back(region.second);
+  }
+  std::sort(chunks.begin(), chunks.end(), [](const MapChunk *a, const MapChunk *b) {
+    const glm::i16vec3 &ca = a->region.coord;
+    const glm::i16vec3 &cb = b->region.coord;
+    return ca.z < cb.z || ca.z == cb.z && (ca.y < cb.y || ca.y == cb.y && ca.x < cb.x);
+  });
+
+  std::vector<v0_6::RegionTableEntry> region_table;
+  region_table.reserve(chunks.size());
+  std::vector<std::vector<uint8_t>> compressed(std::min(kSaveBatchSize, chunks.size()));
+  std::vector<int> errors(compressed.size());
+
+  const auto save_chunk = [&](size_t batch_start, size_t i, std::vector<uint8_t> &uncompressed) {
+    v0_6::RegionTableEntry &entry = region_table[batch_start + i];
+    uncompressed.clear();
+    errors[i] = v0_6::saveChunk(uncompressed, *chunks[batch_start + i], detail);
+    if (!errors[i] && !codec->compress(uncompressed.data(), uncompressed.size(), compressed[i]))
     {
-      return err;
+      errors[i] = kSeCompressionFailure;
+    }
+    // Region sizes are stored as 32-bit values in the region table.
+    if (!errors[i] && (uncompressed.size() > std::numeric_limits<uint32_t>::max() ||
+                       compressed[i].size() > std::numeric_limits<uint32_t>::max()))
+    {
+      errors[i] = kSeDataItemTooLarge;
+    }
+    entry.uncompressed_size = uint32_t(uncompressed.size());
+  };
+
+#ifdef OHM_THREADS
+  tbb::enumerable_thread_specific<std::vector<uint8_t>> uncompressed_buffers;
+#else   // OHM_THREADS
+  std::vector<uint8_t> uncompressed_buffer;
+#endif  // OHM_THREADS
+
+  for (size_t batch_start = 0; batch_start < chunks.size() && (!progress || !progress->quit());
+       batch_start += kSaveBatchSize)
+  {
+    const size_t batch_count = std::min(kSaveBatchSize, chunks.size() - batch_start);
+    region_table.resize(batch_start + batch_count);
+
+    // Compress the regions in parallel.
+#ifdef OHM_THREADS
+    tbb::parallel_for(size_t(0), batch_count,
+                      [&](size_t i) { save_chunk(batch_start, i, uncompressed_buffers.local()); });
+#else   // OHM_THREADS
+    for (size_t i = 0; i < batch_count; ++i)
+    {
+      save_chunk(batch_start, i, uncompressed_buffer);
     }
+#endif  // OHM_THREADS
 
-    if (progress)
+    // Write in order.
+    for (size_t i = 0; i < batch_count; ++i)
     {
-      progress->incrementProgress();
+      if (errors[i])
+      {
+        return errors[i];
+      }
+
+      v0_6::RegionTableEntry &entry = region_table[batch_start + i];
+      entry.coord = chunks[batch_start + i]->region.coord;
+      entry.offset = stream.tell();
+      entry.compressed_size = uint32_t(compressed[i].size());
+      if (stream.writeUncompressed(compressed[i].data(), entry.compressed_size) != entry.compressed_size)
+      {
+        return kSeFileWriteFailure;
+      }
+
+      if (progress)
+      {
+        progress->incrementProgress();
+      }
     }
   }
 
+  // Write the region table, then update the header to reference it.
+  const uint64_t region_table_offset = stream.tell();
+  err = v0_6::saveRegionTable(stream, region_table);
+  if (err)
+  {
+    return err;
+  }
+
+  stream.seek(region_table_offset_pos);
+  if (!writeUncompressed<uint64_t>(stream, region_table_offset))
+  {
+    return kSeFileWriteFailure;
+  }
+
   return kSeOk;
 }
 
 
 int load(const std::string &filename, OccupancyMap &map, SerialiseProgress *progress, MapVersion *version_out)
+{
+  return load(filename, map, progress, version_out, RegionFilter());
+}
+
+
+int loadRegions(const std::string &filename, OccupancyMap &map, const std::vector<glm::i16vec3> &regions,
+                SerialiseProgress *progress, MapVersion *version_out)
+{
+  const std::unordered_set<glm::i16vec3, Vector3Hash<glm::i16vec3>> region_set(regions.begin(), regions.end());
+  const auto filter = [&region_set](const glm::i16vec3 &region) { return region_set.find(region) != region_set.end(); };
+  return load(filename, map, progress, version_out, filter);
+}
+
+
+int loadRegion(const std::string &filename, OccupancyMap &map, const glm::i16vec3 &region, MapVersion *version_out)
+{
+  const auto filter = [region](const glm::i16vec3 &coord) { return coord == region; };
+  return load(filename, map, nullptr, version_out, filter);
+}
+
+
+int loadExtents(const std::string &filename, OccupancyMap &map, const glm::dvec3 &min_extents,
+                const glm::dvec3 &max_extents, SerialiseProgress *progress, MapVersion *version_out)
+{
+  // The map origin and region size are not known until the header is loaded. Both are set before the filter is used.
+  const OccupancyMapDetail &detail = *map.detail();
+  const Aabb box(min_extents, max_extents);
+  const auto filter = [&detail, &box](const glm::i16vec3 &region) {
+    const glm::dvec3 region_extents = detail.region_spatial_dimensions;
+    const glm::dvec3 centre = detail.origin + glm::dvec3(region) * region_extents;
+    return box.overlaps(Aabb(centre - 0.5 * region_extents, centre + 0.5 * region_extents));
+  };
+  return load(filename, map, progress, version_out, filter);
+}
+
+
+int loadPaged(const std::string &filename, OccupancyMap &map, size_t resident_budget, MapVersion *version_out)
 {
   InputStream stream(filename, kSfCompress);
   OccupancyMapDetail &detail = *map.detail();
@@ -676,32 +889,45 @@ int load(const std::string &filename, OccupancyMap &map, SerialiseProgress *prog
     return err;
   }
 
-  err = kSeUnsupportedVersion;
-  if (version.marker == 0 || version.version.major == 0 && version.version.minor == 0)
+  // Paging requires the region table.
+  if (version.marker == 0 || version.version.major == 0 && version.version.minor < 6)
   {
-    err = v0::load(stream, detail, progress, version.version, region_count);
+    return kSeUnsupportedVersion;
   }
-  else if (kSupportedVersionMin <= version.version && version.version <= kSupportedVersionMax)
+
+  err = v0_2::loadMapInfo(stream, detail.info);
+  if (err)
   {
-    if (version.version.major == 0 && version.version.minor == 1)
-    {
-      err = v0_1::load(stream, detail, progress, version.version, region_count);
-    }
-    else if (version.version.major == 0 && version.version.minor == 2)
-    {
-      err = v0_2::load(stream, detail, progress, version.version, region_count);
-    }
-    else if (version.version.major == 0 && version.version.minor == 4)
-    {
-      err = v0_4::load(stream, detail, progress, version.version, region_count);
-    }
-    else if (version.version.major == 0 && version.version.minor == 5)
-    {
-      err = v0_5::load(stream, detail, progress, version.version, region_count);
-    }
+    return err;
   }
 
-  return err;
+  err = v0_1::loadLayout(stream, detail);
+  if (err)
+  {
+    return err;
+  }
+
+  std::vector<v0_6::RegionTableEntry> region_table;
+  err = v0_6::loadRegionTable(stream, version.region_table_offset, region_table);
+  if (err)
+  {
+    return err;
+  }
+
+  VoxelCodec::Ptr codec = VoxelCodec::create(VoxelCodec::Type(version.region_codec));
+  if (!codec)
+  {
+    return kSeCompressionFailure;
+  }
+
+  auto pager = std::make_unique<RegionPager>(detail);
+  if (!pager->open(filename, region_table, codec, resident_budget))
+  {
+    return kSeFileOpenFailure;
+  }
+
+  detail.pager = std::move(pager);
+  return kSeOk;
 }
 
 
@@ -12,6 +12,7 @@
 
 #include <cinttypes>
 #include <string>
+#include <vector>
 
 #ifdef major
 #undef major
@@ -57,6 +58,12 @@ enum SerialisationError
   /// A previously supported version, but one which does not support upgrading.
   kSeDeprecatedVersion,
 
+  /// Failed to compress or decompress region data, or the compression codec is not supported.
+  kSeCompressionFailure,
+
+  /// A map journal is invalid or does not match the map layout.
+  kSeJournalMismatch,
+
   kSeExtensionCode = 0x1000
 };
 
@@ -187,6 +194,9 @@ void ohm_API registerSerialiseExtensionErrorCodeString(int err, const char *erro
 /// a @c SerialiseProgress object via @p progress. That object may also be used to abort serialisation
 /// should it's @c SerialiseProgress::quit() method report @c true.
 ///
+/// Regions are compressed independently, in parallel where threading is available, and indexed by a region table at
+/// the end of the file. This supports parallel loading and loading a subset of the regions - see @c loadRegions() .
+///
 /// @param filename The name of the file to save to.
 /// @param map The map to save.
 /// @param progress Optional progress tracking object.
@@ -209,6 +219,76 @@ int ohm_API save(const std::string &filename, const OccupancyMap &map, Serialise
 int ohm_API load(const std::string &filename, OccupancyMap &map, SerialiseProgress *progress = nullptr,
                  MapVersion *version_out = nullptr);
 
+/// Load only the regions @p regions of @p filename into @p map .
+///
+/// This behaves like @c load() , replacing the current content of @p map , except that only the listed regions are
+/// loaded. Regions not present in the file are ignored.
+///
+/// From map format version 0.6 each region is compressed independently and indexed by a region table, so only the
+/// requested regions are read and decompressed. Older versions must be loaded in full, then culled to the requested
+/// regions.
+///
+/// @param filename The name of the file to load from.
+/// @param map The map object to load into.
+/// @param regions The coordinates of the regions to load.
+/// @param progress Optional progress tracking object.
+/// @param[out] version_out When present, set to the version number of the loaded map format.
+/// @return @c SE_OK on success, or a non zero @c SerialisationError on failure.
+int ohm_API loadRegions(const std::string &filename, OccupancyMap &map, const std::vector<glm::i16vec3> &regions,
+                        SerialiseProgress *progress = nullptr, MapVersion *version_out = nullptr);
+
+/// Load the single region @p region of @p filename into @p map . See @c loadRegions() .
+///
+/// @param filename The name of the file to load from.
+/// @param map The map object to load into.
+/// @param region The coordinate of the region to load.
+/// @param[out] version_out When present, set to the version number of the loaded map format.
+/// @return @c SE_OK on success, or a non zero @c SerialisationError on failure.
+int ohm_API loadRegion(const std::string &filename, OccupancyMap &map, const glm::i16vec3 &region,
+                       MapVersion *version_out = nullptr);
+
+/// Load the regions of @p filename which overlap the axis aligned box defined by @p min_extents and @p max_extents
+/// into @p map . See @c loadRegions() .
+///
+/// The region selection matches @c OccupancyMap::cullRegionsOutside() : any region which overlaps the box is loaded.
+///
+/// @param filename The name of the file to load from.
+/// @param map The map object to load into.
+/// @param min_extents The minimum extents of the box to load, in global map coordinates.
+/// @param max_extents The maximum extents of the box to load, in global map coordinates.
+/// @param progress Optional progress tracking object.
+/// @param[out] version_out When present, set to the version number of the loaded map format.
+/// @return @c SE_OK on success, or a non zero @c SerialisationError on failure.
+int ohm_API loadExtents(const std::string &filename, OccupancyMap &map, const glm::dvec3 &min_extents,
+                        const glm::dvec3 &max_extents, SerialiseProgress *progress = nullptr,
+                        MapVersion *version_out = nullptr);
+
+/// Open @p filename as a paged map, loading regions into @p map on demand.
+///
+/// This loads the map header and layout, then memory maps the file. No regions are initially loaded. Instead,
+/// @c OccupancyMap::region() pages regions in from the file when first accessed. This allows maps larger than the
+/// available memory to be queried and supports near instant startup.
+///
+/// At most @p resident_budget regions are kept in memory, evicting the least recently used regions as required. Only
+/// unmodified regions are evicted. Regions which are modified or created in memory are kept resident, giving copy on
+/// write semantics, and count against the budget. The file is never modified.
+///
+/// Map iteration, @c OccupancyMap::regionCount() and @c OccupancyMap::enumerateRegions() only consider resident
+/// regions. @c OccupancyMap::pagedRegionCount() , @c OccupancyMap::enumerateRegionKeys() and
+/// @c OccupancyMap::calculateExtents() include regions which are not resident. Paging is detached by
+/// @c OccupancyMap::clear() .
+///
+/// Only map format version 0.6 and later support paging.
+///
+/// @param filename The name of the file to open.
+/// @param map The map object to load into. The current content is cleared.
+/// @param resident_budget The maximum number of regions to keep resident. Zero for no limit.
+/// @param[out] version_out When present, set to the version number of the loaded map format.
+/// @return @c SE_OK on success, or a non zero @c SerialisationError on failure. Older map versions fail with
+///   @c kSeUnsupportedVersion .
+int ohm_API loadPaged(const std::string &filename, OccupancyMap &map, size_t resident_budget,
+                      MapVersion *version_out = nullptr);
+
 /// Loads the header and layers of a map file without loading the chunks for voxel data.
 ///
 /// The resulting @p map contains no chunks or voxel data, but does contain valid @c MapLayout data.
@@ -10,6 +10,7 @@
 #include "private/OccupancyMapDetail.h"
 #include "private/OccupancyQueryAlg.h"
 
+#include "ChunkOccupancySummary.h"
 #include "DefaultLayer.h"
 #include "Key.h"
 #include "MapChunk.h"
@@ -25,7 +26,6 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <algorithm>
-#include <functional>
 #include <iostream>
 
 namespace ohm
@@ -35,54 +35,24 @@ namespace
 unsigned regionNearestNeighboursCpu(OccupancyMap &map, NearestNeighboursDetail &query, const glm::i16vec3 &region_key,
                                     ClosestResult &closest)
 {
-  const float invalid_occupancy_value = unobservedOccupancyValue();
   const OccupancyMapDetail &map_data = *map.detail();
-  const auto chunk_search = map_data.chunks.find(region_key);
-  glm::vec3 query_origin;
-  glm::vec3 voxel_vector;
-  Key voxel_key(nullptr);
-  const MapChunk *chunk = nullptr;
-  const uint8_t *occupancy_mem = nullptr;
-  float range_squared = 0;
+  const bool unknown_as_occupied = (query.query_flags & ohm::kQfUnknownAsOccupied) != 0;
+  // Use the map to resolve the region so that paged maps are supported.
+  const MapChunk *const chunk = map.region(region_key);
+  const ChunkOccupancySummary *summary = (chunk) ? chunk->occupancySummary() : nullptr;
+  const glm::vec3 query_origin = glm::vec3(query.near_point - map.origin());
   unsigned added = 0;
-  VoxelBuffer<VoxelBlock> voxel_buffer;
 
-  std::function<bool(float, const OccupancyMapDetail &)> voxel_occupied_func;
-
-  query_origin = glm::vec3(query.near_point - map.origin());
-
-  if (chunk_search == map_data.chunks.end())
+  if (!chunk && !unknown_as_occupied)
   {
-    // The entire region is unknown space...
-    if ((query.query_flags & ohm::kQfUnknownAsOccupied) == 0)
-    {
-      // ... and unknown space is considered free. No results to add.
-      return 0;
-    }
-
-    // ... and we have to treat unknown space as occupied.
-    chunk = nullptr;
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-    occupancy_mem = reinterpret_cast<const uint8_t *>(&invalid_occupancy_value);
-    // Setup voxel occupancy test function to pass all voxels in this region.
-    voxel_occupied_func = [](const float /*voxel*/, const OccupancyMapDetail & /*map_data*/) -> bool { return true; };
+    // The entire region is unknown space and unknown space is considered free. No results to add.
+    return 0;
   }
-  else
+
+  if (summary && summary->totals().occupied == 0 && (!unknown_as_occupied || summary->totals().unobserved == 0))
   {
-    chunk = chunk_search->second;
-    // FIXME: (KS) This is a bit of a mix of legacy direct voxel access and newer VoxelBlock access. Makes things a
-    // bit unclear.
-    voxel_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[chunk->layout().occupancyLayer()]);
-    occupancy_mem = voxel_buffer.voxelMemory();
-    // Setup the voxel test function to check the occupancy threshold and behaviour flags.
-    voxel_occupied_func = [&query](const float voxel, const OccupancyMapDetail &map_data) -> bool {
-      if (voxel == unobservedOccupancyValue())
-      {
-        return query.query_flags & ohm::kQfUnknownAsOccupied;
-      }
-      return (voxel >= map_data.occupancy_threshold_value ||
-              (query.query_flags & ohm::kQfUnknownAsOccupied) && voxel == unobservedOccupancyValue());
-    };
+    // Nothing to add from the summary.
+    return 0;
   }
 
   TES_STMT(std::vector<tes::Vector3d> includedOccupied);
@@ -92,62 +62,70 @@ unsigned regionNearestNeighboursCpu(OccupancyMap &map, NearestNeighboursDetail &
   // TES_BOX_W(g_tes, TES_COLOUR(LightSeaGreen), 0u,
   //           glm::value_ptr(region_centre), glm::value_ptr(map.regionSpatialResolution()));
 
-  float occupancy;
-  for (int z = 0; z < map_data.region_voxel_dimensions.z; ++z)
-  {
-    for (int y = 0; y < map_data.region_voxel_dimensions.y; ++y)
+  // Add an occupied voxel, or invalid voxel to be treated as occupied, if it is within the search radius.
+  const auto add_voxel = [&](const Key &voxel_key, bool unobserved) {
+    // Calculate range to centre.
+    glm::vec3 voxel_vector = map.voxelCentreLocal(voxel_key);
+    voxel_vector -= query_origin;
+    const float range_squared = glm::dot(voxel_vector, voxel_vector);
+    if (range_squared <= query.search_radius * query.search_radius)
     {
-      for (int x = 0; x < map_data.region_voxel_dimensions.x; ++x)
+      query.intersected_voxels.push_back(voxel_key);
+      query.ranges.push_back(std::sqrt(range_squared));
+
+      if (range_squared < closest.range)
       {
-        memcpy(&occupancy, occupancy_mem, sizeof(float));
-        if (voxel_occupied_func(occupancy, map_data))
-        {
-          // Occupied voxel, or invalid voxel to be treated as occupied.
-          // Calculate range to centre.
-          voxel_key = Key(region_key, x, y, z);
-          voxel_vector = map.voxelCentreLocal(voxel_key);
-          voxel_vector -= query_origin;
-          range_squared = glm::dot(voxel_vector, voxel_vector);
-          if (range_squared <= query.search_radius * query.search_radius)
-          {
-            query.intersected_voxels.push_back(voxel_key);
-            query.ranges.push_back(std::sqrt(range_squared));
-
-            if (range_squared < closest.range)
-            {
-              closest.index = query.intersected_voxels.size() - 1;
-              closest.range = range_squared;
-            }
-
-            ++added;
+        closest.index = query.intersected_voxels.size() - 1;
+        closest.range = range_squared;
+      }
+
+      ++added;
 #ifdef TES_ENABLE
-            if (occupancy != unobservedOccupancyValue())
-            {
-              includedOccupied.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
-            }
-            else
-            {
-              includedUncertain.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
-            }
+      if (!unobserved)
+      {
+        includedOccupied.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
+      }
+      else
+      {
+        includedUncertain.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
+      }
 #endif  // TES_ENABLE
-          }
+    }
 #ifdef TES_ENABLE
-          else
-          {
-            if (occupancy != unobservedOccupancyValue())
-            {
-              excludedOccupied.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
-            }
-            else
-            {
-              excludedUncertain.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
-            }
-          }
+    else
+    {
+      if (!unobserved)
+      {
+        excludedOccupied.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
+      }
+      else
+      {
+        excludedUncertain.emplace_back(tes::Vector3d(glm::value_ptr(map.voxelCentreGlobal(voxel_key))));
+      }
+    }
 #endif  // TES_ENABLE
-        }
+    (void)unobserved;
+  };
 
-        // Next voxel. Leave pointer as is (pointing to invalid_occupancy_value) if the chunk is invalid.
-        occupancy_mem += (chunk != nullptr) ? sizeof(occupancy) : 0;
+  if (summary)
+  {
+    // Only visit the voxels marked in the summary bitmasks. This preserves the voxel ordering of a full scan.
+    summary->visitVoxels(true, unknown_as_occupied, [&](unsigned voxel_index) {
+      const glm::u8vec3 local_key = voxelLocalKey(voxel_index, map_data.region_voxel_dimensions);
+      add_voxel(Key(region_key, local_key), summary->isUnobserved(voxel_index));
+    });
+  }
+  else
+  {
+    // The entire region is unknown space and we have to treat unknown space as occupied.
+    for (int z = 0; z < map_data.region_voxel_dimensions.z; ++z)
+    {
+      for (int y = 0; y < map_data.region_voxel_dimensions.y; ++y)
+      {
+        for (int x = 0; x < map_data.region_voxel_dimensions.x; ++x)
+        {
+          add_voxel(Key(region_key, x, y, z), true);
+        }
       }
     }
   }
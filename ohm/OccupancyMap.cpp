@@ -22,6 +22,13 @@
 #include "OccupancyUtil.h"
 
 #include "private/OccupancyMapDetail.h"
+#include "private/RegionPager.h"
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif  // OHM_THREADS
 
 #include <algorithm>
 #include <cassert>
@@ -31,12 +38,45 @@
 #include <cstring>
 #include <functional>
 #include <limits>
+#include <shared_mutex>
 #include <utility>
 
 namespace ohm
 {
 namespace
 {
+/// Invoke @p func for each index in <tt>[0, count)</tt> , in parallel unless @p thread_count is 1.
+/// @param count The number of items to process.
+/// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
+/// @param func The function to invoke for each item index. Must be thread safe unless @p thread_count is 1.
+template <typename Func>
+void forEachIndex(size_t count, unsigned thread_count, Func &&func)
+{
+#ifdef OHM_THREADS
+  if (thread_count != 1 && count > 1)
+  {
+    tbb::task_arena arena(thread_count ? int(thread_count) : int(tbb::task_arena::automatic));
+    arena.execute([&]() {
+      tbb::parallel_for(tbb::blocked_range<size_t>(0u, count), [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); ++i)
+        {
+          func(i);
+        }
+      });
+    });
+    return;
+  }
+#else   // OHM_THREADS
+  (void)thread_count;
+#endif  // OHM_THREADS
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    func(i);
+  }
+}
+
+
 inline Key firstKeyForChunk(const OccupancyMapDetail &map, const MapChunk &chunk)
 {
 #ifdef OHM_VALIDATION
@@ -112,7 +152,7 @@ OccupancyMap::base_iterator::base_iterator(OccupancyMap *map, const Key &key)  /
   ChunkMap::iterator &chunk_iter = initChunkIter(chunk_mem_.data());
   if (!key.isNull())
   {
-    std::unique_lock<decltype(map->detail()->mutex)> guard(map->detail()->mutex);
+    std::shared_lock<ChunkMap> guard(map->detail()->chunks);
     chunk_iter = map->detail()->chunks.find(key.regionKey());
   }
 }
@@ -283,16 +323,30 @@ size_t OccupancyMap::calculateApproximateMemory() const
   byte_count += sizeof(*this);
   if (imp_)
   {
-    std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+    std::shared_lock<ChunkMap> guard(imp_->chunks);
 
     const size_t chunk_count = (!imp_->chunks.empty()) ? imp_->chunks.size() : imp_->loaded_region_count;
     byte_count += sizeof(OccupancyMapDetail);
     byte_count += chunk_count * sizeof(MapChunk);
 
-    for (unsigned i = 0; i < imp_->layout.layerCount(); ++i)
+    if (!imp_->chunks.empty())
     {
-      const MapLayer &layer = imp_->layout.layer(i);
-      byte_count += chunk_count * layer.layerByteSize(imp_->region_voxel_dimensions);
+      // Sum the actual voxel allocations. Uniform and compressed blocks are much smaller than the dense layer size.
+      for (auto &&chunk_ref : imp_->chunks)
+      {
+        for (unsigned i = 0; i < imp_->layout.layerCount(); ++i)
+        {
+          byte_count += chunk_ref.second->voxel_blocks[i]->allocatedByteSize();
+        }
+      }
+    }
+    else
+    {
+      for (unsigned i = 0; i < imp_->layout.layerCount(); ++i)
+      {
+        const MapLayer &layer = imp_->layout.layer(i);
+        byte_count += chunk_count * layer.layerByteSize(imp_->region_voxel_dimensions);
+      }
     }
 
     // Approximate hash map usage.
@@ -398,9 +452,17 @@ bool OccupancyMap::calculateExtents(glm::dvec3 *min_ext, glm::dvec3 *max_ext, Ke
 {
   glm::dvec3 region_min;
   glm::dvec3 region_max;
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  std::shared_lock<ChunkMap> guard(imp_->chunks);
+  // Regions in a paged map file contribute to the extents whether or not they are resident.
+  std::vector<glm::i16vec3> paged_regions;
+  if (imp_->pager)
+  {
+    imp_->pager->regionKeys(paged_regions);
+  }
+
   // Empty map if there are no chunks or the voxel dimensions are zero (latter just shouldn't happen).
-  if (imp_->chunks.empty() || glm::any(glm::equal(imp_->region_voxel_dimensions, glm::u8vec3(0))))
+  if ((imp_->chunks.empty() && paged_regions.empty()) ||
+      glm::any(glm::equal(imp_->region_voxel_dimensions, glm::u8vec3(0))))
   {
     // Empty map. Use the origin.
     if (min_ext)
@@ -428,10 +490,8 @@ bool OccupancyMap::calculateExtents(glm::dvec3 *min_ext, glm::dvec3 *max_ext, Ke
   glm::i16vec3 max_region_key(std::numeric_limits<int16_t>::min());
   bool have_extents = false;
 
-  for (auto &&chunk : imp_->chunks)
-  {
-    const MapRegion region = chunk.second->region;
-    region_min = region_max = region.centre;
+  const auto add_region = [&](const glm::i16vec3 &coord, const glm::dvec3 &centre) {
+    region_min = region_max = centre;
     region_min -= 0.5 * regionSpatialResolution();
     region_max += 0.5 * regionSpatialResolution();
 
@@ -443,14 +503,24 @@ bool OccupancyMap::calculateExtents(glm::dvec3 *min_ext, glm::dvec3 *max_ext, Ke
     max_spatial.y = std::max(max_spatial.y, region_max.y);
     max_spatial.z = std::max(max_spatial.z, region_max.z);
 
-    min_region_key.x = std::min(region.coord.x, min_region_key.x);
-    min_region_key.y = std::min(region.coord.y, min_region_key.y);
-    min_region_key.z = std::min(region.coord.z, min_region_key.z);
-    max_region_key.x = std::max(region.coord.x, max_region_key.x);
-    max_region_key.y = std::max(region.coord.y, max_region_key.y);
-    max_region_key.z = std::max(region.coord.z, max_region_key.z);
+    min_region_key.x = std::min(coord.x, min_region_key.x);
+    min_region_key.y = std::min(coord.y, min_region_key.y);
+    min_region_key.z = std::min(coord.z, min_region_key.z);
+    max_region_key.x = std::max(coord.x, max_region_key.x);
+    max_region_key.y = std::max(coord.y, max_region_key.y);
+    max_region_key.z = std::max(coord.z, max_region_key.z);
 
     have_extents = true;
+  };
+
+  for (auto &&chunk : imp_->chunks)
+  {
+    add_region(chunk.second->region.coord, chunk.second->region.centre);
+  }
+
+  for (const glm::i16vec3 &coord : paged_regions)
+  {
+    add_region(coord, regionCentreGlobal(coord));
   }
 
   // Finalise the min/max voxel keys.
@@ -612,7 +682,7 @@ void OccupancyMap::addLayer(const char *layer_name, const std::function<void(Map
 }
 
 
-void OccupancyMap::updateLayout(const MapLayout &new_layout, bool preserve_map)
+void OccupancyMap::updateLayout(const MapLayout &new_layout, bool preserve_map, unsigned thread_count)
 {
   // First check if there is a difference between the @c MapLayout and the actual layout.
   // There's no work to do otherwise.
@@ -661,17 +731,25 @@ void OccupancyMap::updateLayout(const MapLayout &new_layout, bool preserve_map)
       }
     }
 
-    // Walk the chunks preserving which layers we can.
+    // Walk the chunks preserving which layers we can. Each chunk is updated independently, so we can do so in
+    // parallel.
+    std::unique_lock<ChunkMap> guard(imp_->chunks);
+    std::vector<MapChunk *> chunks;
+    chunks.reserve(imp_->chunks.size());
     for (auto &chunk : imp_->chunks)
     {
-      chunk.second->updateLayout(&new_layout, layer_mapping);
+      chunks.emplace_back(chunk.second);
     }
+    forEachIndex(chunks.size(), thread_count,
+                 [&](size_t i) { chunks[i]->updateLayout(&new_layout, layer_mapping); });
   }
   else
   {
     clear();
   }
 
+  // Pooled chunks match the old layout.
+  imp_->chunk_pool.clear();
   imp_->layout = new_layout;
 
   // Now reallocate any GPU cache which relies on the occupancy layer.
@@ -684,10 +762,34 @@ void OccupancyMap::updateLayout(const MapLayout &new_layout, bool preserve_map)
 
 size_t OccupancyMap::regionCount() const
 {
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
   return imp_->chunks.size();
 }
 
+
+size_t OccupancyMap::pagedRegionCount() const
+{
+  if (!imp_->pager)
+  {
+    return imp_->chunks.size();
+  }
+
+  std::vector<glm::i16vec3> region_keys;
+  enumerateRegionKeys(region_keys);
+  return region_keys.size();
+}
+
+
+void OccupancyMap::setChunkPoolSize(size_t chunk_count)
+{
+  imp_->chunk_pool.setCapacity(chunk_count);
+}
+
+
+size_t OccupancyMap::chunkPoolSize() const
+{
+  return imp_->chunk_pool.capacity();
+}
+
 unsigned OccupancyMap::expireRegions(double timestamp)
 {
   const auto should_remove_chunk = [timestamp](const MapChunk &chunk) { return chunk.touched_time < timestamp; };
@@ -720,6 +822,28 @@ unsigned OccupancyMap::cullRegionsOutside(const glm::dvec3 &min_extents, const g
   return cullRegions(should_remove_chunk);
 }
 
+unsigned OccupancyMap::removeRegions(const std::vector<glm::i16vec3> &region_keys)
+{
+  unsigned removed_count = 0;
+  uint64_t removal_stamp = 0;
+  std::unique_lock<ChunkMap> guard(imp_->chunks);
+  for (const glm::i16vec3 &region_key : region_keys)
+  {
+    const auto region_iter = imp_->chunks.find(region_key);
+    if (region_iter != imp_->chunks.end())
+    {
+      // Stamp the removals only when there are changes.
+      removal_stamp = (removal_stamp) ? removal_stamp : touch();
+      const MapChunk *chunk = region_iter->second;
+      imp_->chunks.erase(region_iter);
+      removeChunk(chunk, removal_stamp);
+      ++removed_count;
+    }
+  }
+
+  return removed_count;
+}
+
 void OccupancyMap::touchRegionTimestampByKey(const glm::i16vec3 &region_key, double timestamp, bool allow_create)
 {
   MapChunk *chunk = region(region_key, allow_create);
@@ -950,13 +1074,14 @@ void OccupancyMap::integrateRays(const glm::dvec3 *rays, size_t element_count, c
   RayMapperOccupancy(this).integrateRays(rays, element_count, intensities, timestamps, ray_update_flags);
 }
 
-OccupancyMap *OccupancyMap::clone() const
+OccupancyMap *OccupancyMap::clone(bool copy_on_write, unsigned thread_count) const
 {
   return clone(-glm::dvec3(std::numeric_limits<double>::infinity()),
-               glm::dvec3(std::numeric_limits<double>::infinity()));
+               glm::dvec3(std::numeric_limits<double>::infinity()), copy_on_write, thread_count);
 }
 
-OccupancyMap *OccupancyMap::clone(const glm::dvec3 &min_ext, const glm::dvec3 &max_ext) const
+OccupancyMap *OccupancyMap::clone(const glm::dvec3 &min_ext, const glm::dvec3 &max_ext, bool copy_on_write,
+                                  unsigned thread_count) const
 {
   auto *new_map = new OccupancyMap(imp_->resolution, imp_->region_voxel_dimensions);
 
@@ -971,7 +1096,9 @@ OccupancyMap *OccupancyMap::clone(const glm::dvec3 &min_ext, const glm::dvec3 &m
   glm::dvec3 region_min;
   glm::dvec3 region_max;
   const glm::dvec3 region_half_ext = 0.5 * imp_->region_spatial_dimensions;
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  // Pairs of source and destination chunks for which to copy voxel data.
+  std::vector<std::pair<const MapChunk *, MapChunk *>> chunk_pairs;
+  std::shared_lock<ChunkMap> guard(imp_->chunks);
   for (const auto &chunk_iter : imp_->chunks)
   {
     const MapChunk *src_chunk = chunk_iter.second;
@@ -984,110 +1111,147 @@ OccupancyMap *OccupancyMap::clone(const glm::dvec3 &min_ext, const glm::dvec3 &m
       MapChunk *dst_chunk = new_map->region(src_chunk->region.coord, true);
       dst_chunk->first_valid_index = src_chunk->first_valid_index;
       dst_chunk->touched_time = src_chunk->touched_time;
-      dst_chunk->dirty_stamp = src_chunk->dirty_stamp.load();
+      dst_chunk->markDirty(src_chunk->dirty_stamp.load());
       dst_chunk->flags = src_chunk->flags;
 
       for (unsigned i = 0; i < imp_->layout.layerCount(); ++i)
       {
         dst_chunk->touched_stamps[i] = static_cast<uint64_t>(src_chunk->touched_stamps[i]);
-        if (src_chunk->voxel_blocks[i])
-        {
-          VoxelBuffer<const VoxelBlock> src_buffer(src_chunk->voxel_blocks[i]);
-          VoxelBuffer<VoxelBlock> dst_buffer(dst_chunk->voxel_blocks[i]);
-          memcpy(dst_buffer.voxelMemory(), src_buffer.voxelMemory(), dst_buffer.voxelMemorySize());
-        }
       }
+      chunk_pairs.emplace_back(src_chunk, dst_chunk);
     }
   }
 
+  // The destination regions have been created above, so the voxel data can be copied in parallel. The data are copied
+  // in their current state, without decompressing, or shared with copy_on_write.
+  const unsigned layer_count = unsigned(imp_->layout.layerCount());
+  forEachIndex(chunk_pairs.size(), thread_count, [&](size_t pair_index) {
+    const MapChunk *src_chunk = chunk_pairs[pair_index].first;
+    MapChunk *dst_chunk = chunk_pairs[pair_index].second;
+    for (unsigned i = 0; i < layer_count; ++i)
+    {
+      if (src_chunk->voxel_blocks[i])
+      {
+        dst_chunk->voxel_blocks[i]->copyFrom(*src_chunk->voxel_blocks[i], copy_on_write);
+      }
+    }
+  });
+
   return new_map;
 }
 
 void OccupancyMap::enumerateRegions(std::vector<const MapChunk *> &chunks) const
 {
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  std::shared_lock<ChunkMap> guard(imp_->chunks);
   for (auto &&chunk_iter : imp_->chunks)
   {
     chunks.push_back(chunk_iter.second);
   }
 }
 
-MapChunk *OccupancyMap::region(const glm::i16vec3 &region_key, bool allow_create)
+void OccupancyMap::enumerateRegionKeys(std::vector<glm::i16vec3> &region_keys) const
 {
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
-  const auto region_search = imp_->chunks.find(region_key);
-  if (region_search != imp_->chunks.end())
+  std::shared_lock<ChunkMap> guard(imp_->chunks);
+  for (auto &&chunk_iter : imp_->chunks)
   {
-    MapChunk *chunk = region_search->second;
-#ifdef OHM_VALIDATION
-    chunk->validateFirstValid(imp_->region_voxel_dimensions);
-#endif  // OHM_VALIDATION
-    return chunk;
+    if (!imp_->pager || !imp_->pager->contains(chunk_iter.first))
+    {
+      region_keys.push_back(chunk_iter.first);
+    }
   }
 
-  if (allow_create)
+  if (imp_->pager)
   {
-    // No such chunk. Create one.
-    MapChunk *chunk = newChunk(Key(region_key, 0, 0, 0));
-    imp_->chunks.insert(std::make_pair(chunk->region.coord, chunk));
-    // No need to touch the map here. We haven't changed the semantics of the map.
-    // That happens when the value of a voxel in the region changes.
-    return chunk;
+    imp_->pager->regionKeys(region_keys);
   }
+}
 
-  return nullptr;
+MapChunk *OccupancyMap::region(const glm::i16vec3 &region_key, bool allow_create)
+{
+  return resolveRegion(region_key, allow_create, false);
 }
 
 const MapChunk *OccupancyMap::region(const glm::i16vec3 &region_key) const
 {
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
-  const auto region_search = imp_->chunks.find(region_key);
-  if (region_search != imp_->chunks.end())
+  return resolveRegion(region_key, false, false);
+}
+
+MapChunk *OccupancyMap::pinRegion(const glm::i16vec3 &region_key, bool allow_create)
+{
+  return resolveRegion(region_key, allow_create, true);
+}
+
+const MapChunk *OccupancyMap::pinRegion(const glm::i16vec3 &region_key) const
+{
+  return resolveRegion(region_key, false, true);
+}
+
+MapChunk *OccupancyMap::resolveRegion(const glm::i16vec3 &region_key, bool allow_create, bool pin) const
+{
+  // Page the region in from file if required.
+  MapChunk *chunk = (imp_->pager) ? imp_->pager->pageIn(region_key, pin) : nullptr;
+  if (!chunk && allow_create)
+  {
+    // Create the chunk if required. This only serialises with other creation and removal in the same shard.
+    // No need to touch the map here. We haven't changed the semantics of the map.
+    // That happens when the value of a voxel in the region changes.
+    bool created = false;
+    chunk = imp_->chunks.lookupOrCreate(
+      region_key,
+      [this, &region_key]() {  //
+        return newChunk(Key(region_key, 0, 0, 0));
+      },
+      &created, pin);
+    if (created && imp_->pager)
+    {
+      imp_->pager->track(region_key);
+    }
+  }
+  else if (!chunk)
   {
-    const MapChunk *chunk = region_search->second;
-    return chunk;
+    chunk = imp_->chunks.lookup(region_key, pin);
   }
 
-  return nullptr;
+#ifdef OHM_VALIDATION
+  if (chunk)
+  {
+    chunk->validateFirstValid(imp_->region_voxel_dimensions);
+  }
+#endif  // OHM_VALIDATION
+  return chunk;
 }
 
 unsigned OccupancyMap::collectDirtyRegions(uint64_t from_stamp,
                                            std::vector<std::pair<uint64_t, glm::i16vec3>> &regions) const
 {
-  // Brute for for now.
-  unsigned added_count = 0;
-  bool added;
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
-  for (auto &&chunk_ref : imp_->chunks)
-  {
-    if (chunk_ref.second->dirty_stamp > from_stamp)
-    {
-      added = false;
+  const size_t initial_size = regions.size();
+  imp_->dirty_chunks.collect(from_stamp, regions);
 
-      // Insertion sorted on the chunk's dirty stamp. Least recently touched (oldtest) first.
-      // TODO(KS): test efficiency of the sorted insertion on a vector.
-      // Scope should be small so I expect little impact.
-      auto item = std::make_pair(chunk_ref.second->dirty_stamp.load(), chunk_ref.second->region.coord);
-      for (auto iter = regions.begin(); iter != regions.end(); ++iter)
-      {
-        if (item.first < iter->first)
-        {
-          regions.insert(iter, item);
-          added = true;
-          break;
-        }
-      }
+  // Sort on the chunk's dirty stamp. Least recently touched (oldtest) first. The new items are sorted then merged
+  // with the existing items, which is equivalent to a sorted insertion of each item, but scales to large numbers of
+  // dirty regions.
+  const auto compare_stamps = [](const std::pair<uint64_t, glm::i16vec3> &a,
+                                 const std::pair<uint64_t, glm::i16vec3> &b) { return a.first < b.first; };
+  const auto first_added = regions.begin() + std::ptrdiff_t(initial_size);
+  std::stable_sort(first_added, regions.end(), compare_stamps);
+  std::inplace_merge(regions.begin(), first_added, regions.end(), compare_stamps);
 
-      if (!added)
-      {
-        regions.push_back(item);
-      }
+  return unsigned(regions.size() - initial_size);
+}
 
-      ++added_count;
+unsigned OccupancyMap::collectRemovedRegions(uint64_t from_stamp, std::vector<glm::i16vec3> &regions) const
+{
+  const size_t initial_size = regions.size();
+  std::shared_lock<ChunkMap> guard(imp_->chunks);
+  for (const auto &removed : imp_->removed_regions)
+  {
+    if (removed.second > from_stamp)
+    {
+      regions.emplace_back(removed.first);
     }
   }
 
-  return added_count;
+  return unsigned(regions.size() - initial_size);
 }
 
 uint64_t OccupancyMap::calculateDirtyExtents(uint64_t from_stamp, glm::i16vec3 *min_ext, glm::i16vec3 *max_ext) const
@@ -1095,7 +1259,7 @@ uint64_t OccupancyMap::calculateDirtyExtents(uint64_t from_stamp, glm::i16vec3 *
   *min_ext = glm::i16vec3(std::numeric_limits<decltype(min_ext->x)>::max());
   *max_ext = glm::i16vec3(std::numeric_limits<decltype(min_ext->x)>::min());
 
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  std::shared_lock<ChunkMap> guard(imp_->chunks);
   const uint64_t at_stamp = imp_->stamp;
   for (auto &&chunk_ref : imp_->chunks)
   {
@@ -1126,7 +1290,7 @@ void OccupancyMap::calculateDirtyClearanceExtents(glm::i16vec3 *min_ext, glm::i1
   *min_ext = glm::i16vec3(std::numeric_limits<decltype(min_ext->x)>::max());
   *max_ext = glm::i16vec3(std::numeric_limits<decltype(min_ext->x)>::min());
 
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  std::shared_lock<ChunkMap> guard(imp_->chunks);
   const int occupancy_layer = imp_->layout.occupancyLayer();
   const int clearance_layer = imp_->layout.clearanceLayer();
 
@@ -1157,7 +1321,7 @@ void OccupancyMap::calculateDirtyClearanceExtents(glm::i16vec3 *min_ext, glm::i1
 
 void OccupancyMap::clear()
 {
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  std::unique_lock<ChunkMap> guard(imp_->chunks);
   // Clear the GPU cache (if present).
   // Must occur before deleting the chunks as it will be referencing some.
   if (imp_->gpu_cache)
@@ -1171,12 +1335,15 @@ void OccupancyMap::clear()
   }
 
   imp_->chunks.clear();
+  imp_->removed_regions.clear();
   imp_->loaded_region_count = 0;
+  // Detach from any map file.
+  imp_->pager.reset();
 }
 
 Key OccupancyMap::firstIterationKey() const
 {
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  std::shared_lock<ChunkMap> guard(imp_->chunks);
   const auto first_chunk_iter = imp_->chunks.begin();
   if (first_chunk_iter != imp_->chunks.end())
   {
@@ -1187,22 +1354,39 @@ Key OccupancyMap::firstIterationKey() const
   return Key::kNull;
 }
 
-MapChunk *OccupancyMap::newChunk(const Key &for_key)
+MapChunk *OccupancyMap::newChunk(const Key &for_key) const
 {
-  auto *chunk =
-    new MapChunk(MapRegion(voxelCentreGlobal(for_key), imp_->origin, imp_->region_spatial_dimensions), *imp_);
-  return chunk;
+  return imp_->chunk_pool.acquire(MapRegion(voxelCentreGlobal(for_key), imp_->origin, imp_->region_spatial_dimensions),
+                                  *imp_);
 }
 
 void OccupancyMap::releaseChunk(const MapChunk *chunk)
 {
-  delete chunk;
+  imp_->chunk_pool.release(chunk);
+}
+
+void OccupancyMap::removeChunk(const MapChunk *chunk, uint64_t removal_stamp)
+{
+  // Remove from the GPU cache.
+  if (imp_->gpu_cache)
+  {
+    imp_->gpu_cache->remove(chunk->region.coord);
+  }
+
+  if (imp_->pager)
+  {
+    imp_->pager->forget(chunk->region.coord);
+  }
+
+  imp_->removed_regions[chunk->region.coord] = removal_stamp;
+  releaseChunk(chunk);
 }
 
 unsigned OccupancyMap::cullRegions(const RegionCullFunc &cull_func)
 {
   unsigned removed_count = 0;
-  std::unique_lock<decltype(imp_->mutex)> guard(imp_->mutex);
+  uint64_t removal_stamp = 0;
+  std::unique_lock<ChunkMap> guard(imp_->chunks);
   auto region_iter = imp_->chunks.begin();
   const MapChunk *chunk = nullptr;
   while (region_iter != imp_->chunks.end())
@@ -1211,15 +1395,10 @@ unsigned OccupancyMap::cullRegions(const RegionCullFunc &cull_func)
 
     if (cull_func(*chunk))
     {
-      // Remove from the GPU cache.
-      if (imp_->gpu_cache)
-      {
-        imp_->gpu_cache->remove(chunk->region.coord);
-      }
-
-      // Culled region. Remove from the map.
+      // Culled region. Remove from the map, stamping the removals only when there are changes.
+      removal_stamp = (removal_stamp) ? removal_stamp : touch();
       region_iter = imp_->chunks.erase(region_iter);
-      releaseChunk(chunk);
+      removeChunk(chunk, removal_stamp);
       ++removed_count;
     }
     else
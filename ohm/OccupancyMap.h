@@ -101,6 +101,10 @@ class RayFilter;
 /// the memory usage. In this mode an @c OccupancyMap uses a background compression thread to compress voxel data. The
 /// background compression thread compresses regions which have not been touched for some time.
 ///
+/// Regardless of compression, each layer of a region holds only a single voxel value until first accessed, and
+/// compression collapses layers where every voxel holds the same value back to a single voxel value. See
+/// @c VoxelBlock .
+///
 /// The background compression does impose a some CPU overhead and latency especially when iterating the map as a
 /// whole to ensure voxel data are uncompressed when needed. The overhead is minimal when not using compression.
 ///
@@ -302,7 +306,8 @@ public:
 
   // Iterator.
   /// Create an iterator to the first voxel in the map. The map should not have voxels added or removed
-  /// during iterator.
+  /// during iterator. Iteration only visits resident regions of a map opened with @c ohm::loadPaged() and
+  /// should not be mixed with voxel access which may page in other regions. See @c enumerateRegionKeys() .
   /// @return An @c iterator to the first voxel in the map, or an invalid iterator when empty.
   iterator begin();
   /// Create a read only iterator to the first voxel in the map. The map should not have voxels added or removed
@@ -318,6 +323,9 @@ public:
   const_iterator end() const;
 
   /// Calculate the approximate memory usage of this map in bytes.
+  ///
+  /// Voxel memory is summed from the current allocation of each @c VoxelBlock , accounting for compressed and uniform
+  /// blocks.
   /// @return The approximate memory usage (bytes).
   size_t calculateApproximateMemory() const;
 
@@ -393,7 +401,8 @@ public:
   /// @return The map origin.
   const glm::dvec3 &origin() const;
 
-  /// Calculate the extents of the map based on existing regions containing known data.
+  /// Calculate the extents of the map based on existing regions containing known data. Includes regions of a paged
+  /// map which are not resident.
   /// @param[out] min_ext Set to the minimum corner of the axis aligned extents. May be nullptr.
   /// @param[out] max_ext Set to the maximum corner of the axis aligned extents. May be nullptr.
   /// @param[out] key_range The key range enclosing the key extents.
@@ -503,14 +512,45 @@ public:
   ///
   /// In both cases the GPU cache is invalidated.
   ///
+  /// Regions are updated in parallel unless @p thread_count is 1. Preserved layers are moved into the new layout
+  /// without copying voxel data, while new layers start in the uniform @c VoxelBlock state.
+  ///
   /// @param new_layout The map layout to update to.
   /// @param preserve_map Try to preserve the map content for equivalent layers?
-  void updateLayout(const MapLayout &new_layout, bool preserve_map = true);
+  /// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
+  ///   Ignored when threading is unavailable.
+  void updateLayout(const MapLayout &new_layout, bool preserve_map = true, unsigned thread_count = 0);
 
   /// Query the number of regions in the map which have been touched.
+  ///
+  /// For maps opened with @c ohm::loadPaged() this only counts the resident regions. Use @c pagedRegionCount() to
+  /// include regions which are in the map file, but not paged in.
   /// @return The number of regions in the map.
   size_t regionCount() const;
 
+  /// Query the number of regions in the map, including regions in the map file of a paged map which are not currently
+  /// resident. Matches @c regionCount() for maps which are not paged.
+  /// @return The number of regions in the map.
+  size_t pagedRegionCount() const;
+
+  /// Set the number of released regions to retain for recycling into new regions.
+  ///
+  /// Regions released by @c expireRegions() , @c removeDistanceRegions() , @c cullRegionsOutside() and @c clear() are
+  /// normally deleted. With a non zero pool size, up to @p chunk_count released @c MapChunk objects are instead
+  /// retained - along with their @c VoxelBlock objects and voxel memory - and recycled when new regions are created.
+  /// This avoids the system allocator in maps which continually create and remove regions, such as sliding window
+  /// maps, at the cost of retaining the memory for up to @p chunk_count regions. The pool is emptied whenever the map
+  /// layout changes.
+  ///
+  /// Pooling is disabled by default.
+  ///
+  /// @param chunk_count The maximum number of regions to pool. Zero to disable pooling and release pooled regions.
+  void setChunkPoolSize(size_t chunk_count);
+
+  /// Query the maximum number of regions to retain for recycling. See @c setChunkPoolSize() .
+  /// @return The chunk pool size.
+  size_t chunkPoolSize() const;
+
   /// Expire @c MapRegion sections which have not been touched after @p timestamp.
   /// Such regions are removed from the map.
   ///
@@ -538,6 +578,12 @@ public:
   /// @return The number of removed regions.
   unsigned cullRegionsOutside(const glm::dvec3 &min_extents, const glm::dvec3 &max_extents);
 
+  /// Remove the regions identified by @p region_keys . Keys of regions which are not present are ignored.
+  ///
+  /// @param region_keys The keys of the regions to remove.
+  /// @return The number of removed regions.
+  unsigned removeRegions(const std::vector<glm::i16vec3> &region_keys);
+
   /// Touch the @c MapRegion which contains @p point .
   /// @param point A spatial point from which to resolve a containing region. There may be border case issues.
   /// @param timestamp The timestamp to update the region touch time to.
@@ -933,19 +979,34 @@ public:
   // Data copy/cloning
   //-------------------------------------------------------
 
-  /// Clone the entire map.
+  /// Clone the entire map. See the extents overload.
+  /// @param copy_on_write True to share compressed voxel data with this map.
+  /// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
   /// @return A deep clone of this map. Caller takes ownership.
-  OccupancyMap *clone() const;
+  OccupancyMap *clone(bool copy_on_write = false, unsigned thread_count = 0) const;
 
   /// Clone the map within the given extents.
   ///
   /// This creates a deep clone of this may, copying only regions which overlap the given extents.
   /// Note that any region which partially overmaps the extents is copied in its entirety.
   ///
+  /// Voxel data are copied region by region in parallel unless @p thread_count is 1. Each voxel layer is copied in
+  /// its current uniform, compressed or uncompressed state without decompressing it (see @c VoxelBlock::copyFrom() ).
+  ///
+  /// With @p copy_on_write , compressed voxel layers are shared with this map rather than copied. Each map decompresses
+  /// a shared layer into its own memory when first accessed, exactly as for an unshared compressed layer, so sharing
+  /// adds no copy to either map. Uncompressed layers, such as those recently accessed, are copied at the time of the
+  /// call so this map can continue to modify them without copying. The clone remains independent of this map either
+  /// way. A snapshot is cheapest for maps with @c MapFlag::kCompressed where most layers are compressed.
+  ///
   /// @param min_ext The minimum spatial extents to over.
   /// @param max_ext The maximum spatial extents to over.
+  /// @param copy_on_write True to share compressed voxel data with this map.
+  /// @param thread_count The number of threads to use: 1 for serial execution, 0 to use all available threads.
+  ///   Ignored when threading is unavailable.
   /// @return A deep clone of this map. Caller takes ownership.
-  OccupancyMap *clone(const glm::dvec3 &min_ext, const glm::dvec3 &max_ext) const;
+  OccupancyMap *clone(const glm::dvec3 &min_ext, const glm::dvec3 &max_ext, bool copy_on_write = false,
+                      unsigned thread_count = 0) const;
 
   //-------------------------------------------------------
   // Internal
@@ -959,10 +1020,22 @@ public:
   inline const OccupancyMapDetail *detail() const { return imp_; }
 
   /// Enumerate the regions within this map.
+  ///
+  /// For maps opened with @c ohm::loadPaged() this only enumerates the resident regions and the chunks may be evicted
+  /// by later page faults on other threads. Use @c enumerateRegionKeys() and @c pinRegion() to visit all regions.
   /// @param[out] chunks The enumerated chunks are added to this container.
   void enumerateRegions(std::vector<const MapChunk *> &chunks) const;
 
+  /// Enumerate the keys of all regions within this map, including regions in the map file of a paged map which are
+  /// not currently resident.
+  /// @param[out] region_keys The enumerated region keys are added to this container.
+  void enumerateRegionKeys(std::vector<glm::i16vec3> &region_keys) const;
+
   /// Fetch a region, potentially creating it. For internal use.
+  ///
+  /// For maps opened with @c ohm::loadPaged() , the returned chunk may be evicted by later page faults on other
+  /// threads unless one of its voxel layers is retained. Use @c pinRegion() to hold a region safely.
+  ///
   /// @param region_key The key of the region to fetch.
   /// @param allow_create Create the region if it doesn't exist?
   /// @return A pointer to the requested region. Null if it doesn't exist and @p allowCreate is @c false.
@@ -971,14 +1044,40 @@ public:
   /// @overload
   const MapChunk *region(const glm::i16vec3 &region_key) const;
 
+  /// Fetch a region as per @c region() and @c MapChunk::pin() it. The pin is applied while the region is locked, so
+  /// the chunk cannot be evicted from a paged map until released with @c MapChunk::unpin() . For internal use.
+  /// @param region_key The key of the region to fetch.
+  /// @param allow_create Create the region if it doesn't exist?
+  /// @return A pointer to the requested, pinned region. Null if it doesn't exist and @p allowCreate is @c false.
+  MapChunk *pinRegion(const glm::i16vec3 &region_key, bool allow_create = false);
+
+  /// @overload
+  const MapChunk *pinRegion(const glm::i16vec3 &region_key) const;
+
   /// Populate @c regions with a list of regions who's touch stamp is greater than the given value.
   ///
   /// Adds to @p regions without clearing it, thus there may be redundancy.
   ///
+  /// Only the regions modified since @p from_stamp are visited, using the modification order tracked by
+  /// @c MapChunk::markDirty() , so the cost scales with the number of dirty regions rather than the size of the map.
+  ///
   /// @param from_stamp The map stamp value from which to fetch regions.
   /// @param regions The list to add to.
+  /// @return The number of regions added.
   unsigned collectDirtyRegions(uint64_t from_stamp, std::vector<std::pair<uint64_t, glm::i16vec3>> &regions) const;
 
+  /// Populate @p regions with the keys of regions removed after @p from_stamp by @c expireRegions() ,
+  /// @c removeDistanceRegions() , @c cullRegionsOutside() or @c removeRegions() . Used to journal removals - see
+  /// @c appendJournal() .
+  ///
+  /// The most recent removal of each region coordinate is retained until @c clear() , whether or not the region has
+  /// since been recreated.
+  ///
+  /// @param from_stamp The map stamp value from which to fetch removed regions.
+  /// @param regions The list to add to.
+  /// @return The number of regions added.
+  unsigned collectRemovedRegions(uint64_t from_stamp, std::vector<glm::i16vec3> &regions) const;
+
   /// Experimental: calculate the extents of regions which have been changed since @c from_stamp .
   /// @param from_stamp The base stamp used to determine dirty regions.
   /// @param min_ext The region key which identifies the minimum extents of the dirty regions.
@@ -997,8 +1096,10 @@ public:
 
 private:
   Key firstIterationKey() const;
-  MapChunk *newChunk(const Key &for_key);
-  static void releaseChunk(const MapChunk *chunk);
+  MapChunk *resolveRegion(const glm::i16vec3 &region_key, bool allow_create, bool pin) const;
+  MapChunk *newChunk(const Key &for_key) const;
+  void releaseChunk(const MapChunk *chunk);
+  void removeChunk(const MapChunk *chunk, uint64_t removal_stamp);
 
   /// Culling function for @c cullRegions().
   using RegionCullFunc = std::function<bool(const MapChunk &)>;
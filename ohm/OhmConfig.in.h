@@ -35,6 +35,8 @@
 #cmakedefine OHM_PROFILE
 #cmakedefine OHM_EMBED_GPU_CODE
 #cmakedefine OHM_WITH_EIGEN
+#cmakedefine OHM_WITH_LZ4
+#cmakedefine OHM_WITH_ZSTD
 
 #ifdef OHM_PROFILE
 #define PROFILING 1
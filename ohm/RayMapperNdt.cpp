@@ -24,6 +24,8 @@
 #include "VoxelIncident.h"
 #include "VoxelTouchTime.h"
 
+#include "private/RegionRayBatch.h"
+
 #include <iostream>
 
 namespace ohm
@@ -81,9 +83,27 @@ RayMapperNdt::RayMapperNdt(NdtMap *map)
 RayMapperNdt::~RayMapperNdt() = default;
 
 
+bool RayMapperNdt::setThreadCount(unsigned thread_count)
+{
+#ifdef OHM_THREADS
+  thread_count_ = thread_count;
+  return true;
+#else   // OHM_THREADS
+  (void)thread_count;
+  thread_count_ = 1;
+  return false;
+#endif  // OHM_THREADS
+}
+
+
 size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count, const float *intensities,
                                    const double *timestamps, unsigned ray_update_flags)
 {
+  if (batched_ || thread_count_ != 1)
+  {
+    return integrateRaysBatched(rays, element_count, intensities, timestamps, ray_update_flags);
+  }
+
   KeyList keys;
   MapChunk *last_chunk = nullptr;
   VoxelBuffer<VoxelBlock> occupancy_buffer;
@@ -183,6 +203,8 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
         // Incidents not required for miss update, but we need it in sync for the update later.
         incidents_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[incident_normal_layer_]);
       }
+      // The stamp is fixed for this call, so mark each chunk dirty once as the walk enters it.
+      chunk->markDirty(touch_stamp);
     }
     last_chunk = chunk;
     const unsigned voxel_index = ohm::voxelIndex(key, occupancy_dim);
@@ -228,7 +250,6 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
     chunk->updateFirstValid(voxel_index);
 
     stop_adjustments = stop_adjustments;
-    chunk->dirty_stamp = touch_stamp;
     // Update the touched_stamps with relaxed memory ordering. The important thing is to have an update,
     // not so much the sequencing. We really don't want to synchronise here.
     chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
@@ -307,6 +328,7 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
         {
           incidents_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[incident_normal_layer_]);
         }
+        chunk->markDirty(touch_stamp);
       }
       last_chunk = chunk;
       const unsigned voxel_index = ohm::voxelIndex(key, occupancy_dim);
@@ -389,7 +411,6 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
       // NOLINTNEXTLINE(clang-analyzer-core.CallAndMessage)
       chunk->updateFirstValid(voxel_index);
 
-      chunk->dirty_stamp = touch_stamp;
       // Update the touched_stamps with relaxed memory ordering. The important thing is to have an update,
       // not so much the sequencing. We really don't want to synchronise here.
       chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
@@ -405,4 +426,216 @@ size_t RayMapperNdt::integrateRays(const glm::dvec3 *rays, size_t element_count,
 
   return element_count / 2;
 }
+
+
+size_t RayMapperNdt::integrateRaysBatched(const glm::dvec3 *rays, size_t element_count, const float *intensities,
+                                          const double *timestamps, unsigned ray_update_flags)
+{
+  OccupancyMap &occupancy_map = map_->map();
+  const auto occupancy_layer = occupancy_layer_;
+  const auto mean_layer = mean_layer_;
+  const auto traversal_layer = traversal_layer_;
+  const auto covariance_layer = covariance_layer_;
+  const auto intensity_layer = intensity_layer_;
+  const auto hit_miss_count_layer = hit_miss_count_layer_;
+  const auto touch_time_layer = (timestamps) ? touch_time_layer_ : -1;
+  const auto incident_normal_layer = incident_normal_layer_;
+  const auto occupancy_dim = occupancy_dim_;
+  const auto miss_value = occupancy_map.missValue();
+  const auto hit_value = occupancy_map.hitValue();
+  const auto resolution = occupancy_map.resolution();
+  const auto voxel_min = occupancy_map.minVoxelValue();
+  const auto voxel_max = occupancy_map.maxVoxelValue();
+  const auto saturation_min = occupancy_map.saturateAtMinValue() ? voxel_min : std::numeric_limits<float>::lowest();
+  const auto saturation_max = occupancy_map.saturateAtMaxValue() ? voxel_max : std::numeric_limits<float>::max();
+  const auto sensor_noise = map_->sensorNoise();
+  const auto ndt_adaptation_rate = map_->adaptationRate();
+  const auto ndt_sample_threshold = map_->ndtSampleThreshold();
+  const auto reinitialise_covariance_threshold = map_->reinitialiseCovarianceThreshold();
+  const auto reinitialise_covariance_point_count = map_->reinitialiseCovariancePointCount();
+  const auto initial_intensity_covariance = map_->initialIntensityCovariance();
+  const bool ndt_tm = ndt_tm_;
+  // Adjustments are never stopped for NDT.
+  const bool stop_adjustments = false;
+  // Touch the map to flag changes.
+  const auto touch_stamp = occupancy_map.touch();
+
+  if (timestamps)
+  {
+    // Update first ray time if not yet set.
+    occupancy_map.updateFirstRayTime(*timestamps);
+  }
+  const double time_base = occupancy_map.firstRayTime();
+
+  RegionRayBatch batch(occupancy_map, thread_count_);
+
+  // Apply all the visits for a single region. The region is owned by the calling thread for the duration of the
+  // update. The logic here mirrors the serial integrateRays() implementation - see comments there.
+  const auto update_region = [&](MapChunk *chunk, const RegionRayBatch::Visit *visits, size_t visit_count) {
+    VoxelBuffer<VoxelBlock> occupancy_buffer(chunk->voxel_blocks[occupancy_layer]);
+    VoxelBuffer<VoxelBlock> mean_buffer(chunk->voxel_blocks[mean_layer]);
+    VoxelBuffer<VoxelBlock> cov_buffer(chunk->voxel_blocks[covariance_layer]);
+    VoxelBuffer<VoxelBlock> intensity_buffer;
+    VoxelBuffer<VoxelBlock> hit_miss_count_buffer;
+    VoxelBuffer<VoxelBlock> traversal_buffer;
+    VoxelBuffer<VoxelBlock> touch_time_buffer;
+    VoxelBuffer<VoxelBlock> incidents_buffer;
+    bool have_sample = false;
+
+    if (ndt_tm)
+    {
+      intensity_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[intensity_layer]);
+      hit_miss_count_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[hit_miss_count_layer]);
+    }
+    if (traversal_layer >= 0)
+    {
+      traversal_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[traversal_layer]);
+    }
+    if (touch_time_layer >= 0)
+    {
+      touch_time_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[touch_time_layer]);
+    }
+    if (incident_normal_layer >= 0)
+    {
+      incidents_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[incident_normal_layer]);
+    }
+
+    for (size_t v = 0; v < visit_count; ++v)
+    {
+      const RegionRayBatch::Visit &visit = visits[v];
+      const RegionRayBatch::Ray &ray = batch.ray(visit.ray);
+      const unsigned voxel_index = ohm::voxelIndex(visit.key, occupancy_dim);
+      const glm::dvec3 voxel_centre = occupancy_map.voxelCentreGlobal(visit.key);
+
+      float occupancy_value;
+      CovarianceVoxel cov;
+      VoxelMean voxel_mean;
+      occupancy_buffer.readVoxel(voxel_index, &occupancy_value);
+      cov_buffer.readVoxel(voxel_index, &cov);
+      mean_buffer.readVoxel(voxel_index, &voxel_mean);
+      const glm::dvec3 mean = subVoxelToLocalCoord<glm::dvec3>(voxel_mean.coord, resolution) + voxel_centre;
+      const float initial_value = occupancy_value;
+      float adjusted_value = initial_value;
+
+      if (!visit.sample)
+      {
+        bool is_miss = false;
+        calculateMissNdt(&cov, &adjusted_value, &is_miss, ray.start, ray.sample, mean, voxel_mean.count,
+                         unobservedOccupancyValue(), miss_value, ndt_adaptation_rate, sensor_noise,
+                         ndt_sample_threshold);
+
+        if (ndt_tm)
+        {
+          HitMissCount hit_miss_count_voxel;
+          hit_miss_count_buffer.readVoxel(voxel_index, &hit_miss_count_voxel);
+          hit_miss_count_voxel.miss_count += (is_miss) ? 1u : 0u;
+          hit_miss_count_buffer.writeVoxel(voxel_index, hit_miss_count_voxel);
+        }
+
+        occupancyAdjustDown(&occupancy_value, initial_value, adjusted_value, unobservedOccupancyValue(), voxel_min,
+                            saturation_min, saturation_max, stop_adjustments);
+        occupancy_buffer.writeVoxel(voxel_index, occupancy_value);
+
+        // Accumulate traversal
+        if (traversal_layer >= 0)
+        {
+          float traversal;
+          traversal_buffer.readVoxel(voxel_index, &traversal);
+          traversal += visit.traversal;
+          traversal_buffer.writeVoxel(voxel_index, traversal);
+        }
+      }
+      else
+      {
+        IntensityMeanCov intensity_voxel;
+        HitMissCount hit_miss_count_voxel;
+        if (ndt_tm)
+        {
+          const float intensity = (intensities) ? intensities[ray.index] : 0.0f;
+          intensity_buffer.readVoxel(voxel_index, &intensity_voxel);
+          hit_miss_count_buffer.readVoxel(voxel_index, &hit_miss_count_voxel);
+
+          const bool reinitialise_permeability_with_covariance = true;  // TODO: make a parameter of map
+          calculateHitMissUpdateOnHit(&cov, adjusted_value, &hit_miss_count_voxel, ray.start, ray.sample, mean,
+                                      voxel_mean.count, unobservedOccupancyValue(),
+                                      reinitialise_permeability_with_covariance, ndt_adaptation_rate, sensor_noise,
+                                      reinitialise_covariance_threshold, reinitialise_covariance_point_count,
+                                      ndt_sample_threshold);
+
+          calculateIntensityUpdateOnHit(&intensity_voxel, adjusted_value, intensity, initial_intensity_covariance,
+                                        voxel_mean.count, reinitialise_covariance_threshold,
+                                        reinitialise_covariance_point_count);
+        }
+
+        const bool reset_mean = calculateHitWithCovariance(
+          &cov, &adjusted_value, ray.sample, mean, voxel_mean.count, hit_value, unobservedOccupancyValue(),
+          float(resolution), reinitialise_covariance_threshold, reinitialise_covariance_point_count);
+        occupancyAdjustUp(&occupancy_value, initial_value, adjusted_value, unobservedOccupancyValue(), voxel_max,
+                          saturation_min, saturation_max, stop_adjustments);
+
+        voxel_mean.count = (!reset_mean) ? voxel_mean.count : 0;
+        voxel_mean.coord = subVoxelUpdate(voxel_mean.coord, voxel_mean.count, ray.sample - voxel_centre, resolution);
+        ++voxel_mean.count;
+
+        occupancy_buffer.writeVoxel(voxel_index, occupancy_value);
+        cov_buffer.writeVoxel(voxel_index, cov);
+        mean_buffer.writeVoxel(voxel_index, voxel_mean);
+        if (ndt_tm)
+        {
+          intensity_buffer.writeVoxel(voxel_index, intensity_voxel);
+          hit_miss_count_buffer.writeVoxel(voxel_index, hit_miss_count_voxel);
+        }
+
+        // Accumulate traversal
+        if (traversal_layer >= 0)
+        {
+          float traversal;
+          traversal_buffer.readVoxel(voxel_index, &traversal);
+          traversal += float(glm::length(ray.sample - ray.start) - ray.last_exit_range);
+          traversal_buffer.writeVoxel(voxel_index, traversal);
+        }
+
+        if (touch_time_layer >= 0)
+        {
+          const unsigned touch_time = encodeVoxelTouchTime(time_base, timestamps[ray.index]);
+          touch_time_buffer.writeVoxel(voxel_index, touch_time);
+        }
+
+        if (incident_normal_layer >= 0)
+        {
+          unsigned packed_normal{};
+          incidents_buffer.readVoxel(voxel_index, &packed_normal);
+          // Point count has already been incremented so subtract one to get the right calculation.
+          packed_normal = updateIncidentNormal(packed_normal, ray.start - ray.sample, voxel_mean.count - 1);
+          incidents_buffer.writeVoxel(voxel_index, packed_normal);
+        }
+
+        have_sample = true;
+      }
+
+      chunk->updateFirstValid(voxel_index);
+    }
+
+    chunk->markDirty(touch_stamp);
+    chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
+    if (ndt_tm)
+    {
+      chunk->touched_stamps[hit_miss_count_layer].store(touch_stamp, std::memory_order_relaxed);
+    }
+    if (have_sample)
+    {
+      chunk->touched_stamps[mean_layer].store(touch_stamp, std::memory_order_relaxed);
+      chunk->touched_stamps[covariance_layer].store(touch_stamp, std::memory_order_relaxed);
+      if (ndt_tm)
+      {
+        chunk->touched_stamps[intensity_layer].store(touch_stamp, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  // Samples are always integrated in NDT, so kRfExcludeSample is ignored as per the serial path.
+  batch.integrate(rays, element_count, ray_update_flags & ~unsigned(kRfExcludeSample), update_region);
+
+  return element_count / 2;
+}
 }  // namespace ohm
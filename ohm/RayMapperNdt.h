@@ -21,11 +21,21 @@ class NdtMap;
 /// @c MayLayout::occupancyLayer() - float occupancy values - , @c MapLayout::meanLayer() - @c VoxelMean - and
 /// @c MapLayout::covarianceLayer() - @c CovarianceVoxel .
 ///
-/// The @c integrateRays() implementation performs a single threaded walk of the voxels to update and touches
-/// those voxels one at a time, updating their occupancy value. Occupancy values are updated using
+/// The @c integrateRays() implementation walks the rays in batches, bucketing the voxel updates by region, then applies
+/// the updates to each region in a single pass, resolving each region and its voxel buffers once per batch. Occupancy
+/// values are updated using
 /// @c calculateMissNdt() for voxels the rays pass through and @c calculateHitWithCovariance() for the sample/end
 /// voxels. Sample voxels also have their @c CovarianceVoxel and @c VoxelMean layers updated.
 ///
+/// A multi-threaded integration may be enabled via @c setThreadCount() . This walks the rays in parallel and buckets
+/// the voxel updates by region. Each region is owned by a single worker thread for the update, so the
+/// @c CovarianceVoxel and other voxel updates require no locking. Within each region, updates are applied in the same
+/// order as the single threaded integration; the sample update for each ray follows that ray's miss updates. The
+/// results are identical to the single threaded integration.
+///
+/// Batching may be disabled via @c setBatched() , in which case the rays are walked in a single thread, updating each
+/// voxel as it is visited.
+///
 /// For reference see:
 /// 3D Normal Distributions Transform Occupancy Maps: An Efficient Representation for Mapping in Dynamic Environments
 class ohm_API RayMapperNdt : public RayMapper
@@ -43,10 +53,33 @@ public:
   /// @return True if valid and @c integrateRays() is safe to call.
   inline bool valid() const override { return valid_; }
 
+  /// Set the number of threads used to walk the rays and update the NDT voxels in @c integrateRays() .
+  ///
+  /// Any value other than 1 selects the batched integration, regardless of @c setBatched() . Zero uses the TBB default
+  /// thread count, while 1 (default) keeps the integration on the calling thread. Covariance and mean updates are
+  /// made by the thread which owns each region, so the results match the single threaded integration.
+  ///
+  /// @param thread_count The number of integration threads.
+  /// @return True if threading is available. False when ohm is built without threads, leaving the thread count at 1.
+  bool setThreadCount(unsigned thread_count);
+
+  /// Get the number of integration threads. See @c setThreadCount() .
+  /// @return The thread count: zero for the TBB default, 1 when single threaded.
+  unsigned threadCount() const { return thread_count_; }
+
+  /// Enable or disable batched ray integration (enabled by default). See class documentation.
+  /// @param batched True to enable batching.
+  void setBatched(bool batched) { batched_ = batched; }
+
+  /// Is batched ray integration enabled? Batching is always used when @c threadCount() is not 1.
+  /// @return True when batching is enabled.
+  bool batched() const { return batched_; }
+
   /// Performs the ray integration.
   ///
   /// This is updated in a single threaded fashion similar to @c RayMapperOccupancy with modified value updates as
-  /// described in the class documentation.
+  /// described in the class documentation. Multiple threads are used when @c threadCount() is not 1. Updates are
+  /// batched by region unless disabled by @c setBatched() .
   ///
   /// This function supports the following @c RayFlag values:
   /// - kRfExcludeRay
@@ -67,6 +100,10 @@ public:
   using RayMapper::integrateRays;
 
 protected:
+  /// Batched, optionally multi-threaded implementation of @c integrateRays() . See class documentation.
+  size_t integrateRaysBatched(const glm::dvec3 *rays, size_t element_count, const float *intensities,
+                              const double *timestamps, unsigned ray_update_flags);
+
   NdtMap *map_;                     ///< Target map.
   int occupancy_layer_ = -1;        ///< Cached occupancy layer index.
   int mean_layer_ = -1;             ///< Cached voxel mean layer index.
@@ -78,8 +115,10 @@ protected:
   int incident_normal_layer_ = -1;  ///< Cache incident normal layer index.
   /// Cached occupancy layer voxel dimensions. Voxel mean and covariance layers must exactly match.
   glm::u8vec3 occupancy_dim_{ 0, 0, 0 };
-  bool valid_ = false;  ///< Has layer validation passed?
-  const bool ndt_tm_;   ///< Does map implement ndt-tm?
+  unsigned thread_count_ = 1;  ///< Number of threads to use in @c integrateRays() .
+  bool batched_ = true;        ///< Batch updates by region in @c integrateRays() ?
+  bool valid_ = false;         ///< Has layer validation passed?
+  const bool ndt_tm_;          ///< Does map implement ndt-tm?
 };
 
 }  // namespace ohm
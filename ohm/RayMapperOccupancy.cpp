@@ -18,6 +18,8 @@
 #include "VoxelOccupancy.h"
 #include "VoxelTouchTime.h"
 
+#include "private/RegionRayBatch.h"
+
 // TODO (KS): RayMapperOccupancy::lookupRays() is deprecated. Use RaysQuery for less code maintenance, but it creates
 // a poor dependency.
 #include "RaysQuery.h"
@@ -65,9 +67,29 @@ RayMapperOccupancy::RayMapperOccupancy(OccupancyMap *map)
 RayMapperOccupancy::~RayMapperOccupancy() = default;
 
 
+bool RayMapperOccupancy::setThreadCount(unsigned thread_count)
+{
+#ifdef OHM_THREADS
+  thread_count_ = thread_count;
+  return true;
+#else   // OHM_THREADS
+  (void)thread_count;
+  thread_count_ = 1;
+  return false;
+#endif  // OHM_THREADS
+}
+
+
 size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_count, const float * /*intensities*/,
                                          const double *timestamps, unsigned ray_update_flags)
 {
+  // kRfStopOnFirstOccupied depends on the state of the voxels along each ray, so the rays cannot be walked ahead of
+  // the update. Use the serial path.
+  if ((batched_ || thread_count_ != 1) && !(ray_update_flags & kRfStopOnFirstOccupied))
+  {
+    return integrateRaysBatched(rays, element_count, timestamps, ray_update_flags);
+  }
+
   KeyList keys;
   MapChunk *last_chunk = nullptr;
   MapChunk *last_mean_chunk = nullptr;
@@ -140,6 +162,8 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
         // Incidents not required for miss update, but we need it in sync for the update later.
         incidents_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[incident_normal_layer_]);
       }
+      // The stamp is fixed for this call, so mark each chunk dirty once as the walk enters it.
+      chunk->markDirty(touch_stamp);
     }
     last_chunk = chunk;
     const unsigned voxel_index = ohm::voxelIndex(key, occupancy_dim);
@@ -181,7 +205,6 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
     chunk->updateFirstValid(voxel_index);
 
     stop_adjustments = stop_adjustments || ((ray_update_flags & kRfStopOnFirstOccupied) && initially_occupied);
-    chunk->dirty_stamp = touch_stamp;
     // Update the touched_stamps with relaxed memory ordering. The important thing is to have an update,
     // not so much the sequencing. We really don't want to synchronise here.
     chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
@@ -253,6 +276,7 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
         {
           incidents_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[incident_normal_layer_]);
         }
+        chunk->markDirty(touch_stamp);
       }
       last_chunk = chunk;
       const unsigned voxel_index = ohm::voxelIndex(key, occupancy_dim);
@@ -328,7 +352,6 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
       // NOLINTNEXTLINE(clang-analyzer-core.CallAndMessage)
       chunk->updateFirstValid(voxel_index);
 
-      chunk->dirty_stamp = touch_stamp;
       // Update the touched_stamps with relaxed memory ordering. The important thing is to have an update,
       // not so much the sequencing. We really don't want to synchronise here.
       chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
@@ -339,6 +362,171 @@ size_t RayMapperOccupancy::integrateRays(const glm::dvec3 *rays, size_t element_
 }
 
 
+size_t RayMapperOccupancy::integrateRaysBatched(const glm::dvec3 *rays, size_t element_count,
+                                                const double *timestamps, unsigned ray_update_flags)
+{
+  const auto occupancy_layer = occupancy_layer_;
+  const auto mean_layer = mean_layer_;
+  const auto traversal_layer = traversal_layer_;
+  const auto touch_time_layer = (timestamps) ? touch_time_layer_ : -1;
+  const auto incident_normal_layer = incident_normal_layer_;
+  const auto occupancy_dim = occupancy_dim_;
+  const auto occupancy_threshold_value = map_->occupancyThresholdValue();
+  const auto miss_value = map_->missValue();
+  const auto hit_value = map_->hitValue();
+  const auto resolution = map_->resolution();
+  const auto voxel_min = map_->minVoxelValue();
+  const auto voxel_max = map_->maxVoxelValue();
+  const auto saturation_min = map_->saturateAtMinValue() ? voxel_min : std::numeric_limits<float>::lowest();
+  const auto saturation_max = map_->saturateAtMaxValue() ? voxel_max : std::numeric_limits<float>::max();
+  // kRfStopOnFirstOccupied is not supported here, so adjustments are never stopped.
+  const bool stop_adjustments = false;
+  // Touch the map to flag changes.
+  const auto touch_stamp = map_->touch();
+
+  if (timestamps)
+  {
+    // Update first ray time if not yet set.
+    map_->updateFirstRayTime(*timestamps);
+  }
+  const double time_base = map_->firstRayTime();
+
+  RegionRayBatch batch(*map_, thread_count_);
+
+  // Apply all the visits for a single region. Each region is updated by only one thread. The logic here mirrors the
+  // serial integrateRays() implementation - see comments there.
+  const auto update_region = [&](MapChunk *chunk, const RegionRayBatch::Visit *visits, size_t visit_count) {
+    VoxelBuffer<VoxelBlock> occupancy_buffer(chunk->voxel_blocks[occupancy_layer]);
+    VoxelBuffer<VoxelBlock> mean_buffer;
+    VoxelBuffer<VoxelBlock> traversal_buffer;
+    VoxelBuffer<VoxelBlock> touch_time_buffer;
+    VoxelBuffer<VoxelBlock> incidents_buffer;
+    bool have_sample_buffers = false;
+
+    if (traversal_layer >= 0)
+    {
+      traversal_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[traversal_layer]);
+    }
+
+    for (size_t v = 0; v < visit_count; ++v)
+    {
+      const RegionRayBatch::Visit &visit = visits[v];
+      const unsigned voxel_index = ohm::voxelIndex(visit.key, occupancy_dim);
+
+      float occupancy_value;
+      occupancy_buffer.readVoxel(voxel_index, &occupancy_value);
+      const float initial_value = occupancy_value;
+
+      const bool initially_unobserved = initial_value == unobservedOccupancyValue();
+      const bool initially_free = !initially_unobserved && initial_value < occupancy_threshold_value;
+      const bool initially_occupied = !initially_unobserved && initial_value >= occupancy_threshold_value;
+
+      if (!visit.sample)
+      {
+        float miss_adjustment = miss_value;
+        miss_adjustment = (initially_unobserved && (ray_update_flags & kRfExcludeUnobserved)) ?
+                            unobservedOccupancyValue() :
+                            miss_adjustment;
+        miss_adjustment = (initially_free && (ray_update_flags & kRfExcludeFree)) ? 0.0f : miss_adjustment;
+        miss_adjustment = (initially_occupied && (ray_update_flags & kRfExcludeOccupied)) ? 0.0f : miss_adjustment;
+
+        occupancyAdjustMiss(&occupancy_value, initial_value, miss_adjustment, unobservedOccupancyValue(), voxel_min,
+                            saturation_min, saturation_max, stop_adjustments);
+        occupancy_buffer.writeVoxel(voxel_index, occupancy_value);
+
+        // Accumulate traversal
+        if (traversal_layer >= 0)
+        {
+          float traversal;
+          traversal_buffer.readVoxel(voxel_index, &traversal);
+          traversal += visit.traversal;
+          traversal_buffer.writeVoxel(voxel_index, traversal);
+        }
+      }
+      else
+      {
+        const RegionRayBatch::Ray &ray = batch.ray(visit.ray);
+
+        if (!have_sample_buffers)
+        {
+          // Only resolve the buffers required for the sample update when we have a sample in this region.
+          if (mean_layer >= 0)
+          {
+            mean_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[mean_layer]);
+          }
+          if (touch_time_layer >= 0)
+          {
+            touch_time_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[touch_time_layer]);
+          }
+          if (incident_normal_layer >= 0)
+          {
+            incidents_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[incident_normal_layer]);
+          }
+          have_sample_buffers = true;
+        }
+
+        float hit_adjustment = hit_value;
+        hit_adjustment = (initially_unobserved && (ray_update_flags & kRfExcludeUnobserved)) ?
+                           unobservedOccupancyValue() :
+                           hit_adjustment;
+        hit_adjustment = (initially_free && (ray_update_flags & kRfExcludeFree)) ? 0.0f : hit_adjustment;
+        hit_adjustment = (initially_occupied && (ray_update_flags & kRfExcludeOccupied)) ? 0.0f : hit_adjustment;
+
+        occupancyAdjustHit(&occupancy_value, initial_value, hit_adjustment, unobservedOccupancyValue(), voxel_max,
+                           saturation_min, saturation_max, stop_adjustments);
+
+        // update voxel mean if present.
+        unsigned sample_count = 0;
+        if (mean_layer >= 0)
+        {
+          VoxelMean voxel_mean;
+          mean_buffer.readVoxel(voxel_index, &voxel_mean);
+          voxel_mean.coord = subVoxelUpdate(voxel_mean.coord, voxel_mean.count,
+                                            ray.sample - map_->voxelCentreGlobal(visit.key), resolution);
+          sample_count = voxel_mean.count;
+          ++voxel_mean.count;
+          mean_buffer.writeVoxel(voxel_index, voxel_mean);
+          chunk->touched_stamps[mean_layer].store(touch_stamp, std::memory_order_relaxed);
+        }
+        occupancy_buffer.writeVoxel(voxel_index, occupancy_value);
+
+        // Accumulate traversal
+        if (traversal_layer >= 0)
+        {
+          float traversal;
+          traversal_buffer.readVoxel(voxel_index, &traversal);
+          traversal += float(glm::length(ray.sample - ray.start) - ray.last_exit_range);
+          traversal_buffer.writeVoxel(voxel_index, traversal);
+        }
+
+        if (touch_time_layer >= 0)
+        {
+          const unsigned touch_time = encodeVoxelTouchTime(time_base, timestamps[ray.index]);
+          touch_time_buffer.writeVoxel(voxel_index, touch_time);
+        }
+
+        if (incident_normal_layer >= 0)
+        {
+          unsigned packed_normal{};
+          incidents_buffer.readVoxel(voxel_index, &packed_normal);
+          packed_normal = updateIncidentNormal(packed_normal, ray.start - ray.sample, sample_count);
+          incidents_buffer.writeVoxel(voxel_index, packed_normal);
+        }
+      }
+
+      chunk->updateFirstValid(voxel_index);
+    }
+
+    chunk->markDirty(touch_stamp);
+    chunk->touched_stamps[occupancy_layer].store(touch_stamp, std::memory_order_relaxed);
+  };
+
+  batch.integrate(rays, element_count, ray_update_flags, update_region);
+
+  return element_count / 2;
+}
+
+
 size_t RayMapperOccupancy::lookupRays(const glm::dvec3 *rays, size_t element_count, float *newly_observed_volumes,
                                       float *ranges, OccupancyType *terminal_states)
 {
@@ -22,9 +22,18 @@ namespace ohm
 /// and @c VoxelMean update (if enabled by the map) - @c MayLayout::occupancyLayer() and @c MapLayout::meanLayer()
 /// respectively.
 ///
-/// The @c integrateRays() implementation performs a single threaded walk of the voxels to update and touches
-/// those voxels one at a time, updating their occupancy value. The given @c OccupancyMap must have an occupancy
-/// layer and may have a @c VoxelMean layer.
+/// The @c integrateRays() implementation walks the rays in batches, bucketing the resulting voxel updates by region.
+/// Each region and its voxel buffers are then resolved once per batch and the updates applied in a single pass over
+/// the region, applying the updates in the same order as a serial walk of the rays. This avoids resolving a region
+/// whenever a ray crosses a region boundary. The given @c OccupancyMap must have an occupancy layer and may have a
+/// @c VoxelMean layer.
+///
+/// A multi-threaded integration may be enabled via @c setThreadCount() . In this mode the rays are walked in parallel
+/// and each region is updated by a single thread. The results are identical to the single threaded integration.
+///
+/// Batching may be disabled via @c setBatched() , in which case the rays are walked in a single thread, updating each
+/// voxel as it is visited. Note that @c kRfStopOnFirstOccupied always uses this code path as the adjustments for each
+/// ray depend on the voxel state along the ray.
 class ohm_API RayMapperOccupancy : public RayMapper
 {
 public:
@@ -40,9 +49,32 @@ public:
   /// @return True if valid and @c integrateRays() is safe to call.
   inline bool valid() const override { return valid_; }
 
+  /// Set the number of threads used to walk the rays and update the occupancy in @c integrateRays() .
+  ///
+  /// Any value other than 1 selects the batched integration, regardless of @c setBatched() . Zero uses the TBB default
+  /// thread count, while 1 (default) keeps the integration on the calling thread. Rays integrated with
+  /// @c kRfStopOnFirstOccupied are always walked serially since each ray depends on the preceding updates.
+  ///
+  /// @param thread_count The number of integration threads.
+  /// @return True if threading is available. False when ohm is built without threads, leaving the thread count at 1.
+  bool setThreadCount(unsigned thread_count);
+
+  /// Get the number of integration threads. See @c setThreadCount() .
+  /// @return The thread count: zero for the TBB default, 1 when single threaded.
+  unsigned threadCount() const { return thread_count_; }
+
+  /// Enable or disable batched ray integration (enabled by default). See class documentation.
+  /// @param batched True to enable batching.
+  void setBatched(bool batched) { batched_ = batched; }
+
+  /// Is batched ray integration enabled? Batching is always used when @c threadCount() is not 1.
+  /// @return True when batching is enabled.
+  bool batched() const { return batched_; }
+
   /// Performs the ray integration.
   ///
-  /// This is updated in a single threaded fashion. For each ray we walk the affected voxel @c Key set and
+  /// This is updated in a single threaded fashion unless a @c threadCount() other than 1 is set. Updates are batched
+  /// by region unless disabled by @c setBatched() . For each ray we walk the affected voxel @c Key set and
   /// update those voxels. Voxels along each line segment have their occupancy probability diminished, while
   /// the end voxel of each segment has the probability increase. The end voxel will also have its @c VoxelMean
   /// updated if the map has a @c MapLayout::meanLayer() . This behaviour may be modified by the @p RayFlag
@@ -81,6 +113,10 @@ public:
   using RayMapper::integrateRays;
 
 protected:
+  /// Batched, optionally multi-threaded implementation of @c integrateRays() . See class documentation.
+  size_t integrateRaysBatched(const glm::dvec3 *rays, size_t element_count, const double *timestamps,
+                              unsigned ray_update_flags);
+
   OccupancyMap *map_ = nullptr;           ///< Target map.
   int occupancy_layer_ = -1;              ///< Cached occupancy layer index.
   int mean_layer_ = -1;                   ///< Cached voxel mean layer index.
@@ -88,6 +124,8 @@ protected:
   int touch_time_layer_ = -1;             ///< Cache touch time layer index.
   int incident_normal_layer_ = -1;        ///< Cache incident normal layer index.
   glm::u8vec3 occupancy_dim_{ 0, 0, 0 };  ///< Cached occupancy layer voxel dimensions. Voxel mean must exactly match.
+  unsigned thread_count_ = 1;             ///< Number of threads to use in @c integrateRays() .
+  bool batched_ = true;                   ///< Batch updates by region in @c integrateRays() ?
   bool valid_ = false;                    ///< Has layer validation passed?
 };
 
@@ -59,6 +59,7 @@ size_t RayMapperSecondarySample::integrateRays(const glm::dvec3 *rays, size_t el
     if (chunk != last_chunk)
     {
       secondary_sample_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[secondary_samples_layer]);
+      chunk->markDirty(touch_stamp);
     }
     last_chunk = chunk;
     const unsigned voxel_index = ohm::voxelIndex(key, layer_dim);
@@ -68,7 +69,6 @@ size_t RayMapperSecondarySample::integrateRays(const glm::dvec3 *rays, size_t el
     secondary_sample_buffer.writeVoxel(voxel_index, voxel);
 
     assert(chunk);
-    chunk->dirty_stamp = touch_stamp;
     chunk->touched_stamps[secondary_samples_layer].store(touch_stamp, std::memory_order_relaxed);
   }
 
@@ -137,6 +137,8 @@ size_t RayMapperTsdf::integrateRays(const glm::dvec3 *rays, size_t element_count
     if (chunk != last_chunk)
     {
       tsdf_buffer = VoxelBuffer<VoxelBlock>(chunk->voxel_blocks[tsdf_layer]);
+      // The stamp is fixed for this call, so mark each chunk dirty once as the walk enters it.
+      chunk->markDirty(touch_stamp);
     }
     last_chunk = chunk;
     const unsigned voxel_index = ohm::voxelIndex(key, tsdf_dim);
@@ -152,7 +154,6 @@ size_t RayMapperTsdf::integrateRays(const glm::dvec3 *rays, size_t element_count
     // NOLINTNEXTLINE(clang-analyzer-core.CallAndMessage)
     chunk->updateFirstValid(voxel_index);
 
-    chunk->dirty_stamp = touch_stamp;
     // Update the touched_stamps with relaxed memory ordering. The important thing is to have an update,
     // not so much the sequencing. We really don't want to synchronise here.
     chunk->touched_stamps[tsdf_layer].store(touch_stamp, std::memory_order_relaxed);
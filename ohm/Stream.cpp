@@ -254,11 +254,25 @@ unsigned InputStream::read(void *buffer, unsigned max_bytes)
 unsigned InputStream::readRaw(void *buffer, unsigned max_bytes)
 {
   std::istream &in = imp()->in;
-  const std::ifstream::pos_type initial_pos = in.tellg();
   in.read(static_cast<char *>(buffer), max_bytes);
-  const std::ifstream::pos_type end_pos = in.tellg();
-  auto read = unsigned(end_pos - initial_pos);
-  return read;
+  // Use gcount() rather than tellg() as the latter is invalid after a short read at the end of the file.
+  return unsigned(in.gcount());
+}
+
+
+size_t InputStream::size()
+{
+  std::istream &in = imp()->in;
+  in.clear();
+  const std::streampos pos = in.tellg();
+  if (pos < 0)
+  {
+    return 0u;
+  }
+  in.seekg(0, std::ios_base::end);
+  const std::streampos end = in.tellg();
+  in.seekg(pos, std::ios_base::beg);
+  return (end >= 0) ? size_t(end) : 0u;
 }
 
 
@@ -306,6 +320,8 @@ void InputStream::doClose()
 
 void InputStream::doSeek(size_t pos)
 {
+  // Clear any end of file state from reading ahead.
+  imp()->in.clear();
   imp()->in.seekg(pos, std::ios_base::beg);
 }
 
@@ -442,7 +458,19 @@ void OutputStream::flush()
 
 bool OutputStream::doOpen(const std::string &file_path, unsigned flags)
 {
-  imp()->out.open(file_path.c_str(), std::ios_base::binary);
+  if (flags & kSfAppend)
+  {
+    // Open without truncation, positioned at the end. Opening for update fails if the file does not exist.
+    imp()->out.open(file_path.c_str(), std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+    if (imp()->out.is_open())
+    {
+      imp()->out.seekp(0, std::ios_base::end);
+    }
+  }
+  if (!imp()->out.is_open())
+  {
+    imp()->out.open(file_path.c_str(), std::ios_base::binary | std::ios_base::trunc);
+  }
   imp()->file_path = file_path;
 #ifndef OHM_ZIP
   flags &= ~SF_Compress;
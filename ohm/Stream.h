@@ -25,6 +25,9 @@ enum StreamFlag : unsigned
 {
   /// Compression is enabled.
   kSfCompress = (1u << 0u),
+  /// Open an @c OutputStream on an existing file without truncating it, positioned at the end of the file. The file is
+  /// created if it does not exist. Unlike @c std::ios_base::app , writes occur at the current position after a seek.
+  kSfAppend = (1u << 1u),
 };
 
 
@@ -155,6 +158,10 @@ public:
   /// @return The number of bytes read. Zero indicates no bytes available, or an decompression error.
   unsigned readRaw(void *buffer, unsigned max_bytes);
 
+  /// Query the size of the file in bytes. The current stream position is preserved.
+  /// @return The file size, or zero when not open.
+  size_t size();
+
   /// Returns true if the stream (file) is open.
   /// @return True when open.
   bool isOpen() const override;
@@ -30,25 +30,36 @@ namespace detail
 template <typename T>
 struct VoxelChunkAccess
 {
-  /// Resolve a mutable chunk for @p key from @p map , creating the chunk if required.
+  /// Resolve and pin a mutable chunk for @p key from @p map , creating the chunk if required.
   /// @param map The map of interest.
   /// @param key The key to resolve the chunk for.
-  /// @return The chunk for @p key .
-  static MapChunk *chunk(OccupancyMap *map, const Key &key) { return map->region(key.regionKey(), true); }
+  /// @return The chunk for @p key . Must be @c MapChunk::unpin() -ed.
+  static MapChunk *chunk(OccupancyMap *map, const Key &key) { return map->pinRegion(key.regionKey(), true); }
 
   /// Update the first valid index for @p chunk using @p voxel_index .
   /// @param chunk The map chunk being touched: must be valid.
   /// @param voxel_index The linear index of the modified voxel.
   static void touch(MapChunk *chunk, unsigned voxel_index) { chunk->updateFirstValid(voxel_index); }
 
+  /// Retain @p block for write access. See @c VoxelBlock::retain() .
+  /// @param block The voxel block to retain.
+  /// @return The voxel memory of @p block .
+  static uint8_t *retain(VoxelBlock *block)
+  {
+    block->retain();
+    return block->voxelBytes();
+  }
+
   /// Mark @p chunk as having been updated within @p layer_index .
-  /// This will @c OccupancyMap::touch() the @p map and update the stamps in @p chunk relevant to @p layer_index .
+  /// This will @c OccupancyMap::touch() the @p map , update the stamps in @p chunk relevant to @p layer_index and
+  /// note the layer @c VoxelBlock as written.
   /// @param map The map of interest.
   /// @param chunk The map chunk being touched: must be valid.
   /// @param layer_index The voxel memory index in chunk which has been modified.
   static void touch(OccupancyMap *map, MapChunk *chunk, int layer_index)
   {
-    chunk->dirty_stamp = map->touch();
+    chunk->voxel_blocks[layer_index]->markWritten();
+    chunk->markDirty(map->touch());
     chunk->touched_stamps[layer_index].store(chunk->dirty_stamp, std::memory_order_relaxed);
   }
 
@@ -70,11 +81,11 @@ struct VoxelChunkAccess
 template <typename T>
 struct VoxelChunkAccess<const T>
 {
-  /// Query the @c MapChunk pointer for @p key.
+  /// Query and pin the @c MapChunk pointer for @p key.
   /// @param map The Occupancy map of interest
   /// @param key The key to get a chunk for.
-  /// @return The @c MapChunk for key, or null if the chunk does not exist.
-  static const MapChunk *chunk(const OccupancyMap *map, const Key &key) { return map->region(key.regionKey()); }
+  /// @return The @c MapChunk for key, or null if the chunk does not exist. Must be @c MapChunk::unpin() -ed.
+  static const MapChunk *chunk(const OccupancyMap *map, const Key &key) { return map->pinRegion(key.regionKey()); }
 
   /// Noop.
   /// @param chunk Ignored.
@@ -85,6 +96,12 @@ struct VoxelChunkAccess<const T>
     (void)voxel_index;
   }
 
+  /// Retain @p block for read only access, which does not allocate uniform blocks. See
+  /// @c VoxelBlock::retainReadOnly() .
+  /// @param block The voxel block to retain.
+  /// @return The voxel memory of @p block .
+  static const uint8_t *retain(VoxelBlock *block) { return block->retainReadOnly(); }
+
   /// Noop.
   /// @param map Ignored.
   /// @param chunk Ignored.
@@ -514,7 +531,8 @@ protected:
     key_ = key;
   }
 
-  /// Internal chunk set function. Performs book keeping for @c Flag::kTouchedChunk .
+  /// Internal chunk set function. Performs book keeping for @c Flag::kTouchedChunk . The chunk is pinned while
+  /// referenced so that it cannot be paged out (see @c MapChunk::pin() ).
   /// @param chunk The chunk to set the voxel to reference.
   inline void setChunk(MapChunkPtr chunk)
   {
@@ -522,11 +540,14 @@ protected:
     {
       updateChunkTouchAndCompression(false);
       chunk_ = chunk;
+      if (chunk_)
+      {
+        chunk_->pin();
+      }
       if (chunk_ && layer_index_ != -1)
       {
-        chunk_->voxel_blocks[layer_index_]->retain();
+        voxel_memory_ = detail::VoxelChunkAccess<T>::retain(chunk_->voxel_blocks[layer_index_].get());
         flags_ |= unsigned(Flag::kCompressionLock);
-        voxel_memory_ = chunk_->voxel_blocks[layer_index_]->voxelBytes();
       }
       else
       {
@@ -733,8 +754,13 @@ Voxel<T> &Voxel<T>::setKey(const Key &key)
   setKeyInternal(key);
   if (!chunk_ || chunk_->region.coord != key.regionKey())
   {
-    // Create chunk if not read only access.
-    setChunk(detail::VoxelChunkAccess<T>::chunk(map_, key));
+    // Create chunk if not read only access. The lookup pins the chunk until setChunk() has taken its own pin.
+    MapChunkPtr chunk = detail::VoxelChunkAccess<T>::chunk(map_, key);
+    setChunk(chunk);
+    if (chunk)
+    {
+      chunk->unpin();
+    }
   }
   return *this;
 }
@@ -900,9 +926,13 @@ void Voxel<T>::updateChunkTouchAndCompression(bool retain_chunk)
     if (!retain_chunk && (flags_ & unsigned(Flag::kCompressionLock)))
     {
       chunk_->voxel_blocks[layer_index_]->release();
-      chunk_ = nullptr;
     }
   }
+  if (!retain_chunk && chunk_)
+  {
+    chunk_->unpin();
+    chunk_ = nullptr;
+  }
   // Always clear Flag::kTouchedChunk however, we only clear Flag::kCompressionLock if we are not retaining the chunk.
   auto clear_flags = unsigned(Flag::kTouchedChunk);
   clear_flags |= !!retain_chunk * unsigned(Flag::kCompressionLock);
@@ -10,10 +10,11 @@
 
 #include "private/OccupancyMapDetail.h"
 
-#include <zlib.h>
-
 #include <algorithm>
 #include <cstring>
+#include <map>
+#include <mutex>
+#include <utility>
 
 namespace ohm
 {
@@ -21,45 +22,91 @@ namespace
 {
 const unsigned kDefaultBufferSize = 1024u;
 unsigned g_minimum_buffer_size = kDefaultBufferSize;
-int g_zlib_compression_level = Z_BEST_SPEED;
-int g_zlib_gzip_flag = 0;  // Use 16 to enable GZip.
-const int kWindowBits = 14;
-const int kZLibMemLevel = 8;
-const int kCompressionStrategy = Z_DEFAULT_STRATEGY;
+VoxelBlock::CompressionLevel g_compression_level = VoxelBlock::kCompressFast;
+VoxelBlock::CompressionType g_compression_type = VoxelBlock::kCompressDeflate;
 
-const int kGZipCompressionFlag = 16;
 const unsigned kReleaseDelayMs = 500;
-/// When reserving compressed buffer space, device the uncompressed size by this factor.
-const unsigned kBufferReservationQutient = 10;
-}  // namespace
 
+/// Resolve the default codec matching the current @c VoxelBlock::CompressionControls . Codecs are created once for
+/// each combination so that the returned reference remains valid and may be retained by the @c VoxelBlock .
+const VoxelCodec::Ptr &defaultCodec()
+{
+  static const VoxelCodec::Ptr codecs[] = {
+    VoxelCodec::create(VoxelCodec::kZLib, VoxelCodec::kLevelFast),
+    VoxelCodec::create(VoxelCodec::kZLib, VoxelCodec::kLevelBalanced),
+    VoxelCodec::create(VoxelCodec::kZLib, VoxelCodec::kLevelMax),
+    VoxelCodec::create(VoxelCodec::kGZip, VoxelCodec::kLevelFast),
+    VoxelCodec::create(VoxelCodec::kGZip, VoxelCodec::kLevelBalanced),
+    VoxelCodec::create(VoxelCodec::kGZip, VoxelCodec::kLevelMax),
+  };
+  const unsigned level_count = 3;
+  const unsigned type_index = (g_compression_type == VoxelBlock::kCompressGZip) ? 1u : 0u;
+  return codecs[type_index * level_count + unsigned(g_compression_level)];
+}
 
-void VoxelBlock::getCompressionControls(CompressionControls *controls)
+/// Replicate the pattern in the first @p pattern_size bytes of @p mem to fill @p byte_size bytes. Copies double in
+/// size on each iteration.
+void fillPattern(uint8_t *mem, size_t pattern_size, size_t byte_size)
 {
-  controls->minimum_buffer_size = g_minimum_buffer_size;
+  size_t filled = pattern_size;
+  while (filled < byte_size)
+  {
+    const size_t copy_size = std::min(filled, byte_size - filled);
+    memcpy(mem + filled, mem, copy_size);
+    filled += copy_size;
+  }
+}
 
-  switch (g_zlib_compression_level)
+/// Resolve the dense expansion of the uniform @p voxel to @p byte_size bytes for @c VoxelBlock::retainReadOnly() .
+/// Expansions are shared by all blocks with the same voxel value and size and are held weakly, so each is released
+/// along with the last block referencing it.
+/// @param voxel The uniform voxel value.
+/// @param voxel_byte_size The byte size of @p voxel .
+/// @param byte_size The expanded byte size.
+/// @return The shared expansion.
+std::shared_ptr<const std::vector<uint8_t>> uniformExpansion(const uint8_t *voxel, size_t voxel_byte_size,
+                                                             size_t byte_size)
+{
+  using Expansion = std::shared_ptr<const std::vector<uint8_t>>;
+  using ExpansionKey = std::pair<size_t, std::vector<uint8_t>>;
+  static std::mutex mutex;
+  static std::map<ExpansionKey, std::weak_ptr<const std::vector<uint8_t>>> expansions;
+
+  ExpansionKey key(byte_size, std::vector<uint8_t>(voxel, voxel + voxel_byte_size));
+  std::unique_lock<std::mutex> guard(mutex);
+  auto iter = expansions.find(key);
+  if (iter != expansions.end())
   {
-  default:
-  case Z_DEFAULT_COMPRESSION:
-    controls->compression_level = kCompressBalanced;
-    break;
-  case Z_BEST_SPEED:
-    controls->compression_level = kCompressFast;
-    break;
-  case Z_BEST_COMPRESSION:
-    controls->compression_level = kCompressMax;
-    break;
+    if (Expansion expansion = iter->second.lock())
+    {
+      return expansion;
+    }
   }
 
-  if (g_zlib_gzip_flag)
+  // Not cached. Prune expired entries before adding the new expansion.
+  for (auto prune = expansions.begin(); prune != expansions.end();)
   {
-    controls->compression_type = kCompressGZip;
+    prune = (prune->second.expired()) ? expansions.erase(prune) : std::next(prune);
   }
-  else
+
+  auto expanded = std::make_shared<std::vector<uint8_t>>(byte_size);
+  if (byte_size >= voxel_byte_size && voxel_byte_size)
   {
-    controls->compression_type = kCompressDeflate;
+    memcpy(expanded->data(), voxel, voxel_byte_size);
+    fillPattern(expanded->data(), voxel_byte_size, byte_size);
   }
+  Expansion expansion = std::move(expanded);
+  expansions[std::move(key)] = expansion;
+  return expansion;
+}
+}  // namespace
+
+
+void VoxelBlock::getCompressionControls(CompressionControls *controls)
+{
+  controls->minimum_buffer_size = g_minimum_buffer_size;
+  controls->compression_level = g_compression_level;
+  controls->compression_type = g_compression_type;
 }
 
 void VoxelBlock::setCompressionControls(const CompressionControls &controls)
@@ -69,27 +116,28 @@ void VoxelBlock::setCompressionControls(const CompressionControls &controls)
   {
   default:
   case kCompressFast:
-    g_zlib_compression_level = Z_BEST_SPEED;
+    g_compression_level = kCompressFast;
     break;
   case kCompressBalanced:
-    g_zlib_compression_level = Z_DEFAULT_COMPRESSION;
+    g_compression_level = kCompressBalanced;
     break;
   case kCompressMax:
-    g_zlib_compression_level = Z_BEST_COMPRESSION;
+    g_compression_level = kCompressMax;
     break;
   }
 
-  g_zlib_gzip_flag = (controls.compression_type == kCompressGZip) ? kGZipCompressionFlag : 0;
+  g_compression_type = (controls.compression_type == kCompressGZip) ? kCompressGZip : kCompressDeflate;
 }
 
 
 VoxelBlock::VoxelBlock(const OccupancyMapDetail *map, const MapLayer &layer)
   : map_(map)
   , layer_index_(layer.layerIndex())
+  , voxel_byte_size_(layer.voxelByteSize())
   , uncompressed_byte_size_(layer.layerByteSize(map->region_voxel_dimensions))
 {
-  initUncompressed(voxel_bytes_, layer);
-  flags_ |= kFUncompressed;
+  initUniform(layer);
+  release_after_ = (Clock::now() + std::chrono::milliseconds(kReleaseDelayMs)).time_since_epoch().count();
   // Try add to compression process if the map uses compression.
   if ((map->flags & MapFlag::kCompressed) == MapFlag::kCompressed)
   {
@@ -125,16 +173,40 @@ void VoxelBlock::retain()
   std::unique_lock<Mutex> guard(access_guard_);
   ++reference_count_;
   flags_ |= kFLocked;  // Ensure block is lock to prevent compression.
-  // Ensure uncompressed data are available.
-  if (!(flags_ & kFUncompressed))
+  const size_t allocated = uncompressRetainedUnguarded();
+  if ((flags_ & kFManagedForCompression) && allocated)
   {
-    std::vector<uint8_t> working_buffer;
-    uncompressUnguarded(working_buffer);
-    voxel_bytes_.swap(working_buffer);
-    flags_ |= kFUncompressed;
+    guard.unlock();
+    // Let the compression queue know about the additional memory. This may wake the queue.
+    VoxelBlockCompressionQueue::instance().notifyAllocation(allocated);
   }
 }
 
+const uint8_t *VoxelBlock::retainReadOnly()
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  ++reference_count_;
+  flags_ |= kFLocked;  // Ensure block is lock to prevent compression.
+  if (flags_ & kFUniform)
+  {
+    // Reference the shared expansion rather than allocating dense memory for this block.
+    if (!uniform_view_)
+    {
+      uniform_view_ = uniformExpansion(voxel_bytes_.data(), voxel_byte_size_, uncompressed_byte_size_);
+    }
+    return uniform_view_->data();
+  }
+
+  const size_t allocated = uncompressRetainedUnguarded();
+  const uint8_t *voxel_bytes = voxel_bytes_.data();
+  if ((flags_ & kFManagedForCompression) && allocated)
+  {
+    guard.unlock();
+    VoxelBlockCompressionQueue::instance().notifyAllocation(allocated);
+  }
+  return voxel_bytes;
+}
+
 void VoxelBlock::release()
 {
   std::unique_lock<Mutex> guard(access_guard_);
@@ -143,8 +215,17 @@ void VoxelBlock::release()
     --reference_count_;
     if (reference_count_ == 0)
     {
+      uniform_view_.reset();
+      // Blocks managed for compression are collapsed by the compression queue. Others are collapsed here, but only
+      // after being written as the content cannot otherwise have changed. This keeps the capacity, so blocks which are
+      // retained for write, but not written, neither reallocate nor compare their voxels.
+      if ((flags_ & (kFWritten | kFManagedForCompression)) == kFWritten)
+      {
+        collapseUniformUnguarded();
+      }
       // Unlock to allow compression.
-      flags_ &= ~kFLocked;
+      flags_ &= ~(kFLocked | kFWritten);
+      release_after_ = (Clock::now() + std::chrono::milliseconds(kReleaseDelayMs)).time_since_epoch().count();
     }
   }
 }
@@ -172,33 +253,125 @@ size_t VoxelBlock::compress()
   return compressWithTemporaryBuffer(compression_buffer);
 }
 
+size_t VoxelBlock::allocatedByteSize() const
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  size_t byte_count = voxel_bytes_.capacity();
+  for (const auto *shared : { &shared_bytes_, &uniform_view_ })
+  {
+    if (*shared)
+    {
+      byte_count += (*shared)->capacity() / size_t(std::max<long>(shared->use_count(), 1));
+    }
+  }
+  return byte_count;
+}
+
 size_t VoxelBlock::compressWithTemporaryBuffer(std::vector<uint8_t> &compression_buffer)
 {
   std::unique_lock<Mutex> guard(access_guard_);
 
   if (!reference_count_ && !(flags_ & kFLocked))
   {
-    // Handle uninitialised buffer. We may not have initialised the buffer yet, but this call requires data to be
-    // compressed such as when used for serialisation to disk.
-    if (voxel_bytes_.empty())
+    // Uniform blocks are already in their smallest form, but may hold capacity kept by reset(). Collapse uncompressed
+    // blocks with uniform content rather than running the codec.
+    if ((flags_ & kFUniform) || collapseUniformUnguarded())
+    {
+      voxel_bytes_.shrink_to_fit();
+      return voxel_bytes_.size();
+    }
+
+    if (!(flags_ & kFUncompressed))
     {
-      initUncompressed(voxel_bytes_, map_->layout.layer(layer_index_));
-      flags_ |= kFUncompressed;
+      // Already compressed. This leaves any shared data shared.
+      return compressed_byte_size_;
     }
 
-    compressUnguarded(compression_buffer);
+    if (!compressUnguarded(compression_buffer))
+    {
+      return 0;
+    }
     setCompressedBytesUnguarded(compression_buffer);
     return compression_buffer.size();
   }
   return 0;
 }
 
+bool VoxelBlock::copyFrom(VoxelBlock &src, bool copy_on_write)
+{
+  if (&src == this)
+  {
+    return true;
+  }
+
+  std::unique_lock<Mutex> src_guard(src.access_guard_);
+  std::unique_lock<Mutex> guard(access_guard_);
+
+  if (src.voxel_byte_size_ != voxel_byte_size_ || src.uncompressed_byte_size_ != uncompressed_byte_size_)
+  {
+    return false;
+  }
+
+  if (reference_count_ && (flags_ & kFUncompressed))
+  {
+    // The current voxel memory is in use and must remain valid. Uncompress into it. The size is unchanged. Read only
+    // retains of a uniform block reference the uniform_view_ instead, so the stored data may be replaced below.
+    return src.uncompressUnguarded(voxel_bytes_);
+  }
+
+  const bool was_uncompressed = (flags_ & kFUncompressed) != 0;
+  // Only compressed data are shared. Uniform data are already minimal. Uncompressed data are copied here instead: a
+  // shared uncompressed payload would cost an extra copy when either block is next retained, where compressed data
+  // are decompressed into new memory regardless. This leaves the source block free to be modified without copying.
+  if (copy_on_write && !(src.flags_ & (kFUniform | kFUncompressed | kFLocked)) && !src.reference_count_)
+  {
+    src.shareUnguarded();
+    shared_bytes_ = src.shared_bytes_;
+    voxel_bytes_.clear();
+    voxel_bytes_.shrink_to_fit();
+  }
+  else
+  {
+    // Copy the data as stored. This reuses the existing capacity where possible.
+    const std::vector<uint8_t> &src_bytes = src.storedBytesUnguarded();
+    voxel_bytes_.assign(src_bytes.begin(), src_bytes.end());
+    shared_bytes_.reset();
+  }
+
+  compressed_byte_size_ = src.compressed_byte_size_;
+  codec_ = src.codec_;
+  const unsigned state_flags = kFUncompressed | kFUniform;
+  flags_ = (flags_ & ~(state_flags | kFShared)) | (src.flags_ & state_flags) | ((shared_bytes_) ? kFShared : 0u);
+
+  // Notify the compression queue of new uncompressed memory as for retain().
+  const bool notify = !was_uncompressed && (flags_ & kFManagedForCompression) && (flags_ & kFUncompressed);
+  guard.unlock();
+  src_guard.unlock();
+  if (notify)
+  {
+    VoxelBlockCompressionQueue::instance().notifyAllocation(uncompressed_byte_size_);
+  }
+  return true;
+}
+
 void VoxelBlock::updateLayerIndex(unsigned layer_index)
 {
   std::unique_lock<Mutex> guard(access_guard_);
   layer_index_ = layer_index;
 }
 
+void VoxelBlock::reset(const MapLayer &layer)
+{
+  std::unique_lock<Mutex> guard(access_guard_);
+  layer_index_ = layer.layerIndex();
+  voxel_byte_size_ = layer.voxelByteSize();
+  // Return to the uniform state. The buffer capacity is kept so that the next retain() need not allocate. The
+  // compression queue counts the kept capacity as allocated and may release it, while retain() only notifies the queue
+  // of memory allocated beyond that capacity. There is no new allocation to notify here.
+  initUniform(layer);
+  release_after_ = (Clock::now() + std::chrono::milliseconds(kReleaseDelayMs)).time_since_epoch().count();
+}
+
 bool VoxelBlock::supportsCompression() const
 {
   return (map_->flags & MapFlag::kCompressed) == MapFlag::kCompressed;
@@ -208,158 +381,147 @@ bool VoxelBlock::compressUnguarded(std::vector<uint8_t> &compression_buffer)
 {
   if (flags_ & kFUncompressed)
   {
-    int ret = Z_OK;
-    z_stream stream;
-    memset(&stream, 0u, sizeof(stream));
-    // NOLINTNEXTLINE(hicpp-signed-bitwise)
-    deflateInit2(&stream, g_zlib_compression_level, Z_DEFLATED, kWindowBits | g_zlib_gzip_flag, kZLibMemLevel,
-                 kCompressionStrategy);
-
-    stream.next_in = static_cast<Bytef *>(voxel_bytes_.data());
-    stream.avail_in = unsigned(voxel_bytes_.size());
-
-    compression_buffer.reserve(
-      std::max(voxel_bytes_.size() / kBufferReservationQutient, static_cast<size_t>(g_minimum_buffer_size)));
-    compression_buffer.resize(compression_buffer.capacity());
+    // Resolve the codec from the layer, falling back to the default codec.
+    const VoxelCodec::Ptr &layer_codec = map_->layout.layer(layer_index_).codec();
+    const VoxelCodec::Ptr &codec = (layer_codec) ? layer_codec : defaultCodec();
 
-    stream.avail_out = unsigned(compression_buffer.size());
-    stream.next_out = compression_buffer.data();
-
-    int flush_flag = Z_NO_FLUSH;
-    do
-    {
-      ret = deflate(&stream, flush_flag);
-
-      switch (ret)
-      {
-      case Z_OK:
-        // Done with input data. Make sure we change to flushing.
-        if (stream.avail_in == 0)
-        {
-          flush_flag = Z_FINISH;
-        }
-
-        // Check for insufficient output data before Z_STREAM_END.
-        if (stream.avail_out == 0)
-        {
-          // Output buffer too small.
-          const size_t bytes_so_far = compression_buffer.size();
-          compression_buffer.resize(2 * bytes_so_far);
-          stream.avail_out = unsigned(compression_buffer.size() - bytes_so_far);
-          stream.next_out = compression_buffer.data() + bytes_so_far;
-        }
-        break;
-      case Z_STREAM_END:
-        break;
-      default:
-        // Failed.
-        deflateEnd(&stream);
-        return false;
-      }
-    } while (stream.avail_in || ret != Z_STREAM_END);
-
-    // Ensure flush.
-    if (flush_flag != Z_FINISH)
-    {
-      deflate(&stream, Z_FINISH);
-    }
-
-    ret = deflateEnd(&stream);
-    if (ret != Z_OK)
+    const std::vector<uint8_t> &voxel_bytes = storedBytesUnguarded();
+    compression_buffer.reserve(g_minimum_buffer_size);
+    if (!codec->compress(voxel_bytes.data(), voxel_bytes.size(), compression_buffer))
     {
       return false;
     }
-
-    // Resize compressed buffer.
-    compression_buffer.resize(compression_buffer.size() - stream.avail_out);
+    // Retain the codec so we can decompress regardless of changes to the layer or compression controls.
+    codec_ = codec;
   }
   else
   {
     // Already compressed. Copy buffer.
-    compression_buffer.resize(voxel_bytes_.size());
-    if (!voxel_bytes_.empty())
+    const std::vector<uint8_t> &voxel_bytes = storedBytesUnguarded();
+    compression_buffer.resize(voxel_bytes.size());
+    if (!voxel_bytes.empty())
     {
-      memcpy(compression_buffer.data(), voxel_bytes_.data(), sizeof(*voxel_bytes_.data()) * voxel_bytes_.size());
+      memcpy(compression_buffer.data(), voxel_bytes.data(), sizeof(*voxel_bytes.data()) * voxel_bytes.size());
     }
   }
 
   return true;
 }
 
+size_t VoxelBlock::uncompressRetainedUnguarded()
+{
+  // Ensure uncompressed data are available. Shared data are always compressed, so this also releases any share.
+  if (flags_ & kFUncompressed)
+  {
+    return 0;
+  }
+
+  // Memory already held, such as the capacity kept by reset(), has already been counted by the compression queue.
+  const size_t previous_capacity = voxel_bytes_.capacity();
+  if (flags_ & kFUniform)
+  {
+    // Expand the uniform voxel in place. This reuses any capacity retained by reset().
+    voxel_bytes_.resize(uncompressed_byte_size_);
+    fillPattern(voxel_bytes_.data(), voxel_byte_size_, voxel_bytes_.size());
+  }
+  else
+  {
+    std::vector<uint8_t> working_buffer;
+    uncompressUnguarded(working_buffer);
+    voxel_bytes_.swap(working_buffer);
+    releaseSharedUnguarded();
+  }
+  flags_ = (flags_ & ~kFUniform) | kFUncompressed;
+
+  return (uncompressed_byte_size_ > previous_capacity) ? uncompressed_byte_size_ - previous_capacity : 0u;
+}
+
+
 bool VoxelBlock::uncompressUnguarded(std::vector<uint8_t> &expanded_buffer)
 {
-  if (voxel_bytes_.empty())
+  if (flags_ & kFUniform)
   {
-    initUncompressed(voxel_bytes_, map_->layout.layer(layer_index_));
-    flags_ |= kFUncompressed;
+    expanded_buffer.resize(uncompressed_byte_size_);
+    if (!expanded_buffer.empty())
+    {
+      memcpy(expanded_buffer.data(), voxel_bytes_.data(), voxel_byte_size_);
+      fillPattern(expanded_buffer.data(), voxel_byte_size_, expanded_buffer.size());
+    }
+    return true;
   }
 
+  const std::vector<uint8_t> &voxel_bytes = storedBytesUnguarded();
   if (flags_ & kFUncompressed)
   {
     // Simply copy existing bytes.
-    expanded_buffer.resize(voxel_bytes_.size());
-    if (!voxel_bytes_.empty())
+    expanded_buffer.resize(voxel_bytes.size());
+    if (!voxel_bytes.empty())
     {
-      memcpy(expanded_buffer.data(), voxel_bytes_.data(), sizeof(*voxel_bytes_.data()) * voxel_bytes_.size());
+      memcpy(expanded_buffer.data(), voxel_bytes.data(), sizeof(*voxel_bytes.data()) * voxel_bytes.size());
     }
     return true;
   }
 
   expanded_buffer.resize(uncompressed_byte_size_);
+  return codec_->decompress(voxel_bytes.data(), voxel_bytes.size(), expanded_buffer.data(), expanded_buffer.size());
+}
 
-  int ret = Z_OK;
-  z_stream stream;
-  memset(&stream, 0u, sizeof(stream));
-  inflateInit2(&stream, kWindowBits | g_zlib_gzip_flag);  // NOLINT(hicpp-signed-bitwise)
 
-  stream.avail_in = unsigned(voxel_bytes_.size());
-  stream.next_in = voxel_bytes_.data();
+const std::vector<uint8_t> &VoxelBlock::storedBytesUnguarded() const
+{
+  return (shared_bytes_) ? *shared_bytes_ : voxel_bytes_;
+}
 
-  stream.avail_out = unsigned(expanded_buffer.size());
-  stream.next_out = static_cast<unsigned char *>(expanded_buffer.data());
 
-  int flush_flag = Z_NO_FLUSH;
-  do
+void VoxelBlock::shareUnguarded()
+{
+  if (!shared_bytes_)
   {
-    ret = inflate(&stream, flush_flag);
+    shared_bytes_ = std::make_shared<const std::vector<uint8_t>>(std::move(voxel_bytes_));
+    voxel_bytes_ = std::vector<uint8_t>();
+    flags_ |= kFShared;
+  }
+}
 
-    switch (ret)
-    {
-    case Z_OK:
-      // Check for insufficient output data on flush or before finishing input data. This is an error an error condition
-      // as we know how large it should be.
-      if (stream.avail_out == 0 && (flush_flag == Z_FINISH || stream.avail_in))
-      {
-        // Failed.
-        inflateEnd(&stream);
-        return false;
-      }
 
-      // Transition to flush if there is no more input data.
-      if (stream.avail_in == 0)
-      {
-        flush_flag = Z_FINISH;
-      }
-      break;
-    case Z_STREAM_END:
-      break;
-    default:
-      // Failed.
-      inflateEnd(&stream);
-      return false;
-    }
-  } while (stream.avail_in || ret != Z_STREAM_END);
+void VoxelBlock::releaseSharedUnguarded()
+{
+  shared_bytes_.reset();
+  flags_ &= ~kFShared;
+}
+
 
-  // Ensure flush.
-  if (flush_flag != Z_FINISH)
+void VoxelBlock::initUniform(const MapLayer &layer)
+{
+  // Value initialise the voxel so any padding bytes not covered by the clear pattern are deterministic.
+  voxel_bytes_.assign(voxel_byte_size_, 0u);
+  layer.clear(voxel_bytes_.data(), glm::u8vec3(1));
+  compressed_byte_size_ = voxel_bytes_.size();
+  codec_.reset();
+  releaseSharedUnguarded();
+  flags_ = (flags_ & ~kFUncompressed) | kFUniform;
+}
+
+
+bool VoxelBlock::collapseUniformUnguarded()
+{
+  const std::vector<uint8_t> &voxel_bytes = storedBytesUnguarded();
+  if (!(flags_ & kFUncompressed) || voxel_bytes.size() < voxel_byte_size_ || voxel_byte_size_ == 0)
   {
-    inflate(&stream, Z_FINISH);
+    return false;
   }
 
-  // Resize compressed buffer.
-  expanded_buffer.resize(expanded_buffer.size() - stream.avail_out);
-  inflateEnd(&stream);
+  // The buffer is a repetition of the first voxel iff every byte matches the byte one voxel later.
+  const size_t compare_size = voxel_bytes.size() - voxel_byte_size_;
+  if (compare_size && memcmp(voxel_bytes.data(), voxel_bytes.data() + voxel_byte_size_, compare_size) != 0)
+  {
+    return false;
+  }
 
+  voxel_bytes_.resize(voxel_byte_size_);
+  compressed_byte_size_ = voxel_bytes_.size();
+  codec_.reset();
+  flags_ = (flags_ & ~kFUncompressed) | kFUniform;
   return true;
 }
 
@@ -380,6 +542,7 @@ void VoxelBlock::setCompressedBytesUnguarded(const std::vector<uint8_t> &compres
   }
   voxel_bytes_.shrink_to_fit();
   compressed_byte_size_ = voxel_bytes_.size();
+  releaseSharedUnguarded();
   // Clear uncompressed flag.
   flags_ &= ~(kFUncompressed);
 }
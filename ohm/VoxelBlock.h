@@ -9,12 +9,14 @@
 #include "OhmConfig.h"
 
 #include "Mutex.h"
+#include "VoxelCodec.h"
 
 #include <glm/fwd.hpp>
 #include <glm/vec3.hpp>
 
 #include <atomic>
 #include <chrono>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -30,21 +32,38 @@ struct OccupancyMapDetail;
 /// Internally the @c VoxelBlock allocates or decompresses voxel memory for its associated @c MapLayer
 /// (@c layerInfo()) when @c retain() is called. It then maintains a reference count for the number of @c retain()
 /// calls ensuring uncompressed voxel data remain valid until all references are by calling @c release(). The block is
-/// then passed to the background compression thread when the last reference is released. The level of compression
-/// can be globally set using the static @c setCompressionControls() function.
+/// then passed to the background compression thread when the last reference is released. The compression algorithm
+/// is selected per layer using @c MapLayer::setCodec() . Layers without a codec use zlib with the level of compression
+/// set globally using the static @c setCompressionControls() function.
 ///
 /// Typically, @c retain() and @c release() should not be called directly. Instead user code should use the @c Voxel
 /// data access object. This object manages multiple aspects of voxel data access including ensuring @c retain() and
 /// @c release() are called as needed.
 ///
-/// When a @c VoxelBlock is pushed onto the background compression queue, it is assigned a release time before which
-/// it cannot be compressed. The background thread cannot compress the block before this time elapses. The time is
-/// updated on each release, ensuring that the block is not compressed until some time after the most recent release.
+/// When a @c VoxelBlock is pushed onto the background compression queue, it is assigned a release time. The time is
+/// updated on each release and the background thread uses this to compress the least recently accessed blocks first.
 /// This is currently based on wall clock time and may change in future.
 ///
 /// The block also deals with cases where the background thread is in the process of compressing the voxel data while
 /// the reference count is non zero or when the background thread is processing the block when the map chunk is
 /// deleted.
+///
+/// Blocks which hold the same value for every voxel are stored in a uniform state, keeping only a single voxel's worth
+/// of bytes (see @c kFUniform ). New blocks start in the uniform state holding the layer clear pattern and the dense
+/// buffer is only allocated on the first writable @c retain() . Since voxel memory is written directly via
+/// @c voxelBytes() , the dense buffer is materialised on @c retain() regardless of whether the caller goes on to write
+/// to the block. Read only access via @c retainReadOnly() does not allocate for a uniform block. Instead it references
+/// a dense expansion of the uniform value which is shared by all blocks of the same voxel value and size while they are
+/// retained. A block collapses back to the uniform state if all its voxels are equal when compressed, either by the
+/// background compression thread or @c compress() . Blocks which are not managed for compression also collapse on the
+/// last @c release() after @c markWritten() , keeping the dense buffer capacity for the next @c retain() . This saves
+/// the memory of layers which are never written for a region as well as regions which are entirely unobserved or free.
+///
+/// Compressed voxel data may also be shared between blocks copy-on-write by @c copyFrom() (see @c kFShared ). Shared
+/// data are immutable. A shared block decompresses into private memory on the next @c retain() , exactly as an
+/// unshared compressed block would, while the other blocks continue to reference the shared data. This makes
+/// snapshots of compressed blocks, such as from @c OccupancyMap::clone() , nearly free without adding a copy to either
+/// block. Uncompressed data are never shared.
 class ohm_API VoxelBlock
 {
   friend VoxelBlockCompressionQueue;
@@ -79,7 +98,15 @@ public:
     /// Block is to be deleted. Only set when the block should be deleted but is currently on the compression thread.
     kFMarkedForDeath = (1u << 2u),
     /// Block is part of the compression system.
-    kFManagedForCompression = (1u << 3u)
+    kFManagedForCompression = (1u << 3u),
+    /// Memory buffer holds a single voxel, the value of which is shared by all voxels in the block. Never set with
+    /// @c kFUncompressed .
+    kFUniform = (1u << 4u),
+    /// The compressed voxel data are shared with other blocks and must not be modified. The share is released on the
+    /// next @c retain() . Never set with @c kFUniform or @c kFUncompressed .
+    kFShared = (1u << 5u),
+    /// The voxel memory has been written, as noted by @c markWritten() , since the block was last fully released.
+    kFWritten = (1u << 6u)
   };
 
   /// Compression level options
@@ -93,7 +120,7 @@ public:
     kCompressMax
   };
 
-  /// Compression type.
+  /// Compression type used by the default codec.
   enum CompressionType
   {
     /// ZLib deflate.
@@ -102,7 +129,8 @@ public:
     kCompressGZip
   };
 
-  /// Static compression controls.
+  /// Static compression controls. These configure the default codec, used for layers which have no
+  /// @c MapLayer::codec() .
   struct ohm_API CompressionControls
   {
     /// Minimum initial buffer size used when compressing a voxel block.
@@ -150,23 +178,75 @@ public:
 
   /// Size of a single voxel in the map.
   /// @return The size of a voxel in bytes.
-  size_t perVoxelByteSize() const;
+  inline size_t perVoxelByteSize() const { return voxel_byte_size_; }
 
   /// Uncompressed data size.
   /// @return The uncompressed size of the voxel map in bytes.
   inline size_t uncompressedByteSize() const { return uncompressed_byte_size_; }
 
+  /// Query the number of bytes currently allocated for the voxel data. This is the @c uncompressedByteSize() when
+  /// uncompressed, the compressed data size when compressed or near @c perVoxelByteSize() when uniform. Data shared by
+  /// @c copyFrom() and the uniform expansion referenced by @c retainReadOnly() are split evenly between the sharing
+  /// blocks.
+  ///
+  /// Threadsafe.
+  ///
+  /// @return The allocated byte size of the voxel data.
+  size_t allocatedByteSize() const;
+
   /// Query current flag values.
   inline unsigned flags() const { return flags_; }
 
-  /// Retain the uncompressed voxel memory until a corresponding @c release() call. Not recommended; use
+  /// Query the number of outstanding @c retain() calls.
+  /// @return The current reference count.
+  inline unsigned referenceCount() const { return reference_count_; }
+
+  /// Query the release time for the block. This is updated when the last @c retain() reference is released and is
+  /// used to prioritise compression of the least recently used blocks.
+  /// @return The release time point.
+  inline Clock::time_point releaseAfter() const { return Clock::time_point(Clock::duration(release_after_)); }
+
+  /// Override the @c releaseAfter() time, which is otherwise set by @c release() . This supports deterministic control
+  /// of the compression order, such as for testing.
+  /// @param time The new release time point.
+  inline void setReleaseAfter(Clock::time_point time) { release_after_ = time.time_since_epoch().count(); }
+
+  /// Query the number of times writable access to the voxel memory has ended. See @c markWritten() .
+  /// @return The current write count.
+  inline unsigned writeCount() const { return write_count_.load(std::memory_order_acquire); }
+
+  /// Note that the voxel memory may have been written outside of the @c Voxel interface, which would otherwise update
+  /// the @c MapChunk::touched_stamps . Called when a writable @c VoxelBuffer is released, so that state derived from
+  /// the voxel data, such as the @c ChunkOccupancySummary , is recalculated. Also sets @c kFWritten .
+  inline void markWritten()
+  {
+    flags_ |= kFWritten;
+    write_count_.fetch_add(1u, std::memory_order_release);
+  }
+
+  /// Retain the uncompressed voxel memory for writing until a corresponding @c release() call. Not recommended; use
   /// @c voxelBuffer().
   ///
   /// This call may block while the voxel memory is uncompressed or allocated an initialised.
   void retain();
 
+  /// Retain the uncompressed voxel memory for reading until a corresponding @c release() call. Not recommended; use
+  /// @c VoxelBuffer<const VoxelBlock> .
+  ///
+  /// Unlike @c retain() , this does not allocate the dense voxel memory for a uniform block. The returned memory is a
+  /// dense expansion of the uniform value, shared with other uniform blocks. As such, writes made via a concurrent
+  /// @c retain() of a uniform block are not visible in the returned memory. Compressed blocks are uncompressed as for
+  /// @c retain() .
+  ///
+  /// @return The uncompressed voxel memory, valid until the matching @c release() .
+  const uint8_t *retainReadOnly();
+
   /// Release the uncompressed voxel memory until a corresponding @c release() call. Not recommended; use
   /// @c voxelBuffer().
+  ///
+  /// The last release after a @c markWritten() collapses the block to the uniform state if all voxels are equal,
+  /// unless the block is managed for compression, in which case this is left to the compression queue. The dense
+  /// buffer capacity is kept, so retaining the block again does not allocate.
   void release();
 
 #if 0
@@ -183,7 +263,8 @@ public:
   /// Attempt to compress the @c VoxelBlock memory.
   ///
   /// This call can only succeed if the current reference count is zero (and the kFLocked flag is clear). The compressed
-  /// data size is returned on success.
+  /// data size is returned on success. The block is collapsed to the uniform state rather than compressed if all
+  /// voxels are equal, in which case the size of the uniform voxel is returned.
   ///
   /// Threadsafe.
   ///
@@ -194,7 +275,8 @@ public:
   /// compression.
   ///
   /// This call can only succeed if the current reference count is zero (and the kFLocked flag is clear). The compressed
-  /// data size is returned on success.
+  /// data size is returned on success. Blocks where all voxels are equal are collapsed to the uniform state as for
+  /// @c compress() .
   ///
   /// Threadsafe.
   ///
@@ -203,7 +285,24 @@ public:
   /// @return The compressed data size on success, zero on failure.
   size_t compressWithTemporaryBuffer(std::vector<uint8_t> &compression_buffer);
 
-  /// Direct access to the voxel bytes. Should be retained first. For internal use.
+  /// Copy the voxel data from @p src , preserving the uniform, compressed or uncompressed state of @p src . This avoids
+  /// decompressing or expanding the source data.
+  ///
+  /// With @p copy_on_write , compressed @p src data are shared by both blocks rather than copied. Either block
+  /// decompresses into its own memory when next retained, as it would without sharing. Uniform and uncompressed @p src
+  /// data are always copied, so the @p src block may continue to be modified without an additional copy. Note that
+  /// sharing changes the internal state of @p src , but not its voxel content.
+  ///
+  /// When this block is currently retained, the @p src data are uncompressed into the existing voxel memory instead.
+  ///
+  /// Threadsafe, except that this block must not be concurrently copied into @p src . For internal use.
+  ///
+  /// @param src The block to copy from. Must have the same voxel and uncompressed byte sizes as this block.
+  /// @param copy_on_write True to share the @p src data where possible.
+  /// @return True on success, false if the block sizes do not match or decompression fails.
+  bool copyFrom(VoxelBlock &src, bool copy_on_write = false);
+
+  /// Direct access to the voxel bytes. Should be retained first with @c retain() . For internal use.
   /// @return Voxel bytes.
   uint8_t *voxelBytes();
 
@@ -215,6 +314,13 @@ public:
   /// @param layer_index The new layer index.
   void updateLayerIndex(unsigned layer_index);
 
+  /// Internal function for recycling the block into a new region. Resets the voxel data to the uniform cleared state
+  /// for @p layer , retaining the existing voxel memory capacity for reuse on the next @c retain() . The
+  /// @c VoxelBlockCompressionQueue continues to count the retained capacity and may release it under memory pressure.
+  /// The block must not be retained. For internal use.
+  /// @param layer The layer the block represents.
+  void reset(const MapLayer &layer);
+
 private:
   /// True if the map configuration supports compression of this voxel block.
   bool supportsCompression() const;
@@ -226,11 +332,32 @@ private:
   ///   though the capacity may be larger.
   /// @return True if compressio into @p compression_buffer succeeded.
   bool compressUnguarded(std::vector<uint8_t> &compression_buffer);
+  /// Access the current voxel data, which are either the @c shared_bytes_ or the @c voxel_bytes_ .
+  /// @return The voxel data in the state described by the @c flags_ .
+  const std::vector<uint8_t> &storedBytesUnguarded() const;
+  /// Move the compressed @c voxel_bytes_ into the @c shared_bytes_ , if not already shared, so they may be shared by
+  /// @c copyFrom() .
+  void shareUnguarded();
+  /// Release any @c shared_bytes_ reference, clearing @c kFShared . The @c voxel_bytes_ must already hold the
+  /// current voxel data.
+  void releaseSharedUnguarded();
+  /// Ensure the @c voxel_bytes_ hold uncompressed voxel data, without locking the mutex. Called from @c retain()
+  /// and @c retainReadOnly() .
+  /// @return The number of bytes allocated beyond the previous capacity of the @c voxel_bytes_ .
+  size_t uncompressRetainedUnguarded();
   /// Decompress voxel data into @p expanded_buffer without locking the mutex. This is called from @c retain() after
   /// the mutex is locked.
   /// @param expanded_buffer The buffer to populate with uncompressed data.
   /// @return True on successfully decompressing.
   bool uncompressUnguarded(std::vector<uint8_t> &expanded_buffer);
+  /// Set the voxel data to the uniform state holding the clear pattern for @p layer . The @c voxel_bytes_ capacity is
+  /// retained.
+  /// @param layer The layer used to initialise the memory. Must be explicitly passed to handle map layout changes.
+  void initUniform(const MapLayer &layer);
+  /// Collapse uncompressed voxel data to the uniform state if all voxels are equal. The @c voxel_bytes_ capacity is
+  /// retained.
+  /// @return True if the block is now uniform.
+  bool collapseUniformUnguarded();
   /// Initialise the given buffer to uncompressed voxel data. The voxel data is cleared to the appropriate pattern
   /// for the voxel layer.
   /// @param expanded_buffer The buffer to initialised.
@@ -245,26 +372,39 @@ private:
   /// Voxel data.
   ///
   /// This data can be in one of three states:
-  /// 1. Empty implying no changes have been made from the default initialised values.
-  /// 2. Uncompressed when not empty and `flags_ & kFUncompressed` set.
-  /// 3. Compressed when not emtpy and `flags_ & kFUncompressed` clear.
+  /// 1. Uniform when `flags_ & kFUniform` is set, holding a single voxel shared by all voxels.
+  /// 2. Uncompressed when `flags_ & kFUncompressed` set.
+  /// 3. Compressed when neither flag is set.
+  ///
+  /// Empty while the compressed data are held in @c shared_bytes_ .
   std::vector<uint8_t> voxel_bytes_;
+  /// Immutable compressed voxel data shared with other blocks when `flags_ & kFShared` is set. See @c copyFrom() .
+  std::shared_ptr<const std::vector<uint8_t>> shared_bytes_;
+  /// Dense expansion of the uniform voxel referenced by @c retainReadOnly() calls. Held until the last @c release() .
+  std::shared_ptr<const std::vector<uint8_t>> uniform_view_;
   /// Data access mutex
   mutable Mutex access_guard_;
   /// Number of oustandting @c retain() calls. Cannot be compressed while no zero.
   std::atomic_uint32_t reference_count_{ 0 };
   /// Block status @c Flag values.
   std::atomic_uint32_t flags_{ 0 };
-  /// Timepoint after which the block may be compressed.
-  Clock::time_point release_after_;
+  /// Timepoint after which the block may be compressed, stored as @c Clock ticks for atomic access. See
+  /// @c releaseAfter() .
+  std::atomic<Clock::rep> release_after_{ 0 };
+  /// Number of @c markWritten() calls.
+  std::atomic_uint32_t write_count_{ 0 };
   /// The owning occupancy map detail.
   const OccupancyMapDetail *map_ = nullptr;
   /// The index into the @c MapLayout represented by this voxel data.
   unsigned layer_index_ = 0;
+  /// Byte size of a single voxel.
+  size_t voxel_byte_size_ = 0;
   /// Byte size of this voxel block when uncompressed.
   size_t uncompressed_byte_size_ = 0;
-  /// Byte size of this voxel block when uncompressed.
+  /// Byte size of this voxel block when compressed or uniform.
   size_t compressed_byte_size_ = 0;
+  /// The codec used to compress the current @c voxel_bytes_ . Only valid when compressed.
+  VoxelCodec::Ptr codec_;
 };
 
 inline uint8_t *VoxelBlock::voxelBytes()
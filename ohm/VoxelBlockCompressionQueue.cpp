@@ -11,6 +11,11 @@
 
 #include <logutil/Logger.h>
 
+#ifdef OHM_THREADS
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif  // OHM_THREADS
+
 #include <algorithm>
 #include <chrono>
 #include <cinttypes>
@@ -18,7 +23,20 @@
 
 namespace ohm
 {
-const int kSleepIntervalMs = 50;
+namespace
+{
+/// Interval at which the background thread wakes when not notified of the high tide being crossed. This is required to
+/// clean up blocks marked for death and refresh the allocation estimate.
+const int kIdleIntervalMs = 1000;
+/// Minimum interval between ticks while we remain over the high tide.
+const int kBusyIntervalMs = 10;
+/// Maximum number of blocks to compress per worker thread in each compression round. Memory usage is re-evaluated
+/// after each round.
+const unsigned kBlocksPerWorkerRound = 8u;
+
+using Clock = std::chrono::steady_clock;
+}  // namespace
+
 
 VoxelBlockCompressionQueue &VoxelBlockCompressionQueue::instance()
 {
@@ -98,12 +116,61 @@ uint64_t VoxelBlockCompressionQueue::estimatedAllocationSize() const
 }
 
 
+bool VoxelBlockCompressionQueue::setWorkerCount(unsigned worker_count)
+{
+#ifdef OHM_THREADS
+  imp_->worker_count = worker_count;
+  return true;
+#else   // OHM_THREADS
+  (void)worker_count;
+  imp_->worker_count = 1;
+  return false;
+#endif  // OHM_THREADS
+}
+
+
+unsigned VoxelBlockCompressionQueue::workerCount() const
+{
+  return imp_->worker_count;
+}
+
+
+VoxelBlockCompressionQueue::Stats VoxelBlockCompressionQueue::stats() const
+{
+  Stats stats;
+  stats.blocks_compressed = imp_->blocks_compressed;
+  stats.bytes_saved = imp_->bytes_saved;
+  stats.blocks_per_second = imp_->blocks_per_second;
+  stats.lag_seconds = imp_->lag_seconds;
+  return stats;
+}
+
+
+void VoxelBlockCompressionQueue::notifyAllocation(uint64_t byte_count)
+{
+  const uint64_t pending = imp_->pending_allocation += byte_count;
+  if (imp_->estimated_allocated_size + pending >= imp_->high_tide)
+  {
+    // Note the time the high tide was crossed if not already set.
+    Clock::rep not_crossed = 0;
+    imp_->high_tide_crossed.compare_exchange_strong(not_crossed, Clock::now().time_since_epoch().count());
+    // Wake the processing thread if we haven't already requested it.
+    if (imp_->running && !imp_->wake_flag.exchange(true))
+    {
+      std::unique_lock<std::mutex> guard(imp_->wake_lock);
+      imp_->wake_condition.notify_one();
+    }
+  }
+}
+
+
 void VoxelBlockCompressionQueue::push(VoxelBlock *block)
 {
   if (imp_->running || imp_->test_mode)
   {
     block->flags_ |= VoxelBlock::kFManagedForCompression;
     ohm::push(*imp_, block);
+    notifyAllocation(block->uncompressed_byte_size_);
   }
 }
 
@@ -116,6 +183,10 @@ bool VoxelBlockCompressionQueue::testMode() const
 
 void VoxelBlockCompressionQueue::__tick(std::vector<uint8_t> &compression_buffer)
 {
+  // Clear the wake flag and pending allocation. The memory usage is recalculated below.
+  imp_->wake_flag = false;
+  imp_->pending_allocation = 0;
+
   // Process any new items added to the compression queue by adding them to the block list.
   {
     VoxelBlock *voxels = nullptr;
@@ -130,91 +201,163 @@ void VoxelBlockCompressionQueue::__tick(std::vector<uint8_t> &compression_buffer
   uint64_t memory_usage = 0;
   const uint64_t high_tide = imp_->high_tide;
   const uint64_t low_tide = imp_->low_tide;
-  for (auto iter = imp_->blocks.begin(); iter != imp_->blocks.end();)
+  // Compact the block list in place as we go to avoid repeated erasure.
+  size_t live_count = 0;
+  for (size_t i = 0; i < imp_->blocks.size(); ++i)
   {
-    CompressionEntry &entry = *iter;
+    CompressionEntry &entry = imp_->blocks[i];
     // Check if marked for death.
     if (!(entry.voxels->flags_ & VoxelBlock::kFMarkedForDeath))
     {
       // Still alive. Update th entry's allocation size.
-      if (entry.voxels->flags_ & VoxelBlock::kFUncompressed)
+      const unsigned flags = entry.voxels->flags_;
+      if (flags & VoxelBlock::kFUncompressed)
       {
         entry.allocation_size = entry.voxels->uncompressed_byte_size_;
       }
+      else if (flags & (VoxelBlock::kFShared | VoxelBlock::kFUniform))
+      {
+        // Count only this block's portion of shared data, so the shared allocation is counted once. Uniform blocks may
+        // hold the capacity kept by VoxelBlock::reset() .
+        entry.allocation_size = entry.voxels->allocatedByteSize();
+      }
       else
       {
         entry.allocation_size = entry.voxels->compressed_byte_size_;
       }
 
       memory_usage += entry.allocation_size;
-      ++iter;
+      imp_->blocks[live_count++] = entry;
     }
     else
     {
-      // Marked for death. Remove this entry;
       // Block no longer required. Remove it.
-      // Marked for death. Clean it up.
       // Lock access guard to make sure the code that sets the flag has completed
-      iter->voxels->access_guard_.lock();
-      // fprintf(stderr, "0x%" PRIXPTR ", VoxelBlockCompressionQueue\n", (uintptr_t)iter->voxels);
-      delete iter->voxels;
-      iter = imp_->blocks.erase(iter);
+      entry.voxels->access_guard_.lock();
+      delete entry.voxels;
     }
   }
+  imp_->blocks.resize(live_count);
 
   // Check if we are over the high tide and release what we can.
   if (memory_usage >= high_tide)
   {
-    // Sort all blocks by allocation size.
-    // TODO(KS): consider including the queued for compression flag so we push items to be compressed to the front
-    // of the sort results.
-    // TODO(KS): try using a partial sort.
-    std::sort(imp_->blocks.begin(), imp_->blocks.end(), [](const CompressionEntry &a, const CompressionEntry &b) {
-      return a.allocation_size > b.allocation_size;
-    });
-
-    auto iter = imp_->blocks.begin();
-    // Free until we reach the low tide.
-    while (iter != imp_->blocks.end() && memory_usage >= low_tide)
+    Clock::rep crossed = imp_->high_tide_crossed;
+    const auto compression_start = Clock::now();
+    if (!crossed)
     {
-      // Check if marked for death. The status may have changed since we updated the allocation size.
-      if (!(iter->voxels->flags_ & VoxelBlock::kFMarkedForDeath))
+      crossed = compression_start.time_since_epoch().count();
+    }
+
+    // Collect the compression candidates: uncompressed, unlocked blocks and uniform blocks holding more than a single
+    // voxel. Shared blocks are already compressed and are never candidates. Prioritise by least recent release time.
+    // We use a heap rather than a full sort as we generally only need to compress a subset of the blocks.
+    using Candidate = std::pair<VoxelBlock::Clock::rep, size_t>;
+    std::vector<Candidate> candidates;
+    for (size_t i = 0; i < imp_->blocks.size(); ++i)
+    {
+      const CompressionEntry &entry = imp_->blocks[i];
+      const unsigned flags = entry.voxels->flags_;
+      const bool uniform_excess =
+        (flags & VoxelBlock::kFUniform) && entry.allocation_size > entry.voxels->voxel_byte_size_;
+      if (((flags & VoxelBlock::kFUncompressed) || uniform_excess) &&
+          !(flags & (VoxelBlock::kFLocked | VoxelBlock::kFMarkedForDeath | VoxelBlock::kFShared)))
       {
-        // Not maked for death. Check lock flag and compress this item if we can
-        if (!(iter->voxels->flags_ & VoxelBlock::kFLocked))
+        candidates.emplace_back(entry.voxels->release_after_, i);
+      }
+    }
+    const auto candidate_order = [](const Candidate &a, const Candidate &b) { return a.first > b.first; };
+    std::make_heap(candidates.begin(), candidates.end(), candidate_order);
+
+    unsigned worker_count = imp_->worker_count;
+#ifdef OHM_THREADS
+    worker_count = (worker_count) ? worker_count : unsigned(tbb::this_task_arena::max_concurrency());
+    if (imp_->arena_concurrency != int(worker_count))
+    {
+      if (imp_->arena_concurrency)
+      {
+        imp_->arena.terminate();
+      }
+      imp_->arena.initialize(int(worker_count));
+      imp_->arena_concurrency = int(worker_count);
+    }
+#else   // OHM_THREADS
+    worker_count = 1;
+#endif  // OHM_THREADS
+    const size_t max_round_size = size_t(worker_count) * kBlocksPerWorkerRound;
+    std::vector<size_t> round;
+    std::vector<size_t> compressed_sizes;
+    uint64_t blocks_compressed = 0;
+
+    // Compress in rounds until we reach the low tide.
+    while (!candidates.empty() && memory_usage >= low_tide)
+    {
+      // Select the next round of blocks. We select only as many blocks as could be required to reach the low tide,
+      // assuming each block compressed to nothing. This ensures we do not compress more than required.
+      round.clear();
+      uint64_t round_allocation = 0;
+      const uint64_t required_reduction = memory_usage - low_tide;
+      while (!candidates.empty() && round.size() < max_round_size && round_allocation <= required_reduction)
+      {
+        std::pop_heap(candidates.begin(), candidates.end(), candidate_order);
+        round.emplace_back(candidates.back().second);
+        round_allocation += imp_->blocks[candidates.back().second].allocation_size;
+        candidates.pop_back();
+      }
+
+      // Try compress the selected blocks. This could fail as the flags can have changed. On failure, the
+      // compressed_size will be zero. We call compressWithTemporaryBuffer() to re-use the compression buffer memory.
+      compressed_sizes.resize(round.size());
+#ifdef OHM_THREADS
+      if (worker_count > 1 && round.size() > 1)
+      {
+        imp_->arena.execute([&]() {
+          tbb::parallel_for(size_t(0), round.size(), [&](size_t i) {
+            std::vector<uint8_t> &worker_buffer = imp_->worker_buffers.local();
+            compressed_sizes[i] = imp_->blocks[round[i]].voxels->compressWithTemporaryBuffer(worker_buffer);
+          });
+        });
+      }
+      else
+#endif  // OHM_THREADS
+      {
+        for (size_t i = 0; i < round.size(); ++i)
         {
-          // Block is not locked.
           logutil::trace("compress\n");
-          // Try compress the current item. This could fail as the flag can have changed. On failure, the
-          // compressed_size will be zero. We call compressWithTemporaryBuffer() to re-use the compression buffer
-          // memory.
-          size_t compressed_size = iter->voxels->compressWithTemporaryBuffer(compression_buffer);
-          if (compressed_size)
-          {
-            // Compression succeeded.
-            // Adjust memory_usage down in a way which guarantees no underflow. Paranoia.
-            memory_usage = (memory_usage > iter->allocation_size) ? memory_usage - iter->allocation_size : 0u;
-            memory_usage += compressed_size;
-          }
+          compressed_sizes[i] = imp_->blocks[round[i]].voxels->compressWithTemporaryBuffer(compression_buffer);
         }
-
-        ++iter;
       }
-      else
+
+      for (size_t i = 0; i < round.size(); ++i)
       {
-        // Block no longer required. Remove it.
-        // Marked for death. Clean it up.
-        // Lock access guard to make sure the code that sets the flag has completed
-        iter->voxels->access_guard_.lock();
-        // fprintf(stderr, "0x%" PRIXPTR ", VoxelBlockCompressionQueue\n", (uintptr_t)iter->voxels);
-        delete iter->voxels;
-        // Adjust memory_usage down in a way which guarantees no underflow. Paranoia.
-        memory_usage = (memory_usage > iter->allocation_size) ? memory_usage - iter->allocation_size : 0u;
-        iter = imp_->blocks.erase(iter);
+        const size_t compressed_size = compressed_sizes[i];
+        if (compressed_size)
+        {
+          // Compression succeeded.
+          CompressionEntry &entry = imp_->blocks[round[i]];
+          // Adjust memory_usage down in a way which guarantees no underflow. Paranoia.
+          memory_usage = (memory_usage > entry.allocation_size) ? memory_usage - entry.allocation_size : 0u;
+          memory_usage += compressed_size;
+          imp_->bytes_saved += (entry.allocation_size > compressed_size) ? entry.allocation_size - compressed_size : 0u;
+          entry.allocation_size = compressed_size;
+          ++blocks_compressed;
+        }
       }
     }
+
+    const auto compression_end = Clock::now();
+    const double elapsed = std::chrono::duration<double>(compression_end - compression_start).count();
+    imp_->blocks_compressed += blocks_compressed;
+    imp_->blocks_per_second = (elapsed > 0) ? double(blocks_compressed) / elapsed : 0.0;
+    imp_->lag_seconds =
+      std::chrono::duration<double>(compression_end - Clock::time_point(Clock::duration(crossed))).count();
   }
 
+  if (memory_usage < low_tide)
+  {
+    // Compression is only complete once we reach the low tide. Until then, the lag is measured from the first crossing.
+    imp_->high_tide_crossed = 0;
+  }
   imp_->estimated_allocated_size = memory_usage;
 }
 
@@ -223,7 +366,11 @@ void VoxelBlockCompressionQueue::joinCurrentThread()
   // Mark thread for quit.
   if (imp_->running)
   {
-    imp_->quit_flag = true;
+    {
+      std::unique_lock<std::mutex> guard(imp_->wake_lock);
+      imp_->quit_flag = true;
+      imp_->wake_condition.notify_one();
+    }
     imp_->processing_thread.join();
     // Clear the running and quit flags.
     imp_->running = false;
@@ -237,8 +384,21 @@ void VoxelBlockCompressionQueue::run()
   std::vector<uint8_t> compression_buffer;
   while (!imp_->quit_flag)
   {
-    std::this_thread::sleep_for(std::chrono::milliseconds(kSleepIntervalMs));
-    __tick(compression_buffer);
+    {
+      // Sleep until notified of crossing the high tide or the idle interval elapses.
+      std::unique_lock<std::mutex> guard(imp_->wake_lock);
+      imp_->wake_condition.wait_for(guard, std::chrono::milliseconds(kIdleIntervalMs),
+                                    [this]() { return imp_->quit_flag || imp_->wake_flag; });
+    }
+    if (!imp_->quit_flag)
+    {
+      __tick(compression_buffer);
+      if (imp_->estimated_allocated_size >= imp_->high_tide)
+      {
+        // Still over the high tide; most likely all remaining blocks are locked. Avoid spinning on wake requests.
+        std::this_thread::sleep_for(std::chrono::milliseconds(kBusyIntervalMs));
+      }
+    }
   }
 }
 }  // namespace ohm
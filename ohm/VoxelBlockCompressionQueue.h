@@ -8,6 +8,8 @@
 
 #include "OhmConfig.h"
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace ohm
@@ -22,9 +24,28 @@ struct VoxelBlockCompressionQueueDetail;
 /// last reference then attaining a new reference to start a new background thread.
 ///
 /// An @c OccupancyMap will call @c retain() and @c release() on construction and destruction respectively.
+///
+/// The background thread sleeps until notified that the estimated allocation has crossed the @c highTide() , or until
+/// an idle interval elapses. Once woken, blocks are compressed in least recently released order (see
+/// @c VoxelBlock::releaseAfter() ) until the allocation falls below the @c lowTide() . Compression may be spread across
+/// multiple worker threads - see @c setWorkerCount() .
 class ohm_API VoxelBlockCompressionQueue
 {
 public:
+  /// Compression statistics. See @c stats() .
+  struct ohm_API Stats
+  {
+    /// Total number of blocks compressed.
+    uint64_t blocks_compressed = 0;
+    /// Total number of bytes saved by compression.
+    uint64_t bytes_saved = 0;
+    /// Compression rate over the most recent compression cycle.
+    double blocks_per_second = 0;
+    /// Queue lag: the time (seconds) between the high tide being crossed and the most recent compression cycle
+    /// completing. Measured from the first crossing until the allocation is brought back below the low tide.
+    double lag_seconds = 0;
+  };
+
   /// Singleton access.
   static VoxelBlockCompressionQueue &instance();
 
@@ -57,6 +78,28 @@ public:
   /// Query the number of bytes allocated to voxel blocks managed by this compressor (byte).
   uint64_t estimatedAllocationSize() const;
 
+  /// Set the number of worker threads used to compress voxel blocks once the high tide is exceeded.
+  ///
+  /// Setting the @p worker_count to zero uses the maximum number of threads. Setting the @p worker_count to 1
+  /// compresses on the background thread only (default).
+  ///
+  /// @param worker_count The number of worker threads.
+  /// @return True if multi-threading is available. False when no multi-threading is available and @p worker_count is
+  /// ignored.
+  bool setWorkerCount(unsigned worker_count);
+  /// Query the number of worker threads used for compression. See @c setWorkerCount() .
+  /// @return The number of compression threads.
+  unsigned workerCount() const;
+
+  /// Query compression statistics.
+  /// @return The current statistics.
+  Stats stats() const;
+
+  /// Notify the queue of additional memory allocated to managed voxel blocks. This may wake the background thread
+  /// when the @c highTide() is crossed. For internal use; called when a block is pushed or uncompressed.
+  /// @param byte_count The number of bytes allocated.
+  void notifyAllocation(uint64_t byte_count);
+
   /// Push a @c VoxelBlock on the queue for compression.
   /// @param block The block to compress.
   void push(VoxelBlock *block);
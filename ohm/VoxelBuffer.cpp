@@ -7,15 +7,46 @@
 
 namespace ohm
 {
+namespace
+{
+/// Mark the @p block of a writable buffer as written. See @c VoxelBlock::markWritten() .
+inline void markWritten(VoxelBlock *block, std::false_type /*is_const*/)
+{
+  block->markWritten();
+}
+
+
+/// Overload for read only buffers, which cannot have written the @p block .
+inline void markWritten(VoxelBlock * /*block*/, std::true_type /*is_const*/) {}
+
+
+/// Retain the @p block of a writable buffer. See @c VoxelBlock::retain() .
+/// @return The voxel memory.
+inline uint8_t *retainVoxels(VoxelBlock *block, std::false_type /*is_const*/)
+{
+  block->retain();
+  return block->voxelBytes();
+}
+
+
+/// Retain the @p block of a read only buffer, which need not allocate uniform blocks. See
+/// @c VoxelBlock::retainReadOnly() .
+/// @return The voxel memory.
+inline const uint8_t *retainVoxels(VoxelBlock *block, std::true_type /*is_const*/)
+{
+  return block->retainReadOnly();
+}
+}  // namespace
+
+
 template <typename VoxelBlock>
 VoxelBuffer<VoxelBlock>::VoxelBuffer(ohm::VoxelBlock *block)
   : voxel_block_(block)
 {
   if (block)
   {
-    block->retain();
+    voxel_memory_ = retainVoxels(block, std::is_const<VoxelBlock>());
     voxel_memory_size_ = block->uncompressedByteSize();
-    voxel_memory_ = block->voxelBytes();
   }
 }
 
@@ -24,6 +55,7 @@ VoxelBuffer<VoxelBlock>::VoxelBuffer(VoxelBuffer<VoxelBlock> &&other) noexcept
   : voxel_memory_(std::exchange(other.voxel_memory_, nullptr))
   , voxel_memory_size_(std::exchange(other.voxel_memory_size_, 0))
   , voxel_block_(std::exchange(other.voxel_block_, nullptr))
+  , written_(std::exchange(other.written_, false))
 {}
 
 template <typename VoxelBlock>
@@ -34,7 +66,7 @@ VoxelBuffer<VoxelBlock>::VoxelBuffer(const VoxelBuffer<VoxelBlock> &other)
 {
   if (voxel_block_)
   {
-    voxel_block_->retain();
+    voxel_memory_ = retainVoxels(voxel_block_, std::is_const<VoxelBlock>());
   }
 }
 
@@ -50,6 +82,7 @@ VoxelBuffer<VoxelBlock> &VoxelBuffer<VoxelBlock>::operator=(VoxelBuffer<VoxelBlo
   std::swap(voxel_block_, other.voxel_block_);
   std::swap(voxel_memory_size_, other.voxel_memory_size_);
   std::swap(voxel_memory_, other.voxel_memory_);
+  std::swap(written_, other.written_);
   return *this;
 }
 
@@ -62,9 +95,8 @@ VoxelBuffer<VoxelBlock> &VoxelBuffer<VoxelBlock>::operator=(const VoxelBuffer<Vo
     voxel_block_ = other.voxel_block_;
     if (voxel_block_)
     {
-      voxel_block_->retain();
+      voxel_memory_ = retainVoxels(voxel_block_, std::is_const<VoxelBlock>());
       voxel_memory_size_ = voxel_block_->uncompressedByteSize();
-      voxel_memory_ = voxel_block_->voxelBytes();
     }
   }
   return *this;
@@ -75,10 +107,15 @@ void VoxelBuffer<VoxelBlock>::release()
 {
   if (voxel_block_)
   {
+    if (written_)
+    {
+      markWritten(voxel_block_, std::is_const<VoxelBlock>());
+    }
     voxel_block_->release();
     voxel_block_ = nullptr;
     voxel_memory_ = nullptr;
     voxel_memory_size_ = 0;
+    written_ = false;
   }
 }
 
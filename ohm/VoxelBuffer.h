@@ -64,11 +64,16 @@ public:
   bool isValid() const { return voxel_memory_ != nullptr; }
 
   /// Access the raw memory stored by the wrapped @c VoxelBlock . The returned point is `const` when the template type
-  /// is `const`.
+  /// is `const`. Accessing the memory of a writable buffer notes the buffer as written, as the memory may be modified
+  /// (see @c release() ).
   ///
   /// Must only be called if @c isValid() is `true`.
   /// @return A pointer to the referenced voxel memory.
-  VoxelPtr voxelMemory() const { return voxel_memory_; }
+  VoxelPtr voxelMemory() const
+  {
+    written_ = written_ || !std::is_const<VoxelBlock>::value;
+    return voxel_memory_;
+  }
   /// Query the uncompressed byte size of the voxel memory for the retained layer.
   /// @return The uncompressed size for the voxel memory, or zero when @c isValid() is `false`.
   size_t voxelMemorySize() const { return voxel_memory_size_; }
@@ -84,7 +89,7 @@ public:
   template <typename T>
   void readVoxel(unsigned voxel_index, T *value)
   {
-    memcpy(value, voxelMemory() + sizeof(T) * voxel_index, sizeof(T));
+    memcpy(value, voxel_memory_ + sizeof(T) * voxel_index, sizeof(T));
   }
 
   /// Write the content for a voxel in the buffer. Must only be called if @c isValid() , @c voxel_index is in range
@@ -99,12 +104,16 @@ public:
   }
 
   /// Explicitly release the buffer. Further usage is invalid and @c isValid() will return `false`.
+  ///
+  /// Releasing a writable buffer calls @c ohm::VoxelBlock::markWritten() if the buffer has been written with
+  /// @c writeVoxel() or its @c voxelMemory() accessed.
   void release();
 
 protected:
   VoxelPtr voxel_memory_{ nullptr };         ///< Pointer to the uncompressed voxel memory.
   size_t voxel_memory_size_{ 0 };            ///< Number of bytes referenced by the @c voxel_memory_ .
   ohm::VoxelBlock *voxel_block_{ nullptr };  ///< The @c VoxelBlock object owning the voxel memory.
+  mutable bool written_{ false };            ///< Set when the voxel memory may have been written.
 };
 
 extern template class VoxelBuffer<VoxelBlock>;
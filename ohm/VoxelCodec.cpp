@@ -0,0 +1,457 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "VoxelCodec.h"
+
+#include "MapChunk.h"
+#include "MapLayout.h"
+#include "OccupancyMap.h"
+#include "VoxelBlock.h"
+#include "VoxelBuffer.h"
+
+#include <zlib.h>
+
+#ifdef OHM_WITH_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif  // OHM_WITH_LZ4
+
+#ifdef OHM_WITH_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif  // OHM_WITH_ZSTD
+
+#include <algorithm>
+#include <cstring>
+
+namespace ohm
+{
+namespace
+{
+const size_t kMinimumBufferSize = 1024u;
+/// When reserving compressed buffer space, divide the uncompressed size by this factor.
+const size_t kBufferReservationQutient = 10u;
+
+class ZLibCodec : public VoxelCodec
+{
+public:
+  static constexpr int kWindowBits = 14;
+  static constexpr int kZLibMemLevel = 8;
+  static constexpr int kCompressionStrategy = Z_DEFAULT_STRATEGY;
+  static constexpr int kGZipCompressionFlag = 16;
+
+  ZLibCodec(Type type, Level level)
+    : VoxelCodec(type, level)
+    , gzip_flag_((type == kGZip) ? kGZipCompressionFlag : 0)
+  {
+    switch (level)
+    {
+    default:
+    case kLevelFast:
+      zlib_level_ = Z_BEST_SPEED;
+      break;
+    case kLevelBalanced:
+      zlib_level_ = Z_DEFAULT_COMPRESSION;
+      break;
+    case kLevelMax:
+      zlib_level_ = Z_BEST_COMPRESSION;
+      break;
+    }
+  }
+
+  bool compress(const uint8_t *src, size_t src_size, std::vector<uint8_t> &dst) const override
+  {
+    int ret = Z_OK;
+    z_stream stream;
+    memset(&stream, 0u, sizeof(stream));
+    // NOLINTNEXTLINE(hicpp-signed-bitwise)
+    deflateInit2(&stream, zlib_level_, Z_DEFLATED, kWindowBits | gzip_flag_, kZLibMemLevel, kCompressionStrategy);
+
+    stream.next_in = const_cast<Bytef *>(src);  // NOLINT(cppcoreguidelines-pro-type-const-cast)
+    stream.avail_in = unsigned(src_size);
+
+    dst.reserve(std::max(src_size / kBufferReservationQutient, kMinimumBufferSize));
+    dst.resize(dst.capacity());
+
+    stream.avail_out = unsigned(dst.size());
+    stream.next_out = dst.data();
+
+    int flush_flag = Z_NO_FLUSH;
+    do
+    {
+      ret = deflate(&stream, flush_flag);
+
+      switch (ret)
+      {
+      case Z_OK:
+        // Done with input data. Make sure we change to flushing.
+        if (stream.avail_in == 0)
+        {
+          flush_flag = Z_FINISH;
+        }
+
+        // Check for insufficient output data before Z_STREAM_END.
+        if (stream.avail_out == 0)
+        {
+          // Output buffer too small.
+          const size_t bytes_so_far = dst.size();
+          dst.resize(2 * bytes_so_far);
+          stream.avail_out = unsigned(dst.size() - bytes_so_far);
+          stream.next_out = dst.data() + bytes_so_far;
+        }
+        break;
+      case Z_STREAM_END:
+        break;
+      default:
+        // Failed.
+        deflateEnd(&stream);
+        return false;
+      }
+    } while (stream.avail_in || ret != Z_STREAM_END);
+
+    // Ensure flush.
+    if (flush_flag != Z_FINISH)
+    {
+      deflate(&stream, Z_FINISH);
+    }
+
+    ret = deflateEnd(&stream);
+    if (ret != Z_OK)
+    {
+      return false;
+    }
+
+    // Resize compressed buffer.
+    dst.resize(dst.size() - stream.avail_out);
+    return true;
+  }
+
+  bool decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size) const override
+  {
+    int ret = Z_OK;
+    z_stream stream;
+    memset(&stream, 0u, sizeof(stream));
+    inflateInit2(&stream, kWindowBits | gzip_flag_);  // NOLINT(hicpp-signed-bitwise)
+
+    stream.avail_in = unsigned(src_size);
+    stream.next_in = const_cast<Bytef *>(src);  // NOLINT(cppcoreguidelines-pro-type-const-cast)
+
+    stream.avail_out = unsigned(dst_size);
+    stream.next_out = dst;
+
+    int flush_flag = Z_NO_FLUSH;
+    do
+    {
+      ret = inflate(&stream, flush_flag);
+
+      switch (ret)
+      {
+      case Z_OK:
+        // Check for insufficient output data on flush or before finishing input data. This is an error condition as
+        // we know how large it should be.
+        if (stream.avail_out == 0 && (flush_flag == Z_FINISH || stream.avail_in))
+        {
+          // Failed.
+          inflateEnd(&stream);
+          return false;
+        }
+
+        // Transition to flush if there is no more input data.
+        if (stream.avail_in == 0)
+        {
+          flush_flag = Z_FINISH;
+        }
+        break;
+      case Z_STREAM_END:
+        break;
+      default:
+        // Failed.
+        inflateEnd(&stream);
+        return false;
+      }
+    } while (stream.avail_in || ret != Z_STREAM_END);
+
+    // Ensure flush.
+    if (flush_flag != Z_FINISH)
+    {
+      inflate(&stream, Z_FINISH);
+    }
+
+    const bool ok = stream.avail_out == 0;
+    inflateEnd(&stream);
+    return ok;
+  }
+
+private:
+  int zlib_level_ = Z_BEST_SPEED;
+  int gzip_flag_ = 0;
+};
+
+#ifdef OHM_WITH_LZ4
+class Lz4Codec : public VoxelCodec
+{
+public:
+  explicit Lz4Codec(Level level)
+    : VoxelCodec(kLz4, level)
+  {}
+
+  bool compress(const uint8_t *src, size_t src_size, std::vector<uint8_t> &dst) const override
+  {
+    if (src_size > size_t(LZ4_MAX_INPUT_SIZE))
+    {
+      return false;
+    }
+
+    dst.resize(size_t(LZ4_compressBound(int(src_size))));
+    int compressed_size = 0;
+    switch (level())
+    {
+    default:
+    case kLevelFast:
+      compressed_size = LZ4_compress_default(reinterpret_cast<const char *>(src), reinterpret_cast<char *>(dst.data()),
+                                             int(src_size), int(dst.size()));
+      break;
+    case kLevelBalanced:
+      compressed_size = LZ4_compress_HC(reinterpret_cast<const char *>(src), reinterpret_cast<char *>(dst.data()),
+                                        int(src_size), int(dst.size()), LZ4HC_CLEVEL_DEFAULT);
+      break;
+    case kLevelMax:
+      compressed_size = LZ4_compress_HC(reinterpret_cast<const char *>(src), reinterpret_cast<char *>(dst.data()),
+                                        int(src_size), int(dst.size()), LZ4HC_CLEVEL_MAX);
+      break;
+    }
+
+    if (compressed_size <= 0)
+    {
+      dst.clear();
+      return false;
+    }
+
+    dst.resize(size_t(compressed_size));
+    return true;
+  }
+
+  bool decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size) const override
+  {
+    const int decompressed_size = LZ4_decompress_safe(reinterpret_cast<const char *>(src),
+                                                      reinterpret_cast<char *>(dst), int(src_size), int(dst_size));
+    return decompressed_size >= 0 && size_t(decompressed_size) == dst_size;
+  }
+};
+#endif  // OHM_WITH_LZ4
+
+#ifdef OHM_WITH_ZSTD
+class ZstdCodec : public VoxelCodec
+{
+public:
+  ZstdCodec(Level level, const std::vector<uint8_t> &dictionary)
+    : VoxelCodec(kZstd, level)
+  {
+    switch (level)
+    {
+    default:
+    case kLevelFast:
+      zstd_level_ = 1;
+      break;
+    case kLevelBalanced:
+      zstd_level_ = ZSTD_CLEVEL_DEFAULT;
+      break;
+    case kLevelMax:
+      zstd_level_ = 19;
+      break;
+    }
+
+    if (!dictionary.empty())
+    {
+      cdict_ = ZSTD_createCDict(dictionary.data(), dictionary.size(), zstd_level_);
+      ddict_ = ZSTD_createDDict(dictionary.data(), dictionary.size());
+    }
+  }
+
+  ~ZstdCodec() override
+  {
+    ZSTD_freeCDict(cdict_);
+    ZSTD_freeDDict(ddict_);
+  }
+
+  ZstdCodec(const ZstdCodec &) = delete;
+  ZstdCodec &operator=(const ZstdCodec &) = delete;
+
+  bool compress(const uint8_t *src, size_t src_size, std::vector<uint8_t> &dst) const override
+  {
+    ZSTD_CCtx *cctx = threadContexts().cctx;
+    dst.resize(ZSTD_compressBound(src_size));
+    const size_t compressed_size =
+      (cdict_) ? ZSTD_compress_usingCDict(cctx, dst.data(), dst.size(), src, src_size, cdict_) :
+                 ZSTD_compressCCtx(cctx, dst.data(), dst.size(), src, src_size, zstd_level_);
+    if (ZSTD_isError(compressed_size))
+    {
+      dst.clear();
+      return false;
+    }
+    dst.resize(compressed_size);
+    return true;
+  }
+
+  bool decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size) const override
+  {
+    ZSTD_DCtx *dctx = threadContexts().dctx;
+    const size_t decompressed_size = (ddict_) ? ZSTD_decompress_usingDDict(dctx, dst, dst_size, src, src_size, ddict_) :
+                                                ZSTD_decompressDCtx(dctx, dst, dst_size, src, src_size);
+    return !ZSTD_isError(decompressed_size) && decompressed_size == dst_size;
+  }
+
+private:
+  /// Zstd contexts are expensive to create, so we maintain a set per thread. The contexts may be used with any
+  /// @c ZstdCodec instance.
+  struct Contexts
+  {
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+
+    Contexts() = default;
+    Contexts(const Contexts &) = delete;
+    Contexts &operator=(const Contexts &) = delete;
+    ~Contexts()
+    {
+      ZSTD_freeCCtx(cctx);
+      ZSTD_freeDCtx(dctx);
+    }
+  };
+
+  static Contexts &threadContexts()
+  {
+    static thread_local Contexts contexts;
+    return contexts;
+  }
+
+  int zstd_level_ = 1;
+  ZSTD_CDict *cdict_ = nullptr;
+  ZSTD_DDict *ddict_ = nullptr;
+};
+#endif  // OHM_WITH_ZSTD
+}  // namespace
+
+
+bool VoxelCodec::supported(Type type)
+{
+  switch (type)
+  {
+  case kZLib:
+  case kGZip:
+    return true;
+#ifdef OHM_WITH_LZ4
+  case kLz4:
+    return true;
+#endif  // OHM_WITH_LZ4
+#ifdef OHM_WITH_ZSTD
+  case kZstd:
+    return true;
+#endif  // OHM_WITH_ZSTD
+  default:
+    break;
+  }
+  return false;
+}
+
+
+const char *VoxelCodec::typeName(Type type)
+{
+  switch (type)
+  {
+  case kZLib:
+    return "zlib";
+  case kGZip:
+    return "gzip";
+  case kLz4:
+    return "lz4";
+  case kZstd:
+    return "zstd";
+  default:
+    break;
+  }
+  return "<unknown>";
+}
+
+
+VoxelCodec::Ptr VoxelCodec::create(Type type, Level level, const std::vector<uint8_t> &dictionary)
+{
+  (void)dictionary;
+  switch (type)
+  {
+  case kZLib:
+  case kGZip:
+    return std::make_shared<ZLibCodec>(type, level);
+#ifdef OHM_WITH_LZ4
+  case kLz4:
+    return std::make_shared<Lz4Codec>(level);
+#endif  // OHM_WITH_LZ4
+#ifdef OHM_WITH_ZSTD
+  case kZstd:
+    return std::make_shared<ZstdCodec>(level, dictionary);
+#endif  // OHM_WITH_ZSTD
+  default:
+    break;
+  }
+  return nullptr;
+}
+
+
+bool VoxelCodec::trainDictionary(std::vector<uint8_t> &dictionary, const OccupancyMap &map, int layer_index,
+                                 size_t dictionary_size, size_t max_samples)
+{
+  dictionary.clear();
+#ifdef OHM_WITH_ZSTD
+  if (layer_index < 0 || unsigned(layer_index) >= map.layout().layerCount())
+  {
+    return false;
+  }
+
+  std::vector<const MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  if (chunks.empty())
+  {
+    return false;
+  }
+  chunks.resize(std::min(chunks.size(), max_samples));
+
+  std::vector<uint8_t> samples;
+  std::vector<size_t> sample_sizes;
+  sample_sizes.reserve(chunks.size());
+  for (const MapChunk *chunk : chunks)
+  {
+    VoxelBuffer<const VoxelBlock> buffer(chunk->voxel_blocks[layer_index]);
+    samples.insert(samples.end(), buffer.voxelMemory(), buffer.voxelMemory() + buffer.voxelMemorySize());
+    sample_sizes.emplace_back(buffer.voxelMemorySize());
+  }
+
+  dictionary.resize(dictionary_size);
+  const size_t trained_size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(),
+                                                    sample_sizes.data(), unsigned(sample_sizes.size()));
+  if (ZDICT_isError(trained_size))
+  {
+    dictionary.clear();
+    return false;
+  }
+  dictionary.resize(trained_size);
+  return true;
+#else   // OHM_WITH_ZSTD
+  (void)map;
+  (void)layer_index;
+  (void)dictionary_size;
+  (void)max_samples;
+  return false;
+#endif  // OHM_WITH_ZSTD
+}
+
+
+VoxelCodec::VoxelCodec(Type type, Level level)
+  : type_(type)
+  , level_(level)
+{}
+
+
+VoxelCodec::~VoxelCodec() = default;
+}  // namespace ohm
@@ -0,0 +1,137 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_VOXELCODEC_H
+#define OHM_VOXELCODEC_H
+
+#include "OhmConfig.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ohm
+{
+class OccupancyMap;
+
+/// Defines the compression algorithm used by a @c VoxelBlock to compress voxel data for a @c MapLayer .
+///
+/// Codecs are selected per layer using @c MapLayer::setCodec() . Layers with no codec use the global zlib settings
+/// from @c VoxelBlock::setCompressionControls() . A @c VoxelBlock retains the codec used to compress its data, so a
+/// layer's codec may be changed without invalidating existing compressed blocks.
+///
+/// zlib (deflate and gzip) is always available. LZ4 and Zstd are optional and only available when ohm is built with
+/// the corresponding libraries - see @c supported() . LZ4 favours decompression speed which is typically the most
+/// important factor since voxel blocks are decompressed whenever they are retained. Zstd supports a trained dictionary,
+/// which can significantly improve the compression of small, repetitive blocks such as occupancy layers. See
+/// @c trainDictionary() .
+///
+/// Codec objects are immutable once created and are invoked concurrently from multiple threads.
+class ohm_API VoxelCodec
+{
+public:
+  /// Shared pointer type for a codec.
+  using Ptr = std::shared_ptr<const VoxelCodec>;
+
+  /// Codec algorithm identifiers.
+  enum Type : uint8_t
+  {
+    /// zlib deflate.
+    kZLib,
+    /// zlib with gzip header.
+    kGZip,
+    /// LZ4 block compression. Optional.
+    kLz4,
+    /// Zstandard compression. Optional.
+    kZstd
+  };
+
+  /// Compression level, mapped to an appropriate level for each codec.
+  enum Level : uint8_t
+  {
+    /// Use the fastest compression.
+    kLevelFast,
+    /// Use balanced size/speed compression.
+    kLevelBalanced,
+    /// Use maximum compression (slowest).
+    kLevelMax
+  };
+
+  /// Query whether the given codec @p type is available in this build.
+  /// @param type The codec to query.
+  /// @return True if @c create() will succeed for @p type .
+  static bool supported(Type type);
+
+  /// Query the name of a codec type.
+  /// @param type The codec type.
+  /// @return The codec name string.
+  static const char *typeName(Type type);
+
+  /// Create a codec of the given @p type .
+  /// @param type The codec type.
+  /// @param level The compression level.
+  /// @param dictionary Optional compression dictionary. Only used by @c kZstd and must remain the same for compression
+  ///   and decompression. See @c trainDictionary() .
+  /// @return The codec or null if @p type is not supported.
+  static Ptr create(Type type, Level level = kLevelFast, const std::vector<uint8_t> &dictionary = {});
+
+  /// Train a compression dictionary for the layer @p layer_index from the existing voxel data in @p map . Each region
+  /// in the map is used as a training sample, up to @p max_samples regions.
+  ///
+  /// This is only supported for @c kZstd .
+  ///
+  /// @param[out] dictionary The trained dictionary. Cleared on failure.
+  /// @param map The map to sample.
+  /// @param layer_index The index of the layer to train for.
+  /// @param dictionary_size The target dictionary size in bytes.
+  /// @param max_samples The maximum number of regions to sample.
+  /// @return True on success.
+  static bool trainDictionary(std::vector<uint8_t> &dictionary, const OccupancyMap &map, int layer_index,
+                              size_t dictionary_size = 16 * 1024u, size_t max_samples = 2000u);
+
+  /// Constructor.
+  /// @param type The codec type.
+  /// @param level The compression level.
+  VoxelCodec(Type type, Level level);
+
+  /// Virtual destructor.
+  virtual ~VoxelCodec();
+
+  /// Query the codec type.
+  /// @return The codec type.
+  inline Type type() const { return type_; }
+
+  /// Query the compression level.
+  /// @return The compression level.
+  inline Level level() const { return level_; }
+
+  /// Query the codec name.
+  /// @return The codec name string.
+  inline const char *name() const { return typeName(type_); }
+
+  /// Compress @p src into @p dst .
+  /// @param src The data to compress.
+  /// @param src_size The number of bytes in @p src .
+  /// @param[in,out] dst The buffer to compress into. Resized to exactly match the compressed size on success, though the
+  ///   capacity may be larger. The existing capacity is reused where possible.
+  /// @return True on success.
+  virtual bool compress(const uint8_t *src, size_t src_size, std::vector<uint8_t> &dst) const = 0;
+
+  /// Decompress @p src into @p dst . The uncompressed size must be known in advance.
+  /// @param src The compressed data.
+  /// @param src_size The number of bytes in @p src .
+  /// @param dst The buffer to decompress into.
+  /// @param dst_size The expected uncompressed size. Decompression fails if the data do not exactly fill @p dst .
+  /// @return True on success.
+  virtual bool decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size) const = 0;
+
+private:
+  Type type_;
+  Level level_;
+};
+}  // namespace ohm
+
+#endif  // OHM_VOXELCODEC_H
@@ -0,0 +1,233 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "ChunkMap.h"
+
+#include "MapChunk.h"
+
+#include <mutex>
+
+namespace ohm
+{
+static_assert((ChunkMap::kShardCount & (ChunkMap::kShardCount - 1)) == 0, "Shard count must be a power of 2");
+
+ChunkMap::ChunkMap() = default;
+
+
+ChunkMap::~ChunkMap() = default;
+
+
+unsigned ChunkMap::shardIndex(const KeyType &region)
+{
+  // Match Key::regionHash(). The shard maps use fibonacci hashing which uses the high bits, so using the low bits here
+  // does not affect the distribution within each shard.
+  const glm::u32vec3 rk = region;
+  return vhash::hashBits(rk.x, rk.y, rk.z) & (kShardCount - 1u);
+}
+
+
+MapChunk *ChunkMap::lookup(const KeyType &region, bool pin) const
+{
+  const Shard &shard = shards_[shardIndex(region)];
+  std::shared_lock<SharedMutex> guard(shard.mutex);
+  const auto iter = shard.map.find(region);
+  if (iter != shard.map.end())
+  {
+    if (pin)
+    {
+      iter->second->pin();
+    }
+    return iter->second;
+  }
+  return nullptr;
+}
+
+
+MapChunk *ChunkMap::lookupOrCreate(const KeyType &region, const CreateFunction &create, bool *created, bool pin)
+{
+  Shard &shard = shards_[shardIndex(region)];
+  {
+    std::shared_lock<SharedMutex> guard(shard.mutex);
+    const auto iter = shard.map.find(region);
+    if (iter != shard.map.end())
+    {
+      if (created)
+      {
+        *created = false;
+      }
+      if (pin)
+      {
+        iter->second->pin();
+      }
+      return iter->second;
+    }
+  }
+
+  std::unique_lock<SharedMutex> guard(shard.mutex);
+  // Check again in case another thread created the region while we were unlocked.
+  const auto iter = shard.map.find(region);
+  if (iter != shard.map.end())
+  {
+    if (created)
+    {
+      *created = false;
+    }
+    if (pin)
+    {
+      iter->second->pin();
+    }
+    return iter->second;
+  }
+
+  MapChunk *chunk = create();
+  shard.map.insert(std::make_pair(region, chunk));
+  ++count_;
+  if (created)
+  {
+    *created = true;
+  }
+  if (pin)
+  {
+    chunk->pin();
+  }
+  return chunk;
+}
+
+
+MapChunk *ChunkMap::remove(const KeyType &region)
+{
+  Shard &shard = shards_[shardIndex(region)];
+  std::unique_lock<SharedMutex> guard(shard.mutex);
+  const auto iter = shard.map.find(region);
+  if (iter != shard.map.end())
+  {
+    MapChunk *chunk = iter->second;
+    shard.map.erase(iter);
+    --count_;
+    return chunk;
+  }
+  return nullptr;
+}
+
+
+MapChunk *ChunkMap::removeIf(const KeyType &region, const std::function<bool(const MapChunk &)> &predicate)
+{
+  Shard &shard = shards_[shardIndex(region)];
+  std::unique_lock<SharedMutex> guard(shard.mutex);
+  const auto iter = shard.map.find(region);
+  if (iter != shard.map.end() && predicate(*iter->second))
+  {
+    MapChunk *chunk = iter->second;
+    shard.map.erase(iter);
+    --count_;
+    return chunk;
+  }
+  return nullptr;
+}
+
+
+ChunkMap::iterator ChunkMap::find(const KeyType &region)
+{
+  const unsigned shard_index = shardIndex(region);
+  ShardMap &map = shards_[shard_index].map;
+  const auto iter = map.find(region);
+  return (iter != map.end()) ? iterator(this, shard_index, iter) : end();
+}
+
+
+ChunkMap::const_iterator ChunkMap::find(const KeyType &region) const
+{
+  const unsigned shard_index = shardIndex(region);
+  const ShardMap &map = shards_[shard_index].map;
+  const auto iter = map.find(region);
+  return (iter != map.end()) ? const_iterator(this, shard_index, iter) : end();
+}
+
+
+std::pair<ChunkMap::iterator, bool> ChunkMap::insert(const std::pair<KeyType, MapChunk *> &item)
+{
+  const unsigned shard_index = shardIndex(item.first);
+  const auto result = shards_[shard_index].map.insert(item);
+  if (result.second)
+  {
+    ++count_;
+  }
+  return std::make_pair(iterator(this, shard_index, result.first), result.second);
+}
+
+
+ChunkMap::iterator ChunkMap::erase(const_iterator iter)
+{
+  const unsigned shard_index = iter.shard_;
+  // Erasure yields an iterator to the next item in the shard. The iterator constructor skips to the next shard as
+  // required.
+  ShardMap::iterator next = shards_[shard_index].map.erase(iter.iter_);
+  --count_;
+  return iterator(this, shard_index, next);
+}
+
+
+void ChunkMap::clear()
+{
+  for (Shard &shard : shards_)
+  {
+    shard.map.clear();
+  }
+  count_ = 0;
+}
+
+
+size_t ChunkMap::bucket_count() const
+{
+  size_t bucket_count = 0;
+  for (const Shard &shard : shards_)
+  {
+    bucket_count += shard.map.bucket_count();
+  }
+  return bucket_count;
+}
+
+
+float ChunkMap::max_load_factor() const
+{
+  return shards_[0].map.max_load_factor();
+}
+
+
+void ChunkMap::lock() const
+{
+  for (const Shard &shard : shards_)
+  {
+    shard.mutex.lock();
+  }
+}
+
+
+void ChunkMap::unlock() const
+{
+  for (const Shard &shard : shards_)
+  {
+    shard.mutex.unlock();
+  }
+}
+
+
+void ChunkMap::lock_shared() const
+{
+  for (const Shard &shard : shards_)
+  {
+    shard.mutex.lock_shared();
+  }
+}
+
+
+void ChunkMap::unlock_shared() const
+{
+  for (const Shard &shard : shards_)
+  {
+    shard.mutex.unlock_shared();
+  }
+}
+}  // namespace ohm
@@ -0,0 +1,264 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_CHUNKMAP_H
+#define OHM_CHUNKMAP_H
+
+#include "OhmConfig.h"
+
+#include <ohmutil/VectorHash.h>
+
+#include <glm/vec3.hpp>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif  // __GNUC__
+#include <ska/bytell_hash_map.hpp>
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif  // __GNUC__
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <shared_mutex>
+
+namespace ohm
+{
+struct MapChunk;
+
+/// The region index for an @c OccupancyMap : a hash map of region coordinates to @c MapChunk objects which supports
+/// concurrent access.
+///
+/// The map is split into @c kShardCount shards, selected by the region hash (see @c Key::regionHash() ). Each shard
+/// has its own hash map and reader/writer lock. This supports two access modes:
+///
+/// - Concurrent access via @c lookup() , @c lookupOrCreate() and @c remove() . These lock only the relevant shard, so
+///   lookups of existing regions proceed in parallel with each other and only contend with region creation or removal
+///   in the same shard.
+/// - Whole map access, such as iteration, @c find() , @c insert() , @c erase() and @c clear() . These do not lock and
+///   the caller must either hold a whole map lock or otherwise guarantee exclusive access. The @c ChunkMap meets the
+///   standard @c SharedMutex requirements for this purpose, locking all shards. Use @c std::shared_lock for read only
+///   access - which allows concurrent lookups to continue - or @c std::unique_lock when modifying the map.
+///
+/// Shard locks are always acquired in shard order so whole map and single shard locks do not deadlock. Whole map locks
+/// are not recursive and must not be held when making a concurrent access call.
+class ohm_API ChunkMap
+{
+public:
+  /// Region coordinate type.
+  using KeyType = glm::i16vec3;
+  /// Hash map used for each shard.
+  using ShardMap = ska::bytell_hash_map<KeyType, MapChunk *, Vector3Hash<KeyType>>;
+  /// Shard lock type.
+  using SharedMutex = std::shared_timed_mutex;
+
+  /// Number of shards. Must be a power of 2.
+  static constexpr unsigned kShardCount = 64u;
+
+  /// Iterator across all shards. Iteration requires a whole map lock.
+  template <typename Owner, typename ShardIterator>
+  class base_iterator  // NOLINT(readability-identifier-naming)
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename std::iterator_traits<ShardIterator>::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = typename std::iterator_traits<ShardIterator>::pointer;
+    using reference = typename std::iterator_traits<ShardIterator>::reference;
+
+    base_iterator() = default;
+    base_iterator(Owner *owner, unsigned shard, ShardIterator iter)
+      : owner_(owner)
+      , shard_(shard)
+      , iter_(iter)
+    {
+      skipEmptyShards();
+    }
+
+    /// Conversion from a non-const iterator.
+    template <typename OtherOwner, typename OtherIterator>
+    base_iterator(const base_iterator<OtherOwner, OtherIterator> &other)  // NOLINT(google-explicit-constructor)
+      : owner_(other.owner_)
+      , shard_(other.shard_)
+      , iter_(other.iter_)
+    {}
+
+    inline reference operator*() const { return *iter_; }
+    inline pointer operator->() const { return &*iter_; }
+
+    inline base_iterator &operator++()
+    {
+      ++iter_;
+      skipEmptyShards();
+      return *this;
+    }
+
+    inline base_iterator operator++(int)
+    {
+      base_iterator copy(*this);
+      ++(*this);
+      return copy;
+    }
+
+    inline bool operator==(const base_iterator &other) const
+    {
+      return shard_ == other.shard_ && (shard_ == kShardCount || iter_ == other.iter_);
+    }
+
+    inline bool operator!=(const base_iterator &other) const { return !(*this == other); }
+
+  private:
+    template <typename OtherOwner, typename OtherIterator>
+    friend class base_iterator;
+    friend ChunkMap;
+
+    /// Move to the start of the next non-empty shard if at the end of the current shard.
+    void skipEmptyShards()
+    {
+      while (shard_ < kShardCount && iter_ == owner_->shards_[shard_].map.end())
+      {
+        ++shard_;
+        if (shard_ < kShardCount)
+        {
+          iter_ = owner_->shards_[shard_].map.begin();
+        }
+        else
+        {
+          iter_ = ShardIterator();
+        }
+      }
+    }
+
+    Owner *owner_ = nullptr;
+    unsigned shard_ = kShardCount;
+    ShardIterator iter_{};
+  };
+
+  /// Iterator type.
+  using iterator = base_iterator<ChunkMap, ShardMap::iterator>;  // NOLINT(readability-identifier-naming)
+  /// Const iterator type.
+  using const_iterator =  // NOLINT(readability-identifier-naming)
+    base_iterator<const ChunkMap, ShardMap::const_iterator>;
+
+  /// Function used to create a missing region in @c lookupOrCreate() .
+  using CreateFunction = std::function<MapChunk *()>;
+
+  ChunkMap();
+  ~ChunkMap();
+
+  ChunkMap(const ChunkMap &) = delete;
+  ChunkMap &operator=(const ChunkMap &) = delete;
+
+  /// Calculate the shard index for the region @p region .
+  /// @param region The region coordinate.
+  /// @return The shard index for @p region .
+  static unsigned shardIndex(const KeyType &region);
+
+  //-------------------------------------------------------------------------------------------------------------------
+  // Concurrent access. Must not be called while holding a whole map lock.
+  //-------------------------------------------------------------------------------------------------------------------
+
+  /// Lookup an existing region. Only blocks while the region's shard is being modified.
+  /// @param region The region coordinate.
+  /// @param pin True to @c MapChunk::pin() the chunk while the shard is locked, so that it cannot be concurrently
+  ///   removed by @c removeIf() .
+  /// @return The region chunk or null if not present.
+  MapChunk *lookup(const KeyType &region, bool pin = false) const;
+
+  /// Lookup a region, creating it using @p create if not present. Creation is serialised within the shard only.
+  /// @param region The region coordinate.
+  /// @param create Function used to create the region. Invoked while the shard is locked.
+  /// @param[out] created Optionally set to true when the region is created, false when it exists.
+  /// @param pin True to @c MapChunk::pin() the chunk while the shard is locked.
+  /// @return The existing or created region chunk.
+  MapChunk *lookupOrCreate(const KeyType &region, const CreateFunction &create, bool *created = nullptr,
+                           bool pin = false);
+
+  /// Remove the region at @p region .
+  /// @param region The region coordinate.
+  /// @return The removed chunk, which is now owned by the caller, or null if not present.
+  MapChunk *remove(const KeyType &region);
+
+  /// Remove the region at @p region only if @p predicate passes for its chunk. The @p predicate is evaluated while the
+  /// shard is exclusively locked, so no concurrent @c lookup() can obtain or pin the chunk before it is removed.
+  /// @param region The region coordinate.
+  /// @param predicate Removal condition. Must not call back into the @c ChunkMap .
+  /// @return The removed chunk, which is now owned by the caller, or null if not present or the @p predicate fails.
+  MapChunk *removeIf(const KeyType &region, const std::function<bool(const MapChunk &)> &predicate);
+
+  /// Query the number of regions. This is atomic and requires no lock.
+  /// @return The number of regions.
+  inline size_t size() const { return count_; }
+
+  /// Query if there are no regions. This is atomic and requires no lock.
+  /// @return True if empty.
+  inline bool empty() const { return count_ == 0; }
+
+  //-------------------------------------------------------------------------------------------------------------------
+  // Whole map access. Requires a whole map lock or exclusive access.
+  //-------------------------------------------------------------------------------------------------------------------
+
+  iterator begin() { return iterator(this, 0, shards_[0].map.begin()); }
+  const_iterator begin() const { return const_iterator(this, 0, shards_[0].map.begin()); }
+  iterator end() { return iterator(); }
+  const_iterator end() const { return const_iterator(); }
+
+  /// Find a region without locking.
+  /// @param region The region coordinate.
+  /// @return An iterator to the region or @c end() .
+  iterator find(const KeyType &region);
+  /// @overload
+  const_iterator find(const KeyType &region) const;
+
+  /// Insert a region without locking. Does not replace existing items.
+  /// @param item The region coordinate and chunk pair.
+  /// @return A pair of the iterator to the existing or inserted item and true on insertion.
+  std::pair<iterator, bool> insert(const std::pair<KeyType, MapChunk *> &item);
+
+  /// Erase the item at @p iter without locking.
+  /// @param iter The item to erase.
+  /// @return An iterator to the next item.
+  iterator erase(const_iterator iter);
+
+  /// Remove all items without locking. Does not delete the chunks.
+  void clear();
+
+  /// Query the total number of buckets across all shards.
+  /// @return The bucket count.
+  size_t bucket_count() const;  // NOLINT(readability-identifier-naming)
+
+  /// Query the maximum load factor of the hash maps.
+  /// @return The maximum load factor.
+  float max_load_factor() const;  // NOLINT(readability-identifier-naming)
+
+  //-------------------------------------------------------------------------------------------------------------------
+  // Whole map locking (SharedMutex requirements).
+  //-------------------------------------------------------------------------------------------------------------------
+
+  /// Lock all shards for exclusive access.
+  void lock() const;
+  /// Release an exclusive lock from @c lock() .
+  void unlock() const;
+  /// Lock all shards for shared, read only access. Concurrent @c lookup() calls continue to succeed.
+  void lock_shared() const;  // NOLINT(readability-identifier-naming)
+  /// Release a shared lock from @c lock_shared() .
+  void unlock_shared() const;  // NOLINT(readability-identifier-naming)
+
+private:
+  struct Shard
+  {
+    ShardMap map;
+    mutable SharedMutex mutex;
+  };
+
+  std::array<Shard, kShardCount> shards_;
+  std::atomic_size_t count_{ 0 };
+};
+}  // namespace ohm
+
+#endif  // OHM_CHUNKMAP_H
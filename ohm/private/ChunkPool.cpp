@@ -0,0 +1,153 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "ChunkPool.h"
+
+#include "MapChunk.h"
+#include "MapLayer.h"
+#include "MapLayout.h"
+#include "VoxelBlock.h"
+
+#include "OccupancyMapDetail.h"
+
+namespace ohm
+{
+namespace
+{
+/// Check the voxel memory of @p chunk matches the current layout of @p detail .
+bool matchesLayout(const MapChunk &chunk, const OccupancyMapDetail &detail)
+{
+  const MapLayout &layout = detail.layout;
+  if (chunk.voxel_blocks.size() != layout.layerCount())
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < layout.layerCount(); ++i)
+  {
+    if (chunk.voxel_blocks[i]->uncompressedByteSize() != layout.layer(i).layerByteSize(detail.region_voxel_dimensions))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+}  // namespace
+
+
+ChunkPool::~ChunkPool()
+{
+  clear();
+}
+
+
+size_t ChunkPool::capacity() const
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+  return capacity_;
+}
+
+
+void ChunkPool::setCapacity(size_t capacity)
+{
+  std::vector<MapChunk *> excess;
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    capacity_ = capacity;
+    if (chunks_.size() > capacity_)
+    {
+      excess.assign(chunks_.begin() + std::ptrdiff_t(capacity_), chunks_.end());
+      chunks_.resize(capacity_);
+    }
+  }
+
+  for (MapChunk *chunk : excess)
+  {
+    delete chunk;
+  }
+}
+
+
+size_t ChunkPool::size() const
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+  return chunks_.size();
+}
+
+
+MapChunk *ChunkPool::acquire(const MapRegion &region, const OccupancyMapDetail &detail)
+{
+  MapChunk *chunk = nullptr;
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    if (!chunks_.empty())
+    {
+      chunk = chunks_.back();
+      chunks_.pop_back();
+    }
+  }
+
+  const MapLayout &layout = detail.layout;
+  if (chunk && !matchesLayout(*chunk, detail))
+  {
+    // The layout has been changed without clearing the pool, such as when loading a map.
+    delete chunk;
+    chunk = nullptr;
+  }
+
+  if (!chunk)
+  {
+    return new MapChunk(region, detail);
+  }
+
+  // Reset the recycled chunk outside the lock.
+  chunk->region = region;
+  chunk->first_valid_index = ~0u;
+  chunk->touched_time = 0;
+  chunk->dirty_stamp = 0u;
+  chunk->flags = 0;
+  for (size_t i = 0; i < layout.layerCount(); ++i)
+  {
+    chunk->touched_stamps[i] = 0u;
+    chunk->voxel_blocks[i]->reset(layout.layer(i));
+  }
+  chunk->occupancy_summary->invalidate();
+
+  return chunk;
+}
+
+
+void ChunkPool::release(const MapChunk *chunk)
+{
+  chunk->map->dirty_chunks.remove(chunk);
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    if (chunks_.size() < capacity_)
+    {
+      // Pooled chunks are modified before reuse.
+      chunks_.emplace_back(const_cast<MapChunk *>(chunk));  // NOLINT(cppcoreguidelines-pro-type-const-cast)
+      return;
+    }
+  }
+
+  delete chunk;
+}
+
+
+void ChunkPool::clear()
+{
+  std::vector<MapChunk *> chunks;
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    chunks.swap(chunks_);
+  }
+
+  for (MapChunk *chunk : chunks)
+  {
+    delete chunk;
+  }
+}
+}  // namespace ohm
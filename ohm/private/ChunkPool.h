@@ -0,0 +1,72 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_CHUNKPOOL_H
+#define OHM_CHUNKPOOL_H
+
+#include "OhmConfig.h"
+
+#include <mutex>
+#include <vector>
+
+namespace ohm
+{
+struct MapChunk;
+struct MapRegion;
+struct OccupancyMapDetail;
+
+/// A pool of released @c MapChunk objects for recycling into new regions. See @c OccupancyMap::setChunkPoolSize() .
+///
+/// A pooled chunk retains its @c VoxelBlock objects and their voxel memory, so recycling a chunk avoids the system
+/// allocator for the @c MapChunk , each @c VoxelBlock and the voxel buffers. Since all chunks in a map share the same
+/// @c MapLayout and region dimensions, any pooled chunk may be recycled for any new region. The pool must be cleared
+/// whenever the map layout changes.
+///
+/// The pool is thread safe. It may be used while holding the @c ChunkMap locks, but not the reverse.
+class ChunkPool
+{
+public:
+  /// Constructor.
+  ChunkPool() = default;
+  /// Destructor - deletes the pooled chunks.
+  ~ChunkPool();
+
+  ChunkPool(const ChunkPool &) = delete;
+  ChunkPool &operator=(const ChunkPool &) = delete;
+
+  /// Query the maximum number of chunks to retain in the pool.
+  /// @return The pool capacity. Zero when pooling is disabled.
+  size_t capacity() const;
+
+  /// Set the maximum number of chunks to retain in the pool, releasing excess chunks.
+  /// @param capacity The pool capacity. Zero disables pooling.
+  void setCapacity(size_t capacity);
+
+  /// Query the number of chunks currently in the pool.
+  /// @return The number of pooled chunks.
+  size_t size() const;
+
+  /// Acquire a chunk for @p region , recycling a pooled chunk if available. A recycled chunk is reset to the same
+  /// state as a newly constructed chunk.
+  /// @param region The region for the chunk.
+  /// @param detail The map the chunk belongs to.
+  /// @return The chunk.
+  MapChunk *acquire(const MapRegion &region, const OccupancyMapDetail &detail);
+
+  /// Release @p chunk to the pool, or delete it when the pool is full. The chunk must no longer be in the map.
+  /// @param chunk The chunk to release.
+  void release(const MapChunk *chunk);
+
+  /// Delete all the pooled chunks.
+  void clear();
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<MapChunk *> chunks_;
+  size_t capacity_ = 0;
+};
+}  // namespace ohm
+
+#endif  // OHM_CHUNKPOOL_H
@@ -0,0 +1,107 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "DirtyChunkList.h"
+
+#include "MapChunk.h"
+
+#include <algorithm>
+
+namespace ohm
+{
+void DirtyChunkList::touch(MapChunk *chunk)
+{
+  // Early out without the lock when the chunk is already the most recent entry and its order stamp covers the new dirty
+  // stamp. This is the common case when a walk re-enters the chunk it last modified and avoids serialising all writers
+  // of a map on the mutex_. The order stamp is published before the tail_, so a stale order stamp only fails the check.
+  if (tail_.load(std::memory_order_acquire) == chunk &&
+      chunk->dirty_order_stamp.load(std::memory_order_acquire) >= chunk->dirty_stamp.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  std::unique_lock<std::mutex> guard(mutex_);
+  MapChunk *tail = tail_.load(std::memory_order_relaxed);
+  uint64_t order_stamp = chunk->dirty_stamp;
+  if (tail != chunk)
+  {
+    unlink(chunk);
+    tail = tail_.load(std::memory_order_relaxed);
+    if (tail)
+    {
+      order_stamp = std::max(order_stamp, tail->dirty_order_stamp.load(std::memory_order_relaxed));
+      tail->dirty_next = chunk;
+      chunk->dirty_prev = tail;
+    }
+    else
+    {
+      head_ = chunk;
+    }
+  }
+  else if (chunk->dirty_prev)
+  {
+    order_stamp = std::max(order_stamp, chunk->dirty_prev->dirty_order_stamp.load(std::memory_order_relaxed));
+  }
+  order_stamp = std::max(order_stamp, chunk->dirty_order_stamp.load(std::memory_order_relaxed));
+  chunk->dirty_order_stamp.store(order_stamp, std::memory_order_release);
+  tail_.store(chunk, std::memory_order_release);
+}
+
+
+void DirtyChunkList::remove(const MapChunk *chunk)
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+  // The links are owned by the list.
+  unlink(const_cast<MapChunk *>(chunk));  // NOLINT(cppcoreguidelines-pro-type-const-cast)
+}
+
+
+void DirtyChunkList::collect(uint64_t from_stamp, std::vector<std::pair<uint64_t, glm::i16vec3>> &regions) const
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+  // The order stamps bound the dirty stamps from above and are non-decreasing along the list, so no earlier chunk can
+  // have been modified after from_stamp once an order stamp is reached which is not.
+  for (const MapChunk *chunk = tail_.load(std::memory_order_relaxed); chunk && chunk->dirty_order_stamp > from_stamp;
+       chunk = chunk->dirty_prev)
+  {
+    const uint64_t dirty_stamp = chunk->dirty_stamp;
+    if (dirty_stamp > from_stamp)
+    {
+      regions.emplace_back(dirty_stamp, chunk->region.coord);
+    }
+  }
+}
+
+
+void DirtyChunkList::unlink(MapChunk *chunk)
+{
+  if (!chunk->dirty_prev && head_ != chunk)
+  {
+    // Not in the list.
+    return;
+  }
+
+  if (chunk->dirty_prev)
+  {
+    chunk->dirty_prev->dirty_next = chunk->dirty_next;
+  }
+  else
+  {
+    head_ = chunk->dirty_next;
+  }
+
+  if (chunk->dirty_next)
+  {
+    chunk->dirty_next->dirty_prev = chunk->dirty_prev;
+  }
+  else
+  {
+    tail_.store(chunk->dirty_prev, std::memory_order_release);
+  }
+
+  chunk->dirty_prev = chunk->dirty_next = nullptr;
+  chunk->dirty_order_stamp.store(0, std::memory_order_relaxed);
+}
+}  // namespace ohm
@@ -0,0 +1,71 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_DIRTYCHUNKLIST_H
+#define OHM_DIRTYCHUNKLIST_H
+
+#include "OhmConfig.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace ohm
+{
+struct MapChunk;
+
+/// Tracks the chunks of a map in the order they are marked dirty by @c MapChunk::markDirty() . This allows the regions
+/// changed since a stamp to be collected at a cost which scales with the number of changed regions rather than the
+/// number of regions in the map. See @c OccupancyMap::collectDirtyRegions() .
+///
+/// The list is intrusive, using the @c MapChunk::dirty_prev and @c MapChunk::dirty_next links. Marking a chunk moves
+/// it to the end of the list and sets its @c MapChunk::dirty_order_stamp to the larger of its @c MapChunk::dirty_stamp
+/// and the order stamp of the previous last chunk. The order stamps are thus non-decreasing along the list, even when
+/// concurrent updates mark chunks in a different order to the stamps they were given.
+///
+/// The list is thread safe. It may be used while holding the @c ChunkMap locks, but not the reverse. Touching the chunk
+/// which is already last in the list does not take the list lock unless its order stamp must be raised.
+class DirtyChunkList
+{
+public:
+  /// Constructor.
+  DirtyChunkList() = default;
+
+  DirtyChunkList(const DirtyChunkList &) = delete;
+  DirtyChunkList &operator=(const DirtyChunkList &) = delete;
+
+  /// Move @p chunk to the end of the list as the most recently modified chunk. Called from @c MapChunk::markDirty()
+  /// after updating the @c MapChunk::dirty_stamp .
+  /// @param chunk The modified chunk.
+  void touch(MapChunk *chunk);
+
+  /// Remove @p chunk from the list. This must be called before a chunk leaves the map. Chunks which are not in the list
+  /// are ignored.
+  /// @param chunk The chunk to remove.
+  void remove(const MapChunk *chunk);
+
+  /// Add the regions with a @c MapChunk::dirty_stamp greater than @p from_stamp to @p regions , along with their
+  /// dirty stamps. The regions are added in reverse modification order.
+  /// @param from_stamp The map stamp value from which to fetch regions.
+  /// @param regions The list to add to.
+  void collect(uint64_t from_stamp, std::vector<std::pair<uint64_t, glm::i16vec3>> &regions) const;
+
+private:
+  /// Unlink @p chunk from the list. Requires the @c mutex_ .
+  void unlink(MapChunk *chunk);
+
+  mutable std::mutex mutex_;
+  MapChunk *head_ = nullptr;
+  /// Last chunk in the list. Atomic to support the lock free early out in @c touch() ; only modified under the
+  /// @c mutex_ .
+  std::atomic<MapChunk *> tail_{ nullptr };
+};
+}  // namespace ohm
+
+#endif  // OHM_DIRTYCHUNKLIST_H
@@ -5,6 +5,8 @@
 // Author: Kazys Stepanas
 #include "OccupancyMapDetail.h"
 
+#include "RegionPager.h"
+
 #include "DefaultLayer.h"
 #include "MapLayer.h"
 #include "MapLayout.h"
@@ -16,34 +16,26 @@
 #include "ohm/Mutex.h"
 #include "ohm/RayFilter.h"
 
-#include <ohmutil/VectorHash.h>
+#include "ChunkMap.h"
+#include "ChunkPool.h"
+#include "DirtyChunkList.h"
 
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wconversion"
-#endif  // __GNUC__
-#include <ska/bytell_hash_map.hpp>
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif  // __GNUC__
+#include <ohmutil/VectorHash.h>
 
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
 
 namespace ohm
 {
-using ChunkMap = ska::bytell_hash_map<glm::i16vec3, MapChunk *, Vector3Hash<glm::i16vec3>>;
-
 class MapRegionCache;
 class OccupancyMap;
+class RegionPager;
 
 /// Internal details associated with an @c OccupancyMap .
 struct ohm_API OccupancyMapDetail
 {
-  /// Mutex type to use to protect map access.
-  using Mutex = ohm::Mutex;
-
   /// A global origin offset for data in the map. All data read from the map has this origin added.
   glm::dvec3 origin = glm::dvec3(0);
   /// The spatial dimensions of each region. Calculated as `region_voxel_dimensions * resolution`.
@@ -82,10 +74,17 @@ struct ohm_API OccupancyMapDetail
   MapFlag flags = MapFlag::kNone;
   /// The voxel memory layout information for the map.
   MapLayout layout;
-  /// The hash map of @c MapChunk objects contained in this map.
+  /// The chunks in modification order, used to collect the dirty regions. Mutable as chunks are marked through their
+  /// const map pointer. Declared before the chunks and pool so it outlives them.
+  mutable DirtyChunkList dirty_chunks;
+  /// The hash map of @c MapChunk objects contained in this map. This supports concurrent region lookup and creation,
+  /// while iteration requires locking the @c ChunkMap as a whole - see @c ChunkMap .
   ChunkMap chunks;
-  /// Data access mutex. Used to protect @c chunks .
-  mutable Mutex mutex;
+  /// Released chunks available for recycling into new regions. See @c OccupancyMap::setChunkPoolSize() .
+  ChunkPool chunk_pool;
+  /// The map stamp at which each region coordinate was last removed, used to journal removals. Guarded by the
+  /// @c chunks lock. See @c OccupancyMap::collectRemovedRegions() .
+  std::unordered_map<glm::i16vec3, uint64_t, Vector3Hash<glm::i16vec3>> removed_regions;
   // Region count at load time. Useful when only the header is loaded.
   size_t loaded_region_count = 0;
 
@@ -98,6 +97,9 @@ struct ohm_API OccupancyMapDetail
   /// Optional function to be called for each input ray before processing. See @c RayFilterFunction documentation.
   RayFilterFunction ray_filter;
 
+  /// Pages regions in from a map file on demand. Only set for maps opened with @c ohm::loadPaged() .
+  std::unique_ptr<RegionPager> pager;
+
   /// Meta information storage about the map.
   /// The data stored are arbitrary key/value pairs. Generally it is expected that this may hold data about how
   /// the map was generated or has been modified.
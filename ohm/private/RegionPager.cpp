@@ -0,0 +1,332 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "RegionPager.h"
+
+#include "MapChunk.h"
+#include "MapRegionCache.h"
+#include "VoxelBlock.h"
+#include "VoxelCodec.h"
+
+#include "OccupancyMapDetail.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define OHM_REGION_PAGER_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // defined(__unix__) || defined(__APPLE__)
+
+namespace ohm
+{
+struct RegionPager::FileFallback
+{
+  std::mutex mutex;
+  std::ifstream in;
+};
+
+
+RegionPager::RegionPager(OccupancyMapDetail &detail)
+  : detail_(detail)
+{}
+
+
+RegionPager::~RegionPager()
+{
+#ifdef OHM_REGION_PAGER_MMAP
+  if (mapped_)
+  {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    munmap(const_cast<uint8_t *>(mapped_), mapped_size_);
+  }
+#endif  // OHM_REGION_PAGER_MMAP
+}
+
+
+bool RegionPager::open(const std::string &filename, const std::vector<v0_6::RegionTableEntry> &table,
+                       std::shared_ptr<const VoxelCodec> codec, size_t resident_budget)
+{
+  codec_ = std::move(codec);
+  resident_budget_ = resident_budget;
+  table_.clear();
+  table_.reserve(table.size());
+  for (const auto &entry : table)
+  {
+    table_.insert(std::make_pair(entry.coord, entry));
+  }
+
+#ifdef OHM_REGION_PAGER_MMAP
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd >= 0)
+  {
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+      void *mem = mmap(nullptr, size_t(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mem != MAP_FAILED)  // NOLINT(cppcoreguidelines-pro-type-cstyle-cast)
+      {
+        // Access is driven by spatial queries, not file order.
+        madvise(mem, size_t(file_stat.st_size), MADV_RANDOM);
+        mapped_ = static_cast<const uint8_t *>(mem);
+        mapped_size_ = size_t(file_stat.st_size);
+      }
+    }
+    // The mapping remains valid after closing the file.
+    ::close(fd);
+  }
+
+  if (mapped_)
+  {
+    return true;
+  }
+#endif  // OHM_REGION_PAGER_MMAP
+
+  // Fallback to reading the file.
+  file_ = std::make_unique<FileFallback>();
+  file_->in.open(filename.c_str(), std::ios_base::binary);
+  return file_->in.is_open();
+}
+
+
+bool RegionPager::contains(const glm::i16vec3 &region) const
+{
+  return table_.find(region) != table_.end();
+}
+
+
+void RegionPager::regionKeys(std::vector<glm::i16vec3> &regions) const
+{
+  regions.reserve(regions.size() + table_.size());
+  for (const auto &entry : table_)
+  {
+    regions.emplace_back(entry.first);
+  }
+}
+
+
+MapChunk *RegionPager::pageIn(const glm::i16vec3 &region, bool pin)
+{
+  const auto table_iter = table_.find(region);
+  if (table_iter == table_.end())
+  {
+    return nullptr;
+  }
+
+  MapChunk *chunk = detail_.chunks.lookup(region, pin);
+  if (chunk)
+  {
+    touch(region);
+    return chunk;
+  }
+
+  // Load outside of the map lock. Another thread may load the same region concurrently, in which case the first to
+  // insert wins.
+  MapChunk *loaded_chunk = loadChunk(table_iter->second);
+  if (!loaded_chunk)
+  {
+    return nullptr;
+  }
+
+  bool created = false;
+  chunk = detail_.chunks.lookupOrCreate(
+    region, [loaded_chunk]() { return loaded_chunk; }, &created, pin);
+
+  if (created)
+  {
+    {
+      std::unique_lock<std::mutex> guard(mutex_);
+      lru_.push_front(Resident{ region, chunk, chunk->dirty_stamp });
+      resident_[region] = lru_.begin();
+    }
+    evict();
+  }
+  else
+  {
+    detail_.chunk_pool.release(loaded_chunk);
+    touch(region);
+  }
+
+  return chunk;
+}
+
+
+void RegionPager::touch(const glm::i16vec3 &region)
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+  const auto iter = resident_.find(region);
+  if (iter != resident_.end() && iter->second != lru_.begin())
+  {
+    lru_.splice(lru_.begin(), lru_, iter->second);
+  }
+}
+
+
+void RegionPager::track(const glm::i16vec3 &region)
+{
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    modified_.insert(region);
+  }
+  evict();
+}
+
+
+size_t RegionPager::residentCount()
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+  return lru_.size() + modified_.size();
+}
+
+
+void RegionPager::forget(const glm::i16vec3 &region)
+{
+  std::unique_lock<std::mutex> guard(mutex_);
+  const auto iter = resident_.find(region);
+  if (iter != resident_.end())
+  {
+    lru_.erase(iter->second);
+    resident_.erase(iter);
+  }
+  modified_.erase(region);
+}
+
+
+MapChunk *RegionPager::loadChunk(const v0_6::RegionTableEntry &entry)
+{
+  thread_local std::vector<uint8_t> compressed;
+  thread_local std::vector<uint8_t> uncompressed;
+
+  const uint8_t *src = readRegion(entry, compressed);
+  if (!src)
+  {
+    return nullptr;
+  }
+
+  uncompressed.resize(entry.uncompressed_size);
+  if (!codec_->decompress(src, entry.compressed_size, uncompressed.data(), uncompressed.size()))
+  {
+    return nullptr;
+  }
+
+  MapChunk *chunk = detail_.chunk_pool.acquire(MapRegion(), detail_);
+  if (v0_6::loadChunk(uncompressed.data(), uncompressed.size(), *chunk, detail_) != 0 ||
+      chunk->region.coord != entry.coord)
+  {
+    detail_.chunk_pool.release(chunk);
+    return nullptr;
+  }
+
+  chunk->searchAndUpdateFirstValid(detail_.region_voxel_dimensions);
+  return chunk;
+}
+
+
+void RegionPager::evict()
+{
+  if (resident_budget_ == 0)
+  {
+    return;
+  }
+
+  // Select candidate regions while holding the pager lock. The lock order prevents locking the map shards here, so a
+  // candidate may be pinned or retained before it is removed.
+  std::vector<glm::i16vec3> candidates;
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    auto iter = lru_.end();
+    while (lru_.size() + modified_.size() > resident_budget_ + candidates.size() && iter != lru_.begin())
+    {
+      --iter;
+      if (iter->chunk->dirty_stamp != iter->loaded_stamp)
+      {
+        // Modified. Keep the region in memory, but still account for it against the budget.
+        modified_.insert(iter->coord);
+        resident_.erase(iter->coord);
+        iter = lru_.erase(iter);
+        continue;
+      }
+
+      if (evictable(*iter))
+      {
+        candidates.emplace_back(iter->coord);
+      }
+    }
+  }
+
+  for (const glm::i16vec3 &coord : candidates)
+  {
+    // Re-check the candidate under the shard lock, which blocks pinned lookups of the region, then remove the region
+    // from the map and the LRU together. Locking the pager mutex while holding the shard lock matches the lock order.
+    MapChunk *chunk = detail_.chunks.removeIf(coord, [this, &coord](const MapChunk &chunk) {
+      std::unique_lock<std::mutex> guard(mutex_);
+      const auto iter = resident_.find(coord);
+      if (iter == resident_.end() || iter->second->chunk != &chunk || !evictable(*iter->second))
+      {
+        return false;
+      }
+      lru_.erase(iter->second);
+      resident_.erase(iter);
+      return true;
+    });
+
+    if (chunk)
+    {
+      if (detail_.gpu_cache)
+      {
+        detail_.gpu_cache->remove(coord);
+      }
+      detail_.chunk_pool.release(chunk);
+    }
+  }
+}
+
+
+bool RegionPager::evictable(const Resident &resident)
+{
+  const MapChunk *chunk = resident.chunk;
+  if (chunk->pin_count > 0 || chunk->dirty_stamp != resident.loaded_stamp)
+  {
+    return false;
+  }
+
+  for (unsigned i = 0; i < chunk->layout().layerCount(); ++i)
+  {
+    if (chunk->voxel_blocks[i] && chunk->voxel_blocks[i]->referenceCount() > 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+const uint8_t *RegionPager::readRegion(const v0_6::RegionTableEntry &entry, std::vector<uint8_t> &buffer)
+{
+  if (mapped_)
+  {
+    if (entry.offset + entry.compressed_size > mapped_size_)
+    {
+      return nullptr;
+    }
+    return mapped_ + entry.offset;
+  }
+
+  if (!file_)
+  {
+    return nullptr;
+  }
+
+  buffer.resize(entry.compressed_size);
+  std::unique_lock<std::mutex> guard(file_->mutex);
+  file_->in.clear();
+  file_->in.seekg(std::streamoff(entry.offset), std::ios_base::beg);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  file_->in.read(reinterpret_cast<char *>(buffer.data()), std::streamsize(buffer.size()));
+  return (size_t(file_->in.gcount()) == buffer.size()) ? buffer.data() : nullptr;
+}
+}  // namespace ohm
@@ -0,0 +1,156 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_REGIONPAGER_H
+#define OHM_REGIONPAGER_H
+
+#include "OhmConfig.h"
+
+#include "serialise/MapSerialiseV0.6.h"
+
+#include <ohmutil/VectorHash.h>
+
+#include <glm/vec3.hpp>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ohm
+{
+struct MapChunk;
+struct OccupancyMapDetail;
+class VoxelCodec;
+
+/// Supports paging @c MapChunk regions into an @c OccupancyMap on demand from a map file. See @c ohm::loadPaged() .
+///
+/// The pager memory maps a version 0.6 (or later) map file and uses the region table to locate regions. Regions are
+/// paged in by @c OccupancyMap::region() when not already resident. The pager tracks the paged regions in least
+/// recently used order and evicts regions when more than the resident budget are loaded. Only clean regions are
+/// evicted: regions which have been modified since being paged in are retained in memory for the lifetime of the map,
+/// as are regions created in memory. This gives copy on write semantics; the map file is never modified. Modified and
+/// created regions still count against the resident budget, so clean regions are evicted more aggressively as the
+/// number of modified regions grows. Once the modified regions alone exceed the budget, only the regions in use remain
+/// paged in. Modified regions may be released by writing them to a journal (see @c ohm::appendJournal() ) and
+/// reloading.
+///
+/// A region is only evicted when it is not pinned (see @c MapChunk::pin() ) and none of its voxel layers are retained
+/// (see @c VoxelBlock::retain() ). These conditions are checked while the region's @c ChunkMap shard is exclusively
+/// locked, and the region is removed under the same lock, so a concurrent pinned lookup either pins the chunk first
+/// or does not find it. @c MapChunk pointers obtained from the map without a pin or retained voxel layer, such as from
+/// @c OccupancyMap::region() , may be invalidated by later page faults. The resident budget should exceed the number
+/// of regions in concurrent use.
+///
+/// Locking order: the pager mutex may be locked while holding the @c ChunkMap locks, but not the reverse.
+class RegionPager
+{
+public:
+  /// Create a pager for @p detail .
+  /// @param detail The map to page regions into.
+  RegionPager(OccupancyMapDetail &detail);
+  /// Destructor - unmaps the file.
+  ~RegionPager();
+
+  /// Open the map file to page from.
+  /// @param filename The map file.
+  /// @param table The region table read from the file.
+  /// @param codec The codec used to compress regions in the file.
+  /// @param resident_budget The maximum number of paged regions to keep resident. Zero for no limit.
+  /// @return True on success.
+  bool open(const std::string &filename, const std::vector<v0_6::RegionTableEntry> &table,
+            std::shared_ptr<const VoxelCodec> codec, size_t resident_budget);
+
+  /// Query the resident region budget.
+  /// @return The maximum number of paged regions to keep resident, zero for no limit.
+  inline size_t residentBudget() const { return resident_budget_; }
+
+  /// Query the number of regions in the map file.
+  /// @return The number of pageable regions.
+  inline size_t regionCount() const { return table_.size(); }
+
+  /// Query whether @p region is in the map file.
+  /// @param region The region coordinate.
+  /// @return True if the region can be paged in.
+  bool contains(const glm::i16vec3 &region) const;
+
+  /// Collect the coordinates of all regions in the map file.
+  /// @param[out] regions Populated with the region coordinates. Not cleared first.
+  void regionKeys(std::vector<glm::i16vec3> &regions) const;
+
+  /// Page in @p region if it is in the map file and not already resident. May evict other regions.
+  /// @param region The region to page in.
+  /// @param pin True to @c MapChunk::pin() the returned chunk.
+  /// @return The resident chunk, or null if @p region is not in the file or fails to load.
+  MapChunk *pageIn(const glm::i16vec3 &region, bool pin = false);
+
+  /// Mark @p region as recently used.
+  /// @param region The region coordinate.
+  void touch(const glm::i16vec3 &region);
+
+  /// Account for a @p region created in memory rather than paged in. The region is never evicted, but counts against
+  /// the resident budget. May evict other regions.
+  /// @param region The region coordinate.
+  void track(const glm::i16vec3 &region);
+
+  /// Query the number of resident regions counted against the budget, including modified and created regions.
+  /// @return The number of accounted regions.
+  size_t residentCount();
+
+  /// Notify the pager that @p region has been removed from the map.
+  /// @param region The region coordinate.
+  void forget(const glm::i16vec3 &region);
+
+private:
+  struct Resident
+  {
+    glm::i16vec3 coord;
+    MapChunk *chunk;
+    uint64_t loaded_stamp;
+  };
+
+  using ResidentList = std::list<Resident>;
+  using Vector3HashI16 = Vector3Hash<glm::i16vec3>;
+
+  /// Decompress and create the chunk for @p entry .
+  MapChunk *loadChunk(const v0_6::RegionTableEntry &entry);
+
+  /// Evict least recently used, clean, unreferenced regions until within budget.
+  void evict();
+
+  /// Check if the @p resident region may be evicted. Requires the pager mutex.
+  /// @param resident The resident region details.
+  /// @return True if the region is unmodified, unpinned and has no retained voxel layers.
+  static bool evictable(const Resident &resident);
+
+  /// Read the compressed data for @p entry . Returns a pointer into the memory mapped file, or into @p buffer when
+  /// memory mapping is not available.
+  const uint8_t *readRegion(const v0_6::RegionTableEntry &entry, std::vector<uint8_t> &buffer);
+
+  OccupancyMapDetail &detail_;
+  std::unordered_map<glm::i16vec3, v0_6::RegionTableEntry, Vector3HashI16> table_;
+  std::shared_ptr<const VoxelCodec> codec_;
+  size_t resident_budget_ = 0;
+
+  /// Memory mapped file content.
+  const uint8_t *mapped_ = nullptr;
+  size_t mapped_size_ = 0;
+  /// File handle used when memory mapping is not available.
+  struct FileFallback;
+  std::unique_ptr<FileFallback> file_;
+
+  std::mutex mutex_;
+  /// Resident, unmodified regions, most recently used first.
+  ResidentList lru_;
+  std::unordered_map<glm::i16vec3, ResidentList::iterator, Vector3HashI16> resident_;
+  /// Resident regions which have been modified or created in memory. These are never evicted.
+  std::unordered_set<glm::i16vec3, Vector3HashI16> modified_;
+};
+}  // namespace ohm
+
+#endif  // OHM_REGIONPAGER_H
@@ -0,0 +1,283 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "RegionRayBatch.h"
+
+#include "LineWalk.h"
+#include "MapChunk.h"
+#include "OccupancyMap.h"
+#include "RayFlag.h"
+
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif  // OHM_THREADS
+
+#include <algorithm>
+
+namespace ohm
+{
+void RegionRayBatch::Block::clear()
+{
+  for (unsigned i = 0; i < bucket_count; ++i)
+  {
+    buckets[i].visits.clear();
+  }
+  bucket_count = 0;
+  bucket_map.clear();
+}
+
+
+std::vector<RegionRayBatch::Visit> &RegionRayBatch::Block::bucket(const glm::i16vec3 &region)
+{
+  const auto iter = bucket_map.find(region);
+  if (iter != bucket_map.end())
+  {
+    return buckets[iter->second].visits;
+  }
+
+  if (bucket_count == buckets.size())
+  {
+    buckets.emplace_back();
+  }
+
+  Bucket &bucket = buckets[bucket_count];
+  bucket.region = region;
+  bucket_map.insert(std::make_pair(region, bucket_count));
+  ++bucket_count;
+  return bucket.visits;
+}
+
+
+RegionRayBatch::RegionRayBatch(OccupancyMap &map, unsigned thread_count)
+  : map_(map)
+  , ray_filter_(map.rayFilter())
+  , thread_count_(thread_count)
+{}
+
+
+RegionRayBatch::~RegionRayBatch() = default;
+
+
+void RegionRayBatch::integrate(const glm::dvec3 *rays, size_t element_count, unsigned ray_update_flags,
+                               const RegionFunction &region_func)
+{
+  const size_t ray_count = element_count / 2;
+  // Serial integration uses single block batches. This keeps the recorded visits small enough to stay in cache and
+  // leaves a single bucket for each region, so the region updates need not collate visits from multiple blocks.
+  const size_t batch_size = size_t(kBlockRayCount) * ((thread_count_ != 1) ? kBatchBlockCount : 1u);
+  last_exit_range_ = 0;
+
+  const auto integrate_all = [&]() {
+    for (size_t first_ray = 0; first_ray < ray_count; first_ray += batch_size)
+    {
+      integrateBatch(rays, first_ray, std::min(batch_size, ray_count - first_ray), ray_update_flags, region_func);
+    }
+  };
+
+#ifdef OHM_THREADS
+  if (thread_count_ != 1)
+  {
+    tbb::task_arena arena(thread_count_ ? int(thread_count_) : int(tbb::task_arena::automatic));
+    arena.execute(integrate_all);
+    return;
+  }
+#endif  // OHM_THREADS
+  integrate_all();
+}
+
+
+void RegionRayBatch::integrateBatch(const glm::dvec3 *rays, size_t first_ray, size_t ray_count,
+                                    unsigned ray_update_flags, const RegionFunction &region_func)
+{
+  const auto block_count = unsigned((ray_count + kBlockRayCount - 1) / kBlockRayCount);
+  rays_.resize(ray_count);
+  if (blocks_.size() < block_count)
+  {
+    blocks_.resize(block_count);
+  }
+
+  // Walk the rays in blocks.
+#ifdef OHM_THREADS
+  if (thread_count_ != 1)
+  {
+    tbb::parallel_for(tbb::blocked_range<unsigned>(0u, block_count, 1u),
+                      [&](const tbb::blocked_range<unsigned> &range) {
+                        for (unsigned b = range.begin(); b != range.end(); ++b)
+                        {
+                          walkBlock(b, rays, first_ray, ray_count, ray_update_flags);
+                        }
+                      });
+  }
+  else
+#endif  // OHM_THREADS
+  {
+    for (unsigned b = 0; b < block_count; ++b)
+    {
+      walkBlock(b, rays, first_ray, ray_count, ray_update_flags);
+    }
+  }
+
+  // Resolve the last exit range for rays which made no miss visits. This is carried from the previous ray.
+  for (Ray &ray : rays_)
+  {
+    if (ray.walked)
+    {
+      last_exit_range_ = ray.last_exit_range;
+    }
+    else
+    {
+      ray.last_exit_range = last_exit_range_;
+    }
+  }
+
+  // Collate the regions across the blocks, preserving block order.
+  regions_.clear();
+  ska::bytell_hash_map<glm::i16vec3, unsigned, Vector3Hash<glm::i16vec3>> region_map;
+  for (unsigned b = 0; b < block_count; ++b)
+  {
+    const Block &block = blocks_[b];
+    for (unsigned i = 0; i < block.bucket_count; ++i)
+    {
+      const glm::i16vec3 &coord = block.buckets[i].region;
+      auto iter = region_map.find(coord);
+      if (iter == region_map.end())
+      {
+        iter = region_map.insert(std::make_pair(coord, unsigned(regions_.size()))).first;
+        regions_.emplace_back();
+        regions_.back().coord = coord;
+      }
+      regions_[iter->second].buckets.emplace_back(b, i);
+    }
+  }
+
+  // Create the regions. This requires locking the map so we do so serially before the update.
+  for (Region &region : regions_)
+  {
+    region.chunk = map_.region(region.coord, true);
+  }
+
+  // Update regions.
+#ifdef OHM_THREADS
+  if (thread_count_ != 1)
+  {
+    tbb::enumerable_thread_specific<std::vector<Visit>> scratch_buffers;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0u, regions_.size(), 1u),
+                      [&](const tbb::blocked_range<size_t> &range) {
+                        std::vector<Visit> &scratch = scratch_buffers.local();
+                        for (size_t r = range.begin(); r != range.end(); ++r)
+                        {
+                          updateRegion(regions_[r], scratch, region_func);
+                        }
+                      });
+  }
+  else
+#endif  // OHM_THREADS
+  {
+    for (Region &region : regions_)
+    {
+      updateRegion(region, scratch_, region_func);
+    }
+  }
+
+  for (unsigned b = 0; b < block_count; ++b)
+  {
+    blocks_[b].clear();
+  }
+}
+
+
+void RegionRayBatch::walkBlock(unsigned block_index, const glm::dvec3 *rays, size_t first_ray, size_t ray_count,
+                               unsigned ray_update_flags)
+{
+  Block &block = blocks_[block_index];
+  const size_t block_start = size_t(block_index) * kBlockRayCount;
+  const size_t block_end = std::min(block_start + kBlockRayCount, ray_count);
+  const bool use_filter = bool(ray_filter_);
+
+  glm::i16vec3 last_region{};
+  std::vector<Visit> *visits = nullptr;
+  unsigned ray_index = 0;
+  Ray *ray = nullptr;
+
+  const auto add_visit = [&](const Key &key, bool sample, float traversal) {
+    if (!visits || key.regionKey() != last_region)
+    {
+      last_region = key.regionKey();
+      visits = &block.bucket(last_region);
+    }
+    visits->emplace_back(Visit{ key, sample, traversal, ray_index });
+  };
+
+  const auto visit_func = [&](const Key &key, double enter_range, double exit_range) -> bool  //
+  {
+    add_visit(key, false, float(exit_range - enter_range));
+    ray->last_exit_range = exit_range;
+    ray->walked = true;
+    return true;
+  };
+
+  const LineWalkContext walk_context(map_, visit_func);
+
+  for (size_t i = block_start; i < block_end; ++i)
+  {
+    unsigned filter_flags = 0;
+    ray_index = unsigned(i);
+    ray = &rays_[i];
+    ray->start = rays[(first_ray + i) * 2];
+    ray->sample = rays[(first_ray + i) * 2 + 1];
+    ray->index = first_ray + i;
+    ray->last_exit_range = 0;
+    ray->walked = false;
+
+    if (use_filter)
+    {
+      if (!ray_filter_(&ray->start, &ray->sample, &filter_flags))
+      {
+        // Bad ray.
+        continue;
+      }
+    }
+
+    // Explicit update of the end voxel if it's a sample, include in ray if clipped.
+    const bool include_sample_in_ray = (filter_flags & kRffClippedEnd) || (ray_update_flags & kRfEndPointAsFree);
+    unsigned walk_flags = (!include_sample_in_ray) ? kExcludeEndVoxel : 0u;
+    // Skip the start voxel according to ray_update_flags.
+    walk_flags |= (ray_update_flags & kRfExcludeOrigin) ? kExcludeStartVoxel : 0u;
+
+    if (!(ray_update_flags & kRfExcludeRay))
+    {
+      walkSegmentKeys(walk_context, ray->start, ray->sample, walk_flags);
+    }
+
+    if (!include_sample_in_ray && !(ray_update_flags & kRfExcludeSample))
+    {
+      add_visit(map_.voxelKey(ray->sample), true, 0.0f);
+    }
+  }
+}
+
+
+void RegionRayBatch::updateRegion(Region &region, std::vector<Visit> &scratch, const RegionFunction &region_func)
+{
+  if (region.buckets.size() == 1)
+  {
+    // Single block touches this region. No need to collate.
+    const auto &visits = blocks_[region.buckets.front().first].buckets[region.buckets.front().second].visits;
+    region_func(region.chunk, visits.data(), visits.size());
+    return;
+  }
+
+  scratch.clear();
+  for (const auto &block_bucket : region.buckets)
+  {
+    const auto &visits = blocks_[block_bucket.first].buckets[block_bucket.second].visits;
+    scratch.insert(scratch.end(), visits.begin(), visits.end());
+  }
+  region_func(region.chunk, scratch.data(), scratch.size());
+}
+}  // namespace ohm
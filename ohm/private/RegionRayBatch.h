@@ -0,0 +1,176 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHM_REGIONRAYBATCH_H
+#define OHM_REGIONRAYBATCH_H
+
+#include "OhmConfig.h"
+
+#include "Key.h"
+#include "RayFilter.h"
+
+#include <ohmutil/VectorHash.h>
+
+#include <glm/vec3.hpp>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif  // __GNUC__
+#include <ska/bytell_hash_map.hpp>
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif  // __GNUC__
+
+#include <functional>
+#include <vector>
+
+namespace ohm
+{
+struct MapChunk;
+class OccupancyMap;
+
+/// A utility class for batched, optionally multi-threaded ray integration in CPU.
+///
+/// The @c RegionRayBatch walks a set of rays, deferring the voxel updates by recording a @c Visit for each voxel
+/// touched. The visits are bucketed by region (@c MapChunk ) and each region is then handed to a @c RegionFunction
+/// which applies all the visits in that region. This resolves each region once per batch rather than each time a ray
+/// crosses into the region. Regions are processed in parallel unless the thread count is 1, but each region is only
+/// ever updated by one thread, so no voxel level synchronisation is required.
+///
+/// Within each region, visits are presented in the same order as a serial walk of the rays would visit them. That is,
+/// each ray's sample visit follows its own miss visits, and earlier rays are visited before later rays. This ensures
+/// a region update can exactly replicate the results of a serial integration.
+///
+/// Rays are processed in fixed size batches in order to bound the memory used to record the visits. Serial integration
+/// uses batches of a single block so that the visits stay in cache.
+///
+/// The @p ray_update_flags affect how the rays are walked as follows:
+/// - @c kRfEndPointAsFree : the sample voxel is walked as part of the ray with no sample visit.
+/// - @c kRfExcludeRay : no miss visits are recorded.
+/// - @c kRfExcludeSample : no sample visits are recorded.
+/// - @c kRfExcludeOrigin : the voxel containing the ray origin is not visited.
+/// - @c kRfStopOnFirstOccupied : not supported as this requires the voxel state along the ray. The caller must fall
+///   back to a serial code path.
+///
+/// The map's @c OccupancyMap::rayFilter() is applied and may result in clipped rays. The filter function is invoked
+/// from multiple threads.
+class RegionRayBatch
+{
+public:
+  /// Details of a ray in the current batch, after filtering.
+  struct Ray
+  {
+    /// Ray start point (after filtering).
+    glm::dvec3 start;
+    /// Ray end point (after filtering).
+    glm::dvec3 sample;
+    /// The exit range of the last voxel visited as a miss - either by this ray or, where this ray makes no miss
+    /// visits, by a previous ray. Used to calculate the traversal for the sample voxel.
+    double last_exit_range;
+    /// Index of the ray in the original ray set. Used to index per ray data such as intensities and timestamps.
+    size_t index;
+    /// True if the ray made any miss visits.
+    bool walked;
+  };
+
+  /// Records a voxel visit by a ray.
+  struct Visit
+  {
+    /// The voxel visited.
+    Key key;
+    /// True if this is a sample visit (ray end point), false for a miss visit.
+    bool sample;
+    /// For miss visits, the distance travelled through the voxel, matching the serial traversal accumulation.
+    float traversal;
+    /// Index of the ray making the visit. Use with @c ray() .
+    unsigned ray;
+  };
+
+  /// Function called to apply all the visits to a single region. The visits are given in serial visiting order.
+  ///
+  /// @param chunk The region to update.
+  /// @param visits The visit array.
+  /// @param visit_count Number of elements in @p visits .
+  using RegionFunction = std::function<void(MapChunk *chunk, const Visit *visits, size_t visit_count)>;
+
+  /// Number of rays processed by a single thread during the walk stage.
+  static constexpr unsigned kBlockRayCount = 256u;
+  /// Number of blocks processed in a multi-threaded batch.
+  static constexpr unsigned kBatchBlockCount = 64u;
+
+  /// Constructor.
+  /// @param map The target map.
+  /// @param thread_count Number of threads to use. Zero for automatic, 1 to process the batch in the calling thread.
+  explicit RegionRayBatch(OccupancyMap &map, unsigned thread_count = 0);
+
+  /// Destructor.
+  ~RegionRayBatch();
+
+  /// Walk the @p rays and apply the region updates for each batch using @p region_func .
+  ///
+  /// @param rays The array of start/end point pairs to integrate.
+  /// @param element_count The number of @c glm::dvec3 elements in @p rays , which is twice the ray count.
+  /// @param ray_update_flags @c RayFlag values controlling the walk.
+  /// @param region_func The function used to apply visits to each region.
+  void integrate(const glm::dvec3 *rays, size_t element_count, unsigned ray_update_flags,
+                 const RegionFunction &region_func);
+
+  /// Access a ray in the current batch.
+  /// @param ray_index The batch index of the ray, as given by @c Visit::ray .
+  /// @return The ray details.
+  inline const Ray &ray(unsigned ray_index) const { return rays_[ray_index]; }
+
+private:
+  /// The visits for a single region within a block.
+  struct Bucket
+  {
+    glm::i16vec3 region;
+    std::vector<Visit> visits;
+  };
+
+  /// The set of visits made by rays in a single block.
+  struct Block
+  {
+    /// Visit buckets. Only the first @c bucket_count are in use. Others are retained to avoid reallocation.
+    std::vector<Bucket> buckets;
+    /// Maps region coordinates to @c buckets index.
+    ska::bytell_hash_map<glm::i16vec3, unsigned, Vector3Hash<glm::i16vec3>> bucket_map;
+    /// Number of @c buckets in use.
+    unsigned bucket_count = 0;
+
+    void clear();
+    std::vector<Visit> &bucket(const glm::i16vec3 &region);
+  };
+
+  /// Identifies the visits for a region across all blocks in a batch.
+  struct Region
+  {
+    glm::i16vec3 coord;
+    MapChunk *chunk = nullptr;
+    /// Pairs of block and bucket indices containing visits for this region, in block order.
+    std::vector<std::pair<unsigned, unsigned>> buckets;
+  };
+
+  void integrateBatch(const glm::dvec3 *rays, size_t first_ray, size_t ray_count, unsigned ray_update_flags,
+                      const RegionFunction &region_func);
+  void walkBlock(unsigned block_index, const glm::dvec3 *rays, size_t first_ray, size_t ray_count,
+                 unsigned ray_update_flags);
+  void updateRegion(Region &region, std::vector<Visit> &scratch, const RegionFunction &region_func);
+
+  OccupancyMap &map_;
+  RayFilterFunction ray_filter_;
+  unsigned thread_count_ = 0;
+  std::vector<Ray> rays_;
+  std::vector<Block> blocks_;
+  std::vector<Region> regions_;
+  /// Visit collation buffer for single threaded updates.
+  std::vector<Visit> scratch_;
+  /// Carries the last exit range from one batch to the next.
+  double last_exit_range_ = 0;
+};
+}  // namespace ohm
+
+#endif  // OHM_REGIONRAYBATCH_H
@@ -10,6 +10,10 @@
 
 #include "ohm/Stream.h"
 
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
 namespace ohm
 {
 /// Explicitly typed stream writing, uncompressed.
@@ -56,6 +60,34 @@ inline bool read(InputStream &stream, S &val)
   val = static_cast<S>(val2);
   return true;
 }
+
+
+/// Explicitly typed buffer writing. Appends to @p buffer .
+template <typename T, typename S>
+inline bool write(std::vector<uint8_t> &buffer, const S &val)
+{
+  const T val2 = static_cast<T>(val);
+  const size_t offset = buffer.size();
+  buffer.resize(offset + sizeof(val2));
+  memcpy(buffer.data() + offset, &val2, sizeof(val2));
+  return true;
+}
+
+
+/// Explicitly typed buffer reading. Reads from @p buffer at @p pos , advancing @p pos on success.
+template <typename T, typename S>
+inline bool read(const uint8_t *buffer, size_t buffer_size, size_t &pos, S &val)
+{
+  T val2{ 0 };
+  if (pos + sizeof(val2) > buffer_size)
+  {
+    return false;
+  }
+  memcpy(&val2, buffer + pos, sizeof(val2));
+  pos += sizeof(val2);
+  val = static_cast<S>(val2);
+  return true;
+}
 }  // namespace ohm
 
 #endif  // SERIALISEUTIL_H
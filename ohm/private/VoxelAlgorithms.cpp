@@ -5,9 +5,10 @@
 // Author: Kazys Stepanas
 #include "VoxelAlgorithms.h"
 
+#include "ChunkOccupancySummary.h"
 #include "Key.h"
+#include "MapChunk.h"
 #include "OccupancyMap.h"
-#include "VoxelData.h"
 
 #include <limits>
 
@@ -25,7 +26,6 @@ float calculateNearestNeighbour(const Key &voxel_key, const OccupancyMap &map,
                                 bool report_unscaled_distance)
 {
   Key search_key;
-  Voxel<const float> test_voxel(&map, map.layout().occupancyLayer());
   glm::vec3 voxel_centre;
   glm::vec3 separation;
 
@@ -38,30 +38,77 @@ float calculateNearestNeighbour(const Key &voxel_key, const OccupancyMap &map,
 
   voxel_centre = map.voxelCentreLocal(voxel_key);
 
-  test_voxel.setKey(voxel_key);
+  // Test voxels using the chunk occupancy summaries, caching the summary for the last region. A null summary means the
+  // region is unknown.
+  const glm::ivec3 region_dim = map.regionVoxelDimensions();
+  const ChunkOccupancySummary *summary = nullptr;
+  glm::i16vec3 summary_region = voxel_key.regionKey();
+  bool have_summary_region = false;
+  const auto is_obstacle = [&](const Key &key) {
+    if (!have_summary_region || key.regionKey() != summary_region)
+    {
+      const MapChunk *chunk = map.region(key.regionKey());
+      summary = (chunk) ? chunk->occupancySummary() : nullptr;
+      summary_region = key.regionKey();
+      have_summary_region = true;
+    }
+
+    if (!summary)
+    {
+      return unobserved_as_occupied;
+    }
+
+    const unsigned voxel_index = voxelIndex(key, region_dim);
+    return summary->isOccupied(voxel_index) || unobserved_as_occupied && summary->isUnobserved(voxel_index);
+  };
+
   // First try early out if the target voxel is occupied.
-  if (!ignore_self &&
-      (test_voxel.isValid() && isOccupied(test_voxel) || unobserved_as_occupied && isUnobservedOrNull(test_voxel)))
+  if (!ignore_self && is_obstacle(voxel_key))
   {
     return 0.0f;
   }
 
+  // Early out if no region overlapping the search extents can contain an obstacle.
+  Key min_key = voxel_key;
+  Key max_key = voxel_key;
+  map.moveKey(min_key, -voxel_search_half_extents);
+  map.moveKey(max_key, voxel_search_half_extents);
+  bool have_candidates = false;
+  for (int rz = min_key.regionKey().z; rz <= max_key.regionKey().z && !have_candidates; ++rz)
+  {
+    for (int ry = min_key.regionKey().y; ry <= max_key.regionKey().y && !have_candidates; ++ry)
+    {
+      for (int rx = min_key.regionKey().x; rx <= max_key.regionKey().x && !have_candidates; ++rx)
+      {
+        const MapChunk *chunk = map.region(glm::i16vec3(rx, ry, rz));
+        const ChunkOccupancySummary *region_summary = (chunk) ? chunk->occupancySummary() : nullptr;
+        have_candidates = (region_summary) ? region_summary->totals().occupied > 0 ||
+                                               unobserved_as_occupied && region_summary->totals().unobserved > 0 :
+                                             unobserved_as_occupied;
+      }
+    }
+  }
+
+  if (!have_candidates)
+  {
+    return -1.0f;
+  }
+
   for (int z = -voxel_search_half_extents.z; z <= voxel_search_half_extents.z; ++z)
   {
     for (int y = -voxel_search_half_extents.y; y <= voxel_search_half_extents.y; ++y)
     {
       for (int x = -voxel_search_half_extents.x; x <= voxel_search_half_extents.x; ++x)
       {
-        search_key = voxel_key;
-        map.moveKey(search_key, x, y, z);
-        test_voxel.setKey(search_key);
-
         if (ignore_self && x == 0 && y == 0 && z == 0)
         {
           continue;
         }
 
-        if (test_voxel.isValid() && isOccupied(test_voxel) || unobserved_as_occupied && isUnobservedOrNull(test_voxel))
+        search_key = voxel_key;
+        map.moveKey(search_key, x, y, z);
+
+        if (is_obstacle(search_key))
         {
           separation = glm::vec3(map.voxelCentreLocal(search_key)) - voxel_centre;
           range_sqr = glm::dot(separation, separation);
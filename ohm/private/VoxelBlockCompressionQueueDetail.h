@@ -12,11 +12,14 @@
 
 #ifdef OHM_THREADS
 #include <tbb/concurrent_queue.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/task_arena.h>
 #else  // OHM_THREADS
 #include <queue>
 #endif  // OHM_THREADS
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <mutex>
@@ -57,6 +60,36 @@ struct VoxelBlockCompressionQueueDetail
   std::atomic_uint64_t low_tide{ 6ull * 1024ull * 1024ull * 1024ull };
   /// Current allocation estimation.
   std::atomic_uint64_t estimated_allocated_size{ 0 };
+  /// Allocations (bytes) reported via @c notifyAllocation() since the last tick.
+  std::atomic_uint64_t pending_allocation{ 0 };
+  /// Time (steady clock ticks) at which the high tide was first noted as exceeded. Cleared once the estimated
+  /// allocation drops back below the low tide.
+  std::atomic<std::chrono::steady_clock::rep> high_tide_crossed{ 0 };
+  /// Number of compression worker threads. Zero for automatic.
+  std::atomic_uint worker_count{ 1 };
+  /// Statistic: total number of blocks compressed.
+  std::atomic_uint64_t blocks_compressed{ 0 };
+  /// Statistic: total number of bytes saved.
+  std::atomic_uint64_t bytes_saved{ 0 };
+  /// Statistic: compression rate over the last compression cycle.
+  std::atomic<double> blocks_per_second{ 0 };
+  /// Statistic: most recent lag (seconds) between crossing the high tide and finishing a compression cycle.
+  std::atomic<double> lag_seconds{ 0 };
+#ifdef OHM_THREADS
+  /// Per worker compression buffers.
+  tbb::enumerable_thread_specific<std::vector<uint8_t>> worker_buffers;
+  /// Arena limiting compression to the @c worker_count threads. Only used by the processing thread and reinitialised
+  /// only when the worker count changes.
+  tbb::task_arena arena;
+  /// Concurrency @c arena is initialised with. Zero before initialisation.
+  int arena_concurrency{ 0 };
+#endif  // OHM_THREADS
+  /// Mutex for @c wake_condition .
+  std::mutex wake_lock;
+  /// Condition variable used to wake the processing thread.
+  std::condition_variable wake_condition;
+  /// Set to wake the processing thread.
+  std::atomic_bool wake_flag{ false };
   /// Thread reference count.
   std::atomic_int reference_count{ 0 };
   /// Thread quit flag.
@@ -0,0 +1,363 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "MapSerialiseV0.6.h"
+
+#include "MapSerialiseV0.2.h"
+
+#include "private/OccupancyMapDetail.h"
+#include "private/SerialiseUtil.h"
+
+#include "MapChunk.h"
+#include "MapLayer.h"
+#include "MapSerialise.h"
+#include "Stream.h"
+#include "VoxelBlock.h"
+#include "VoxelBuffer.h"
+#include "VoxelCodec.h"
+
+#ifdef OHM_THREADS
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#endif  // OHM_THREADS
+
+#include <algorithm>
+#include <limits>
+
+namespace ohm
+{
+namespace v0_6
+{
+namespace
+{
+/// Number of regions to read before decompressing them in parallel. Limits the memory overhead of loading.
+const size_t kLoadBatchSize = 256u;
+}  // namespace
+
+int load(InputStream &stream, OccupancyMapDetail &detail, SerialiseProgress *progress, const MapVersion & /*version*/,
+         uint64_t region_table_offset, unsigned codec_type, const RegionFilter &filter)
+{
+  int err = v0_2::loadMapInfo(stream, detail.info);
+  if (err)
+  {
+    return err;
+  }
+
+  err = v0_1::loadLayout(stream, detail);
+  if (err)
+  {
+    return err;
+  }
+
+  std::vector<RegionTableEntry> table;
+  err = loadRegionTable(stream, region_table_offset, table);
+  if (err)
+  {
+    return err;
+  }
+
+  if (filter)
+  {
+    const auto remove_from = std::remove_if(table.begin(), table.end(),
+                                            [&filter](const RegionTableEntry &entry) { return !filter(entry.coord); });
+    table.erase(remove_from, table.end());
+  }
+
+  if (progress)
+  {
+    if (!table.empty())
+    {
+      progress->setTargetProgress(unsigned(table.size()));
+    }
+    else
+    {
+      progress->setTargetProgress(unsigned(1));
+      progress->incrementProgress();
+    }
+  }
+
+  if (table.empty())
+  {
+    return kSeOk;
+  }
+
+  const VoxelCodec::Ptr codec = VoxelCodec::create(VoxelCodec::Type(codec_type));
+  if (!codec)
+  {
+    return kSeCompressionFailure;
+  }
+
+  // Read the data in file order to minimise seeking.
+  std::sort(table.begin(), table.end(),
+            [](const RegionTableEntry &a, const RegionTableEntry &b) { return a.offset < b.offset; });
+
+  std::vector<std::vector<uint8_t>> compressed(std::min(kLoadBatchSize, table.size()));
+  std::vector<MapChunk *> chunks(compressed.size());
+  std::vector<int> errors(compressed.size());
+
+  const auto load_chunk = [&](size_t batch_start, size_t i, std::vector<uint8_t> &uncompressed) {
+    const RegionTableEntry &entry = table[batch_start + i];
+    uncompressed.resize(entry.uncompressed_size);
+    if (!codec->decompress(compressed[i].data(), compressed[i].size(), uncompressed.data(), uncompressed.size()))
+    {
+      errors[i] = kSeCompressionFailure;
+      return;
+    }
+
+    auto *chunk = new MapChunk(detail);
+    errors[i] = loadChunk(uncompressed.data(), uncompressed.size(), *chunk, detail);
+    if (!errors[i] && chunk->region.coord != entry.coord)
+    {
+      // Region table does not match the region data.
+      errors[i] = kSeFileReadFailure;
+    }
+
+    if (errors[i])
+    {
+      delete chunk;
+      return;
+    }
+
+    // Resolve map chunk details.
+    chunk->searchAndUpdateFirstValid(detail.region_voxel_dimensions);
+    chunks[i] = chunk;
+  };
+
+#ifdef OHM_THREADS
+  tbb::enumerable_thread_specific<std::vector<uint8_t>> uncompressed_buffers;
+#else   // OHM_THREADS
+  std::vector<uint8_t> uncompressed_buffer;
+#endif  // OHM_THREADS
+
+  for (size_t batch_start = 0; batch_start < table.size() && (!progress || !progress->quit());
+       batch_start += kLoadBatchSize)
+  {
+    const size_t batch_count = std::min(kLoadBatchSize, table.size() - batch_start);
+
+    // Read the compressed data serially.
+    for (size_t i = 0; i < batch_count; ++i)
+    {
+      const RegionTableEntry &entry = table[batch_start + i];
+      compressed[i].resize(entry.compressed_size);
+      stream.seek(entry.offset);
+      if (stream.readRaw(compressed[i].data(), entry.compressed_size) != entry.compressed_size)
+      {
+        return kSeFileReadFailure;
+      }
+      chunks[i] = nullptr;
+      errors[i] = kSeOk;
+    }
+
+    // Decompress and resolve the chunks in parallel.
+#ifdef OHM_THREADS
+    tbb::parallel_for(size_t(0), batch_count,
+                      [&](size_t i) { load_chunk(batch_start, i, uncompressed_buffers.local()); });
+#else   // OHM_THREADS
+    for (size_t i = 0; i < batch_count; ++i)
+    {
+      load_chunk(batch_start, i, uncompressed_buffer);
+    }
+#endif  // OHM_THREADS
+
+    for (size_t i = 0; i < batch_count; ++i)
+    {
+      if (errors[i])
+      {
+        err = (err) ? err : errors[i];
+        continue;
+      }
+
+      if (!err)
+      {
+        detail.chunks.insert(std::make_pair(chunks[i]->region.coord, chunks[i]));
+        if (progress)
+        {
+          progress->incrementProgress();
+        }
+      }
+      else
+      {
+        delete chunks[i];
+      }
+    }
+
+    if (err)
+    {
+      return err;
+    }
+  }
+
+  return kSeOk;
+}
+
+
+int saveRegionTable(OutputStream &stream, const std::vector<RegionTableEntry> &table)
+{
+  bool ok = true;
+  ok = writeUncompressed<uint32_t>(stream, table.size()) && ok;
+  for (const RegionTableEntry &entry : table)
+  {
+    ok = writeUncompressed<int32_t>(stream, entry.coord.x) && ok;
+    ok = writeUncompressed<int32_t>(stream, entry.coord.y) && ok;
+    ok = writeUncompressed<int32_t>(stream, entry.coord.z) && ok;
+    ok = writeUncompressed<uint64_t>(stream, entry.offset) && ok;
+    ok = writeUncompressed<uint32_t>(stream, entry.compressed_size) && ok;
+    ok = writeUncompressed<uint32_t>(stream, entry.uncompressed_size) && ok;
+  }
+
+  return (ok) ? 0 : kSeFileWriteFailure;
+}
+
+
+int loadRegionTable(InputStream &stream, uint64_t region_table_offset, std::vector<RegionTableEntry> &table)
+{
+  bool ok = true;
+  uint32_t entry_count = 0;
+
+  table.clear();
+  const uint64_t stream_size = stream.size();
+  if (region_table_offset > stream_size || stream_size - region_table_offset < sizeof(entry_count))
+  {
+    return kSeFileReadFailure;
+  }
+
+  stream.seek(region_table_offset);
+  ok = readRaw<uint32_t>(stream, entry_count) && ok;
+
+  if (!ok)
+  {
+    return kSeFileReadFailure;
+  }
+
+  // Validate the entry count from the file against the remaining stream before allocating for it.
+  const size_t entry_size = 3 * sizeof(int32_t) + sizeof(uint64_t) + 2 * sizeof(uint32_t);
+  const uint64_t table_size = uint64_t(entry_count) * entry_size;
+  if (table_size > stream_size - region_table_offset - sizeof(entry_count) ||
+      table_size > std::numeric_limits<unsigned>::max())
+  {
+    return kSeValueOverflow;
+  }
+
+  // Read the table in one block then parse.
+  std::vector<uint8_t> buffer(table_size);
+  ok = stream.readRaw(buffer.data(), unsigned(buffer.size())) == buffer.size();
+
+  if (!ok)
+  {
+    return kSeFileReadFailure;
+  }
+
+  table.resize(entry_count);
+  size_t pos = 0;
+  for (RegionTableEntry &entry : table)
+  {
+    ok = read<int32_t>(buffer.data(), buffer.size(), pos, entry.coord.x) && ok;
+    ok = read<int32_t>(buffer.data(), buffer.size(), pos, entry.coord.y) && ok;
+    ok = read<int32_t>(buffer.data(), buffer.size(), pos, entry.coord.z) && ok;
+    ok = read<uint64_t>(buffer.data(), buffer.size(), pos, entry.offset) && ok;
+    ok = read<uint32_t>(buffer.data(), buffer.size(), pos, entry.compressed_size) && ok;
+    ok = read<uint32_t>(buffer.data(), buffer.size(), pos, entry.uncompressed_size) && ok;
+  }
+
+  return (ok) ? 0 : kSeFileReadFailure;
+}
+
+
+int loadChunk(const uint8_t *buffer, size_t buffer_size, MapChunk &chunk, const OccupancyMapDetail &detail)
+{
+  bool ok = true;
+  size_t pos = 0;
+
+  // Read region details, then nodes. MapChunk members are derived.
+  ok = read<int32_t>(buffer, buffer_size, pos, chunk.region.coord.x) && ok;
+  ok = read<int32_t>(buffer, buffer_size, pos, chunk.region.coord.y) && ok;
+  ok = read<int32_t>(buffer, buffer_size, pos, chunk.region.coord.z) && ok;
+  ok = read<double>(buffer, buffer_size, pos, chunk.region.centre.x) && ok;
+  ok = read<double>(buffer, buffer_size, pos, chunk.region.centre.y) && ok;
+  ok = read<double>(buffer, buffer_size, pos, chunk.region.centre.z) && ok;
+  ok = read<double>(buffer, buffer_size, pos, chunk.touched_time) && ok;
+
+  if (ok)
+  {
+    const MapLayout &layout = detail.layout;
+    for (size_t i = 0; ok && i < layout.layerCount(); ++i)
+    {
+      const MapLayer &layer = layout.layer(i);
+      VoxelBuffer<VoxelBlock> voxel_buffer(chunk.voxel_blocks[i]);
+      // Get the layer memory.
+      uint8_t *layer_mem = voxel_buffer.voxelMemory();
+
+      if (layer.flags() & MapLayer::kSkipSerialise)
+      {
+        // Not to be serialised. Clear instead.
+        layer.clear(layer_mem, detail.region_voxel_dimensions);
+        continue;
+      }
+
+      uint64_t layer_touched_stamp = 0;
+      ok = read<uint64_t>(buffer, buffer_size, pos, layer_touched_stamp) && ok;
+
+      chunk.touched_stamps[i] = layer_touched_stamp;
+
+      const size_t node_count = layer.volume(detail.region_voxel_dimensions);
+      const size_t node_byte_count = layer.voxelByteSize() * node_count;
+      if (pos + node_byte_count > buffer_size)
+      {
+        return kSeFileReadFailure;
+      }
+
+      memcpy(layer_mem, buffer + pos, node_byte_count);
+      pos += node_byte_count;
+    }
+  }
+
+  return (ok) ? 0 : kSeFileReadFailure;
+}
+
+
+int saveChunk(std::vector<uint8_t> &buffer, const MapChunk &chunk, const OccupancyMapDetail &detail)
+{
+  // Write region details, then nodes. MapChunk members are derived.
+  write<int32_t>(buffer, chunk.region.coord.x);
+  write<int32_t>(buffer, chunk.region.coord.y);
+  write<int32_t>(buffer, chunk.region.coord.z);
+  write<double>(buffer, chunk.region.centre.x);
+  write<double>(buffer, chunk.region.centre.y);
+  write<double>(buffer, chunk.region.centre.z);
+  write<double>(buffer, chunk.touched_time);
+
+  // Save each map layer.
+  const MapLayout &layout = detail.layout;
+  for (size_t i = 0; i < layout.layerCount(); ++i)
+  {
+    const MapLayer &layer = layout.layer(i);
+
+    if (layer.flags() & MapLayer::kSkipSerialise)
+    {
+      // Not to be serialised.
+      continue;
+    }
+
+    uint64_t layer_touched_stamp = chunk.touched_stamps[i];
+    write<uint64_t>(buffer, layer_touched_stamp);
+
+    // Get the layer memory.
+    VoxelBuffer<const VoxelBlock> voxel_buffer(chunk.voxel_blocks[layer.layerIndex()]);
+    const uint8_t *layer_mem = voxel_buffer.voxelMemory();
+    const size_t node_count = layer.volume(detail.region_voxel_dimensions);
+    const size_t node_byte_count = layer.voxelByteSize() * node_count;
+    if (buffer.size() + node_byte_count != uint32_t(buffer.size() + node_byte_count))
+    {
+      // Region data size must fit the region table.
+      return kSeValueOverflow;
+    }
+
+    buffer.insert(buffer.end(), layer_mem, layer_mem + node_byte_count);
+  }
+
+  return kSeOk;
+}
+}  // namespace v0_6
+}  // namespace ohm
@@ -0,0 +1,89 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef MAPSERIALISEV0_6_H
+#define MAPSERIALISEV0_6_H
+
+#include "OhmConfig.h"
+
+#include "MapSerialiseV0.1.h"
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ohm
+{
+class InputStream;
+class OutputStream;
+struct MapChunk;
+struct MapVersion;
+struct OccupancyMapDetail;
+class SerialiseProgress;
+
+/// Filter function used to select which regions to load. Returns true to load the region.
+using RegionFilter = std::function<bool(const glm::i16vec3 &)>;
+
+namespace v0_6
+{
+/// An entry in the region table. Version 0.6 stores each region independently compressed, followed by a table of
+/// these entries, allowing regions to be located without decompressing the preceding data.
+struct RegionTableEntry
+{
+  /// The region coordinate.
+  glm::i16vec3 coord{ 0 };
+  /// The absolute file offset of the compressed region data.
+  uint64_t offset = 0;
+  /// Number of bytes of compressed region data.
+  uint32_t compressed_size = 0;
+  /// Number of bytes of region data once uncompressed.
+  uint32_t uncompressed_size = 0;
+};
+
+/// Load a version 0.6 map, optionally restricted to the regions passing @p filter .
+/// @param stream The stream to load from, positioned immediately after the header.
+/// @param detail The map to load into.
+/// @param progress Optional progress tracking.
+/// @param version The map version.
+/// @param region_table_offset Absolute file offset of the region table.
+/// @param codec_type The @c VoxelCodec::Type used to compress the regions.
+/// @param filter Optional filter selecting the regions to load. All regions are loaded when empty.
+/// @return @c kSeOk on success or a @c SerialisationError on failure.
+int load(InputStream &stream, OccupancyMapDetail &detail, SerialiseProgress *progress, const MapVersion &version,
+         uint64_t region_table_offset, unsigned codec_type, const RegionFilter &filter = RegionFilter());
+
+/// Write the region @p table to @p stream uncompressed.
+/// @param stream The stream to write to.
+/// @param table The region table.
+/// @return @c kSeOk on success or a @c SerialisationError on failure.
+int saveRegionTable(OutputStream &stream, const std::vector<RegionTableEntry> &table);
+
+/// Read the region @p table from @p stream .
+/// @param stream The stream to read from.
+/// @param region_table_offset Absolute file offset of the region table.
+/// @param[out] table The region table.
+/// @return @c kSeOk on success or a @c SerialisationError on failure.
+int loadRegionTable(InputStream &stream, uint64_t region_table_offset, std::vector<RegionTableEntry> &table);
+
+/// Load a chunk from an uncompressed memory buffer, as written by @c saveChunk() .
+/// @param buffer The uncompressed chunk data.
+/// @param buffer_size Number of bytes in @p buffer .
+/// @param chunk The chunk to load into.
+/// @param detail The map the chunk belongs to.
+/// @return @c kSeOk on success or a @c SerialisationError on failure.
+int loadChunk(const uint8_t *buffer, size_t buffer_size, MapChunk &chunk, const OccupancyMapDetail &detail);
+
+/// Save a chunk into an uncompressed memory buffer.
+/// @param[in,out] buffer The buffer to append to.
+/// @param chunk The chunk to save.
+/// @param detail The map the chunk belongs to.
+/// @return @c kSeOk on success or a @c SerialisationError on failure.
+int saveChunk(std::vector<uint8_t> &buffer, const MapChunk &chunk, const OccupancyMapDetail &detail);
+}  // namespace v0_6
+}  // namespace ohm
+
+#endif  // MAPSERIALISEV0_6_H
@@ -113,6 +113,7 @@ void OhmAppCpu::MapOptions::configure(cxxopts::OptionAdder &adder)
     ("miss", "The occupancy probability due to a miss. Must be < 0.5.", optVal(prob_miss))
     ("voxel-mean", "Enable voxel mean coordinates?", optVal(voxel_mean))
     ("traversal", "Enable traversal layer?", optVal(traversal))
+    ("threads", "Number of threads to use for ray integration. Zero for all available threads. Not supported for TSDF mapping.", optVal(thread_count))
     ("threshold", "Sets the occupancy threshold assigned when exporting the map to a cloud.", optVal(prob_thresh)->implicit_value(optStr(prob_thresh)))
     ("tsdf", "Build a tsdf map instead of an occupancy map. Incompatible with other voxel or occupancy options.", optVal(tsdf_enabled))
     ("tsdf-max-weight", "Maximum TSDF voxel weight.", optVal(tsdf.max_weight))
@@ -174,6 +175,7 @@ void OhmAppCpu::MapOptions::print(std::ostream &out)
   }
 
   out << "Ray length max: " << ray_length_max << '\n';
+  out << "Threads: " << thread_count << '\n';
 }
 
 
@@ -254,6 +256,8 @@ void OhmAppCpu::CompressionOptions::configure(cxxopts::OptionAdder &adder)
   adder
     ("high-tide", "Set the high memory tide which the background compression thread will try keep below.", optVal(high_tide))
     ("low-tide", "Set the low memory tide to which the background compression thread will try reduce to once high-tide is exceeded.", optVal(low_tide))
+    ("compression-threads", "Number of threads used to compress voxel data once high-tide is exceeded. Zero for all available threads.", optVal(worker_count))
+    ("compression-codec", "Codec used to compress voxel data [zlib, gzip, lz4, zstd]. Availability of lz4 and zstd depends on build options.", optVal(codec))
     ("uncompressed", "Maintain uncompressed map. By default, may regions may be compressed when no longer needed.", optVal(uncompressed))
   ;
   // clang-format on
@@ -267,6 +271,8 @@ void OhmAppCpu::CompressionOptions::print(std::ostream &out)
   {
     out << "  High tide: " << high_tide << '\n';
     out << "  Low tide: " << low_tide << '\n';
+    out << "  Threads: " << worker_count << '\n';
+    out << "  Codec: " << codec << '\n';
   }
 }
 
@@ -362,6 +368,34 @@ int OhmAppCpu::validateOptions(const cxxopts::ParseResult &parsed)
     return -1;
   }
 
+  // Resolve the compression codec.
+  if (!options().compression().uncompressed)
+  {
+    bool codec_found = false;
+    for (ohm::VoxelCodec::Type codec_type :
+         { ohm::VoxelCodec::kZLib, ohm::VoxelCodec::kGZip, ohm::VoxelCodec::kLz4, ohm::VoxelCodec::kZstd })
+    {
+      if (options().compression().codec == ohm::VoxelCodec::typeName(codec_type))
+      {
+        options().compression().codec_type = codec_type;
+        codec_found = true;
+        break;
+      }
+    }
+
+    if (!codec_found)
+    {
+      std::cerr << "Unknown compression codec: " << options().compression().codec << std::endl;
+      return -1;
+    }
+
+    if (!ohm::VoxelCodec::supported(options().compression().codec_type))
+    {
+      std::cerr << "Compression codec not supported in this build: " << options().compression().codec << std::endl;
+      return -1;
+    }
+  }
+
   // Set default ndt probability if using.
   if (int(options().ndt().mode))
   {
@@ -400,6 +434,13 @@ int OhmAppCpu::prepareForRun()
   ohm::MapFlag map_flags = ohm::MapFlag::kDefault;
   map_flags |= (options().map().voxel_mean) ? ohm::MapFlag::kVoxelMean : ohm::MapFlag::kNone;
   map_flags &= (options().compression().uncompressed) ? ~ohm::MapFlag::kCompressed : ~ohm::MapFlag::kNone;
+  if (!options().compression().uncompressed)
+  {
+    ohm::VoxelBlockCompressionQueue &compression_queue = ohm::VoxelBlockCompressionQueue::instance();
+    compression_queue.setHighTide(options().compression().high_tide.byteSize());
+    compression_queue.setLowTide(options().compression().low_tide.byteSize());
+    compression_queue.setWorkerCount(options().compression().worker_count);
+  }
   map_ = std::make_unique<ohm::OccupancyMap>(options().map().resolution, options().map().region_voxel_dim, map_flags);
 
   // Make sure we build layers before initialising any GPU map. Otherwise we can cache the wrong GPU programs.
@@ -421,7 +462,9 @@ int OhmAppCpu::prepareForRun()
     ndt_map_->setReinitialiseCovarianceThreshold(ohm::probabilityToValue(options().ndt().covariance_reset_probability));
     ndt_map_->setReinitialiseCovariancePointCount(options().ndt().covariance_reset_sample_count);
 
-    true_mapper_ = std::make_unique<ohm::RayMapperNdt>(ndt_map_.get());
+    auto ndt_mapper = std::make_unique<ohm::RayMapperNdt>(ndt_map_.get());
+    ndt_mapper->setThreadCount(options().map().thread_count);
+    true_mapper_ = std::move(ndt_mapper);
   }
   else if (options().map().tsdf_enabled)
   {
@@ -435,7 +478,9 @@ int OhmAppCpu::prepareForRun()
   }
   else
   {
-    true_mapper_ = std::make_unique<ohm::RayMapperOccupancy>(map_.get());
+    auto occupancy_mapper = std::make_unique<ohm::RayMapperOccupancy>(map_.get());
+    occupancy_mapper->setThreadCount(options().map().thread_count);
+    true_mapper_ = std::move(occupancy_mapper);
   }
 
   map_->setHitProbability(options().map().prob_hit);
@@ -491,6 +536,16 @@ int OhmAppCpu::prepareForRun()
     }
   }
 
+  if (!options().compression().uncompressed)
+  {
+    // Set the codec for all layers now the layout is finalised.
+    const ohm::VoxelCodec::Ptr codec = ohm::VoxelCodec::create(options().compression().codec_type);
+    for (size_t i = 0; i < map_->layout().layerCount(); ++i)
+    {
+      map_->layout().layerPtr(i)->setCodec(codec);
+    }
+  }
+
   return 0;
 }
 
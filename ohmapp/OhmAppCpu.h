@@ -15,6 +15,7 @@
 #include <ohm/NdtMode.h>
 #include <ohm/OccupancyMap.h>
 #include <ohm/RayMapper.h>
+#include <ohm/VoxelCodec.h>
 #include <ohm/VoxelTsdf.h>
 
 #include <logutil/LogUtil.h>
@@ -78,6 +79,8 @@ public:
     bool voxel_mean = false;
     /// Generate the map with voxel traversal for density queries?
     bool traversal = false;
+    /// Number of threads to use for CPU ray integration. Zero for all available, one for single threaded (default).
+    unsigned thread_count = 1;
 
     /// TSDF options.
     ohm::TsdfOptions tsdf{};
@@ -134,6 +137,12 @@ public:
     logutil::Bytes high_tide;
     /// Low tide: compress until this is reached.
     logutil::Bytes low_tide;
+    /// Number of compression worker threads. Zero for all available.
+    unsigned worker_count = 1;
+    /// Name of the codec used to compress voxel layers: zlib, gzip, lz4 or zstd.
+    std::string codec = "zlib";
+    /// Codec resolved from @c codec during option validation.
+    ohm::VoxelCodec::Type codec_type = ohm::VoxelCodec::kZLib;
     /// True to disable compression.
     bool uncompressed = false;
 
@@ -8,11 +8,18 @@
 #include <logutil/Logger.h>
 
 #include <slamio/SlamCloudLoader.h>
+#include <slamio/SlamIO.h>
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <limits>
+#include <thread>
 
 // Must be after argument streaming operators.
 #include <ohmutil/Options.h>
@@ -20,6 +27,171 @@
 using namespace ohm;
 namespace ohmapp
 {
+/// A batch of samples ready for the @c BatchFunction along with the batch ray statistics.
+struct SlamIOSource::Batch
+{
+  /// Batch origin passed to the @c BatchFunction .
+  glm::dvec3 origin{ 0 };
+  /// Samples, optionally interleaved with sensor positions.
+  std::vector<glm::dvec3> sensor_and_samples;
+  /// Sample timestamps.
+  std::vector<double> timestamps;
+  /// Sample intensities.
+  std::vector<float> intensities;
+  /// Sample colours.
+  std::vector<glm::vec4> colours;
+  /// Sample return numbers. Empty when not available.
+  std::vector<uint8_t> return_numbers;
+  /// Minimum sample ray length.
+  double ray_length_minimum = std::numeric_limits<double>::max();
+  /// Maximum sample ray length.
+  double ray_length_maximum = 0;
+  /// Total of the sample ray lengths.
+  double ray_length_total = 0;
+
+  /// Add a sample to the batch.
+  /// @param sample The sample to add.
+  /// @param with_sensor Add the sensor position before the sample?
+  /// @param with_return_number Add the sample return number?
+  /// @param max_return_number Clamp the return number to this value.
+  void add(const slamio::SamplePoint &sample, bool with_sensor, bool with_return_number, uint8_t max_return_number)
+  {
+    if (with_sensor)
+    {
+      sensor_and_samples.emplace_back(sample.origin);
+    }
+    sensor_and_samples.emplace_back(sample.sample);
+    colours.emplace_back(sample.colour);
+    intensities.emplace_back(sample.intensity);
+    timestamps.emplace_back(sample.timestamp);
+    if (with_return_number)
+    {
+      return_numbers.emplace_back(std::min(sample.return_number, max_return_number));
+    }
+
+    const double ray_length = glm::length(sample.sample - sample.origin);
+    ray_length_minimum = std::min(ray_length, ray_length_minimum);
+    ray_length_maximum = std::max(ray_length, ray_length_maximum);
+    ray_length_total += ray_length;
+  }
+
+  /// Clear the batch, retaining the allocated memory.
+  void clear()
+  {
+    sensor_and_samples.clear();
+    timestamps.clear();
+    intensities.clear();
+    colours.clear();
+    return_numbers.clear();
+    ray_length_minimum = std::numeric_limits<double>::max();
+    ray_length_maximum = ray_length_total = 0;
+  }
+
+  /// Swap content with @p other .
+  void swap(Batch &other)
+  {
+    std::swap(origin, other.origin);
+    sensor_and_samples.swap(other.sensor_and_samples);
+    timestamps.swap(other.timestamps);
+    intensities.swap(other.intensities);
+    colours.swap(other.colours);
+    return_numbers.swap(other.return_numbers);
+    std::swap(ray_length_minimum, other.ray_length_minimum);
+    std::swap(ray_length_maximum, other.ray_length_maximum);
+    std::swap(ray_length_total, other.ray_length_total);
+  }
+};
+
+namespace
+{
+/// A bounded ring of batches passed from a reader thread to the processing thread.
+///
+/// Batch content is swapped in and out of the ring so that batch memory circulates between the reader, the ring and
+/// the processing thread without reallocation.
+///
+/// Blocking calls wait until notified by the other side of the ring, by @c finish() or by @c abort() .
+template <typename Batch>
+class BatchRing
+{
+public:
+  /// Constructor.
+  /// @param capacity Maximum number of batches held in the ring. Must be at least one.
+  explicit BatchRing(unsigned capacity)
+    : batches_(std::max(capacity, 1u))
+  {}
+
+  /// Push @p batch into the ring, blocking while the ring is full. On return @p batch is empty.
+  /// @param batch The batch to push.
+  /// @return False if the ring has been aborted and reading should stop.
+  bool push(Batch &batch)
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    not_full_.wait(guard, [this]() { return count_ < batches_.size() || aborted_; });
+    if (aborted_)
+    {
+      batch.clear();
+      return false;
+    }
+    Batch &slot = batches_[(head_ + count_) % batches_.size()];
+    slot.swap(batch);
+    ++count_;
+    guard.unlock();
+    not_empty_.notify_one();
+    batch.clear();
+    return true;
+  }
+
+  /// Pop the next batch into @p batch , blocking while the ring is empty and not finished.
+  /// @param batch Batch to swap the next batch into.
+  /// @return False once the ring has been drained after @c finish() or once aborted.
+  bool pop(Batch &batch)
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    not_empty_.wait(guard, [this]() { return count_ > 0 || finished_ || aborted_; });
+    if (count_ == 0 || aborted_)
+    {
+      return false;
+    }
+    batches_[head_].swap(batch);
+    head_ = (head_ + 1) % batches_.size();
+    --count_;
+    guard.unlock();
+    not_full_.notify_one();
+    return true;
+  }
+
+  /// Mark that no more batches will be pushed.
+  void finish()
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    finished_ = true;
+    guard.unlock();
+    not_empty_.notify_all();
+  }
+
+  /// Abort the pipeline, releasing a blocked @c push() and discarding pending batches.
+  void abort()
+  {
+    std::unique_lock<std::mutex> guard(mutex_);
+    aborted_ = true;
+    guard.unlock();
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+private:
+  std::vector<Batch> batches_;
+  size_t head_ = 0;
+  size_t count_ = 0;
+  bool finished_ = false;
+  bool aborted_ = false;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
+}  // namespace
+
+
 void SlamIOSource::Options::configure(cxxopts::OptionAdder &adder)
 {
   Super::Options::configure(adder);
@@ -27,9 +199,11 @@ void SlamIOSource::Options::configure(cxxopts::OptionAdder &adder)
   adder
     ("batch-delta", "Maximum delta in the sensor movement before forcing a batch up. Zero/negative to disable.", optVal(sensor_batch_delta))
     ("batch-size", "The number of points to process in each batch. Controls debug display. In GPU mode, this controls the GPU grid size.", optVal(batch_size))
-    ("cloud", "The input cloud (las/laz) to load.", cxxopts::value(cloud_file))
+    ("cloud", "The input cloud (las/laz) to load. May be a wildcard pattern matching a set of time ordered tiles, loaded in sorted order.", cxxopts::value(cloud_file))
+    ("pipeline", "Number of batches to read ahead on a separate thread while processing. Zero to read and process on one thread.", optVal(pipeline_depth))
     ("points-only", "Assume the point cloud is providing points only. Otherwise a cloud file with no trajectory is considered a ray cloud.", optVal(point_cloud_only))
     ("preload", "Preload this number of points before starting processing. -1 for all. May be used for separating processing and loading time.", optVal(preload_count)->default_value("0")->implicit_value("-1"))
+    ("read-ahead", "Number of cloud tiles to stream ahead on background threads when --cloud matches multiple files. Zero to read tiles sequentially.", optVal(file_read_ahead))
     ("sensor", "Offset from the trajectory to the sensor position. Helps correct trajectory to the sensor centre for better rays.", optVal(sensor_offset))
     ("trajectory", "The trajectory (text) file to load.", cxxopts::value(trajectory_file))
     ;
@@ -78,6 +252,8 @@ void SlamIOSource::Options::print(std::ostream &out)
   {
     out << "Points batch size: " << batch_size << '\n';
   }
+  out << "Pipeline depth: " << pipeline_depth << '\n';
+  out << "Tile read ahead: " << file_read_ahead << '\n';
 
   Super::Options::print(out);
 }
@@ -92,6 +268,18 @@ SlamIOSource::~SlamIOSource() = default;
 
 std::string SlamIOSource::sourceName() const
 {
+  // Name a set of tiles from the pattern up to the first wildcard, less any separators.
+  const auto wildcard_start = options().cloud_file.find_first_of("*?[");
+  if (wildcard_start != std::string::npos)
+  {
+    std::string name = options().cloud_file.substr(0, wildcard_start);
+    while (!name.empty() && std::strchr("_-. /\\", name.back()))
+    {
+      name.pop_back();
+    }
+    return (!name.empty()) ? name : std::string("cloud");
+  }
+
   const auto extension_start = options().cloud_file.find_last_of('.');
   if (extension_start != std::string::npos)
   {
@@ -144,9 +332,18 @@ int SlamIOSource::prepareForRun(uint64_t &point_count, const std::string &refere
   loader_->enableReturnNumberInference(options().return_number_mode == ReturnNumberMode::Auto);
 
   loader_->setErrorLog([this](const char *msg) { logutil::error(msg); });
+  loader_->setFileReadAhead(options().file_read_ahead);
+
+  const std::vector<std::string> cloud_files = slamio::expandFilePattern(options().cloud_file.c_str());
+  if (cloud_files.empty())
+  {
+    logutil::error("No files match cloud ", options().cloud_file, '\n');
+    return 1;
+  }
+
   if (!options().trajectory_file.empty())
   {
-    if (!loader_->openWithTrajectory(options().cloud_file.c_str(), options().trajectory_file.c_str()))
+    if (!loader_->openWithTrajectory(cloud_files, options().trajectory_file.c_str()))
     {
       logutil::error("Error loading cloud ", options().cloud_file, " with trajectory ", options().trajectory_file,
                      '\n');
@@ -155,7 +352,7 @@ int SlamIOSource::prepareForRun(uint64_t &point_count, const std::string &refere
   }
   else if (!options().point_cloud_only)
   {
-    if (!loader_->openRayCloud(options().cloud_file.c_str()))
+    if (!loader_->openRayCloud(cloud_files))
     {
       logutil::error("Error loading ray ", options().cloud_file, '\n');
       return 1;
@@ -163,7 +360,7 @@ int SlamIOSource::prepareForRun(uint64_t &point_count, const std::string &refere
   }
   else if (options().point_cloud_only)
   {
-    if (!loader_->openPointCloud(options().cloud_file.c_str()))
+    if (!loader_->openPointCloud(cloud_files))
     {
       logutil::error("Error loading point cloud ", options().cloud_file, '\n');
       return 1;
@@ -232,35 +429,20 @@ int SlamIOSource::run(BatchFunction batch_function, unsigned *quit_level_ptr)
     return 1;
   }
 
-  // Data samples array, optionall interleaved with sensor position.
-  std::vector<glm::dvec3> sensor_and_samples;
-  std::vector<glm::vec4> colours;
-  std::vector<float> intensities;
-  std::vector<double> timestamps;
-  std::vector<uint8_t> return_numbers;
-  glm::dvec3 batch_origin(0);
-  glm::dvec3 last_batch_origin(0);
-  // Update map visualisation every N samples.
-  const size_t ray_batch_size = options().batch_size;
-  double timebase = -1;
-  double last_batch_timestamp = -1;
-  double accumulated_motion = 0;
-  double delta_motion = 0;
-  bool warned_no_motion = false;
+  // A failure to read a cloud tile ends the samples early. Report it rather than treating it as the end of the data.
+  const auto read_result = [this]() {
+    const bool read_failed = !loader_->readError().empty();
+    if (read_failed)
+    {
+      logutil::error("Failed to read the input cloud: ", loader_->readError(), '\n');
+    }
+    loader_->close();
+    loader_.reset();
+    return (!read_failed) ? 0 : 1;
+  };
 
-  //------------------------------------
-  // Population loop.
-  //------------------------------------
-  Stats batch_stats{};
   slamio::SamplePoint sample{};
-  bool point_pending = false;
-  bool have_processed = false;
-  bool finish = false;
-  // Cache control variables
-  const auto point_limit = options().point_limit;
-  const auto time_limit = options().time_limit;
   const auto input_start_time = options().start_time;
-  const auto sensor_batch_delta = options().sensor_batch_delta;
 
   // Get to the first sample tiem.
   // Read the first sample and set the time base.
@@ -269,35 +451,81 @@ int SlamIOSource::run(BatchFunction batch_function, unsigned *quit_level_ptr)
     // No work to do.
     logutil::info("No points to process\n");
     flush_on_exit();
-    return 0;
+    return read_result();
   }
 
-  timebase = sample.timestamp;
+  timebase_ = sample.timestamp;
 
-  while (sample.timestamp - timebase < input_start_time)
+  while (sample.timestamp - timebase_ < input_start_time)
   {
     if (!loader_->nextSample(sample))
     {
       logutil::info("No sample points before selected start time ", input_start_time, ". Nothign to do.\n");
       flush_on_exit();
-      return 0;
+      return read_result();
     }
   }
 
-  batch_origin = sample.origin;
+  global_stats_.data_time_start = timebase_;
+  global_stats_.process_time_start = 0;
+  processed_point_count_ = 0;
+  processed_time_range_ = 0;
+
+  if (options().pipeline_depth > 0)
+  {
+    runPipelined(batch_function, sample, quit_level_ptr);
+  }
+  else
+  {
+    Stats batch_stats{};
+    batch_stats.data_time_start = timebase_;
+    batch_stats.process_time_start = 0;
+    readBatches(
+      sample,
+      [&](Batch &batch) {
+        const bool keep_processing = processBatch(batch_function, batch, batch_stats);
+        batch.clear();
+        return keep_processing;
+      },
+      quit_level_ptr);
+  }
+
+  flush_on_exit();
+  return read_result();
+}
 
-  point_pending = true;
-  global_stats_.data_time_start = batch_stats.data_time_start = timebase;
-  global_stats_.process_time_start = batch_stats.process_time_start = 0;
+
+void SlamIOSource::readBatches(slamio::SamplePoint &sample, const std::function<bool(Batch &)> &emit,
+                               unsigned *quit_level_ptr)
+{
+  // Data samples array, optionall interleaved with sensor position.
+  Batch batch;
+  glm::dvec3 batch_origin = sample.origin;
+  glm::dvec3 last_batch_origin(0);
+  // Update map visualisation every N samples.
+  const size_t ray_batch_size = options().batch_size;
+  double last_batch_timestamp = -1;
+  double accumulated_motion = 0;
+  double delta_motion = 0;
+  bool warned_no_motion = false;
+
+  //------------------------------------
+  // Population loop.
+  //------------------------------------
+  bool point_pending = true;
+  bool have_processed = false;
+  bool finish = false;
+  // Cache control variables
+  const auto point_limit = options().point_limit;
+  const auto time_limit = options().time_limit;
+  const auto sensor_batch_delta = options().sensor_batch_delta;
 
   uint64_t process_points_local = 0;
   const uint8_t max_return_number =
     (options().return_number_mode != ReturnNumberMode::Off) ? std::numeric_limits<uint8_t>::max() : 0u;
   const bool use_return_number = loader_->hasReturnNumber() || loader_->returnNumberInference();
-  processed_point_count_ = 0;
-  processed_time_range_ = 0;
   while ((process_points_local < point_limit || point_limit == 0) &&
-         (last_batch_timestamp - timebase < time_limit || time_limit == 0) && point_pending && !finish)
+         (last_batch_timestamp - timebase_ < time_limit || time_limit == 0) && point_pending && !finish)
   {
     const double sensor_delta_sq = glm::dot(sample.origin - batch_origin, sample.origin - batch_origin);
     const bool sensor_delta_exceeded =
@@ -306,24 +534,7 @@ int SlamIOSource::run(BatchFunction batch_function, unsigned *quit_level_ptr)
     // Add sample to the batch.
     if (!sensor_delta_exceeded)
     {
-      if (!samplesOnly())
-      {
-        sensor_and_samples.emplace_back(sample.origin);
-      }
-      sensor_and_samples.emplace_back(sample.sample);
-      colours.emplace_back(sample.colour);
-      intensities.emplace_back(sample.intensity);
-      timestamps.emplace_back(sample.timestamp);
-      if (use_return_number)
-      {
-        return_numbers.emplace_back(std::min(sample.return_number, max_return_number));
-      }
-
-      const double ray_length = glm::length(sample.sample - sample.origin);
-      batch_stats.ray_length_minimum = std::min(ray_length, batch_stats.ray_length_minimum);
-      batch_stats.ray_length_maximum = std::max(ray_length, batch_stats.ray_length_maximum);
-      batch_stats.ray_length_total += ray_length;
-
+      batch.add(sample, !samplesOnly(), use_return_number, max_return_number);
       point_pending = false;
     }
     else
@@ -332,32 +543,25 @@ int SlamIOSource::run(BatchFunction batch_function, unsigned *quit_level_ptr)
       point_pending = true;
     }
 
-    if (!timestamps.empty() && (sensor_delta_exceeded || timestamps.size() >= ray_batch_size ||
-                                point_limit && process_points_local + timestamps.size() >= point_limit))
+    if (!batch.timestamps.empty() && (sensor_delta_exceeded || batch.timestamps.size() >= ray_batch_size ||
+                                      point_limit && process_points_local + batch.timestamps.size() >= point_limit))
     {
-      finish = !processBatch(batch_function, batch_origin, sensor_and_samples, timestamps, intensities, colours,
-                             return_numbers, batch_stats);
+      const size_t batch_point_count = batch.timestamps.size();
+      batch.origin = batch_origin;
+      finish = !emit(batch);
 
       delta_motion = glm::length(batch_origin - last_batch_origin);
       accumulated_motion += delta_motion;
       last_batch_origin = batch_origin;
 
-      if (have_processed && !warned_no_motion && delta_motion == 0 && !timestamps.empty())
+      if (have_processed && !warned_no_motion && delta_motion == 0)
       {
         // Precisely zero motion seems awfully suspicious.
         logutil::warn("\nWarning: Precisely zero motion in batch\n");
         warned_no_motion = true;
       }
       have_processed = true;
-      process_points_local += timestamps.size();
-      processed_point_count_ = process_points_local;
-      processed_time_range_ = timestamps.back() - timebase;
-
-      sensor_and_samples.clear();
-      timestamps.clear();
-      intensities.clear();
-      colours.clear();
-      return_numbers.clear();
+      process_points_local += batch_point_count;
     }
 
     if (!point_pending)
@@ -365,7 +569,7 @@ int SlamIOSource::run(BatchFunction batch_function, unsigned *quit_level_ptr)
       // Fetch next sample.
       point_pending = loader_->nextSample(sample);
     }
-    batch_origin = (timestamps.empty()) ? sample.origin : batch_origin;
+    batch_origin = (batch.timestamps.empty()) ? sample.origin : batch_origin;
 
     finish = finish || (quit_level_ptr && *quit_level_ptr != 0u);
   }
@@ -373,31 +577,15 @@ int SlamIOSource::run(BatchFunction batch_function, unsigned *quit_level_ptr)
   if (point_pending && (!point_limit || process_points_local < point_limit))
   {
     // Final point processing.
-    if (!samplesOnly())
-    {
-      sensor_and_samples.emplace_back(sample.origin);
-    }
-    sensor_and_samples.emplace_back(sample.sample);
-    colours.emplace_back(sample.colour);
-    intensities.emplace_back(sample.intensity);
-    timestamps.emplace_back(sample.timestamp);
-
-    const double ray_length = glm::length(sample.sample - sample.origin);
-    batch_stats.ray_length_minimum = std::min(ray_length, batch_stats.ray_length_minimum);
-    batch_stats.ray_length_maximum = std::max(ray_length, batch_stats.ray_length_maximum);
-    batch_stats.ray_length_total += ray_length;
-
+    batch.add(sample, !samplesOnly(), use_return_number, max_return_number);
     point_pending = false;
   }
 
   // Process the final batch.
-  if (!timestamps.empty() && !finish)
+  if (!batch.timestamps.empty() && !finish)
   {
-    processBatch(batch_function, last_batch_origin, sensor_and_samples, timestamps, intensities, colours,
-                 return_numbers, batch_stats);
-    process_points_local += timestamps.size();
-    processed_point_count_ = process_points_local;
-    processed_time_range_ = timestamps.back() - timebase;
+    batch.origin = last_batch_origin;
+    emit(batch);
   }
 
   const double motion_epsilon = 1e-6;
@@ -405,12 +593,64 @@ int SlamIOSource::run(BatchFunction batch_function, unsigned *quit_level_ptr)
   {
     logutil::warn("Warning: very low accumulated motion: ", accumulated_motion, '\n');
   }
+}
 
-  loader_->close();
-  loader_.release();
 
-  flush_on_exit();
-  return 0;
+void SlamIOSource::runPipelined(const BatchFunction &batch_function, slamio::SamplePoint &sample,
+                                unsigned *quit_level_ptr)
+{
+  BatchRing<Batch> ring(options().pipeline_depth);
+  std::exception_ptr reader_error;
+
+  // Read on a background thread, but process on this thread as the batch function may require thread affinity, such
+  // as for a GPU context. Only this thread reads the quit level, which is not synchronised, checking it after each
+  // batch. The reader stops when this thread aborts the ring.
+  std::thread reader([this, &ring, &sample, &reader_error]() {
+    try
+    {
+      readBatches(
+        sample, [&ring](Batch &batch) { return ring.push(batch); }, nullptr);
+    }
+    catch (...)
+    {
+      reader_error = std::current_exception();
+    }
+    ring.finish();
+  });
+
+  // Ensure the reader is released and joined if processing throws.
+  struct ReaderGuard
+  {
+    BatchRing<Batch> &ring;
+    std::thread &reader;
+    ~ReaderGuard()
+    {
+      ring.abort();
+      reader.join();
+    }
+  };
+
+  {
+    ReaderGuard reader_guard{ ring, reader };
+    Batch batch;
+    Stats batch_stats{};
+    batch_stats.data_time_start = timebase_;
+    batch_stats.process_time_start = 0;
+    const auto quit = [quit_level_ptr]() { return quit_level_ptr && *quit_level_ptr != 0u; };
+    while (ring.pop(batch))
+    {
+      if (!processBatch(batch_function, batch, batch_stats) || quit())
+      {
+        // Release the reader and discard any batches read ahead.
+        ring.abort();
+      }
+    }
+  }
+
+  if (reader_error)
+  {
+    std::rethrow_exception(reader_error);
+  }
 }
 
 
@@ -455,24 +695,29 @@ void SlamIOSource::addBatchStats(const Stats &stats)
 
 
 // Yes, try inline this private function.
-inline bool SlamIOSource::processBatch(const BatchFunction &batch_function, const glm::dvec3 &batch_origin,
-                                       const std::vector<glm::dvec3> &sensor_and_samples,
-                                       const std::vector<double> &timestamps, const std::vector<float> &intensities,
-                                       const std::vector<glm::vec4> &colours, const std::vector<uint8_t> &return_number,
-                                       Stats &stats)
+inline bool SlamIOSource::processBatch(const BatchFunction &batch_function, const Batch &batch, Stats &stats)
 {
   const auto time_now = Clock::now();
   stats.process_time_end = std::chrono::duration<double>(time_now - time_point_start_).count();
-  stats.data_time_end = (!timestamps.empty()) ? timestamps.back() : stats.data_time_start;
-  stats.ray_count = unsigned(timestamps.size());
-  const bool keep_processing =
-    batch_function(batch_origin, sensor_and_samples, timestamps, intensities, colours, return_number);
+  stats.data_time_end = (!batch.timestamps.empty()) ? batch.timestamps.back() : stats.data_time_start;
+  stats.ray_count = unsigned(batch.timestamps.size());
+  stats.ray_length_minimum = batch.ray_length_minimum;
+  stats.ray_length_maximum = batch.ray_length_maximum;
+  stats.ray_length_total = batch.ray_length_total;
+  const bool keep_processing = batch_function(batch.origin, batch.sensor_and_samples, batch.timestamps,
+                                              batch.intensities, batch.colours, batch.return_numbers);
   if (options().stats_mode != StatsMode::Off)
   {
     addBatchStats(stats);
   }
   stats.reset(stats.process_time_end, stats.data_time_end);
 
+  processed_point_count_ += batch.timestamps.size();
+  if (!batch.timestamps.empty())
+  {
+    processed_time_range_ = batch.timestamps.back() - timebase_;
+  }
+
   return keep_processing;
 }
 }  // namespace ohmapp
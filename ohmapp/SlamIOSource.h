@@ -11,13 +11,15 @@
 
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <mutex>
 
 namespace slamio
 {
 class SlamCloudLoader;
-}
+struct SamplePoint;
+}  // namespace slamio
 
 namespace ohmapp
 {
@@ -33,6 +35,8 @@ public:
   {
     /// Point cloud data file. May alternatively specify a ray cloud file where the normals prepresent a ray back to
     /// the sensor location. Ray clouds do not require a trajectory file.
+    ///
+    /// May be a file pattern with wildcards to load a time ordered set of tiles. See @c slamio::expandFilePattern() .
     std::string cloud_file;
     /// Trajectory file. May be a point cloud or a text trajectory file. See @c slamio library.
     std::string trajectory_file;
@@ -44,6 +48,12 @@ public:
     double sensor_batch_delta = 0.0;
     /// Trigger a batch whenever this number of points have been loaded.
     unsigned batch_size = 4096;
+    /// Number of batches which may be read ahead of the batch being processed. Batches are read on a separate thread
+    /// when non-zero, overlapping loading with map processing. Zero to read and process on the same thread.
+    unsigned pipeline_depth = 2;
+    /// Number of cloud tiles to stream ahead on background threads when @c cloud_file matches multiple files. Zero to
+    /// read the tiles sequentially.
+    unsigned file_read_ahead = 2;
     /// True to process a point cloud without a trajectory. No sensor positions are known, and the sensor positions are
     /// given as the sample positions.
     bool point_cloud_only = false;
@@ -80,6 +90,27 @@ public:
   Stats windowedStats() const override;
 
 private:
+  struct Batch;
+
+  /// Read batches from the @c loader_ , passing each batch to @p emit . This is the population loop, which runs either
+  /// on the @c run() thread or on a reader thread when pipelining.
+  ///
+  /// @param sample The first sample to process, at or after the start time.
+  /// @param emit Called to process or queue each batch. The batch content may be swapped out, but the batch must be
+  ///   left empty. Returns false to stop reading.
+  /// @param quit_level_ptr Reading stops when this is non-null and non-zero.
+  void readBatches(slamio::SamplePoint &sample, const std::function<bool(Batch &)> &emit, unsigned *quit_level_ptr);
+
+  /// Read and process batches in a pipeline where a reader thread fills a ring of batches for processing on the calling
+  /// thread.
+  ///
+  /// Exceptions thrown by the @p batch_function stop the reader and propagate once it has been joined, as do
+  /// exceptions thrown while reading.
+  /// @param batch_function The batch processing function.
+  /// @param sample The first sample to process.
+  /// @param quit_level_ptr Processing stops when this is non-null and non-zero. Only read on the calling thread.
+  void runPipelined(const BatchFunction &batch_function, slamio::SamplePoint &sample, unsigned *quit_level_ptr);
+
   /// Update and cache the @c windowedStats() .
   void updateWindowedStats();
 
@@ -87,11 +118,8 @@ private:
   /// @param stats Batch stats to add.
   void addBatchStats(const Stats &stats);
 
-  /// Process a data batch, collecting stats.
-  bool processBatch(const BatchFunction &batch_function, const glm::dvec3 &batch_origin,
-                    const std::vector<glm::dvec3> &sensor_and_samples, const std::vector<double> &timestamps,
-                    const std::vector<float> &intensities, const std::vector<glm::vec4> &colours,
-                    const std::vector<uint8_t> &return_number, Stats &stats);
+  /// Process a data batch, collecting stats and updating the processed point count and time range.
+  bool processBatch(const BatchFunction &batch_function, const Batch &batch, Stats &stats);
 
   using Clock = std::chrono::high_resolution_clock;
 
@@ -101,6 +129,8 @@ private:
   std::atomic<uint64_t> processed_point_count_{};
   /// Time range processed. Must be kept up to date during @c run() for display and statistics.
   std::atomic<double> processed_time_range_{};
+  /// Timestamp of the first sample processed.
+  double timebase_ = 0;
   /// Stats window ring buffer.
   std::vector<Stats> windowed_stats_buffer_;
   /// Target buffer size for the stats window ring buffer.
@@ -212,24 +212,25 @@ void regionFloodFillStepCpuBlock(OccupancyMap &map, ClearanceProcessDetail & /*q
     }
   }
 
-  chunk->touched_stamps[map.layout().clearanceLayer()] = chunk->dirty_stamp = map.touch();
+  chunk->markDirty(map.touch());
+  chunk->touched_stamps[map.layout().clearanceLayer()] = chunk->dirty_stamp.load();
 }
 
 
 unsigned regionClearanceProcessCpu(OccupancyMap &map, ClearanceProcessDetail &query, const glm::i16vec3 &region_key)
 {
   OccupancyMapDetail &map_data = *map.detail();
-  const auto chunk_search = map_data.chunks.find(region_key);
+  MapChunk *const region_chunk = map_data.chunks.lookup(region_key);
   glm::ivec3 voxel_search_half_extents;
 
-  if (chunk_search == map_data.chunks.end())
+  if (!region_chunk)
   {
     // The entire region is unknown space. Nothing to do as we can't write to anything.
     return 0;
   }
 
   voxel_search_half_extents = ohm::calculateVoxelSearchHalfExtents(map, query.search_radius);
-  MapChunk *chunk = chunk_search->second;
+  MapChunk *chunk = region_chunk;
 
 #ifdef OHM_THREADS
   const auto parallel_query_func = [&query, &map, region_key, chunk,
@@ -256,17 +257,17 @@ unsigned regionSeedFloodFillCpu(OccupancyMap &map, ClearanceProcessDetail &query
                                 const glm::ivec3 & /*voxel_extents*/, const glm::ivec3 &calc_extents)
 {
   OccupancyMapDetail &map_data = *map.detail();
-  const auto chunk_search = map_data.chunks.find(region_key);
+  MapChunk *const region_chunk = map_data.chunks.lookup(region_key);
   glm::ivec3 voxel_search_half_extents;
 
-  if (chunk_search == map_data.chunks.end())
+  if (!region_chunk)
   {
     // The entire region is unknown space. Nothing to do as we can't write to anything.
     return 0;
   }
 
   voxel_search_half_extents = ohm::calculateVoxelSearchHalfExtents(map, query.search_radius);
-  MapChunk *chunk = chunk_search->second;
+  MapChunk *chunk = region_chunk;
 
 #ifdef OHM_THREADS
   const auto parallel_query_func = [&query, &map, region_key, chunk,
@@ -293,17 +294,17 @@ unsigned regionFloodFillStepCpu(OccupancyMap &map, ClearanceProcessDetail &query
                                 const glm::ivec3 & /*voxel_extents*/, const glm::ivec3 &calc_extents)
 {
   OccupancyMapDetail &map_data = *map.detail();
-  const auto chunk_search = map_data.chunks.find(region_key);
+  MapChunk *const region_chunk = map_data.chunks.lookup(region_key);
   glm::ivec3 voxel_search_half_extents;
 
-  if (chunk_search == map_data.chunks.end())
+  if (!region_chunk)
   {
     // The entire region is unknown space. Nothing to do as we can't write to anything.
     return 0;
   }
 
   voxel_search_half_extents = ohm::calculateVoxelSearchHalfExtents(map, query.search_radius);
-  MapChunk *chunk = chunk_search->second;
+  MapChunk *chunk = region_chunk;
 
 #ifdef OHM_THREADS
   const auto parallel_query_func = [&query, &map, region_key, chunk,
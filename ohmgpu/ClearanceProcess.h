@@ -33,7 +33,8 @@ class OccupancyMap;
 /// The CPU implementation performs a brute force O(nmm) where n is defined by the number of voxels within all regions
 /// in the search extents, an m is defined by the number of voxels required to reach the @c searchRadius(). The GPU
 /// implementation is closer to worst case O(m) although it incurs additional, initial overhead. The GPU
-/// implementation is recommended over the CPU implementation.
+/// implementation is recommended over the CPU implementation. For CPU only clearance calculation, see
+/// @c EdtClearanceProcess in @c ohm , which calculates exact ranges in linear time.
 ///
 /// Both CPU and GPU implementations keep track of which regions have been previously calculated. Results are not
 /// recalculated for a region unless a hard @c reset() is performed.
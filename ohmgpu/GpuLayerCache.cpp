@@ -493,7 +493,8 @@ GpuCacheEntry *GpuLayerCache::resolveCacheEntry(OccupancyMap &map, const glm::i1
         // Keeping in sync between GPU and CPU has been an ongoing issue. It probably needs a stamping system which
         // separates CPU and GPU changes, but we don't have that yet. As an interim solution to recognising GPU changes,
         // we update the dirty stamp for a chunk on both upload and download.
-        chunk->dirty_stamp = chunk->touched_stamps[imp_->layer_index] = entry->chunk_touch_stamp = imp_->map->stamp();
+        chunk->touched_stamps[imp_->layer_index] = entry->chunk_touch_stamp = imp_->map->stamp();
+        chunk->markDirty(entry->chunk_touch_stamp);
       }
       else
       {
@@ -607,7 +608,8 @@ GpuCacheEntry *GpuLayerCache::resolveCacheEntry(OccupancyMap &map, const glm::i1
       if (!entry->skip_download)
       {
         // As above where we upload to update, we change the stamp for the chunk on both upload and download.
-        chunk->dirty_stamp = chunk->touched_stamps[imp_->layer_index] = entry->chunk_touch_stamp = imp_->map->stamp();
+        chunk->touched_stamps[imp_->layer_index] = entry->chunk_touch_stamp = imp_->map->stamp();
+        chunk->markDirty(entry->chunk_touch_stamp);
       }
       else
       {
@@ -683,8 +685,8 @@ void GpuLayerCache::syncToMainMemory(GpuCacheEntry &entry, bool wait_on_sync)
       imp_->buffer->read(voxel_mem, imp_->chunk_mem_size, entry.mem_offset, &imp_->gpu_queue, &last_event,
                          &entry.sync_event);
       // Update the dirty stamp for the region
-      entry.chunk->dirty_stamp = entry.chunk->touched_stamps[imp_->layer_index] = entry.chunk_touch_stamp =
-        imp_->map->touch();
+      entry.chunk->touched_stamps[imp_->layer_index] = entry.chunk_touch_stamp = imp_->map->touch();
+      entry.chunk->markDirty(entry.chunk_touch_stamp);
       // Also need to invalidate the MapChunk::first_valid_index as we don't know what it will be coming off the GPU.
       // We only apply this change for the occupancy layer
       if (imp_->layer_index == unsigned(imp_->map->layout().occupancyLayer()) ||
@@ -11,6 +11,7 @@
 #include "HeightmapUtil.h"
 #include "PlaneFillLayeredWalker.h"
 #include "PlaneFillWalker.h"
+#include "PlaneUpdateWalker.h"
 #include "PlaneWalker.h"
 
 #include <ohm/Aabb.h>
@@ -33,12 +34,22 @@
 
 #include <3esservermacros.h>
 
+#ifdef OHM_THREADS
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif  // OHM_THREADS
+
 #include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 // Enable code to support breaking on a specific voxel.
 #define HM_DEBUG_VOXEL 0
@@ -47,6 +58,19 @@ namespace ohm
 {
 namespace heightmap
 {
+/// Number of upcoming walk keys for which to search the source map columns in parallel.
+const size_t kColumnLookahead = 2048u;
+/// Minimum number of upcoming walk keys required to make a parallel column search worthwhile.
+const size_t kMinParallelColumns = 64u;
+
+/// Column search results for a walk key. Used to search columns ahead of the walk when using multiple threads.
+struct ColumnSearch
+{
+  Key walk_key = Key(nullptr);       ///< The walk key from which the column search started.
+  Key candidate_key = Key(nullptr);  ///< Result of @c findNearestSupportingVoxel() .
+  GroundCandidate ground;            ///< Result of @c findGround() .
+};
+
 /// Helper function for visiting a heightmap node. This expands into the neighbours as required and performs debug
 /// rendering.
 /// @param walker The class used to walk the heightmap region. Examples; @c PlaneWalker , @c PlanerFillWalker ,
@@ -110,6 +134,106 @@ void onVisitWalker(Walker &walker, const HeightmapDetail &imp, const Key &walk_k
   }
 #endif  // neighbours
 }
+
+
+/// Query whether a walk updates an existing heightmap rather than building a new heightmap.
+/// @param walker The class used to walk the heightmap region.
+/// @return True for a @c PlaneUpdateWalker .
+template <typename Walker>
+inline bool isUpdateWalk(const Walker & /*walker*/)
+{
+  return false;
+}
+
+
+/// @overload
+inline bool isUpdateWalk(const PlaneUpdateWalker & /*walker*/)
+{
+  return true;
+}
+
+
+/// Query whether the existing heightmap column for @p walk_key must be cleared before writing the walk result.
+/// @param walker The class used to walk the heightmap region.
+/// @param walk_key The current walk key.
+/// @return True if the heightmap column should be cleared. Only an update walk may return true.
+template <typename Walker>
+inline bool resetColumn(Walker & /*walker*/, const Key & /*walk_key*/)
+{
+  return false;
+}
+
+
+/// @overload
+inline bool resetColumn(PlaneUpdateWalker &walker, const Key &walk_key)
+{
+  return walker.resetColumn(walk_key);
+}
+
+
+/// Calculate the source map key extents to walk when generating a heightmap.
+/// @param src_map The source occupancy map.
+/// @param src_region The spatial extents of @p src_map . See @c OccupancyMap::calculateExtents() .
+/// @param cull_to Limits the extents along each axis for which the @p cull_to extents are non-zero.
+/// @param[out] min_ext_key Set to the minimum key to walk.
+/// @param[out] max_ext_key Set to the maximum key to walk.
+void calculateWalkExtents(const OccupancyMap &src_map, ohm::Aabb src_region, const ohm::Aabb &cull_to,
+                          Key *min_ext_key, Key *max_ext_key)
+{
+  // Clip to the cull box.
+  for (int i = 0; i < 3; ++i)
+  {
+    if (cull_to.diagonal()[i] > 0)
+    {
+      src_region.minExtentsMutable()[i] = cull_to.minExtents()[i];
+      src_region.maxExtentsMutable()[i] = cull_to.maxExtents()[i];
+    }
+  }
+
+  // Generate keys for these extents.
+  *min_ext_key = src_map.voxelKey(src_region.minExtents());
+  *max_ext_key = src_map.voxelKey(src_region.maxExtents());
+}
+
+
+/// Resolve the heightmap key for the column containing the source map @p src_key . Only valid for a non-layered
+/// heightmap.
+/// @param imp Heightmap implementation.
+/// @param src_key A key in the source occupancy map.
+/// @return The heightmap key for the column containing @p src_key .
+Key heightmapColumnKey(const HeightmapDetail &imp, const Key &src_key)
+{
+  glm::dvec3 column_pos = imp.occupancy_map->voxelCentreGlobal(src_key);
+  column_pos[imp.vertical_axis_index] = 0;
+  Key hm_key = imp.heightmap->voxelKey(column_pos);
+  return project(&hm_key, imp.vertical_axis_index);
+}
+
+
+/// Clear the heightmap result for the column containing the source map @p src_key . Used to remove stale results when
+/// updating a heightmap.
+/// @param imp Heightmap implementation.
+/// @param src_key A key in the source occupancy map.
+void clearHeightmapColumn(HeightmapDetail &imp, const Key &src_key)
+{
+  const Key hm_key = heightmapColumnKey(imp, src_key);
+  if (!imp.heightmap->region(hm_key.regionKey()))
+  {
+    // Nothing to clear.
+    return;
+  }
+
+  Voxel<float> occupancy(imp.heightmap.get(), imp.heightmap->layout().occupancyLayer(), hm_key);
+  Voxel<HeightmapVoxel> heightmap_voxel(imp.heightmap.get(), imp.heightmap_voxel_layer, hm_key);
+  if (occupancy.isValid() && occupancy.data() != ohm::unobservedOccupancyValue())
+  {
+    occupancy.write(ohm::unobservedOccupancyValue());
+    if (heightmap_voxel.isValid())
+    {
+      heightmap_voxel.write(HeightmapVoxel{});
+    }
+  }
+}
 }  // namespace heightmap
 
 
@@ -152,9 +276,29 @@ Heightmap::Heightmap(double grid_resolution, double min_clearance, UpAxis up_axi
 Heightmap::~Heightmap() = default;
 
 
+bool Heightmap::setThreadCount(unsigned thread_count)
+{
+#ifdef OHM_THREADS
+  imp_->thread_count = thread_count;
+  return true;
+#else   // OHM_THREADS
+  (void)thread_count;
+  imp_->thread_count = 1;
+  return false;
+#endif  // OHM_THREADS
+}
+
+
+unsigned Heightmap::threadCount() const
+{
+  return imp_->thread_count;
+}
+
+
 void Heightmap::setOccupancyMap(const OccupancyMap *map)
 {
   imp_->occupancy_map = map;
+  imp_->source_extents_valid = false;
 }
 
 
@@ -347,22 +491,11 @@ bool Heightmap::buildHeightmap(const glm::dvec3 &reference_pos, const ohm::Aabb
   // 2. Populate heightmap voxels
 
   const OccupancyMap &src_map = *imp_->occupancy_map;
-  ohm::Aabb src_region;
-  src_map.calculateExtents(&src_region.minExtentsMutable(), &src_region.maxExtentsMutable());
-
-  // Clip to the cull box.
-  for (int i = 0; i < 3; ++i)
-  {
-    if (cull_to.diagonal()[i] > 0)
-    {
-      src_region.minExtentsMutable()[i] = cull_to.minExtents()[i];
-      src_region.maxExtentsMutable()[i] = cull_to.maxExtents()[i];
-    }
-  }
-
-  // Generate keys for these extents.
-  const Key min_ext_key = src_map.voxelKey(src_region.minExtents());
-  const Key max_ext_key = src_map.voxelKey(src_region.maxExtents());
+  src_map.calculateExtents(&imp_->source_extents.minExtentsMutable(), &imp_->source_extents.maxExtentsMutable());
+  imp_->source_extents_valid = true;
+  Key min_ext_key;
+  Key max_ext_key;
+  heightmap::calculateWalkExtents(src_map, imp_->source_extents, cull_to, &min_ext_key, &max_ext_key);
 
   unsigned processed_count = 0;
   unsigned supporting_voxel_flags = !!imp_->generate_virtual_surface * heightmap::kVirtualSurfaces |
@@ -412,6 +545,128 @@ bool Heightmap::buildHeightmap(const glm::dvec3 &reference_pos, const ohm::Aabb
 }
 
 
+bool Heightmap::updateHeightmap(const glm::dvec3 &reference_pos, uint64_t from_stamp, const ohm::Aabb &cull_to)
+{
+  if (!imp_->occupancy_map)
+  {
+    return false;
+  }
+
+  // Layered heightmaps are finalised over the whole generated area and there is nothing to update in an empty
+  // heightmap. Build from scratch.
+  if (isMultiLayered() || imp_->heightmap->regionCount() == 0)
+  {
+    return buildHeightmap(reference_pos, cull_to);
+  }
+
+  PROFILE(updateHeightmap);
+
+  const OccupancyMap &src_map = *imp_->occupancy_map;
+  std::vector<std::pair<uint64_t, glm::i16vec3>> dirty_regions;
+  if (!src_map.collectDirtyRegions(from_stamp, dirty_regions))
+  {
+    // No changes.
+    return true;
+  }
+
+  // Expand the source map extents from the previous build by the dirty regions rather than visiting every region.
+  // Regions removed since the build may leave the extents larger than the map, which only widens the walk bounds.
+  if (imp_->source_extents_valid)
+  {
+    const glm::dvec3 region_half_extents = 0.5 * src_map.regionSpatialResolution();
+    for (const auto &dirty_region : dirty_regions)
+    {
+      const glm::dvec3 region_centre = src_map.regionCentreGlobal(dirty_region.second);
+      imp_->source_extents.expand(region_centre - region_half_extents);
+      imp_->source_extents.expand(region_centre + region_half_extents);
+    }
+  }
+  else
+  {
+    src_map.calculateExtents(&imp_->source_extents.minExtentsMutable(), &imp_->source_extents.maxExtentsMutable());
+    imp_->source_extents_valid = true;
+  }
+
+  Key min_ext_key;
+  Key max_ext_key;
+  heightmap::calculateWalkExtents(src_map, imp_->source_extents, cull_to, &min_ext_key, &max_ext_key);
+
+  const bool planar = imp_->mode == HeightmapMode::kPlanar;
+  const Key planar_key = src_map.voxelKey(reference_pos);
+  const auto previous_ground = [this, &src_map](const Key &key) {
+    glm::dvec3 pos;
+    const HeightmapVoxelType voxel_type = getHeightmapVoxelInfo(heightmap::heightmapColumnKey(*imp_, key), &pos);
+    return (voxel_type == HeightmapVoxelType::kSurface || voxel_type == HeightmapVoxelType::kVirtualSurface) ?
+             src_map.voxelKey(pos) :
+             Key(nullptr);
+  };
+  PlaneUpdateWalker walker(src_map, min_ext_key, max_ext_key, imp_->up_axis_id, planar ? &planar_key : nullptr,
+                           previous_ground);
+
+  // A planar heightmap only searches the band between the floor and ceiling around the reference height, plus the
+  // clearance above. Changes outside that band cannot affect the result. The fill modes move the search band with the
+  // ground height, so every change may be relevant.
+  const int axis = imp_->vertical_axis_index;
+  const double height_sign = (int(imp_->up_axis_id) >= 0) ? 1.0 : -1.0;
+  // Band limits along the vertical axis: [min, max].
+  glm::dvec2 relevant_band(-std::numeric_limits<double>::max(), std::numeric_limits<double>::max());
+  if (planar)
+  {
+    const int below_index = (height_sign > 0) ? 0 : 1;
+    if (imp_->floor > 0)
+    {
+      relevant_band[below_index] = reference_pos[axis] - height_sign * imp_->floor;
+    }
+    if (imp_->ceiling > 0)
+    {
+      relevant_band[1 - below_index] = reference_pos[axis] + height_sign * (imp_->ceiling + imp_->min_clearance);
+    }
+  }
+
+  const glm::dvec3 region_extents = src_map.regionSpatialResolution();
+  const glm::ivec3 region_dim = src_map.regionVoxelDimensions();
+  for (const auto &dirty_region : dirty_regions)
+  {
+    const glm::i16vec3 &region_key = dirty_region.second;
+    const double region_min = src_map.regionSpatialMin(region_key)[axis];
+    if (region_min > relevant_band[1] || region_min + region_extents[axis] < relevant_band[0])
+    {
+      continue;
+    }
+
+    walker.markDirty(Key(region_key, 0, 0, 0),
+                     Key(region_key, uint8_t(region_dim.x - 1), uint8_t(region_dim.y - 1), uint8_t(region_dim.z - 1)));
+  }
+
+  // Clear the previous results for the dirty columns. Columns beyond these are cleared as the walk reaches them.
+  for (const Key &key : walker.dirtyColumns())
+  {
+    heightmap::clearHeightmapColumn(*imp_, key);
+  }
+
+  // Use the same supporting voxel flags as buildHeightmap().
+  unsigned supporting_voxel_flags = !!imp_->generate_virtual_surface * heightmap::kVirtualSurfaces |
+                                    !!imp_->promote_virtual_below * heightmap::kPromoteVirtualBelow;
+  if (planar)
+  {
+    supporting_voxel_flags |= heightmap::kIgnoreVirtualAbove;
+    buildHeightmapT(walker, reference_pos, supporting_voxel_flags, supporting_voxel_flags);
+  }
+  else
+  {
+    const unsigned initial_supporting_voxel_flags = supporting_voxel_flags;
+    supporting_voxel_flags |= heightmap::kBiasAbove;
+    buildHeightmapT(walker, reference_pos, initial_supporting_voxel_flags, supporting_voxel_flags);
+  }
+
+#if PROFILING
+  ohm::Profile::instance().report();
+#endif  // PROFILING
+
+  return true;
+}
+
+
 HeightmapVoxelType Heightmap::getHeightmapVoxelInfo(const Key &key, glm::dvec3 *pos, HeightmapVoxel *voxel_info) const
 {
   if (!key.isNull())
@@ -530,8 +785,11 @@ bool Heightmap::buildHeightmapT(KeyWalker &walker, const glm::dvec3 &reference_p
 
   updateMapInfo(heightmap.mapInfo());
 
-  // Clear previous results.
-  heightmap.clear();
+  // Clear previous results unless updating. An update walk clears the affected columns as it goes.
+  if (!heightmap::isUpdateWalk(walker))
+  {
+    heightmap.clear();
+  }
 
   // Encode the base height of the heightmap in the origin.
   // heightmap.setOrigin(upAxisNormal() * glm::dot(upAxisNormal(), reference_pos));
@@ -568,7 +826,7 @@ bool Heightmap::buildHeightmapT(KeyWalker &walker, const glm::dvec3 &reference_p
   const int clearance_voxel_count_permissive =
     std::max(1, ohm::pointToRegionCoord(imp_->min_clearance, src_map.resolution()) - 1);
 
-  heightmap::SrcVoxel src_voxel(src_map, use_voxel_mean);
+  heightmap::SrcVoxel src_voxel(src_map, use_voxel_mean, upAxisIndex(), walker.minKey(), walker.maxKey());
   heightmap::DstVoxel hm_voxel(heightmap, imp_->heightmap_voxel_layer, use_voxel_mean);
   // Track generated extents. Seed with zero keys and correct dimensions.
   KeyRange dst_range_2d(Key(0), Key(0), heightmap.regionVoxelDimensions());
@@ -585,6 +843,40 @@ bool Heightmap::buildHeightmapT(KeyWalker &walker, const glm::dvec3 &reference_p
   std::unordered_map<ohm::Key, heightmap::HeightmapKeyType> src_to_heightmap_keys;
   const bool ordered_layers = areLayersSorted();  // True to sort multi-layered configurations.
   bool abort = false;
+
+  // Search the column for a walk key: find the nearest supporting voxel then the ground voxel above it.
+  const auto search_column = [&](heightmap::SrcVoxel &voxel, heightmap::ColumnSearch &search, unsigned flags) {
+    search.candidate_key = heightmap::findNearestSupportingVoxel(voxel, search.walk_key, upAxis(), walker.minKey(),
+                                                                 walker.maxKey(), voxel_floor, voxel_ceiling,
+                                                                 clearance_voxel_count_permissive, flags);
+    search.ground.invalidate();
+    if (!search.candidate_key.isNull())
+    {
+      findGround(search.ground, voxel, search.candidate_key, walker.minKey(), walker.maxKey(), *imp_);
+    }
+  };
+
+  // The column searches are the dominant cost and only read the source map. With multiple threads we search the
+  // columns for the upcoming walk keys in parallel, then consume the results in walk order. Walk keys are fixed once
+  // queued, so this yields exactly the serial result. Only the first (seed) iteration uses the initial flags, so
+  // lookahead starts from the second iteration.
+  std::vector<heightmap::ColumnSearch> lookahead;
+  size_t lookahead_next = 0;
+#ifdef OHM_THREADS
+  std::vector<Key> lookahead_keys;
+  std::unique_ptr<tbb::task_arena> arena;
+  std::unique_ptr<tbb::enumerable_thread_specific<heightmap::SrcVoxel>> thread_src_voxels;
+  if (imp_->thread_count != 1)
+  {
+    arena = std::make_unique<tbb::task_arena>(imp_->thread_count ? int(imp_->thread_count) :
+                                                                   int(tbb::task_arena::automatic));
+    thread_src_voxels =
+      std::make_unique<tbb::enumerable_thread_specific<heightmap::SrcVoxel>>(
+        std::cref(src_map), use_voxel_mean, upAxisIndex(), walker.minKey(), walker.maxKey());
+  }
+#endif  // OHM_THREADS
+  bool first_iteration = true;
+
   do
   {
 #if HM_DEBUG_VOXEL
@@ -605,17 +897,52 @@ bool Heightmap::buildHeightmapT(KeyWalker &walker, const glm::dvec3 &reference_p
     // This is key closest to the walk_key which could be ground. This will be either an occupied voxel, or virtual
     // ground voxel.
     // Virtual ground is where a free is supported by an uncertain or null voxel below it.
-    Key candidate_key = heightmap::findNearestSupportingVoxel(src_voxel, walk_key, upAxis(), walker.minKey(),
-                                                              walker.maxKey(), voxel_floor, voxel_ceiling,
-                                                              clearance_voxel_count_permissive, supporting_voxel_flags);
-
-    // Walk the column of candidate_key to find the first occupied voxel with sufficent clearance. A virtual voxel
+    //
+    // Then walk the column of candidate_key to find the first occupied voxel with sufficent clearance. A virtual voxel
     // with sufficient clearance may be given if there is no valid occupied voxel.
-    heightmap::GroundCandidate ground;
-    if (!candidate_key.isNull())
+    heightmap::ColumnSearch column;
+    if (lookahead_next < lookahead.size() && lookahead[lookahead_next].walk_key == walk_key)
+    {
+      column = lookahead[lookahead_next++];
+    }
+    else
     {
-      findGround(ground, src_voxel, candidate_key, walker.minKey(), walker.maxKey(), *imp_);
+      lookahead.clear();
+      lookahead_next = 0;
+      column.walk_key = walk_key;
+#ifdef OHM_THREADS
+      if (arena && !first_iteration)
+      {
+        lookahead_keys.resize(heightmap::kColumnLookahead);
+        lookahead_keys[0] = walk_key;
+        const size_t key_count =
+          1 + walker.peek(walk_key, lookahead_keys.data() + 1, lookahead_keys.size() - 1);
+        if (key_count >= heightmap::kMinParallelColumns)
+        {
+          lookahead.resize(key_count);
+          arena->execute([&]() {
+            tbb::parallel_for(tbb::blocked_range<size_t>(0u, key_count), [&](const tbb::blocked_range<size_t> &range) {
+              heightmap::SrcVoxel &voxel = thread_src_voxels->local();
+              for (size_t i = range.begin(); i != range.end(); ++i)
+              {
+                lookahead[i].walk_key = lookahead_keys[i];
+                search_column(voxel, lookahead[i], iterating_supporting_flags);
+              }
+            });
+          });
+          column = lookahead[lookahead_next++];
+        }
+      }
+#endif  // OHM_THREADS
+      if (lookahead.empty())
+      {
+        search_column(src_voxel, column, supporting_voxel_flags);
+      }
     }
+    first_iteration = false;
+
+    const Key &candidate_key = column.candidate_key;
+    const heightmap::GroundCandidate &ground = column.ground;
     const Key ground_key = (ground.isValid()) ? ground.key : walk_key;
 
     // Mark whether this voxel may be a base layer candidate. This is always true for non-layered heightmaps.
@@ -625,6 +952,12 @@ bool Heightmap::buildHeightmapT(KeyWalker &walker, const glm::dvec3 &reference_p
 
     heightmap::onVisitWalker(walker, *imp_, walk_key, candidate_key, ground_key);
 
+    // Clear any stale result when updating a column outside the dirty area.
+    if (heightmap::resetColumn(walker, walk_key))
+    {
+      heightmap::clearHeightmapColumn(*imp_, walk_key);
+    }
+
     // Write to the heightmap.
     src_voxel.setKey(ground_key);
     src_voxel.syncKey();
@@ -20,6 +20,7 @@
 
 #include <glm/fwd.hpp>
 
+#include <cstdint>
 #include <functional>
 #include <set>
 #include <vector>
@@ -138,7 +139,8 @@ public:
   /// Setting the @p thread_count to zero enables multi-threading using the maximum number of threads. Setting the
   /// @p thread_count to 1 disables threads (default).
   ///
-  /// Using multiple threads may not yield significant gains.
+  /// When threaded, the source map column searches for upcoming walk keys are performed in parallel, while the walk
+  /// and heightmap population remain serial. The resulting heightmap is identical to the single threaded result.
   ///
   /// @param thread_count The number of threads to set.
   /// @return True if mult-threading is available. False when no mult-threading is available and @p thread_count is
@@ -341,6 +343,29 @@ public:
   /// @return true on success.
   bool buildHeightmap(const glm::dvec3 &reference_pos, const ohm::Aabb &cull_to = ohm::Aabb(0.0));
 
+  /// Incrementally update the heightmap for changes in the source map since @p from_stamp .
+  ///
+  /// This collects the source map regions changed since @p from_stamp - see @c OccupancyMap::collectDirtyRegions() -
+  /// and regenerates only the heightmap columns covered by those regions. A planar heightmap also ignores changes
+  /// outside the floor/ceiling band, which is extended by the clearance height. A fill heightmap is reseeded from the
+  /// existing surface around the changed columns and the fill only spreads past the changed columns where the surface
+  /// found differs from the existing result. The cost scales with the changed area rather than the heightmap extents.
+  ///
+  /// The update assumes the heightmap was previously generated from the same source map with the same settings,
+  /// @p reference_pos and @p cull_to . The result generally matches @c buildHeightmap() , but a fill update may
+  /// differ in areas where the fill order affects the surface selected. Call @c buildHeightmap() periodically, or
+  /// whenever the settings change, to rebuild the full heightmap.
+  ///
+  /// Layered heightmaps are finalised over the whole heightmap and are not supported. This falls back to
+  /// @c buildHeightmap() for layered modes and when the heightmap is empty.
+  ///
+  /// @param reference_pos The staring position to build the heightmap around. Nominally a vehicle or sensor position.
+  /// @param from_stamp The source @c OccupancyMap::stamp() value from the previous build or update.
+  /// @param cull_to Build the heightmap only from within these extents in the source map.
+  /// @return True on success, false if there is no source map.
+  bool updateHeightmap(const glm::dvec3 &reference_pos, uint64_t from_stamp,
+                       const ohm::Aabb &cull_to = ohm::Aabb(0.0));
+
   /// Query the information about a voxel in the @c heightmap() occupancy map.
   ///
   /// Heightmap voxel values, positions and semantics are specialised from the general @c OccupancyMap usage. This
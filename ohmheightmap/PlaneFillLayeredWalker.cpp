@@ -65,6 +65,14 @@ bool PlaneFillLayeredWalker::walkNext(Key &key)
 }
 
 
+size_t PlaneFillLayeredWalker::peek(const Key & /*key*/, Key *keys, size_t max_count) const
+{
+  const size_t count = std::min(max_count, open_list_.size());
+  std::copy(open_list_.begin(), open_list_.begin() + count, keys);
+  return count;
+}
+
+
 size_t PlaneFillLayeredWalker::visit(const Key &key, PlaneWalkVisitMode mode, std::array<Key, 8> &added_neighbours)
 {
   size_t added = 0;
@@ -62,6 +62,24 @@ bool PlaneFillWalker::walkNext(Key &key)
 }
 
 
+size_t PlaneFillWalker::peek(const Key & /*key*/, Key *keys, size_t max_count) const
+{
+  if (!glm::all(glm::greaterThan(key_range, glm::ivec3(0))))
+  {
+    return 0;
+  }
+
+  // Mirror the clamping in walkNext().
+  const size_t count = std::min(max_count, open_list_.size());
+  for (size_t i = 0; i < count; ++i)
+  {
+    keys[i] = open_list_[i];
+    keys[i].clampTo(min_ext_key, max_ext_key);
+  }
+  return count;
+}
+
+
 size_t PlaneFillWalker::visit(const Key &key, PlaneWalkVisitMode mode, std::array<Key, 8> &added_neighbours)
 {
   size_t added = 0;
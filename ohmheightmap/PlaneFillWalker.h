@@ -112,6 +112,14 @@ public:
   /// @return True if the key is valid, false if walking is complete.
   bool walkNext(Key &key);
 
+  /// Query the keys which following calls to @c walkNext() will yield without affecting the walk. Calls to @c visit()
+  /// only append to the open list, so these keys remain valid until yielded.
+  /// @param key The current key. Unused, but present for compatibility with @c PlaneWalker .
+  /// @param[out] keys Array to write the upcoming keys to.
+  /// @param max_count Maximum number of @p keys to write.
+  /// @return The number of @p keys written.
+  size_t peek(const Key &key, Key *keys, size_t max_count) const;
+
   /// Call this function when visiting a voxel at the given @p key. The keys neighbouring @p key (on the walk plane)
   /// are added to the open list, provided they are not already on the open list. The added neighbouring keys are
   /// filled in @p neighbours with the number of neighbours added given in the return value.
@@ -0,0 +1,312 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "PlaneUpdateWalker.h"
+
+#include "HeightmapUtil.h"
+
+#include <ohm/OccupancyMap.h>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace ohm
+{
+PlaneUpdateWalker::PlaneUpdateWalker(const OccupancyMap &map, const Key &min_ext_key, const Key &max_ext_key,
+                                     UpAxis up_axis, const Key *plane_key_ptr, GroundLookup previous_ground)
+  : map(map)
+  , min_ext_key(min_ext_key)
+  , max_ext_key(max_ext_key)
+  , key_range(map.rangeBetween(min_ext_key, max_ext_key) + glm::ivec3(1, 1, 1))
+  , axis_indices(ohm::heightmap::heightmapAxisIndices(up_axis))
+  , plane_key_(plane_key_ptr ? *plane_key_ptr : min_ext_key)
+  , reference_key_(min_ext_key)
+  , planar_(plane_key_ptr != nullptr)
+  , previous_ground_(std::move(previous_ground))
+{
+  plane_key_.clampToAxis(axis_indices[2], min_ext_key, max_ext_key);
+}
+
+
+void PlaneUpdateWalker::markDirty(Key min_key, Key max_key)
+{
+  if (!glm::all(glm::greaterThan(key_range, glm::ivec3(0))))
+  {
+    return;
+  }
+
+  min_key.clampTo(min_ext_key, max_ext_key);
+  max_key.clampTo(min_ext_key, max_ext_key);
+  const glm::ivec3 range = map.rangeBetween(min_key, max_key);
+
+  for (int row = 0; row <= range[axis_indices[1]]; ++row)
+  {
+    Key key = min_key;
+    map.moveKeyAlongAxis(key, axis_indices[1], row);
+    for (int col = 0; col <= range[axis_indices[0]]; ++col)
+    {
+      const unsigned grid_index = gridIndex(key);
+      if (grid_index != ~0u)
+      {
+        Column &column = columns_[grid_index];
+        if (!column.dirty)
+        {
+          column.dirty = true;
+          dirty_columns_.emplace_back(key);
+        }
+      }
+      map.moveKeyAlongAxis(key, axis_indices[0], 1);
+    }
+  }
+}
+
+
+bool PlaneUpdateWalker::begin(Key &key)
+{
+  open_list_.clear();
+  next_unwalked_ = 0;
+
+  if (!glm::all(glm::greaterThan(key_range, glm::ivec3(0))))
+  {
+    // Key out of range.
+    return false;
+  }
+
+  if (planar_)
+  {
+    // Walk each dirty column at the plane height.
+    for (Key column_key : dirty_columns_)
+    {
+      column_key.setRegionAxis(axis_indices[2], plane_key_.regionKey()[axis_indices[2]]);
+      column_key.setLocalAxis(axis_indices[2], plane_key_.localKey()[axis_indices[2]]);
+      open_list_.emplace_back(column_key);
+    }
+  }
+  else
+  {
+    // Start with the reference key if it has changed.
+    key.clampTo(min_ext_key, max_ext_key);
+    reference_key_ = key;
+    const auto ref_column = columns_.find(gridIndex(key));
+    if (ref_column != columns_.end() && ref_column->second.dirty)
+    {
+      push(key);
+    }
+
+    // Seed from the existing ground in the clean columns around the dirty columns.
+    for (const Key &dirty_key : dirty_columns_)
+    {
+      for (int row_delta = -1; row_delta <= 1; ++row_delta)
+      {
+        for (int col_delta = -1; col_delta <= 1; ++col_delta)
+        {
+          Key n_key = dirty_key;
+          map.moveKeyAlongAxis(n_key, axis_indices[1], row_delta);
+          map.moveKeyAlongAxis(n_key, axis_indices[0], col_delta);
+          const unsigned n_grid_index = gridIndex(n_key);
+          if (n_grid_index == ~0u)
+          {
+            continue;
+          }
+
+          Column &column = columns_[n_grid_index];
+          if (column.dirty || column.seed)
+          {
+            continue;
+          }
+
+          Key ground_key = (previous_ground_) ? previous_ground_(n_key) : Key(nullptr);
+          if (!ground_key.isNull())
+          {
+            column.seed = true;
+            ground_key.clampTo(min_ext_key, max_ext_key);
+            push(ground_key);
+          }
+        }
+      }
+    }
+  }
+
+  return walkNext(key);
+}
+
+
+bool PlaneUpdateWalker::walkNext(Key &key)
+{
+  if (open_list_.empty() && (planar_ || !seedUnwalkedColumn()))
+  {
+    return false;
+  }
+
+  key = open_list_.front();
+  open_list_.pop_front();
+  key.clampTo(min_ext_key, max_ext_key);
+  if (!planar_)
+  {
+    const unsigned grid_index = gridIndex(key);
+    if (grid_index != ~0u)
+    {
+      columns_[grid_index].height = keyHeight(key);
+    }
+  }
+  return true;
+}
+
+
+size_t PlaneUpdateWalker::peek(const Key & /*key*/, Key *keys, size_t max_count) const
+{
+  // Mirror the clamping in walkNext().
+  const size_t count = std::min(max_count, open_list_.size());
+  for (size_t i = 0; i < count; ++i)
+  {
+    keys[i] = open_list_[i];
+    keys[i].clampTo(min_ext_key, max_ext_key);
+  }
+  return count;
+}
+
+
+size_t PlaneUpdateWalker::visit(const Key &key, PlaneWalkVisitMode mode, std::array<Key, 8> &added_neighbours)
+{
+  size_t added = 0;
+
+  if (planar_ || mode == PlaneWalkVisitMode::kIgnoreNeighbours)
+  {
+    return added;
+  }
+
+  const unsigned grid_index = gridIndex(key);
+  if (grid_index == ~0u)
+  {
+    return added;
+  }
+
+  const Column &column = columns_[grid_index];
+  if (!column.dirty && !column.seed)
+  {
+    // Clean column. Stop expanding if the surface is unchanged.
+    const Key previous_ground = (previous_ground_) ? previous_ground_(key) : Key(nullptr);
+    const bool unchanged = (mode == PlaneWalkVisitMode::kAddUnvisitedColumnNeighbours) ? previous_ground.isNull() :
+                                                                                         previous_ground == key;
+    if (unchanged)
+    {
+      return added;
+    }
+  }
+
+  for (int row_delta = -1; row_delta <= 1; ++row_delta)
+  {
+    for (int col_delta = -1; col_delta <= 1; ++col_delta)
+    {
+      if (row_delta == 0 && col_delta == 0)
+      {
+        // Skip over the self reference.
+        continue;
+      }
+
+      Key n_key = key;
+      map.moveKeyAlongAxis(n_key, axis_indices[1], row_delta);
+      map.moveKeyAlongAxis(n_key, axis_indices[0], col_delta);
+
+      if (push(n_key))
+      {
+        assert(added < added_neighbours.size());
+        added_neighbours[added] = n_key;
+        ++added;
+      }
+    }
+  }
+
+  return added;
+}
+
+
+bool PlaneUpdateWalker::resetColumn(const Key &key)
+{
+  const unsigned grid_index = gridIndex(key);
+  if (grid_index == ~0u)
+  {
+    return false;
+  }
+
+  Column &column = columns_[grid_index];
+  if (column.dirty || column.reset)
+  {
+    return false;
+  }
+
+  column.reset = true;
+  return true;
+}
+
+
+unsigned PlaneUpdateWalker::gridIndex(const Key &key) const
+{
+  // Get the offset for the key.
+  const auto offset_to_key = map.rangeBetween(min_ext_key, key);
+
+  if (offset_to_key[axis_indices[0]] >= 0 && offset_to_key[axis_indices[1]] >= 0 &&
+      offset_to_key[axis_indices[0]] < key_range[axis_indices[0]] &&
+      offset_to_key[axis_indices[1]] < key_range[axis_indices[1]])
+  {
+    return unsigned(offset_to_key[axis_indices[0]]) +
+           unsigned(offset_to_key[axis_indices[1]]) * unsigned(key_range[axis_indices[0]]);
+  }
+
+  // Key out of range.
+  return ~0u;
+}
+
+
+int PlaneUpdateWalker::keyHeight(const Key &key) const
+{
+  return map.rangeBetween(min_ext_key, key)[axis_indices[2]];
+}
+
+
+bool PlaneUpdateWalker::seedUnwalkedColumn()
+{
+  // Columns are only ever added, so the search resumes from the last seeded column.
+  for (; next_unwalked_ < dirty_columns_.size(); ++next_unwalked_)
+  {
+    Key column_key = dirty_columns_[next_unwalked_];
+    if (columns_[gridIndex(column_key)].height >= 0)
+    {
+      // Already reached by the fill.
+      continue;
+    }
+
+    column_key.setRegionAxis(axis_indices[2], reference_key_.regionKey()[axis_indices[2]]);
+    column_key.setLocalAxis(axis_indices[2], reference_key_.localKey()[axis_indices[2]]);
+    push(column_key);
+    ++next_unwalked_;
+    return true;
+  }
+
+  return false;
+}
+
+
+bool PlaneUpdateWalker::push(const Key &key)
+{
+  const unsigned grid_index = gridIndex(key);
+  if (grid_index == ~0u)
+  {
+    return false;
+  }
+
+  Column &column = columns_[grid_index];
+  const int height = keyHeight(key);
+  if (column.height < 0 || height < column.height)
+  {
+    column.height = height;
+    open_list_.emplace_back(key);
+    return true;
+  }
+
+  return false;
+}
+}  // namespace ohm
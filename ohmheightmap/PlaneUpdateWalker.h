@@ -0,0 +1,161 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef OHMHEIGHTMAP_PLANEUPDATEWALKER_H
+#define OHMHEIGHTMAP_PLANEUPDATEWALKER_H
+
+#include "OhmHeightmapConfig.h"
+
+#include "PlaneWalkVisitMode.h"
+#include "UpAxis.h"
+
+#include <ohm/Key.h>
+
+#include <glm/vec3.hpp>
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace ohm
+{
+class OccupancyMap;
+
+/// Helper class for walking the columns of an existing heightmap which need to be updated after changes to the source
+/// map. Used by @c Heightmap::updateHeightmap() .
+///
+/// The walker is initialised with the set of dirty columns via @c markDirty() . The walk then depends on whether a
+/// @c plane_key is given:
+/// - With a @c plane_key , only the dirty columns are walked at the plane height. This matches a @c PlaneWalker where
+///   each column is independent.
+/// - Without a @c plane_key , the walk matches a @c PlaneFillWalker , but is seeded from the existing heightmap ground
+///   around the boundary of the dirty columns. The fill only expands beyond the dirty columns where the ground found
+///   for a column differs from the ground previously recorded in the heightmap for that column. That is, the flood
+///   connectivity is only re-evaluated where the surface has changed. Dirty columns which the fill does not reach,
+///   such as those surrounded by columns with no recorded surface, are seeded at the reference height once the fill
+///   completes, so every dirty column is walked.
+///
+/// The walker only tracks columns which are marked or walked, so the cost scales with the updated area rather than the
+/// extents of the map.
+///
+/// Usage is as for @c PlaneFillWalker with the following additions:
+/// - Call @c markDirty() for each changed area before calling @c begin() .
+/// - Call @c resetColumn() after @c visit() to query whether the heightmap result for a non-dirty column must be
+///   cleared before it is rewritten. The caller is expected to clear the dirty columns before the walk.
+class ohmheightmap_API PlaneUpdateWalker
+{
+public:
+  /// Function signature used to look up the source map ground key previously recorded in the heightmap for the column
+  /// containing the given key. Must return a null key when there is no surface recorded for the column.
+  using GroundLookup = std::function<Key(const Key &)>;
+
+  const OccupancyMap &map;     ///< Map to walk voxels in.
+  const Key min_ext_key;       ///< The starting voxel key (inclusive).
+  const Key max_ext_key;       ///< The last voxel key (inclusive).
+  const glm::ivec3 key_range;  ///< The range between @c min_ext_key and @c max_ext_key .
+  /// Mapping of the indices to walk, supporting various heightmap up axes. Element 2 is always the up axis, where
+  /// elements 0 and 1 are the horizontal axes.
+  const std::array<int, 3> axis_indices;
+
+  /// Constructor.
+  /// @param map The map to walk voxels in.
+  /// @param min_ext_key The starting voxel key (inclusive).
+  /// @param max_ext_key The last voxel key (inclusive).
+  /// @param up_axis Specifies the up axis for the map.
+  /// @param plane_key_ptr Optional key specifying the plane height for a planar update. Null for a fill update.
+  /// @param previous_ground Ground lookup for the existing heightmap. Required for a fill update.
+  PlaneUpdateWalker(const OccupancyMap &map, const Key &min_ext_key, const Key &max_ext_key, UpAxis up_axis,
+                    const Key *plane_key_ptr = nullptr, GroundLookup previous_ground = GroundLookup());
+
+  /// Query the minimum key value to walk from.
+  /// @return The mimimum key value.
+  inline const Key &minKey() const { return min_ext_key; }
+  /// Query the maximum key value to walk to.
+  /// @return The maximum key value.
+  inline const Key &maxKey() const { return max_ext_key; }
+
+  /// Mark the columns between @p min_key and @p max_key as dirty. Only the planar axes are considered and the range
+  /// is clamped to the walk extents.
+  /// @param min_key The minimum key of the dirty range (inclusive).
+  /// @param max_key The maximum key of the dirty range (inclusive).
+  void markDirty(Key min_key, Key max_key);
+
+  /// Query the dirty columns added via @c markDirty() . The key heights are undefined.
+  /// @return The dirty column keys.
+  inline const std::vector<Key> &dirtyColumns() const { return dirty_columns_; }
+
+  /// Initialise @p key To the first voxel to walk.
+  /// @param[in,out] key The reference key. For a fill update, this is walked first if it is in a dirty column. Set to
+  /// the first key to be walked.
+  /// @return True if the key is valid, false if there is nothing to walk.
+  bool begin(Key &key);
+
+  /// Walk the next key in the sequence.
+  /// @param[in,out] key Modifies to be the next key to be walked.
+  /// @return True if the key is valid, false if walking is complete.
+  bool walkNext(Key &key);
+
+  /// Query the keys which following calls to @c walkNext() will yield without affecting the walk.
+  /// @param key The current key. Unused, but present for compatibility with @c PlaneWalker .
+  /// @param[out] keys Array to write the upcoming keys to.
+  /// @param max_count Maximum number of @p keys to write.
+  /// @return The number of @p keys written.
+  size_t peek(const Key &key, Key *keys, size_t max_count) const;
+
+  /// Call this function when visiting a voxel at the given @p key. For a fill update, the neighbours of @p key are
+  /// added to the open list as for @c PlaneFillWalker::visit() unless @p key lies outside the dirty columns and
+  /// matches the ground previously recorded in the heightmap. Nothing is added for a planar update.
+  /// @param key The key being visited. Must fall within the @c range.minKey() and @c range.maxKey() bounds.
+  /// @param neighbours Populated with any neighbours of @p key added to the open list.
+  /// @param mode Affects how to expand neighbours when visiting the voxel at @p key.
+  /// @return The number of neighbours added.
+  size_t visit(const Key &key, PlaneWalkVisitMode mode, std::array<Key, 8> &neighbours);
+  /// @overload
+  inline size_t visit(const Key &key, PlaneWalkVisitMode mode)
+  {
+    std::array<Key, 8> discard_neighbours;
+    return visit(key, mode, discard_neighbours);
+  }
+
+  /// Query whether the existing heightmap result for the column containing @p key must be cleared before writing a
+  /// new result. This is true the first time a column outside the dirty columns is walked.
+  /// @param key The key being walked.
+  /// @return True if the column should be cleared.
+  bool resetColumn(const Key &key);
+
+private:
+  /// Tracking data for a walked or dirty column.
+  struct Column
+  {
+    /// Height at which the column has been added to the open list. Negative when not added.
+    int height = -1;
+    bool dirty = false;  ///< Column is in the dirty set.
+    bool seed = false;   ///< Column seeds the walk from the existing heightmap.
+    bool reset = false;  ///< Column has been reset for a new result.
+  };
+
+  unsigned gridIndex(const Key &key) const;
+  /// Query the Visit entry height for @p key.
+  int keyHeight(const Key &key) const;
+  /// Push @p key to the open list if the column has not been added at a lower height.
+  bool push(const Key &key);
+  /// Seed the fill from the next dirty column which has not been added to the open list.
+  /// @return True if a column was seeded.
+  bool seedUnwalkedColumn();
+
+  Key plane_key_;
+  Key reference_key_;  ///< Reference key given to @c begin() , used to seed unwalked dirty columns.
+  size_t next_unwalked_ = 0;  ///< Index of the next @c dirty_columns_ entry to check for @c seedUnwalkedColumn() .
+  bool planar_ = false;
+  GroundLookup previous_ground_;
+  std::deque<Key> open_list_;  ///< Remaining voxels to (re)process.
+  std::unordered_map<unsigned, Column> columns_;
+  std::vector<Key> dirty_columns_;
+};
+}  // namespace ohm
+
+#endif  // OHMHEIGHTMAP_PLANEUPDATEWALKER_H
@@ -50,4 +50,16 @@ bool PlaneWalker::walkNext(Key &key) const
 
   return true;
 }
+
+
+size_t PlaneWalker::peek(const Key &key, Key *keys, size_t max_count) const
+{
+  Key next_key = key;
+  size_t count = 0;
+  while (count < max_count && walkNext(next_key))
+  {
+    keys[count++] = next_key;
+  }
+  return count;
+}
 }  // namespace ohm
@@ -64,6 +64,13 @@ public:
   /// @return True if the key is valid, false if walking is complete.
   bool walkNext(Key &key) const;
 
+  /// Query the keys which following calls to @c walkNext() will yield without affecting the walk.
+  /// @param key The current key, as last set by @c begin() or @c walkNext() .
+  /// @param[out] keys Array to write the upcoming keys to.
+  /// @param max_count Maximum number of @p keys to write.
+  /// @return The number of @p keys written.
+  size_t peek(const Key &key, Key *keys, size_t max_count) const;
+
   /// For API compatibility. Does nothing.
   /// @return 0
   inline size_t visit(const Key & /*key*/, PlaneWalkVisitMode /*mode*/) { return 0u; }  // NOLINT
@@ -61,6 +61,8 @@ struct ohmheightmap_API HeightmapDetail
   /// Enables post process filtering for layered heightmaps, removing virtual surface voxels with fewer 26-connected
   /// populated neighbours.
   unsigned virtual_surface_filter_threshold = 0;
+  /// Number of threads used to search source map columns. Zero for all available. See @c Heightmap::setThreadCount() .
+  unsigned thread_count = 1;
   /// Level of debugging information provided in generating the heightmap. Only has an effect if
   /// @c OHM_TES_DEBUG is configured in CMake.
   int debug_level = 0;
@@ -75,6 +77,11 @@ struct ohmheightmap_API HeightmapDetail
   /// Prefer a virtual surface below the reference position to a real surface above.
   /// @see @c Heightmap::setPromoteVirtualBelow()
   bool promote_virtual_below = false;
+  /// Source map extents calculated by the last @c Heightmap::buildHeightmap() and expanded by the regions changed in
+  /// each @c Heightmap::updateHeightmap() . Only valid when @c source_extents_valid is set.
+  Aabb source_extents = Aabb(0.0);
+  /// Set when @c source_extents matches the generated heightmap.
+  bool source_extents_valid = false;
 
   ~HeightmapDetail();
 
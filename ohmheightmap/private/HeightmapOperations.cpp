@@ -10,6 +10,8 @@
 #include "ohmheightmap/Heightmap.h"  // For TES_ENABLE
 #include "ohmheightmap/HeightmapVoxelType.h"
 
+#include <ohm/ChunkOccupancySummary.h>
+#include <ohm/MapChunk.h>
 #include <ohm/OccupancyUtil.h>
 #include <ohm/Trace.h>  // For TES_ENABLE
 
@@ -20,6 +22,8 @@
 
 #include <glm/gtc/type_ptr.hpp>  // For TES_ENABLE
 
+#include <algorithm>
+
 namespace ohm
 {
 namespace heightmap
@@ -28,6 +32,164 @@ namespace heightmap
 const uint32_t kNeighbourIdMask = 0x80000000u;
 #endif  // TES_ENABLE
 
+namespace
+{
+/// Maximum number of region columns held by a @c SrcColumnCache .
+const size_t kMaxCachedColumns = 32;
+}  // namespace
+
+
+SrcColumnCache::SrcColumnCache(const OccupancyMap &map, int up_axis_index, const Key &min_key, const Key &max_key,
+                               std::initializer_list<int> layers)
+  : map_(&map)
+  , up_axis_index_(up_axis_index)
+  , region_min_(std::min(min_key.regionKey()[up_axis_index], max_key.regionKey()[up_axis_index]))
+  , region_max_(std::max(min_key.regionKey()[up_axis_index], max_key.regionKey()[up_axis_index]))
+{
+  for (int layer : layers)
+  {
+    if (layer >= 0)
+    {
+      layers_.emplace_back(layer);
+    }
+  }
+}
+
+
+const MapChunk *SrcColumnCache::chunk(const Key &key)
+{
+  return entry(key.regionKey()).chunk;
+}
+
+
+bool SrcColumnCache::unobservedSpan(const Key &key)
+{
+  ChunkEntry &chunk_entry = entry(key.regionKey());
+  if (!chunk_entry.chunk)
+  {
+    return true;
+  }
+
+  const glm::ivec3 dim = map_->regionVoxelDimensions();
+  const int axis_a = (up_axis_index_ + 1) % 3;
+  const int axis_b = (up_axis_index_ + 2) % 3;
+
+  if (chunk_entry.observed.empty())
+  {
+    // Build the column summary for the chunk from the chunk occupancy summary.
+    chunk_entry.observed.resize(size_t(dim[axis_a]) * size_t(dim[axis_b]));
+    const ChunkOccupancySummary *summary = chunk_entry.chunk->occupancySummary();
+    if (!summary)
+    {
+      // No occupancy summary. Treat all columns as observed so nothing is skipped.
+      std::fill(chunk_entry.observed.begin(), chunk_entry.observed.end(), uint8_t(1));
+    }
+    else if (summary->totals().unobserved < summary->voxelCount())
+    {
+      const std::vector<uint64_t> &unobserved_bits = summary->unobservedBits();
+      const unsigned voxel_count = summary->voxelCount();
+      for (size_t i = 0; i < unobserved_bits.size(); ++i)
+      {
+        uint64_t observed_word = ~unobserved_bits[i];
+        while (observed_word)
+        {
+          const unsigned voxel_index = unsigned(i * 64u + ChunkOccupancySummary::lowestBit(observed_word));
+          observed_word &= observed_word - 1u;
+          if (voxel_index >= voxel_count)
+          {
+            // Padding bits in the last word.
+            break;
+          }
+          const glm::u8vec3 local_key = voxelLocalKey(voxel_index, dim);
+          chunk_entry.observed[local_key[axis_a] + local_key[axis_b] * dim[axis_a]] = 1;
+        }
+      }
+    }
+  }
+
+  const glm::u8vec3 local_key = key.localKey();
+  return !chunk_entry.observed[local_key[axis_a] + local_key[axis_b] * dim[axis_a]];
+}
+
+
+SrcColumnCache::ChunkEntry &SrcColumnCache::entry(const glm::i16vec3 &region_key)
+{
+  const int vertical_region = region_key[up_axis_index_];
+  if (vertical_region < region_min_)
+  {
+    // Extend the cached range down. Existing columns gain unresolved entries at the bottom of their stacks.
+    const size_t extension = size_t(region_min_ - vertical_region);
+    for (Column &column : columns_)
+    {
+      column.stack.insert(column.stack.begin(), extension, ChunkEntry{});
+    }
+    region_min_ = vertical_region;
+  }
+  // Extending up only moves the limit. Column stacks are resized on access.
+  region_max_ = std::max(region_max_, vertical_region);
+
+  glm::i16vec3 column_key = region_key;
+  column_key[up_axis_index_] = 0;
+
+  if (current_column_ >= columns_.size() || columns_[current_column_].region_key != column_key)
+  {
+    // Search for the column, tracking the least recently used column for eviction.
+    size_t evict_index = 0;
+    current_column_ = columns_.size();
+    for (size_t i = 0; i < columns_.size(); ++i)
+    {
+      if (columns_[i].region_key == column_key)
+      {
+        current_column_ = i;
+        break;
+      }
+      evict_index = (columns_[i].last_used < columns_[evict_index].last_used) ? i : evict_index;
+    }
+
+    if (current_column_ == columns_.size())
+    {
+      // Not cached. Start a new column, resolving its chunks as they are accessed.
+      if (columns_.size() < kMaxCachedColumns)
+      {
+        columns_.emplace_back();
+      }
+      else
+      {
+        current_column_ = evict_index;
+      }
+
+      Column &column = columns_[current_column_];
+      column.region_key = column_key;
+      column.stack.clear();
+    }
+  }
+
+  Column &column = columns_[current_column_];
+  column.last_used = ++use_marker_;
+  const size_t stack_index = size_t(vertical_region - region_min_);
+  if (stack_index >= column.stack.size())
+  {
+    column.stack.resize(size_t(region_max_ - region_min_ + 1));
+  }
+
+  ChunkEntry &chunk_entry = column.stack[stack_index];
+  if (!chunk_entry.resolved)
+  {
+    chunk_entry.resolved = true;
+    // Pin the chunk until the layers are retained. The retained layers then keep a paged chunk resident.
+    chunk_entry.chunk = map_->pinRegion(region_key);
+    if (chunk_entry.chunk)
+    {
+      for (int layer : layers_)
+      {
+        chunk_entry.buffers.emplace_back(chunk_entry.chunk->voxel_blocks[layer]);
+      }
+      chunk_entry.chunk->unpin();
+    }
+  }
+  return chunk_entry;
+}
+
 
 bool DstVoxel::haveRecordedHeight(double height, int up_axis_index, const glm::dvec3 &up) const
 {
@@ -326,6 +488,21 @@ Key findNearestSupportingVoxel2(SrcVoxel &voxel, const Key &from_key, const Key
                                -(1 + current_key.localKey()[up_axis_index]);
       i += std::abs(next_step) - 1;
     }
+    else if (unobserved && voxel.unobservedSpan())
+    {
+      // The column has no observations in this chunk. Skip to the last voxel in the chunk (or search range). The
+      // intermediate voxels are all unobserved and cannot change the virtual surface state, so this yields the same
+      // result as stepping each voxel.
+      const int skip = std::min((step > 0) ? voxel.occupancy.layerDim()[up_axis_index] - 1 -
+                                               current_key.localKey()[up_axis_index] :
+                                             int(current_key.localKey()[up_axis_index]),
+                                vertical_range - 1 - i);
+      if (skip > 0)
+      {
+        next_step = step * skip;
+        i += skip - 1;
+      }
+    }
 
     // Single step in the current region.
     voxel.map().moveKeyAlongAxis(current_key, up_axis_index, next_step);
@@ -496,6 +673,19 @@ bool findGround(GroundCandidate &ground, SrcVoxel &voxel, const Key &seed_key, c
     }
 
     last_voxel_type = voxel_type;
+
+    if ((voxel_type == ohm::kUnobserved || voxel_type == ohm::kNull) && voxel.unobservedSpan())
+    {
+      // The column has no observations in this chunk. Skip to the last voxel in the chunk (or search range) as the
+      // intermediate voxels cannot affect the result.
+      int skip = (step_dir > 0) ? voxel.occupancy.layerDim()[up_axis_index] - 1 - key.localKey()[up_axis_index] :
+                                  int(key.localKey()[up_axis_index]);
+      skip = std::min(skip, std::abs(voxel.map().rangeBetween(key, (step_dir > 0) ? max_key : min_key)[up_axis_index]));
+      if (skip > 0)
+      {
+        voxel.map().moveKeyAlongAxis(key, up_axis_index, step_dir * skip);
+      }
+    }
   }
 
   // Did we find a valid candidate?
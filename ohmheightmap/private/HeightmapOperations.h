@@ -15,13 +15,16 @@
 #include <ohm/KeyRange.h>
 #include <ohm/OccupancyMap.h>
 #include <ohm/OccupancyType.h>
+#include <ohm/VoxelBuffer.h>
 #include <ohm/VoxelData.h>
 
 #include <glm/vec3.hpp>
 
+#include <initializer_list>
 #include <iosfwd>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 namespace ohm
 {
@@ -62,6 +65,78 @@ enum SupportingVoxelFlag : unsigned
   kIgnoreVirtualAbove = (1u << 3u),
 };
 
+/// Caches the source map chunks for the region columns visited during heightmap generation.
+///
+/// The ground searches step up and down the source map columns, crossing region boundaries. Each region change would
+/// otherwise resolve and pin the chunk with @c OccupancyMap::region() and, where the @c VoxelBlock for a layer has
+/// been compressed, decompress it again. This cache resolves each chunk in a region column on first access and holds a
+/// @c VoxelBuffer for each chunk layer until the column is evicted. The region lookup and decompression are then paid
+/// once per chunk rather than on each region change. A @c Voxel bound to a cached chunk still retains and releases
+/// the layer block as it changes regions, but that is only a reference count update on a block which is already
+/// uncompressed.
+///
+/// The cache initially covers the vertical search bounds and grows to cover any region the searches step into above or
+/// below those bounds, so every lookup is cached.
+///
+/// Each cached chunk also lazily builds a 2D summary of which voxel columns contain any observed voxels from the
+/// chunk's @c ChunkOccupancySummary , allowing unobserved spans to be skipped without touching voxel memory.
+class SrcColumnCache
+{
+public:
+  /// Constructor.
+  /// @param map The source map.
+  /// @param up_axis_index Index of the vertical axis [0, 2].
+  /// @param min_key Minimum key bounding the vertical search range.
+  /// @param max_key Maximum key bounding the vertical search range.
+  /// @param layers The layers to retain for each chunk. Negative indices are ignored.
+  SrcColumnCache(const OccupancyMap &map, int up_axis_index, const Key &min_key, const Key &max_key,
+                 std::initializer_list<int> layers);
+
+  /// Resolve the cached chunk for @p key .
+  /// @param key The source map key of interest.
+  /// @return The chunk containing @p key or null if the chunk does not exist.
+  const MapChunk *chunk(const Key &key);
+
+  /// Query whether the voxel column containing @p key has no observed voxels within the chunk containing @p key . This
+  /// includes null chunks.
+  /// @param key The source map key of interest.
+  /// @return True if the column is unobserved for the extents of the chunk.
+  bool unobservedSpan(const Key &key);
+
+private:
+  /// Cached chunk entry.
+  struct ChunkEntry
+  {
+    const MapChunk *chunk = nullptr;                     ///< The chunk. May be null.
+    std::vector<VoxelBuffer<const VoxelBlock>> buffers;  ///< Retained layers for @c chunk .
+    std::vector<uint8_t> observed;  ///< Marks voxel columns with observations. Empty until summarised.
+    bool resolved = false;          ///< True once @c chunk has been looked up.
+  };
+
+  /// A cached stack of chunks in a region column.
+  struct Column
+  {
+    glm::i16vec3 region_key{ 0 };  ///< Region key for the column with the vertical component cleared.
+    std::vector<ChunkEntry> stack;  ///< Chunks in the column from @c region_min_ . May end before @c region_max_ .
+    uint64_t last_used = 0;         ///< Usage marker used to select the column to evict.
+  };
+
+  /// Resolve the cached chunk entry for @p region_key , caching the region column and resolving the chunk if required.
+  /// Extends the cached vertical range to include @p region_key .
+  /// @param region_key The region of interest.
+  /// @return The cached entry.
+  ChunkEntry &entry(const glm::i16vec3 &region_key);
+
+  const OccupancyMap *map_;
+  int up_axis_index_;
+  int region_min_;
+  int region_max_;
+  std::vector<int> layers_;
+  std::vector<Column> columns_;
+  size_t current_column_ = 0;
+  uint64_t use_marker_ = 0;
+};
+
 /// Helper structure for managing voxel data access from the source heightmap.
 struct SrcVoxel
 {
@@ -69,16 +144,29 @@ struct SrcVoxel
   Voxel<const VoxelMean> mean;              ///< Voxel mean layer (optional)
   Voxel<const CovarianceVoxel> covariance;  ///< Covariance layer used for surface normal estimation (optional)
   float occupancy_threshold;                ///< Occupancy threshold cached from the source map.
-
-  SrcVoxel(const OccupancyMap &map, bool use_voxel_mean)
+  SrcColumnCache columns;                   ///< Cached chunk access for the source map columns.
+
+  /// Constructor.
+  /// @param map The source map.
+  /// @param use_voxel_mean Use voxel mean positioning?
+  /// @param up_axis_index Index of the vertical axis [0, 2].
+  /// @param min_key Minimum key bounding the vertical search range.
+  /// @param max_key Maximum key bounding the vertical search range.
+  SrcVoxel(const OccupancyMap &map, bool use_voxel_mean, int up_axis_index, const Key &min_key, const Key &max_key)
     : occupancy(&map, map.layout().occupancyLayer())
     , mean(&map, use_voxel_mean ? map.layout().meanLayer() : -1)
     , covariance(&map, map.layout().covarianceLayer())
     , occupancy_threshold(map.occupancyThresholdValue())
+    , columns(map, up_axis_index, min_key, max_key,
+              { occupancy.layerIndex(), mean.layerIndex(), covariance.layerIndex() })
   {}
 
-  /// Set the key, but only for the occupancy layer.
-  inline void setKey(const Key &key) { occupancy.setKey(key); }
+  /// Set the key, but only for the occupancy layer. The chunk is resolved from the @c columns cache.
+  inline void setKey(const Key &key) { occupancy.setKey(key, columns.chunk(key)); }
+
+  /// Query whether the column at the current occupancy key is unobserved for the remainder of the current chunk.
+  /// @return True if the column is unobserved for the extents of the chunk.
+  inline bool unobservedSpan() { return columns.unobservedSpan(occupancy.key()); }
 
   /// Sync the key from the occupancy layer to the other layers.
   inline void syncKey()
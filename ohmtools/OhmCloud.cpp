@@ -6,6 +6,8 @@
 #include "OhmCloud.h"
 
 #include <ohm/Density.h>
+#include <ohm/ForEachRegion.h>
+#include <ohm/MapChunk.h>
 #include <ohm/OccupancyMap.h>
 #include <ohm/OccupancyType.h>
 #include <ohm/Query.h>
@@ -67,9 +69,58 @@ enum SaveWithFlags
   WithColour = (1 << 0)
 };
 
-uint64_t saveAnyCloud(const std::string &file_name, const ohm::OccupancyMap &map,
-                      std::function<bool(ExtractedVoxel &, const ohm::OccupancyMap::const_iterator &)> extract_voxel,
-                      unsigned with_flags, const ohmtools::ProgressCallback &prog)
+/// Voxel extraction function. Extracts the voxel at the given voxel index of the region into the @c ExtractedVoxel ,
+/// returning true when the voxel is to be exported.
+using ExtractVoxelFunction = std::function<bool(ExtractedVoxel &, const ohm::RegionVoxels &, unsigned)>;
+/// Creates an @c ExtractVoxelFunction . Each function created has its own voxel references so the functions may be
+/// used concurrently.
+using ExtractVoxelFactory = std::function<ExtractVoxelFunction()>;
+
+/// Number of regions to extract points from before writing them out when saving a cloud. This bounds the memory used
+/// to hold encoded points.
+const size_t kCloudRegionBatchSize = 256;
+
+/// Visit the voxels of all regions in @p map with the voxel buffers for @p layers retained, serially to preserve the
+/// output order. Reports progress after each region. Regions of a paged map are paged in and pinned one at a time.
+void visitVoxels(const ohm::OccupancyMap &map, const std::vector<int> &layers,
+                 const std::function<void(const ohm::RegionVoxels &, unsigned)> &visit,
+                 const ohmtools::ProgressCallback &prog)
+{
+  std::vector<glm::i16vec3> region_keys;
+  map.enumerateRegionKeys(region_keys);
+  std::vector<const ohm::MapChunk *> chunk(1);
+  for (size_t r = 0; r < region_keys.size(); ++r)
+  {
+    chunk[0] = map.pinRegion(region_keys[r]);
+    if (chunk[0])
+    {
+      ohm::forEachRegion(
+        map, chunk, layers,
+        [&](const ohm::RegionVoxels &region) {
+          for (unsigned i = region.begin(); i < region.end(); ++i)
+          {
+            visit(region, i);
+          }
+        },
+        1);
+      chunk[0]->unpin();
+    }
+
+    if (prog)
+    {
+      prog(r + 1, region_keys.size());
+    }
+  }
+}
+
+/// Stream a point cloud of the voxels extracted from @p map to @p file_name .
+///
+/// Regions are processed in batches of @c kCloudRegionBatchSize . Points are extracted from the regions in each batch
+/// in parallel, each region encoding its points into its own buffer, then the buffers are written in region order. The
+/// output is independent of the @p thread_count while the memory use is bounded by the batch size.
+uint64_t saveAnyCloud(const std::string &file_name, const ohm::OccupancyMap &map, const std::vector<int> &layers,
+                      const ExtractVoxelFactory &make_extract_voxel, unsigned with_flags,
+                      const ohmtools::ProgressCallback &prog, unsigned thread_count)
 {
   std::ofstream out(file_name, std::ios::binary);
 
@@ -78,44 +129,81 @@ uint64_t saveAnyCloud(const std::string &file_name, const ohm::OccupancyMap &map
     return 0;
   }
 
-  ExtractedVoxel voxel{};
-  const size_t region_count = map.regionCount();
-  size_t processed_region_count = 0;
-  glm::i16vec3 last_region = (map.regionCount() > 0) ? map.begin().key().regionKey() : glm::i16vec3(0);
-
   // Setup the Ply stream.
   ohm::PlyPointStream ply = setupPlyStream((with_flags & WithColour) != 0);
   ply.open(out);
 
-  uint64_t point_count = 0;
-  for (auto iter = map.begin(); iter != map.end(); ++iter)
+  /// Encoded points for a region.
+  struct RegionPoints
   {
-    // Progress update.
-    if (last_region != iter.key().regionKey())
+    std::vector<uint8_t> data;
+    uint64_t count = 0;
+  };
+
+  const auto extract_region = [&](const ohm::RegionVoxels &region, RegionPoints &points) {
+    const ExtractVoxelFunction extract_voxel = make_extract_voxel();
+    ohm::PlyPointStream encoder(ply.properties());
+    ExtractedVoxel voxel{};
+    for (unsigned i = region.begin(); i < region.end(); ++i)
     {
-      ++processed_region_count;
-      if (prog)
+      if (extract_voxel(voxel, region, i))
       {
-        prog(processed_region_count, region_count);
+        encoder.setPointPosition(voxel.position);
+        if (with_flags & WithColour)
+        {
+          encoder.setProperty(kPropertyRed, voxel.colour.r());
+          encoder.setProperty(kPropertyGreen, voxel.colour.g());
+          encoder.setProperty(kPropertyBlue, voxel.colour.b());
+        }
+        encoder.encodePoint(points.data);
+        ++points.count;
       }
-      last_region = iter.key().regionKey();
     }
+  };
+
+  // Enumerate keys rather than chunks so that regions of a paged map are paged in a batch at a time. The batch is
+  // pinned until written.
+  std::vector<glm::i16vec3> region_keys;
+  map.enumerateRegionKeys(region_keys);
 
-    if (extract_voxel(voxel, iter))
+  std::vector<const ohm::MapChunk *> batch;
+  std::vector<RegionPoints> region_points;
+  for (size_t batch_begin = 0; batch_begin < region_keys.size(); batch_begin += kCloudRegionBatchSize)
+  {
+    const size_t batch_end = std::min(batch_begin + kCloudRegionBatchSize, region_keys.size());
+    batch.clear();
+    for (size_t i = batch_begin; i < batch_end; ++i)
     {
-      ply.setPointPosition(voxel.position);
-      if (with_flags & WithColour)
+      if (const ohm::MapChunk *chunk = map.pinRegion(region_keys[i]))
       {
-        ply.setProperty(kPropertyRed, voxel.colour.r());
-        ply.setProperty(kPropertyGreen, voxel.colour.g());
-        ply.setProperty(kPropertyBlue, voxel.colour.b());
+        batch.emplace_back(chunk);
       }
+    }
+    region_points.resize(batch.size());
+    for (RegionPoints &points : region_points)
+    {
+      // Clear, retaining the memory for the next batch.
+      points.data.clear();
+      points.count = 0;
+    }
 
-      ply.writePoint();
-      ++point_count;
+    ohm::forEachRegion(
+      map, batch, layers,
+      [&](const ohm::RegionVoxels &region) { extract_region(region, region_points[region.regionIndex()]); },
+      thread_count);
+
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+      ply.writeEncodedPoints(region_points[i].data, region_points[i].count);
+      batch[i]->unpin();
+      if (prog)
+      {
+        prog(std::min(batch_begin + i + 1, batch_end), region_keys.size());
+      }
     }
   }
 
+  const uint64_t point_count = ply.pointCount();
   ply.close();
   out.close();
 
@@ -156,9 +244,9 @@ void addVoxel(ohm::PlyMesh &ply, const glm::dvec3 &position, double resolution,
 }  // namespace ohmtools
 
 
-uint64_t saveAnyVoxels(const std::string &file_name, const ohm::OccupancyMap &map,
-                       std::function<bool(ExtractedVoxel &, const ohm::OccupancyMap::const_iterator &)> extract_voxel,
-                       unsigned with_flags, const ohmtools::ProgressCallback &prog)
+uint64_t saveAnyVoxels(const std::string &file_name, const ohm::OccupancyMap &map, const std::vector<int> &layers,
+                       const ExtractVoxelFactory &make_extract_voxel, unsigned with_flags,
+                       const ohmtools::ProgressCallback &prog)
 {
   std::ofstream out(file_name, std::ios::binary);
 
@@ -170,33 +258,22 @@ uint64_t saveAnyVoxels(const std::string &file_name, const ohm::OccupancyMap &ma
   // Ply voxel mesh.
   ohm::PlyMesh ply;
 
+  const ExtractVoxelFunction extract_voxel = make_extract_voxel();
   ExtractedVoxel voxel{};
   const double resolution = map.resolution();
-  const size_t region_count = map.regionCount();
-  size_t processed_region_count = 0;
-  glm::i16vec3 last_region = (map.regionCount() > 0) ? map.begin().key().regionKey() : glm::i16vec3(0);
 
   uint64_t voxel_count = 0;
-  for (auto iter = map.begin(); iter != map.end(); ++iter)
-  {
-    // Progress update.
-    if (last_region != iter.key().regionKey())
-    {
-      ++processed_region_count;
-      if (prog)
+  visitVoxels(
+    map, layers,
+    [&](const ohm::RegionVoxels &region, unsigned voxel_index) {
+      if (extract_voxel(voxel, region, voxel_index))
       {
-        prog(processed_region_count, region_count);
+        const ohm::Colour c = (with_flags & WithColour) ? voxel.colour : ohm::Colour(255, 255, 255);
+        addVoxel(ply, voxel.position, resolution, c);
+        ++voxel_count;
       }
-      last_region = iter.key().regionKey();
-    }
-
-    if (extract_voxel(voxel, iter))
-    {
-      const ohm::Colour c = (with_flags & WithColour) ? voxel.colour : ohm::Colour(255, 255, 255);
-      addVoxel(ply, voxel.position, resolution, c);
-      ++voxel_count;
-    }
-  }
+    },
+    prog);
 
   if (!ply.save(out, true))
   {
@@ -209,6 +286,94 @@ uint64_t saveAnyVoxels(const std::string &file_name, const ohm::OccupancyMap &ma
 }
 
 
+/// Create the extraction functions for occupied voxels, and free voxels when @c SaveCloudOptions::export_free is set.
+ExtractVoxelFactory occupancyExtractor(const ohm::OccupancyMap &map, const ohmtools::SaveCloudOptions &opt,
+                                       const ohmtools::ColourSelect &colour_select)
+{
+  const int mean_layer = (opt.ignore_voxel_mean) ? -1 : map.layout().meanLayer();
+  const bool export_free = opt.export_free;
+  return [&map, mean_layer, export_free, colour_select]() -> ExtractVoxelFunction {
+    ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
+    ohm::Voxel<const ohm::VoxelMean> mean(&map, mean_layer);
+    return [&map, export_free, colour_select, occupancy, mean](
+             ExtractedVoxel &voxel, const ohm::RegionVoxels &region, unsigned voxel_index) mutable -> bool {
+      // Filter on the occupancy buffer before resolving the voxel references.
+      const float *occupancy_values = region.voxels<float>(0);
+      if (!occupancy_values || !(ohm::isOccupied(occupancy_values[voxel_index], map) ||
+                                 export_free && ohm::isFree(occupancy_values[voxel_index], map)))
+      {
+        return false;
+      }
+
+      const ohm::Key key = region.key(voxel_index);
+      ohm::setVoxelKey(key, occupancy, mean);
+      voxel.position = (mean.isLayerValid()) ? positionSafe(mean) : map.voxelCentreGlobal(key);
+      if (colour_select)
+      {
+        voxel.colour = colour_select(occupancy);
+      }
+      return true;
+    };
+  };
+}
+
+
+/// Create the extraction functions for voxels passing the @c SaveDensityCloudOptions::density_threshold .
+ExtractVoxelFactory densityExtractor(const ohm::OccupancyMap &map, const ohmtools::SaveDensityCloudOptions &opt,
+                                     const ohmtools::ColourSelect &colour_select)
+{
+  const float density_threshold = opt.density_threshold;
+  const bool ignore_voxel_mean = opt.ignore_voxel_mean;
+  return [&map, density_threshold, ignore_voxel_mean, colour_select]() -> ExtractVoxelFunction {
+    ohm::Voxel<const float> traversal(&map, map.layout().traversalLayer());
+    ohm::Voxel<const ohm::VoxelMean> mean(&map, map.layout().meanLayer());
+    return [&map, density_threshold, ignore_voxel_mean, colour_select, traversal, mean](
+             ExtractedVoxel &voxel, const ohm::RegionVoxels &region, unsigned voxel_index) mutable -> bool {
+      const ohm::Key key = region.key(voxel_index);
+      ohm::setVoxelKey(key, traversal, mean);
+      const float density = voxelDensity(traversal, mean);
+      if (density >= density_threshold)
+      {
+        voxel.position = (!ignore_voxel_mean) ? positionSafe(mean) : map.voxelCentreGlobal(key);
+        if (colour_select)
+        {
+          voxel.colour = colour_select(traversal);
+        }
+        return true;
+      }
+      return false;
+    };
+  };
+}
+
+
+/// Create the extraction functions for TSDF voxels within @p surface_distance of the surface.
+ExtractVoxelFactory tsdfExtractor(const ohm::OccupancyMap &map, float surface_distance,
+                                  const ohmtools::ColourSelectTsdf &colour_select)
+{
+  return [&map, surface_distance, colour_select]() -> ExtractVoxelFunction {
+    ohm::Voxel<const ohm::VoxelTsdf> tsdf_voxel(&map, map.layout().layerIndex(ohm::default_layer::tsdfLayerName()));
+    return [&map, surface_distance, colour_select, tsdf_voxel](
+             ExtractedVoxel &voxel, const ohm::RegionVoxels &region, unsigned voxel_index) mutable -> bool {
+      // Filter on the TSDF buffer before resolving the voxel reference.
+      const ohm::VoxelTsdf &tsdf = region.voxels<ohm::VoxelTsdf>(0)[voxel_index];
+      const bool export_match = tsdf.weight > 0 && std::abs(tsdf.distance) < surface_distance;
+      if (export_match)
+      {
+        const ohm::Key key = region.key(voxel_index);
+        ohm::setVoxelKey(key, tsdf_voxel);
+        voxel.position = map.voxelCentreLocal(key);
+        if (colour_select)
+        {
+          voxel.colour = colour_select(tsdf_voxel);
+        }
+        return true;
+      }
+      return false;
+    };
+  };
+}
+
 }  // namespace
 
 namespace ohmtools
@@ -334,12 +499,12 @@ ColourByIntensity::ColourByIntensity(const ohm::OccupancyMap &map, const ohm::Co
 }
 
 
-ohm::Colour ColourByIntensity::select(const ohm::Voxel<const float> &occupancy)
+ohm::Colour ColourByIntensity::select(const ohm::Voxel<const float> &occupancy) const
 {
-  intensity_.setKey(occupancy);
-  if (intensity_.isValid())
+  const ohm::Voxel<const ohm::IntensityMeanCov> intensity(occupancy, intensity_.layerIndex());
+  if (intensity.isValid())
   {
-    return select(intensity_.data().intensity_mean);
+    return select(intensity.data().intensity_mean);
   }
   return colours[1];
 }
@@ -470,26 +635,8 @@ uint64_t saveCloud(const std::string &file_name, const ohm::OccupancyMap &map, c
     with_flags |= WithColour;
   }
 
-  ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
-  auto mean = (opt.ignore_voxel_mean) ? ohm::Voxel<const ohm::VoxelMean>() :
-                                        ohm::Voxel<const ohm::VoxelMean>(&map, map.layout().meanLayer());
-
-  const auto extract_voxel = [&map, &opt, &occupancy, &mean, colour_select](
-                               ExtractedVoxel &voxel, const ohm::OccupancyMap::const_iterator &iter) -> bool {
-    ohm::setVoxelKey(iter, occupancy, mean);
-    if (isOccupied(occupancy) || opt.export_free && isFree(occupancy))
-    {
-      voxel.position = (mean.isLayerValid()) ? positionSafe(mean) : map.voxelCentreGlobal(*iter);
-      if (colour_select)
-      {
-        voxel.colour = colour_select(occupancy);
-      }
-      return true;
-    }
-    return false;
-  };
-
-  return ::saveAnyCloud(file_name, map, extract_voxel, with_flags, prog);
+  return ::saveAnyCloud(file_name, map, { map.layout().occupancyLayer() }, occupancyExtractor(map, opt, colour_select),
+                        with_flags, prog, opt.thread_count);
 }
 
 
@@ -521,23 +668,8 @@ uint64_t saveDensityCloud(const std::string &file_name, const ohm::OccupancyMap
     with_flags |= WithColour;
   }
 
-  const auto extract_voxel = [&map, &opt, &traversal, &mean, colour_select](
-                               ExtractedVoxel &voxel, const ohm::OccupancyMap::const_iterator &iter) -> bool {
-    const float density = voxelDensity(traversal, mean);
-    if (density >= opt.density_threshold)
-    {
-      voxel.position = (mean.isLayerValid()) ? positionSafe(mean) : map.voxelCentreGlobal(*iter);
-      voxel.position = (!opt.ignore_voxel_mean) ? positionSafe(mean) : map.voxelCentreGlobal(*iter);
-      if (colour_select)
-      {
-        voxel.colour = colour_select(traversal);
-      }
-      return true;
-    }
-    return false;
-  };
-
-  return ::saveAnyCloud(file_name, map, extract_voxel, with_flags, prog);
+  return ::saveAnyCloud(file_name, map, {}, densityExtractor(map, opt, colour_select), with_flags, prog,
+                        opt.thread_count);
 }
 
 
@@ -562,26 +694,8 @@ uint64_t ohmtools_API saveVoxels(const std::string &file_name, const ohm::Occupa
     with_flags |= WithColour;
   }
 
-  ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
-  auto mean = (opt.ignore_voxel_mean) ? ohm::Voxel<const ohm::VoxelMean>() :
-                                        ohm::Voxel<const ohm::VoxelMean>(&map, map.layout().meanLayer());
-
-  const auto extract_voxel = [&map, &opt, &occupancy, &mean, colour_select](
-                               ExtractedVoxel &voxel, const ohm::OccupancyMap::const_iterator &iter) -> bool {
-    ohm::setVoxelKey(iter, occupancy, mean);
-    if (isOccupied(occupancy) || opt.export_free && isFree(occupancy))
-    {
-      voxel.position = (mean.isLayerValid()) ? positionSafe(mean) : map.voxelCentreGlobal(*iter);
-      if (colour_select)
-      {
-        voxel.colour = colour_select(occupancy);
-      }
-      return true;
-    }
-    return false;
-  };
-
-  return ::saveAnyVoxels(file_name, map, extract_voxel, with_flags, prog);
+  return ::saveAnyVoxels(file_name, map, { map.layout().occupancyLayer() }, occupancyExtractor(map, opt, colour_select),
+                         with_flags, prog);
 }
 
 
@@ -613,36 +727,13 @@ uint64_t saveDensityVoxels(const std::string &file_name, const ohm::OccupancyMap
     with_flags |= WithColour;
   }
 
-  const auto extract_voxel = [&map, &opt, &traversal, &mean, colour_select](
-                               ExtractedVoxel &voxel, const ohm::OccupancyMap::const_iterator &iter) -> bool {
-    const float density = voxelDensity(traversal, mean);
-    if (density >= opt.density_threshold)
-    {
-      voxel.position = (mean.isLayerValid()) ? positionSafe(mean) : map.voxelCentreGlobal(*iter);
-      voxel.position = (!opt.ignore_voxel_mean) ? positionSafe(mean) : map.voxelCentreGlobal(*iter);
-      if (colour_select)
-      {
-        voxel.colour = colour_select(traversal);
-      }
-      return true;
-    }
-    return false;
-  };
-
-  return ::saveAnyVoxels(file_name, map, extract_voxel, with_flags, prog);
+  return ::saveAnyVoxels(file_name, map, {}, densityExtractor(map, opt, colour_select), with_flags, prog);
 }
 
 
 uint64_t saveHeightmapCloud(const std::string &file_name, const ohm::OccupancyMap &map,
                             const SaveHeightmapCloudOptions &opt, const ProgressCallback &prog)
 {
-  std::ofstream out(file_name, std::ios::binary);
-
-  if (!out.is_open())
-  {
-    return 0;
-  }
-
   auto colour_select = opt.colour_select;
   std::unique_ptr<ColourByHeightmapClearance> colour_by_height;
   if (!colour_select && opt.allow_default_colour_selection)
@@ -653,21 +744,8 @@ uint64_t saveHeightmapCloud(const std::string &file_name, const ohm::OccupancyMa
     };
   }
 
-  ohm::PlyPointStream ply = setupPlyStream(static_cast<bool>(colour_select));
-  ply.open(out);
-
-  glm::dvec3 pos;
-  const size_t region_count = map.regionCount();
-  size_t processed_region_count = 0;
-  glm::i16vec3 last_region = map.begin().key().regionKey();
-
-  ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
-  auto mean = (opt.ignore_voxel_mean) ? ohm::Voxel<const ohm::VoxelMean>() :
-                                        ohm::Voxel<const ohm::VoxelMean>(&map, map.layout().meanLayer());
-  ohm::Voxel<const ohm::HeightmapVoxel> heightmap_voxel(&map,
-                                                        map.layout().layerIndex(ohm::HeightmapVoxel::kHeightmapLayer));
-
-  if (!heightmap_voxel.isLayerValid())
+  const int heightmap_layer = map.layout().layerIndex(ohm::HeightmapVoxel::kHeightmapLayer);
+  if (heightmap_layer == -1)
   {
     // Invalid format.
     return 0;
@@ -687,55 +765,51 @@ uint64_t saveHeightmapCloud(const std::string &file_name, const ohm::OccupancyMa
     height_flip = -1.0f;
   }
 
-  uint64_t point_count = 0;
-  for (auto iter = map.begin(); iter != map.end(); ++iter)
-  {
-    ohm::setVoxelKey(iter, occupancy, mean, heightmap_voxel);
-    if (last_region != iter.key().regionKey())
-    {
-      ++processed_region_count;
-      if (prog)
-      {
-        prog(processed_region_count, region_count);
-      }
-      last_region = iter.key().regionKey();
-    }
-
-    // Respect collapse option. When collapsing, we ignore voxels which are not in the base layer.
-    if (!opt.collapse || (heightmap_voxel.isValid() && heightmap_voxel.data().layer == ohm::kHvlBaseLayer))
-    {
+  const int mean_layer = (opt.ignore_voxel_mean) ? -1 : map.layout().meanLayer();
+  const auto make_extract_voxel = [&map, &opt, colour_select, mean_layer, heightmap_layer, heightmap_axis,
+                                   height_flip]() -> ExtractVoxelFunction {
+    ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
+    ohm::Voxel<const ohm::VoxelMean> mean(&map, mean_layer);
+    ohm::Voxel<const ohm::HeightmapVoxel> heightmap_voxel(&map, heightmap_layer);
+    return [&map, &opt, colour_select, heightmap_axis, height_flip, occupancy, mean, heightmap_voxel](
+             ExtractedVoxel &voxel, const ohm::RegionVoxels &region, unsigned voxel_index) mutable -> bool {
       // Note: an occupancy value of 0 will come up as occupied, but in a heightmap represents a vacant voxel which we
-      // want to skip unless exporting "free".
-      if (isOccupied(occupancy) && occupancy.data() != 0 ||
-          opt.export_free && (isFree(occupancy) || occupancy.data() == 0))
+      // want to skip unless exporting "free". Filter on the occupancy buffer before resolving the voxel references.
+      const float *occupancy_values = region.voxels<float>(0);
+      const float value = (occupancy_values) ? occupancy_values[voxel_index] : ohm::unobservedOccupancyValue();
+      if (!(ohm::isOccupied(value, map) && value != 0 ||
+            opt.export_free && (ohm::isFree(value, map) || value == 0)))
       {
-        pos = (mean.isLayerValid()) ? positionSafe(mean) : map.voxelCentreGlobal(*iter);
-        if (heightmap_voxel.isValid())
-        {
-          pos[heightmap_axis] =
-            map.voxelCentreGlobal(*iter)[heightmap_axis] + double(height_flip * heightmap_voxel.data().height);
-        }
+        return false;
+      }
 
-        ply.setPointPosition(pos);
+      const ohm::Key key = region.key(voxel_index);
+      ohm::setVoxelKey(key, occupancy, mean, heightmap_voxel);
 
-        if (colour_select)
-        {
-          const ohm::Colour c = colour_select(occupancy);
-          ply.setProperty(kPropertyRed, c.r());
-          ply.setProperty(kPropertyGreen, c.g());
-          ply.setProperty(kPropertyBlue, c.b());
-        }
+      // Respect collapse option. When collapsing, we ignore voxels which are not in the base layer.
+      if (opt.collapse && !(heightmap_voxel.isValid() && heightmap_voxel.data().layer == ohm::kHvlBaseLayer))
+      {
+        return false;
+      }
 
-        ply.writePoint();
-        ++point_count;
+      voxel.position = (mean.isLayerValid()) ? positionSafe(mean) : map.voxelCentreGlobal(key);
+      if (heightmap_voxel.isValid())
+      {
+        voxel.position[heightmap_axis] =
+          map.voxelCentreGlobal(key)[heightmap_axis] + double(height_flip * heightmap_voxel.data().height);
       }
-    }
-  }
 
-  ply.close();
-  out.close();
+      if (colour_select)
+      {
+        voxel.colour = colour_select(occupancy);
+      }
+      return true;
+    };
+  };
 
-  return point_count;
+  const unsigned with_flags = (colour_select) ? unsigned(WithColour) : 0u;
+  return ::saveAnyCloud(file_name, map, { map.layout().occupancyLayer() }, make_extract_voxel, with_flags, prog,
+                        opt.thread_count);
 }
 
 
@@ -763,10 +837,7 @@ uint64_t saveHeightmapVoxels(const std::string &file_name, const ohm::OccupancyM
   ohm::PlyMesh ply;
 
   glm::dvec3 pos;
-  const size_t region_count = map.regionCount();
   const double resolution = map.resolution();
-  size_t processed_region_count = 0;
-  glm::i16vec3 last_region = map.begin().key().regionKey();
 
   ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
   auto mean = (opt.ignore_voxel_mean) ? ohm::Voxel<const ohm::VoxelMean>() :
@@ -795,40 +866,38 @@ uint64_t saveHeightmapVoxels(const std::string &file_name, const ohm::OccupancyM
   }
 
   uint64_t voxel_count = 0;
-  for (auto iter = map.begin(); iter != map.end(); ++iter)
-  {
-    ohm::setVoxelKey(iter, occupancy, mean, heightmap_voxel);
-    if (last_region != iter.key().regionKey())
-    {
-      ++processed_region_count;
-      if (prog)
+  visitVoxels(
+    map, { map.layout().occupancyLayer() },
+    [&](const ohm::RegionVoxels &region, unsigned voxel_index) {
+      // Note: an occupancy value of 0 will come up as occupied, but in a heightmap represents a vacant voxel which we
+      // want to skip unless exporting "free". Filter on the occupancy buffer before resolving the voxel references.
+      const float *occupancy_values = region.voxels<float>(0);
+      const float value = (occupancy_values) ? occupancy_values[voxel_index] : ohm::unobservedOccupancyValue();
+      if (!(ohm::isOccupied(value, map) && value != 0 ||
+            opt.export_free && (ohm::isFree(value, map) || value == 0)))
       {
-        prog(processed_region_count, region_count);
+        return;
       }
-      last_region = iter.key().regionKey();
-    }
 
-    // Respect collapse option. When collapsing, we ignore voxels which are not in the base layer.
-    if (!opt.collapse || (heightmap_voxel.isValid() && heightmap_voxel.data().layer == ohm::kHvlBaseLayer))
-    {
-      // Note: an occupancy value of 0 will come up as occupied, but in a heightmap represents a vacant voxel which we
-      // want to skip unless exporting "free".
-      if (isOccupied(occupancy) && occupancy.data() != 0 ||
-          opt.export_free && (isFree(occupancy) || occupancy.data() == 0))
+      const ohm::Key key = region.key(voxel_index);
+      ohm::setVoxelKey(key, occupancy, mean, heightmap_voxel);
+
+      // Respect collapse option. When collapsing, we ignore voxels which are not in the base layer.
+      if (!opt.collapse || (heightmap_voxel.isValid() && heightmap_voxel.data().layer == ohm::kHvlBaseLayer))
       {
-        pos = (mean.isLayerValid()) ? positionSafe(mean) : map.voxelCentreGlobal(*iter);
+        pos = (mean.isLayerValid()) ? positionSafe(mean) : map.voxelCentreGlobal(key);
         if (heightmap_voxel.isValid())
         {
           pos[heightmap_axis] =
-            map.voxelCentreGlobal(*iter)[heightmap_axis] + double(height_flip * heightmap_voxel.data().height);
+            map.voxelCentreGlobal(key)[heightmap_axis] + double(height_flip * heightmap_voxel.data().height);
         }
 
         const ohm::Colour c = (colour_select) ? colour_select(occupancy) : ohm::Colour(255, 255, 255);
         addVoxel(ply, pos, resolution, c);
         ++voxel_count;
       }
-    }
-  }
+    },
+    prog);
 
   if (!ply.save(out, true))
   {
@@ -878,77 +947,60 @@ void saveQueryCloud(const std::string &file_name, const ohm::OccupancyMap &map,
 
 size_t saveClearanceCloud(const std::string &file_name, const ohm::OccupancyMap &map, const glm::dvec3 &min_extents,
                           const glm::dvec3 &max_extents, float colour_range, int export_type,
-                          const ProgressCallback &prog)
+                          const ProgressCallback &prog, unsigned thread_count)
 {
-  const size_t region_count = map.regionCount();
-  size_t processed_region_count = 0;
-  glm::dvec3 v;
-  glm::i16vec3 last_region = map.begin().key().regionKey();
-  ohm::PlyMesh ply;
-  size_t point_count = 0;
+  const glm::i16vec3 min_region = map.regionKey(min_extents);
+  const glm::i16vec3 max_region = map.regionKey(max_extents);
 
-  glm::i16vec3 min_region = map.regionKey(min_extents);
-  glm::i16vec3 max_region = map.regionKey(max_extents);
-
-  ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
-  ohm::Voxel<const float> clearance(&map, map.layout().clearanceLayer());
-
-  if (!clearance.isLayerValid())
+  if (map.layout().clearanceLayer() == -1)
   {
     // No clearance layer.
     return 0;
   }
 
   const float colour_scale = colour_range;
-  const auto map_end_iter = map.end();
-  for (auto iter = map.begin(); iter != map_end_iter; ++iter)
-  {
-    clearance.setKey(occupancy.setKey(*iter));
-    if (last_region != iter.key().regionKey())
-    {
-      ++processed_region_count;
-      if (prog)
+  const auto make_extract_voxel = [&map, min_region, max_region, colour_range, colour_scale,
+                                   export_type]() -> ExtractVoxelFunction {
+    ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
+    return [&map, min_region, max_region, colour_range, colour_scale, export_type, occupancy](
+             ExtractedVoxel &voxel, const ohm::RegionVoxels &region, unsigned voxel_index) mutable -> bool {
+      // Ensure the voxel is in a region we have calculated data for.
+      const glm::i16vec3 region_key = region.chunk().region.coord;
+      if (min_region.x <= region_key.x && region_key.x <= max_region.x &&  //
+          min_region.y <= region_key.y && region_key.y <= max_region.y &&  //
+          min_region.z <= region_key.z && region_key.z <= max_region.z)
       {
-        prog(processed_region_count, region_count);
-      }
-      last_region = iter.key().regionKey();
-    }
-
-    // Ensure the voxel is in a region we have calculated data for.
-    if (min_region.x <= last_region.x && last_region.x <= max_region.x &&  //
-        min_region.y <= last_region.y && last_region.y <= max_region.y &&  //
-        min_region.z <= last_region.z && last_region.z <= max_region.z)
-    {
-      const bool export_match = !occupancy.isNull() && occupancyType(occupancy) >= export_type;
-      if (export_match)
-      {
-        float range_value;
-        assert(clearance.isValid());  // More for clang-tidy. We've already checked the layer validity.
-        clearance.read(&range_value);
-        if (range_value < 0)
-        {
-          range_value = colour_range;
-        }
-        if (range_value >= 0)
+        const ohm::Key key = region.key(voxel_index);
+        occupancy.setKey(key);
+        const bool export_match = !occupancy.isNull() && occupancyType(occupancy) >= export_type;
+        if (export_match)
         {
-          uint8_t c =
-            uint8_t(std::numeric_limits<uint8_t>::max() * std::max(0.0f, (colour_scale - range_value) / colour_scale));
-          v = map.voxelCentreLocal(*iter);
-          ply.addVertex(v, ohm::Colour(c, std::numeric_limits<uint8_t>::max() / 2, 0));
-          ++point_count;
+          float range_value = region.voxels<float>(1)[voxel_index];
+          if (range_value < 0)
+          {
+            range_value = colour_range;
+          }
+          if (range_value >= 0)
+          {
+            uint8_t c = uint8_t(std::numeric_limits<uint8_t>::max() *
+                                std::max(0.0f, (colour_scale - range_value) / colour_scale));
+            voxel.position = map.voxelCentreLocal(key);
+            voxel.colour = ohm::Colour(c, std::numeric_limits<uint8_t>::max() / 2, 0);
+            return true;
+          }
         }
       }
-    }
-  }
-
-  ply.save(file_name, true);
+      return false;
+    };
+  };
 
-  return point_count;
+  return ::saveAnyCloud(file_name, map, { map.layout().occupancyLayer(), map.layout().clearanceLayer() },
+                        make_extract_voxel, WithColour, prog, thread_count);
 }
 
 
 size_t saveTsdfCloud(const std::string &file_name, const ohm::OccupancyMap &map, float surface_distance,
-                     const ColourSelectTsdf &colour_select, const ProgressCallback &prog)
+                     const ColourSelectTsdf &colour_select, const ProgressCallback &prog, unsigned thread_count)
 {
   // Work out if we need colour.
   unsigned with_flags = 0;
@@ -966,24 +1018,8 @@ size_t saveTsdfCloud(const std::string &file_name, const ohm::OccupancyMap &map,
     return 0;
   }
 
-  const auto extract_voxel = [&map, surface_distance, &tsdf_voxel, colour_select](
-                               ExtractedVoxel &voxel, const ohm::OccupancyMap::const_iterator &iter) -> bool {
-    ohm::setVoxelKey(iter, tsdf_voxel);
-    const auto tsdf = tsdf_voxel.data();
-    const bool export_match = tsdf.weight > 0 && std::abs(tsdf.distance) < surface_distance;
-    if (export_match)
-    {
-      voxel.position = map.voxelCentreLocal(*iter);
-      if (colour_select)
-      {
-        voxel.colour = colour_select(tsdf_voxel);
-      }
-      return true;
-    }
-    return false;
-  };
-
-  return ::saveAnyCloud(file_name, map, extract_voxel, with_flags, prog);
+  return ::saveAnyCloud(file_name, map, { tsdf_voxel.layerIndex() },
+                        tsdfExtractor(map, surface_distance, colour_select), with_flags, prog, thread_count);
 }
 
 
@@ -1005,23 +1041,7 @@ size_t saveTsdfVoxels(const std::string &file_name, const ohm::OccupancyMap &map
     return 0;
   }
 
-  const auto extract_voxel = [&map, surface_distance, &tsdf_voxel, colour_select](
-                               ExtractedVoxel &voxel, const ohm::OccupancyMap::const_iterator &iter) -> bool {
-    ohm::setVoxelKey(iter, tsdf_voxel);
-    const auto tsdf = tsdf_voxel.data();
-    const bool export_match = tsdf.weight > 0 && std::abs(tsdf.distance) < surface_distance;
-    if (export_match)
-    {
-      voxel.position = map.voxelCentreLocal(*iter);
-      if (colour_select)
-      {
-        voxel.colour = colour_select(tsdf_voxel);
-      }
-      return true;
-    }
-    return false;
-  };
-
-  return ::saveAnyVoxels(file_name, map, extract_voxel, with_flags, prog);
+  return ::saveAnyVoxels(file_name, map, { tsdf_voxel.layerIndex() },
+                         tsdfExtractor(map, surface_distance, colour_select), with_flags, prog);
 }
 }  // namespace ohmtools
@@ -54,6 +54,10 @@ struct ohmtools_API SaveCloudOptions
   bool export_free = false;
   /// Ignore voxel mean forcing voxel centres for positions?
   bool ignore_voxel_mean = false;
+  /// Number of threads used to extract points when saving a point cloud: 1 for serial extraction (default), 0 to use
+  /// all available threads. The output is the same regardless of the thread count, but the @c colour_select function
+  /// must be thread safe when not 1. Voxel mesh exports are always serial.
+  unsigned thread_count = 1;
 };
 
 /// Options for saving a density cloud.
@@ -231,10 +235,10 @@ public:
   /// @return True if the map used on construction has an appropiate intensity layer.
   inline bool isValid() const { return intensity_.isLayerValid(); }
 
-  /// Select a colour for the given voxel @p occupancy.
+  /// Select a colour for the given voxel @p occupancy. Thread safe.
   /// @param occupancy The voxel to colour.
   /// @return The colour for the voxel at @p occupancy.
-  ohm::Colour select(const ohm::Voxel<const float> &occupancy);
+  ohm::Colour select(const ohm::Voxel<const float> &occupancy) const;
 
   /// Select a colour for the given @p intensity value.
   /// @param intensity Intensity value to colour for [0, max_intensity].
@@ -399,10 +403,11 @@ void ohmtools_API saveQueryCloud(const std::string &file_name, const ohm::Occupa
 /// @param colour_range Affects voxel colouring as described above. Green at this range.
 /// @param export_type Type of voxels to export. Voxels of this @c OccupancyType or greater are exported.
 /// @param prog Optional function called to report on progress.
+/// @param thread_count Number of threads used to extract points. See @c SaveCloudOptions::thread_count .
 size_t ohmtools_API saveClearanceCloud(const std::string &file_name, const ohm::OccupancyMap &map,
                                        const glm::dvec3 &min_extents, const glm::dvec3 &max_extents,
                                        float colour_range = 0.0f, int export_type = 0,
-                                       const ProgressCallback &prog = ProgressCallback());
+                                       const ProgressCallback &prog = ProgressCallback(), unsigned thread_count = 1);
 
 /// Save a point cloud from TSDF layer data.
 ///
@@ -410,8 +415,10 @@ size_t ohmtools_API saveClearanceCloud(const std::string &file_name, const ohm::
 /// @param map The map to save voxels from.
 /// @param surface_distance Surface distance threshold to export with.
 /// @param prog Optional function called to report on progress.
+/// @param thread_count Number of threads used to extract points. See @c SaveCloudOptions::thread_count .
 size_t saveTsdfCloud(const std::string &file_name, const ohm::OccupancyMap &map, float surface_distance,
-                     const ColourSelectTsdf &colour_select = {}, const ProgressCallback &prog = ProgressCallback());
+                     const ColourSelectTsdf &colour_select = {}, const ProgressCallback &prog = ProgressCallback(),
+                     unsigned thread_count = 1);
 
 /// Save a point cloud from TSDF layer data.
 ///
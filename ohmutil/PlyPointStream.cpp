@@ -112,6 +112,7 @@ PlyPointStream::PlyPointStream(PlyPointStream &&other) noexcept
   : out_(std::exchange(other.out_, nullptr))
   , properties_(std::move(other.properties_))
   , values_(std::move(other.values_))
+  , point_buffer_(std::move(other.point_buffer_))
   , point_count_(std::exchange(other.point_count_, 0))
   , point_count_pos_(std::exchange(other.point_count_pos_, -1))
 {}
@@ -128,6 +129,7 @@ PlyPointStream &PlyPointStream::operator=(PlyPointStream &&other) noexcept
   out_ = std::exchange(other.out_, nullptr);
   properties_ = std::move(other.properties_);
   values_ = std::move(other.values_);
+  point_buffer_ = std::move(other.point_buffer_);
   point_count_ = std::exchange(other.point_count_, 0);
   point_count_pos_ = std::exchange(other.point_count_pos_, -1);
   return *this;
@@ -244,40 +246,60 @@ bool PlyPointStream::setProperty(const std::string &name, double value)
 
 void PlyPointStream::writePoint()
 {
+  point_buffer_.clear();
+  encodePoint(point_buffer_);
+  out_->write(reinterpret_cast<const char *>(point_buffer_.data()), std::streamsize(point_buffer_.size()));
+  ++point_count_;
+}
+
+
+void PlyPointStream::encodePoint(std::vector<uint8_t> &buffer) const
+{
+  const auto append = [&buffer](const void *value, size_t size) {
+    const auto *bytes = static_cast<const uint8_t *>(value);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+  };
+
   for (size_t i = 0; i < properties_.size(); ++i)
   {
     const Value &value = values_[i];
     switch (properties_[i].type)
     {
     case Type::kInt8:
-      out_->write(reinterpret_cast<const char *>(&value.i8), sizeof(value.i8));
+      append(&value.i8, sizeof(value.i8));
       break;
     case Type::kUInt8:
-      out_->write(reinterpret_cast<const char *>(&value.u8), sizeof(value.u8));
+      append(&value.u8, sizeof(value.u8));
       break;
     case Type::kInt16:
-      out_->write(reinterpret_cast<const char *>(&value.i16), sizeof(value.i16));
+      append(&value.i16, sizeof(value.i16));
       break;
     case Type::kUInt16:
-      out_->write(reinterpret_cast<const char *>(&value.u16), sizeof(value.u16));
+      append(&value.u16, sizeof(value.u16));
       break;
     case Type::kInt32:
-      out_->write(reinterpret_cast<const char *>(&value.i32), sizeof(value.i32));
+      append(&value.i32, sizeof(value.i32));
       break;
     case Type::kUInt32:
-      out_->write(reinterpret_cast<const char *>(&value.u32), sizeof(value.u32));
+      append(&value.u32, sizeof(value.u32));
       break;
     case Type::kFloat32:
-      out_->write(reinterpret_cast<const char *>(&value.f32), sizeof(value.f32));
+      append(&value.f32, sizeof(value.f32));
       break;
     case Type::kFloat64:
-      out_->write(reinterpret_cast<const char *>(&value.f64), sizeof(value.f64));
+      append(&value.f64, sizeof(value.f64));
       break;
     default:
       throw std::runtime_error("Unexpected data type");
     }
   }
-  ++point_count_;
+}
+
+
+void PlyPointStream::writeEncodedPoints(const std::vector<uint8_t> &buffer, uint64_t point_count)
+{
+  out_->write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(buffer.size()));
+  point_count_ += point_count;
 }
 
 
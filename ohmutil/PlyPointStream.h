@@ -151,6 +151,18 @@ public:
   /// Write the current collected point data. Values which have not been set will retain their previous value.
   void writePoint();
 
+  /// Append the current collected point data to @p buffer in the binary format used by @c writePoint() .
+  ///
+  /// This does not require the stream to be open, so a separate @c PlyPointStream with the same @c properties() may
+  /// be used to encode points - possibly on another thread - for later writing with @c writeEncodedPoints() .
+  /// @param buffer The buffer to append to.
+  void encodePoint(std::vector<uint8_t> &buffer) const;
+
+  /// Write points previously encoded using @c encodePoint() with the same @c properties() .
+  /// @param buffer The encoded point data.
+  /// @param point_count The number of points encoded in @p buffer .
+  void writeEncodedPoints(const std::vector<uint8_t> &buffer, uint64_t point_count);
+
   /// Query the ply string name for @p type . This is written to the ply file as the property type.
   /// @param type The type to query.
   /// @return The ply type name for @p type
@@ -206,6 +218,8 @@ private:
   std::ostream *out_{ nullptr };
   std::vector<Property> properties_;
   std::vector<Value> values_;
+  /// Buffer used to encode each point in @c writePoint() .
+  std::vector<uint8_t> point_buffer_;
   uint64_t point_count_ = 0;
   std::ostream::pos_type point_count_pos_ = -1;
 };
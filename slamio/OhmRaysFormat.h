@@ -0,0 +1,127 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef SLAMIO_OHMRAYSFORMAT_H_
+#define SLAMIO_OHMRAYSFORMAT_H_
+
+#include "SlamIOConfig.h"
+
+#include "DataChannel.h"
+
+#include <cstdint>
+
+namespace slamio
+{
+/// Structures of the ohm rays file format. See @c OhmRaysWriter .
+///
+/// File layout:
+/// - @c FileHeader
+/// - @c ChunkHeader and payload for each chunk
+/// - @c IndexEntry for each chunk
+/// - @c Footer
+///
+/// A chunk payload is a set of columns, each written for all rays in the chunk before the next column:
+/// - `float[6]` ray origin and sample coordinates, relative to @c ChunkHeader::origin
+/// - `double` timestamp (optional, @c DataChannel::Time )
+/// - `float` intensity (optional, @c DataChannel::Intensity )
+/// - `uint8_t` return number (optional, @c DataChannel::ReturnNumber )
+///
+/// The payload may be compressed as a whole according to @c FileHeader::codec . All values are written in host byte
+/// order, matching the ohm map format.
+namespace ohmrays
+{
+/// File header marker: "OHMR"
+const uint32_t kFileMarker = 0x524d484fu;
+/// Chunk header marker: "RCHK"
+const uint32_t kChunkMarker = 0x4b484352u;
+/// Footer marker: "OHMI"
+const uint32_t kFooterMarker = 0x494d484fu;
+/// Current format version.
+const uint16_t kVersion = 1u;
+
+/// Chunk payload codecs. LZ4 and Zstandard support depend on the @c WITH_LZ4 and @c WITH_ZSTD build options.
+enum Codec : uint16_t
+{
+  kCodecNone = 0u,  ///< Uncompressed payload.
+  kCodecZlib = 1u,  ///< zlib compressed payload.
+  kCodecLz4 = 2u,   ///< LZ4 compressed payload.
+  kCodecZstd = 3u   ///< Zstandard compressed payload.
+};
+
+/// Query whether a chunk payload @p codec is supported by this build.
+/// @param codec The @c Codec value to check.
+/// @return True if chunk payloads using the @p codec can be read and written.
+inline bool codecSupported(uint16_t codec)
+{
+  switch (codec)
+  {
+  case kCodecNone:
+  case kCodecZlib:
+    return true;
+  case kCodecLz4:
+    return SLAMIO_HAVE_LZ4 != 0;
+  case kCodecZstd:
+    return SLAMIO_HAVE_ZSTD != 0;
+  default:
+    break;
+  }
+  return false;
+}
+
+/// File header.
+struct FileHeader
+{
+  uint32_t marker;    ///< @c kFileMarker
+  uint16_t version;   ///< @c kVersion
+  uint16_t codec;     ///< @c Codec for chunk payloads.
+  uint32_t channels;  ///< @c DataChannel flags for the optional columns.
+  uint32_t reserved;  ///< Reserved - zero.
+};
+
+/// Header preceding each chunk payload.
+struct ChunkHeader
+{
+  uint32_t marker;             ///< @c kChunkMarker
+  uint32_t ray_count;          ///< Number of rays in the chunk.
+  double origin[3];            ///< Reference position for the relative ray coordinates.
+  uint64_t payload_size;       ///< Stored payload byte size.
+  uint64_t uncompressed_size;  ///< Uncompressed payload byte size.
+};
+
+/// Chunk index entry.
+struct IndexEntry
+{
+  uint64_t offset;     ///< File offset of the @c ChunkHeader .
+  uint64_t ray_count;  ///< Number of rays in the chunk.
+  double time_first;   ///< First timestamp in the chunk. Zero without timestamps.
+  double time_last;    ///< Last timestamp in the chunk. Zero without timestamps.
+};
+
+/// File footer.
+struct Footer
+{
+  uint64_t index_offset;  ///< File offset of the first @c IndexEntry .
+  uint64_t chunk_count;   ///< Number of chunks and index entries.
+  uint64_t ray_count;     ///< Total number of rays.
+  uint32_t marker;        ///< @c kFooterMarker
+  uint32_t version;       ///< @c kVersion
+};
+
+/// Calculate the uncompressed payload size for a chunk.
+/// @param ray_count Number of rays in the chunk.
+/// @param channels The optional columns present.
+/// @return The payload byte size.
+inline uint64_t payloadSize(uint64_t ray_count, DataChannel channels)
+{
+  uint64_t size = ray_count * 6u * sizeof(float);
+  size += ((channels & DataChannel::Time) != DataChannel::None) ? ray_count * sizeof(double) : 0u;
+  size += ((channels & DataChannel::Intensity) != DataChannel::None) ? ray_count * sizeof(float) : 0u;
+  size += ((channels & DataChannel::ReturnNumber) != DataChannel::None) ? ray_count * sizeof(uint8_t) : 0u;
+  return size;
+}
+}  // namespace ohmrays
+}  // namespace slamio
+
+#endif  // SLAMIO_OHMRAYSFORMAT_H_
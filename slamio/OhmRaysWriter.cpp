@@ -0,0 +1,332 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "OhmRaysWriter.h"
+
+#include <glm/glm.hpp>
+
+#include <zlib.h>
+
+#if SLAMIO_HAVE_LZ4
+#include <lz4.h>
+#endif  // SLAMIO_HAVE_LZ4
+#if SLAMIO_HAVE_ZSTD
+#include <zstd.h>
+#endif  // SLAMIO_HAVE_ZSTD
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace slamio
+{
+struct OhmRaysWriterDetail
+{
+  using FilePtr = std::unique_ptr<FILE, int (*)(FILE *)>;
+
+  FilePtr file{ nullptr, &fclose };
+  DataChannel channels = DataChannel::None;
+  ohmrays::Codec codec = ohmrays::kCodecZlib;
+  unsigned chunk_size = OhmRaysWriter::kDefaultChunkSize;
+  /// Bytes written so far. Tracked to avoid 32-bit @c ftell() limits.
+  uint64_t file_offset = 0;
+  uint64_t ray_count = 0;
+  bool ok = true;
+
+  // Pending chunk columns.
+  glm::dvec3 chunk_origin{ 0 };
+  std::vector<float> rays;
+  std::vector<double> timestamps;
+  std::vector<float> intensities;
+  std::vector<uint8_t> return_numbers;
+  std::vector<ohmrays::IndexEntry> index;
+  /// Payload assembly and compression buffers.
+  std::vector<uint8_t> payload;
+  std::vector<uint8_t> compressed;
+
+  inline bool hasChannel(DataChannel channel) const { return (channels & channel) != DataChannel::None; }
+
+  size_t pendingCount() const { return rays.size() / 6u; }
+
+  bool write(const void *data, size_t byte_count)
+  {
+    if (ok && std::fwrite(data, 1, byte_count, file.get()) != byte_count)
+    {
+      ok = false;
+    }
+    file_offset += byte_count;
+    return ok;
+  }
+
+  /// Compress the @c payload into @c compressed according to the @c codec . Uses the fastest compression levels,
+  /// favouring speed over size.
+  bool compressPayload()
+  {
+    switch (codec)
+    {
+    case ohmrays::kCodecZlib:
+    {
+      uLongf compressed_size = compressBound(uLong(payload.size()));
+      compressed.resize(compressed_size);
+      if (compress2(compressed.data(), &compressed_size, payload.data(), uLong(payload.size()), Z_BEST_SPEED) != Z_OK)
+      {
+        return false;
+      }
+      compressed.resize(compressed_size);
+      return true;
+    }
+#if SLAMIO_HAVE_LZ4
+    case ohmrays::kCodecLz4:
+    {
+      if (payload.size() > size_t(LZ4_MAX_INPUT_SIZE))
+      {
+        return false;
+      }
+      compressed.resize(size_t(LZ4_compressBound(int(payload.size()))));
+      const int compressed_size =
+        LZ4_compress_default(reinterpret_cast<const char *>(payload.data()),
+                             reinterpret_cast<char *>(compressed.data()), int(payload.size()), int(compressed.size()));
+      if (compressed_size <= 0)
+      {
+        return false;
+      }
+      compressed.resize(size_t(compressed_size));
+      return true;
+    }
+#endif  // SLAMIO_HAVE_LZ4
+#if SLAMIO_HAVE_ZSTD
+    case ohmrays::kCodecZstd:
+    {
+      compressed.resize(ZSTD_compressBound(payload.size()));
+      const size_t compressed_size =
+        ZSTD_compress(compressed.data(), compressed.size(), payload.data(), payload.size(), 1);
+      if (ZSTD_isError(compressed_size))
+      {
+        return false;
+      }
+      compressed.resize(compressed_size);
+      return true;
+    }
+#endif  // SLAMIO_HAVE_ZSTD
+    default:
+      break;
+    }
+    return false;
+  }
+
+  template <typename T>
+  void appendColumn(const std::vector<T> &column)
+  {
+    const size_t byte_count = column.size() * sizeof(T);
+    const size_t offset = payload.size();
+    payload.resize(offset + byte_count);
+    if (byte_count)
+    {
+      std::memcpy(payload.data() + offset, column.data(), byte_count);
+    }
+  }
+};
+
+
+OhmRaysWriter::OhmRaysWriter()
+  : imp_(std::make_unique<OhmRaysWriterDetail>())
+{}
+
+
+OhmRaysWriter::~OhmRaysWriter()
+{
+  close();
+}
+
+
+bool OhmRaysWriter::open(const char *filename, DataChannel channels, bool compress, unsigned chunk_size)
+{
+  return open(filename, channels, (compress) ? ohmrays::kCodecZlib : ohmrays::kCodecNone, chunk_size);
+}
+
+
+bool OhmRaysWriter::open(const char *filename, DataChannel channels, ohmrays::Codec codec, unsigned chunk_size)
+{
+  close();
+  if (!ohmrays::codecSupported(codec))
+  {
+    return false;
+  }
+
+  imp_->file.reset(std::fopen(filename, "wb"));
+  if (!imp_->file)
+  {
+    return false;
+  }
+
+  imp_->channels = channels & (DataChannel::Time | DataChannel::Intensity | DataChannel::ReturnNumber);
+  imp_->codec = codec;
+  imp_->chunk_size = (chunk_size) ? chunk_size : kDefaultChunkSize;
+  imp_->file_offset = 0;
+  imp_->ray_count = 0;
+  imp_->ok = true;
+  imp_->index.clear();
+  imp_->rays.clear();
+  imp_->timestamps.clear();
+  imp_->intensities.clear();
+  imp_->return_numbers.clear();
+
+  ohmrays::FileHeader header{};
+  header.marker = ohmrays::kFileMarker;
+  header.version = ohmrays::kVersion;
+  header.codec = codec;
+  header.channels = uint32_t(imp_->channels);
+  return imp_->write(&header, sizeof(header));
+}
+
+
+bool OhmRaysWriter::isOpen() const
+{
+  return imp_->file != nullptr;
+}
+
+
+bool OhmRaysWriter::close()
+{
+  if (!imp_->file)
+  {
+    return false;
+  }
+
+  flushChunk();
+
+  ohmrays::Footer footer{};
+  footer.index_offset = imp_->file_offset;
+  footer.chunk_count = imp_->index.size();
+  footer.ray_count = imp_->ray_count;
+  footer.marker = ohmrays::kFooterMarker;
+  footer.version = ohmrays::kVersion;
+
+  if (!imp_->index.empty())
+  {
+    imp_->write(imp_->index.data(), imp_->index.size() * sizeof(*imp_->index.data()));
+  }
+  imp_->write(&footer, sizeof(footer));
+
+  const bool ok = imp_->ok && std::fflush(imp_->file.get()) == 0;
+  imp_->file.reset();
+  imp_->index.clear();
+  return ok;
+}
+
+
+bool OhmRaysWriter::writeRay(const glm::dvec3 &origin, const glm::dvec3 &sample, double timestamp, float intensity,
+                             uint8_t return_number)
+{
+  const glm::dvec3 rays[2] = { origin, sample };
+  return writeRays(rays, 1, &timestamp, &intensity, &return_number);
+}
+
+
+bool OhmRaysWriter::writeRays(const glm::dvec3 *rays, size_t ray_count, const double *timestamps,
+                              const float *intensities, const uint8_t *return_numbers)
+{
+  OhmRaysWriterDetail &imp = *imp_;
+  if (!imp.file)
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < ray_count; ++i)
+  {
+    if (imp.pendingCount() == 0)
+    {
+      // The first ray origin of each chunk is the reference point for the chunk.
+      imp.chunk_origin = rays[i * 2 + 0];
+    }
+
+    const glm::vec3 origin = glm::vec3(rays[i * 2 + 0] - imp.chunk_origin);
+    const glm::vec3 sample = glm::vec3(rays[i * 2 + 1] - imp.chunk_origin);
+    imp.rays.insert(imp.rays.end(), { origin.x, origin.y, origin.z, sample.x, sample.y, sample.z });
+    if (imp.hasChannel(DataChannel::Time))
+    {
+      imp.timestamps.emplace_back((timestamps) ? timestamps[i] : 0.0);
+    }
+    if (imp.hasChannel(DataChannel::Intensity))
+    {
+      imp.intensities.emplace_back((intensities) ? intensities[i] : 0.0f);
+    }
+    if (imp.hasChannel(DataChannel::ReturnNumber))
+    {
+      imp.return_numbers.emplace_back((return_numbers) ? return_numbers[i] : uint8_t(0u));
+    }
+
+    if (imp.pendingCount() >= imp.chunk_size)
+    {
+      flushChunk();
+    }
+  }
+
+  return imp.ok;
+}
+
+
+uint64_t OhmRaysWriter::rayCount() const
+{
+  return imp_->ray_count + imp_->pendingCount();
+}
+
+
+bool OhmRaysWriter::flushChunk()
+{
+  OhmRaysWriterDetail &imp = *imp_;
+  const size_t ray_count = imp.pendingCount();
+  if (ray_count == 0)
+  {
+    return imp.ok;
+  }
+
+  imp.payload.clear();
+  imp.appendColumn(imp.rays);
+  imp.appendColumn(imp.timestamps);
+  imp.appendColumn(imp.intensities);
+  imp.appendColumn(imp.return_numbers);
+
+  const uint8_t *payload = imp.payload.data();
+  uint64_t payload_size = imp.payload.size();
+  if (imp.codec != ohmrays::kCodecNone)
+  {
+    if (!imp.compressPayload())
+    {
+      imp.ok = false;
+      return false;
+    }
+    payload = imp.compressed.data();
+    payload_size = imp.compressed.size();
+  }
+
+  ohmrays::ChunkHeader header{};
+  header.marker = ohmrays::kChunkMarker;
+  header.ray_count = uint32_t(ray_count);
+  header.origin[0] = imp.chunk_origin.x;
+  header.origin[1] = imp.chunk_origin.y;
+  header.origin[2] = imp.chunk_origin.z;
+  header.payload_size = payload_size;
+  header.uncompressed_size = imp.payload.size();
+
+  ohmrays::IndexEntry entry{};
+  entry.offset = imp.file_offset;
+  entry.ray_count = ray_count;
+  entry.time_first = (!imp.timestamps.empty()) ? imp.timestamps.front() : 0.0;
+  entry.time_last = (!imp.timestamps.empty()) ? imp.timestamps.back() : 0.0;
+  imp.index.emplace_back(entry);
+
+  imp.write(&header, sizeof(header));
+  imp.write(payload, size_t(payload_size));
+  imp.ray_count += ray_count;
+
+  imp.rays.clear();
+  imp.timestamps.clear();
+  imp.intensities.clear();
+  imp.return_numbers.clear();
+
+  return imp.ok;
+}
+}  // namespace slamio
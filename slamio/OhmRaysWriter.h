@@ -0,0 +1,103 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef SLAMIO_OHMRAYSWRITER_H_
+#define SLAMIO_OHMRAYSWRITER_H_
+
+#include "SlamIOConfig.h"
+
+#include "DataChannel.h"
+#include "OhmRaysFormat.h"
+
+#include <glm/vec3.hpp>
+
+#include <memory>
+
+namespace slamio
+{
+struct OhmRaysWriterDetail;
+
+/// Writes a compact, chunked binary ray cloud file, conventionally with an `.ohmrays` extension. These files are read
+/// by @c PointCloudReaderOhmRays .
+///
+/// Rays are buffered into chunks, each storing its rays in columns. Ray origin and sample coordinates are stored as
+/// single precision values relative to a double precision chunk origin, alongside optional timestamps, intensities
+/// and return numbers. Chunk payloads may be compressed. An index of the chunks is written on @c close() .
+///
+/// Typical usage:
+/// - @c open() the file, selecting the optional channels to write.
+/// - Call @c writeRay() or @c writeRays() as required.
+/// - @c close() the file to finalise the index.
+class slamio_API OhmRaysWriter
+{
+public:
+  /// Default number of rays in each chunk.
+  static constexpr unsigned kDefaultChunkSize = 65536u;
+
+  /// Constructor.
+  OhmRaysWriter();
+  /// Destructor - calls @c close() .
+  ~OhmRaysWriter();
+
+  /// Open @p filename for writing.
+  /// @param filename The file to write.
+  /// @param channels The optional channels to write. Only @c DataChannel::Time , @c DataChannel::Intensity and
+  ///   @c DataChannel::ReturnNumber are considered.
+  /// @param compress True to zlib compress chunk payloads.
+  /// @param chunk_size Number of rays in each chunk.
+  /// @return True on success.
+  bool open(const char *filename, DataChannel channels = DataChannel::Time, bool compress = true,
+            unsigned chunk_size = kDefaultChunkSize);
+
+  /// Open @p filename for writing chunk payloads with the given @p codec .
+  /// @param filename The file to write.
+  /// @param channels The optional channels to write. See other overload.
+  /// @param codec The chunk payload codec. Fails if the codec is not @c ohmrays::codecSupported() .
+  /// @param chunk_size Number of rays in each chunk.
+  /// @return True on success.
+  bool open(const char *filename, DataChannel channels, ohmrays::Codec codec, unsigned chunk_size = kDefaultChunkSize);
+
+  /// Is the file open?
+  /// @return True when open.
+  bool isOpen() const;
+
+  /// Flush pending rays, write the index and close the file.
+  /// @return True on success, false if writing has failed.
+  bool close();
+
+  /// Write a single ray.
+  /// @param origin The ray origin (sensor position).
+  /// @param sample The ray end point (sample position).
+  /// @param timestamp The ray timestamp.
+  /// @param intensity The sample intensity.
+  /// @param return_number The sample return number.
+  /// @return False if writing has failed.
+  bool writeRay(const glm::dvec3 &origin, const glm::dvec3 &sample, double timestamp = 0, float intensity = 0,
+                uint8_t return_number = 0);
+
+  /// Write multiple rays.
+  /// @param rays Ray origin and sample pairs, as used by @c ohm::RayMapper::integrateRays() . Element count is
+  ///   @c 2 * ray_count .
+  /// @param ray_count Number of rays to write.
+  /// @param timestamps Optional per ray timestamps.
+  /// @param intensities Optional per ray intensities.
+  /// @param return_numbers Optional per ray return numbers.
+  /// @return False if writing has failed.
+  bool writeRays(const glm::dvec3 *rays, size_t ray_count, const double *timestamps = nullptr,
+                 const float *intensities = nullptr, const uint8_t *return_numbers = nullptr);
+
+  /// Query the number of rays written.
+  /// @return The ray count.
+  uint64_t rayCount() const;
+
+private:
+  /// Write the pending chunk.
+  bool flushChunk();
+
+  std::unique_ptr<OhmRaysWriterDetail> imp_;
+};
+}  // namespace slamio
+
+#endif  // SLAMIO_OHMRAYSWRITER_H_
@@ -0,0 +1,412 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "PointCloudReaderOhmRays.h"
+
+#include "OhmRaysFormat.h"
+
+#include <zlib.h>
+
+#if SLAMIO_HAVE_LZ4
+#include <lz4.h>
+#endif  // SLAMIO_HAVE_LZ4
+#if SLAMIO_HAVE_ZSTD
+#include <zstd.h>
+#endif  // SLAMIO_HAVE_ZSTD
+
+#include <cstdio>
+#include <cstring>
+
+namespace slamio
+{
+namespace
+{
+using FilePtr = std::unique_ptr<FILE, int (*)(FILE *)>;
+
+bool seekFile(FILE *file, uint64_t offset, int origin = SEEK_SET)
+{
+#ifdef _WIN32
+  return _fseeki64(file, int64_t(offset), origin) == 0;
+#else   // _WIN32
+  return fseeko(file, off_t(offset), origin) == 0;
+#endif  // _WIN32
+}
+
+uint64_t tellFile(FILE *file)
+{
+#ifdef _WIN32
+  return uint64_t(_ftelli64(file));
+#else   // _WIN32
+  return uint64_t(ftello(file));
+#endif  // _WIN32
+}
+
+template <typename T>
+bool readValue(FILE *file, T &value)
+{
+  return std::fread(&value, sizeof(value), 1, file) == 1;
+}
+
+/// Decompress a chunk payload stored with @p codec . The @p payload must be sized to the expected uncompressed size.
+/// @return True if the @p stored data decompress to exactly fill the @p payload .
+bool decompressPayload(uint16_t codec, const std::vector<uint8_t> &stored, std::vector<uint8_t> &payload)
+{
+  switch (codec)
+  {
+  case ohmrays::kCodecZlib:
+  {
+    uLongf uncompressed_size = uLongf(payload.size());
+    return uncompress(payload.data(), &uncompressed_size, stored.data(), uLong(stored.size())) == Z_OK &&
+           uncompressed_size == payload.size();
+  }
+#if SLAMIO_HAVE_LZ4
+  case ohmrays::kCodecLz4:
+  {
+    if (stored.size() > size_t(LZ4_MAX_INPUT_SIZE) || payload.size() > size_t(LZ4_MAX_INPUT_SIZE))
+    {
+      return false;
+    }
+    const int uncompressed_size =
+      LZ4_decompress_safe(reinterpret_cast<const char *>(stored.data()), reinterpret_cast<char *>(payload.data()),
+                          int(stored.size()), int(payload.size()));
+    return uncompressed_size >= 0 && size_t(uncompressed_size) == payload.size();
+  }
+#endif  // SLAMIO_HAVE_LZ4
+#if SLAMIO_HAVE_ZSTD
+  case ohmrays::kCodecZstd:
+  {
+    const size_t uncompressed_size = ZSTD_decompress(payload.data(), payload.size(), stored.data(), stored.size());
+    return !ZSTD_isError(uncompressed_size) && uncompressed_size == payload.size();
+  }
+#endif  // SLAMIO_HAVE_ZSTD
+  default:
+    break;
+  }
+  return false;
+}
+
+/// Extract a column of @p count items of type @c T from @p payload at @p offset , advancing the offset.
+template <typename T>
+void readColumn(const std::vector<uint8_t> &payload, size_t &offset, size_t count, std::vector<T> &column)
+{
+  column.resize(count);
+  if (count)
+  {
+    std::memcpy(column.data(), payload.data() + offset, count * sizeof(T));
+  }
+  offset += count * sizeof(T);
+}
+}  // namespace
+
+
+struct PointCloudReaderOhmRaysDetail
+{
+  FilePtr file{ nullptr, &fclose };
+  ohmrays::FileHeader header{};
+  std::vector<ohmrays::IndexEntry> index;
+  uint64_t ray_count = 0;
+  /// Next chunk to read.
+  size_t next_chunk = 0;
+  DataChannel available_channels = DataChannel::None;
+  DataChannel desired_channels = DataChannel::None;
+
+  /// Chunk decoded for @c readNext() and @c readChunk() .
+  OhmRaysChunk current;
+  /// Index of the next ray in @c current .
+  size_t current_next = 0;
+
+  std::vector<uint8_t> stored;
+  std::vector<uint8_t> payload;
+  std::vector<float> relative_rays;
+
+  inline bool extract(DataChannel channel) const
+  {
+    return (available_channels & channel) != DataChannel::None &&
+           (desired_channels == DataChannel::None || (desired_channels & channel) != DataChannel::None);
+  }
+
+  /// Build the chunk index by scanning the chunk headers. Used when the footer is missing, such as for a file which
+  /// was not closed.
+  void scanIndex(uint64_t file_size)
+  {
+    index.clear();
+    ray_count = 0;
+    uint64_t offset = sizeof(ohmrays::FileHeader);
+    ohmrays::ChunkHeader chunk_header{};
+    while (offset + sizeof(chunk_header) <= file_size && seekFile(file.get(), offset) &&
+           readValue(file.get(), chunk_header) && chunk_header.marker == ohmrays::kChunkMarker &&
+           offset + sizeof(chunk_header) + chunk_header.payload_size <= file_size)
+    {
+      ohmrays::IndexEntry entry{};
+      entry.offset = offset;
+      entry.ray_count = chunk_header.ray_count;
+      index.emplace_back(entry);
+      ray_count += chunk_header.ray_count;
+      offset += sizeof(chunk_header) + chunk_header.payload_size;
+    }
+  }
+};
+
+
+PointCloudReaderOhmRays::PointCloudReaderOhmRays()
+  : imp_(std::make_unique<PointCloudReaderOhmRaysDetail>())
+{}
+
+
+PointCloudReaderOhmRays::~PointCloudReaderOhmRays()
+{
+  close();
+}
+
+
+DataChannel PointCloudReaderOhmRays::availableChannels() const
+{
+  return imp_->available_channels;
+}
+
+
+DataChannel PointCloudReaderOhmRays::desiredChannels() const
+{
+  return imp_->desired_channels;
+}
+
+
+void PointCloudReaderOhmRays::setDesiredChannels(DataChannel channels)
+{
+  imp_->desired_channels = channels;
+}
+
+
+bool PointCloudReaderOhmRays::isOpen()
+{
+  return imp_->file != nullptr;
+}
+
+
+bool PointCloudReaderOhmRays::open(const char *filename)
+{
+  close();
+  PointCloudReaderOhmRaysDetail &imp = *imp_;
+  imp.file.reset(std::fopen(filename, "rb"));
+  if (!imp.file)
+  {
+    return false;
+  }
+
+  if (!readValue(imp.file.get(), imp.header) || imp.header.marker != ohmrays::kFileMarker ||
+      imp.header.version > ohmrays::kVersion ||
+      !ohmrays::codecSupported(imp.header.codec))
+  {
+    close();
+    return false;
+  }
+
+  // Read the index via the footer.
+  seekFile(imp.file.get(), 0, SEEK_END);
+  const uint64_t file_size = tellFile(imp.file.get());
+  ohmrays::Footer footer{};
+  bool have_index = false;
+  if (file_size >= sizeof(ohmrays::FileHeader) + sizeof(footer) &&
+      seekFile(imp.file.get(), file_size - sizeof(footer)) && readValue(imp.file.get(), footer) &&
+      footer.marker == ohmrays::kFooterMarker &&
+      footer.index_offset + footer.chunk_count * sizeof(ohmrays::IndexEntry) + sizeof(footer) == file_size)
+  {
+    imp.index.resize(size_t(footer.chunk_count));
+    have_index = seekFile(imp.file.get(), footer.index_offset) &&
+                 (imp.index.empty() || std::fread(imp.index.data(), sizeof(ohmrays::IndexEntry), imp.index.size(),
+                                                  imp.file.get()) == imp.index.size());
+    imp.ray_count = footer.ray_count;
+  }
+
+  if (!have_index)
+  {
+    imp.scanIndex(file_size);
+  }
+
+  imp.available_channels = DataChannel::Position | DataChannel::Normal |
+                           (DataChannel(imp.header.channels) &
+                            (DataChannel::Time | DataChannel::Intensity | DataChannel::ReturnNumber));
+  return seekChunk(0);
+}
+
+
+void PointCloudReaderOhmRays::close()
+{
+  imp_->file.reset();
+  imp_->index.clear();
+  imp_->ray_count = 0;
+  imp_->next_chunk = 0;
+  imp_->available_channels = DataChannel::None;
+  imp_->current = OhmRaysChunk{};
+  imp_->current_next = 0;
+}
+
+
+bool PointCloudReaderOhmRays::streaming() const
+{
+  return true;
+}
+
+
+uint64_t PointCloudReaderOhmRays::pointCount() const
+{
+  return imp_->ray_count;
+}
+
+
+bool PointCloudReaderOhmRays::readNext(CloudPoint &point)
+{
+  return readChunk(&point, 1) == 1;
+}
+
+
+uint64_t PointCloudReaderOhmRays::readChunk(CloudPoint *point, uint64_t count)
+{
+  PointCloudReaderOhmRaysDetail &imp = *imp_;
+  uint64_t read_count = 0;
+  while (read_count < count)
+  {
+    if (imp.current_next >= imp.current.rayCount())
+    {
+      if (!readRays(imp.current))
+      {
+        break;
+      }
+      imp.current_next = 0;
+    }
+
+    const OhmRaysChunk &chunk = imp.current;
+    const bool have_time = !chunk.timestamps.empty();
+    const bool have_intensity = !chunk.intensities.empty();
+    const bool have_return_number = !chunk.return_numbers.empty();
+    for (; read_count < count && imp.current_next < chunk.rayCount(); ++read_count, ++imp.current_next)
+    {
+      const size_t i = imp.current_next;
+      CloudPoint &pt = point[read_count];
+      pt = {};
+      pt.position = chunk.rays[i * 2 + 1];
+      // Ray cloud convention: the normal is the vector from the sample back to the ray origin.
+      pt.normal = chunk.rays[i * 2 + 0] - chunk.rays[i * 2 + 1];
+      pt.timestamp = (have_time) ? chunk.timestamps[i] : 0.0;
+      pt.intensity = (have_intensity) ? chunk.intensities[i] : 0.0f;
+      pt.return_number = (have_return_number) ? chunk.return_numbers[i] : 0u;
+    }
+  }
+
+  return read_count;
+}
+
+
+size_t PointCloudReaderOhmRays::chunkCount() const
+{
+  return imp_->index.size();
+}
+
+
+bool PointCloudReaderOhmRays::seekChunk(size_t chunk_index)
+{
+  PointCloudReaderOhmRaysDetail &imp = *imp_;
+  if (!imp.file || chunk_index > imp.index.size())
+  {
+    return false;
+  }
+
+  imp.next_chunk = chunk_index;
+  imp.current_next = imp.current.rayCount();
+  return chunk_index == imp.index.size() || seekFile(imp.file.get(), imp.index[chunk_index].offset);
+}
+
+
+bool PointCloudReaderOhmRays::readRays(OhmRaysChunk &chunk)
+{
+  PointCloudReaderOhmRaysDetail &imp = *imp_;
+  if (!imp.file || imp.next_chunk >= imp.index.size())
+  {
+    return false;
+  }
+
+  // Skip the remainder of the current chunk.
+  imp.current_next = imp.current.rayCount();
+
+  ohmrays::ChunkHeader header{};
+  if (!readValue(imp.file.get(), header) || header.marker != ohmrays::kChunkMarker)
+  {
+    return false;
+  }
+
+  const DataChannel file_channels = DataChannel(imp.header.channels);
+  if (header.uncompressed_size != ohmrays::payloadSize(header.ray_count, file_channels))
+  {
+    return false;
+  }
+
+  imp.stored.resize(size_t(header.payload_size));
+  if (!imp.stored.empty() && std::fread(imp.stored.data(), 1, imp.stored.size(), imp.file.get()) != imp.stored.size())
+  {
+    return false;
+  }
+  ++imp.next_chunk;
+
+  const std::vector<uint8_t> *payload = &imp.stored;
+  if (imp.header.codec != ohmrays::kCodecNone)
+  {
+    imp.payload.resize(size_t(header.uncompressed_size));
+    if (!decompressPayload(imp.header.codec, imp.stored, imp.payload))
+    {
+      return false;
+    }
+    payload = &imp.payload;
+  }
+  else if (header.payload_size != header.uncompressed_size)
+  {
+    return false;
+  }
+
+  const size_t ray_count = header.ray_count;
+  size_t offset = 0;
+  readColumn(*payload, offset, ray_count * 6u, imp.relative_rays);
+
+  // Restore absolute ray coordinates. This is the only conversion required for ray integration.
+  const glm::dvec3 chunk_origin(header.origin[0], header.origin[1], header.origin[2]);
+  chunk.rays.resize(ray_count * 2u);
+  const float *relative = imp.relative_rays.data();
+  for (size_t i = 0; i < ray_count * 2u; ++i)
+  {
+    chunk.rays[i] = chunk_origin + glm::dvec3(relative[i * 3 + 0], relative[i * 3 + 1], relative[i * 3 + 2]);
+  }
+
+  chunk.timestamps.clear();
+  chunk.intensities.clear();
+  chunk.return_numbers.clear();
+  if ((file_channels & DataChannel::Time) != DataChannel::None)
+  {
+    if (imp.extract(DataChannel::Time))
+    {
+      readColumn(*payload, offset, ray_count, chunk.timestamps);
+    }
+    else
+    {
+      offset += ray_count * sizeof(double);
+    }
+  }
+  if ((file_channels & DataChannel::Intensity) != DataChannel::None)
+  {
+    if (imp.extract(DataChannel::Intensity))
+    {
+      readColumn(*payload, offset, ray_count, chunk.intensities);
+    }
+    else
+    {
+      offset += ray_count * sizeof(float);
+    }
+  }
+  if ((file_channels & DataChannel::ReturnNumber) != DataChannel::None && imp.extract(DataChannel::ReturnNumber))
+  {
+    readColumn(*payload, offset, ray_count, chunk.return_numbers);
+  }
+
+  return true;
+}
+}  // namespace slamio
@@ -0,0 +1,87 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef SLAMIO_POINTCLOUDREADEROHMRAYS_H_
+#define SLAMIO_POINTCLOUDREADEROHMRAYS_H_
+
+#include "SlamIOConfig.h"
+
+#include "PointCloudReader.h"
+
+#include <glm/vec3.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace slamio
+{
+struct PointCloudReaderOhmRaysDetail;
+
+/// Ray data decoded from a chunk of an ohm rays file into contiguous arrays.
+///
+/// The @c rays array may be passed directly to @c ohm::RayMapper::integrateRays() or @c ohm::GpuMap::integrateRays()
+/// along with the @c timestamps and @c intensities .
+struct OhmRaysChunk
+{
+  /// Ray origin and sample pairs.
+  std::vector<glm::dvec3> rays;
+  /// Per ray timestamps. Empty when not available.
+  std::vector<double> timestamps;
+  /// Per ray intensities. Empty when not available.
+  std::vector<float> intensities;
+  /// Per ray return numbers. Empty when not available.
+  std::vector<uint8_t> return_numbers;
+
+  /// Query the number of rays in the chunk.
+  /// @return The ray count.
+  inline size_t rayCount() const { return rays.size() / 2u; }
+};
+
+/// Reader for compact binary ray clouds written by @c OhmRaysWriter , conventionally with an `.ohmrays` extension.
+///
+/// As a @c PointCloudReader this presents a ray cloud where the @c CloudPoint::normal is the vector from the sample
+/// back to the ray origin. For bulk loading, @c readRays() decodes a whole file chunk into contiguous ray arrays
+/// without any per point conversion to @c CloudPoint .
+class slamio_API PointCloudReaderOhmRays : public PointCloudReader
+{
+public:
+  PointCloudReaderOhmRays();
+  ~PointCloudReaderOhmRays();
+
+  DataChannel availableChannels() const override;
+  DataChannel desiredChannels() const override;
+  void setDesiredChannels(DataChannel channels) override;
+
+  bool isOpen() override;
+  bool open(const char *filename) override;
+  void close() override;
+
+  bool streaming() const override;
+
+  uint64_t pointCount() const override;
+  bool readNext(CloudPoint &point) override;
+  uint64_t readChunk(CloudPoint *point, uint64_t count) override;
+
+  /// Query the number of chunks in the file.
+  /// @return The chunk count.
+  size_t chunkCount() const;
+
+  /// Move to the start of the chunk at @p chunk_index using the file index.
+  /// @param chunk_index The chunk index to seek to, in the range `[0, chunkCount()]` .
+  /// @return True on success.
+  bool seekChunk(size_t chunk_index);
+
+  /// Read and decode the next file chunk into @p chunk . This skips any rays of the current chunk which have not been
+  /// read by @c readNext() or @c readChunk() .
+  /// @param chunk The chunk data structure to decode into. Arrays are resized as required.
+  /// @return True on success, false at the end of the file or on failure.
+  bool readRays(OhmRaysChunk &chunk);
+
+private:
+  std::unique_ptr<PointCloudReaderOhmRaysDetail> imp_;
+};
+}  // namespace slamio
+
+#endif  // SLAMIO_POINTCLOUDREADEROHMRAYS_H_
@@ -10,8 +10,20 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SLAMIO_PLY_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // defined(__unix__) || defined(__APPLE__)
 
 namespace
 {
@@ -186,6 +198,440 @@ double scaleFactorForType(e_ply_type type)
   }
   return 1.0;
 }
+
+
+/// Resolve the @c PlyProperty to read for a vertex property.
+/// @param name_lower The vertex property name in lower case.
+/// @param desired_channels The channels to read. Properties for other channels are not resolved.
+/// @param time_fields Candidate time field names.
+/// @param return_number_fields Candidate return number field names.
+/// @param[out] property Set to the resolved property.
+/// @param[out] normalised Set to true if the property value is normalised by the range of integer types.
+/// @return True if the property is to be read.
+bool resolveProperty(const std::string &name_lower, slamio::DataChannel desired_channels,
+                     const std::vector<std::string> &time_fields, const std::vector<std::string> &return_number_fields,
+                     slamio::PointCloudReaderPly::PlyProperty &property, bool &normalised)
+{
+  using slamio::DataChannel;
+  using PlyProperty = slamio::PointCloudReaderPly::PlyProperty;
+  const auto desired = [desired_channels](DataChannel channel) {
+    return (desired_channels & channel) != DataChannel::None;
+  };
+
+  normalised = false;
+  if (isOneOf(name_lower, time_fields) && desired(DataChannel::Time))
+  {
+    property = PlyProperty::kTimestamp;
+  }
+  else if (isOneOf(name_lower, "x") && desired(DataChannel::Position))
+  {
+    property = PlyProperty::kX;
+  }
+  else if (isOneOf(name_lower, "y") && desired(DataChannel::Position))
+  {
+    property = PlyProperty::kY;
+  }
+  else if (isOneOf(name_lower, "z") && desired(DataChannel::Position))
+  {
+    property = PlyProperty::kZ;
+  }
+  else if (isOneOf(name_lower, { "nx", "normal_x" }) && desired(DataChannel::Normal))
+  {
+    property = PlyProperty::kNX;
+  }
+  else if (isOneOf(name_lower, { "ny", "normal_y" }) && desired(DataChannel::Normal))
+  {
+    property = PlyProperty::kNY;
+  }
+  else if (isOneOf(name_lower, { "nz", "normal_z" }) && desired(DataChannel::Normal))
+  {
+    property = PlyProperty::kNZ;
+  }
+  else if (isOneOf(name_lower, { "red", "r" }) && desired(DataChannel::ColourRgb))
+  {
+    property = PlyProperty::kR;
+    normalised = true;
+  }
+  else if (isOneOf(name_lower, { "green", "g" }) && desired(DataChannel::ColourRgb))
+  {
+    property = PlyProperty::kG;
+    normalised = true;
+  }
+  else if (isOneOf(name_lower, { "blue", "b" }) && desired(DataChannel::ColourRgb))
+  {
+    property = PlyProperty::kB;
+    normalised = true;
+  }
+  else if (isOneOf(name_lower, { "alpha", "a" }) && desired(DataChannel::ColourAlpha))
+  {
+    property = PlyProperty::kA;
+    normalised = true;
+  }
+  else if (isOneOf(name_lower, "intensity") && desired(DataChannel::Intensity))
+  {
+    property = PlyProperty::kIntensity;
+    normalised = true;
+  }
+  else if (isOneOf(name_lower, return_number_fields) && desired(DataChannel::ReturnNumber))
+  {
+    property = PlyProperty::kReturnNumber;
+    normalised = true;
+  }
+  else
+  {
+    return false;
+  }
+
+  return true;
+}
+
+
+/// Resolve the available data channels from @c PointCloudReaderPly::ReadSampleData::have_property_flags .
+slamio::DataChannel availableChannelsFromFlags(unsigned property_flags)
+{
+  using slamio::DataChannel;
+  using PlyProperty = slamio::PointCloudReaderPly::PlyProperty;
+  DataChannel available_channels = DataChannel::None;
+  if (haveProperty(property_flags, PlyProperty::kTimestamp))
+  {
+    available_channels |= DataChannel::Time;
+  }
+  if (haveProperty(property_flags, PlyProperty::kX) && haveProperty(property_flags, PlyProperty::kY) &&
+      haveProperty(property_flags, PlyProperty::kZ))
+  {
+    available_channels |= DataChannel::Position;
+  }
+  if (haveProperty(property_flags, PlyProperty::kNX) && haveProperty(property_flags, PlyProperty::kNY) &&
+      haveProperty(property_flags, PlyProperty::kNZ))
+  {
+    available_channels |= DataChannel::Normal;
+  }
+  if (haveProperty(property_flags, PlyProperty::kR) && haveProperty(property_flags, PlyProperty::kG) &&
+      haveProperty(property_flags, PlyProperty::kB))
+  {
+    available_channels |= DataChannel::ColourRgb;
+  }
+  if (haveProperty(property_flags, PlyProperty::kA))
+  {
+    available_channels |= DataChannel::ColourAlpha;
+  }
+  if (haveProperty(property_flags, PlyProperty::kIntensity))
+  {
+    available_channels |= DataChannel::Intensity;
+  }
+  if (haveProperty(property_flags, PlyProperty::kReturnNumber))
+  {
+    available_channels |= DataChannel::ReturnNumber;
+  }
+  return available_channels;
+}
+}  // namespace
+
+namespace slamio
+{
+/// Native reader for memory mapped, binary little endian PLY vertex data.
+struct PlyBinaryVertices
+{
+  /// Describes a vertex property to decode.
+  struct Column
+  {
+    /// Property byte offset within a vertex.
+    size_t offset = 0;
+    /// Property data type.
+    e_ply_type type = PLY_FLOAT64;
+    /// Scale factor applied after conversion to double.
+    double scale = 1.0;
+  };
+
+  /// Mapped file content.
+  const uint8_t *mapped = nullptr;
+  /// Size of @c mapped .
+  size_t mapped_size = 0;
+  /// Start of the vertex element data.
+  const uint8_t *vertices = nullptr;
+  /// Byte size of each vertex.
+  size_t vertex_stride = 0;
+  /// Number of vertices.
+  uint64_t vertex_count = 0;
+  /// The properties to decode and their columns.
+  std::vector<std::pair<PointCloudReaderPly::PlyProperty, Column>> columns;
+  /// Property flags matching @c PointCloudReaderPly::ReadSampleData::have_property_flags .
+  unsigned have_property_flags = 0;
+  /// Decoding buffer for a column of values.
+  std::vector<double> column_values;
+
+  PlyBinaryVertices() = default;
+  PlyBinaryVertices(const PlyBinaryVertices &) = delete;
+  PlyBinaryVertices &operator=(const PlyBinaryVertices &) = delete;
+
+  ~PlyBinaryVertices()
+  {
+#ifdef SLAMIO_PLY_MMAP
+    if (mapped)
+    {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+      munmap(const_cast<uint8_t *>(mapped), mapped_size);
+    }
+#endif  // SLAMIO_PLY_MMAP
+  }
+};
+}  // namespace slamio
+
+namespace
+{
+/// Resolve the byte size of a PLY type.
+size_t plyTypeSize(e_ply_type type)
+{
+  switch (type)
+  {
+  case PLY_INT8:
+  case PLY_UINT8:
+  case PLY_CHAR:
+  case PLY_UCHAR:
+    return 1;
+  case PLY_INT16:
+  case PLY_UINT16:
+  case PLY_SHORT:
+  case PLY_USHORT:
+    return 2;
+  case PLY_INT32:
+  case PLY_UIN32:
+  case PLY_FLOAT32:
+  case PLY_INT:
+  case PLY_UINT:
+  case PLY_FLOAT:
+    return 4;
+  case PLY_FLOAT64:
+  case PLY_DOUBLE:
+    return 8;
+  default:
+    break;
+  }
+  return 0;
+}
+
+
+/// Parse a PLY type name, returning @c PLY_LIST for unknown types.
+e_ply_type plyTypeFromName(const std::string &name)
+{
+  // Order matches e_ply_type.
+  static const char *const type_names[] = { "int8",  "uint8", "int16",  "uint16", "int32",  "uint32",
+                                            "float32", "float64", "char", "uchar", "short", "ushort",
+                                            "int",   "uint",  "float",  "double" };
+  for (unsigned i = 0; i < unsigned(PLY_LIST); ++i)
+  {
+    if (name == type_names[i])
+    {
+      return e_ply_type(i);
+    }
+  }
+  return PLY_LIST;
+}
+
+
+/// Decode a column of @p count values of type @c T from vertices of @p stride bytes, converting to double.
+///
+/// The loop is a simple strided gather which the compiler may vectorise.
+template <typename T>
+void decodeColumn(const uint8_t *src, size_t stride, size_t count, double scale, double *dst)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    T value;
+    std::memcpy(&value, src + i * stride, sizeof(value));
+    dst[i] = double(value) * scale;
+  }
+}
+
+
+/// Decode a column of @p count values of the given PLY @p type .
+void decodeColumn(e_ply_type type, const uint8_t *src, size_t stride, size_t count, double scale, double *dst)
+{
+  switch (type)
+  {
+  case PLY_INT8:
+  case PLY_CHAR:
+    decodeColumn<int8_t>(src, stride, count, scale, dst);
+    break;
+  case PLY_UINT8:
+  case PLY_UCHAR:
+    decodeColumn<uint8_t>(src, stride, count, scale, dst);
+    break;
+  case PLY_INT16:
+  case PLY_SHORT:
+    decodeColumn<int16_t>(src, stride, count, scale, dst);
+    break;
+  case PLY_UINT16:
+  case PLY_USHORT:
+    decodeColumn<uint16_t>(src, stride, count, scale, dst);
+    break;
+  case PLY_INT32:
+  case PLY_INT:
+    decodeColumn<int32_t>(src, stride, count, scale, dst);
+    break;
+  case PLY_UIN32:
+  case PLY_UINT:
+    decodeColumn<uint32_t>(src, stride, count, scale, dst);
+    break;
+  case PLY_FLOAT32:
+  case PLY_FLOAT:
+    decodeColumn<float>(src, stride, count, scale, dst);
+    break;
+  case PLY_FLOAT64:
+  case PLY_DOUBLE:
+    decodeColumn<double>(src, stride, count, scale, dst);
+    break;
+  default:
+    break;
+  }
+}
+
+
+bool hostIsLittleEndian()
+{
+  const uint16_t probe = 1u;
+  uint8_t first_byte = 0;
+  std::memcpy(&first_byte, &probe, 1);
+  return first_byte == 1u;
+}
+
+
+/// Parse the PLY header from @p binary mapped memory, resolving the vertex columns to read for @p desired_channels .
+/// Fails unless the file is binary little endian with fixed size vertices preceded only by fixed size elements.
+bool parseBinaryHeader(slamio::PlyBinaryVertices &binary, slamio::DataChannel desired_channels)
+{
+  const char *const header = reinterpret_cast<const char *>(binary.mapped);  // NOLINT
+  const char *const header_end = header + binary.mapped_size;
+  const char *line = header;
+
+  std::vector<std::string> time_fields;
+  size_t field_name_count = 0;
+  const auto *time_field_names = slamio::timeFieldNames(field_name_count);
+  time_fields.assign(time_field_names, time_field_names + field_name_count);
+
+  std::vector<std::string> return_number_fields;
+  field_name_count = 0;
+  const auto *return_number_field_names = slamio::returnNumberFieldNames(field_name_count);
+  return_number_fields.assign(return_number_field_names, return_number_field_names + field_name_count);
+
+  bool have_format = false;
+  bool in_vertex = false;
+  bool have_vertex = false;
+  bool element_fixed_size = true;
+  uint64_t element_count = 0;
+  size_t element_stride = 0;
+  // Byte offset of the vertex data from the end of the header.
+  uint64_t vertex_data_offset = 0;
+  std::string token;
+
+  while (line < header_end)
+  {
+    const char *line_end = static_cast<const char *>(std::memchr(line, '\n', size_t(header_end - line)));
+    if (!line_end)
+    {
+      return false;
+    }
+
+    std::istringstream istr(std::string(line, line_end));
+    line = line_end + 1;
+    istr >> token;
+
+    if (token == "ply" || token == "comment" || token == "obj_info")
+    {
+      continue;
+    }
+
+    if (token == "format")
+    {
+      istr >> token;
+      if (token != "binary_little_endian")
+      {
+        return false;
+      }
+      have_format = true;
+    }
+    else if (token == "element" || token == "end_header")
+    {
+      // Finalise the previous element.
+      if (in_vertex)
+      {
+        binary.vertex_count = element_count;
+        binary.vertex_stride = element_stride;
+        have_vertex = true;
+      }
+      else if (!have_vertex)
+      {
+        if (!element_fixed_size)
+        {
+          return false;
+        }
+        vertex_data_offset += element_count * element_stride;
+      }
+
+      if (token == "end_header")
+      {
+        if (!have_format || !have_vertex)
+        {
+          return false;
+        }
+        binary.vertices = reinterpret_cast<const uint8_t *>(line) + vertex_data_offset;  // NOLINT
+        const uint64_t vertex_bytes = binary.vertex_count * binary.vertex_stride;
+        return uint64_t(header_end - line) >= vertex_data_offset + vertex_bytes;
+      }
+
+      std::string element_name;
+      istr >> element_name >> element_count;
+      in_vertex = element_name == "vertex";
+      element_fixed_size = true;
+      element_stride = 0;
+    }
+    else if (token == "property")
+    {
+      std::string type_name;
+      std::string property_name;
+      istr >> type_name >> property_name;
+      const e_ply_type type = plyTypeFromName(type_name);
+      if (type == PLY_LIST)
+      {
+        // List or unknown type. Vertices must be fixed size, but other elements may be skipped if they are before the
+        // vertices.
+        element_fixed_size = false;
+        if (in_vertex)
+        {
+          return false;
+        }
+        continue;
+      }
+
+      if (in_vertex)
+      {
+        std::string property_name_lower = property_name;
+        std::transform(property_name_lower.begin(), property_name_lower.end(), property_name_lower.begin(),
+                       [](const unsigned char ch) { return std::tolower(ch); });
+        slamio::PointCloudReaderPly::PlyProperty property_id{};
+        bool normalised = false;
+        if (resolveProperty(property_name_lower, desired_channels, time_fields, return_number_fields, property_id,
+                            normalised))
+        {
+          slamio::PlyBinaryVertices::Column column;
+          column.offset = element_stride;
+          column.type = type;
+          column.scale = (normalised) ? scaleFactorForType(type) : 1.0;
+          binary.columns.emplace_back(property_id, column);
+          binary.have_property_flags |= (1u << unsigned(property_id));
+        }
+      }
+
+      element_stride += plyTypeSize(type);
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return false;
+}
 }  // namespace
 
 namespace slamio
@@ -216,13 +662,18 @@ void PointCloudReaderPly::setDesiredChannels(DataChannel channels)
 
 bool PointCloudReaderPly::isOpen()
 {
-  return ply_handle_->ply.get() != nullptr;
+  return binary_ != nullptr || ply_handle_->ply.get() != nullptr;
 }
 
 bool PointCloudReaderPly::open(const char *filename)
 {
   close();
 
+  if (openBinary(filename))
+  {
+    return true;
+  }
+
   if (!ply_handle_->open(filename))
   {
     close();
@@ -243,6 +694,10 @@ bool PointCloudReaderPly::open(const char *filename)
 void PointCloudReaderPly::close()
 {
   ply_handle_->close();
+  binary_.reset();
+  read_ahead_.clear();
+  read_ahead_next_ = 0;
+  next_point_index_ = 0;
   read_sample_.sample = {};
   point_count_ = 0;
   available_channels_ = DataChannel::None;
@@ -260,6 +715,25 @@ uint64_t PointCloudReaderPly::pointCount() const
 
 bool PointCloudReaderPly::readNext(CloudPoint &point)
 {
+  if (binary_)
+  {
+    // Decode ahead to amortise the per column overheads.
+    if (read_ahead_next_ >= read_ahead_.size())
+    {
+      const size_t read_ahead_size = 1024u;
+      read_ahead_.resize(read_ahead_size);
+      read_ahead_.resize(size_t(readBinaryChunk(read_ahead_.data(), read_ahead_size)));
+      read_ahead_next_ = 0;
+    }
+
+    if (read_ahead_next_ < read_ahead_.size())
+    {
+      point = read_ahead_[read_ahead_next_++];
+      return true;
+    }
+    return false;
+  }
+
   if (next_point_index_ < long(point_count_))
   {
     if (ply_read_next_instance(ply_handle_->ply.get(), ply_handle_->vertex_element, ply_handle_->ply_argument,
@@ -277,6 +751,16 @@ uint64_t PointCloudReaderPly::readChunk(CloudPoint *point, uint64_t count)
 {
   uint64_t read_count = 0;
 
+  if (binary_)
+  {
+    // Consume any points read ahead by readNext() first.
+    while (read_count < count && read_ahead_next_ < read_ahead_.size())
+    {
+      point[read_count++] = read_ahead_[read_ahead_next_++];
+    }
+    return read_count + readBinaryChunk(point + read_count, count - read_count);
+  }
+
   for (uint64_t i = 0; i < count; ++i)
   {
     if (readNext(point[i]))
@@ -292,6 +776,143 @@ uint64_t PointCloudReaderPly::readChunk(CloudPoint *point, uint64_t count)
   return read_count;
 }
 
+bool PointCloudReaderPly::openBinary(const char *filename)
+{
+#ifdef SLAMIO_PLY_MMAP
+  if (!hostIsLittleEndian())
+  {
+    return false;
+  }
+
+  auto binary = std::make_unique<PlyBinaryVertices>();
+  const int fd = ::open(filename, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+  {
+    void *mem = mmap(nullptr, size_t(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mem != MAP_FAILED)  // NOLINT(cppcoreguidelines-pro-type-cstyle-cast)
+    {
+      // Vertex data are read front to back.
+      madvise(mem, size_t(file_stat.st_size), MADV_SEQUENTIAL);
+      binary->mapped = static_cast<const uint8_t *>(mem);
+      binary->mapped_size = size_t(file_stat.st_size);
+    }
+  }
+  // The mapping remains valid after closing the file.
+  ::close(fd);
+
+  if (!binary->mapped || !parseBinaryHeader(*binary, desired_channels_))
+  {
+    // Not mapped or not a binary little endian file. Use rply.
+    return false;
+  }
+
+  binary_ = std::move(binary);
+  point_count_ = binary_->vertex_count;
+  available_channels_ = availableChannelsFromFlags(binary_->have_property_flags);
+  read_sample_.have_property_flags = binary_->have_property_flags;
+  return true;
+#else   // SLAMIO_PLY_MMAP
+  (void)filename;
+  return false;
+#endif  // SLAMIO_PLY_MMAP
+}
+
+uint64_t PointCloudReaderPly::readBinaryChunk(CloudPoint *point, uint64_t count)
+{
+  count = std::min<uint64_t>(count, point_count_ - uint64_t(next_point_index_));
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  const size_t stride = binary_->vertex_stride;
+  const uint8_t *src = binary_->vertices + uint64_t(next_point_index_) * stride;
+  const bool have_alpha = haveProperty(binary_->have_property_flags, PlyProperty::kA);
+
+  for (uint64_t i = 0; i < count; ++i)
+  {
+    point[i] = {};
+    point[i].colour.a = (have_alpha) ? 0.0f : 1.0f;
+  }
+
+  // Decode a column at a time, then scatter into the points.
+  auto &values = binary_->column_values;
+  values.resize(size_t(count));
+  for (const auto &property_column : binary_->columns)
+  {
+    const PlyBinaryVertices::Column &column = property_column.second;
+    decodeColumn(column.type, src + column.offset, stride, size_t(count), column.scale, values.data());
+
+    switch (property_column.first)
+    {
+    case PlyProperty::kTimestamp:
+      for (uint64_t i = 0; i < count; ++i)
+      {
+        point[i].timestamp = values[i];
+      }
+      break;
+    case PlyProperty::kX:
+    case PlyProperty::kY:
+    case PlyProperty::kZ:
+    {
+      const unsigned axis = unsigned(property_column.first) - unsigned(PlyProperty::kX);
+      for (uint64_t i = 0; i < count; ++i)
+      {
+        point[i].position[axis] = values[i];
+      }
+      break;
+    }
+    case PlyProperty::kNX:
+    case PlyProperty::kNY:
+    case PlyProperty::kNZ:
+    {
+      const unsigned axis = unsigned(property_column.first) - unsigned(PlyProperty::kNX);
+      for (uint64_t i = 0; i < count; ++i)
+      {
+        point[i].normal[axis] = values[i];
+      }
+      break;
+    }
+    case PlyProperty::kR:
+    case PlyProperty::kG:
+    case PlyProperty::kB:
+    case PlyProperty::kA:
+    {
+      const unsigned channel = unsigned(property_column.first) - unsigned(PlyProperty::kR);
+      for (uint64_t i = 0; i < count; ++i)
+      {
+        point[i].colour[channel] = float(values[i]);
+      }
+      break;
+    }
+    case PlyProperty::kIntensity:
+      for (uint64_t i = 0; i < count; ++i)
+      {
+        point[i].intensity = float(values[i]);
+      }
+      break;
+    case PlyProperty::kReturnNumber:
+      for (uint64_t i = 0; i < count; ++i)
+      {
+        point[i].return_number = uint8_t(std::round(std::min<double>(
+          values[i] * std::numeric_limits<uint8_t>::max(), std::numeric_limits<uint8_t>::max())));
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  next_point_index_ += long(count);
+  return count;
+}
+
 bool PointCloudReaderPly::readHeader()
 {
   if (!ply_handle_->ply)
@@ -301,6 +922,7 @@ bool PointCloudReaderPly::readHeader()
 
   std::fill(read_sample_.properties.begin(), read_sample_.properties.end(), 0.0);
   std::fill(read_sample_.scale_factor.begin(), read_sample_.scale_factor.end(), 1.0);
+  read_sample_.have_property_flags = 0;
 
   p_ply ply = ply_handle_->ply.get();
   p_ply_element element = nullptr;
@@ -345,124 +967,18 @@ bool PointCloudReaderPly::readHeader()
         std::string property_name_lower = property_name;
         std::transform(property_name_lower.begin(), property_name_lower.end(), property_name_lower.begin(),
                        [](const unsigned char ch) { return std::tolower(ch); });
-        if (isOneOf(property_name_lower, time_fields) && (desired_channels_ & DataChannel::Time) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_,
-                          long(PlyProperty::kTimestamp));
-          last_vertex_property_id = PlyProperty::kTimestamp;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = 1.0;
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, "x") && (desired_channels_ & DataChannel::Position) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kX));
-          last_vertex_property_id = PlyProperty::kX;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = 1.0;
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, "y") && (desired_channels_ & DataChannel::Position) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kY));
-          last_vertex_property_id = PlyProperty::kY;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = 1.0;
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, "z") && (desired_channels_ & DataChannel::Position) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kZ));
-          last_vertex_property_id = PlyProperty::kZ;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = 1.0;
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, { "nx", "normal_x" }) &&
-                 (desired_channels_ & DataChannel::Normal) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kNX));
-          last_vertex_property_id = PlyProperty::kNX;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = 1.0;
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, { "ny", "normal_y" }) &&
-                 (desired_channels_ & DataChannel::Normal) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kNY));
-          last_vertex_property_id = PlyProperty::kNY;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = 1.0;
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, { "nz", "normal_z" }) &&
-                 (desired_channels_ & DataChannel::Normal) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kNZ));
-          last_vertex_property_id = PlyProperty::kNZ;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = 1.0;
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, { "red", "r" }) &&
-                 (desired_channels_ & DataChannel::ColourRgb) != DataChannel::None)
+        PlyProperty property_id{};
+        bool normalised = false;
+        if (resolveProperty(property_name_lower, desired_channels_, time_fields, return_number_fields, property_id,
+                            normalised))
         {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kR));
-          last_vertex_property_id = PlyProperty::kR;
+          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(property_id));
+          last_vertex_property_id = property_id;
           last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = scaleFactorForType(type);
+          read_sample_.scale_factor[unsigned(property_id)] = (normalised) ? scaleFactorForType(type) : 1.0;
+          read_sample_.have_property_flags |= (1u << unsigned(property_id));
           property_callback = &vertexProperty;
         }
-        else if (isOneOf(property_name_lower, { "green", "g" }) &&
-                 (desired_channels_ & DataChannel::ColourRgb) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kG));
-          last_vertex_property_id = PlyProperty::kG;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = scaleFactorForType(type);
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, { "blue", "b" }) &&
-                 (desired_channels_ & DataChannel::ColourRgb) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kB));
-          last_vertex_property_id = PlyProperty::kB;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = scaleFactorForType(type);
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, { "alpha", "a" }) &&
-                 (desired_channels_ & DataChannel::ColourAlpha) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_, long(PlyProperty::kA));
-          last_vertex_property_id = PlyProperty::kA;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = scaleFactorForType(type);
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, "intensity") &&
-                 (desired_channels_ & DataChannel::Intensity) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_,
-                          long(PlyProperty::kIntensity));
-          last_vertex_property_id = PlyProperty::kIntensity;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = scaleFactorForType(type);
-          property_callback = &vertexProperty;
-        }
-        else if (isOneOf(property_name_lower, return_number_fields) &&
-                 (desired_channels_ & DataChannel::ReturnNumber) != DataChannel::None)
-        {
-          ply_set_read_cb(ply, element_name, property_name, property_callback, &read_sample_,
-                          long(PlyProperty::kReturnNumber));
-          last_vertex_property_id = PlyProperty::kReturnNumber;
-          last_vertex_property_name = property_name;
-          read_sample_.scale_factor[unsigned(last_vertex_property_id)] = scaleFactorForType(type);
-          property_callback = &vertexProperty;
-        }
-
-        read_sample_.have_property_flags |= (1u << unsigned(last_vertex_property_id));
       }
     }
     // else // not interested for point data
@@ -495,38 +1011,7 @@ bool PointCloudReaderPly::readHeader()
   }
 
   // Confirm which data values are available
-  const unsigned property_flags = read_sample_.have_property_flags;
-  if (haveProperty(property_flags, PlyProperty::kTimestamp))
-  {
-    available_channels_ |= DataChannel::Time;
-  }
-  if (haveProperty(property_flags, PlyProperty::kX) && haveProperty(property_flags, PlyProperty::kY) &&
-      haveProperty(property_flags, PlyProperty::kZ))
-  {
-    available_channels_ |= DataChannel::Position;
-  }
-  if (haveProperty(property_flags, PlyProperty::kNX) && haveProperty(property_flags, PlyProperty::kNY) &&
-      haveProperty(property_flags, PlyProperty::kNZ))
-  {
-    available_channels_ |= DataChannel::Normal;
-  }
-  if (haveProperty(property_flags, PlyProperty::kR) && haveProperty(property_flags, PlyProperty::kG) &&
-      haveProperty(property_flags, PlyProperty::kB))
-  {
-    available_channels_ |= DataChannel::ColourRgb;
-  }
-  if (haveProperty(property_flags, PlyProperty::kA))
-  {
-    available_channels_ |= DataChannel::ColourAlpha;
-  }
-  if (haveProperty(property_flags, PlyProperty::kIntensity))
-  {
-    available_channels_ |= DataChannel::Intensity;
-  }
-  if (haveProperty(property_flags, PlyProperty::kReturnNumber))
-  {
-    available_channels_ |= DataChannel::ReturnNumber;
-  }
+  available_channels_ = availableChannelsFromFlags(read_sample_.have_property_flags);
 
   return true;
 }
@@ -18,8 +18,13 @@
 namespace slamio
 {
 struct RPlyHandle;
+struct PlyBinaryVertices;
 
-/// A PLY point cloud loading using miniply.
+/// A PLY point cloud loader.
+///
+/// Binary little endian PLY files are memory mapped (where supported) and read natively. Only the vertex properties
+/// for the @c desiredChannels() are decoded, a column at a time over a chunk of vertices. Other PLY files are read
+/// using the rply library.
 class PointCloudReaderPly : public PointCloudReader
 {
 public:
@@ -75,12 +80,23 @@ public:
 private:
   bool readHeader();
 
+  /// Try open @p filename for native reading. Fails for PLY files which are not binary little endian.
+  bool openBinary(const char *filename);
+  /// Native implementation of @c readChunk() .
+  uint64_t readBinaryChunk(CloudPoint *point, uint64_t count);
+
   uint64_t point_count_ = 0;
   long next_point_index_ = 0;
   ReadSampleData read_sample_;
   DataChannel available_channels_ = DataChannel::None;
   DataChannel desired_channels_ = DataChannel::Time | DataChannel::Position;
   std::unique_ptr<RPlyHandle> ply_handle_;
+  /// Native binary reader. Null when using rply.
+  std::unique_ptr<PlyBinaryVertices> binary_;
+  /// Points decoded ahead for @c readNext() on the native path.
+  std::vector<CloudPoint> read_ahead_;
+  /// Index of the next point in @c read_ahead_ .
+  size_t read_ahead_next_ = 0;
 };
 }  // namespace slamio
 
@@ -31,15 +31,14 @@ void PointCloudReaderTraj::setDesiredChannels(DataChannel channels)
 
 bool PointCloudReaderTraj::isOpen()
 {
-  return file_in_.is_open();
+  return text_in_.isOpen();
 }
 
 bool PointCloudReaderTraj::open(const char *filename)
 {
   close();
-  file_in_.open(filename, std::ios::binary);
 
-  if (!file_in_.is_open())
+  if (!text_in_.open(filename))
   {
     close();
     return false;
@@ -47,10 +46,8 @@ bool PointCloudReaderTraj::open(const char *filename)
 
   // Try read the first data line. It may be valid or it may be headings.
   CloudPoint point;
-  auto reset_pos = file_in_.tellg();
   if (!readNext(point))
   {
-    reset_pos = file_in_.tellg();
     if (!readNext(point))
     {
       // Data not ok.
@@ -68,7 +65,7 @@ bool PointCloudReaderTraj::open(const char *filename)
   }
 
   // Reset to the first valid data line.
-  file_in_.seekg(reset_pos);
+  text_in_.unreadLine();
 
   if (desired_channels_ == DataChannel::None)
   {
@@ -80,7 +77,8 @@ bool PointCloudReaderTraj::open(const char *filename)
 
 void PointCloudReaderTraj::close()
 {
-  file_in_.close();
+  text_in_.close();
+  eof_ = false;
   desired_channels_ = DataChannel::None;
 }
 
@@ -96,45 +94,36 @@ uint64_t PointCloudReaderTraj::pointCount() const
 
 bool PointCloudReaderTraj::readNext(CloudPoint &point)
 {
-  if (!eof_)
-  {
-    if (!std::getline(file_in_, data_line_))
-    {
-      // End of file.
-      eof_ = true;
-      return false;
-    }
-
-    // sscanf is far faster than using stream operators.
-#ifdef _MSC_VER
-    if (sscanf_s(data_line_.c_str(), "%lg %lg %lg %lg", &point.timestamp, &point.position.x, &point.position.y,
-                 &point.position.z) == 4)
-#else   // _MSC_VER
-    if (sscanf(data_line_.c_str(), "%lg %lg %lg %lg", &point.timestamp, &point.position.x, &point.position.y,
-               &point.position.z) == 4)
-#endif  // _MSC_VER
-    {
-      return true;
-    }
-  }
-
-  return false;
+  return readChunk(&point, 1) == 1;
 }
 
 uint64_t PointCloudReaderTraj::readChunk(CloudPoint *point, uint64_t count)
 {
   uint64_t read_count = 0;
+  const char *line_begin = nullptr;
+  const char *line_end = nullptr;
 
-  for (uint64_t i = 0; i < count; ++i)
+  while (read_count < count && !eof_)
   {
-    if (readNext(point[i]))
+    if (!text_in_.nextLine(line_begin, line_end))
     {
-      ++read_count;
+      // End of file.
+      eof_ = true;
+      break;
     }
-    else
+
+    // Parse "time x y z", ignoring any additional fields.
+    CloudPoint &pt = point[read_count];
+    const char *cursor = parseDouble(line_begin, line_end, pt.timestamp);
+    cursor = (cursor) ? parseDouble(cursor, line_end, pt.position.x) : nullptr;
+    cursor = (cursor) ? parseDouble(cursor, line_end, pt.position.y) : nullptr;
+    cursor = (cursor) ? parseDouble(cursor, line_end, pt.position.z) : nullptr;
+    if (!cursor)
     {
+      // Parse failure.
       break;
     }
+    ++read_count;
   }
 
   return read_count;
@@ -9,10 +9,7 @@
 #include "SlamIOConfig.h"
 
 #include "PointCloudReader.h"
-
-#include <fstream>
-#include <memory>
-#include <string>
+#include "TextLineReader.h"
 
 namespace miniply
 {
@@ -50,10 +47,7 @@ public:
   uint64_t readChunk(CloudPoint *point, uint64_t count) override;
 
 private:
-  using FilePtr = std::unique_ptr<FILE, int (*)(FILE *)>;
-
-  std::ifstream file_in_;
-  std::string data_line_;
+  TextLineReader text_in_;
   bool eof_ = false;
   DataChannel desired_channels_ = DataChannel::Position | DataChannel::Time;
 };
@@ -35,15 +35,14 @@ void PointCloudReaderXyz::setDesiredChannels(DataChannel channels)
 
 bool PointCloudReaderXyz::isOpen()
 {
-  return file_in_.is_open();
+  return text_in_.isOpen();
 }
 
 bool PointCloudReaderXyz::open(const char *filename)
 {
   close();
-  file_in_.open(filename, std::ios::binary);
 
-  if (!file_in_.is_open())
+  if (!text_in_.open(filename))
   {
     close();
     return false;
@@ -67,7 +66,8 @@ bool PointCloudReaderXyz::open(const char *filename)
 
 void PointCloudReaderXyz::close()
 {
-  file_in_.close();
+  text_in_.close();
+  eof_ = false;
   available_channels_ = DataChannel::None;
 }
 
@@ -83,56 +83,67 @@ uint64_t PointCloudReaderXyz::pointCount() const
 
 bool PointCloudReaderXyz::readNext(CloudPoint &point)
 {
-  if (!eof_)
+  return readChunk(&point, 1) == 1;
+}
+
+uint64_t PointCloudReaderXyz::readChunk(CloudPoint *point, uint64_t count)
+{
+  uint64_t read_count = 0;
+  const char *line_begin = nullptr;
+  const char *line_end = nullptr;
+
+  // Resolve the optional channels to extract once per chunk.
+  const DataChannel extract_channels = available_channels_ & desired_channels_;
+  const bool read_normal = (extract_channels & DataChannel::Normal) != DataChannel::None;
+  const bool read_intensity = (extract_channels & DataChannel::Intensity) != DataChannel::None;
+  const bool read_return_number = (extract_channels & DataChannel::ReturnNumber) != DataChannel::None;
+
+  while (read_count < count && !eof_)
   {
-    if (!std::getline(file_in_, data_line_))
+    if (!text_in_.nextLine(line_begin, line_end))
     {
       // End of file.
       eof_ = true;
-      return false;
+      break;
     }
 
-    // sscanf is far faster than using stream operators, but the unknown number of data items on a line mandate streams
-    std::istringstream istr(data_line_);
-
+    // Parse values in place in the line. Extra values on the line are ignored.
+    const char *cursor = line_begin;
     for (auto &value : values_buffer_)
     {
-      istr >> value;
+      cursor = parseDouble(cursor, line_end, value);
+      if (!cursor)
+      {
+        // Parse failure.
+        return read_count;
+      }
     }
 
-    if (!istr.fail())
+    CloudPoint &pt = point[read_count];
+    pt.timestamp = values_buffer_[time_index_];
+    pt.position.x = values_buffer_[x_index_];
+    pt.position.y = values_buffer_[y_index_];
+    pt.position.z = values_buffer_[z_index_];
+    if (read_normal)
     {
-      point.timestamp = values_buffer_[time_index_];
-      point.position.x = values_buffer_[x_index_];
-      point.position.y = values_buffer_[y_index_];
-      point.position.z = values_buffer_[z_index_];
-      return true;
+      pt.normal.x = values_buffer_[nx_index_];
+      pt.normal.y = values_buffer_[ny_index_];
+      pt.normal.z = values_buffer_[nz_index_];
     }
-  }
-
-  return false;
-}
-
-uint64_t PointCloudReaderXyz::readChunk(CloudPoint *point, uint64_t count)
-{
-  uint64_t read_count = 0;
-
-  for (uint64_t i = 0; i < count; ++i)
-  {
-    if (readNext(point[i]))
+    if (read_intensity)
     {
-      ++read_count;
+      pt.intensity = float(values_buffer_[intensity_index_]);
     }
-    else
+    if (read_return_number)
     {
-      break;
+      pt.return_number = uint8_t(values_buffer_[return_number_index_]);
     }
+    ++read_count;
   }
 
   return read_count;
 }
 
-
 namespace
 {
 const size_t heading_not_found = ~size_t(0u);
@@ -169,18 +180,17 @@ size_t headingIndex(const std::vector<std::string> &names, const std::vector<std
 
 bool PointCloudReaderXyz::readHeadings()
 {
-  if (!eof_)
+  const char *line_begin = nullptr;
+  const char *line_end = nullptr;
+  if (!text_in_.nextLine(line_begin, line_end))
   {
-    if (!std::getline(file_in_, data_line_))
-    {
-      // End of file.
-      eof_ = true;
-      return false;
-    }
+    // End of file.
+    eof_ = true;
+    return false;
   }
 
   // Parse headings.
-  std::istringstream istr(data_line_);
+  std::istringstream istr(std::string(line_begin, line_end));
   std::vector<std::string> headings;
   std::string token;
   while (!istr.fail())
@@ -9,10 +9,8 @@
 #include "SlamIOConfig.h"
 
 #include "PointCloudReader.h"
+#include "TextLineReader.h"
 
-#include <fstream>
-#include <memory>
-#include <string>
 #include <vector>
 
 namespace miniply
@@ -42,6 +40,8 @@ namespace slamio
 ///   - timestamp
 ///   - time
 /// - Data in a line are space delimited
+///
+/// The file is read in blocks with values parsed in place, so bulk reading with @c readChunk() is preferred.
 class PointCloudReaderXyz : public PointCloudReader
 {
 public:
@@ -63,12 +63,9 @@ public:
   uint64_t readChunk(CloudPoint *point, uint64_t count) override;
 
 private:
-  using FilePtr = std::unique_ptr<FILE, int (*)(FILE *)>;
-
   bool readHeadings();
 
-  std::ifstream file_in_;
-  std::string data_line_;
+  TextLineReader text_in_;
   bool eof_ = false;
   DataChannel desired_channels_ = DataChannel::Position | DataChannel::Time;
   DataChannel available_channels_ = DataChannel::None;
@@ -8,10 +8,14 @@
 #include "PointCloudReader.h"
 #include "SlamIO.h"
 
+#include <algorithm>
 #include <chrono>
+#include <deque>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -20,34 +24,13 @@
 namespace
 {
 using Clock = std::chrono::high_resolution_clock;
+
+/// Number of points read and processed together by the @c SlamCloudLoader .
+const size_t kBatchSize = 4096u;
 }  // namespace
 
 namespace slamio
 {
-struct SlamCloudLoaderDetail
-{
-  PointCloudReaderPtr sample_reader;
-  PointCloudReaderPtr trajectory_reader;
-
-  CloudPoint trajectory_buffer[2] = {};
-  glm::dvec3 trajectory_to_sensor_offset{};
-
-  SamplePoint next_sample;
-  uint64_t read_count = 0;
-  uint64_t preload_index = 0;
-
-  Clock::time_point first_sample_read_time;
-  double first_sample_timestamp = -1.0;
-  bool ray_cloud = false;
-  bool real_time_mode = false;
-  bool infer_return_number = false;
-  bool allow_return_number_inference = false;
-
-  std::vector<SamplePoint> preload_samples;
-
-  SlamCloudLoader::Log error_log;
-};
-
 template <typename T>
 void error(std::ostream &out, const T &msg)
 {
@@ -83,6 +66,288 @@ void error(SlamCloudLoader::Log log, const T &msg, Args... args)
   }
 }
 
+namespace
+{
+/// Number of points decoded from a sample file by each background read. Bounds the memory used to read ahead.
+const size_t kStreamChunkSize = 16u * kBatchSize;
+
+/// A sample file being read in chunks on background threads. Only one chunk read is in flight for each stream, so the
+/// stream state is only touched by one thread at a time.
+struct SampleFileStream
+{
+  std::string file_path;
+  PointCloudReaderPtr reader;
+  DataChannel desired_channels = DataChannel::None;
+  uint64_t read_count = 0;
+};
+
+/// A chunk of points decoded from a @c SampleFileStream .
+struct SampleFileChunk
+{
+  std::vector<CloudPoint> points;
+  /// Set when reading the file failed. Holds the error message.
+  std::string error;
+  /// True if this is the last chunk from the file.
+  bool end = false;
+};
+
+/// Build the error message for a sample file which ended before reaching its reported point count, or an empty string
+/// if the file was read in full.
+std::string checkSampleFileComplete(const PointCloudReader &reader, uint64_t read_count, const std::string &file_path)
+{
+  if (reader.pointCount() && read_count < reader.pointCount())
+  {
+    std::ostringstream str;
+    str << "Point cloud " << file_path << " ended after " << read_count << " of " << reader.pointCount() << " points";
+    return str.str();
+  }
+  return std::string();
+}
+
+/// Decode the next chunk of points from @p stream , opening the file on the first call.
+SampleFileChunk readSampleFileChunk(const std::shared_ptr<SampleFileStream> &stream)
+{
+  SampleFileChunk chunk;
+  if (!stream->reader)
+  {
+    stream->reader = slamio::createCloudReaderFromFilename(stream->file_path.c_str());
+    if (!stream->reader)
+    {
+      chunk.error = "Unsupported extension for point cloud file " + stream->file_path;
+      chunk.end = true;
+      return chunk;
+    }
+
+    stream->reader->setDesiredChannels(stream->desired_channels);
+    if (!stream->reader->open(stream->file_path.c_str()))
+    {
+      chunk.error = "Unable to open point cloud " + stream->file_path;
+      chunk.end = true;
+      return chunk;
+    }
+  }
+
+  chunk.points.resize(kStreamChunkSize);
+  size_t read_count = 0;
+  while (read_count < chunk.points.size())
+  {
+    const uint64_t chunk_count = stream->reader->readChunk(chunk.points.data() + read_count,
+                                                           chunk.points.size() - read_count);
+    if (!chunk_count)
+    {
+      chunk.end = true;
+      break;
+    }
+    read_count += chunk_count;
+  }
+  chunk.points.resize(read_count);
+  stream->read_count += read_count;
+
+  if (chunk.end)
+  {
+    chunk.error = checkSampleFileComplete(*stream->reader, stream->read_count, stream->file_path);
+    // Release the file as soon as it is done.
+    stream->reader = nullptr;
+  }
+
+  return chunk;
+}
+}  // namespace
+
+
+struct SlamCloudLoaderDetail
+{
+  std::vector<std::string> sample_files;
+  /// Index of the next item in @c sample_files to open or queue for reading.
+  size_t next_sample_file = 0;
+  /// Reader for the current sample file when reading sequentially.
+  PointCloudReaderPtr sample_reader;
+  PointCloudReaderPtr trajectory_reader;
+  /// Channels available in all the sample files.
+  DataChannel sample_channels = DataChannel::None;
+  DataChannel desired_sample_channels = DataChannel::None;
+  uint64_t sample_point_count = 0;
+
+  /// Number of points read from @c sample_reader .
+  uint64_t sample_reader_count = 0;
+  /// Set when reading a sample file fails. No further points are read.
+  std::string read_error;
+
+  /// A sample file streamed on background threads with the read of its next chunk in flight.
+  struct PendingFile
+  {
+    std::shared_ptr<SampleFileStream> stream;
+    std::future<SampleFileChunk> chunk;
+  };
+
+  /// Background file decoding. Used with multiple sample files and a non-zero @c file_read_ahead .
+  unsigned file_read_ahead = 2;
+  std::deque<PendingFile> pending_files;
+  SampleFileChunk current_chunk;
+  size_t current_chunk_next = 0;
+
+  CloudPoint trajectory_buffer[2] = {};
+  /// Trajectory points read ahead of @c trajectory_buffer .
+  std::vector<CloudPoint> trajectory_points;
+  size_t trajectory_next = 0;
+  glm::dvec3 trajectory_to_sensor_offset{};
+
+  /// Points read for the current batch.
+  std::vector<CloudPoint> cloud_batch;
+  /// Processed samples for the current batch.
+  std::vector<SamplePoint> sample_batch;
+  size_t sample_batch_next = 0;
+  /// Indices into @c sample_batch of samples requiring trajectory interpolation.
+  std::vector<size_t> trajectory_indices;
+  /// The last sample loaded.
+  SamplePoint last_sample{};
+  uint64_t read_count = 0;
+  uint64_t preload_index = 0;
+
+  Clock::time_point first_sample_read_time;
+  double first_sample_timestamp = -1.0;
+  bool ray_cloud = false;
+  bool real_time_mode = false;
+  bool infer_return_number = false;
+  bool allow_return_number_inference = false;
+
+  std::vector<SamplePoint> preload_samples;
+
+  SlamCloudLoader::Log error_log;
+
+  inline bool readInBackground() const { return file_read_ahead > 0 && sample_files.size() > 1; }
+
+  /// Queue background reading of sample files up to the @c file_read_ahead limit. Each queued file starts decoding its
+  /// first chunk.
+  void queueSampleFiles()
+  {
+    while (pending_files.size() < file_read_ahead && next_sample_file < sample_files.size())
+    {
+      PendingFile pending;
+      pending.stream = std::make_shared<SampleFileStream>();
+      pending.stream->file_path = sample_files[next_sample_file++];
+      pending.stream->desired_channels = desired_sample_channels;
+      pending.chunk = std::async(std::launch::async, readSampleFileChunk, pending.stream);
+      pending_files.emplace_back(std::move(pending));
+    }
+  }
+
+  /// Record a sample file failure. This stops all further reading.
+  void setReadError(const std::string &message)
+  {
+    read_error = message;
+    error(error_log, message);
+    pending_files.clear();
+    sample_reader = nullptr;
+    next_sample_file = sample_files.size();
+  }
+
+  /// Read up to @p count points from the sample files, moving through the files as required. Stops at the first file
+  /// which fails to read, setting @c read_error . Points decoded before the failure are still returned.
+  size_t readPoints(CloudPoint *points, size_t count)
+  {
+    size_t read_count = 0;
+    while (read_count < count)
+    {
+      if (readInBackground())
+      {
+        if (current_chunk_next >= current_chunk.points.size())
+        {
+          // Move to the next decoded chunk.
+          queueSampleFiles();
+          if (pending_files.empty())
+          {
+            break;
+          }
+          current_chunk = pending_files.front().chunk.get();
+          current_chunk_next = 0;
+          if (!current_chunk.end)
+          {
+            // Decode the next chunk from the same file while this one is consumed.
+            pending_files.front().chunk =
+              std::async(std::launch::async, readSampleFileChunk, pending_files.front().stream);
+          }
+          else
+          {
+            pending_files.pop_front();
+            queueSampleFiles();
+          }
+
+          if (!current_chunk.error.empty())
+          {
+            setReadError(current_chunk.error);
+          }
+          continue;
+        }
+
+        const size_t copy_count = std::min(count - read_count, current_chunk.points.size() - current_chunk_next);
+        std::copy(current_chunk.points.begin() + current_chunk_next,
+                  current_chunk.points.begin() + current_chunk_next + copy_count, points + read_count);
+        current_chunk_next += copy_count;
+        read_count += copy_count;
+      }
+      else
+      {
+        if (!sample_reader)
+        {
+          // Open the next file.
+          if (next_sample_file >= sample_files.size())
+          {
+            break;
+          }
+          const std::string &file_path = sample_files[next_sample_file++];
+          sample_reader = slamio::createCloudReaderFromFilename(file_path.c_str());
+          sample_reader_count = 0;
+          if (!sample_reader)
+          {
+            setReadError("Unsupported extension for point cloud file " + file_path);
+            break;
+          }
+          sample_reader->setDesiredChannels(desired_sample_channels);
+          if (!sample_reader->open(file_path.c_str()))
+          {
+            setReadError("Unable to open point cloud " + file_path);
+            break;
+          }
+        }
+
+        const uint64_t chunk_count = sample_reader->readChunk(points + read_count, count - read_count);
+        read_count += chunk_count;
+        sample_reader_count += chunk_count;
+        if (!chunk_count)
+        {
+          const std::string message =
+            checkSampleFileComplete(*sample_reader, sample_reader_count, sample_files[next_sample_file - 1]);
+          sample_reader = nullptr;
+          if (!message.empty())
+          {
+            setReadError(message);
+          }
+        }
+      }
+    }
+
+    return read_count;
+  }
+
+  /// Fetch the next trajectory point, reading the trajectory file in chunks.
+  bool nextTrajectoryPoint(CloudPoint &point)
+  {
+    if (trajectory_next >= trajectory_points.size())
+    {
+      trajectory_points.resize(kBatchSize);
+      trajectory_points.resize(trajectory_reader->readChunk(trajectory_points.data(), trajectory_points.size()));
+      trajectory_next = 0;
+      if (trajectory_points.empty())
+      {
+        return false;
+      }
+    }
+    point = trajectory_points[trajectory_next++];
+    return true;
+  }
+};
+
 SlamCloudLoader::SlamCloudLoader(bool real_time_mode)
   : imp_(std::make_unique<SlamCloudLoaderDetail>())
 {
@@ -132,28 +397,73 @@ bool SlamCloudLoader::returnNumberInference() const
 }
 
 
+void SlamCloudLoader::setFileReadAhead(unsigned file_count)
+{
+  imp_->file_read_ahead = file_count;
+}
+
+
+unsigned SlamCloudLoader::fileReadAhead() const
+{
+  return imp_->file_read_ahead;
+}
+
+
 bool SlamCloudLoader::openWithTrajectory(const char *sample_file_path, const char *trajectory_file_path)
 {
-  return open(sample_file_path, trajectory_file_path, false);
+  return open(std::vector<std::string>{ sample_file_path }, trajectory_file_path, false);
+}
+
+
+bool SlamCloudLoader::openWithTrajectory(const std::vector<std::string> &sample_file_paths,
+                                         const char *trajectory_file_path)
+{
+  return open(sample_file_paths, trajectory_file_path, false);
 }
 
 
 bool SlamCloudLoader::openPointCloud(const char *sample_file_path)
 {
-  return open(sample_file_path, nullptr, false);
+  return open(std::vector<std::string>{ sample_file_path }, nullptr, false);
+}
+
+
+bool SlamCloudLoader::openPointCloud(const std::vector<std::string> &sample_file_paths)
+{
+  return open(sample_file_paths, nullptr, false);
 }
 
 
 bool SlamCloudLoader::openRayCloud(const char *sample_file_path)
 {
-  return open(sample_file_path, nullptr, true);
+  return open(std::vector<std::string>{ sample_file_path }, nullptr, true);
+}
+
+
+bool SlamCloudLoader::openRayCloud(const std::vector<std::string> &sample_file_paths)
+{
+  return open(sample_file_paths, nullptr, true);
 }
 
 
 void SlamCloudLoader::close()
 {
+  // Wait for background reads before releasing anything else.
+  imp_->pending_files.clear();
+  imp_->current_chunk = SampleFileChunk{};
+  imp_->current_chunk_next = 0;
+  imp_->read_error.clear();
+  imp_->sample_files.clear();
+  imp_->next_sample_file = 0;
   imp_->sample_reader = nullptr;
+  imp_->sample_reader_count = 0;
   imp_->trajectory_reader = nullptr;
+  imp_->sample_channels = DataChannel::None;
+  imp_->sample_point_count = 0;
+  imp_->trajectory_points.clear();
+  imp_->trajectory_next = 0;
+  imp_->sample_batch.clear();
+  imp_->sample_batch_next = 0;
   imp_->read_count = 0;
   imp_->preload_index = 0;
   imp_->first_sample_timestamp = -1.0;
@@ -164,7 +474,7 @@ void SlamCloudLoader::close()
 
 size_t SlamCloudLoader::numberOfPoints() const
 {
-  return imp_->sample_reader ? imp_->sample_reader->pointCount() : 0;
+  return imp_->sample_point_count;
 }
 
 
@@ -174,9 +484,15 @@ bool SlamCloudLoader::realTimeMode() const
 }
 
 
+const std::string &SlamCloudLoader::readError() const
+{
+  return imp_->read_error;
+}
+
+
 bool SlamCloudLoader::sampleFileIsOpen() const
 {
-  return imp_->sample_reader != nullptr;
+  return !imp_->sample_files.empty();
 }
 
 
@@ -188,7 +504,7 @@ bool SlamCloudLoader::trajectoryFileIsOpen() const
 
 bool SlamCloudLoader::hasTimestamp() const
 {
-  return imp_->sample_reader && (imp_->sample_reader->availableChannels() & DataChannel::Time) != DataChannel::None;
+  return (imp_->sample_channels & DataChannel::Time) != DataChannel::None;
 }
 
 
@@ -200,28 +516,25 @@ bool SlamCloudLoader::hasOrigin() const
 
 bool SlamCloudLoader::hasIntensity() const
 {
-  return imp_->sample_reader &&
-         (imp_->sample_reader->availableChannels() & DataChannel::Intensity) != DataChannel::None;
+  return (imp_->sample_channels & DataChannel::Intensity) != DataChannel::None;
 }
 
 
 bool SlamCloudLoader::hasColour() const
 {
-  return imp_->sample_reader &&
-         (imp_->sample_reader->availableChannels() & DataChannel::ColourRgb) == DataChannel::ColourRgb;
+  return (imp_->sample_channels & DataChannel::ColourRgb) == DataChannel::ColourRgb;
 }
 
 
 bool SlamCloudLoader::hasReturnNumber() const
 {
-  return imp_->sample_reader &&
-         (imp_->sample_reader->availableChannels() & DataChannel::ReturnNumber) == DataChannel::ReturnNumber;
+  return (imp_->sample_channels & DataChannel::ReturnNumber) == DataChannel::ReturnNumber;
 }
 
 
 void SlamCloudLoader::preload(size_t point_count)
 {
-  if (!imp_->sample_reader)
+  if (!sampleFileIsOpen())
   {
     return;
   }
@@ -252,39 +565,77 @@ void SlamCloudLoader::preload(size_t point_count)
 
 bool SlamCloudLoader::nextSample(SamplePoint &sample)
 {
-  if (loadPoint())
+  return nextSamples(&sample, 1) == 1;
+}
+
+
+size_t SlamCloudLoader::nextSamples(SamplePoint *samples, size_t count)
+{
+  SlamCloudLoaderDetail &imp = *imp_;
+  size_t read_count = 0;
+  while (read_count < count)
   {
-    ++imp_->read_count;
+    if (imp.preload_index < imp.preload_samples.size())
+    {
+      const size_t copy_count = std::min<size_t>(count - read_count, imp.preload_samples.size() - imp.preload_index);
+      std::copy(imp.preload_samples.begin() + imp.preload_index,
+                imp.preload_samples.begin() + imp.preload_index + copy_count, samples + read_count);
+      imp.preload_index += copy_count;
+      read_count += copy_count;
+      continue;
+    }
+
+    if (!imp.preload_samples.empty())
+    {
+      // Preload done. Release the memory for preload_samples
+      imp.preload_samples = std::vector<SamplePoint>();
+      imp.preload_index = 0;
+    }
 
-    // Read next sample.
-    sample = imp_->next_sample;
+    if (imp.sample_batch_next >= imp.sample_batch.size() && !loadBatch())
+    {
+      break;
+    }
 
-    // If in real time mode, sleep until we should deliver this sample.
-    if (imp_->real_time_mode && imp_->first_sample_timestamp >= 0)
+    const size_t copy_count = std::min(count - read_count, imp.sample_batch.size() - imp.sample_batch_next);
+    std::copy(imp.sample_batch.begin() + imp.sample_batch_next,
+              imp.sample_batch.begin() + imp.sample_batch_next + copy_count, samples + read_count);
+    imp.sample_batch_next += copy_count;
+    read_count += copy_count;
+  }
+
+  imp.read_count += read_count;
+
+  // If in real time mode, sleep until we should deliver the last sample.
+  if (read_count && imp.real_time_mode && imp.first_sample_timestamp >= 0)
+  {
+    const double sample_relative_time = samples[read_count - 1].timestamp - imp.first_sample_timestamp;
+    if (sample_relative_time > 0)
     {
-      const double sample_relative_time = sample.timestamp - imp_->first_sample_timestamp;
-      if (sample_relative_time > 0)
+      auto uptime = Clock::now() - imp.first_sample_read_time;
+      const double sleep_time =
+        sample_relative_time - std::chrono::duration_cast<std::chrono::duration<double>>(uptime).count();
+      if (sleep_time > 0)
       {
-        auto uptime = Clock::now() - imp_->first_sample_read_time;
-        const double sleep_time =
-          sample_relative_time - std::chrono::duration_cast<std::chrono::duration<double>>(uptime).count();
-        if (sleep_time > 0)
-        {
-          std::this_thread::sleep_for(std::chrono::duration<double>(sleep_time));
-        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(sleep_time));
       }
     }
-    return true;
   }
-  return false;
+
+  return read_count;
 }
 
 
-bool SlamCloudLoader::open(const char *sample_file_path, const char *trajectory_file_path, bool ray_cloud)
+bool SlamCloudLoader::open(const std::vector<std::string> &sample_file_paths, const char *trajectory_file_path,
+                           bool ray_cloud)
 {
   close();
 
-  imp_->sample_reader = slamio::createCloudReaderFromFilename(sample_file_path);
+  if (sample_file_paths.empty())
+  {
+    error(imp_->error_log, "No point cloud files given");
+    return false;
+  }
 
   if (!ray_cloud)
   {
@@ -301,13 +652,6 @@ bool SlamCloudLoader::open(const char *sample_file_path, const char *trajectory_
     }
   }
 
-  if (!imp_->sample_reader)
-  {
-    error(imp_->error_log, "Unsupported extension for point cloud file ", sample_file_path);
-    close();
-    return false;
-  }
-
   DataChannel required_channels = DataChannel::Position;
   if (ray_cloud)
   {
@@ -347,132 +691,162 @@ bool SlamCloudLoader::open(const char *sample_file_path, const char *trajectory_
   }
 
   // Set desired channels to include the required channels and ones we could additionally use.
-  imp_->sample_reader->setDesiredChannels(required_channels | DataChannel::Colour | DataChannel::Intensity |
-                                          DataChannel::ReturnNumber);
-  if (!imp_->sample_reader->open(sample_file_path))
+  imp_->desired_sample_channels =
+    required_channels | DataChannel::Colour | DataChannel::Intensity | DataChannel::ReturnNumber;
+
+  // Open each sample file to validate the channels and count the points. Only the first file is left open and only
+  // when reading sequentially.
+  imp_->sample_files = sample_file_paths;
+  imp_->sample_channels = DataChannel::None;
+  for (size_t i = 0; i < sample_file_paths.size(); ++i)
   {
-    error(imp_->error_log, "Unable to open point cloud ", sample_file_path);
-    close();
-    return false;
-  }
+    const char *sample_file_path = sample_file_paths[i].c_str();
+    PointCloudReaderPtr sample_reader = slamio::createCloudReaderFromFilename(sample_file_path);
+    if (!sample_reader)
+    {
+      error(imp_->error_log, "Unsupported extension for point cloud file ", sample_file_path);
+      close();
+      return false;
+    }
 
-  if (!imp_->trajectory_reader)
-  {
-    if (ray_cloud)
+    sample_reader->setDesiredChannels(imp_->desired_sample_channels);
+    if (!sample_reader->open(sample_file_path))
     {
-      // Ray cloud expects normals.
-      required_channels |= DataChannel::Normal;
+      error(imp_->error_log, "Unable to open point cloud ", sample_file_path);
+      close();
+      return false;
     }
-  }
 
-  // Check for required channels.
-  if ((required_channels & imp_->sample_reader->availableChannels()) != required_channels)
-  {
-    error(imp_->error_log, "Unable to load required data channels from point cloud ", sample_file_path);
-    close();
-    return false;
+    // Check for required channels.
+    if ((required_channels & sample_reader->availableChannels()) != required_channels)
+    {
+      error(imp_->error_log, "Unable to load required data channels from point cloud ", sample_file_path);
+      close();
+      return false;
+    }
+
+    imp_->sample_channels =
+      (i == 0) ? sample_reader->availableChannels() : imp_->sample_channels & sample_reader->availableChannels();
+    imp_->sample_point_count += sample_reader->pointCount();
+
+    if (i == 0 && !imp_->readInBackground())
+    {
+      imp_->sample_reader = sample_reader;
+      imp_->next_sample_file = 1;
+    }
   }
 
-  imp_->infer_return_number = imp_->allow_return_number_inference && (imp_->sample_reader->availableChannels() &
-                                                                      DataChannel::ReturnNumber) == DataChannel::None;
+  imp_->infer_return_number = imp_->allow_return_number_inference &&
+                              (imp_->sample_channels & DataChannel::ReturnNumber) == DataChannel::None;
 
   imp_->ray_cloud = ray_cloud;
+
+  if (imp_->readInBackground())
+  {
+    imp_->queueSampleFiles();
+  }
   return true;
 }
 
-bool SlamCloudLoader::loadPoint()
+
+bool SlamCloudLoader::loadBatch()
 {
-  if (imp_->preload_index < imp_->preload_samples.size())
-  {
-    imp_->next_sample = imp_->preload_samples[imp_->preload_index++];
-    return true;
-  }
+  SlamCloudLoaderDetail &imp = *imp_;
+  imp.cloud_batch.resize(kBatchSize);
+  const size_t point_count = imp.readPoints(imp.cloud_batch.data(), imp.cloud_batch.size());
+  imp.sample_batch.resize(point_count);
+  imp.sample_batch_next = 0;
+  imp.trajectory_indices.clear();
 
-  if (!imp_->preload_samples.empty())
+  if (point_count == 0)
   {
-    // Preload done. Release the memory for preload_samples
-    imp_->preload_samples.shrink_to_fit();
-    imp_->preload_index = 0;
+    return false;
   }
 
-  CloudPoint point{};
-  if (imp_->sample_reader && imp_->sample_reader->readNext(point))
+  const bool is_first_batch = imp.first_sample_timestamp < 0;
+  const SamplePoint *previous_sample = (!is_first_batch) ? &imp.last_sample : nullptr;
+  for (size_t i = 0; i < point_count; ++i)
   {
-    SamplePoint sample = c2sPt(point);
+    const CloudPoint &point = imp.cloud_batch[i];
+    SamplePoint &sample = imp.sample_batch[i];
+    c2sPt(sample, point);
 
-    const bool is_first_sample = imp_->first_sample_timestamp < 0;
-    bool is_secondary_return = !is_first_sample && point.return_number > 0;
+    bool is_secondary_return = previous_sample && point.return_number > 0;
 
     // Infer secondary returns if the return number is not available.
     // Only if this is not the first point sample.
-    if (!is_first_sample && imp_->infer_return_number)
+    if (previous_sample && imp.infer_return_number)
     {
       // We assume secondary returns can occur when sequential points have exactly the same timestamp.
-      if (sample.timestamp == imp_->next_sample.timestamp)
+      if (sample.timestamp == previous_sample->timestamp)
       {
         sample.return_number = 1u;
         is_secondary_return = true;
-        // std::cout << "infer dual return\n" << std::flush;
       }
     }
 
-    if (imp_->ray_cloud)
+    if (imp.ray_cloud)
     {
       // Loading a ray cloud. The normal is the vector from sample back to sensor.
       sample.origin = point.position + point.normal;
     }
-    else
+    else if (is_secondary_return)
     {
-      if (!is_secondary_return)
-      {
-        sampleTrajectory(sample.origin, sample.sample, sample.timestamp);
-      }
-      else
-      {
-        // Use previous sample point as the sample origin for this one.
-        sample.origin = imp_->next_sample.sample;
-      }
+      // Use previous sample point as the sample origin for this one.
+      sample.origin = previous_sample->sample;
     }
-    imp_->next_sample = sample;
-
-    if (is_first_sample)
+    else if (imp.trajectory_reader)
     {
-      imp_->first_sample_timestamp = sample.timestamp;
-      imp_->first_sample_read_time = Clock::now();
+      // Resolved below for the whole batch.
+      imp.trajectory_indices.emplace_back(i);
     }
-    return true;
+    else
+    {
+      sample.origin = sample.sample;
+    }
+
+    previous_sample = &sample;
   }
-  return false;
+
+  if (!imp.trajectory_indices.empty())
+  {
+    sampleTrajectory(imp.sample_batch.data(), imp.trajectory_indices.data(), imp.trajectory_indices.size());
+  }
+
+  imp.last_sample = imp.sample_batch.back();
+
+  if (is_first_batch)
+  {
+    imp.first_sample_timestamp = imp.sample_batch.front().timestamp;
+    imp.first_sample_read_time = Clock::now();
+  }
+  return true;
 }
 
 
-bool SlamCloudLoader::sampleTrajectory(glm::dvec3 &position, const glm::dvec3 &sample, double timestamp)
+void SlamCloudLoader::sampleTrajectory(SamplePoint *samples, const size_t *indices, size_t count)
 {
-  if (imp_->trajectory_reader)
+  SlamCloudLoaderDetail &imp = *imp_;
+  CloudPoint *trajectory = imp.trajectory_buffer;
+  CloudPoint traj_point;
+  for (size_t i = 0; i < count; ++i)
   {
-    CloudPoint traj_point;
+    SamplePoint &sample = samples[indices[i]];
+    const double timestamp = sample.timestamp;
 
-    while (timestamp > imp_->trajectory_buffer[1].timestamp && imp_->trajectory_reader->readNext(traj_point))
+    while (timestamp > trajectory[1].timestamp && imp.nextTrajectoryPoint(traj_point))
     {
-      imp_->trajectory_buffer[0] = imp_->trajectory_buffer[1];
-      imp_->trajectory_buffer[1] = traj_point;
+      trajectory[0] = trajectory[1];
+      trajectory[1] = traj_point;
     }
 
-    if (imp_->trajectory_buffer[0].timestamp <= timestamp && timestamp <= imp_->trajectory_buffer[1].timestamp &&
-        imp_->trajectory_buffer[0].timestamp != imp_->trajectory_buffer[1].timestamp)
+    if (trajectory[0].timestamp <= timestamp && timestamp <= trajectory[1].timestamp &&
+        trajectory[0].timestamp != trajectory[1].timestamp)
     {
-      const double lerp = (timestamp - imp_->trajectory_buffer[0].timestamp) /
-                          (imp_->trajectory_buffer[1].timestamp - imp_->trajectory_buffer[0].timestamp);
-      position = imp_->trajectory_buffer[0].position +
-                 lerp * (imp_->trajectory_buffer[1].position - imp_->trajectory_buffer[0].position);
-      position += imp_->trajectory_to_sensor_offset;
-      return true;
+      const double lerp = (timestamp - trajectory[0].timestamp) / (trajectory[1].timestamp - trajectory[0].timestamp);
+      sample.origin = trajectory[0].position + lerp * (trajectory[1].position - trajectory[0].position);
+      sample.origin += imp.trajectory_to_sensor_offset;
     }
   }
-  else
-  {
-    position = sample;
-  }
-  return false;
 }
 }  // namespace slamio
@@ -12,6 +12,8 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace slamio
 {
@@ -42,6 +44,15 @@ struct SlamCloudLoaderDetail;
 /// sampling. That is, `SamplePoint::origin = SamplePoint::sample + normal`. See
 /// [RayCloudTools](https://github.com/csiro-robotics/raycloudtools) for more on ray clouds.
 ///
+/// Each open function also accepts a list of sample files, such as a time ordered set of point cloud tiles. See
+/// @c expandFilePattern() to build such a list. Sample files are read in list order. When there is more than one file,
+/// up to @c fileReadAhead() files are streamed in chunks on background threads. The trajectory is always a single
+/// file.
+///
+/// Reading stops at the first sample file which cannot be opened or which ends before its reported point count. The
+/// sample functions then report no more data and @c readError() describes the failure. Callers should check
+/// @c readError() once the samples are exhausted to distinguish a failure from the end of the data.
+///
 /// Typical usage:
 ///
 /// @code
@@ -103,6 +114,18 @@ public:
   /// Check if return number inference is enabled. See @c enableReturnNumberInference() .
   bool returnNumberInference() const;
 
+  /// Set the number of sample files to stream ahead on background threads when reading multiple sample files. Each file
+  /// is decoded one chunk at a time, so the memory overhead is a fixed number of points per file rather than whole
+  /// files. Zero reads the files sequentially on the calling thread.
+  ///
+  /// Must be set before calling @c open() .
+  ///
+  /// @param file_count The number of files to read ahead.
+  void setFileReadAhead(unsigned file_count);
+
+  /// Query the number of sample files to decode ahead. See @c setFileReadAhead() .
+  unsigned fileReadAhead() const;
+
   /// Open the given point cloud and trajectory file pair. Both file must be valid. The @p sample_file_path must be a
   /// point cloud file, while @p trajectory_file_path can be either a point cloud file or a text trajectory.
   ///
@@ -122,11 +145,22 @@ public:
   /// @return True on successfully opening both files.
   bool openWithTrajectory(const char *sample_file_path, const char *trajectory_file_path);
 
+  /// Open a time ordered list of point cloud files with a trajectory file. See @c openWithTrajectory() .
+  /// @param sample_file_paths Point cloud file names, in time order.
+  /// @param trajectory_file_path Point cloud or trajectory file name.
+  /// @return True on successfully opening all files.
+  bool openWithTrajectory(const std::vector<std::string> &sample_file_paths, const char *trajectory_file_path);
+
   /// Open the given point cloud file. This generates @c CloudSample values which have a fixed, zero @p origin value.
   /// @param sample_file_path Point cloud file name.
   /// @return True on successfully opening the point cloud.
   bool openPointCloud(const char *sample_file_path);
 
+  /// Open a time ordered list of point cloud files. See @c openPointCloud() .
+  /// @param sample_file_paths Point cloud file names, in time order.
+  /// @return True on successfully opening all the point clouds.
+  bool openPointCloud(const std::vector<std::string> &sample_file_paths);
+
   /// Open the given ray cloud file. A ray cloud is a point cloud file where the normals channel is used to represent
   /// a vector from the position back to the ray origin.
   ///
@@ -138,15 +172,26 @@ public:
   /// @return True on successfully opening the ray cloud.
   bool openRayCloud(const char *sample_file_path);
 
+  /// Open a time ordered list of ray cloud files. See @c openRayCloud() .
+  /// @param sample_file_paths Ray cloud file names, in time order.
+  /// @return True on successfully opening all the ray clouds.
+  bool openRayCloud(const std::vector<std::string> &sample_file_paths);
+
   /// Close the current input files.
   void close();
 
-  /// Query the number of points. May be zero as some readers do not report the total point count.
+  /// Query the number of points. May be zero as some readers do not report the total point count. This is the total
+  /// across all sample files.
   size_t numberOfPoints() const;
 
   /// Running in real time mode with points given at a rate determined by the the point cloud timestamps?
   bool realTimeMode() const;
 
+  /// Query the error which stopped reading the sample files. Empty when there has been no failure. Set when a sample
+  /// file cannot be opened or ends before its reported point count. Cleared by @c close() .
+  /// @return The read error message.
+  const std::string &readError() const;
+
   /// Do we have a point cloud?
   bool sampleFileIsOpen() const;
   /// Do we have a trajectory?
@@ -174,20 +219,32 @@ public:
   /// Get the next point, sensor position and timestamp.
   bool nextSample(SamplePoint &sample);
 
+  /// Get up to @p count next samples. This is the bulk equivalent of @c nextSample() .
+  ///
+  /// In real time mode, this sleeps until the last sample should be delivered.
+  ///
+  /// @param[out] samples Array to write samples to. Must have space for @p count elements.
+  /// @param count The maximum number of samples to read.
+  /// @return The number of samples read. Zero when there is no more data.
+  size_t nextSamples(SamplePoint *samples, size_t count);
+
 private:
-  bool open(const char *sample_file_path, const char *trajectory_file_path, bool ray_cloud);
+  bool open(const std::vector<std::string> &sample_file_paths, const char *trajectory_file_path, bool ray_cloud);
 
-  bool loadPoint();
+  /// Read and process the next batch of samples from the sample files.
+  /// @return True if any samples were loaded.
+  bool loadBatch();
 
-  /// Sample the trajectory at the given timestamp.
+  /// Sample the trajectory for a set of samples, setting each @c SamplePoint::origin .
   ///
-  /// This reads the trajectory to the segment which covers @p timestamp and
-  /// linearly interpolates a @p position at this time.
+  /// This reads the trajectory to the segment which covers each sample timestamp and linearly interpolates a position
+  /// at this time. The sample timestamps must be non-decreasing. The origin is left unchanged for samples with
+  /// timestamps out of range.
   ///
-  /// @param[out] position Set to the trajectory position on success.
-  /// @param timestamp The desired sample time.
-  /// @return True on success, false when @p timestamp is out of range.
-  bool sampleTrajectory(glm::dvec3 &position, const glm::dvec3 &sample, double timestamp);
+  /// @param samples The sample array.
+  /// @param indices Indices into @p samples of the samples to process.
+  /// @param count Number of @p indices .
+  void sampleTrajectory(SamplePoint *samples, const size_t *indices, size_t count);
 
   std::unique_ptr<SlamCloudLoaderDetail> imp_;
 };
@@ -5,6 +5,7 @@
 // Author: Kazys Stepanas
 #include "SlamIO.h"
 
+#include "PointCloudReaderOhmRays.h"
 #include "PointCloudReaderPly.h"
 #include "PointCloudReaderTraj.h"
 #include "PointCloudReaderXyz.h"
@@ -13,8 +14,15 @@
 #include "PointCloudReaderPdal.h"
 #endif  // SLAMIO_HAVE_PDAL
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define SLAMIO_HAVE_GLOB 1
+#include <glob.h>
+#endif  // defined(__unix__) || defined(__APPLE__)
+
 namespace
 {
 std::string getFileExtension(const std::string &file)
@@ -46,7 +54,11 @@ PointCloudReaderPtr createCloudReader(const char *extension_c)
     extension = extension_c;
   }
 
-  if (extension == "ply")
+  if (extension == "ohmrays")
+  {
+    reader = std::make_shared<PointCloudReaderOhmRays>();
+  }
+  else if (extension == "ply")
   {
     reader = std::make_shared<PointCloudReaderPly>();
   }
@@ -73,4 +85,36 @@ PointCloudReaderPtr createCloudReaderFromFilename(const char *filename)
   const auto extension = getFileExtension(filename);
   return createCloudReader(extension.c_str());
 }
+
+std::vector<std::string> expandFilePattern(const char *pattern)
+{
+  std::vector<std::string> files;
+  if (!pattern || !pattern[0])
+  {
+    return files;
+  }
+
+  if (!std::strpbrk(pattern, "*?["))
+  {
+    files.emplace_back(pattern);
+    return files;
+  }
+
+#ifdef SLAMIO_HAVE_GLOB
+  glob_t matches{};
+  if (glob(pattern, 0, nullptr, &matches) == 0)
+  {
+    for (size_t i = 0; i < matches.gl_pathc; ++i)
+    {
+      files.emplace_back(matches.gl_pathv[i]);
+    }
+  }
+  globfree(&matches);
+  std::sort(files.begin(), files.end());
+#else   // SLAMIO_HAVE_GLOB
+  files.emplace_back(pattern);
+#endif  // SLAMIO_HAVE_GLOB
+
+  return files;
+}
 }  // namespace slamio
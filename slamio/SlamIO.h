@@ -9,6 +9,8 @@
 #include "SlamIOConfig.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace slamio
 {
@@ -27,6 +29,17 @@ PointCloudReaderPtr slamio_API createCloudReader(const char *extension);
 /// @param filename The point cloud file to read.
 /// @return The appropriate reader or a @c nullptr for an unsupported extension.
 PointCloudReaderPtr slamio_API createCloudReaderFromFilename(const char *filename);
+
+/// Expand a file name @p pattern containing wildcards (`*`, `?` or `[...]`) into a sorted list of the matching files.
+///
+/// This is primarily for opening a set of point cloud tiles with @c SlamCloudLoader . Sorting is lexicographic, so
+/// tiles should be named such that this matches time order.
+///
+/// @note Wildcard expansion is only supported on POSIX platforms. Elsewhere the pattern is returned as is.
+/// @param pattern The file name pattern.
+/// @return The matching file names. Contains only @p pattern when it contains no wildcards. Empty when there are no
+///   matches.
+std::vector<std::string> slamio_API expandFilePattern(const char *pattern);
 }  // namespace slamio
 
 #endif  // SLAMIO_SLAMIO_H_
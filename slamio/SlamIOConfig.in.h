@@ -36,5 +36,7 @@
 
 #cmakedefine01 SLAMIO_HAVE_PDAL
 #cmakedefine01 SLAMIO_HAVE_PDAL_STREAMS
+#cmakedefine01 SLAMIO_HAVE_LZ4
+#cmakedefine01 SLAMIO_HAVE_ZSTD
 
 #endif  // SLAMIO_SLAMIOCONFIG_H_
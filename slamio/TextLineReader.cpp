@@ -0,0 +1,275 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "TextLineReader.h"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace slamio
+{
+namespace
+{
+inline bool isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+inline bool isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+/// Fallback parsing using @c strtod() for values outside the fast path.
+const char *parseDoubleStrtod(const char *begin, const char *end, double &value)
+{
+  const char *token_end = begin;
+  while (token_end < end && !isSpace(*token_end))
+  {
+    ++token_end;
+  }
+
+  // strtod() requires a null terminated string.
+  std::array<char, 64> local_buffer;
+  std::string long_buffer;
+  const size_t token_length = size_t(token_end - begin);
+  const char *token = nullptr;
+  if (token_length < local_buffer.size())
+  {
+    std::memcpy(local_buffer.data(), begin, token_length);
+    local_buffer[token_length] = '\0';
+    token = local_buffer.data();
+  }
+  else
+  {
+    long_buffer.assign(begin, token_end);
+    token = long_buffer.c_str();
+  }
+
+  char *parse_end = nullptr;
+  const double parsed = std::strtod(token, &parse_end);
+  if (parse_end == token)
+  {
+    return nullptr;
+  }
+
+  value = parsed;
+  return begin + (parse_end - token);
+}
+}  // namespace
+
+
+TextLineReader::TextLineReader(size_t block_size)
+  : block_size_(block_size ? block_size : kDefaultBlockSize)
+{}
+
+
+TextLineReader::~TextLineReader() = default;
+
+
+bool TextLineReader::open(const char *filename)
+{
+  close();
+  file_.reset(std::fopen(filename, "rb"));
+  return file_ != nullptr;
+}
+
+
+void TextLineReader::close()
+{
+  file_.reset();
+  buffer_.clear();
+  buffer_.shrink_to_fit();
+  cursor_ = line_start_ = data_end_ = 0;
+  eof_ = false;
+}
+
+
+bool TextLineReader::nextLine(const char *&begin, const char *&end)
+{
+  // Number of bytes after the cursor already searched for a line ending.
+  size_t searched = 0;
+  for (;;)
+  {
+    const char *data = buffer_.data();
+    const void *newline = (cursor_ + searched < data_end_) ?
+                            std::memchr(data + cursor_ + searched, '\n', data_end_ - cursor_ - searched) :
+                            nullptr;
+    if (newline)
+    {
+      begin = data + cursor_;
+      end = static_cast<const char *>(newline);
+      line_start_ = cursor_;
+      cursor_ = size_t(end - data) + 1;
+      break;
+    }
+
+    searched = data_end_ - cursor_;
+    if (!fill())
+    {
+      // Final line without a line ending.
+      if (cursor_ >= data_end_)
+      {
+        return false;
+      }
+      data = buffer_.data();
+      begin = data + cursor_;
+      end = data + data_end_;
+      line_start_ = cursor_;
+      cursor_ = data_end_;
+      break;
+    }
+  }
+
+  if (end > begin && end[-1] == '\r')
+  {
+    --end;
+  }
+
+  return true;
+}
+
+
+void TextLineReader::unreadLine()
+{
+  cursor_ = line_start_;
+}
+
+
+bool TextLineReader::fill()
+{
+  if (!file_ || eof_)
+  {
+    return false;
+  }
+
+  // Move the unconsumed data to the start of the buffer.
+  if (cursor_ > 0)
+  {
+    std::memmove(buffer_.data(), buffer_.data() + cursor_, data_end_ - cursor_);
+    data_end_ -= cursor_;
+    line_start_ = (line_start_ > cursor_) ? line_start_ - cursor_ : 0;
+    cursor_ = 0;
+  }
+
+  if (buffer_.size() < data_end_ + block_size_)
+  {
+    buffer_.resize(data_end_ + block_size_);
+  }
+
+  const size_t read_bytes = std::fread(buffer_.data() + data_end_, 1, block_size_, file_.get());
+  data_end_ += read_bytes;
+  // A short read need not be the end of the stream, such as when reading from a pipe. Only stop on end of file or error.
+  eof_ = read_bytes < block_size_ && (std::feof(file_.get()) || std::ferror(file_.get()));
+  return read_bytes > 0;
+}
+
+
+const char *parseDouble(const char *begin, const char *end, double &value)
+{
+  // Exactly representable powers of 10.
+  static const std::array<double, 23> kPow10 = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                                 1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                                 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  // Maximum significant digits which are guaranteed to fit the double mantissa exactly.
+  const int max_fast_digits = 15;
+
+  while (begin < end && isSpace(*begin))
+  {
+    ++begin;
+  }
+
+  if (begin >= end)
+  {
+    return nullptr;
+  }
+
+  const char *cursor = begin;
+  const bool negative = *cursor == '-';
+  if (*cursor == '-' || *cursor == '+')
+  {
+    ++cursor;
+  }
+
+  uint64_t mantissa = 0;
+  int significant_digits = 0;
+  int digit_count = 0;
+  int exponent = 0;
+
+  for (; cursor < end && isDigit(*cursor); ++cursor, ++digit_count)
+  {
+    if (mantissa || *cursor != '0')
+    {
+      mantissa = mantissa * 10u + uint64_t(*cursor - '0');
+      ++significant_digits;
+    }
+  }
+
+  if (cursor < end && *cursor == '.')
+  {
+    ++cursor;
+    for (; cursor < end && isDigit(*cursor); ++cursor, ++digit_count)
+    {
+      if (mantissa || *cursor != '0')
+      {
+        mantissa = mantissa * 10u + uint64_t(*cursor - '0');
+        ++significant_digits;
+      }
+      --exponent;
+    }
+  }
+
+  if (digit_count == 0 || significant_digits > max_fast_digits)
+  {
+    // Not a plain decimal value (e.g., inf, nan, hex) or too many digits for an exact fast path.
+    return parseDoubleStrtod(begin, end, value);
+  }
+
+  if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+  {
+    const char *exponent_cursor = cursor + 1;
+    bool exponent_negative = false;
+    if (exponent_cursor < end && (*exponent_cursor == '-' || *exponent_cursor == '+'))
+    {
+      exponent_negative = *exponent_cursor == '-';
+      ++exponent_cursor;
+    }
+
+    if (exponent_cursor < end && isDigit(*exponent_cursor))
+    {
+      int explicit_exponent = 0;
+      for (; exponent_cursor < end && isDigit(*exponent_cursor); ++exponent_cursor)
+      {
+        if (explicit_exponent < 10000)
+        {
+          explicit_exponent = explicit_exponent * 10 + (*exponent_cursor - '0');
+        }
+      }
+      exponent += (exponent_negative) ? -explicit_exponent : explicit_exponent;
+      cursor = exponent_cursor;
+    }
+    // Otherwise the 'e' is not part of the number, matching strtod().
+  }
+
+  if (cursor < end && !isSpace(*cursor))
+  {
+    // Unexpected suffix, such as a hexadecimal value. Let strtod() decide.
+    return parseDoubleStrtod(begin, end, value);
+  }
+
+  if (exponent < -int(kPow10.size() - 1) || exponent > int(kPow10.size() - 1))
+  {
+    return parseDoubleStrtod(begin, end, value);
+  }
+
+  // Both the mantissa and power of 10 are exact, so a single operation yields a correctly rounded result.
+  double result = double(mantissa);
+  result = (exponent < 0) ? result / kPow10[size_t(-exponent)] : result * kPow10[size_t(exponent)];
+  value = (negative) ? -result : result;
+  return cursor;
+}
+}  // namespace slamio
@@ -0,0 +1,89 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#ifndef SLAMIO_TEXTLINEREADER_H_
+#define SLAMIO_TEXTLINEREADER_H_
+
+#include "SlamIOConfig.h"
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace slamio
+{
+/// A block buffered, line based text file reader.
+///
+/// Lines are read by reading the file in large blocks and splitting lines in place in the block buffer. Each line
+/// is exposed as a character range into the buffer, avoiding per line allocation and copying. Lines are split using
+/// @c memchr() , which is vectorised by most C runtime libraries.
+class TextLineReader
+{
+public:
+  /// Default block size used to read the file.
+  static constexpr size_t kDefaultBlockSize = 1024u * 1024u;
+
+  /// Constructor.
+  /// @param block_size The number of bytes to read from the file at a time. The buffer grows as needed for lines
+  ///   longer than this.
+  explicit TextLineReader(size_t block_size = kDefaultBlockSize);
+  /// Destructor.
+  ~TextLineReader();
+
+  /// Open @p filename for reading.
+  /// @param filename The file to open.
+  /// @return True on success.
+  bool open(const char *filename);
+  /// Close the file.
+  void close();
+  /// Is the file open?
+  /// @return True when open.
+  bool isOpen() const { return file_ != nullptr; }
+
+  /// Fetch the next line. The line range excludes the line ending, with both `\n` and `\r\n` supported.
+  ///
+  /// The line range remains valid until the next call to @c nextLine() or @c close() .
+  ///
+  /// @param[out] begin Set to the first character of the line.
+  /// @param[out] end Set to one past the last character of the line.
+  /// @return True if a line has been read, false at the end of the file.
+  bool nextLine(const char *&begin, const char *&end);
+
+  /// Step back to the start of the last line returned by @c nextLine() so it is returned again.
+  void unreadLine();
+
+private:
+  using FilePtr = std::unique_ptr<FILE, int (*)(FILE *)>;
+
+  /// Read the next block from the file, preserving the unconsumed buffer content.
+  /// @return True if more data have been read.
+  bool fill();
+
+  FilePtr file_{ nullptr, &fclose };
+  std::vector<char> buffer_;
+  size_t block_size_ = kDefaultBlockSize;
+  /// Buffer position for the next line.
+  size_t cursor_ = 0;
+  /// Buffer position of the last line returned.
+  size_t line_start_ = 0;
+  /// End of the valid data in @c buffer_ .
+  size_t data_end_ = 0;
+  /// Set once reading reaches the end of the file or fails.
+  bool eof_ = false;
+};
+
+/// Parse a floating point value from the character range [@p begin, @p end) , skipping leading white space.
+///
+/// Values with up to 15 significant digits and small exponents are parsed directly with exact rounding. Other values,
+/// including @c inf and @c nan , fall back to @c strtod() , so the result always matches @c strtod() .
+///
+/// @param begin The start of the character range.
+/// @param end The end of the character range.
+/// @param[out] value Set to the parsed value on success.
+/// @return A pointer to the character after the parsed value, or null on failure.
+const char slamio_API *parseDouble(const char *begin, const char *end, double &value);
+}  // namespace slamio
+
+#endif  // SLAMIO_TEXTLINEREADER_H_
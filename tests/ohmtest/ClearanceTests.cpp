@@ -0,0 +1,244 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "OhmTestConfig.h"
+
+#include <gtest/gtest.h>
+
+#include <ohm/EdtClearanceProcess.h>
+#include <ohm/MapChunk.h>
+#include <ohm/MapLayout.h>
+#include <ohm/MappingProcess.h>
+#include <ohm/OccupancyMap.h>
+#include <ohm/QueryFlag.h>
+#include <ohm/VoxelBlock.h>
+#include <ohm/VoxelBuffer.h>
+#include <ohm/VoxelData.h>
+
+#include <ohm/private/VoxelAlgorithms.h>
+
+#include "ohmtestcommon/OhmTestUtil.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace clearance
+{
+namespace
+{
+/// Build the test room map with some scattered obstacles and an observation away from the room, leaving unobserved
+/// voxels and missing regions.
+/// @param region_size The voxel dimensions for each map region.
+std::unique_ptr<ohm::OccupancyMap> buildMap(const glm::u8vec3 &region_size)
+{
+  std::unique_ptr<ohm::OccupancyMap> map_ptr = ohmtestutil::createBoxRoomMap(region_size);
+  ohm::OccupancyMap &map = *map_ptr;
+
+  std::mt19937 rand_engine(0x1234u);
+  std::uniform_real_distribution<double> rand(-1.8, 1.8);
+  ohm::Voxel<float> voxel(&map, map.layout().occupancyLayer());
+  for (int i = 0; i < 40; ++i)
+  {
+    voxel.setKey(map.voxelKey(glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine))));
+    ohm::integrateHit(voxel);
+  }
+
+  // Add observations away from the room, leaving unobserved voxels and missing regions in between.
+  voxel.setKey(map.voxelKey(glm::dvec3(4.5, 0.0, 0.0)));
+  ohm::integrateMiss(voxel);
+  voxel.reset();
+  return map_ptr;
+}
+
+
+/// Validate the clearance values in @p map against @c ohm::calculateNearestNeighbour() .
+void validateClearance(const ohm::OccupancyMap &map, const ohm::EdtClearanceProcess &process)
+{
+  const glm::ivec3 half_extents = ohm::calculateVoxelSearchHalfExtents(map, process.searchRadius());
+  const bool unknown_as_occupied = (process.queryFlags() & ohm::kQfUnknownAsOccupied) != 0;
+  const bool report_unscaled = (process.queryFlags() & ohm::kQfReportUnscaledResults) != 0;
+
+  std::vector<const ohm::MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  ohm::Voxel<const float> clearance(&map, map.layout().clearanceLayer());
+  ASSERT_TRUE(clearance.isLayerValid());
+  unsigned obstructed = 0;
+  unsigned unobstructed = 0;
+  for (const ohm::MapChunk *chunk : chunks)
+  {
+    const unsigned voxel_count = unsigned(map.regionVoxelVolume());
+    for (unsigned i = 0; i < voxel_count; ++i)
+    {
+      const ohm::Key key = chunk->keyForIndex(i, map.regionVoxelDimensions());
+      const float expected =
+        ohm::calculateNearestNeighbour(key, map, half_extents, unknown_as_occupied, false, process.searchRadius(),
+                                       process.axisScaling(), report_unscaled);
+      clearance.setKey(key);
+      ASSERT_TRUE(clearance.isValid());
+      ASSERT_NEAR(clearance.data(), expected, 1e-4f) << "region " << chunk->region.coord.x << ","
+                                                     << chunk->region.coord.y << "," << chunk->region.coord.z
+                                                     << " index " << i;
+      obstructed += expected >= 0;
+      unobstructed += expected < 0;
+    }
+  }
+
+  // Make sure we covered both cases.
+  EXPECT_GT(obstructed, 0u);
+  EXPECT_GT(unobstructed, 0u);
+}
+}  // namespace
+
+
+TEST(Clearance, Edt)
+{
+  // Compare the EDT clearance values against the brute force nearest neighbour search for various flags and scaling.
+  const std::unique_ptr<ohm::OccupancyMap> map_ptr = buildMap(glm::u8vec3(8, 10, 12));
+  ohm::OccupancyMap &map = *map_ptr;
+
+  const float search_radius = 0.8f;
+  for (unsigned flags : { 0u, unsigned(ohm::kQfUnknownAsOccupied), unsigned(ohm::kQfReportUnscaledResults) })
+  {
+    for (const glm::vec3 &scaling : { glm::vec3(1.0f), glm::vec3(1.0f, 1.5f, 2.0f) })
+    {
+      if ((flags & ohm::kQfReportUnscaledResults) && scaling != glm::vec3(1.0f))
+      {
+        // Equidistant obstructions may resolve differently, changing the unscaled range.
+        continue;
+      }
+      ohm::EdtClearanceProcess process(search_radius, flags);
+      process.setAxisScaling(scaling);
+      process.calculateForExtents(map, glm::dvec3(-10.0), glm::dvec3(10.0));
+      validateClearance(map, process);
+    }
+  }
+}
+
+
+TEST(Clearance, EdtUpdate)
+{
+  // Validate threaded and incremental updates.
+  const std::unique_ptr<ohm::OccupancyMap> map_ptr = buildMap(glm::u8vec3(8));
+  const std::unique_ptr<ohm::OccupancyMap> threaded_map_ptr = buildMap(glm::u8vec3(8));
+  ohm::OccupancyMap &map = *map_ptr;
+  ohm::OccupancyMap &threaded_map = *threaded_map_ptr;
+
+  ohm::EdtClearanceProcess process(0.6f, ohm::kQfUnknownAsOccupied);
+  ohm::EdtClearanceProcess threaded_process(0.6f, ohm::kQfUnknownAsOccupied);
+  threaded_process.setThreadCount(0);
+
+  EXPECT_EQ(process.update(map, 0.0), ohm::kMprUpToDate);
+  EXPECT_EQ(threaded_process.update(threaded_map, 0.0), ohm::kMprUpToDate);
+  validateClearance(map, process);
+
+  const auto compare_maps = [&map, &threaded_map]() {
+    std::vector<const ohm::MapChunk *> chunks;
+    map.enumerateRegions(chunks);
+    ohm::Voxel<const float> clearance(&map, map.layout().clearanceLayer());
+    ohm::Voxel<const float> threaded_clearance(&threaded_map, threaded_map.layout().clearanceLayer());
+    for (const ohm::MapChunk *chunk : chunks)
+    {
+      for (unsigned i = 0; i < unsigned(map.regionVoxelVolume()); ++i)
+      {
+        const ohm::Key key = chunk->keyForIndex(i, map.regionVoxelDimensions());
+        clearance.setKey(key);
+        threaded_clearance.setKey(key);
+        ASSERT_TRUE(threaded_clearance.isValid());
+        ASSERT_EQ(clearance.data(), threaded_clearance.data());
+      }
+    }
+  };
+  compare_maps();
+
+  // Record the clearance stamps, then modify the map at a single voxel.
+  const int clearance_layer = map.layout().clearanceLayer();
+  std::vector<const ohm::MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  std::vector<uint64_t> stamps;
+  for (const ohm::MapChunk *chunk : chunks)
+  {
+    stamps.emplace_back(chunk->touched_stamps[clearance_layer]);
+  }
+
+  for (ohm::OccupancyMap *target_map : { &map, &threaded_map })
+  {
+    ohm::Voxel<float> voxel(target_map, target_map->layout().occupancyLayer());
+    voxel.setKey(target_map->voxelKey(glm::dvec3(-1.5, -1.5, -1.5)));
+    for (int i = 0; i < 10; ++i)
+    {
+      ohm::integrateHit(voxel);
+    }
+  }
+
+  EXPECT_EQ(process.update(map, 0.0), ohm::kMprUpToDate);
+  EXPECT_EQ(threaded_process.update(threaded_map, 0.0), ohm::kMprUpToDate);
+  validateClearance(map, process);
+  compare_maps();
+
+  // Only the regions around the modified voxel should have been updated.
+  unsigned updated_count = 0;
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    updated_count += chunks[i]->touched_stamps[clearance_layer] != stamps[i];
+  }
+  EXPECT_GT(updated_count, 0u);
+  EXPECT_LT(updated_count, chunks.size());
+}
+
+
+TEST(Clearance, EdtHalo)
+{
+  // Changes to a region must update the clearance values of the regions within its halo, including writes which do not
+  // touch the stamps and removal of the region. Use narrow regions so the halo spans two regions along x.
+  const std::unique_ptr<ohm::OccupancyMap> map_ptr = buildMap(glm::u8vec3(2, 8, 8));
+  ohm::OccupancyMap &map = *map_ptr;
+
+  ohm::EdtClearanceProcess process(0.8f, 0u);
+  EXPECT_EQ(process.update(map, 0.0), ohm::kMprUpToDate);
+  validateClearance(map, process);
+
+  const int clearance_layer = map.layout().clearanceLayer();
+  const glm::i16vec3 region_a = map.regionKey(glm::dvec3(1.7, 0.5, 0.5));
+  // Within the halo of region_a, but not adjacent.
+  const glm::i16vec3 region_b = region_a - glm::i16vec3(2, 0, 0);
+  // Outside the halo of region_a.
+  const glm::i16vec3 region_c = region_a - glm::i16vec3(6, 0, 0);
+  const auto clearance_stamp = [&map, clearance_layer](const glm::i16vec3 &region_key) -> uint64_t {
+    const ohm::MapChunk *chunk = map.region(region_key);
+    return (chunk) ? uint64_t(chunk->touched_stamps[clearance_layer]) : 0u;
+  };
+  ASSERT_NE(map.region(region_a), nullptr);
+  ASSERT_NE(map.region(region_b), nullptr);
+  ASSERT_NE(map.region(region_c), nullptr);
+
+  // Occupy region_a through a voxel buffer, leaving the touched stamps unchanged.
+  uint64_t stamp_b = clearance_stamp(region_b);
+  const uint64_t stamp_c = clearance_stamp(region_c);
+  {
+    ohm::MapChunk *chunk = map.region(region_a);
+    ohm::VoxelBuffer<ohm::VoxelBlock> buffer(chunk->voxel_blocks[map.layout().occupancyLayer()]);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    float *occupancy = reinterpret_cast<float *>(buffer.voxelMemory());
+    std::fill(occupancy, occupancy + map.regionVoxelVolume(), map.hitValue());
+  }
+  EXPECT_EQ(process.update(map, 0.0), ohm::kMprUpToDate);
+  validateClearance(map, process);
+  EXPECT_NE(clearance_stamp(region_b), stamp_b);
+  EXPECT_EQ(clearance_stamp(region_c), stamp_c);
+
+  // Remove region_a and the regions beyond it.
+  stamp_b = clearance_stamp(region_b);
+  const double max_x =
+    map.regionCentreGlobal(region_a).x - 0.5 * map.regionSpatialResolution().x - 0.5 * map.resolution();
+  map.cullRegionsOutside(glm::dvec3(-10.0), glm::dvec3(max_x, 10.0, 10.0));
+  ASSERT_EQ(map.region(region_a), nullptr);
+  EXPECT_EQ(process.update(map, 0.0), ohm::kMprUpToDate);
+  validateClearance(map, process);
+  EXPECT_NE(clearance_stamp(region_b), stamp_b);
+  EXPECT_EQ(clearance_stamp(region_c), stamp_c);
+}
+}  // namespace clearance
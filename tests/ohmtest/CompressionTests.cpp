@@ -9,22 +9,144 @@
 
 #include <ohm/DefaultLayer.h>
 #include <ohm/MapLayer.h>
+#include <ohm/MapChunk.h>
 #include <ohm/MapLayout.h>
+#include <ohm/NdtMap.h>
 #include <ohm/OccupancyMap.h>
+#include <ohm/RayMapperNdt.h>
+#include <ohm/RayMapperTsdf.h>
+#include <ohm/Voxel.h>
 #include <ohm/VoxelBlock.h>
 #include <ohm/VoxelBlockCompressionQueue.h>
+#include <ohm/VoxelBuffer.h>
+#include <ohm/VoxelCodec.h>
+#include <ohm/VoxelMean.h>
+#include <ohm/VoxelOccupancy.h>
 
 #include <ohmutil/OhmUtil.h>
 
 #include <logutil/LogUtil.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <random>
 
 namespace
 {
 using Clock = std::chrono::high_resolution_clock;
+
+const ohm::VoxelCodec::Type kCodecTypes[] = { ohm::VoxelCodec::kZLib, ohm::VoxelCodec::kGZip, ohm::VoxelCodec::kLz4,
+                                              ohm::VoxelCodec::kZstd };
+
+/// Generate rays from a sensor moving through a room with a floor, walls and some clutter.
+std::vector<glm::dvec3> generateRoomRays(size_t ray_count)
+{
+  std::default_random_engine rng(1153297050u);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::uniform_real_distribution<double> noise(-0.02, 0.02);
+  std::uniform_int_distribution<int> surface(0, 5);
+  const glm::dvec3 half_extents(8.0, 6.0, 1.5);
+
+  std::vector<glm::dvec3> rays;
+  rays.reserve(ray_count * 2);
+  for (size_t i = 0; i < ray_count; ++i)
+  {
+    const double time = 1e-4 * double(i);
+    const glm::dvec3 sensor(4.0 * std::cos(time), 3.0 * std::sin(time), 0.0);
+    glm::dvec3 sample(half_extents.x * uniform(rng), half_extents.y * uniform(rng), half_extents.z * uniform(rng));
+    switch (surface(rng))
+    {
+    case 0:  // Floor
+    case 1:
+      sample.z = -half_extents.z + noise(rng);
+      break;
+    case 2:  // Walls
+      sample.x = std::copysign(half_extents.x, sample.x) + noise(rng);
+      break;
+    case 3:
+      sample.y = std::copysign(half_extents.y, sample.y) + noise(rng);
+      break;
+    case 4:  // Ceiling
+      sample.z = half_extents.z + noise(rng);
+      break;
+    default:  // Clutter in a central column.
+      sample.x = 0.5 * sample.x / half_extents.x;
+      sample.y = 0.5 * sample.y / half_extents.y;
+      break;
+    }
+    rays.emplace_back(sensor);
+    rays.emplace_back(sample);
+  }
+  return rays;
 }
 
+/// Extract the uncompressed voxel data for @p layer_index from each region in @p map .
+std::vector<std::vector<uint8_t>> collectLayerBlocks(const ohm::OccupancyMap &map, int layer_index)
+{
+  std::vector<const ohm::MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  std::vector<std::vector<uint8_t>> blocks;
+  blocks.reserve(chunks.size());
+  for (const ohm::MapChunk *chunk : chunks)
+  {
+    ohm::VoxelBuffer<const ohm::VoxelBlock> buffer(chunk->voxel_blocks[layer_index]);
+    blocks.emplace_back(buffer.voxelMemory(), buffer.voxelMemory() + buffer.voxelMemorySize());
+  }
+  return blocks;
+}
+
+/// Compress and decompress all @p blocks with @p codec , validating the results and reporting the throughput and
+/// compression ratio.
+void benchmarkCodec(const char *layer_name, const ohm::VoxelCodec &codec, const char *label,
+                    const std::vector<std::vector<uint8_t>> &blocks)
+{
+  std::vector<std::vector<uint8_t>> compressed(blocks.size());
+  size_t uncompressed_size = 0;
+  size_t compressed_size = 0;
+
+  const auto compress_start = Clock::now();
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    ASSERT_TRUE(codec.compress(blocks[i].data(), blocks[i].size(), compressed[i])) << label;
+  }
+  const auto compress_end = Clock::now();
+
+  std::vector<uint8_t> expanded;
+  const auto decompress_start = Clock::now();
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    expanded.resize(blocks[i].size());
+    ASSERT_TRUE(codec.decompress(compressed[i].data(), compressed[i].size(), expanded.data(), expanded.size()))
+      << label;
+  }
+  const auto decompress_end = Clock::now();
+
+  // Validate outside of the timing loop.
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    expanded.resize(blocks[i].size());
+    ASSERT_TRUE(codec.decompress(compressed[i].data(), compressed[i].size(), expanded.data(), expanded.size()));
+    ASSERT_EQ(memcmp(expanded.data(), blocks[i].data(), expanded.size()), 0) << label << " block " << i;
+    uncompressed_size += blocks[i].size();
+    compressed_size += compressed[i].size();
+  }
+
+  const auto mb_per_second = [uncompressed_size](const Clock::duration &elapsed) {
+    const double seconds = std::max(std::chrono::duration<double>(elapsed).count(), 1e-9);
+    return double(uncompressed_size) / (1024.0 * 1024.0) / seconds;
+  };
+
+  const double ratio = double(uncompressed_size) / double(std::max<size_t>(compressed_size, 1u));
+  std::cout << std::setfill(' ') << std::setw(12) << layer_name << std::setw(16) << label << " ratio " << std::setw(8)
+            << std::fixed << std::setprecision(2) << ratio
+            << " compress " << std::setw(9) << mb_per_second(compress_end - compress_start) << " MiB/s"
+            << " decompress " << std::setw(9) << mb_per_second(decompress_end - decompress_start) << " MiB/s"
+            << std::defaultfloat << std::endl;
+}
+}  // namespace
+
 TEST(Compression, Simple)
 {
   ohm::VoxelBlockCompressionQueue compressor(true);  // Instantiate in test mode
@@ -48,15 +170,18 @@ TEST(Compression, Simple)
   compressor.setHighTide((block_count + 1) * layer_mem_size);
   compressor.__tick(compression_buffer);
 
-  // No compression should have occurred.
+  // New blocks are uniform, holding only a single voxel.
   std::cout << "allocated: " << logutil::Bytes(compressor.estimatedAllocationSize()) << std::endl;
-  EXPECT_EQ(compressor.estimatedAllocationSize(), uncompressed_size);
+  EXPECT_EQ(compressor.estimatedAllocationSize(), block_count * layer.voxelByteSize());
 
-  // Now lock all the buffers and set a zero high/low water mark. Everything should stay allocated.
+  // Now lock all the buffers, allocating the voxel memory, and set a zero high/low water mark. Everything should stay
+  // allocated.
   for (auto &block : blocks)
   {
     block->retain();
   }
+  compressor.__tick(compression_buffer);
+  EXPECT_EQ(compressor.estimatedAllocationSize(), uncompressed_size);
   compressor.setHighTide(0);
   compressor.setLowTide(0);
   compressor.__tick(compression_buffer);
@@ -153,6 +278,9 @@ TEST(Compression, HighLoad)
     blocks.emplace_back();
     blocks[i].reset(new ohm::VoxelBlock(map.detail(), layer));
     compressor.push(blocks[i].get());
+    // Allocate the voxel memory.
+    blocks[i]->retain();
+    blocks[i]->release();
   }
   // Set the high water mark above the current allocation size.
   compressor.setHighTide((block_count + 1) * layer_mem_size);
@@ -183,3 +311,489 @@ TEST(Compression, HighLoad)
   EXPECT_EQ(compressor.estimatedAllocationSize(), 0);
   std::cout << "Release tick: " << (end - start) << std::endl;
 }
+
+
+TEST(Compression, LeastRecentFirst)
+{
+  ohm::VoxelBlockCompressionQueue compressor(true);  // Instantiate in test mode
+  // Create a map in order to use the layout. DO NOT SET kCompressed. That would start a new compression object.
+  ohm::OccupancyMap map(1.0, ohm::MapFlag::kNone);
+  std::vector<ohm::VoxelBlock::Ptr> blocks;
+  std::vector<uint8_t> compression_buffer;
+
+  // Use all available threads to compress.
+  compressor.setWorkerCount(0);
+
+  const size_t block_count = 10;
+  const ohm::MapLayer &layer = map.layout().layer(map.layout().occupancyLayer());
+  const size_t layer_mem_size = layer.layerByteSize(map.regionVoxelDimensions());
+  for (size_t i = 0; i < block_count; ++i)
+  {
+    blocks.emplace_back();
+    blocks[i].reset(new ohm::VoxelBlock(map.detail(), layer));
+    compressor.push(blocks[i].get());
+    blocks[i]->retain();
+  }
+
+  // Release the blocks, then order the release times so the last block is the least recently used.
+  const ohm::VoxelBlock::Clock::time_point release_base = ohm::VoxelBlock::Clock::now();
+  for (size_t i = 0; i < block_count; ++i)
+  {
+    blocks[i]->release();
+    blocks[i]->setReleaseAfter(release_base + std::chrono::seconds(block_count - i));
+  }
+
+  // Set the tides to compress half the blocks.
+  compressor.setHighTide(0);
+  compressor.setLowTide(layer_mem_size * block_count / 2 + layer_mem_size / 2);
+  compressor.__tick(compression_buffer);
+
+  // Expect the least recently released blocks to be compressed.
+  for (size_t i = 0; i < block_count; ++i)
+  {
+    const bool expect_compressed = i >= block_count / 2;
+    EXPECT_EQ(!(blocks[i]->flags() & ohm::VoxelBlock::kFUncompressed), expect_compressed) << "block " << i;
+  }
+
+  const ohm::VoxelBlockCompressionQueue::Stats stats = compressor.stats();
+  EXPECT_EQ(stats.blocks_compressed, block_count / 2);
+  EXPECT_GT(stats.bytes_saved, 0u);
+  EXPECT_LE(stats.bytes_saved, layer_mem_size * block_count / 2);
+
+  // Ensure the blocks are releases.
+  blocks.clear();
+  compressor.__tick(compression_buffer);
+}
+
+
+TEST(Compression, Uniform)
+{
+  ohm::VoxelBlockCompressionQueue compressor(true);  // Instantiate in test mode
+  // Create a map in order to use the layout. DO NOT SET kCompressed. That would start a new compression object.
+  ohm::OccupancyMap map(1.0, ohm::MapFlag::kNone);
+  const ohm::MapLayer &layer = map.layout().layer(map.layout().occupancyLayer());
+  ohm::VoxelBlock::Ptr block(new ohm::VoxelBlock(map.detail(), layer));
+
+  const auto validate_voxels = [&block](float expected, size_t modified_index, float modified_value) {
+    const auto *voxels = reinterpret_cast<const float *>(block->voxelBytes());
+    const size_t voxel_count = block->uncompressedByteSize() / sizeof(float);
+    for (size_t i = 0; i < voxel_count; ++i)
+    {
+      ASSERT_EQ(voxels[i], (i == modified_index) ? modified_value : expected) << i;
+    }
+  };
+
+  // New blocks start uniform with a single voxel allocation.
+  EXPECT_TRUE(block->flags() & ohm::VoxelBlock::kFUniform);
+  EXPECT_FALSE(block->flags() & ohm::VoxelBlock::kFUncompressed);
+  EXPECT_EQ(block->allocatedByteSize(), layer.voxelByteSize());
+
+  // Retaining expands to the dense clear pattern.
+  block->retain();
+  EXPECT_FALSE(block->flags() & ohm::VoxelBlock::kFUniform);
+  EXPECT_TRUE(block->flags() & ohm::VoxelBlock::kFUncompressed);
+  EXPECT_EQ(block->allocatedByteSize(), block->uncompressedByteSize());
+  validate_voxels(ohm::unobservedOccupancyValue(), ~size_t(0u), 0.0f);
+  block->release();
+
+  // Unmodified voxels collapse back to uniform.
+  EXPECT_EQ(block->compress(), layer.voxelByteSize());
+  EXPECT_TRUE(block->flags() & ohm::VoxelBlock::kFUniform);
+  EXPECT_EQ(block->allocatedByteSize(), layer.voxelByteSize());
+
+  // Modify a single voxel. The block must now compress with the codec and preserve the modification.
+  const size_t modified_index = 17;
+  block->retain();
+  reinterpret_cast<float *>(block->voxelBytes())[modified_index] = 0.5f;
+  block->release();
+  EXPECT_GT(block->compress(), 0u);
+  EXPECT_FALSE(block->flags() & (ohm::VoxelBlock::kFUniform | ohm::VoxelBlock::kFUncompressed));
+  block->retain();
+  validate_voxels(ohm::unobservedOccupancyValue(), modified_index, 0.5f);
+
+  // Set all voxels to a new value and ensure it collapses to that value.
+  const float fill_value = -0.25f;
+  auto *voxels = reinterpret_cast<float *>(block->voxelBytes());
+  std::fill(voxels, voxels + block->uncompressedByteSize() / sizeof(float), fill_value);
+  block->release();
+  EXPECT_EQ(block->compress(), layer.voxelByteSize());
+  EXPECT_TRUE(block->flags() & ohm::VoxelBlock::kFUniform);
+  block->retain();
+  validate_voxels(fill_value, ~size_t(0u), 0.0f);
+  block->release();
+
+  // Reset returns to the uniform clear pattern.
+  block->reset(layer);
+  EXPECT_TRUE(block->flags() & ohm::VoxelBlock::kFUniform);
+  block->retain();
+  validate_voxels(ohm::unobservedOccupancyValue(), ~size_t(0u), 0.0f);
+  block->release();
+}
+
+
+TEST(Compression, UniformReset)
+{
+  // Validate the compression queue accounting for a block reset to uniform while keeping its voxel memory capacity.
+  ohm::VoxelBlockCompressionQueue compressor(true);  // Instantiate in test mode
+  // Create a map in order to use the layout. DO NOT SET kCompressed. That would start a new compression object.
+  ohm::OccupancyMap map(1.0, ohm::MapFlag::kNone);
+  const ohm::MapLayer &layer = map.layout().layer(map.layout().occupancyLayer());
+  std::vector<ohm::VoxelBlock::Ptr> blocks;
+  blocks.emplace_back(new ohm::VoxelBlock(map.detail(), layer));
+  ohm::VoxelBlock &block = *blocks.back();
+  std::vector<uint8_t> compression_buffer;
+  compressor.push(&block);
+
+  // Keep the tides high while accumulating allocation.
+  compressor.setHighTide(~uint64_t(0u));
+  compressor.setLowTide(~uint64_t(0u));
+  block.retain();
+  block.release();
+  compressor.__tick(compression_buffer);
+  EXPECT_EQ(compressor.estimatedAllocationSize(), block.uncompressedByteSize());
+
+  // Reset keeps the capacity, which must still be counted.
+  block.reset(layer);
+  EXPECT_TRUE(block.flags() & ohm::VoxelBlock::kFUniform);
+  EXPECT_EQ(block.allocatedByteSize(), block.uncompressedByteSize());
+  compressor.__tick(compression_buffer);
+  EXPECT_EQ(compressor.estimatedAllocationSize(), block.uncompressedByteSize());
+
+  // Under memory pressure the queue releases the kept capacity.
+  compressor.setHighTide(0);
+  compressor.setLowTide(0);
+  compressor.__tick(compression_buffer);
+  EXPECT_TRUE(block.flags() & ohm::VoxelBlock::kFUniform);
+  EXPECT_EQ(block.allocatedByteSize(), layer.voxelByteSize());
+  compressor.__tick(compression_buffer);
+  EXPECT_EQ(compressor.estimatedAllocationSize(), layer.voxelByteSize());
+
+  // Ensure the blocks are released.
+  blocks.clear();
+  compressor.__tick(compression_buffer);
+  EXPECT_EQ(compressor.estimatedAllocationSize(), 0u);
+}
+
+
+TEST(Compression, UniformMapMemory)
+{
+  // Populate only the occupancy layer of a map with additional layers. The other layers remain uniform and the
+  // approximate memory should reflect this.
+  ohm::OccupancyMap map(0.1, glm::u8vec3(32), ohm::MapFlag::kNone);
+  ohm::MapLayout layout = map.layout();
+  ohm::addVoxelMean(layout);
+  ohm::addCovariance(layout);
+  map.updateLayout(layout);
+
+  ohm::Voxel<float> voxel(&map, map.layout().occupancyLayer());
+  for (int i = 0; i < 10; ++i)
+  {
+    voxel.setKey(map.voxelKey(glm::dvec3(i * 4.0, 0, 0)));
+    ohm::integrateHit(voxel);
+  }
+  voxel.reset();
+
+  size_t dense_layer_bytes = 0;
+  for (unsigned i = 0; i < map.layout().layerCount(); ++i)
+  {
+    dense_layer_bytes += map.layout().layer(i).layerByteSize(map.regionVoxelDimensions());
+  }
+  const size_t occupancy_bytes =
+    map.layout().layer(map.layout().occupancyLayer()).layerByteSize(map.regionVoxelDimensions());
+
+  const size_t memory = map.calculateApproximateMemory();
+  std::cout << "regions: " << map.regionCount() << " memory: " << logutil::Bytes(memory)
+            << " dense: " << logutil::Bytes(map.regionCount() * dense_layer_bytes) << std::endl;
+  EXPECT_GE(memory, map.regionCount() * occupancy_bytes);
+  EXPECT_LT(memory, map.regionCount() * (occupancy_bytes + (dense_layer_bytes - occupancy_bytes) / 2));
+}
+
+
+TEST(Compression, UniformReadOnly)
+{
+  // Read every voxel of a map of uniform regions. Read only access must not allocate the dense voxel memory.
+  ohm::OccupancyMap map(0.1, glm::u8vec3(16), ohm::MapFlag::kNone);
+  ohm::MapLayout layout = map.layout();
+  ohm::addVoxelMean(layout);
+  map.updateLayout(layout);
+  for (int i = 0; i < 8; ++i)
+  {
+    ASSERT_NE(map.region(glm::i16vec3(i, 0, 0), true), nullptr);
+  }
+
+  const size_t uniform_memory = map.calculateApproximateMemory();
+  const int occupancy_layer = map.layout().occupancyLayer();
+  const size_t voxel_count = map.regionVoxelVolume();
+  const ohm::MapChunk *first_chunk = map.region(glm::i16vec3(0));
+  const ohm::MapChunk *second_chunk = map.region(glm::i16vec3(1, 0, 0));
+
+  // Concurrent read only buffers over matching uniform blocks share the same expansion.
+  {
+    ohm::VoxelBuffer<const ohm::VoxelBlock> first(first_chunk->voxel_blocks[occupancy_layer]);
+    ohm::VoxelBuffer<const ohm::VoxelBlock> second(second_chunk->voxel_blocks[occupancy_layer]);
+    EXPECT_EQ(first.voxelMemory(), second.voxelMemory());
+    EXPECT_TRUE(first_chunk->voxel_blocks[occupancy_layer]->flags() & ohm::VoxelBlock::kFUniform);
+    for (unsigned i = 0; i < voxel_count; ++i)
+    {
+      float value{};
+      first.readVoxel(i, &value);
+      ASSERT_EQ(value, ohm::unobservedOccupancyValue()) << i;
+    }
+  }
+
+  // Read all voxels using the Voxel interface.
+  const ohm::OccupancyMap &const_map = map;
+  ohm::Voxel<const float> occupancy(&const_map, occupancy_layer);
+  ohm::Voxel<const ohm::VoxelMean> mean(&const_map, const_map.layout().meanLayer());
+  for (int i = 0; i < 8; ++i)
+  {
+    ohm::setVoxelKey(ohm::Key(glm::i16vec3(i, 0, 0), 0, 0, 0), occupancy, mean);
+    do
+    {
+      mean.setKey(occupancy);
+      ASSERT_TRUE(occupancy.isValid());
+      ASSERT_TRUE(mean.isValid());
+      ASSERT_EQ(occupancy.data(), ohm::unobservedOccupancyValue());
+      ASSERT_EQ(mean.data().count, 0u);
+    } while (occupancy.nextInRegion());
+  }
+  occupancy.reset();
+  mean.reset();
+
+  EXPECT_EQ(map.calculateApproximateMemory(), uniform_memory);
+  std::vector<const ohm::MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  for (const ohm::MapChunk *chunk : chunks)
+  {
+    for (const auto &block : chunk->voxel_blocks)
+    {
+      EXPECT_TRUE(block->flags() & ohm::VoxelBlock::kFUniform);
+      EXPECT_EQ(block->allocatedByteSize(), block->perVoxelByteSize());
+    }
+  }
+
+  // Writing allocates the block. Without compression, it collapses again on release if all voxels remain equal, but
+  // keeps the capacity until compressed.
+  ohm::VoxelBlock &block = *first_chunk->voxel_blocks[occupancy_layer];
+  {
+    ohm::VoxelBuffer<ohm::VoxelBlock> buffer(first_chunk->voxel_blocks[occupancy_layer]);
+    EXPECT_TRUE(block.flags() & ohm::VoxelBlock::kFUncompressed);
+    for (unsigned i = 0; i < voxel_count; ++i)
+    {
+      buffer.writeVoxel(i, -1.0f);
+    }
+  }
+  EXPECT_TRUE(block.flags() & ohm::VoxelBlock::kFUniform);
+  EXPECT_EQ(block.allocatedByteSize(), block.uncompressedByteSize());
+  EXPECT_EQ(block.compress(), block.perVoxelByteSize());
+  EXPECT_EQ(block.allocatedByteSize(), block.perVoxelByteSize());
+
+  // A differing voxel keeps the dense memory.
+  {
+    ohm::VoxelBuffer<ohm::VoxelBlock> buffer(first_chunk->voxel_blocks[occupancy_layer]);
+    buffer.writeVoxel(3, 1.0f);
+  }
+  EXPECT_TRUE(block.flags() & ohm::VoxelBlock::kFUncompressed);
+  EXPECT_EQ(block.allocatedByteSize(), block.uncompressedByteSize());
+  {
+    ohm::VoxelBuffer<const ohm::VoxelBlock> buffer(first_chunk->voxel_blocks[occupancy_layer]);
+    float value{};
+    buffer.readVoxel(3, &value);
+    EXPECT_EQ(value, 1.0f);
+    buffer.readVoxel(4, &value);
+    EXPECT_EQ(value, -1.0f);
+  }
+}
+
+
+TEST(Compression, UncompressedRetainCycle)
+{
+  // Writable retains of an uncompressed map must not reallocate the voxel memory when released and retained again.
+  ohm::OccupancyMap map(0.1, glm::u8vec3(16), ohm::MapFlag::kNone);
+  const int occupancy_layer = map.layout().occupancyLayer();
+  const ohm::MapChunk *chunk = map.region(glm::i16vec3(0), true);
+  ASSERT_NE(chunk, nullptr);
+  ohm::VoxelBlock &block = *chunk->voxel_blocks[occupancy_layer];
+
+  const uint8_t *voxel_memory = nullptr;
+  {
+    ohm::VoxelBuffer<ohm::VoxelBlock> buffer(chunk->voxel_blocks[occupancy_layer]);
+    voxel_memory = block.voxelBytes();
+  }
+
+  // Retained for write, but not written: the block stays dense and uncollapsed.
+  for (int i = 0; i < 4; ++i)
+  {
+    ohm::VoxelBuffer<ohm::VoxelBlock> buffer(chunk->voxel_blocks[occupancy_layer]);
+    float value{};
+    buffer.readVoxel(0, &value);
+    EXPECT_EQ(value, ohm::unobservedOccupancyValue());
+    EXPECT_EQ(block.voxelBytes(), voxel_memory);
+  }
+  EXPECT_TRUE(block.flags() & ohm::VoxelBlock::kFUncompressed);
+  EXPECT_EQ(block.allocatedByteSize(), block.uncompressedByteSize());
+
+  // Written with a uniform value: the block collapses, but reuses the same memory when retained again.
+  const size_t voxel_count = map.regionVoxelVolume();
+  for (int i = 0; i < 4; ++i)
+  {
+    ohm::VoxelBuffer<ohm::VoxelBlock> buffer(chunk->voxel_blocks[occupancy_layer]);
+    EXPECT_EQ(block.voxelBytes(), voxel_memory);
+    for (unsigned j = 0; j < voxel_count; ++j)
+    {
+      buffer.writeVoxel(j, float(i));
+    }
+  }
+  EXPECT_TRUE(block.flags() & ohm::VoxelBlock::kFUniform);
+  EXPECT_EQ(block.allocatedByteSize(), block.uncompressedByteSize());
+}
+
+
+TEST(Compression, Codecs)
+{
+  // Generate a repetitive data set similar to an occupancy layer.
+  std::vector<float> source(32 * 32 * 32, ohm::unobservedOccupancyValue());
+  for (size_t i = 0; i < source.size(); i += 7)
+  {
+    source[i] = (i % 3) ? 0.85f : -0.4f;
+  }
+  const auto *source_bytes = reinterpret_cast<const uint8_t *>(source.data());
+  const size_t source_size = source.size() * sizeof(*source.data());
+
+  for (ohm::VoxelCodec::Type type : kCodecTypes)
+  {
+    ohm::VoxelCodec::Ptr codec = ohm::VoxelCodec::create(type);
+    if (!ohm::VoxelCodec::supported(type))
+    {
+      EXPECT_EQ(codec, nullptr);
+      std::cout << ohm::VoxelCodec::typeName(type) << " not supported" << std::endl;
+      continue;
+    }
+    ASSERT_NE(codec, nullptr);
+    EXPECT_EQ(codec->type(), type);
+
+    std::vector<uint8_t> compressed;
+    ASSERT_TRUE(codec->compress(source_bytes, source_size, compressed)) << codec->name();
+    EXPECT_LT(compressed.size(), source_size) << codec->name();
+
+    std::vector<float> expanded(source.size());
+    ASSERT_TRUE(codec->decompress(compressed.data(), compressed.size(), reinterpret_cast<uint8_t *>(expanded.data()),
+                                  source_size))
+      << codec->name();
+    EXPECT_EQ(memcmp(expanded.data(), source.data(), source_size), 0) << codec->name();
+
+    // Decompressing into the wrong size buffer must fail.
+    EXPECT_FALSE(codec->decompress(compressed.data(), compressed.size(), reinterpret_cast<uint8_t *>(expanded.data()),
+                                   source_size / 2))
+      << codec->name();
+  }
+}
+
+
+TEST(Compression, LayerCodec)
+{
+  ohm::VoxelBlockCompressionQueue compressor(true);  // Instantiate in test mode
+  // Create a map in order to use the layout. DO NOT SET kCompressed. That would start a new compression object.
+  ohm::OccupancyMap map(1.0, ohm::MapFlag::kNone);
+  ohm::MapLayer &layer = *map.layout().layerPtr(map.layout().occupancyLayer());
+
+  for (ohm::VoxelCodec::Type type : kCodecTypes)
+  {
+    if (!ohm::VoxelCodec::supported(type))
+    {
+      continue;
+    }
+
+    layer.setCodec(ohm::VoxelCodec::create(type));
+    ohm::VoxelBlock::Ptr block(new ohm::VoxelBlock(map.detail(), layer));
+
+    // Write a pattern to the block.
+    block->retain();
+    auto *voxels = reinterpret_cast<float *>(block->voxelBytes());
+    const size_t voxel_count = block->uncompressedByteSize() / sizeof(float);
+    for (size_t i = 0; i < voxel_count; i += 3)
+    {
+      voxels[i] = float(i % 11);
+    }
+    std::vector<uint8_t> expected(block->voxelBytes(), block->voxelBytes() + block->uncompressedByteSize());
+    block->release();
+
+    const size_t compressed_size = block->compress();
+    ASSERT_GT(compressed_size, 0u) << ohm::VoxelCodec::typeName(type);
+    EXPECT_LT(compressed_size, block->uncompressedByteSize()) << ohm::VoxelCodec::typeName(type);
+    EXPECT_FALSE(block->flags() & ohm::VoxelBlock::kFUncompressed);
+
+    // Change the layer codec. The block must still decompress using the codec it was compressed with.
+    layer.setCodec(nullptr);
+
+    block->retain();
+    EXPECT_TRUE(block->flags() & ohm::VoxelBlock::kFUncompressed);
+    EXPECT_EQ(memcmp(block->voxelBytes(), expected.data(), expected.size()), 0) << ohm::VoxelCodec::typeName(type);
+    block->release();
+  }
+
+  // Copying the layout should preserve the codec.
+  layer.setCodec(ohm::VoxelCodec::create(ohm::VoxelCodec::kGZip));
+  ohm::MapLayout layout_copy(map.layout());
+  ASSERT_NE(layout_copy.layer(layout_copy.occupancyLayer()).codec(), nullptr);
+  EXPECT_EQ(layout_copy.layer(layout_copy.occupancyLayer()).codec()->type(), ohm::VoxelCodec::kGZip);
+}
+
+
+TEST(Compression, CodecBenchmark)
+{
+  // Report compression and decompression throughput along with compression ratio for the occupancy, mean, covariance
+  // and TSDF layers. The map data are generated from a room like scan.
+  const double resolution = 0.1;
+  const size_t ray_count = 200000;
+  const std::vector<glm::dvec3> rays = generateRoomRays(ray_count);
+
+  ohm::OccupancyMap ndt_map(resolution, ohm::MapFlag::kVoxelMean);
+  ohm::NdtMap ndt(&ndt_map, true);
+  ohm::RayMapperNdt ndt_mapper(&ndt);
+  ndt_mapper.integrateRays(rays.data(), rays.size(), nullptr, nullptr, ohm::kRfDefault);
+
+  ohm::OccupancyMap tsdf_map(resolution, ohm::MapFlag::kTsdf);
+  ohm::RayMapperTsdf tsdf_mapper(&tsdf_map);
+  tsdf_mapper.integrateRays(rays.data(), rays.size(), nullptr, nullptr, ohm::kRfDefault);
+
+  const std::vector<std::pair<const ohm::OccupancyMap *, const char *>> layers = {
+    { &ndt_map, ohm::default_layer::occupancyLayerName() },
+    { &ndt_map, ohm::default_layer::meanLayerName() },
+    { &ndt_map, ohm::default_layer::covarianceLayerName() },
+    { &tsdf_map, ohm::default_layer::tsdfLayerName() },
+  };
+
+  std::cout << "Regions: " << ndt_map.regionCount() << std::endl;
+  for (const auto &map_layer : layers)
+  {
+    const ohm::OccupancyMap &map = *map_layer.first;
+    const int layer_index = map.layout().layerIndex(map_layer.second);
+    ASSERT_GE(layer_index, 0) << map_layer.second;
+    const std::vector<std::vector<uint8_t>> blocks = collectLayerBlocks(map, layer_index);
+    ASSERT_FALSE(blocks.empty());
+
+    for (ohm::VoxelCodec::Type type : kCodecTypes)
+    {
+      if (!ohm::VoxelCodec::supported(type))
+      {
+        continue;
+      }
+
+      for (ohm::VoxelCodec::Level level : { ohm::VoxelCodec::kLevelFast, ohm::VoxelCodec::kLevelBalanced })
+      {
+        const std::string label = std::string(ohm::VoxelCodec::typeName(type)) +
+                                  ((level == ohm::VoxelCodec::kLevelFast) ? "-fast" : "-balanced");
+        benchmarkCodec(map_layer.second, *ohm::VoxelCodec::create(type, level), label.c_str(), blocks);
+      }
+
+      // Try Zstd with a dictionary trained for the layer.
+      std::vector<uint8_t> dictionary;
+      if (type == ohm::VoxelCodec::kZstd && ohm::VoxelCodec::trainDictionary(dictionary, map, layer_index))
+      {
+        benchmarkCodec(map_layer.second, *ohm::VoxelCodec::create(type, ohm::VoxelCodec::kLevelFast, dictionary),
+                       "zstd-dict", blocks);
+      }
+    }
+  }
+}
@@ -9,8 +9,10 @@
 #include <ohm/CopyUtil.h>
 #include <ohm/Key.h>
 #include <ohm/LineQuery.h>
+#include <ohm/MapChunk.h>
 #include <ohm/OccupancyMap.h>
 #include <ohm/RayMapperOccupancy.h>
+#include <ohm/VoxelBlock.h>
 #include <ohm/VoxelData.h>
 
 #include <ohmtools/OhmCloud.h>
@@ -64,6 +66,117 @@ TEST(Copy, CloneSubmap)
 }
 
 
+TEST(Copy, CloneCopyOnWrite)
+{
+  // Use an uncompressed map so the background compression does not modify the voxel block states.
+  ohm::OccupancyMap map(0.25, ohm::MapFlag::kNone);
+
+  // Generate occupancy and compress the voxel blocks explicitly. Only compressed data are shared.
+  const double box_size = 5.0;
+  ohmgen::boxRoom(map, glm::dvec3(-box_size), glm::dvec3(box_size));
+  std::vector<const ohm::MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  for (const ohm::MapChunk *chunk : chunks)
+  {
+    for (const auto &voxel_block : chunk->voxel_blocks)
+    {
+      voxel_block->compress();
+    }
+  }
+
+  // Access a voxel in another region, leaving its occupancy layer uncompressed.
+  const int occupancy_layer = map.layout().occupancyLayer();
+  const ohm::Key key = map.voxelKey(glm::dvec3(box_size - 0.5 * map.resolution()));
+  const ohm::Key uncompressed_key = map.voxelKey(glm::dvec3(-box_size + 0.5 * map.resolution()));
+  ASSERT_NE(key.regionKey(), uncompressed_key.regionKey());
+  {
+    ohm::Voxel<const float> voxel(&map, occupancy_layer, uncompressed_key);
+    ASSERT_TRUE(voxel.isValid());
+  }
+
+  // Clone serially and in parallel, sharing the voxel data.
+  const std::unique_ptr<ohm::OccupancyMap> map_copy(map.clone(true, 1));
+  const std::unique_ptr<ohm::OccupancyMap> threaded_copy(map.clone(true, 0));
+
+  // Validate the compressed voxel data are shared until retained, while the uncompressed data are copied and remain
+  // owned by the source map.
+  const auto block_flags = [occupancy_layer](const ohm::OccupancyMap &target_map, const ohm::Key &block_key) {
+    const ohm::MapChunk *chunk = target_map.region(block_key.regionKey());
+    return (chunk) ? chunk->voxel_blocks[occupancy_layer]->flags() : 0u;
+  };
+  for (const ohm::OccupancyMap *target_map : { &map, map_copy.get(), threaded_copy.get() })
+  {
+    EXPECT_NE(block_flags(*target_map, key) & ohm::VoxelBlock::kFShared, 0u);
+    EXPECT_EQ(block_flags(*target_map, uncompressed_key) & ohm::VoxelBlock::kFShared, 0u);
+    EXPECT_NE(block_flags(*target_map, uncompressed_key) & ohm::VoxelBlock::kFUncompressed, 0u);
+  }
+
+  // Compare maps.
+  ohmtestutil::compareMaps(*map_copy, map, ohmtestutil::kCfCompareExtended);
+  ohmtestutil::compareMaps(*threaded_copy, map, ohmtestutil::kCfCompareExtended);
+
+  // Modify the source map. The clones must be unaffected.
+  ohm::Voxel<float> occupancy(&map, occupancy_layer, key);
+  ASSERT_TRUE(occupancy.isValid());
+  const float original_value = occupancy.data();
+  occupancy.write(original_value + 1.0f);
+  occupancy.reset();
+  EXPECT_EQ(block_flags(map, key) & ohm::VoxelBlock::kFShared, 0u);
+
+  for (ohm::OccupancyMap *clone_map : { map_copy.get(), threaded_copy.get() })
+  {
+    ohm::Voxel<float> clone_occupancy(clone_map, occupancy_layer, key);
+    ASSERT_TRUE(clone_occupancy.isValid());
+    EXPECT_EQ(clone_occupancy.data(), original_value);
+    // Modify the clone. The source must be unaffected.
+    clone_occupancy.write(original_value + 2.0f);
+  }
+
+  occupancy = ohm::Voxel<float>(&map, occupancy_layer, key);
+  ASSERT_TRUE(occupancy.isValid());
+  EXPECT_EQ(occupancy.data(), original_value + 1.0f);
+
+  // Modify the uncompressed source region. The clones hold their own copies.
+  ohm::Voxel<float> uncompressed_occupancy(&map, occupancy_layer, uncompressed_key);
+  ASSERT_TRUE(uncompressed_occupancy.isValid());
+  const float uncompressed_value = uncompressed_occupancy.data();
+  uncompressed_occupancy.write(uncompressed_value + 1.0f);
+  uncompressed_occupancy.reset();
+  for (ohm::OccupancyMap *clone_map : { map_copy.get(), threaded_copy.get() })
+  {
+    ohm::Voxel<const float> clone_occupancy(clone_map, occupancy_layer, uncompressed_key);
+    ASSERT_TRUE(clone_occupancy.isValid());
+    EXPECT_EQ(clone_occupancy.data(), uncompressed_value);
+  }
+}
+
+
+TEST(Copy, CloneCompressed)
+{
+  // Clone with compressed voxel blocks, which are copied without decompressing.
+  ohm::OccupancyMap map(0.25);
+
+  // Generate occupancy and compress all the voxel blocks.
+  const double box_size = 5.0;
+  ohmgen::boxRoom(map, glm::dvec3(-box_size), glm::dvec3(box_size));
+  std::vector<const ohm::MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  for (const ohm::MapChunk *chunk : chunks)
+  {
+    for (const auto &voxel_block : chunk->voxel_blocks)
+    {
+      voxel_block->compress();
+    }
+  }
+
+  for (bool copy_on_write : { false, true })
+  {
+    const std::unique_ptr<ohm::OccupancyMap> map_copy(map.clone(copy_on_write));
+    ohmtestutil::compareMaps(*map_copy, map, ohmtestutil::kCfCompareExtended);
+  }
+}
+
+
 TEST(Copy, Copy)
 {
   // Test copying utilities.
@@ -91,6 +204,11 @@ TEST(Copy, Copy)
 
   // Compare maps.
   ohmtestutil::compareMaps(dst_map, map, ohmtestutil::kCfCompareExtended);
+
+  // Copy serially and compare.
+  ohm::OccupancyMap serial_map(map.resolution());
+  EXPECT_TRUE(ohm::copyMap(serial_map, map, {}, {}, 1));
+  ohmtestutil::compareMaps(serial_map, map, ohmtestutil::kCfCompareExtended);
 }
 
 
@@ -6,10 +6,23 @@
 #include "OhmTestConfig.h"
 
 #include <ohm/Aabb.h>
+#include <ohm/ChunkOccupancySummary.h>
+#include <ohm/CompareMaps.h>
+#include <ohm/DefaultLayer.h>
+#include <ohm/ForEachRegion.h>
 #include <ohm/Key.h>
+#include <ohm/MapChunk.h>
 #include <ohm/LineQuery.h>
+#include <ohm/MapLayer.h>
+#include <ohm/MapLayout.h>
+#include <ohm/NearestNeighbours.h>
 #include <ohm/OccupancyMap.h>
+#include <ohm/RayFilter.h>
+#include <ohm/RayFlag.h>
 #include <ohm/RayMapperOccupancy.h>
+#include <ohm/QueryFlag.h>
+#include <ohm/VoxelBlock.h>
+#include <ohm/VoxelBuffer.h>
 #include <ohm/VoxelData.h>
 
 #include <ohmtools/OhmCloud.h>
@@ -18,10 +31,18 @@
 #include <ohmutil/OhmUtil.h>
 #include <ohmutil/Profile.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include "ohmtestcommon/OhmTestUtil.h"
@@ -193,4 +214,639 @@ TEST(Map, ClipBox)
 
   EXPECT_TRUE(touched);
 }
+
+
+TEST(Map, IntegrateThreaded)
+{
+  // Validate the batched and multi-threaded RayMapperOccupancy yield exactly the same results as the serial
+  // integration for various ray flags.
+  const double resolution = 0.25;
+  const uint8_t region_size = 16u;
+  const unsigned ray_count = 20000u;
+  const MapFlag map_flags =
+    MapFlag::kVoxelMean | MapFlag::kTraversal | MapFlag::kTouchTime | MapFlag::kIncidentNormal;
+  const unsigned ray_flags_set[] = { kRfDefault,
+                                     kRfExcludeOrigin,
+                                     kRfEndPointAsFree,
+                                     kRfExcludeSample,
+                                     kRfExcludeRay,
+                                     kRfExcludeUnobserved,
+                                     kRfExcludeFree | kRfExcludeOccupied,
+                                     kRfStopOnFirstOccupied };
+
+  std::mt19937 rand_engine(1234u);
+  std::uniform_real_distribution<double> rand(-12.0, 12.0);
+  std::vector<glm::dvec3> rays;
+  std::vector<double> timestamps;
+
+  rays.reserve(ray_count * 2);
+  timestamps.reserve(ray_count);
+  for (unsigned i = 0; i < ray_count; ++i)
+  {
+    // Cluster the ray origins to generate overlapping rays.
+    rays.emplace_back(glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine)) * 0.1);
+    rays.emplace_back(glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine)));
+    timestamps.emplace_back(0.01 * i);
+  }
+
+  // Clip some rays.
+  const Aabb clip_box(glm::dvec3(-10.0), glm::dvec3(10.0));
+  const auto ray_filter = [&clip_box](glm::dvec3 *start, glm::dvec3 *end, unsigned *filter_flags) {
+    return clipBounded(start, end, filter_flags, clip_box);
+  };
+
+  for (unsigned ray_flags : ray_flags_set)
+  {
+    OccupancyMap reference_map(resolution, glm::u8vec3(region_size), map_flags);
+    OccupancyMap batched_map(resolution, glm::u8vec3(region_size), map_flags);
+    OccupancyMap map(resolution, glm::u8vec3(region_size), map_flags);
+    reference_map.setRayFilter(ray_filter);
+    batched_map.setRayFilter(ray_filter);
+    map.setRayFilter(ray_filter);
+
+    RayMapperOccupancy reference_mapper(&reference_map);
+    RayMapperOccupancy batched_mapper(&batched_map);
+    RayMapperOccupancy mapper(&map);
+    reference_mapper.setBatched(false);
+    const bool threads_available = mapper.setThreadCount(0);
+
+    // Integrate twice so the second pass operates on existing voxel values.
+    for (int pass = 0; pass < 2; ++pass)
+    {
+      reference_mapper.integrateRays(rays.data(), rays.size(), nullptr, timestamps.data(), ray_flags);
+      batched_mapper.integrateRays(rays.data(), rays.size(), nullptr, timestamps.data(), ray_flags);
+      if (threads_available)
+      {
+        mapper.integrateRays(rays.data(), rays.size(), nullptr, timestamps.data(), ray_flags);
+      }
+    }
+
+    ohmtestutil::compareMaps(batched_map, reference_map,
+                             ohmtestutil::kCfCompareFineDetail | ohmtestutil::kCfLayerBytes);
+    if (threads_available)
+    {
+      ohmtestutil::compareMaps(map, reference_map, ohmtestutil::kCfCompareFineDetail | ohmtestutil::kCfLayerBytes);
+    }
+  }
+}
+
+
+TEST(Map, ConcurrentRegions)
+{
+  // Create and look up regions from multiple threads. Each thread creates an overlapping set of regions, so threads
+  // race to create the same regions. All threads must resolve the same chunk for each region.
+  OccupancyMap map(0.25);
+  const int extents = 12;
+  const unsigned thread_count = 4;
+  std::vector<std::vector<MapChunk *>> thread_chunks(thread_count);
+  std::vector<std::thread> threads;
+
+  const auto region_index = [extents](int x, int y, int z) {
+    return size_t(x + extents) + size_t(2 * extents) * (size_t(y + extents) + size_t(2 * extents) * size_t(z));
+  };
+
+  for (unsigned t = 0; t < thread_count; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      std::vector<MapChunk *> &chunks = thread_chunks[t];
+      chunks.resize(size_t(2 * extents) * size_t(2 * extents) * size_t(2));
+      // Vary the iteration order between threads.
+      const int step = (t % 2) ? -1 : 1;
+      for (int z = 0; z < 2; ++z)
+      {
+        for (int y = -extents; y < extents; ++y)
+        {
+          for (int i = 0; i < 2 * extents; ++i)
+          {
+            const int x = (step > 0) ? -extents + i : extents - 1 - i;
+            const glm::i16vec3 region_key(x, y, z);
+            // Lookup, then create.
+            MapChunk *existing = map.region(region_key, false);
+            MapChunk *chunk = map.region(region_key, true);
+            ASSERT_NE(chunk, nullptr);
+            EXPECT_TRUE(!existing || existing == chunk);
+            EXPECT_EQ(chunk->region.coord, region_key);
+            chunks[region_index(x, y, z)] = chunk;
+          }
+        }
+      }
+    });
+  }
+
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  const size_t expected_count = size_t(2 * extents) * size_t(2 * extents) * size_t(2);
+  EXPECT_EQ(map.regionCount(), expected_count);
+  for (unsigned t = 1; t < thread_count; ++t)
+  {
+    EXPECT_EQ(thread_chunks[t], thread_chunks[0]);
+  }
+
+  // Validate iteration visits each region once.
+  std::vector<const MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  ASSERT_EQ(chunks.size(), expected_count);
+  std::sort(chunks.begin(), chunks.end());
+  EXPECT_EQ(std::unique(chunks.begin(), chunks.end()), chunks.end());
+
+  // Cull half the regions while other threads continue to look up regions.
+  std::atomic_bool culling{ true };
+  std::thread lookup_thread([&]() {
+    while (culling)
+    {
+      for (int x = -extents; x < extents; ++x)
+      {
+        const MapChunk *chunk = static_cast<const OccupancyMap &>(map).region(glm::i16vec3(x, 0, 1));
+        ASSERT_NE(chunk, nullptr);
+      }
+    }
+  });
+  // Keep only the z = 1 regions.
+  const double keep_z = map.region(glm::i16vec3(0, 0, 1), false)->region.centre.z;
+  const double big = 1e6;
+  const unsigned removed =
+    map.cullRegionsOutside(glm::dvec3(-big, -big, keep_z - 0.1), glm::dvec3(big, big, keep_z + 0.1));
+  culling = false;
+  lookup_thread.join();
+
+  EXPECT_EQ(removed, expected_count / 2);
+  EXPECT_EQ(map.regionCount(), expected_count / 2);
+  EXPECT_EQ(map.region(glm::i16vec3(0, 0, 0), false), nullptr);
+  EXPECT_NE(map.region(glm::i16vec3(0, 0, 1), false), nullptr);
+}
+
+
+TEST(Map, ChunkPool)
+{
+  // Validate recycled regions are indistinguishable from new regions.
+  const double resolution = 0.25;
+  const glm::u8vec3 region_size(16);
+  const MapFlag map_flags = MapFlag::kVoxelMean | MapFlag::kTraversal;
+  OccupancyMap reference_map(resolution, region_size, map_flags);
+  OccupancyMap map(resolution, region_size, map_flags);
+  map.setChunkPoolSize(1000);
+  EXPECT_EQ(map.chunkPoolSize(), 1000u);
+
+  // Populate, then cull all regions, releasing them to the pool.
+  ohmgen::boxRoom(map, glm::dvec3(-5.0), glm::dvec3(5.0));
+  const size_t initial_region_count = map.regionCount();
+  ASSERT_GT(initial_region_count, 0u);
+  map.cullRegionsOutside(glm::dvec3(1000.0), glm::dvec3(1001.0));
+  ASSERT_EQ(map.regionCount(), 0u);
+
+  // Repopulate with different content. All regions come from the pool.
+  ohmgen::boxRoom(reference_map, glm::dvec3(-3.0, -4.0, -2.0), glm::dvec3(2.0, 3.0, 4.0));
+  ohmgen::boxRoom(map, glm::dvec3(-3.0, -4.0, -2.0), glm::dvec3(2.0, 3.0, 4.0));
+  ASSERT_LE(map.regionCount(), initial_region_count);
+  ohmtestutil::compareMaps(map, reference_map, ohmtestutil::kCfCompareExtended | ohmtestutil::kCfLayerBytes);
+
+  // Pooled regions must not be recycled after a layout change.
+  map.clear();
+  reference_map.clear();
+  map.addTouchTimeLayer();
+  reference_map.addTouchTimeLayer();
+  ohmgen::boxRoom(reference_map, glm::dvec3(-2.0), glm::dvec3(2.0));
+  ohmgen::boxRoom(map, glm::dvec3(-2.0), glm::dvec3(2.0));
+  ohmtestutil::compareMaps(map, reference_map, ohmtestutil::kCfCompareExtended | ohmtestutil::kCfLayerBytes);
+
+  map.setChunkPoolSize(0);
+  EXPECT_EQ(map.chunkPoolSize(), 0u);
+}
+
+TEST(Map, OccupancySummary)
+{
+  // Validate the chunk occupancy summaries against the voxel data as the map changes, then validate a nearest
+  // neighbours query using the summaries against a brute force search. Use a region size which does not fill the last
+  // bitmask word and is not a multiple of the summary cell size.
+  const std::unique_ptr<OccupancyMap> map_ptr = ohmtestutil::createBoxRoomMap(glm::u8vec3(10, 12, 14));
+  OccupancyMap &map = *map_ptr;
+
+  const auto validate_summaries = [&map]() {
+    std::vector<const MapChunk *> chunks;
+    map.enumerateRegions(chunks);
+    ASSERT_FALSE(chunks.empty());
+    const glm::ivec3 dim = map.regionVoxelDimensions();
+    for (const MapChunk *chunk : chunks)
+    {
+      const ChunkOccupancySummary *summary = chunk->occupancySummary();
+      ASSERT_NE(summary, nullptr);
+      ASSERT_EQ(summary->voxelCount(), unsigned(dim.x * dim.y * dim.z));
+
+      Voxel<const float> voxel(&map, map.layout().occupancyLayer());
+      ChunkOccupancySummary::Cell totals;
+      for (unsigned i = 0; i < summary->voxelCount(); ++i)
+      {
+        voxel.setKey(chunk->keyForIndex(i, dim));
+        ASSERT_TRUE(voxel.isValid());
+        const bool occupied = isOccupied(voxel);
+        const bool unobserved = isUnobserved(voxel);
+        EXPECT_EQ(summary->isOccupied(i), occupied);
+        EXPECT_EQ(summary->isUnobserved(i), unobserved);
+        totals.occupied += occupied;
+        totals.unobserved += unobserved;
+      }
+      EXPECT_EQ(summary->totals().occupied, totals.occupied);
+      EXPECT_EQ(summary->totals().unobserved, totals.unobserved);
+
+      // Each pyramid level must account for all the voxels, ending in a single cell.
+      for (unsigned level = 0; level < summary->levelCount(); ++level)
+      {
+        const glm::ivec3 cell_dim = summary->cellDimensions(level);
+        ChunkOccupancySummary::Cell level_totals;
+        glm::ivec3 coord;
+        for (coord.z = 0; coord.z < cell_dim.z; ++coord.z)
+        {
+          for (coord.y = 0; coord.y < cell_dim.y; ++coord.y)
+          {
+            for (coord.x = 0; coord.x < cell_dim.x; ++coord.x)
+            {
+              level_totals.occupied += summary->cell(level, coord).occupied;
+              level_totals.unobserved += summary->cell(level, coord).unobserved;
+            }
+          }
+        }
+        EXPECT_EQ(level_totals.occupied, totals.occupied);
+        EXPECT_EQ(level_totals.unobserved, totals.unobserved);
+      }
+      ASSERT_GT(summary->levelCount(), 0u);
+      EXPECT_EQ(summary->cellDimensions(summary->levelCount() - 1), glm::ivec3(1));
+    }
+  };
+
+  validate_summaries();
+
+  // Modify the map and ensure the summaries are refreshed.
+  {
+    Voxel<float> voxel(&map, map.layout().occupancyLayer());
+    for (int i = 0; i < 10; ++i)
+    {
+      voxel.setKey(map.voxelKey(glm::dvec3(-1.0 + 0.25 * i, 0.5, 0.0)));
+      integrateHit(voxel);
+    }
+    voxel.setKey(map.voxelKey(glm::dvec3(-2.0)));
+    for (int i = 0; i < 10; ++i)
+    {
+      integrateMiss(voxel);
+    }
+  }
+  validate_summaries();
+
+  map.setOccupancyThresholdProbability(0.9f);
+  validate_summaries();
+  map.setOccupancyThresholdProbability(0.5f);
+
+  // Write occupancy directly through a VoxelBuffer, bypassing the touched stamps. Releasing the buffer must invalidate
+  // the summary.
+  {
+    MapChunk *chunk = map.region(map.voxelKey(glm::dvec3(0.0)).regionKey());
+    ASSERT_NE(chunk, nullptr);
+    const uint64_t stamp = chunk->touched_stamps[map.layout().occupancyLayer()];
+    const ChunkOccupancySummary *summary = chunk->occupancySummary();
+    const unsigned occupied_count = summary->totals().occupied;
+    VoxelBuffer<VoxelBlock> buffer(chunk->voxel_blocks[map.layout().occupancyLayer()]);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    float *occupancy = reinterpret_cast<float *>(buffer.voxelMemory());
+    const float hit_value = map.hitValue();
+    unsigned written_count = 0;
+    for (unsigned i = 0; i < unsigned(map.regionVoxelVolume()); ++i)
+    {
+      if (!summary->isOccupied(i))
+      {
+        occupancy[i] = hit_value;
+        ++written_count;
+      }
+    }
+    buffer.release();
+    ASSERT_GT(written_count, 0u);
+    ASSERT_EQ(chunk->touched_stamps[map.layout().occupancyLayer()], stamp);
+    EXPECT_EQ(chunk->occupancySummary(), summary);
+    EXPECT_EQ(summary->totals().occupied, occupied_count + written_count);
+  }
+  validate_summaries();
+
+  // Compare nearest neighbours against a brute force search.
+  const glm::dvec3 near_point(-1.2, 0.3, 0.1);
+  const float search_radius = 1.6f;
+  for (unsigned query_flags : { 0u, unsigned(kQfUnknownAsOccupied) })
+  {
+    NearestNeighbours query(map, near_point, search_radius, query_flags);
+    ASSERT_TRUE(query.execute());
+
+    std::vector<Key> expected;
+    const glm::ivec3 half_extents(int(std::ceil(search_radius / map.resolution())) + 1);
+    const Key centre_key = map.voxelKey(near_point);
+    Voxel<const float> voxel(&map, map.layout().occupancyLayer());
+    for (int z = -half_extents.z; z <= half_extents.z; ++z)
+    {
+      for (int y = -half_extents.y; y <= half_extents.y; ++y)
+      {
+        for (int x = -half_extents.x; x <= half_extents.x; ++x)
+        {
+          Key key = centre_key;
+          map.moveKey(key, x, y, z);
+          voxel.setKey(key);
+          const bool obstacle =
+            isOccupied(voxel) || (query_flags & kQfUnknownAsOccupied) && isUnobservedOrNull(voxel);
+          if (obstacle && glm::length(map.voxelCentreGlobal(key) - near_point) <= search_radius)
+          {
+            expected.emplace_back(key);
+          }
+        }
+      }
+    }
+
+    ASSERT_FALSE(expected.empty());
+    std::vector<Key> results(query.intersectedVoxels(), query.intersectedVoxels() + query.numberOfResults());
+    ASSERT_EQ(results.size(), expected.size()) << "flags " << query_flags;
+    for (const Key &key : expected)
+    {
+      EXPECT_NE(std::find(results.begin(), results.end(), key), results.end());
+    }
+  }
+}
+
+
+TEST(Map, ForEachRegion)
+{
+  // Validate the region visit functions against per voxel key lookup.
+  const std::unique_ptr<OccupancyMap> map_ptr = ohmtestutil::createBoxRoomMap();
+  OccupancyMap &map = *map_ptr;
+  const int occupancy_layer = map.layout().occupancyLayer();
+
+  // Serial visitation must match enumerateRegions() order and visit every voxel of each region.
+  std::vector<Key> iter_keys;
+  std::vector<float> iter_values;
+  std::vector<const MapChunk *> chunks;
+  map.enumerateRegions(chunks);
+  Voxel<const float> voxel(&map, occupancy_layer);
+  for (const MapChunk *chunk : chunks)
+  {
+    for (unsigned i = 0; i < unsigned(map.regionVoxelVolume()); ++i)
+    {
+      const Key key = chunk->keyForIndex(i, map.regionVoxelDimensions());
+      voxel.setKey(key);
+      iter_keys.emplace_back(key);
+      iter_values.emplace_back(voxel.data());
+    }
+  }
+  voxel.reset();
+
+  size_t visit_index = 0;
+  std::vector<size_t> region_indices;
+  forEachRegion(
+    map, { occupancy_layer, -1 },
+    [&](const RegionVoxels &region) {
+      ASSERT_EQ(region.layerCount(), 2u);
+      ASSERT_NE(region.voxels<float>(0), nullptr);
+      EXPECT_EQ(region.voxels<float>(1), nullptr);
+      region_indices.emplace_back(region.regionIndex());
+      for (unsigned i = region.begin(); i < region.end(); ++i, ++visit_index)
+      {
+        ASSERT_LT(visit_index, iter_keys.size());
+        ASSERT_EQ(region.key(i), iter_keys[visit_index]);
+        ASSERT_EQ(region.voxels<float>(0)[i], iter_values[visit_index]);
+      }
+    },
+    1);
+  EXPECT_EQ(visit_index, iter_keys.size());
+  ASSERT_EQ(region_indices.size(), map.regionCount());
+  for (size_t i = 0; i < region_indices.size(); ++i)
+  {
+    EXPECT_EQ(region_indices[i], i);
+  }
+
+  // Count the occupied voxels using the parallel functions.
+  const size_t expected_occupied =
+    size_t(std::count_if(iter_values.begin(), iter_values.end(), [&map](float value) {  //
+      return isOccupied(value, map);
+    }));
+  ASSERT_GT(expected_occupied, 0u);
+
+  std::atomic<size_t> occupied{ 0 };
+  std::atomic<size_t> visited{ 0 };
+  parallelForEachVoxel(map, { occupancy_layer }, [&](const RegionVoxels &region, unsigned voxel_index) {
+    occupied += isOccupied(region.voxels<float>(0)[voxel_index], map);
+    ++visited;
+  });
+  EXPECT_EQ(occupied, expected_occupied);
+  EXPECT_EQ(visited, iter_keys.size());
+
+  // Use an odd grain size which does not divide the region.
+  visited = 0;
+  forEachVoxelRange(
+    map, {},
+    [&](const RegionVoxels &region) {
+      EXPECT_LE(region.end() - region.begin(), 100u);
+      visited += region.end() - region.begin();
+    },
+    0, 100);
+  EXPECT_EQ(visited, iter_keys.size());
+
+  for (unsigned thread_count : { 1u, 0u })
+  {
+    const size_t reduced_occupied = reduceRegions(
+      map, { occupancy_layer }, size_t(0u),
+      [&map](const RegionVoxels &region, size_t &count) {
+        for (unsigned i = region.begin(); i < region.end(); ++i)
+        {
+          count += isOccupied(region.voxels<float>(0)[i], map);
+        }
+      },
+      [](size_t a, size_t b) { return a + b; }, thread_count);
+    EXPECT_EQ(reduced_occupied, expected_occupied);
+
+    // Reduce bool results, which must not share storage between regions.
+    const bool any_occupied = reduceRegions(
+      map, { occupancy_layer }, false,
+      [&map](const RegionVoxels &region, bool &region_occupied) {
+        for (unsigned i = region.begin(); i < region.end() && !region_occupied; ++i)
+        {
+          region_occupied = isOccupied(region.voxels<float>(0)[i], map);
+        }
+      },
+      [](bool a, bool b) { return a || b; }, thread_count);
+    EXPECT_TRUE(any_occupied);
+  }
+}
+
+
+TEST(Map, CompareVoxels)
+{
+  // Validate the parallel voxel comparison against the map iterator and between thread counts. The eval map has a
+  // different layout, placing the compared layer at a different index.
+  const std::unique_ptr<OccupancyMap> ref_map_ptr = ohmtestutil::createBoxRoomMap();
+  OccupancyMap &ref_map = *ref_map_ptr;
+  MapLayout eval_layout;
+  addTouchTime(eval_layout);
+  addOccupancy(eval_layout);
+  const std::unique_ptr<OccupancyMap> eval_map =
+    ohmtestutil::createBoxRoomMap(glm::u8vec3(ref_map.regionVoxelDimensions()), &eval_layout);
+  ASSERT_NE(eval_map->layout().occupancyLayer(), ref_map.layout().occupancyLayer());
+  // Add a region with no valid voxels. The iterator visits only the tail of such a region.
+  ASSERT_NE(ref_map.region(glm::i16vec3(20, 20, 20), true), nullptr);
+  ASSERT_NE(eval_map->region(glm::i16vec3(20, 20, 20), true), nullptr);
+  const std::string layer_name = default_layer::occupancyLayerName();
+
+  // Voxels before the first valid voxel in each region are not compared, matching the iterator.
+  size_t expected_count = 0;
+  Key modified_key(nullptr);
+  Voxel<const float> voxel(&ref_map, ref_map.layout().occupancyLayer());
+  for (auto iter = ref_map.begin(); iter != ref_map.end(); ++iter)
+  {
+    voxel.setKey(*iter);
+    if (isOccupied(voxel) && iter->localKey() != glm::u8vec3(0))
+    {
+      modified_key = *iter;
+    }
+    ++expected_count;
+  }
+  voxel.reset();
+  ASSERT_FALSE(modified_key.isNull());
+
+  std::vector<std::string> messages;
+  const auto log = [&messages](compare::Severity /*severity*/, const std::string &msg) {
+    messages.emplace_back(msg);
+  };
+
+  for (unsigned thread_count : { 1u, 0u })
+  {
+    const compare::VoxelsResult result =
+      compare::compareVoxels(*eval_map, ref_map, layer_name, nullptr, 0, log, thread_count);
+    EXPECT_TRUE(result);
+    EXPECT_EQ(result.voxels_passed, expected_count);
+    EXPECT_EQ(result.voxels_failed, 0u);
+  }
+  EXPECT_TRUE(messages.empty());
+
+  // Modify a single voxel.
+  {
+    Voxel<float> eval_voxel(eval_map.get(), eval_map->layout().occupancyLayer(), modified_key);
+    ASSERT_TRUE(eval_voxel.isValid());
+    eval_voxel.write(eval_voxel.data() + 0.1f);
+  }
+
+  std::vector<std::string> serial_messages;
+  for (unsigned thread_count : { 1u, 0u })
+  {
+    messages.clear();
+    const compare::VoxelsResult result =
+      compare::compareVoxels(*eval_map, ref_map, layer_name, nullptr, compare::kContinue, log, thread_count);
+    EXPECT_FALSE(result);
+    EXPECT_EQ(result.voxels_passed, expected_count - 1);
+    EXPECT_EQ(result.voxels_failed, 1u);
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_NE(messages.front().find("value mismatch"), std::string::npos);
+
+    if (thread_count == 1)
+    {
+      serial_messages = messages;
+    }
+    else
+    {
+      EXPECT_EQ(messages, serial_messages);
+    }
+  }
+
+  // Early termination must be consistent.
+  const compare::VoxelsResult serial_result =
+    compare::compareVoxels(*eval_map, ref_map, layer_name, nullptr, 0, compare::emptyLog, 1);
+  const compare::VoxelsResult parallel_result =
+    compare::compareVoxels(*eval_map, ref_map, layer_name, nullptr, 0, compare::emptyLog, 0);
+  EXPECT_EQ(serial_result.voxels_failed, 1u);
+  EXPECT_EQ(parallel_result.voxels_failed, 1u);
+  EXPECT_EQ(serial_result.voxels_passed, parallel_result.voxels_passed);
+
+  // The modification is within tolerance.
+  MapLayer tolerance(layer_name.c_str());
+  compare::configureTolerance(tolerance, layer_name.c_str(), 0.2f);
+  messages.clear();
+  const compare::VoxelsResult tolerance_result =
+    compare::compareVoxels(*eval_map, ref_map, layer_name, &tolerance, compare::kContinue, log);
+  EXPECT_TRUE(tolerance_result);
+  EXPECT_EQ(tolerance_result.voxels_passed, expected_count);
+  EXPECT_TRUE(messages.empty());
+
+  // Fail every voxel in the modified region. Every failure is reported, in the same order for any thread count.
+  {
+    Voxel<float> eval_voxel(eval_map.get(), eval_map->layout().occupancyLayer());
+    const glm::u8vec3 dims = eval_map->regionVoxelDimensions();
+    Key key = modified_key;
+    for (uint8_t z = 0; z < dims.z; ++z)
+    {
+      for (uint8_t y = 0; y < dims.y; ++y)
+      {
+        for (uint8_t x = 0; x < dims.x; ++x)
+        {
+          key.setLocalKey(glm::u8vec3(x, y, z));
+          eval_voxel.setKey(key);
+          ASSERT_TRUE(eval_voxel.isValid());
+          eval_voxel.write(123.0f);
+        }
+      }
+    }
+  }
+
+  for (unsigned thread_count : { 1u, 0u })
+  {
+    messages.clear();
+    const compare::VoxelsResult result =
+      compare::compareVoxels(*eval_map, ref_map, layer_name, nullptr, compare::kContinue, log, thread_count);
+    EXPECT_GT(result.voxels_failed, 1u);
+    EXPECT_EQ(result.voxels_passed + result.voxels_failed, expected_count);
+    EXPECT_EQ(messages.size(), result.voxels_failed);
+
+    if (thread_count == 1)
+    {
+      serial_messages = messages;
+    }
+    else
+    {
+      EXPECT_EQ(messages, serial_messages);
+    }
+  }
+}
+
+
+TEST(Map, SaveCloudThreads)
+{
+  // The streamed point cloud must be the same for any thread count.
+  const std::unique_ptr<OccupancyMap> map_ptr = ohmtestutil::createBoxRoomMap();
+  OccupancyMap &map = *map_ptr;
+
+  size_t occupied_count = 0;
+  Voxel<const float> voxel(&map, map.layout().occupancyLayer());
+  for (auto iter = map.begin(); iter != map.end(); ++iter)
+  {
+    voxel.setKey(*iter);
+    occupied_count += isOccupied(voxel);
+  }
+  voxel.reset();
+
+  std::vector<std::string> contents;
+  for (unsigned thread_count : { 1u, 0u })
+  {
+    const std::string file_name = "map-save-cloud-threads-" + std::to_string(thread_count) + ".ply";
+    ohmtools::SaveCloudOptions opt;
+    opt.thread_count = thread_count;
+    size_t last_progress = 0;
+    const uint64_t point_count =
+      ohmtools::saveCloud(file_name, map, opt, [&last_progress](size_t progress, size_t target) {
+        EXPECT_EQ(progress, last_progress + 1);
+        EXPECT_LE(progress, target);
+        last_progress = progress;
+      });
+    EXPECT_EQ(point_count, occupied_count);
+    EXPECT_EQ(last_progress, map.regionCount());
+
+    std::ifstream in(file_name, std::ios::binary);
+    ASSERT_TRUE(in.is_open());
+    contents.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  EXPECT_FALSE(contents[0].empty());
+  EXPECT_EQ(contents[0], contents[1]);
+}
 }  // namespace maptests
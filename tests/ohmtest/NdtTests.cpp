@@ -8,6 +8,7 @@
 #include <ohm/Key.h>
 #include <ohm/NdtMap.h>
 #include <ohm/OccupancyMap.h>
+#include <ohm/RayMapperNdt.h>
 #include <ohm/Trace.h>
 #include <ohm/VoxelData.h>
 
@@ -15,7 +16,10 @@
 #include "ohmtestcommon/CovarianceTestUtil.h"
 #include "ohmtestcommon/OhmTestUtil.h"
 
+#include <ohmutil/OhmUtil.h>
+
 #include <chrono>
+#include <iostream>
 #include <random>
 #include <unordered_map>
 
@@ -467,4 +471,103 @@ TEST(Ndt, MissSpherical)
   testNdtMiss(sensor, samples, voxel_resolution, sensor_noise, glm::dvec3(-0.5 * voxel_resolution), rays,
               expected_prob_and_tolerance);
 }
+
+
+/// Generate a ray set for the threaded NDT benchmark. The samples are generated on the planar, cylindrical and spherical
+/// surfaces used in the miss tests, but scaled up to cover many map regions. The sensor moves through the scene.
+void generateNdtBenchmarkRays(std::vector<glm::dvec3> &rays, std::vector<float> &intensities,
+                              std::vector<double> &timestamps, size_t ray_count_per_surface)
+{
+  uint32_t seed = 1153297050u;
+  std::default_random_engine rng(seed);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::uniform_real_distribution<double> noise(-0.05, 0.05);
+  std::uniform_real_distribution<float> uniform_intensity(0.0f, 100.0f);
+  const double extents = 10.0;
+  const double cylinder_radius = 4.0;
+  const double sphere_radius = 6.0;
+
+  rays.clear();
+  intensities.clear();
+  timestamps.clear();
+
+  const auto add_ray = [&](const glm::dvec3 &sample) {
+    const double time = 0.001 * double(timestamps.size());
+    // Move the sensor in a circle around the origin.
+    const glm::dvec3 sensor(2.0 * std::cos(time), 2.0 * std::sin(time), 1.5);
+    rays.emplace_back(sensor);
+    rays.emplace_back(sample);
+    intensities.emplace_back(uniform_intensity(rng));
+    timestamps.emplace_back(time);
+  };
+
+  // Planar
+  for (size_t i = 0; i < ray_count_per_surface; ++i)
+  {
+    add_ray(glm::dvec3(extents * uniform(rng), extents * uniform(rng), noise(rng)));
+  }
+
+  // Cylindrical
+  for (size_t i = 0; i < ray_count_per_surface; ++i)
+  {
+    const double angle = M_PI * uniform(rng);
+    const double radius = cylinder_radius + noise(rng);
+    add_ray(glm::dvec3(radius * std::cos(angle), radius * std::sin(angle), 1.5 + 1.5 * uniform(rng)));
+  }
+
+  // Spherical
+  for (size_t i = 0; i < ray_count_per_surface; ++i)
+  {
+    glm::dvec3 sample(0);
+    while (glm::length2(sample) < 1e-6)
+    {
+      sample = glm::dvec3(uniform(rng), uniform(rng), uniform(rng));
+    }
+    add_ray(glm::normalize(sample) * (sphere_radius + noise(rng)));
+  }
+}
+
+
+TEST(Ndt, Threaded)
+{
+  // Benchmark the multi-threaded RayMapperNdt against the single threaded integration. We also validate the threaded
+  // results exactly match.
+  using Clock = std::chrono::high_resolution_clock;
+  const double resolution = 0.1;
+  const size_t ray_count_per_surface = 10000u;
+  const MapFlag map_flags = MapFlag::kVoxelMean | MapFlag::kTraversal | MapFlag::kTouchTime | MapFlag::kIncidentNormal;
+  std::vector<glm::dvec3> rays;
+  std::vector<float> intensities;
+  std::vector<double> timestamps;
+
+  generateNdtBenchmarkRays(rays, intensities, timestamps, ray_count_per_surface);
+
+  for (NdtMode mode : { NdtMode::kOccupancy, NdtMode::kTraversability })
+  {
+    OccupancyMap reference_map(resolution, map_flags);
+    NdtMap reference_ndt(&reference_map, true, mode);
+    RayMapperNdt reference_mapper(&reference_ndt);
+    reference_mapper.setBatched(false);
+    OccupancyMap map(resolution, map_flags);
+    NdtMap ndt(&map, true, mode);
+    RayMapperNdt mapper(&ndt);
+
+    if (!mapper.setThreadCount(0))
+    {
+      GTEST_SKIP() << "Multi-threading not available";
+    }
+
+    const auto serial_start = Clock::now();
+    reference_mapper.integrateRays(rays.data(), rays.size(), intensities.data(), timestamps.data(), kRfDefault);
+    const auto serial_end = Clock::now();
+    mapper.integrateRays(rays.data(), rays.size(), intensities.data(), timestamps.data(), kRfDefault);
+    const auto threaded_end = Clock::now();
+
+    std::cout << ndtModeToString(mode) << " " << rays.size() / 2 << " rays\n";
+    std::cout << "  serial: " << (serial_end - serial_start) << std::endl;
+    std::cout << "  threaded: " << (threaded_end - serial_end) << std::endl;
+
+    compareMaps(map, reference_map, kCfCompareFineDetail | kCfLayerBytes);
+  }
+}
 }  // namespace ndttests
@@ -11,10 +11,13 @@
 #include <ohm/CalculateSegmentKeys.h>
 #include <ohm/Key.h>
 #include <ohm/KeyList.h>
+#include <ohm/KeyRange.h>
 #include <ohm/LineQuery.h>
+#include <ohm/MapJournal.h>
 #include <ohm/MapSerialise.h>
 #include <ohm/OccupancyMap.h>
 #include <ohm/OccupancyUtil.h>
+#include <ohm/Voxel.h>
 #include <ohm/VoxelOccupancy.h>
 
 #include <ohmtools/OhmCloud.h>
@@ -23,11 +26,17 @@
 #include <ohmutil/OhmUtil.h>
 #include <ohmutil/Profile.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <random>
+#include <string>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -104,6 +113,344 @@ TEST(Serialisation, Basic)
 }
 
 
+TEST(Serialisation, LoadRegions)
+{
+  const char *map_name = "test-map-regions.ohm";
+  const double boundary_distance = 5.0;
+  OccupancyMap save_map(0.25, glm::u8vec3(16));
+
+  ohmgen::boxRoom(save_map, glm::dvec3(-boundary_distance), glm::dvec3(boundary_distance));
+  ASSERT_EQ(save(map_name, save_map), 0);
+
+  // Load an axis aligned box and compare against a fully loaded map culled to the same box.
+  const glm::dvec3 min_ext(-boundary_distance, -1.0, -1.0);
+  const glm::dvec3 max_ext(0.0, 1.0, 1.0);
+  OccupancyMap culled_map(1);
+  ASSERT_EQ(load(map_name, culled_map), 0);
+  ASSERT_EQ(culled_map.regionCount(), save_map.regionCount());
+  culled_map.cullRegionsOutside(min_ext, max_ext);
+  ASSERT_GT(culled_map.regionCount(), 0u);
+  ASSERT_LT(culled_map.regionCount(), save_map.regionCount());
+
+  OccupancyMap extents_map(1);
+  ASSERT_EQ(loadExtents(map_name, extents_map, min_ext, max_ext), 0);
+  EXPECT_EQ(extents_map.regionCount(), culled_map.regionCount());
+  ohmtestutil::compareMaps(extents_map, culled_map, ohmtestutil::kCfCompareExtended);
+
+  // Load an explicit region list, including a region which is not in the map.
+  std::vector<glm::i16vec3> regions;
+  for (auto iter = culled_map.begin(); iter != culled_map.end(); ++iter)
+  {
+    if (regions.empty() || regions.back() != iter->regionKey())
+    {
+      regions.emplace_back(iter->regionKey());
+    }
+  }
+  std::sort(regions.begin(), regions.end(), [](const glm::i16vec3 &a, const glm::i16vec3 &b) {
+    return a.x < b.x || a.x == b.x && (a.y < b.y || a.y == b.y && a.z < b.z);
+  });
+  regions.erase(std::unique(regions.begin(), regions.end()), regions.end());
+  ASSERT_EQ(regions.size(), culled_map.regionCount());
+  regions.emplace_back(glm::i16vec3(1000));
+
+  OccupancyMap regions_map(1);
+  ASSERT_EQ(loadRegions(map_name, regions_map, regions), 0);
+  EXPECT_EQ(regions_map.regionCount(), culled_map.regionCount());
+  ohmtestutil::compareMaps(regions_map, culled_map, ohmtestutil::kCfCompareExtended);
+
+  // Load a single region.
+  OccupancyMap region_map(1);
+  ASSERT_EQ(loadRegion(map_name, region_map, regions.front()), 0);
+  EXPECT_EQ(region_map.regionCount(), 1u);
+  EXPECT_NE(region_map.region(regions.front()), nullptr);
+}
+
+
+TEST(Serialisation, Paged)
+{
+  const char *map_name = "test-map-paged.ohm";
+  const double boundary_distance = 5.0;
+  const size_t resident_budget = 4;
+  OccupancyMap save_map(0.25, glm::u8vec3(16));
+
+  ohmgen::boxRoom(save_map, glm::dvec3(-boundary_distance), glm::dvec3(boundary_distance));
+  ASSERT_EQ(save(map_name, save_map), 0);
+  ASSERT_GT(save_map.regionCount(), resident_budget);
+
+  OccupancyMap paged_map(1);
+  ASSERT_EQ(loadPaged(map_name, paged_map, resident_budget), 0);
+  // Nothing is loaded until accessed.
+  EXPECT_EQ(paged_map.regionCount(), 0u);
+  // Region enumeration and extents include the regions which are not resident.
+  EXPECT_EQ(paged_map.pagedRegionCount(), save_map.regionCount());
+  {
+    KeyRange expected_range;
+    KeyRange paged_range;
+    save_map.calculateExtents(nullptr, nullptr, &expected_range);
+    EXPECT_TRUE(paged_map.calculateExtents(nullptr, nullptr, &paged_range));
+    EXPECT_EQ(paged_range.minKey(), expected_range.minKey());
+    EXPECT_EQ(paged_range.maxKey(), expected_range.maxKey());
+  }
+
+  // Modify a voxel in the first region. This region must remain resident.
+  const Key modified_key = save_map.begin().key();
+  float modified_value = 0;
+  {
+    Voxel<float> occupancy(&paged_map, paged_map.layout().occupancyLayer(), modified_key);
+    ASSERT_TRUE(occupancy.isValid());
+    modified_value = occupancy.data() + 1.0f;
+    occupancy.write(modified_value);
+  }
+
+  // Read every voxel via the paged map and compare.
+  {
+    Voxel<const float> expected(&save_map, save_map.layout().occupancyLayer());
+    Voxel<const float> paged(&paged_map, paged_map.layout().occupancyLayer());
+    ASSERT_TRUE(paged.isLayerValid());
+    for (auto iter = save_map.begin(); iter != save_map.end(); ++iter)
+    {
+      if (*iter == modified_key)
+      {
+        continue;
+      }
+      expected.setKey(*iter);
+      paged.setKey(*iter);
+      ASSERT_TRUE(paged.isValid());
+      ASSERT_EQ(paged.data(), expected.data());
+    }
+  }
+
+  // Clean regions have been evicted to meet the budget, which includes the modified region. The modified region
+  // remains.
+  EXPECT_LE(paged_map.regionCount(), resident_budget);
+  {
+    Voxel<const float> modified(&paged_map, paged_map.layout().occupancyLayer(), modified_key);
+    ASSERT_TRUE(modified.isValid());
+    EXPECT_EQ(modified.data(), modified_value);
+  }
+
+  // Regions not in the file can still be created. These also count against the budget.
+  const glm::i16vec3 new_region(1000);
+  EXPECT_EQ(paged_map.region(new_region), nullptr);
+  EXPECT_NE(paged_map.region(new_region, true), nullptr);
+  EXPECT_EQ(paged_map.pagedRegionCount(), save_map.regionCount() + 1);
+
+  // Modify more regions than the budget. Only modified regions remain resident.
+  std::vector<glm::i16vec3> region_keys;
+  paged_map.enumerateRegionKeys(region_keys);
+  ASSERT_EQ(region_keys.size(), save_map.regionCount() + 1);
+  std::vector<glm::i16vec3> modified_regions;
+  {
+    Voxel<float> occupancy(&paged_map, paged_map.layout().occupancyLayer());
+    for (const glm::i16vec3 &region_key : region_keys)
+    {
+      if (modified_regions.size() > resident_budget)
+      {
+        break;
+      }
+      occupancy.setKey(Key(region_key, 0, 0, 0));
+      ASSERT_TRUE(occupancy.isValid());
+      occupancy.write(1.0f);
+      modified_regions.emplace_back(region_key);
+    }
+  }
+  // Page in each clean region in turn. Each is evicted by the next page fault.
+  for (const glm::i16vec3 &region_key : region_keys)
+  {
+    if (std::find(modified_regions.begin(), modified_regions.end(), region_key) == modified_regions.end())
+    {
+      EXPECT_NE(paged_map.region(region_key), nullptr);
+    }
+  }
+  EXPECT_LE(paged_map.regionCount(), modified_regions.size() + 1);
+  for (const glm::i16vec3 &region_key : modified_regions)
+  {
+    EXPECT_NE(paged_map.region(region_key), nullptr);
+  }
+}
+
+
+TEST(Serialisation, PagedConcurrent)
+{
+  // Read a paged map from several threads with a resident budget far smaller than the working set. Regions are
+  // continually evicted and recycled while other threads look them up.
+  const char *map_name = "test-map-paged-concurrent.ohm";
+  const size_t resident_budget = 2;
+  const unsigned thread_count = 4;
+  const unsigned pass_count = 4;
+  OccupancyMap save_map(0.25, glm::u8vec3(8));
+
+  ohmgen::boxRoom(save_map, glm::dvec3(-2.0), glm::dvec3(2.0));
+  ASSERT_EQ(save(map_name, save_map), 0);
+  ASSERT_GT(save_map.regionCount(), resident_budget * thread_count);
+
+  std::vector<std::pair<Key, float>> expected;
+  {
+    Voxel<const float> occupancy(&save_map, save_map.layout().occupancyLayer());
+    for (auto iter = save_map.begin(); iter != save_map.end(); ++iter)
+    {
+      occupancy.setKey(*iter);
+      expected.emplace_back(*iter, occupancy.data());
+    }
+  }
+
+  OccupancyMap paged_map(1);
+  ASSERT_EQ(loadPaged(map_name, paged_map, resident_budget), 0);
+  // Recycle evicted regions so stale references read the wrong region rather than freed memory.
+  paged_map.setChunkPoolSize(resident_budget);
+
+  std::vector<unsigned> failures(thread_count, 0);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_count; ++t)
+  {
+    threads.emplace_back([&, t]() {
+      Voxel<const float> occupancy(&paged_map, paged_map.layout().occupancyLayer());
+      for (unsigned pass = 0; pass < pass_count; ++pass)
+      {
+        // Start each thread at a different offset so they fault different regions.
+        const size_t offset = (t * expected.size()) / thread_count;
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+          const auto &entry = expected[(i + offset) % expected.size()];
+          occupancy.setKey(entry.first);
+          if (!occupancy.isValid() || occupancy.data() != entry.second ||
+              occupancy.chunk()->region.coord != entry.first.regionKey())
+          {
+            ++failures[t];
+          }
+        }
+      }
+      occupancy.reset();
+    });
+  }
+
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  for (unsigned t = 0; t < thread_count; ++t)
+  {
+    EXPECT_EQ(failures[t], 0u) << "thread " << t;
+  }
+  EXPECT_LE(paged_map.regionCount(), resident_budget + thread_count);
+}
+
+TEST(Serialisation, Journal)
+{
+  const std::string map_name = "test-map-journal.ohm";
+  const std::string journal_name = "test-map-journal.ohmj";
+  OccupancyMap live_map(0.25, glm::u8vec3(16));
+
+  ohmgen::boxRoom(live_map, glm::dvec3(-2.0), glm::dvec3(2.0));
+  uint64_t checkpoint_stamp = live_map.stamp();
+  ASSERT_EQ(save(map_name, live_map), 0);
+  std::remove(journal_name.c_str());
+
+  // Modify existing regions and add new regions, checkpointing after each change.
+  ohmgen::boxRoom(live_map, glm::dvec3(-1.0), glm::dvec3(1.0));
+  ASSERT_EQ(appendJournal(journal_name, live_map, checkpoint_stamp), 0);
+  EXPECT_EQ(checkpoint_stamp, live_map.stamp());
+  ohmgen::boxRoom(live_map, glm::dvec3(3.0), glm::dvec3(6.0));
+  ASSERT_EQ(appendJournal(journal_name, live_map, checkpoint_stamp), 0);
+  // A checkpoint with no changes.
+  ASSERT_EQ(appendJournal(journal_name, live_map, checkpoint_stamp), 0);
+  // Remove regions from the base map and the journaled regions.
+  ASSERT_GT(live_map.cullRegionsOutside(glm::dvec3(0.1), glm::dvec3(0.2)), 0u);
+  ASSERT_EQ(appendJournal(journal_name, live_map, checkpoint_stamp), 0);
+
+  OccupancyMap replay_map(1);
+  ASSERT_EQ(load(map_name, replay_map), 0);
+  uint64_t replay_stamp = 0;
+  ASSERT_EQ(replayJournal(journal_name, replay_map, nullptr, &replay_stamp), 0);
+  EXPECT_EQ(replay_stamp, checkpoint_stamp);
+  EXPECT_EQ(replay_map.regionCount(), live_map.regionCount());
+  ohmtestutil::compareMaps(replay_map, live_map, ohmtestutil::kCfCompareExtended | ohmtestutil::kCfLayerBytes);
+
+  // A journal may only be applied to a map with a matching layout.
+  OccupancyMap mismatch_map(0.25, glm::u8vec3(8));
+  EXPECT_EQ(replayJournal(journal_name, mismatch_map), kSeJournalMismatch);
+
+  // Compact and validate the journal is reset.
+  ASSERT_EQ(compactJournal(map_name, journal_name), 0);
+  OccupancyMap compact_map(1);
+  ASSERT_EQ(load(map_name, compact_map), 0);
+  ohmtestutil::compareMaps(compact_map, live_map, ohmtestutil::kCfCompareExtended | ohmtestutil::kCfLayerBytes);
+
+  const size_t region_count = compact_map.regionCount();
+  ASSERT_EQ(replayJournal(journal_name, compact_map), 0);
+  EXPECT_EQ(compact_map.regionCount(), region_count);
+}
+
+
+TEST(Serialisation, JournalTornTail)
+{
+  // A journal cut off part way through writing a record must replay up to the last complete record. A following
+  // checkpoint overwrites the incomplete record.
+  const std::string map_name = "test-map-journal-torn.ohm";
+  const std::string journal_name = "test-map-journal-torn.ohmj";
+  const auto read_journal = [&journal_name]() {
+    std::ifstream in(journal_name, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  };
+  OccupancyMap live_map(0.25, glm::u8vec3(16));
+
+  ohmgen::boxRoom(live_map, glm::dvec3(-2.0), glm::dvec3(2.0));
+  uint64_t checkpoint_stamp = live_map.stamp();
+  ASSERT_EQ(save(map_name, live_map), 0);
+  std::remove(journal_name.c_str());
+
+  ohmgen::boxRoom(live_map, glm::dvec3(-1.0), glm::dvec3(1.0));
+  ASSERT_EQ(appendJournal(journal_name, live_map, checkpoint_stamp), 0);
+  const uint64_t complete_stamp = checkpoint_stamp;
+  const std::unique_ptr<OccupancyMap> complete_map(live_map.clone());
+  const size_t complete_size = read_journal().size();
+
+  ohmgen::boxRoom(live_map, glm::dvec3(3.0), glm::dvec3(6.0));
+  ASSERT_EQ(appendJournal(journal_name, live_map, checkpoint_stamp), 0);
+  const std::string journal = read_journal();
+  ASSERT_GT(journal.size(), complete_size + 8);
+
+  // Truncate the last record within its header, within its payload and before its end marker.
+  for (size_t torn_size : { complete_size + 8, (complete_size + journal.size()) / 2, journal.size() - 1 })
+  {
+    {
+      std::ofstream out(journal_name, std::ios::binary | std::ios::trunc);
+      out.write(journal.data(), std::streamsize(torn_size));
+    }
+
+    OccupancyMap replay_map(1);
+    ASSERT_EQ(load(map_name, replay_map), 0);
+    uint64_t replay_stamp = 0;
+    ASSERT_EQ(replayJournal(journal_name, replay_map, nullptr, &replay_stamp), 0) << "torn size " << torn_size;
+    EXPECT_EQ(replay_stamp, complete_stamp) << "torn size " << torn_size;
+    ohmtestutil::compareMaps(replay_map, *complete_map,
+                             ohmtestutil::kCfCompareExtended | ohmtestutil::kCfLayerBytes);
+  }
+
+  // Checkpoint the lost changes again.
+  checkpoint_stamp = complete_stamp;
+  ASSERT_EQ(appendJournal(journal_name, live_map, checkpoint_stamp), 0);
+  OccupancyMap replay_map(1);
+  ASSERT_EQ(load(map_name, replay_map), 0);
+  uint64_t replay_stamp = 0;
+  ASSERT_EQ(replayJournal(journal_name, replay_map, nullptr, &replay_stamp), 0);
+  EXPECT_EQ(replay_stamp, checkpoint_stamp);
+  ohmtestutil::compareMaps(replay_map, live_map, ohmtestutil::kCfCompareExtended | ohmtestutil::kCfLayerBytes);
+
+  // A torn tail longer than the following record is truncated rather than left after it.
+  const size_t valid_size = read_journal().size();
+  const std::string torn_tail(4096, '\xff');
+  {
+    std::ofstream out(journal_name, std::ios::binary | std::ios::app);
+    out.write(torn_tail.data(), std::streamsize(torn_tail.size()));
+  }
+  ASSERT_EQ(appendJournal(journal_name, live_map, checkpoint_stamp), 0);
+  EXPECT_GT(read_journal().size(), valid_size);
+  EXPECT_LT(read_journal().size(), valid_size + torn_tail.size());
+}
+
+
 // Legacy code used to generate the test map for Serialisation.Upgrade tests.
 void cubicRoomLegacy(OccupancyMap &map, float boundary_range, int voxel_step)
 {
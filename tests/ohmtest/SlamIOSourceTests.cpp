@@ -0,0 +1,172 @@
+// Copyright (c) 2021
+// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+// ABN 41 687 119 230
+//
+// Author: Kazys Stepanas
+#include "OhmTestConfig.h"
+
+#include <ohmapp/SlamIOSource.h>
+
+#include <glm/glm.hpp>
+
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace slamiosourcetests
+{
+const unsigned kPointCount = 1000;
+const unsigned kBatchSize = 64;
+
+/// Write a timestamped point cloud to @p path .
+void writeCloud(const std::string &path)
+{
+  std::ofstream out(path.c_str(), std::ios::binary);
+  out << "ply\n";
+  out << "format ascii 1.0\n";
+  out << "element vertex " << kPointCount << '\n';
+  out << "property double time\n";
+  out << "property double x\n";
+  out << "property double y\n";
+  out << "property double z\n";
+  out << "end_header\n";
+  out.precision(std::numeric_limits<double>::max_digits10);
+  for (unsigned i = 0; i < kPointCount; ++i)
+  {
+    out << 0.01 * i << ' ' << 0.1 * i << ' ' << 0.2 * i << ' ' << 0.5 << '\n';
+  }
+}
+
+/// Create a @c SlamIOSource for @p cloud_file ready to run.
+std::unique_ptr<ohmapp::SlamIOSource> createSource(const std::string &cloud_file, unsigned pipeline_depth,
+                                                   uint64_t expected_point_count = kPointCount)
+{
+  auto source = std::make_unique<ohmapp::SlamIOSource>();
+  source->options().cloud_file = cloud_file;
+  source->options().point_cloud_only = true;
+  source->options().batch_size = kBatchSize;
+  source->options().pipeline_depth = pipeline_depth;
+  uint64_t point_count = 0;
+  EXPECT_EQ(source->validateOptions(), 0);
+  EXPECT_EQ(source->prepareForRun(point_count, ""), 0);
+  EXPECT_EQ(point_count, expected_point_count);
+  return source;
+}
+
+
+TEST(SlamIOSource, Pipelined)
+{
+  const std::string cloud_file = "slamio-source-pipelined.ply";
+  writeCloud(cloud_file);
+
+  // Collect the samples with and without pipelining. The results must match.
+  std::vector<std::vector<glm::dvec3>> samples(2);
+  const unsigned pipeline_depths[] = { 0, 2 };
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    auto source = createSource(cloud_file, pipeline_depths[i]);
+    std::vector<glm::dvec3> &collected = samples[i];
+    ASSERT_EQ(source->run(
+                [&collected](const glm::dvec3 &, const std::vector<glm::dvec3> &sensor_and_samples,
+                             const std::vector<double> &, const std::vector<float> &, const std::vector<glm::vec4> &,
+                             const std::vector<uint8_t> &) {
+                  collected.insert(collected.end(), sensor_and_samples.begin(), sensor_and_samples.end());
+                  return true;
+                },
+                nullptr),
+              0);
+    EXPECT_EQ(source->processedPointCount(), kPointCount);
+  }
+
+  ASSERT_EQ(samples[0].size(), kPointCount);
+  EXPECT_EQ(samples[0], samples[1]);
+}
+
+
+TEST(SlamIOSource, PipelinedQuit)
+{
+  const std::string cloud_file = "slamio-source-pipelined-quit.ply";
+  writeCloud(cloud_file);
+
+  // Set the quit level from the batch function. The reader must stop and processing must end after that batch.
+  auto source = createSource(cloud_file, 2);
+  unsigned quit_level = 0;
+  unsigned batch_count = 0;
+  ASSERT_EQ(source->run(
+              [&](const glm::dvec3 &, const std::vector<glm::dvec3> &, const std::vector<double> &,
+                  const std::vector<float> &, const std::vector<glm::vec4> &, const std::vector<uint8_t> &) {
+                quit_level = (++batch_count == 2) ? 1u : quit_level;
+                return true;
+              },
+              &quit_level),
+            0);
+  EXPECT_EQ(batch_count, 2u);
+  EXPECT_EQ(source->processedPointCount(), 2u * kBatchSize);
+}
+
+
+TEST(SlamIOSource, PipelinedThrow)
+{
+  const std::string cloud_file = "slamio-source-pipelined-throw.ply";
+  writeCloud(cloud_file);
+
+  // An exception from the batch function must stop and join the reader, then propagate.
+  auto source = createSource(cloud_file, 2);
+  unsigned batch_count = 0;
+  EXPECT_THROW(source->run(
+                 [&batch_count](const glm::dvec3 &, const std::vector<glm::dvec3> &, const std::vector<double> &,
+                                const std::vector<float> &, const std::vector<glm::vec4> &,
+                                const std::vector<uint8_t> &) -> bool {
+                   if (++batch_count == 3)
+                   {
+                     throw std::runtime_error("batch failure");
+                   }
+                   return true;
+                 },
+                 nullptr),
+               std::runtime_error);
+  EXPECT_EQ(batch_count, 3u);
+}
+
+
+TEST(SlamIOSource, Tiles)
+{
+  // Load a set of tiles using a file pattern. The source is named for the pattern prefix.
+  const unsigned tile_count = 3;
+  for (unsigned i = 0; i < tile_count; ++i)
+  {
+    writeCloud("slamio-source-tile-" + std::to_string(i) + ".ply");
+  }
+
+  const auto batch_function = [](const glm::dvec3 &, const std::vector<glm::dvec3> &, const std::vector<double> &,
+                                 const std::vector<float> &, const std::vector<glm::vec4> &,
+                                 const std::vector<uint8_t> &) { return true; };
+
+  auto source = createSource("slamio-source-tile-*.ply", 2, tile_count * kPointCount);
+  EXPECT_EQ(source->sourceName(), "slamio-source-tile");
+  ASSERT_EQ(source->run(batch_function, nullptr), 0);
+  EXPECT_EQ(source->processedPointCount(), tile_count * kPointCount);
+
+  // Truncate the last tile. The failure must fail the run rather than end the data early.
+  {
+    std::ofstream out("slamio-source-tile-2.ply", std::ios::binary | std::ios::trunc);
+    out << "ply\n";
+    out << "format ascii 1.0\n";
+    out << "element vertex " << kPointCount << '\n';
+    out << "property double time\n";
+    out << "property double x\n";
+    out << "property double y\n";
+    out << "property double z\n";
+    out << "end_header\n";
+    out << "0 0 0 0\n";
+  }
+
+  source = createSource("slamio-source-tile-*.ply", 2, tile_count * kPointCount);
+  EXPECT_NE(source->run(batch_function, nullptr), 0);
+  EXPECT_EQ(source->processedPointCount(), (tile_count - 1) * kPointCount + 1);
+}
+}  // namespace slamiosourcetests
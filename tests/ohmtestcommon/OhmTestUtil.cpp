@@ -9,10 +9,17 @@
 #include <ohm/MapLayer.h>
 #include <ohm/MapLayout.h>
 #include <ohm/OccupancyMap.h>
+#include <ohm/VoxelBuffer.h>
 #include <ohm/VoxelData.h>
 
+#include <ohmtools/OhmGen.h>
+
+#include <ohmutil/GlmStream.h>
+
 #include <gtest/gtest.h>
 
+#include <cstring>
+
 #include <stdio.h> /* defines FILENAME_MAX */
 #ifdef WIN32
 #include <direct.h>
@@ -179,6 +186,19 @@ void compareMaps(const OccupancyMap &map, const OccupancyMap &reference_map, con
         }
         EXPECT_EQ(chunk->flags, ref_chunk->flags);
       }
+
+      if (compare_flags & kCfLayerBytes)
+      {
+        ASSERT_EQ(chunk->layout().layerCount(), ref_chunk->layout().layerCount());
+        for (unsigned i = 0; i < chunk->layout().layerCount(); ++i)
+        {
+          VoxelBuffer<const VoxelBlock> buffer(chunk->voxel_blocks[i]);
+          VoxelBuffer<const VoxelBlock> ref_buffer(ref_chunk->voxel_blocks[i]);
+          ASSERT_EQ(buffer.voxelMemorySize(), ref_buffer.voxelMemorySize());
+          EXPECT_EQ(memcmp(buffer.voxelMemory(), ref_buffer.voxelMemory(), buffer.voxelMemorySize()), 0)
+            << "Layer " << chunk->layout().layer(i).name() << " mismatch in region " << chunk->region.coord;
+        }
+      }
     }
   }
 
@@ -257,4 +277,15 @@ void compareMaps(const OccupancyMap &map, const OccupancyMap &reference_map, con
     }
   }
 }
+
+
+std::unique_ptr<ohm::OccupancyMap> createBoxRoomMap(const glm::u8vec3 &region_size, const ohm::MapLayout *seed_layout)
+{
+  const double resolution = 0.25;
+  std::unique_ptr<OccupancyMap> map =
+    (seed_layout) ? std::make_unique<OccupancyMap>(resolution, region_size, MapFlag::kDefault, *seed_layout) :
+                    std::make_unique<OccupancyMap>(resolution, region_size);
+  ohmgen::boxRoom(*map, glm::dvec3(-2.0), glm::dvec3(2.0));
+  return map;
+}
 }  // namespace ohmtestutil
@@ -6,10 +6,13 @@
 #ifndef OHMTESTUTIL_H
 #define OHMTESTUTIL_H
 
-#include <glm/fwd.hpp>
+#include <glm/glm.hpp>
+
+#include <memory>
 
 namespace ohm
 {
+class MapLayout;
 class OccupancyMap;
 }
 
@@ -25,6 +28,8 @@ enum CompareFlag
   kCfOccupancy = (1 << 4),
   kCfClearance = (1 << 5),
   kCfExpectClearance = (1 << 6),
+  /// Compare the raw voxel memory for every layer in each chunk. Requires @c CF_ChunksGeneral and matching layouts.
+  kCfLayerBytes = (1 << 7),
 
   kCfDefault = kCfGeneral | kCfChunksGeneral | kCfOccupancy,
   kCfCompareExtended = kCfGeneral | kCfChunksGeneral | kCfLayout | kCfOccupancy | kCfClearance,
@@ -42,6 +47,16 @@ void compareMaps(const ohm::OccupancyMap &map, const ohm::OccupancyMap &referenc
 void compareMaps(const ohm::OccupancyMap &map, const ohm::OccupancyMap &reference_map, const glm::dvec3 &min_ext,
                  const glm::dvec3 &max_ext, unsigned compare_flags = kCfDefault,
                  unsigned allowed_occupancy_mismatch_count = 0);
+
+/// Create a map at 0.25m resolution containing an @c ohmgen::boxRoom() spanning [-2, 2] on each axis.
+///
+/// The default region dimensions do not divide the room evenly, so the map has partially filled regions and walls on
+/// region boundaries along each axis.
+/// @param region_size The voxel dimensions for each map region.
+/// @param seed_layout Optional layout to create the map with. Uses the default layout when null.
+/// @return The populated map.
+std::unique_ptr<ohm::OccupancyMap> createBoxRoomMap(const glm::u8vec3 &region_size = glm::u8vec3(8, 10, 12),
+                                                    const ohm::MapLayout *seed_layout = nullptr);
 }  // namespace ohmtestutil
 
 #endif  // OHMTESTUTIL_H
@@ -19,6 +19,8 @@
 #include <ohm/VoxelData.h>
 #include <ohm/VoxelLayout.h>
 
+#include "ohmtestcommon/OhmTestUtil.h"
+
 #include <ohmtools/OhmCloud.h>
 #include <ohmtools/OhmGen.h>
 #include <ohmutil/OhmUtil.h>
@@ -1407,3 +1409,145 @@ TEST(Heightmap, VirtualSurfaceLayered)
   // EXPECT_TRUE(validation_info.surface.empty());
   // EXPECT_TRUE(validation_info.virtual_surface.empty());
 }
+
+
+TEST(Heightmap, Update)
+{
+  // Validate an incremental heightmap update matches a full rebuild after changes to the source map.
+  // Functions to modify a patch of the floor. The first raises the floor, the second removes it.
+  const auto raise_floor = [](ohm::OccupancyMap &map, const glm::dvec3 &min_ext, const glm::dvec3 &max_ext,
+                              double height) {
+    ohm::Voxel<float> occupancy(&map, map.layout().occupancyLayer());
+    for (const Key &key : ohm::KeyRange(map.voxelKey(min_ext), map.voxelKey(max_ext), map))
+    {
+      occupancy.setKey(key);
+      occupancy.write(map.missValue());
+      Key raised_key = key;
+      map.moveKeyAlongAxis(raised_key, 2, int(height / map.resolution()));
+      occupancy.setKey(raised_key);
+      occupancy.write(map.hitValue());
+    }
+  };
+  const auto remove_floor = [](ohm::OccupancyMap &map, const glm::dvec3 &min_ext, const glm::dvec3 &max_ext) {
+    ohm::Voxel<float> occupancy(&map, map.layout().occupancyLayer());
+    for (const Key &key : ohm::KeyRange(map.voxelKey(min_ext), map.voxelKey(max_ext), map))
+    {
+      occupancy.setKey(key);
+      occupancy.write(map.missValue());
+    }
+  };
+
+  // Compare every column in the heightmaps.
+  const auto compare_heightmaps = [](const ohm::Heightmap &heightmap, const ohm::Heightmap &reference) {
+    std::unordered_set<ohm::Key, ohm::Key::Hash> keys;
+    for (const ohm::Heightmap *hm : { &heightmap, &reference })
+    {
+      for (auto iter = hm->heightmap().begin(); iter != hm->heightmap().end(); ++iter)
+      {
+        keys.insert(*iter);
+      }
+    }
+
+    for (const Key &key : keys)
+    {
+      glm::dvec3 pos{};
+      glm::dvec3 ref_pos{};
+      ohm::HeightmapVoxel info{};
+      ohm::HeightmapVoxel ref_info{};
+      const ohm::HeightmapVoxelType type = heightmap.getHeightmapVoxelInfo(key, &pos, &info);
+      const ohm::HeightmapVoxelType ref_type = reference.getHeightmapVoxelInfo(key, &ref_pos, &ref_info);
+      const glm::dvec3 column_pos = reference.heightmap().voxelCentreGlobal(key);
+      ASSERT_EQ(int(type), int(ref_type)) << column_pos.x << "," << column_pos.y;
+      if (type != ohm::HeightmapVoxelType::kUnknown)
+      {
+        EXPECT_NEAR(pos.z, ref_pos.z, 1e-6) << column_pos.x << "," << column_pos.y;
+        EXPECT_NEAR(info.clearance, ref_info.clearance, 1e-6f) << column_pos.x << "," << column_pos.y;
+      }
+    }
+  };
+
+  for (ohm::HeightmapMode mode : { ohm::HeightmapMode::kPlanar, ohm::HeightmapMode::kSimpleFill })
+  {
+    SCOPED_TRACE(ohm::heightmapModeToString(mode));
+    ohm::OccupancyMap mode_map(0.1);
+    populateMultiLevelMap(mode_map, HeightmapParams());
+
+    const auto make_heightmap = [&mode_map, mode]() {
+      auto heightmap = std::make_unique<ohm::Heightmap>(mode_map.resolution(), 1.0);
+      heightmap->setOccupancyMap(&mode_map);
+      heightmap->heightmap().setOrigin(mode_map.origin());
+      heightmap->setMode(mode);
+      return heightmap;
+    };
+
+    std::unique_ptr<ohm::Heightmap> heightmap = make_heightmap();
+    heightmap->buildHeightmap(glm::dvec3(0, 0, 0));
+
+    // Raise a section of the floor away from the platform, then remove a section.
+    uint64_t stamp = mode_map.stamp();
+    raise_floor(mode_map, glm::dvec3(3.0, -4.0, 0), glm::dvec3(4.0, -3.0, 0), 0.3);
+    ASSERT_TRUE(heightmap->updateHeightmap(glm::dvec3(0, 0, 0), stamp));
+
+    std::unique_ptr<ohm::Heightmap> reference = make_heightmap();
+    reference->buildHeightmap(glm::dvec3(0, 0, 0));
+    compare_heightmaps(*heightmap, *reference);
+
+    stamp = mode_map.stamp();
+    remove_floor(mode_map, glm::dvec3(-5.0, 3.0, 0), glm::dvec3(-4.0, 4.0, 0));
+    ASSERT_TRUE(heightmap->updateHeightmap(glm::dvec3(0, 0, 0), stamp));
+
+    reference = make_heightmap();
+    reference->buildHeightmap(glm::dvec3(0, 0, 0));
+    compare_heightmaps(*heightmap, *reference);
+
+    // Add an isolated patch of floor beyond the existing map extents. No clean column around the patch has a surface,
+    // so the update cannot reach it from the existing ground.
+    stamp = mode_map.stamp();
+    raise_floor(mode_map, glm::dvec3(8.0, -1.0, 0), glm::dvec3(9.0, 0.0, 0), 0.0);
+    ASSERT_TRUE(heightmap->updateHeightmap(glm::dvec3(0, 0, 0), stamp));
+
+    reference = make_heightmap();
+    reference->buildHeightmap(glm::dvec3(0, 0, 0));
+    glm::dvec3 patch_pos{};
+    ASSERT_NE(int(reference->getHeightmapVoxelInfo(reference->heightmap().voxelKey(glm::dvec3(8.5, -0.5, 0)),
+                                                   &patch_pos)),
+              int(ohm::HeightmapVoxelType::kUnknown));
+    compare_heightmaps(*heightmap, *reference);
+  }
+}
+
+
+TEST(Heightmap, Threads)
+{
+  // Validate a multi-threaded heightmap build matches the single threaded result for each mode.
+  ohm::OccupancyMap map(0.1);
+  HeightmapParams params;
+  params.generate_virtual_surfaces = true;
+  params.virtual_surface_occlusion = false;
+  populateMultiLevelMap(map, params);
+
+  for (ohm::HeightmapMode mode = ohm::HeightmapMode::kFirst; mode <= ohm::HeightmapMode::kLast;
+       mode = ohm::HeightmapMode(int(mode) + 1))
+  {
+    std::unique_ptr<ohm::Heightmap> heightmaps[2];
+    for (unsigned i = 0; i < 2; ++i)
+    {
+      heightmaps[i] = std::make_unique<ohm::Heightmap>(map.resolution(), 0.5);
+      ohm::Heightmap &heightmap = *heightmaps[i];
+      heightmap.setOccupancyMap(&map);
+      heightmap.heightmap().setOrigin(map.origin());
+      heightmap.setMode(mode);
+      heightmap.setGenerateVirtualSurface(true);
+      if (i > 0 && !heightmap.setThreadCount(0))
+      {
+        // No threading support.
+        return;
+      }
+      heightmap.buildHeightmap(glm::dvec3(0, 0, 0));
+    }
+
+    SCOPED_TRACE(ohm::heightmapModeToString(mode));
+    ohmtestutil::compareMaps(heightmaps[1]->heightmap(), heightmaps[0]->heightmap(),
+                             ohmtestutil::kCfGeneral | ohmtestutil::kCfChunksGeneral | ohmtestutil::kCfLayerBytes);
+  }
+}
@@ -5,16 +5,30 @@
 // Author: Kazys Stepanas
 #include <gtest/gtest.h>
 
+#include "slamio/OhmRaysFormat.h"
+#include "slamio/OhmRaysWriter.h"
 #include "slamio/Points.h"
+#include "slamio/PointCloudReaderOhmRays.h"
 #include "slamio/PointCloudReaderPly.h"
+#include "slamio/PointCloudReaderTraj.h"
+#include "slamio/PointCloudReaderXyz.h"
+#include "slamio/SlamCloudLoader.h"
+#include "slamio/TextLineReader.h"
 
+#include <ohmutil/OhmUtil.h>
 #include <ohmutil/PlyPointStream.h>
 
 #include <glm/glm.hpp>
 
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <iostream>
 #include <limits>
 #include <random>
+#include <sstream>
+#include <string>
 #include <vector>
 
 namespace slamio
@@ -109,4 +123,446 @@ TEST(Loader, Ply)
 
   EXPECT_EQ(read_count, point_count);
 }
+
+
+
+TEST(Loader, PlyBinary)
+{
+  // Compare reading a binary PLY natively against reading the same data as an ASCII PLY via rply. Also serves as a
+  // simple benchmark.
+  using Clock = std::chrono::high_resolution_clock;
+  const std::string binary_ply_name = "test_loader_binary.ply";
+  const std::string ascii_ply_name = "test_loader_ascii.ply";
+  const size_t point_count = 200000;
+
+  ohm::PlyPointStream ply_out({
+    ohm::PlyPointStream::Property{ "x", ohm::PlyPointStream::Type::kFloat64 },
+    ohm::PlyPointStream::Property{ "y", ohm::PlyPointStream::Type::kFloat64 },
+    ohm::PlyPointStream::Property{ "z", ohm::PlyPointStream::Type::kFloat64 },
+    ohm::PlyPointStream::Property{ "time", ohm::PlyPointStream::Type::kFloat64 },
+    ohm::PlyPointStream::Property{ "unused", ohm::PlyPointStream::Type::kInt16 },
+    ohm::PlyPointStream::Property{ "red", ohm::PlyPointStream::Type::kUInt8 },
+    ohm::PlyPointStream::Property{ "green", ohm::PlyPointStream::Type::kUInt8 },
+    ohm::PlyPointStream::Property{ "blue", ohm::PlyPointStream::Type::kUInt8 },
+    ohm::PlyPointStream::Property{ "intensity", ohm::PlyPointStream::Type::kFloat32 },
+    ohm::PlyPointStream::Property{ "return_number", ohm::PlyPointStream::Type::kUInt8 },
+  });
+
+  std::ofstream binary_out(binary_ply_name.c_str(), std::ios::binary);
+  std::ofstream ascii_out(ascii_ply_name.c_str(), std::ios::binary);
+  ASSERT_TRUE(binary_out.is_open());
+  ASSERT_TRUE(ascii_out.is_open());
+  ply_out.open(binary_out);
+
+  ascii_out << "ply\nformat ascii 1.0\nelement vertex " << point_count << '\n';
+  ascii_out << "property double x\nproperty double y\nproperty double z\nproperty double time\n";
+  ascii_out << "property short unused\nproperty uchar red\nproperty uchar green\nproperty uchar blue\n";
+  ascii_out << "property float intensity\nproperty uchar return_number\nend_header\n";
+  ascii_out.precision(std::numeric_limits<double>::max_digits10);
+
+  std::mt19937 rand_engine(0x12345678u);
+  std::uniform_real_distribution<double> rand(-100, 100);
+  for (size_t i = 0; i < point_count; ++i)
+  {
+    const glm::dvec3 pos(rand(rand_engine), rand(rand_engine), rand(rand_engine));
+    const double time = double(i) * 1e-4;
+    const auto rgb = uint8_t(i % 256);
+    const float intensity = float(rand(rand_engine));
+    const auto return_number = uint8_t(i % 3);
+    ply_out.setPointPosition(pos);
+    ply_out.setProperty("time", time);
+    ply_out.setProperty("unused", int16_t(-1));
+    ply_out.setProperty("red", rgb);
+    ply_out.setProperty("green", uint8_t(255 - rgb));
+    ply_out.setProperty("blue", rgb);
+    ply_out.setProperty("intensity", intensity);
+    ply_out.setProperty("return_number", return_number);
+    ply_out.writePoint();
+
+    ascii_out << pos.x << ' ' << pos.y << ' ' << pos.z << ' ' << time << " -1 " << unsigned(rgb) << ' '
+              << unsigned(255 - rgb) << ' ' << unsigned(rgb) << ' ' << double(intensity) << ' '
+              << unsigned(return_number) << '\n';
+  }
+  ply_out.close();
+  binary_out.close();
+  ascii_out.close();
+
+  const auto read_all = [](const std::string &filename, DataChannel channels, std::vector<CloudPoint> &points) {
+    PointCloudReaderPly reader;
+    reader.setDesiredChannels(channels);
+    if (!reader.open(filename.c_str()))
+    {
+      return false;
+    }
+    points.resize(reader.pointCount());
+    size_t read_count = 0;
+    uint64_t chunk_count = 0;
+    while ((chunk_count = reader.readChunk(points.data() + read_count,
+                                           std::min<uint64_t>(4096u, points.size() - read_count))))
+    {
+      read_count += chunk_count;
+    }
+    return read_count == points.size();
+  };
+
+  const DataChannel all_channels =
+    DataChannel::Time | DataChannel::Position | DataChannel::Colour | DataChannel::Intensity | DataChannel::ReturnNumber;
+  std::vector<CloudPoint> ascii_points;
+  std::vector<CloudPoint> binary_points;
+  const auto ascii_start = Clock::now();
+  ASSERT_TRUE(read_all(ascii_ply_name, all_channels, ascii_points));
+  const auto binary_start = Clock::now();
+  ASSERT_TRUE(read_all(binary_ply_name, all_channels, binary_points));
+  const auto binary_end = Clock::now();
+
+  ASSERT_EQ(ascii_points.size(), point_count);
+  ASSERT_EQ(binary_points.size(), point_count);
+  for (size_t i = 0; i < point_count; ++i)
+  {
+    const CloudPoint &pt = binary_points[i];
+    const CloudPoint &ref_pt = ascii_points[i];
+    ASSERT_EQ(pt.timestamp, ref_pt.timestamp) << i;
+    ASSERT_EQ(pt.position, ref_pt.position) << i;
+    ASSERT_EQ(pt.colour, ref_pt.colour) << i;
+    ASSERT_EQ(pt.intensity, ref_pt.intensity) << i;
+    ASSERT_EQ(pt.return_number, ref_pt.return_number) << i;
+  }
+
+  std::cout << "rply ascii: " << (binary_start - ascii_start) << std::endl;
+  std::cout << "Native binary: " << (binary_end - binary_start) << std::endl;
+
+  // Validate column projection. Undesired channels are zero.
+  ASSERT_TRUE(read_all(binary_ply_name, DataChannel::Position, binary_points));
+  for (size_t i = 0; i < point_count; ++i)
+  {
+    const CloudPoint &pt = binary_points[i];
+    ASSERT_EQ(pt.position, ascii_points[i].position) << i;
+    ASSERT_EQ(pt.timestamp, 0.0) << i;
+    ASSERT_EQ(pt.intensity, 0.0f) << i;
+    ASSERT_EQ(pt.colour, glm::vec4(0, 0, 0, 1)) << i;
+  }
+
+  // Mixed readNext() and readChunk() calls.
+  PointCloudReaderPly reader;
+  reader.setDesiredChannels(all_channels);
+  ASSERT_TRUE(reader.open(binary_ply_name.c_str()));
+  CloudPoint pt{};
+  ASSERT_TRUE(reader.readNext(pt));
+  EXPECT_EQ(pt.position, ascii_points[0].position);
+  std::vector<CloudPoint> chunk(10);
+  ASSERT_EQ(reader.readChunk(chunk.data(), chunk.size()), chunk.size());
+  for (size_t i = 0; i < chunk.size(); ++i)
+  {
+    EXPECT_EQ(chunk[i].position, ascii_points[i + 1].position) << i;
+  }
+}
+
+
+TEST(Loader, OhmRays)
+{
+  // Write a ray cloud in the ohm rays format with each supported codec and validate reading it back.
+  using Clock = std::chrono::high_resolution_clock;
+  const size_t ray_count = 100000;
+  const unsigned chunk_size = 4096u;
+  std::vector<glm::dvec3> rays;
+  std::vector<double> timestamps;
+  std::vector<float> intensities;
+  std::vector<uint8_t> return_numbers;
+  {
+    std::mt19937 rand_engine(0x12345678u);
+    std::uniform_real_distribution<double> rand(-20, 20);
+    // Offset far from the origin to exercise the chunk relative coordinates.
+    const glm::dvec3 offset(6.0e5, 7.0e6, 100.0);
+    for (size_t i = 0; i < ray_count; ++i)
+    {
+      const glm::dvec3 origin = offset + glm::dvec3(double(i) * 1e-3, 0, 1);
+      rays.emplace_back(origin);
+      rays.emplace_back(origin + glm::dvec3(rand(rand_engine), rand(rand_engine), rand(rand_engine)));
+      timestamps.emplace_back(1000.0 + double(i) * 1e-4);
+      intensities.emplace_back(float(i % 100));
+      return_numbers.emplace_back(uint8_t(i % 3));
+    }
+  }
+
+  // Tolerance for float coordinates relative to a chunk origin.
+  const double epsilon = 1e-5;
+  const auto validate_ray = [&](const glm::dvec3 &origin, const glm::dvec3 &sample, size_t i) {
+    ASSERT_NEAR(origin.x, rays[i * 2 + 0].x, epsilon) << i;
+    ASSERT_NEAR(origin.y, rays[i * 2 + 0].y, epsilon) << i;
+    ASSERT_NEAR(origin.z, rays[i * 2 + 0].z, epsilon) << i;
+    ASSERT_NEAR(sample.x, rays[i * 2 + 1].x, epsilon) << i;
+    ASSERT_NEAR(sample.y, rays[i * 2 + 1].y, epsilon) << i;
+    ASSERT_NEAR(sample.z, rays[i * 2 + 1].z, epsilon) << i;
+  };
+
+  const ohmrays::Codec codecs[] = { ohmrays::kCodecNone, ohmrays::kCodecZlib, ohmrays::kCodecLz4,
+                                    ohmrays::kCodecZstd };
+  const char *codec_names[] = { "Uncompressed", "Zlib", "LZ4", "Zstd" };
+  for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); ++c)
+  {
+    const ohmrays::Codec codec = codecs[c];
+    const std::string test_rays_name = "test_loader_" + std::to_string(unsigned(codec)) + ".ohmrays";
+    if (!ohmrays::codecSupported(codec))
+    {
+      // Codecs which are not built in must fail cleanly.
+      OhmRaysWriter writer;
+      EXPECT_FALSE(writer.open(test_rays_name.c_str(), DataChannel::Time, codec, chunk_size));
+      EXPECT_FALSE(writer.isOpen());
+      continue;
+    }
+
+    {
+      OhmRaysWriter writer;
+      ASSERT_TRUE(writer.open(test_rays_name.c_str(),
+                              DataChannel::Time | DataChannel::Intensity | DataChannel::ReturnNumber, codec,
+                              chunk_size));
+      // Write the first ray individually, then the remainder in bulk.
+      ASSERT_TRUE(writer.writeRay(rays[0], rays[1], timestamps[0], intensities[0], return_numbers[0]));
+      ASSERT_TRUE(writer.writeRays(rays.data() + 2, ray_count - 1, timestamps.data() + 1, intensities.data() + 1,
+                                   return_numbers.data() + 1));
+      EXPECT_EQ(writer.rayCount(), ray_count);
+      ASSERT_TRUE(writer.close());
+    }
+
+    PointCloudReaderOhmRays reader;
+    ASSERT_TRUE(reader.open(test_rays_name.c_str()));
+    EXPECT_EQ(reader.pointCount(), ray_count);
+    EXPECT_EQ(reader.chunkCount(), (ray_count + chunk_size - 1) / chunk_size);
+    EXPECT_EQ(reader.availableChannels(), DataChannel::Position | DataChannel::Normal | DataChannel::Time |
+                                            DataChannel::Intensity | DataChannel::ReturnNumber);
+
+    // Bulk read.
+    OhmRaysChunk chunk;
+    size_t read_count = 0;
+    const auto read_start = Clock::now();
+    while (reader.readRays(chunk))
+    {
+      ASSERT_LE(read_count + chunk.rayCount(), ray_count);
+      ASSERT_EQ(chunk.timestamps.size(), chunk.rayCount());
+      ASSERT_EQ(chunk.intensities.size(), chunk.rayCount());
+      ASSERT_EQ(chunk.return_numbers.size(), chunk.rayCount());
+      for (size_t i = 0; i < chunk.rayCount(); ++i)
+      {
+        validate_ray(chunk.rays[i * 2 + 0], chunk.rays[i * 2 + 1], read_count + i);
+        ASSERT_EQ(chunk.timestamps[i], timestamps[read_count + i]);
+        ASSERT_EQ(chunk.intensities[i], intensities[read_count + i]);
+        ASSERT_EQ(chunk.return_numbers[i], return_numbers[read_count + i]);
+      }
+      read_count += chunk.rayCount();
+    }
+    const auto read_end = Clock::now();
+    EXPECT_EQ(read_count, ray_count);
+
+    // Seek back and read as a ray cloud, mixing readNext() and readChunk().
+    ASSERT_TRUE(reader.seekChunk(1));
+    std::vector<CloudPoint> points(1000);
+    CloudPoint pt{};
+    read_count = chunk_size;
+    ASSERT_TRUE(reader.readNext(pt));
+    validate_ray(pt.position + pt.normal, pt.position, read_count++);
+    uint64_t points_read = 0;
+    while ((points_read = reader.readChunk(points.data(), points.size())))
+    {
+      for (size_t i = 0; i < points_read; ++i, ++read_count)
+      {
+        validate_ray(points[i].position + points[i].normal, points[i].position, read_count);
+        ASSERT_EQ(points[i].timestamp, timestamps[read_count]);
+        ASSERT_EQ(points[i].intensity, intensities[read_count]);
+        ASSERT_EQ(points[i].return_number, return_numbers[read_count]);
+      }
+    }
+    EXPECT_EQ(read_count, ray_count);
+
+    // Open via the file extension using the SlamCloudLoader.
+    SlamCloudLoader loader;
+    ASSERT_TRUE(loader.openRayCloud(test_rays_name.c_str()));
+    SamplePoint sample{};
+    read_count = 0;
+    while (loader.nextSample(sample))
+    {
+      ASSERT_LT(read_count, ray_count);
+      validate_ray(sample.origin, sample.sample, read_count);
+      ++read_count;
+    }
+    EXPECT_EQ(read_count, ray_count);
+
+    std::cout << codec_names[c] << " ohmrays read: " << (read_end - read_start) << std::endl;
+  }
+
+  // The reader must reject an unknown codec.
+  {
+    const char *test_rays_name = "test_loader_bad_codec.ohmrays";
+    ohmrays::FileHeader header{};
+    header.marker = ohmrays::kFileMarker;
+    header.version = ohmrays::kVersion;
+    header.codec = 0xffffu;
+    {
+      std::ofstream out(test_rays_name, std::ios::binary);
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+    PointCloudReaderOhmRays reader;
+    EXPECT_FALSE(reader.open(test_rays_name));
+  }
+}
+
+
+TEST(Loader, ParseDouble)
+{
+  const char *values[] = { "0",
+                           "-0",
+                           "1",
+                           "-12.5",
+                           "0.1",
+                           "3.14159265358979",
+                           "1e-5",
+                           "2.5E+10",
+                           "1e300",
+                           "-4.9e-324",
+                           "0.000000123",
+                           "123456789012345678",
+                           "1.7976931348623157e308",
+                           "inf",
+                           "-nan",
+                           "0x1p3",
+                           "6.02214076e23",
+                           "1234.5678e-30" };
+  for (const char *str : values)
+  {
+    double value = 0;
+    const char *end = str + std::strlen(str);
+    const char *parse_end = parseDouble(str, end, value);
+    ASSERT_NE(parse_end, nullptr) << str;
+    EXPECT_EQ(parse_end, end) << str;
+    const double expected = std::strtod(str, nullptr);
+    if (expected == expected)
+    {
+      EXPECT_EQ(std::memcmp(&value, &expected, sizeof(value)), 0) << str;
+    }
+    else
+    {
+      EXPECT_NE(value, value) << str;
+    }
+  }
+
+  // Compare random values at various precisions against strtod().
+  std::mt19937 rand_engine(0x1234u);
+  std::uniform_real_distribution<double> rand(-1e5, 1e5);
+  char buffer[64];
+  for (int i = 0; i < 100000; ++i)
+  {
+    std::snprintf(buffer, sizeof(buffer), "%.*g", 1 + i % 17, rand(rand_engine));
+    double value = 0;
+    ASSERT_NE(parseDouble(buffer, buffer + std::strlen(buffer), value), nullptr) << buffer;
+    ASSERT_EQ(value, std::strtod(buffer, nullptr)) << buffer;
+  }
+
+  double value = 0;
+  const char *empty = "  ";
+  EXPECT_EQ(parseDouble(empty, empty + std::strlen(empty), value), nullptr);
+  const char *text = "x";
+  EXPECT_EQ(parseDouble(text, text + std::strlen(text), value), nullptr);
+}
+
+
+TEST(Loader, Xyz)
+{
+  // Write a text cloud, then compare reading with PointCloudReaderXyz against a reference parse using stream
+  // operators. The point count is large enough to provide a simple read benchmark.
+  using Clock = std::chrono::high_resolution_clock;
+  const std::string test_xyz_name = "test_loader.xyz";
+  const size_t point_count = 200000;
+  {
+    std::mt19937 rand_engine(0x12345678u);
+    std::uniform_real_distribution<double> rand(-50, 50);
+    std::ofstream out(test_xyz_name.c_str(), std::ios::binary);
+    out << "time x y z nx ny nz intensity\r\n";
+    for (size_t i = 0; i < point_count; ++i)
+    {
+      // Vary the precision to exercise the fast and fallback parsing paths.
+      out.precision((i % 8 == 0) ? std::numeric_limits<double>::max_digits10 : 8);
+      out << 1000.0 + double(i) * 1e-3 << ' ' << rand(rand_engine) << ' ' << rand(rand_engine) << ' '
+          << rand(rand_engine) << '\t' << rand(rand_engine) << ' ' << rand(rand_engine) << ' ' << rand(rand_engine)
+          << ' ' << (i % 256) << '\n';
+    }
+  }
+
+  // Reference read.
+  std::vector<CloudPoint> reference_points;
+  reference_points.reserve(point_count);
+  const auto reference_start = Clock::now();
+  {
+    std::ifstream in(test_xyz_name.c_str(), std::ios::binary);
+    std::string line;
+    std::getline(in, line);
+    CloudPoint pt{};
+    double intensity = 0;
+    while (std::getline(in, line))
+    {
+      std::istringstream istr(line);
+      istr >> pt.timestamp >> pt.position.x >> pt.position.y >> pt.position.z >> pt.normal.x >> pt.normal.y >>
+        pt.normal.z >> intensity;
+      pt.intensity = float(intensity);
+      reference_points.emplace_back(pt);
+    }
+  }
+  const auto reference_end = Clock::now();
+  ASSERT_EQ(reference_points.size(), point_count);
+
+  PointCloudReaderXyz reader;
+  reader.setDesiredChannels(DataChannel::Time | DataChannel::Position | DataChannel::Normal | DataChannel::Intensity);
+  ASSERT_TRUE(reader.open(test_xyz_name.c_str()));
+
+  std::vector<CloudPoint> points(point_count + 1);
+  const auto read_start = Clock::now();
+  size_t read_count = 0;
+  uint64_t chunk_count = 0;
+  while ((chunk_count =
+            reader.readChunk(points.data() + read_count, std::min<uint64_t>(1024u, points.size() - read_count))))
+  {
+    read_count += chunk_count;
+  }
+  const auto read_end = Clock::now();
+
+  ASSERT_EQ(read_count, point_count);
+  for (size_t i = 0; i < point_count; ++i)
+  {
+    const CloudPoint &pt = points[i];
+    const CloudPoint &ref_pt = reference_points[i];
+    ASSERT_EQ(pt.timestamp, ref_pt.timestamp) << i;
+    ASSERT_EQ(pt.position.x, ref_pt.position.x) << i;
+    ASSERT_EQ(pt.position.y, ref_pt.position.y) << i;
+    ASSERT_EQ(pt.position.z, ref_pt.position.z) << i;
+    ASSERT_EQ(pt.normal.x, ref_pt.normal.x) << i;
+    ASSERT_EQ(pt.normal.y, ref_pt.normal.y) << i;
+    ASSERT_EQ(pt.normal.z, ref_pt.normal.z) << i;
+    ASSERT_EQ(pt.intensity, ref_pt.intensity) << i;
+  }
+
+  std::cout << "Stream parse: " << (reference_end - reference_start) << std::endl;
+  std::cout << "Xyz reader: " << (read_end - read_start) << std::endl;
+}
+
+
+TEST(Loader, Traj)
+{
+  // Trajectory with a headings line and no trailing new line.
+  const std::string test_traj_name = "test_loader.txt";
+  {
+    std::ofstream out(test_traj_name.c_str(), std::ios::binary);
+    out << "time x y z q0 q1 q2 q3\n";
+    out << "0.5 1 2 3 1 0 0 0\n";
+    out << "1.5 -1 -2 -3.25 1 0 0 0";
+  }
+
+  PointCloudReaderTraj reader;
+  ASSERT_TRUE(reader.open(test_traj_name.c_str()));
+  CloudPoint pt{};
+  ASSERT_TRUE(reader.readNext(pt));
+  EXPECT_EQ(pt.timestamp, 0.5);
+  EXPECT_EQ(pt.position, glm::dvec3(1, 2, 3));
+  ASSERT_TRUE(reader.readNext(pt));
+  EXPECT_EQ(pt.timestamp, 1.5);
+  EXPECT_EQ(pt.position, glm::dvec3(-1, -2, -3.25));
+  EXPECT_FALSE(reader.readNext(pt));
+}
 }  // namespace slamio
@@ -11,9 +11,14 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
+#include <iostream>
+#include <iterator>
 #include <limits>
 #include <random>
+#include <string>
 #include <vector>
 
 namespace
@@ -138,6 +143,156 @@ TEST(SlamIO, SlamRead)
   }
 }
 
+TEST(SlamIO, MultiFileRead)
+{
+  // Split a time ordered cloud into tiles and read them with the trajectory using both sequential and background file
+  // reading.
+  std::vector<glm::dvec4> samples;
+  std::vector<glm::dvec4> trajectory;
+
+  generateSlamCloud(&samples, &trajectory);
+  // Spread the sample times over the trajectory.
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    samples[i].w = data_time * double(i) / double(samples.size());
+  }
+
+  const size_t tile_count = 5;
+  const size_t tile_size = (samples.size() + tile_count - 1) / tile_count;
+  for (size_t i = 0; i < tile_count; ++i)
+  {
+    const std::vector<glm::dvec4> tile(samples.begin() + i * tile_size,
+                                       samples.begin() + std::min(samples.size(), (i + 1) * tile_size));
+    writeTimestampedPlyCloud("slam-tile-" + std::to_string(i) + ".ply", tile);
+  }
+  const std::string trajectory_file = "slam-tile-trajectory.txt";
+  writeTextTrajectory(trajectory_file, trajectory);
+
+  const std::vector<std::string> sample_files = slamio::expandFilePattern("slam-tile-?.ply");
+  ASSERT_EQ(sample_files.size(), tile_count);
+
+  for (unsigned read_ahead = 0; read_ahead <= 2; read_ahead += 2)
+  {
+    slamio::SlamCloudLoader reader;
+    reader.setErrorLog([](const char *msg) { std::cerr << msg << std::flush; });
+    reader.setFileReadAhead(read_ahead);
+
+    ASSERT_TRUE(reader.openWithTrajectory(sample_files, trajectory_file.c_str()));
+    EXPECT_EQ(reader.numberOfPoints(), samples.size());
+
+    // Mix single and bulk sample reads.
+    std::vector<slamio::SamplePoint> read_samples(samples.size() + 1);
+    size_t read_count = 0;
+    ASSERT_TRUE(reader.nextSample(read_samples[read_count++]));
+    size_t batch_count = 0;
+    while ((batch_count = reader.nextSamples(read_samples.data() + read_count,
+                                             std::min<size_t>(1000, read_samples.size() - read_count))))
+    {
+      read_count += batch_count;
+    }
+    ASSERT_EQ(read_count, samples.size());
+
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+      const slamio::SamplePoint &sample = read_samples[i];
+      ASSERT_NEAR(sample.timestamp, samples[i].w, e0);
+      ASSERT_NEAR(sample.sample.x, samples[i].x, e0);
+      ASSERT_NEAR(sample.sample.y, samples[i].y, e0);
+      ASSERT_NEAR(sample.sample.z, samples[i].z, e0);
+      const glm::dvec3 traj_pt = glm::dvec3(generateTrajectoryPoint(sample.timestamp));
+      ASSERT_NEAR(sample.origin.x, traj_pt.x, 1e-9);
+      ASSERT_NEAR(sample.origin.y, traj_pt.y, 1e-9);
+      ASSERT_NEAR(sample.origin.z, traj_pt.z, 1e-9);
+    }
+  }
+}
+
+TEST(SlamIO, MultiFileReadError)
+{
+  // Read a set of tiles where one tile is truncated and another is missing. Reading must stop at the first failure and
+  // report it rather than skipping the tile.
+  std::vector<glm::dvec4> samples;
+  std::vector<glm::dvec4> trajectory;
+  generateSlamCloud(&samples, &trajectory);
+
+  const size_t tile_count = 3;
+  const size_t tile_size = (samples.size() + tile_count - 1) / tile_count;
+  std::vector<std::string> sample_files;
+  for (size_t i = 0; i < tile_count; ++i)
+  {
+    const std::vector<glm::dvec4> tile(samples.begin() + i * tile_size,
+                                       samples.begin() + std::min(samples.size(), (i + 1) * tile_size));
+    sample_files.emplace_back("slam-error-tile-" + std::to_string(i) + ".ply");
+    writeTimestampedPlyCloud(sample_files.back(), tile);
+  }
+
+  // Truncate the second tile to half its size.
+  {
+    std::ifstream in(sample_files[1].c_str(), std::ios::binary);
+    const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream out(sample_files[1].c_str(), std::ios::binary | std::ios::trunc);
+    out.write(content.data(), std::streamsize(content.size() / 2));
+  }
+
+  for (unsigned read_ahead = 0; read_ahead <= 2; read_ahead += 2)
+  {
+    slamio::SlamCloudLoader reader;
+    reader.setFileReadAhead(read_ahead);
+    ASSERT_TRUE(reader.openPointCloud(sample_files));
+    EXPECT_TRUE(reader.readError().empty());
+
+    std::vector<slamio::SamplePoint> read_samples(samples.size());
+    size_t read_count = 0;
+    size_t batch_count = 0;
+    while ((batch_count = reader.nextSamples(read_samples.data() + read_count, read_samples.size() - read_count)))
+    {
+      read_count += batch_count;
+    }
+
+    // All of the first tile and some of the second tile are delivered. Nothing from the third tile.
+    EXPECT_GT(read_count, tile_size);
+    EXPECT_LT(read_count, 2 * tile_size);
+    ASSERT_FALSE(reader.readError().empty());
+    EXPECT_NE(reader.readError().find(sample_files[1]), std::string::npos);
+    for (size_t i = 0; i < tile_size; ++i)
+    {
+      ASSERT_NEAR(read_samples[i].sample.x, samples[i].x, e0);
+      ASSERT_NEAR(read_samples[i].sample.y, samples[i].y, e0);
+      ASSERT_NEAR(read_samples[i].sample.z, samples[i].z, e0);
+    }
+
+    reader.close();
+    EXPECT_TRUE(reader.readError().empty());
+  }
+
+  // Remove the last tile after opening. The open failure must be reported once reading reaches it. Read ahead is at
+  // most one file so the last tile cannot be opened before it is removed.
+  const std::vector<std::string> open_files = { sample_files[0], sample_files[0], sample_files[2] };
+  for (unsigned read_ahead = 0; read_ahead <= 1; ++read_ahead)
+  {
+    const std::vector<glm::dvec4> last_tile(samples.begin() + 2 * tile_size, samples.end());
+    writeTimestampedPlyCloud(sample_files[2], last_tile);
+
+    slamio::SlamCloudLoader reader;
+    reader.setFileReadAhead(read_ahead);
+    ASSERT_TRUE(reader.openPointCloud(open_files));
+    ASSERT_EQ(std::remove(sample_files[2].c_str()), 0);
+
+    std::vector<slamio::SamplePoint> read_samples(samples.size());
+    size_t read_count = 0;
+    size_t batch_count = 0;
+    while ((batch_count = reader.nextSamples(read_samples.data() + read_count, read_samples.size() - read_count)))
+    {
+      read_count += batch_count;
+    }
+
+    EXPECT_EQ(read_count, 2 * tile_size);
+    ASSERT_FALSE(reader.readError().empty());
+    EXPECT_NE(reader.readError().find(sample_files[2]), std::string::npos);
+  }
+}
+
 TEST(SlamIO, CloudRead)
 {
   std::vector<glm::dvec4> samples;
@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 
 #include <ohm/DefaultLayer.h>
+#include <ohm/ForEachRegion.h>
 #include <ohm/Key.h>
 #include <ohm/KeyList.h>
 #include <ohm/MapInfo.h>
@@ -115,6 +116,8 @@ struct Options
   float threshold = -1.0f;
   float max_intensity = 100.0f;
   float colour_scale = 3.0f;
+  unsigned thread_count = 0;
+  int page_budget = -1;
   ExportMode mode = kExportOccupancy;
   ColourModeOrValue colour = ColourModeOrValue(kColourHeight);
   VoxelMode voxel_mode = kVoxelPoint;
@@ -460,6 +463,11 @@ int parseOptions(Options *opt, int argc, char *argv[])  // NOLINT(modernize-avoi
       ("threshold", "Override the map's occupancy threshold or set the density threshold. Only points passing the "
                     "threshold occupied points are exported.",
                     cxxopts::value(opt->threshold)->default_value(optStr(opt->threshold)))
+      ("threads", "Number of threads used to extract points for point cloud exports. Zero to use all available threads. "
+                  "The output is the same for any thread count.", optVal(opt->thread_count))
+      ("paged", "Page map regions in on demand rather than loading the full map, keeping at most N regions resident (zero "
+                "for no limit). Only for point cloud exports and may not be used with --cull or --expire. Requires map "
+                "format 0.6 or later.", optVal(opt->page_budget), "N")
       ("max-intensity", "Maximum expected intensity value. For use with --colour=intensity, this is the value at which the colour saturates.", optVal(opt->max_intensity))
       ("voxel-mode", "Voxel export mode [point,voxel]: select the ply representation for voxels.", cxxopts::value(opt->voxel_mode)->default_value(optStr(opt->voxel_mode)))
       ;
@@ -490,6 +498,20 @@ int parseOptions(Options *opt, int argc, char *argv[])  // NOLINT(modernize-avoi
       std::cerr << "Missing output file name" << std::endl;
       return -1;
     }
+    if (opt->page_budget >= 0)
+    {
+      // Culling and expiry only see resident regions, while the other export modes visit the map directly.
+      if (opt->cull_distance > 0 || opt->expiry_time > 0)
+      {
+        std::cerr << "--paged may not be used with --cull or --expire" << std::endl;
+        return -1;
+      }
+      if (opt->mode == kExportHeightmapMesh || opt->mode == kExportCovariance)
+      {
+        std::cerr << "--paged is not supported for export mode " << opt->mode << std::endl;
+        return -1;
+      }
+    }
   }
   catch (const cxxopts::OptionException &e)
   {
@@ -506,7 +528,8 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
   ohm::OccupancyMap map(1.0f);
 
   prog.startThread();
-  int res = ohm::load(opt.map_file.c_str(), map, &load_progress);
+  int res = (opt.page_budget >= 0) ? ohm::loadPaged(opt.map_file.c_str(), map, size_t(opt.page_budget)) :
+                                     ohm::load(opt.map_file.c_str(), map, &load_progress);
   prog.endProgress();
 
   std::cout << std::endl;
@@ -605,7 +628,7 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
   }
 
   std::cout << "Converting to PLY cloud" << std::endl;
-  const size_t region_count = map.regionCount();
+  const size_t region_count = map.pagedRegionCount();
   // uint64_t point_count = 0;
 
   prog.beginProgress(ProgressMonitor::Info(region_count));
@@ -629,6 +652,7 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
     ohmtools::SaveCloudOptions save_opt;
     save_opt.ignore_voxel_mean = opt.mode != kExportOccupancy;
     save_opt.export_free = opt.mode == kExportObserved;
+    save_opt.thread_count = opt.thread_count;
     // Default colour mode for saveCloud() is colour by height.
     save_opt.allow_default_colour_selection = (opt.colour.mode == kColourHeight);
     switch (opt.colour.mode)
@@ -683,6 +707,7 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
     save_opt.ignore_voxel_mean = false;
     save_opt.allow_default_colour_selection = true;
     save_opt.density_threshold = opt.threshold;
+    save_opt.thread_count = opt.thread_count;
     export_count = saveDensityCloud(opt.ply_file.c_str(), map, save_opt, save_progress_callback);
     break;
   }
@@ -692,6 +717,7 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
     save_opt.ignore_voxel_mean = false;
     save_opt.export_free = true;
     save_opt.collapse = opt.heightmap.collapse;
+    save_opt.thread_count = opt.thread_count;
     switch (opt.colour.mode)
     {
     case kColourNone:
@@ -749,7 +775,7 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
     glm::dvec3 max_ext;
     map.calculateExtents(&min_ext, &max_ext);
     export_count = ohmtools::saveClearanceCloud(opt.ply_file.c_str(), map, min_ext, max_ext, opt.colour_scale,
-                                                ohm::kFree, save_progress_callback);
+                                                ohm::kFree, save_progress_callback, opt.thread_count);
     break;
   }
   case kExportTsdf:
@@ -792,8 +818,8 @@ int exportPointCloud(const Options &opt, ProgressMonitor &prog, LoadMapProgress
     }
     else
     {
-      export_count =
-        ohmtools::saveTsdfCloud(opt.ply_file.c_str(), map, surface_distance, colour_select, save_progress_callback);
+      export_count = ohmtools::saveTsdfCloud(opt.ply_file.c_str(), map, surface_distance, colour_select,
+                                             save_progress_callback, opt.thread_count);
     }
     break;
   }
@@ -899,7 +925,6 @@ int exportCovariance(const Options &opt, ProgressMonitor &prog, LoadMapProgress
   };
 
   const size_t region_count = map.regionCount();
-  glm::i16vec3 last_region = map.begin().key().regionKey();
 
   ohm::Voxel<const float> occupancy(&map, map.layout().occupancyLayer());
   ohm::Voxel<const ohm::VoxelMean> mean(&map, map.layout().meanLayer());
@@ -972,35 +997,42 @@ int exportCovariance(const Options &opt, ProgressMonitor &prog, LoadMapProgress
 
   prog.beginProgress(ProgressMonitor::Info(region_count));
 
-  for (auto iter = map.begin(); iter != map.end() && !g_quit; ++iter)
-  {
-    ohm::setVoxelKey(*iter, occupancy, mean, covariance);
-    if (last_region != iter->regionKey())
-    {
-      prog.incrementProgress();
-      last_region = iter.key().regionKey();
-    }
-
-    if (!ohm::isOccupied(occupancy))
-    {
-      continue;
-    }
-
-    const glm::dvec3 pos = ohm::positionSafe(mean);
-    ohm::CovarianceVoxel cov;
-    covariance.read(&cov);
-
-    // Add an ellipsoid to the PLY
-    glm::dquat rot;
-    glm::dvec3 scale;
-    ohm::covarianceUnitSphereTransformation(&cov, &rot, &scale);
-    // For rendering niceness, we scale up a bit to get better overlap between voxels.
-    const double scale_factor = std::sqrt(3.0);
-    scale *= scale_factor;
+  ohm::forEachRegion(
+    map, { map.layout().occupancyLayer() },
+    [&](const ohm::RegionVoxels &region) {
+      if (g_quit)
+      {
+        return;
+      }
 
-    const glm::dmat4 transform = glm::translate(pos) * glm::mat4_cast(rot) * glm::scale(scale);
-    add_ellipsoid(ply, transform, colour_select(occupancy));
-  }
+      const float *occupancy_values = region.voxels<float>(0);
+      for (unsigned i = region.begin(); i < region.end(); ++i)
+      {
+        // Filter on the occupancy buffer before resolving the voxel references.
+        if (!ohm::isOccupied(occupancy_values[i], map))
+        {
+          continue;
+        }
+
+        ohm::setVoxelKey(region.key(i), occupancy, mean, covariance);
+        const glm::dvec3 pos = ohm::positionSafe(mean);
+        ohm::CovarianceVoxel cov;
+        covariance.read(&cov);
+
+        // Add an ellipsoid to the PLY
+        glm::dquat rot;
+        glm::dvec3 scale;
+        ohm::covarianceUnitSphereTransformation(&cov, &rot, &scale);
+        // For rendering niceness, we scale up a bit to get better overlap between voxels.
+        const double scale_factor = std::sqrt(3.0);
+        scale *= scale_factor;
+
+        const glm::dmat4 transform = glm::translate(pos) * glm::mat4_cast(rot) * glm::scale(scale);
+        add_ellipsoid(ply, transform, colour_select(occupancy));
+      }
+      prog.incrementProgress();
+    },
+    1);
 
 #if OHM_COV_DEBUG
   ohm::covDebugStats();
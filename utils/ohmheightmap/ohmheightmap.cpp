@@ -158,6 +158,8 @@ struct Options
   double floor = -1;
   double ceiling = -1;
   unsigned virtual_surface_filter_threshold = 0;
+  unsigned thread_count = 1;
+  int page_budget = -1;
   bool virtual_surfaces = false;
   bool no_voxel_mean = false;
 };
@@ -212,8 +214,14 @@ int parseOptions(Options *opt, int argc, char *argv[])  // NOLINT(modernize-avoi
        optVal(opt->floor))                                                                           //
       ("mode", mode_help.str(), optVal(opt->mode))                                                   //
       ("no-voxel-mean", "Ignore voxel mean positioning if available?.", optVal(opt->no_voxel_mean))  //
+      ("paged",
+       "Page map regions in on demand rather than loading the full map, keeping at most N regions resident (zero for "
+       "no limit). Requires map format 0.6 or later.",
+       optVal(opt->page_budget), "N")  //
       ("seed", "Seed position from which to build the heightmap. Specified as a 3 component vector such as '0,0,1'.",
-       optVal(opt->seed_pos))                                                        //
+       optVal(opt->seed_pos))  //
+      ("threads", "Number of threads used to search the source map columns. Zero to use all available threads.",
+       optVal(opt->thread_count))                                                    //
       ("up", "Specifies the up axis {x,y,z,-x,-y,-z}.", optVal(opt->axis_id))        //
       ("virtual", "Allow virtual surfaces?", cxxopts::value(opt->virtual_surfaces))  //
       ("virtual-filter-threshold",
@@ -308,7 +316,8 @@ int main(int argc, char *argv[])
   });
 
   prog.startThread();
-  res = ohm::load(opt.map_file.c_str(), map, &load_progress, &version);
+  res = (opt.page_budget >= 0) ? ohm::loadPaged(opt.map_file.c_str(), map, size_t(opt.page_budget), &version) :
+                                 ohm::load(opt.map_file.c_str(), map, &load_progress, &version);
   prog.endProgress();
 
   std::cout << std::endl;
@@ -336,6 +345,7 @@ int main(int argc, char *argv[])
   heightmap.setIgnoreVoxelMean(opt.no_voxel_mean);
   heightmap.setGenerateVirtualSurface(opt.virtual_surfaces);
   heightmap.setVirtualSurfaceFilterThreshold(opt.virtual_surface_filter_threshold);
+  heightmap.setThreadCount(opt.thread_count);
 
   heightmap.buildHeightmap(opt.seed_pos);
   heightmap.checkForBaseLayerDuplicates(std::cerr);
@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 
 #include <ohm/DefaultLayer.h>
+#include <ohm/ForEachRegion.h>
 #include <ohm/MapInfo.h>
 #include <ohm/MapLayer.h>
 #include <ohm/MapLayout.h>
@@ -47,6 +48,72 @@ struct Options
   bool calculate_extents = false;
   bool detail = false;
 };
+
+/// Voxel statistics gathered for the detailed report.
+struct VoxelStats
+{
+  float min_occupancy = std::numeric_limits<float>::max();
+  float max_occupancy = -std::numeric_limits<float>::max();
+  float min_intensity = std::numeric_limits<float>::max();
+  float max_intensity = -std::numeric_limits<float>::max();
+  uint64_t free_voxels = 0;
+  uint64_t occupied_voxels = 0;
+  uint64_t total_point_count = 0;
+  unsigned max_point_count = 0;
+
+  /// Accumulate the statistics for the voxels of a region.
+  /// @param region The region to accumulate with the occupancy, mean and intensity layers requested in that order.
+  void add(const ohm::RegionVoxels &region)
+  {
+    const float *occupancy = region.voxels<float>(0);
+    const ohm::VoxelMean *mean = region.voxels<ohm::VoxelMean>(1);
+    const ohm::IntensityMeanCov *intensity = region.voxels<ohm::IntensityMeanCov>(2);
+    const float occupancy_threshold = region.map().occupancyThresholdValue();
+    for (unsigned i = region.begin(); i < region.end(); ++i)
+    {
+      const float value = occupancy[i];
+      if (value != ohm::unobservedOccupancyValue())
+      {
+        min_occupancy = std::min(value, min_occupancy);
+        max_occupancy = std::max(value, max_occupancy);
+
+        const bool is_occupied = (value >= occupancy_threshold);
+        free_voxels += !!(value < occupancy_threshold);
+        occupied_voxels += !!is_occupied;
+
+        if (is_occupied)
+        {
+          if (mean)
+          {
+            max_point_count = std::max<unsigned>(mean[i].count, max_point_count);
+            total_point_count += mean[i].count;
+          }
+
+          if (intensity)
+          {
+            min_intensity = std::min(min_intensity, intensity[i].intensity_mean);
+            max_intensity = std::max(max_intensity, intensity[i].intensity_mean);
+          }
+        }
+      }
+    }
+  }
+
+  /// Combine two sets of statistics.
+  static VoxelStats merge(const VoxelStats &a, const VoxelStats &b)
+  {
+    VoxelStats stats;
+    stats.min_occupancy = std::min(a.min_occupancy, b.min_occupancy);
+    stats.max_occupancy = std::max(a.max_occupancy, b.max_occupancy);
+    stats.min_intensity = std::min(a.min_intensity, b.min_intensity);
+    stats.max_intensity = std::max(a.max_intensity, b.max_intensity);
+    stats.free_voxels = a.free_voxels + b.free_voxels;
+    stats.occupied_voxels = a.occupied_voxels + b.occupied_voxels;
+    stats.total_point_count = a.total_point_count + b.total_point_count;
+    stats.max_point_count = std::max(a.max_point_count, b.max_point_count);
+    return stats;
+  }
+};
 }  // namespace
 
 
@@ -259,71 +326,40 @@ int main(int argc, char *argv[])
 
   if (opt.detail)
   {
-    float min_occupancy = std::numeric_limits<float>::max();
-    float max_occupancy = -std::numeric_limits<float>::max();
-    float min_intensity = std::numeric_limits<float>::max();
-    float max_intensity = -std::numeric_limits<float>::max();
-    uint64_t free_voxels = 0;
-    uint64_t occupied_voxels = 0;
-    uint64_t total_point_count = 0;
-    unsigned max_point_count = 0;
-
-    ohm::Voxel<const float> voxel(&map, map.layout().occupancyLayer());
-    ohm::Voxel<const ohm::VoxelMean> mean(&map, map.layout().meanLayer());
-    ohm::Voxel<const ohm::IntensityMeanCov> intensity(&map, map.layout().intensityLayer());
-    if (voxel.isLayerValid())
+    const int occupancy_layer = map.layout().occupancyLayer();
+    const int mean_layer = map.layout().meanLayer();
+    const int intensity_layer = map.layout().intensityLayer();
+    if (occupancy_layer != -1)
     {
-      for (auto iter = map.begin(); iter != map.end() && !g_quit; ++iter)
-      {
-        ohm::setVoxelKey(iter, voxel, mean, intensity);
-        float value;
-        voxel.read(&value);
-        if (value != ohm::unobservedOccupancyValue())
-        {
-          min_occupancy = std::min(value, min_occupancy);
-          max_occupancy = std::max(value, max_occupancy);
-
-          const bool is_occupied = (value >= map.occupancyThresholdValue());
-          free_voxels += !!(value < map.occupancyThresholdValue());
-          occupied_voxels += !!is_occupied;
-
-          if (is_occupied)
+      // Gather the statistics for each region in parallel.
+      const VoxelStats stats = ohm::reduceRegions(
+        map, { occupancy_layer, mean_layer, intensity_layer }, VoxelStats{},
+        [](const ohm::RegionVoxels &region, VoxelStats &region_stats) {
+          if (!g_quit)
           {
-            if (mean.isValid())
-            {
-              ohm::VoxelMean mean_info;
-              mean.read(&mean_info);
-              max_point_count = std::max<unsigned>(mean_info.count, max_point_count);
-              total_point_count += mean_info.count;
-            }
-
-            if (intensity.isValid())
-            {
-              const float intensity_value = intensity.data().intensity_mean;
-              min_intensity = std::min(min_intensity, intensity_value);
-              max_intensity = std::max(max_intensity, intensity_value);
-            }
+            region_stats.add(region);
           }
-        }
-      }
+        },
+        VoxelStats::merge);
 
-      std::cout << "Probability max: " << ohm::valueToProbability(max_occupancy) << " (" << max_occupancy << ")"
-                << std::endl;
-      std::cout << "Probability min: " << ohm::valueToProbability(min_occupancy) << " (" << min_occupancy << ")"
-                << std::endl;
-      std::cout << "Free voxels: " << free_voxels << std::endl;
-      std::cout << "Occupied voxels: " << occupied_voxels << std::endl;
+      std::cout << "Probability max: " << ohm::valueToProbability(stats.max_occupancy) << " ("
+                << stats.max_occupancy << ")" << std::endl;
+      std::cout << "Probability min: " << ohm::valueToProbability(stats.min_occupancy) << " ("
+                << stats.min_occupancy << ")" << std::endl;
+      std::cout << "Free voxels: " << stats.free_voxels << std::endl;
+      std::cout << "Occupied voxels: " << stats.occupied_voxels << std::endl;
 
-      if (mean.isLayerValid())
+      if (mean_layer != -1)
       {
-        std::cout << "Max voxel samples: " << max_point_count << std::endl;
-        std::cout << "Average voxel samples: " << total_point_count / occupied_voxels << std::endl;
+        std::cout << "Max voxel samples: " << stats.max_point_count << std::endl;
+        std::cout << "Average voxel samples: "
+                  << ((stats.occupied_voxels) ? stats.total_point_count / stats.occupied_voxels : 0u) << std::endl;
       }
 
-      if (intensity.isLayerValid())
+      if (intensity_layer != -1)
       {
-        std::cout << "Minimum intensity: " << min_intensity << std::endl;
-        std::cout << "Maximum intensity: " << max_intensity << std::endl;
+        std::cout << "Minimum intensity: " << stats.min_intensity << std::endl;
+        std::cout << "Maximum intensity: " << stats.max_intensity << std::endl;
       }
     }
     else
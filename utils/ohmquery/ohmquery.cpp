@@ -80,6 +80,7 @@ struct Options
   Ranges ranges;
   Line line;
   int repeat = 0;
+  int page_budget = -1;
   bool unknown_as_occupied = true;
   bool use_gpu = false;
   bool gpu_compare = false;
@@ -96,6 +97,10 @@ void Options::print() const
 {
   std::cout << "Map: " << map_file << std::endl;
   std::cout << "Output: " << output_base << std::endl;
+  if (page_budget >= 0)
+  {
+    std::cout << "Paged regions: " << page_budget << std::endl;
+  }
   if (neighbours.radius >= 0)
   {
     std::cout << "Nearest neighbours: " << neighbours.point << " R: " << neighbours.radius << std::endl;
@@ -213,6 +218,7 @@ int parseOptions(Options *opt, int argc, char *argv[])  // NOLINT(modernize-avoi
       ("gpu-compare", "Compare CPU and GPU results for the query. Implies '--gpu'.", optVal(opt->gpu_compare))
       ("hard-reset", "Perform a hard reset when repeatedly executing a query (--repeat option). Soft reset is the default.", optVal(opt->hard_reset_on_repeat))
       ("map", "The input map file to load <<mapfile>-near.ply> and <<mapfile>-line.ply>", optVal(opt->map_file))
+      ("paged", "Page map regions in on demand rather than loading the full map, keeping at most N regions resident (zero for no limit). Requires map format 0.6 or later.", optVal(opt->page_budget), "N")
       ("o,output", "Sets the base PLY file names to save results to. Defaults to <<mapfile>-near.ply> and <<mapfile>-line.ply>", optVal(opt->output_base))
       ("line", "Perform a line segment test from (x1,y1,z1) to (x2,y2,z2) considering voxels withing radius r of the line segment.", optVal(opt->line), "x1,y1,z1,x2,y2,z2,r")
       ("near", "Perform a nearest neighbours query at the point (x,y,z) with a radius of r.", optVal(opt->neighbours), "x,y,z,r")
@@ -587,7 +593,8 @@ int runQueries(const Options &opt)
   printf("Loading map %s\n", opt.map_file.c_str());
   LoadMapProgress load_progress(prog);
   prog.unpause();
-  int err = ohm::load(opt.map_file.c_str(), map, nullptr);//&loadProgress);
+  int err = (opt.page_budget >= 0) ? ohm::loadPaged(opt.map_file.c_str(), map, size_t(opt.page_budget)) :
+                                     ohm::load(opt.map_file.c_str(), map, nullptr);  //&loadProgress);
   prog.endProgress();
 
   if (err)